@@ -16,12 +16,14 @@
 #include "arch/probe.h"
 
 /* flags we export */
+int ceph_arch_intel_aesni = 0;
 int ceph_arch_intel_pclmul = 0;
 int ceph_arch_intel_sse42 = 0;
 int ceph_arch_intel_sse41 = 0;
 int ceph_arch_intel_ssse3 = 0;
 int ceph_arch_intel_sse3 = 0;
 int ceph_arch_intel_sse2 = 0;
+int ceph_arch_intel_invariant_tsc = 0;
 
 #ifdef __x86_64__
 
@@ -45,6 +47,7 @@ static void do_cpuid(unsigned int *eax, unsigned int *ebx, unsigned int *ecx,
 
 /* http://en.wikipedia.org/wiki/CPUID#EAX.3D1:_Processor_Info_and_Feature_Bits */
 
+#define CPUID_AESNI	(1 << 25)
 #define CPUID_PCLMUL	(1 << 1)
 #define CPUID_SSE42	(1 << 20)
 #define CPUID_SSE41	(1 << 19)
@@ -52,11 +55,17 @@ static void do_cpuid(unsigned int *eax, unsigned int *ebx, unsigned int *ecx,
 #define CPUID_SSE3	(1)
 #define CPUID_SSE2	(1 << 26)
 
+/* http://en.wikipedia.org/wiki/CPUID#EAX.3D80000007h:_Advanced_Power_Management_Information */
+#define CPUID_INVARIANT_TSC	(1 << 8)
+
 int ceph_arch_intel_probe(void)
 {
 	/* i know how to check this on x86_64... */
 	unsigned int eax = 1, ebx, ecx, edx;
 	do_cpuid(&eax, &ebx, &ecx, &edx);
+	if ((ecx & CPUID_AESNI) != 0) {
+		ceph_arch_intel_aesni = 1;
+	}
 	if ((ecx & CPUID_PCLMUL) != 0) {
 		ceph_arch_intel_pclmul = 1;
 	}
@@ -76,6 +85,17 @@ int ceph_arch_intel_probe(void)
 	        ceph_arch_intel_sse2 = 1;
 	}
 
+	/* invariant TSC lives in the extended power management leaf */
+	eax = 0x80000000;
+	do_cpuid(&eax, &ebx, &ecx, &edx);
+	if (eax >= 0x80000007) {
+		eax = 0x80000007;
+		do_cpuid(&eax, &ebx, &ecx, &edx);
+		if ((edx & CPUID_INVARIANT_TSC) != 0) {
+			ceph_arch_intel_invariant_tsc = 1;
+		}
+	}
+
 	return 0;
 }
 
@@ -23,6 +23,8 @@
 # include <pk11pub.h>
 #endif
 
+#include "arch/intel.h"
+#include "auth/crypto_aesni.h"
 #include "include/assert.h"
 #include "common/Clock.h"
 #include "common/armor.h"
@@ -235,6 +237,59 @@ int CryptoAES::validate_secret(bufferptr& secret)
   return 0;
 }
 
+// aes-ni fast path for the session-key operations; same AES-128-CBC
+// with PKCS#7 padding the NSS/cryptopp paths produce, so ciphertexts
+// interoperate either way
+static bool aesni_encrypt(const bufferptr& secret, const bufferlist& in,
+			  bufferlist& out)
+{
+  if (!ceph_arch_intel_aesni || !ceph_crypto_aesni_exists())
+    return false;
+  bufferptr out_tmp(in.length() + 16);
+  bufferlist flat;
+  flat.append(in);
+  flat.rebuild();
+  int len = ceph_aesni_cbc_encrypt((unsigned char *)out_tmp.c_str(),
+				   (const unsigned char *)flat.c_str(),
+				   flat.length(),
+				   (const unsigned char *)secret.c_str(),
+				   (const unsigned char *)CEPH_AES_IV);
+  if (len < 0)
+    return false;
+  out_tmp.set_length(len);
+  out.append(out_tmp);
+  return true;
+}
+
+static bool aesni_decrypt(const bufferptr& secret, const bufferlist& in,
+			  bufferlist& out, std::string &error)
+{
+  if (!ceph_arch_intel_aesni || !ceph_crypto_aesni_exists())
+    return false;
+  if (secret.length() < 16)
+    return false;
+  if (in.length() == 0 || in.length() % 16) {
+    error = "failed to decrypt";
+    return true;
+  }
+  bufferptr out_tmp(in.length());
+  bufferlist flat;
+  flat.append(in);
+  flat.rebuild();
+  int len = ceph_aesni_cbc_decrypt((unsigned char *)out_tmp.c_str(),
+				   (const unsigned char *)flat.c_str(),
+				   flat.length(),
+				   (const unsigned char *)secret.c_str(),
+				   (const unsigned char *)CEPH_AES_IV);
+  if (len < 0) {
+    error = "failed to decrypt";
+    return true;
+  }
+  out_tmp.set_length(len);
+  out.append(out_tmp);
+  return true;
+}
+
 void CryptoAES::encrypt(const bufferptr& secret, const bufferlist& in, bufferlist& out,
 			std::string &error) const
 {
@@ -242,6 +297,8 @@ void CryptoAES::encrypt(const bufferptr& secret, const bufferlist& in, bufferlis
     error = "key is too short";
     return;
   }
+  if (aesni_encrypt(secret, in, out))
+    return;
 #ifdef USE_CRYPTOPP
   {
     const unsigned char *key = (const unsigned char *)secret.c_str();
@@ -274,9 +331,11 @@ void CryptoAES::encrypt(const bufferptr& secret, const bufferlist& in, bufferlis
 #endif
 }
 
-void CryptoAES::decrypt(const bufferptr& secret, const bufferlist& in, 
+void CryptoAES::decrypt(const bufferptr& secret, const bufferlist& in,
 			bufferlist& out, std::string &error) const
 {
+  if (aesni_decrypt(secret, in, out, error))
+    return;
 #ifdef USE_CRYPTOPP
   const unsigned char *key = (const unsigned char *)secret.c_str();
 
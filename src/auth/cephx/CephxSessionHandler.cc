@@ -24,41 +24,60 @@
 
 #define dout_subsys ceph_subsys_auth
 
+int CephxSessionHandler::_calc_signature(Message *m, uint64_t *psig)
+{
+  const ceph_msg_header& header = m->get_header();
+  const ceph_msg_footer& footer = m->get_footer();
+
+  // The signature is the first 8 bytes of the AES ciphertext of the
+  // plaintext below.  This is byte-identical to what running the crc
+  // sequence through encode_encrypt() produces (less its length
+  // framing), so peers running the older code see the same signatures;
+  // we just skip the extra bufferlists and framing on this hot path.
+  bufferlist bl_plaintext;
+  __u8 struct_v = 1;
+  ::encode(struct_v, bl_plaintext);
+  uint64_t magic = AUTH_ENC_MAGIC;
+  ::encode(magic, bl_plaintext);
+  ::encode(header.crc, bl_plaintext);
+  ::encode(footer.front_crc, bl_plaintext);
+  ::encode(footer.middle_crc, bl_plaintext);
+  ::encode(footer.data_crc, bl_plaintext);
+
+  bufferlist bl_ciphertext;
+  std::string error;
+  key.encrypt(cct, bl_plaintext, bl_ciphertext, error);
+  if (!error.empty()) {
+    ldout(cct, 0) << "error encrypting message signature: " << error << dendl;
+    return SESSION_SIGNATURE_FAILURE;
+  }
+
+  bufferlist::iterator ci = bl_ciphertext.begin();
+  ::decode(*psig, ci);
+  return 0;
+}
+
 int CephxSessionHandler::sign_message(Message *m)
 {
   // If runtime signing option is off, just return success without signing.
   if (!cct->_conf->cephx_sign_messages) {
     return 0;
   }
-  bufferlist bl_plaintext, bl_encrypted;
-  ceph_msg_header header = m->get_header();
-  std::string error;
 
+  ceph_msg_header& header = m->get_header();
   ceph_msg_footer& en_footer = m->get_footer();
 
-  ::encode(header.crc, bl_plaintext);
-  ::encode(en_footer.front_crc, bl_plaintext);
-  ::encode(en_footer.middle_crc, bl_plaintext);
-  ::encode(en_footer.data_crc, bl_plaintext);
-
   ldout(cct, 10) <<  "sign_message: seq # " << header.seq << " CRCs are: header " << header.crc
 		 << " front " << en_footer.front_crc << " middle " << en_footer.middle_crc
 		 << " data " << en_footer.data_crc << dendl;
 
-  if (encode_encrypt(cct, bl_plaintext, key, bl_encrypted, error)) {
-    ldout(cct, 0) << "error encrypting message signature: " << error << dendl;
+  uint64_t sig;
+  int r = _calc_signature(m, &sig);
+  if (r < 0) {
     ldout(cct, 0) << "no signature put on message" << dendl;
-    return SESSION_SIGNATURE_FAILURE;
-  } 
-
-  bufferlist::iterator ci = bl_encrypted.begin();
-  // Skip the magic number up front. PLR
-  ci.advance(4);
-  ::decode(en_footer.sig, ci);
-
-  // There's potentially an issue with whether the encoding and decoding done here will work
-  // properly when a big endian and little endian machine are talking.  We think it's OK,
-  // but it should be tested to be sure.  PLR
+    return r;
+  }
+  en_footer.sig = sig;
 
   // Receiver won't trust this flag to decide if msg should have been signed.  It's primarily
   // to debug problems where sender and receiver disagree on need to sign msg.  PLR
@@ -75,8 +94,6 @@ int CephxSessionHandler::check_message_signature(Message *m)
     return 0;
   }
 
-  bufferlist bl_plaintext, bl_ciphertext;
-  std::string sig_error;
   ceph_msg_header& header = m->get_header();
   ceph_msg_footer& footer = m->get_footer();
 
@@ -89,26 +106,13 @@ int CephxSessionHandler::check_message_signature(Message *m)
 
   ldout(cct, 10) << "check_message_signature: seq # = " << m->get_seq() << " front_crc_ = " << footer.front_crc
 		 << " middle_crc = " << footer.middle_crc << " data_crc = " << footer.data_crc << dendl;
-  ::encode(header.crc, bl_plaintext);
-  ::encode(footer.front_crc, bl_plaintext);
-  ::encode(footer.middle_crc, bl_plaintext);
-  ::encode(footer.data_crc, bl_plaintext);
-
-  // Encrypt the buffer containing the checksums to calculate the signature. PLR
-  if (encode_encrypt(cct, bl_plaintext, key, bl_ciphertext, sig_error)) {
-    ldout(cct, 0) << "error in encryption for checking message signature: " << sig_error << dendl;
-    return (SESSION_SIGNATURE_FAILURE);
-  } 
 
-  bufferlist::iterator ci = bl_ciphertext.begin();
-  // Skip the magic number at the front. PLR
-  ci.advance(4);
   uint64_t sig_check;
-  ::decode(sig_check, ci);
-
-  // There's potentially an issue with whether the encoding and decoding done here will work
-  // properly when a big endian and little endian machine are talking.  We think it's OK,
-  // but it should be tested to be sure.  PLR
+  int r = _calc_signature(m, &sig_check);
+  if (r < 0) {
+    ldout(cct, 0) << "error in encryption for checking message signature" << dendl;
+    return r;
+  }
 
   if (sig_check != footer.sig) {
     // Should have been signed, but signature check failed.  PLR
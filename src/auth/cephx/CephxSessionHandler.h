@@ -31,6 +31,8 @@ public:
     return false;
   }
 
+  int _calc_signature(Message *m, uint64_t *psig);
+
   int sign_message(Message *m);
 
   int check_message_signature(Message *m) ;
@@ -0,0 +1,139 @@
+#include "auth/crypto_aesni.h"
+
+#ifdef __x86_64__
+
+#pragma GCC push_options
+#pragma GCC target("aes,sse2")
+
+#include <wmmintrin.h>
+
+/*
+ * AES-128 key expansion with the aeskeygenassist instruction; see the
+ * Intel AES-NI white paper.
+ */
+static inline __m128i expand_step(__m128i key, __m128i keygened)
+{
+	keygened = _mm_shuffle_epi32(keygened, _MM_SHUFFLE(3, 3, 3, 3));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	return _mm_xor_si128(key, keygened);
+}
+
+#define EXPAND(k, rcon) \
+	expand_step(k, _mm_aeskeygenassist_si128(k, rcon))
+
+static void expand_key(__m128i rk[11], const unsigned char *key)
+{
+	rk[0] = _mm_loadu_si128((const __m128i *)key);
+	rk[1] = EXPAND(rk[0], 0x01);
+	rk[2] = EXPAND(rk[1], 0x02);
+	rk[3] = EXPAND(rk[2], 0x04);
+	rk[4] = EXPAND(rk[3], 0x08);
+	rk[5] = EXPAND(rk[4], 0x10);
+	rk[6] = EXPAND(rk[5], 0x20);
+	rk[7] = EXPAND(rk[6], 0x40);
+	rk[8] = EXPAND(rk[7], 0x80);
+	rk[9] = EXPAND(rk[8], 0x1b);
+	rk[10] = EXPAND(rk[9], 0x36);
+}
+
+static inline __m128i encrypt_block(__m128i x, const __m128i rk[11])
+{
+	int r;
+
+	x = _mm_xor_si128(x, rk[0]);
+	for (r = 1; r < 10; r++)
+		x = _mm_aesenc_si128(x, rk[r]);
+	return _mm_aesenclast_si128(x, rk[10]);
+}
+
+int ceph_aesni_cbc_encrypt(unsigned char *out,
+			   const unsigned char *in, unsigned in_len,
+			   const unsigned char *key, const unsigned char *iv)
+{
+	__m128i rk[11];
+	__m128i x = _mm_loadu_si128((const __m128i *)iv);
+	unsigned char last[16];
+	unsigned pad = 16 - (in_len % 16);
+	unsigned whole = in_len - (in_len % 16);
+	unsigned i;
+
+	expand_key(rk, key);
+
+	for (i = 0; i < whole; i += 16) {
+		x = _mm_xor_si128(
+			x, _mm_loadu_si128((const __m128i *)(in + i)));
+		x = encrypt_block(x, rk);
+		_mm_storeu_si128((__m128i *)(out + i), x);
+	}
+
+	/* final block: leftover input plus PKCS#7 padding (always some) */
+	for (i = 0; i < 16 - pad; i++)
+		last[i] = in[whole + i];
+	for (; i < 16; i++)
+		last[i] = (unsigned char)pad;
+	x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i *)last));
+	x = encrypt_block(x, rk);
+	_mm_storeu_si128((__m128i *)(out + whole), x);
+
+	return whole + 16;
+}
+
+int ceph_aesni_cbc_decrypt(unsigned char *out,
+			   const unsigned char *in, unsigned in_len,
+			   const unsigned char *key, const unsigned char *iv)
+{
+	__m128i rk[11];
+	__m128i drk[11];
+	__m128i prev = _mm_loadu_si128((const __m128i *)iv);
+	unsigned pad, bad, i;
+	int r;
+
+	if (in_len == 0 || in_len % 16)
+		return -1;
+
+	expand_key(rk, key);
+	drk[0] = rk[10];
+	for (r = 1; r < 10; r++)
+		drk[r] = _mm_aesimc_si128(rk[10 - r]);
+	drk[10] = rk[0];
+
+	for (i = 0; i < in_len; i += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i x = _mm_xor_si128(c, drk[0]);
+
+		for (r = 1; r < 10; r++)
+			x = _mm_aesdec_si128(x, drk[r]);
+		x = _mm_aesdeclast_si128(x, drk[10]);
+		x = _mm_xor_si128(x, prev);
+		_mm_storeu_si128((__m128i *)(out + i), x);
+		prev = c;
+	}
+
+	pad = out[in_len - 1];
+	if (pad == 0 || pad > 16 || pad > in_len)
+		return -1;
+	bad = 0;
+	for (i = in_len - pad; i < in_len; i++)
+		bad |= out[i] ^ pad;
+	if (bad)
+		return -1;
+	return in_len - pad;
+}
+
+#pragma GCC pop_options
+
+int ceph_crypto_aesni_exists(void)
+{
+	return 1;
+}
+
+#else
+
+int ceph_crypto_aesni_exists(void)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef CEPH_AUTH_CRYPTO_AESNI_H
+#define CEPH_AUTH_CRYPTO_AESNI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* is the fast version compiled in */
+extern int ceph_crypto_aesni_exists(void);
+
+#ifdef __x86_64__
+
+/*
+ * AES-128-CBC with PKCS#7 padding, matching what NSS's CKM_AES_CBC_PAD
+ * and cryptopp's default filter produce.  The caller must check
+ * ceph_arch_intel_aesni first.
+ *
+ * encrypt: out must hold in_len + 16 bytes; returns the ciphertext
+ * length (always a multiple of 16).
+ * decrypt: out must hold in_len bytes; returns the plaintext length,
+ * or -1 if in_len is not a positive multiple of 16 or the padding is
+ * malformed.
+ */
+extern int ceph_aesni_cbc_encrypt(unsigned char *out,
+				  const unsigned char *in, unsigned in_len,
+				  const unsigned char *key,
+				  const unsigned char *iv);
+extern int ceph_aesni_cbc_decrypt(unsigned char *out,
+				  const unsigned char *in, unsigned in_len,
+				  const unsigned char *key,
+				  const unsigned char *iv);
+
+#else
+
+static inline int ceph_aesni_cbc_encrypt(unsigned char *out,
+					 const unsigned char *in,
+					 unsigned in_len,
+					 const unsigned char *key,
+					 const unsigned char *iv)
+{
+	return -1;
+}
+
+static inline int ceph_aesni_cbc_decrypt(unsigned char *out,
+					 const unsigned char *in,
+					 unsigned in_len,
+					 const unsigned char *key,
+					 const unsigned char *iv)
+{
+	return -1;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -157,6 +157,8 @@ Client::Client(Messenger *m, MonClient *mc)
     getgroups_cb_handle(NULL),
     async_ino_invalidator(m->cct),
     async_dentry_invalidator(m->cct),
+    async_io_finisher(m->cct),
+    async_io_started(false),
     tick_event(NULL),
     monclient(mc), messenger(m), whoami(m->get_myname().num()),
     initialized(false), mounted(false), unmounting(false),
@@ -376,6 +378,9 @@ int Client::init()
   plb.add_time_avg(l_c_wrlat, "wrlat");
   plb.add_time_avg(l_c_owrlat, "owrlat");
   plb.add_time_avg(l_c_ordlat, "ordlat");
+  plb.add_u64_counter(l_c_ra_issued, "readahead_issued");
+  plb.add_u64_counter(l_c_read_cached, "read_cached");
+  plb.add_u64_counter(l_c_read_miss, "read_miss");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 
@@ -443,6 +448,12 @@ void Client::shutdown()
     async_dentry_invalidator.stop();
   }
 
+  if (async_io_started) {
+    ldout(cct, 10) << "shutdown stopping aio callback finisher" << dendl;
+    async_io_finisher.wait_for_empty();
+    async_io_finisher.stop();
+  }
+
   objectcacher->stop();  // outside of client_lock! this does a join.
 
   client_lock.Lock();
@@ -3090,6 +3101,14 @@ void Client::remove_cap(Cap *cap, bool queue_release)
     i.seq = cap->issue_seq;
     i.migrate_seq = cap->mseq;
     session->release->caps.push_back(i);
+
+    // during a mass trim (cache pressure recall) don't let the batch
+    // grow without bound or sit until the next tick; ship it once it
+    // gets big and start a new one.
+    if (cct->_conf->client_max_cap_releases > 0 &&
+	session->release->caps.size() >=
+	  (size_t)cct->_conf->client_max_cap_releases)
+      flush_cap_releases();
   }
 
   if (in->auth_cap == cap) {
@@ -4197,6 +4216,24 @@ void Client::tick()
     if (el > mdsmap->get_session_timeout() / 3.0)
       renew_caps();
 
+    // proactively trim caps we are unlikely to use again, before the
+    // mds has to recall them in a storm.  the releases go through the
+    // same batched MClientCapRelease path as recall-driven trimming.
+    if (cct->_conf->client_caps_soft_limit > 0) {
+      for (map<int,MetaSession*>::iterator q = mds_sessions.begin();
+	   q != mds_sessions.end();
+	   ++q) {
+	MetaSession *s = q->second;
+	if (s->caps.size() > (size_t)cct->_conf->client_caps_soft_limit) {
+	  ldout(cct, 10) << "tick trimming session mds." << q->first
+			 << " caps " << s->caps.size()
+			 << " > soft limit " << cct->_conf->client_caps_soft_limit
+			 << dendl;
+	  trim_caps(s, cct->_conf->client_caps_soft_limit);
+	}
+      }
+    }
+
     flush_cap_releases();
   }
 
@@ -6134,18 +6171,24 @@ int Client::uninline_data(Inode *in, Context *onfinish)
 
 int Client::read(int fd, char *buf, loff_t size, loff_t offset)
 {
-  Mutex::Locker lock(client_lock);
+  client_lock.Lock();
   tout(cct) << "read" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << size << std::endl;
   tout(cct) << offset << std::endl;
 
   Fh *f = get_filehandle(fd);
-  if (!f)
+  if (!f) {
+    client_lock.Unlock();
     return -EBADF;
+  }
   bufferlist bl;
   int r = _read(f, offset, size, &bl);
   ldout(cct, 3) << "read(" << fd << ", " << (void*)buf << ", " << size << ", " << offset << ") = " << r << dendl;
+  client_lock.Unlock();
+
+  // copy into the caller's buffer without serializing other threads
+  // behind a potentially large memcpy
   if (r >= 0) {
     bl.copy(0, bl.length(), buf);
     r = bl.length();
@@ -6153,6 +6196,93 @@ int Client::read(int fd, char *buf, loff_t size, loff_t offset)
   return r;
 }
 
+struct C_Client_AioCallback : public Context {
+  client_aio_callback_t cb;
+  void *priv;
+  C_Client_AioCallback(client_aio_callback_t c, void *p) : cb(c), priv(p) {}
+  void finish(int r) {
+    cb(r, priv);
+  }
+};
+
+int Client::aio_read(int fd, char *buf, loff_t size, loff_t offset,
+		     client_aio_callback_t cb, void *priv)
+{
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "aio_read" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << size << std::endl;
+  tout(cct) << offset << std::endl;
+
+  Fh *f = get_filehandle(fd);
+  if (!f)
+    return -EBADF;
+  if (offset < 0)
+    return -EINVAL;  // async i/o does not use the implicit file position
+
+  if (!async_io_started) {
+    async_io_finisher.start();
+    async_io_started = true;
+  }
+
+  Inode *in = f->inode;
+
+  // fully async path: cached read with Fc caps.
+  if (cct->_conf->client_oc &&
+      !cct->_conf->client_debug_force_sync_read &&
+      in->inline_version == CEPH_INLINE_NONE) {
+    int have;
+    int r = get_caps(in, CEPH_CAP_FILE_RD, CEPH_CAP_FILE_CACHE, &have, -1);
+    if (r < 0)
+      return r;
+    if (have & CEPH_CAP_FILE_CACHE) {
+      uint64_t len = size;
+      if ((uint64_t)offset >= in->size)
+	len = 0;
+      else if (offset + len > in->size)
+	len = in->size - offset;
+      if (len == 0) {
+	put_cap_ref(in, CEPH_CAP_FILE_RD);
+	async_io_finisher.queue(new C_Client_AioCallback(cb, priv), 0);
+	return 0;
+      }
+      get_cap_ref(in, CEPH_CAP_FILE_CACHE);
+      C_Client_AioRead *onfinish = new C_Client_AioRead(this, in, buf, cb, priv);
+      ldout(cct, 10) << "aio_read " << *in << " " << offset << "~" << len << dendl;
+      r = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
+				  offset, len, &onfinish->bl, 0, onfinish);
+      if (r != 0)
+	onfinish->complete(r);   // it was all cached
+      return 0;
+    }
+    put_cap_ref(in, CEPH_CAP_FILE_RD);
+  }
+
+  // slow path (no cache cap, inline data, sync reads forced): do the
+  // read synchronously and defer only the callback.
+  bufferlist bl;
+  int r = _read(f, offset, size, &bl);
+  if (r >= 0) {
+    bl.copy(0, bl.length(), buf);
+    r = bl.length();
+  }
+  async_io_finisher.queue(new C_Client_AioCallback(cb, priv), r);
+  return 0;
+}
+
+void Client::_aio_read_complete(C_Client_AioRead *c, int r)
+{
+  // called with client_lock held by the objectcacher completion
+  ldout(cct, 10) << "_aio_read_complete r=" << r
+		 << " len=" << c->bl.length() << dendl;
+  put_cap_ref(c->inode, CEPH_CAP_FILE_RD | CEPH_CAP_FILE_CACHE);
+  if (r >= 0) {
+    c->bl.copy(0, c->bl.length(), c->buf);
+    r = c->bl.length();
+  }
+  async_io_finisher.queue(new C_Client_AioCallback(c->cb, c->priv), r);
+}
+
 int Client::_read(Fh *f, int64_t offset, uint64_t size, bufferlist *bl)
 {
   const md_config_t *conf = cct->_conf;
@@ -6250,10 +6380,21 @@ retry:
 success:
   // adjust readahead state
   if (f->last_pos != start_pos) {
+    // not sequential; constant stride (hpc-style strided scan)?
+    loff_t stride = start_pos - f->last_read_start;
+    if (stride > 0 && stride == f->read_stride) {
+      f->nr_stride_read++;
+    } else {
+      f->read_stride = stride > 0 ? stride : 0;
+      f->nr_stride_read = 0;
+    }
     f->nr_consec_read = f->consec_read_bytes = 0;
   } else {
     f->nr_consec_read++;
+    f->read_stride = 0;
+    f->nr_stride_read = 0;
   }
+  f->last_read_start = start_pos;
   f->consec_read_bytes += bl->length();
   ldout(cct, 10) << "readahead nr_consec_read " << f->nr_consec_read
 	   << " for " << f->consec_read_bytes << " bytes" 
@@ -6356,6 +6497,8 @@ int Client::_read_async(Fh *f, uint64_t off, uint64_t len, bufferlist *bl)
 	if (r == 0) {
 	  ldout(cct, 20) << "readahead initiated, c " << onfinish << dendl;
 	  get_cap_ref(in, CEPH_CAP_FILE_RD | CEPH_CAP_FILE_CACHE);
+	  if (logger)
+	    logger->inc(l_c_ra_issued);
 	} else {
 	  ldout(cct, 20) << "readahead was no-op, already cached" << dendl;
 	  delete onfinish;
@@ -6364,6 +6507,35 @@ int Client::_read_async(Fh *f, uint64_t off, uint64_t len, bufferlist *bl)
     }
   }
 
+  // strided readahead?  once a constant forward stride has repeated a
+  // few times, prefetch the next few chunks the pattern will ask for.
+  if (f->read_stride > 0 &&
+      f->nr_stride_read >= 2 &&
+      f->read_stride > (loff_t)len &&   // gaps; plain readahead covers the rest
+      conf->client_readahead_stride_reads > 0) {
+    for (int i = 1; i <= conf->client_readahead_stride_reads; i++) {
+      loff_t soff = off + i * f->read_stride;
+      if ((uint64_t)soff >= in->size)
+	break;
+      loff_t slen = MIN((loff_t)len, (loff_t)(in->size - soff));
+      if (objectcacher->file_is_cached(&in->oset, &in->layout, in->snapid,
+				       soff, slen))
+	continue;
+      ldout(cct, 20) << "strided readahead " << soff << "~" << slen
+		     << " (stride " << f->read_stride << ")" << dendl;
+      Context *onfinish = new C_Readahead(this, in);
+      int r = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
+				      soff, slen, NULL, 0, onfinish);
+      if (r == 0) {
+	get_cap_ref(in, CEPH_CAP_FILE_RD | CEPH_CAP_FILE_CACHE);
+	if (logger)
+	  logger->inc(l_c_ra_issued);
+      } else {
+	delete onfinish;
+      }
+    }
+  }
+
   // read (and possibly block)
   int r, rvalue = 0;
   Mutex flock("Client::_read_async flock");
@@ -6372,6 +6544,8 @@ int Client::_read_async(Fh *f, uint64_t off, uint64_t len, bufferlist *bl)
   Context *onfinish = new C_SafeCond(&flock, &cond, &done, &rvalue);
   r = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
 			      off, len, bl, 0, onfinish);
+  if (logger)
+    logger->inc(r == 0 ? l_c_read_miss : l_c_read_cached);
   if (r == 0) {
     get_cap_ref(in, CEPH_CAP_FILE_CACHE);
     client_lock.Unlock();
@@ -6506,7 +6680,36 @@ int Client::write(int fd, const char *buf, loff_t size, loff_t offset)
 }
 
 
-int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
+int Client::aio_write(int fd, const char *buf, loff_t size, loff_t offset,
+		      client_aio_callback_t cb, void *priv)
+{
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "aio_write" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << size << std::endl;
+  tout(cct) << offset << std::endl;
+
+  Fh *fh = get_filehandle(fd);
+  if (!fh)
+    return -EBADF;
+  if (offset < 0)
+    return -EINVAL;  // async i/o does not use the implicit file position
+
+  if (!async_io_started) {
+    async_io_finisher.start();
+    async_io_started = true;
+  }
+
+  // buffered writes already complete into the object cache and flush
+  // asynchronously underneath; do the copy-in here (it only blocks when
+  // the dirty limit is hit or the write is sync) and defer the callback.
+  int r = _write(fh, offset, size, buf);
+  async_io_finisher.queue(new C_Client_AioCallback(cb, priv), r);
+  return 0;
+}
+
+int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf,
+		   bufferlist *blp)
 {
   if ((uint64_t)(offset+size) > mdsmap->get_max_filesize()) //too large!
     return -EFBIG;
@@ -6551,11 +6754,16 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
     assert(in->inline_version > 0);
   }
 
-  // copy into fresh buffer (since our write may be resub, async)
-  bufferptr bp;
-  if (size > 0) bp = buffer::copy(buf, size);
+  // copy into fresh buffer (since our write may be resub, async);
+  // callers that already own a private buffer hand it in as blp and
+  // skip the copy.
   bufferlist bl;
-  bl.push_back( bp );
+  if (blp) {
+    bl.claim(*blp);
+  } else if (size > 0) {
+    bufferptr bp = buffer::copy(buf, size);
+    bl.push_back( bp );
+  }
 
   utime_t lat;
   uint64_t totalwritten;
@@ -8606,6 +8814,22 @@ int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
   return r;
 }
 
+int Client::ll_write(Fh *fh, loff_t off, loff_t len, bufferlist *blp)
+{
+  Mutex::Locker lock(client_lock);
+  ldout(cct, 3) << "ll_write " << fh << " " << fh->inode->ino << " " << off <<
+    "~" << len << " (bufferlist)" << dendl;
+  tout(cct) << "ll_write" << std::endl;
+  tout(cct) << (unsigned long)fh << std::endl;
+  tout(cct) << off << std::endl;
+  tout(cct) << len << std::endl;
+
+  int r = _write(fh, off, len, NULL, blp);
+  ldout(cct, 3) << "ll_write " << fh << " " << off << "~" << len << " = " << r
+		<< dendl;
+  return r;
+}
+
 int Client::ll_flush(Fh *fh)
 {
   Mutex::Locker lock(client_lock);
@@ -83,6 +83,9 @@ enum {
   l_c_owrlat,
   l_c_ordlat,
   l_c_wrlat,
+  l_c_ra_issued,
+  l_c_read_cached,
+  l_c_read_miss,
   l_c_last,
 };
 
@@ -128,6 +131,8 @@ typedef void (*client_dentry_callback_t)(void *handle, vinodeno_t dirino,
 
 typedef int (*client_getgroups_callback_t)(void *handle, uid_t uid, gid_t **sgids);
 
+typedef void (*client_aio_callback_t)(int res, void *priv);
+
 // ========================================================
 // client interface
 
@@ -225,6 +230,8 @@ class Client : public Dispatcher {
 
   Finisher async_ino_invalidator;
   Finisher async_dentry_invalidator;
+  Finisher async_io_finisher;  // invokes aio_read/aio_write callbacks
+  bool async_io_started;
 
   Context *tick_event;
   utime_t last_cap_renew;
@@ -354,6 +361,17 @@ protected:
 
   // global client lock
   //  - protects Client and buffer cache both!
+  //
+  // Splitting this into per-inode data locks and a separate cap/session
+  // lock is not a local change.  The ObjectCacher is constructed around
+  // this mutex and its completions (and the Objecter's) run expecting
+  // it; cap grant/revoke spans inodes through MetaSession and SnapRealm,
+  // so a cap domain lock would nest against any per-inode lock on every
+  // message; and the path-walking metadata ops mutate the shared
+  // dentry/inode graph.  Until those are untangled, keep long waits
+  // (cap acquisition, flush, sync reads) off this lock -- they already
+  // drop it around blocking -- and keep copies/decodes outside it where
+  // possible rather than adding lock domains piecemeal.
   Mutex                  client_lock;
 
   // helpers
@@ -571,6 +589,22 @@ private:
     }
   };
 
+  struct C_Client_AioRead : public Context {
+    Client *client;
+    Inode *inode;
+    char *buf;
+    client_aio_callback_t cb;
+    void *priv;
+    bufferlist bl;
+    C_Client_AioRead(Client *c, Inode *i, char *b,
+		     client_aio_callback_t cb_, void *p)
+      : client(c), inode(i), buf(b), cb(cb_), priv(p) { }
+    void finish(int r) {
+      client->_aio_read_complete(this, r);
+    }
+  };
+  void _aio_read_complete(C_Client_AioRead *c, int r);
+
   int _read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl, bool *checkeof);
   int _read_async(Fh *f, uint64_t off, uint64_t len, bufferlist *bl);
 
@@ -599,7 +633,8 @@ private:
 	      bool *created = NULL, int uid=-1, int gid=-1);
   loff_t _lseek(Fh *fh, loff_t offset, int whence);
   int _read(Fh *fh, int64_t offset, uint64_t size, bufferlist *bl);
-  int _write(Fh *fh, int64_t offset, uint64_t size, const char *buf);
+  int _write(Fh *fh, int64_t offset, uint64_t size, const char *buf,
+	     bufferlist *blp=NULL);
   int _flush(Fh *fh);
   int _fsync(Fh *fh, bool syncdataonly);
   int _sync_fs();
@@ -704,6 +739,10 @@ public:
   loff_t lseek(int fd, loff_t offset, int whence);
   int read(int fd, char *buf, loff_t size, loff_t offset=-1);
   int write(int fd, const char *buf, loff_t size, loff_t offset=-1);
+  int aio_read(int fd, char *buf, loff_t size, loff_t offset,
+	       client_aio_callback_t cb, void *priv);
+  int aio_write(int fd, const char *buf, loff_t size, loff_t offset,
+		client_aio_callback_t cb, void *priv);
   int fake_write_size(int fd, loff_t size);
   int ftruncate(int fd, loff_t size);
   int fsync(int fd, bool syncdataonly);
@@ -813,6 +852,7 @@ public:
 
   int ll_read(Fh *fh, loff_t off, loff_t len, bufferlist *bl);
   int ll_write(Fh *fh, loff_t off, loff_t len, const char *data);
+  int ll_write(Fh *fh, loff_t off, loff_t len, bufferlist *blp);
   loff_t ll_lseek(Fh *fh, loff_t offset, int whence);
   int ll_flush(Fh *fh);
   int ll_fsync(Fh *fh, bool syncdataonly);
@@ -22,9 +22,13 @@ struct Fh {
   loff_t last_pos;
   loff_t consec_read_bytes;
   int nr_consec_read;
+  loff_t last_read_start;    // start offset of the previous read
+  loff_t read_stride;        // detected constant stride (0 = none)
+  int nr_stride_read;        // consecutive reads at read_stride
 
   Fh() : inode(0), pos(0), mds(0), mode(0), flags(0), pos_locked(false),
-	 last_pos(0), consec_read_bytes(0), nr_consec_read(0) {}
+	 last_pos(0), consec_read_bytes(0), nr_consec_read(0),
+	 last_read_start(0), read_stride(0), nr_stride_read(0) {}
 };
 
 
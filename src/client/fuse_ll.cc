@@ -458,6 +458,37 @@ static void fuse_ll_write(fuse_req_t req, fuse_ino_t ino, const char *buf,
     fuse_reply_err(req, -r);
 }
 
+#if FUSE_VERSION > FUSE_MAKE_VERSION(2, 9)
+static void fuse_ll_write_buf(fuse_req_t req, fuse_ino_t ino,
+			      struct fuse_bufvec *bufv, off_t off,
+			      struct fuse_file_info *fi)
+{
+  CephFuse::Handle *cfuse = (CephFuse::Handle *)fuse_req_userdata(req);
+  Fh *fh = (Fh*)fi->fh;
+  size_t size = fuse_buf_size(bufv);
+
+  // with splice the data is sitting in a pipe, not a memory buffer;
+  // land it directly in a buffer we own so the write path can claim it
+  // without a second copy.
+  bufferptr bp = buffer::create(size);
+  struct fuse_bufvec dst = FUSE_BUFVEC_INIT(size);
+  dst.buf[0].mem = bp.c_str();
+  ssize_t copied = fuse_buf_copy(&dst, bufv, (enum fuse_buf_copy_flags)0);
+  if (copied < 0) {
+    fuse_reply_err(req, -copied);
+    return;
+  }
+  bp.set_length(copied);
+  bufferlist bl;
+  bl.push_back(bp);
+  int r = cfuse->client->ll_write(fh, off, bl.length(), &bl);
+  if (r >= 0)
+    fuse_reply_write(req, r);
+  else
+    fuse_reply_err(req, -r);
+}
+#endif
+
 static void fuse_ll_flush(fuse_req_t req, fuse_ino_t ino,
 			  struct fuse_file_info *fi)
 {
@@ -753,7 +784,7 @@ const static struct fuse_lowlevel_ops fuse_ll_oper = {
 #endif
  poll: 0,
 #if FUSE_VERSION > FUSE_MAKE_VERSION(2, 9)
- write_buf: 0,
+ write_buf: fuse_ll_write_buf,
  retrieve_reply: 0,
  forget_multi: 0,
  flock: 0,
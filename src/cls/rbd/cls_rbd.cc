@@ -90,6 +90,8 @@ cls_method_handle_t h_dir_list;
 cls_method_handle_t h_dir_add_image;
 cls_method_handle_t h_dir_remove_image;
 cls_method_handle_t h_dir_rename_image;
+cls_method_handle_t h_object_map_resize;
+cls_method_handle_t h_object_map_update;
 cls_method_handle_t h_old_snapshots_list;
 cls_method_handle_t h_old_snapshot_add;
 cls_method_handle_t h_old_snapshot_remove;
@@ -1468,6 +1470,100 @@ int set_id(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
   return cls_cxx_write(hctx, 0, write_bl.length(), &write_bl);
 }
 
+/********************** methods for rbd_object_map ***********************/
+
+/**
+ * Resize an image's object existence map.  The map is the object's
+ * data: one bit per data object, bit set means the object may exist.
+ * New bits start cleared; shrinking drops trailing bits.
+ *
+ * Input:
+ * @param num_objects number of data objects the map must cover
+ *
+ * Output:
+ * @returns 0 on success, negative error code on failure
+ */
+int object_map_resize(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  uint64_t num_objects;
+
+  bufferlist::iterator iter = in->begin();
+  try {
+    ::decode(num_objects, iter);
+  } catch (const buffer::error &err) {
+    return -EINVAL;
+  }
+
+  CLS_LOG(20, "object_map_resize num_objects=%llu",
+	  (unsigned long long)num_objects);
+
+  uint64_t new_len = (num_objects + 7) / 8;
+  uint64_t size = 0;
+  int r = cls_cxx_stat(hctx, &size, NULL);
+  if (r < 0 && r != -ENOENT)
+    return r;
+
+  bufferlist bits;
+  if (size > 0) {
+    r = cls_cxx_read(hctx, 0, MIN(size, new_len), &bits);
+    if (r < 0)
+      return r;
+  }
+  if (bits.length() < new_len)
+    bits.append_zero(new_len - bits.length());
+
+  return cls_cxx_write_full(hctx, &bits);
+}
+
+/**
+ * Mark a range of data objects as possibly existing.  Bits only ever
+ * go from clear to set here, so concurrent updaters cannot undo each
+ * other.
+ *
+ * Input:
+ * @param start_ono first object number to mark
+ * @param end_ono one past the last object number to mark
+ *
+ * Output:
+ * @returns 0 on success, -ERANGE if the map does not cover the range
+ */
+int object_map_update(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  uint64_t start_ono, end_ono;
+
+  bufferlist::iterator iter = in->begin();
+  try {
+    ::decode(start_ono, iter);
+    ::decode(end_ono, iter);
+  } catch (const buffer::error &err) {
+    return -EINVAL;
+  }
+
+  if (end_ono < start_ono)
+    return -EINVAL;
+
+  CLS_LOG(20, "object_map_update start_ono=%llu end_ono=%llu",
+	  (unsigned long long)start_ono, (unsigned long long)end_ono);
+
+  uint64_t size = 0;
+  int r = cls_cxx_stat(hctx, &size, NULL);
+  if (r < 0)
+    return r;
+  if (end_ono > size * 8)
+    return -ERANGE;
+
+  bufferlist bl;
+  r = cls_cxx_read(hctx, 0, size, &bl);
+  if (r < 0)
+    return r;
+
+  char *bits = bl.c_str();
+  for (uint64_t i = start_ono; i < end_ono; i++)
+    bits[i >> 3] |= 1 << (i & 7);
+
+  return cls_cxx_write_full(hctx, &bl);
+}
+
 /*********************** methods for rbd_directory ***********************/
 
 static const string dir_key_for_id(const string &id)
@@ -2065,6 +2161,14 @@ void __cls_init()
 			  CLS_METHOD_RD | CLS_METHOD_WR,
 			  set_id, &h_set_id);
 
+  /* methods for the rbd_object_map object */
+  cls_register_cxx_method(h_class, "object_map_resize",
+			  CLS_METHOD_RD | CLS_METHOD_WR,
+			  object_map_resize, &h_object_map_resize);
+  cls_register_cxx_method(h_class, "object_map_update",
+			  CLS_METHOD_RD | CLS_METHOD_WR,
+			  object_map_update, &h_object_map_update);
+
   /* methods for the rbd_directory object */
   cls_register_cxx_method(h_class, "dir_get_id",
 			  CLS_METHOD_RD,
@@ -542,6 +542,25 @@ namespace librbd {
       return ioctx->exec(oid, "rbd", "set_id", in, out);
     }
 
+    /******************** rbd_object_map object methods ********************/
+
+    int object_map_resize(librados::IoCtx *ioctx, const std::string &oid,
+			  uint64_t num_objects)
+    {
+      bufferlist in, out;
+      ::encode(num_objects, in);
+      return ioctx->exec(oid, "rbd", "object_map_resize", in, out);
+    }
+
+    int object_map_update(librados::IoCtx *ioctx, const std::string &oid,
+			  uint64_t start_ono, uint64_t end_ono)
+    {
+      bufferlist in, out;
+      ::encode(start_ono, in);
+      ::encode(end_ono, in);
+      return ioctx->exec(oid, "rbd", "object_map_update", in, out);
+    }
+
     /******************** rbd_directory object methods ********************/
 
     int dir_get_id(librados::IoCtx *ioctx, const std::string &oid,
@@ -82,6 +82,12 @@ namespace librbd {
     int get_id(librados::IoCtx *ioctx, const std::string &oid, std::string *id);
     int set_id(librados::IoCtx *ioctx, const std::string &oid, std::string id);
 
+    // operations on the rbd_object_map.$image_id object
+    int object_map_resize(librados::IoCtx *ioctx, const std::string &oid,
+			  uint64_t num_objects);
+    int object_map_update(librados::IoCtx *ioctx, const std::string &oid,
+			  uint64_t start_ono, uint64_t end_ono);
+
     // operations on rbd_directory objects
     int dir_get_id(librados::IoCtx *ioctx, const std::string &oid,
 		   const std::string &name, std::string *id);
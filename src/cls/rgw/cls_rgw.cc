@@ -213,40 +213,76 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
     return -EINVAL;
   }
 
-  bufferlist bl;
+  std::map<string, struct rgw_bucket_dir_entry>& m = new_dir.m;
+  std::list<string>& common_prefixes = ret.common_prefixes;
+
+  string start_obj = op.start_obj;
+  bool done = false;       /* walked off the end of the objects index */
+  bool truncated = false;
+  bool more = true;
+
+  /* when a delimiter is given, keys that share a common prefix up to the
+   * delimiter are folded into a single prefix entry and the omap iteration
+   * is restarted past the whole prefix range, so listing a pseudo-directory
+   * costs a seek per result instead of a scan per object. keys starting
+   * with '_' carry namespace/escape mangling that only the client side
+   * knows how to undo, so those are always returned as plain entries */
+  while (!done && !truncated && more) {
+    uint32_t left = op.num_entries - (m.size() + common_prefixes.size());
+    map<string, bufferlist> keys;
+    rc = get_obj_vals(hctx, start_obj, op.filter_prefix, left + 1, &keys);
+    if (rc < 0)
+      return rc;
 
-  map<string, bufferlist> keys;
-  rc = get_obj_vals(hctx, op.start_obj, op.filter_prefix, op.num_entries + 1, &keys);
-  if (rc < 0)
-    return rc;
+    more = (keys.size() >= left + 1);
 
-  std::map<string, struct rgw_bucket_dir_entry>& m = new_dir.m;
-  std::map<string, bufferlist>::iterator kiter = keys.begin();
-  uint32_t i;
+    std::map<string, bufferlist>::iterator kiter;
+    for (kiter = keys.begin(); kiter != keys.end(); ++kiter) {
+      if (!bi_is_objs_index(kiter->first)) {
+        done = true;
+        break;
+      }
 
-  bool done = false;
+      if (m.size() + common_prefixes.size() >= op.num_entries) {
+        truncated = true;
+        break;
+      }
 
-  for (i = 0; i < op.num_entries && kiter != keys.end(); ++i, ++kiter) {
-    struct rgw_bucket_dir_entry entry;
+      const string& key = kiter->first;
+      start_obj = key;
+
+      if (!op.delimiter.empty() && key[0] != '_') {
+        int delim_pos = key.find(op.delimiter, op.filter_prefix.size());
+        if (delim_pos >= 0) {
+          string prefix_key = key.substr(0, delim_pos + op.delimiter.size());
+          if (common_prefixes.empty() || common_prefixes.back() != prefix_key) {
+            common_prefixes.push_back(prefix_key);
+            /* skip ahead; keys with bytes >= 0xff right after the prefix
+             * may still show up and are caught by the check above */
+            start_obj = prefix_key;
+            start_obj.append(1, (char)0xFF);
+            more = true;
+            break;
+          }
+          continue; /* residual member of the last common prefix */
+        }
+      }
 
-    if (!bi_is_objs_index(kiter->first)) {
-      done = true;
-      break;
-    }
+      struct rgw_bucket_dir_entry entry;
+      bufferlist& entrybl = kiter->second;
+      bufferlist::iterator eiter = entrybl.begin();
+      try {
+        ::decode(entry, eiter);
+      } catch (buffer::error& err) {
+        CLS_LOG(1, "ERROR: rgw_bucket_list(): failed to decode entry, key=%s\n", kiter->first.c_str());
+        return -EINVAL;
+      }
 
-    bufferlist& entrybl = kiter->second;
-    bufferlist::iterator eiter = entrybl.begin();
-    try {
-      ::decode(entry, eiter);
-    } catch (buffer::error& err) {
-      CLS_LOG(1, "ERROR: rgw_bucket_list(): failed to decode entry, key=%s\n", kiter->first.c_str());
-      return -EINVAL;
+      m[key] = entry;
     }
-    
-    m[kiter->first] = entry;
   }
 
-  ret.is_truncated = (kiter != keys.end() && !done);
+  ret.is_truncated = (truncated && !done);
 
   ::encode(ret, *out);
   return 0;
@@ -59,13 +59,15 @@ void cls_rgw_bucket_complete_op(ObjectWriteOperation& o, RGWModifyOp op, string&
 
 
 int cls_rgw_list_op(IoCtx& io_ctx, string& oid, string& start_obj,
-                    string& filter_prefix, uint32_t num_entries,
-                    rgw_bucket_dir *dir, bool *is_truncated)
+                    string& filter_prefix, const string& delimiter,
+                    uint32_t num_entries, rgw_bucket_dir *dir,
+                    std::list<string> *common_prefixes, bool *is_truncated)
 {
   bufferlist in, out;
   struct rgw_cls_list_op call;
   call.start_obj = start_obj;
   call.filter_prefix = filter_prefix;
+  call.delimiter = delimiter;
   call.num_entries = num_entries;
   ::encode(call, in);
   int r = io_ctx.exec(oid, "rgw", "bucket_list", in, out);
@@ -82,6 +84,8 @@ int cls_rgw_list_op(IoCtx& io_ctx, string& oid, string& start_obj,
 
   if (dir)
     *dir = ret.dir;
+  if (common_prefixes)
+    *common_prefixes = ret.common_prefixes;
   if (is_truncated)
     *is_truncated = ret.is_truncated;
 
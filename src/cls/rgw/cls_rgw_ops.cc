@@ -147,6 +147,7 @@ void rgw_cls_list_op::generate_test_instances(list<rgw_cls_list_op*>& o)
   op->start_obj = "start_obj";
   op->num_entries = 100;
   op->filter_prefix = "filter_prefix";
+  op->delimiter = "/";
   o.push_back(op);
   o.push_back(new rgw_cls_list_op);
 }
@@ -155,6 +156,8 @@ void rgw_cls_list_op::dump(Formatter *f) const
 {
   f->dump_string("start_obj", start_obj);
   f->dump_unsigned("num_entries", num_entries);
+  f->dump_string("filter_prefix", filter_prefix);
+  f->dump_string("delimiter", delimiter);
 }
 
 void rgw_cls_list_ret::generate_test_instances(list<rgw_cls_list_ret*>& o)
@@ -183,6 +186,12 @@ void rgw_cls_list_ret::dump(Formatter *f) const
   dir.dump(f);
   f->close_section();
   f->dump_int("is_truncated", (int)is_truncated);
+  f->open_array_section("common_prefixes");
+  for (list<string>::const_iterator iter = common_prefixes.begin();
+       iter != common_prefixes.end(); ++iter) {
+    f->dump_string("prefix", *iter);
+  }
+  f->close_section();
 }
 
 void cls_rgw_bi_log_list_op::dump(Formatter *f) const
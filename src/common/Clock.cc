@@ -16,7 +16,10 @@
 #include "common/Clock.h"
 #include "common/ceph_context.h"
 #include "common/config.h"
+#include "common/simple_spin.h"
 #include "include/utime.h"
+#include "arch/probe.h"
+#include "arch/intel.h"
 
 #include <time.h>
 
@@ -37,3 +40,100 @@ time_t ceph_clock_gettime(CephContext *cct)
     ret += ((time_t)cct->_conf->clock_offset);
   return ret;
 }
+
+#if defined(__i386__) || defined(__x86_64__)
+#define CEPH_HAVE_RDTSC
+
+static inline uint64_t rdtsc(void)
+{
+  uint32_t lo, hi;
+  __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * Calibration state for the coarse clock.  Readers take no lock: they
+ * snapshot the fields bracketed by the sequence counter and retry
+ * through the syscall path if a recalibration raced with them.
+ */
+#define TSC_MULT_SHIFT 20
+#define NSEC_PER_SEC 1000000000ull
+
+static simple_spinlock_t tsc_lock = SIMPLE_SPINLOCK_INITIALIZER;
+// odd while a recalibration is in flight.  Plain volatile reads are
+// enough on x86 (the only arch with this path): loads are not
+// reordered against loads, and writers serialize on tsc_lock.
+static volatile unsigned tsc_seq = 0;
+static int tsc_usable = 0;           // invariant TSC detected
+static int tsc_probed = 0;
+static uint64_t tsc_base = 0;        // tsc at last calibration
+static uint64_t tsc_base_nsec = 0;   // wall clock at last calibration
+static uint64_t tsc_mult = 0;        // nsec per cycle << TSC_MULT_SHIFT
+
+static utime_t tsc_recalibrate(CephContext *cct)
+{
+  uint64_t tsc = rdtsc();
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  uint64_t nsec = (uint64_t)tv.tv_sec * NSEC_PER_SEC + tv.tv_usec * 1000ull;
+
+  simple_spin_lock(&tsc_lock);
+  if (!tsc_probed) {
+    ceph_arch_probe();
+    tsc_usable = ceph_arch_intel_invariant_tsc;
+    tsc_probed = 1;
+  }
+  if (tsc_usable) {
+    if (tsc_base && tsc > tsc_base && nsec > tsc_base_nsec &&
+	nsec - tsc_base_nsec >= 1000000ull) {
+      // at least 1ms since the last calibration; derive the rate from
+      // the interval and rebase
+      tsc_seq++;
+      tsc_mult = ((nsec - tsc_base_nsec) << TSC_MULT_SHIFT) / (tsc - tsc_base);
+      tsc_base = tsc;
+      tsc_base_nsec = nsec;
+      tsc_seq++;
+    } else if (!tsc_base) {
+      tsc_seq++;
+      tsc_base = tsc;
+      tsc_base_nsec = nsec;
+      tsc_seq++;
+    }
+  }
+  simple_spin_unlock(&tsc_lock);
+
+  utime_t n(&tv);
+  if (cct)
+    n += cct->_conf->clock_offset;
+  return n;
+}
+#endif // rdtsc
+
+utime_t ceph_clock_now_coarse(CephContext *cct)
+{
+#ifdef CEPH_HAVE_RDTSC
+  unsigned s = tsc_seq;
+  if (tsc_usable && !(s & 1) && tsc_mult) {
+    uint64_t base = tsc_base;
+    uint64_t base_nsec = tsc_base_nsec;
+    uint64_t mult = tsc_mult;
+    if (tsc_seq == s) {
+      uint64_t d = rdtsc() - base;
+      // recalibrate once a second to bound drift; the cycle bound also
+      // keeps the multiply below from overflowing
+      if (d < (1ull << 32)) {
+	uint64_t nsec = base_nsec + ((d * mult) >> TSC_MULT_SHIFT);
+	if (nsec - base_nsec < NSEC_PER_SEC) {
+	  utime_t n(nsec / NSEC_PER_SEC, nsec % NSEC_PER_SEC);
+	  if (cct)
+	    n += cct->_conf->clock_offset;
+	  return n;
+	}
+      }
+    }
+  }
+  return tsc_recalibrate(cct);
+#else
+  return ceph_clock_now(cct);
+#endif
+}
@@ -24,4 +24,14 @@ class CephContext;
 extern utime_t ceph_clock_now(CephContext *cct);
 extern time_t ceph_clock_gettime(CephContext *cct);
 
+/*
+ * Cheap timestamps for instrumentation (op event tracking, perf
+ * counters, messenger stamps).  On hosts with an invariant TSC this
+ * scales rdtsc against gettimeofday and recalibrates about once a
+ * second, so results can be off by a few microseconds; everywhere else
+ * it falls back to ceph_clock_now().  Anything that needs monotonic or
+ * exact time must keep using ceph_clock_now().
+ */
+extern utime_t ceph_clock_now_coarse(CephContext *cct);
+
 #endif
@@ -3,6 +3,7 @@
 
 #include "common/config.h"
 #include "Finisher.h"
+#include "common/Formatter.h"
 
 #include "common/debug.h"
 #define dout_subsys ceph_subsys_finisher
@@ -23,6 +24,17 @@ void Finisher::stop()
   finisher_thread.join();
 }
 
+void Finisher::dump_queue_stats(ceph::Formatter *f)
+{
+  finisher_lock.Lock();
+  f->dump_string("type", "finisher");
+  f->dump_string("name", finisher_name);
+  f->dump_unsigned("queue_len", finisher_queue.size());
+  f->dump_unsigned("max_queue_len", max_queue_len);
+  f->dump_unsigned("total_enqueued", total_enqueued);
+  finisher_lock.Unlock();
+}
+
 void Finisher::wait_for_empty()
 {
   finisher_lock.Lock();
@@ -29,7 +29,7 @@ enum {
   l_finisher_last
 };
 
-class Finisher {
+class Finisher : public CephContext::QueueStatsProvider {
   CephContext *cct;
   Mutex          finisher_lock;
   Cond           finisher_cond, finisher_empty_cond;
@@ -37,7 +37,16 @@ class Finisher {
   vector<Context*> finisher_queue;
   list<pair<Context*,int> > finisher_queue_rval;
   PerfCounters *logger;
-  
+  string         finisher_name;
+  uint64_t       total_enqueued, max_queue_len;
+
+  void _queued(uint64_t n) {
+    // finisher_lock held
+    total_enqueued += n;
+    if (finisher_queue.size() > max_queue_len)
+      max_queue_len = finisher_queue.size();
+  }
+
   void *finisher_thread_entry();
 
   struct FinisherThread : public Thread {
@@ -54,6 +63,7 @@ class Finisher {
       finisher_queue.push_back(NULL);
     } else
       finisher_queue.push_back(c);
+    _queued(1);
     finisher_cond.Signal();
     finisher_lock.Unlock();
     if (logger)
@@ -62,6 +72,7 @@ class Finisher {
   void queue(vector<Context*>& ls) {
     finisher_lock.Lock();
     finisher_queue.insert(finisher_queue.end(), ls.begin(), ls.end());
+    _queued(ls.size());
     finisher_cond.Signal();
     finisher_lock.Unlock();
     ls.clear();
@@ -71,6 +82,7 @@ class Finisher {
   void queue(deque<Context*>& ls) {
     finisher_lock.Lock();
     finisher_queue.insert(finisher_queue.end(), ls.begin(), ls.end());
+    _queued(ls.size());
     finisher_cond.Signal();
     finisher_lock.Unlock();
     ls.clear();
@@ -83,15 +95,20 @@ class Finisher {
 
   void wait_for_empty();
 
+  void dump_queue_stats(ceph::Formatter *f);
+
   Finisher(CephContext *cct_) :
     cct(cct_), finisher_lock("Finisher::finisher_lock"),
     finisher_stop(false), finisher_running(false),
     logger(0),
+    total_enqueued(0), max_queue_len(0),
     finisher_thread(this) {}
   Finisher(CephContext *cct_, string name) :
     cct(cct_), finisher_lock("Finisher::finisher_lock"),
     finisher_stop(false), finisher_running(false),
     logger(0),
+    finisher_name(name),
+    total_enqueued(0), max_queue_len(0),
     finisher_thread(this) {
     PerfCountersBuilder b(cct, string("finisher-") + name,
 			  l_finisher_first, l_finisher_last);
@@ -99,6 +116,7 @@ class Finisher {
     logger = b.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
     logger->set(l_finisher_queue_len, 0);
+    cct->register_queue_stats(this);
   }
 
   ~Finisher() {
@@ -106,6 +124,8 @@ class Finisher {
       cct->get_perfcounters_collection()->remove(logger);
       delete logger;
     }
+    if (finisher_name.length() && cct)
+      cct->unregister_queue_stats(this);
   }
 };
 
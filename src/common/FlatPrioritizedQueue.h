@@ -0,0 +1,526 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2004-2006 Sage Weil <sage@newdream.net>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef FLAT_PRIORITY_QUEUE_H
+#define FLAT_PRIORITY_QUEUE_H
+
+#include "common/Formatter.h"
+#include "include/assert.h"
+
+#include <map>
+#include <utility>
+#include <list>
+
+/**
+ * A drop-in replacement for PrioritizedQueue with cheaper bookkeeping.
+ *
+ * Scheduling behaves like PrioritizedQueue: strict-priority items are
+ * serviced first (highest priority wins); among normal priorities we
+ * pick the lowest priority subqueue whose token bucket covers its front
+ * item, else the highest priority subqueue, and each subqueue earns
+ * cost * (priority/total_priority) tokens per dequeued item.  Within a
+ * priority, clients (keys of type K) are serviced round robin.
+ *
+ * The differences are representational:
+ *
+ *  - subqueues live in flat arrays indexed by priority (0..255, the
+ *    CEPH_MSG_PRIO range) with a bitmap of active priorities, so there
+ *    are no map lookups on the enqueue/dequeue fast paths;
+ *
+ *  - the clients of a subqueue are threaded on an intrusive circular
+ *    ring for round robin, rather than walking a std::map;
+ *
+ *  - token distribution is lazy: instead of crediting every subqueue on
+ *    every dequeue, we keep a cumulative (cost, ops) clock and bring a
+ *    subqueue up to date only when the scan actually visits it.
+ */
+template <typename T, typename K>
+class FlatPrioritizedQueue {
+  static const unsigned MAX_PRIO = 256;
+  static const unsigned BITMAP_WORDS = MAX_PRIO / 64;
+
+  int64_t total_priority;
+  int64_t max_tokens_per_subqueue;
+  int64_t min_cost;
+
+  // cumulative dequeue clock, for lazy token distribution
+  uint64_t cum_cost;
+  uint64_t cum_ops;
+
+  unsigned char reserved_shares[MAX_PRIO];  // min percent of cost, 0 = none
+
+  static void bit_set(uint64_t *bm, unsigned b) {
+    bm[b >> 6] |= (uint64_t)1 << (b & 63);
+  }
+  static void bit_clear(uint64_t *bm, unsigned b) {
+    bm[b >> 6] &= ~((uint64_t)1 << (b & 63));
+  }
+  static int bit_highest(const uint64_t *bm) {
+    for (int w = BITMAP_WORDS - 1; w >= 0; w--) {
+      if (bm[w])
+	return (w << 6) + 63 - __builtin_clzll(bm[w]);
+    }
+    return -1;
+  }
+  /// lowest set bit at or above from, or -1
+  static int bit_next(const uint64_t *bm, unsigned from) {
+    if (from >= MAX_PRIO)
+      return -1;
+    unsigned w = from >> 6;
+    uint64_t cur = bm[w] & (~(uint64_t)0 << (from & 63));
+    while (true) {
+      if (cur)
+	return (w << 6) + __builtin_ctzll(cur);
+      if (++w >= BITMAP_WORDS)
+	return -1;
+      cur = bm[w];
+    }
+  }
+
+  template <class F>
+  static unsigned filter_list_pairs(
+    list<pair<unsigned, T> > *l, F f,
+    list<T> *out) {
+    unsigned ret = 0;
+    if (out) {
+      for (typename list<pair<unsigned, T> >::reverse_iterator i = l->rbegin();
+	   i != l->rend();
+	   ++i) {
+	if (f(i->second)) {
+	  out->push_front(i->second);
+	}
+      }
+    }
+    for (typename list<pair<unsigned, T> >::iterator i = l->begin();
+	 i != l->end();
+      ) {
+      if (f(i->second)) {
+	l->erase(i++);
+	++ret;
+      } else {
+	++i;
+      }
+    }
+    return ret;
+  }
+
+  struct SubQueue {
+  private:
+    struct ClientQueue {
+      K key;
+      list<pair<unsigned, T> > items;
+      ClientQueue *ring_next, *ring_prev;  // ring of clients with items
+      ClientQueue() : ring_next(NULL), ring_prev(NULL) {}
+    };
+
+    map<K, ClientQueue> clients;
+    ClientQueue *cur;          ///< next client to service
+    unsigned tokens, max_tokens;
+    int64_t size;
+    uint64_t cost_snapshot;    ///< cum_cost when tokens were last updated
+    uint64_t ops_snapshot;     ///< cum_ops when tokens were last updated
+
+    void ring_insert(ClientQueue *cq) {
+      if (!cur) {
+	cq->ring_next = cq->ring_prev = cq;
+	cur = cq;
+      } else {
+	// insert at the tail, i.e. just before cur
+	cq->ring_next = cur;
+	cq->ring_prev = cur->ring_prev;
+	cur->ring_prev->ring_next = cq;
+	cur->ring_prev = cq;
+      }
+    }
+    void ring_remove(ClientQueue *cq) {
+      if (cq->ring_next == cq) {
+	cur = NULL;
+      } else {
+	cq->ring_prev->ring_next = cq->ring_next;
+	cq->ring_next->ring_prev = cq->ring_prev;
+	if (cur == cq)
+	  cur = cq->ring_next;
+      }
+      cq->ring_next = cq->ring_prev = NULL;
+    }
+    ClientQueue *get_client(K cl) {
+      ClientQueue *cq = &clients[cl];
+      cq->key = cl;
+      return cq;
+    }
+
+  public:
+    SubQueue()
+      : cur(NULL),
+	tokens(0),
+	max_tokens(0),
+	size(0),
+	cost_snapshot(0),
+	ops_snapshot(0) {}
+    void set_max_tokens(unsigned mt) {
+      max_tokens = mt;
+    }
+    unsigned num_tokens() const {
+      return tokens;
+    }
+    void put_tokens(unsigned t) {
+      tokens += t;
+      if (tokens > max_tokens)
+	tokens = max_tokens;
+    }
+    void take_tokens(unsigned t) {
+      if (tokens > t)
+	tokens -= t;
+      else
+	tokens = 0;
+    }
+    /// credit the tokens earned since the last time we looked
+    void refresh_tokens(unsigned priority, uint64_t cc, uint64_t co,
+			int64_t total_priority, unsigned reserved_pct) {
+      uint64_t cost_delta = cc - cost_snapshot;
+      uint64_t ops_delta = co - ops_snapshot;
+      cost_snapshot = cc;
+      ops_snapshot = co;
+      if (!ops_delta || !total_priority)
+	return;
+      uint64_t share = (priority * cost_delta) / total_priority;
+      uint64_t floor = (cost_delta * reserved_pct) / 100;
+      if (share < floor)
+	share = floor;
+      put_tokens(share + ops_delta);
+    }
+    void enqueue(K cl, unsigned cost, T item) {
+      ClientQueue *cq = get_client(cl);
+      if (cq->items.empty())
+	ring_insert(cq);
+      cq->items.push_back(make_pair(cost, item));
+      size++;
+    }
+    void enqueue_front(K cl, unsigned cost, T item) {
+      ClientQueue *cq = get_client(cl);
+      if (cq->items.empty())
+	ring_insert(cq);
+      cq->items.push_front(make_pair(cost, item));
+      cur = cq;  // service the requeued item next
+      size++;
+    }
+    pair<unsigned, T> front() const {
+      assert(cur);
+      return cur->items.front();
+    }
+    void pop_front() {
+      assert(cur);
+      ClientQueue *cq = cur;
+      cq->items.pop_front();
+      size--;
+      if (cq->items.empty()) {
+	ring_remove(cq);
+	clients.erase(cq->key);
+      } else {
+	cur = cq->ring_next;  // round robin to the next client
+      }
+    }
+    unsigned length() const {
+      assert(size >= 0);
+      return (unsigned)size;
+    }
+    bool empty() const {
+      return size == 0;
+    }
+    template <class F>
+    void remove_by_filter(F f, list<T> *out) {
+      for (typename map<K, ClientQueue>::iterator i = clients.begin();
+	   i != clients.end();
+	   ) {
+	ClientQueue *cq = &i->second;
+	bool was_queued = !cq->items.empty();
+	size -= filter_list_pairs(&cq->items, f, out);
+	if (cq->items.empty()) {
+	  if (was_queued)
+	    ring_remove(cq);
+	  clients.erase(i++);
+	} else {
+	  ++i;
+	}
+      }
+    }
+    void remove_by_class(K k, list<T> *out) {
+      typename map<K, ClientQueue>::iterator i = clients.find(k);
+      if (i == clients.end())
+	return;
+      ClientQueue *cq = &i->second;
+      size -= cq->items.size();
+      if (out) {
+	for (typename list<pair<unsigned, T> >::reverse_iterator j =
+	       cq->items.rbegin();
+	     j != cq->items.rend();
+	     ++j) {
+	  out->push_front(j->second);
+	}
+      }
+      if (!cq->items.empty())
+	ring_remove(cq);
+      clients.erase(i);
+    }
+
+    void dump(Formatter *f) const {
+      f->dump_int("tokens", tokens);
+      f->dump_int("max_tokens", max_tokens);
+      f->dump_int("size", size);
+      f->dump_int("num_keys", clients.size());
+      if (!empty())
+	f->dump_int("first_item_cost", front().first);
+    }
+  };
+
+  SubQueue *queue[MAX_PRIO];
+  SubQueue *high_queue[MAX_PRIO];
+  uint64_t queue_bitmap[BITMAP_WORDS];
+  uint64_t high_bitmap[BITMAP_WORDS];
+
+  SubQueue *create_queue(unsigned priority) {
+    assert(priority < MAX_PRIO);
+    if (!queue[priority]) {
+      queue[priority] = new SubQueue;
+      queue[priority]->set_max_tokens(max_tokens_per_subqueue);
+    }
+    SubQueue *sq = queue[priority];
+    if (sq->empty()) {
+      bit_set(queue_bitmap, priority);
+      total_priority += priority;
+      // don't bill the subqueue for the time it was idle
+      sq->refresh_tokens(priority, cum_cost, cum_ops, 0, 0);
+    }
+    return sq;
+  }
+
+  void deactivate_queue(unsigned priority) {
+    bit_clear(queue_bitmap, priority);
+    total_priority -= priority;
+    assert(total_priority >= 0);
+  }
+
+  SubQueue *create_high_queue(unsigned priority) {
+    assert(priority < MAX_PRIO);
+    if (!high_queue[priority]) {
+      high_queue[priority] = new SubQueue;
+      high_queue[priority]->set_max_tokens(max_tokens_per_subqueue);
+    }
+    bit_set(high_bitmap, priority);
+    return high_queue[priority];
+  }
+
+public:
+  FlatPrioritizedQueue(unsigned max_per, unsigned min_c)
+    : total_priority(0),
+      max_tokens_per_subqueue(max_per),
+      min_cost(min_c),
+      cum_cost(0),
+      cum_ops(0)
+  {
+    for (unsigned i = 0; i < MAX_PRIO; i++) {
+      queue[i] = NULL;
+      high_queue[i] = NULL;
+      reserved_shares[i] = 0;
+    }
+    for (unsigned i = 0; i < BITMAP_WORDS; i++) {
+      queue_bitmap[i] = 0;
+      high_bitmap[i] = 0;
+    }
+  }
+  ~FlatPrioritizedQueue() {
+    for (unsigned i = 0; i < MAX_PRIO; i++) {
+      delete queue[i];
+      delete high_queue[i];
+    }
+  }
+
+  /**
+   * reserve a minimum share of distributed tokens for a priority
+   *
+   * Whenever tokens are distributed, the subqueue at @p priority
+   * receives at least @p percent percent of the cost, regardless of
+   * how many other priorities are competing.  A percent of 0 removes
+   * the reservation.
+   */
+  void set_reservation(unsigned priority, unsigned percent) {
+    assert(priority < MAX_PRIO);
+    reserved_shares[priority] = percent < 100 ? percent : 100;
+  }
+
+  unsigned length() const {
+    unsigned total = 0;
+    for (int i = bit_next(queue_bitmap, 0); i >= 0;
+	 i = bit_next(queue_bitmap, i + 1)) {
+      assert(queue[i]->length());
+      total += queue[i]->length();
+    }
+    for (int i = bit_next(high_bitmap, 0); i >= 0;
+	 i = bit_next(high_bitmap, i + 1)) {
+      assert(high_queue[i]->length());
+      total += high_queue[i]->length();
+    }
+    return total;
+  }
+
+  template <class F>
+  void remove_by_filter(F f, list<T> *removed = 0) {
+    for (int i = bit_next(queue_bitmap, 0); i >= 0;
+	 i = bit_next(queue_bitmap, i + 1)) {
+      queue[i]->remove_by_filter(f, removed);
+      if (queue[i]->empty())
+	deactivate_queue(i);
+    }
+    for (int i = bit_next(high_bitmap, 0); i >= 0;
+	 i = bit_next(high_bitmap, i + 1)) {
+      high_queue[i]->remove_by_filter(f, removed);
+      if (high_queue[i]->empty())
+	bit_clear(high_bitmap, i);
+    }
+  }
+
+  void remove_by_class(K k, list<T> *out = 0) {
+    for (int i = bit_next(queue_bitmap, 0); i >= 0;
+	 i = bit_next(queue_bitmap, i + 1)) {
+      queue[i]->remove_by_class(k, out);
+      if (queue[i]->empty())
+	deactivate_queue(i);
+    }
+    for (int i = bit_next(high_bitmap, 0); i >= 0;
+	 i = bit_next(high_bitmap, i + 1)) {
+      high_queue[i]->remove_by_class(k, out);
+      if (high_queue[i]->empty())
+	bit_clear(high_bitmap, i);
+    }
+  }
+
+  void enqueue_strict(K cl, unsigned priority, T item) {
+    create_high_queue(priority)->enqueue(cl, 0, item);
+  }
+
+  void enqueue_strict_front(K cl, unsigned priority, T item) {
+    create_high_queue(priority)->enqueue_front(cl, 0, item);
+  }
+
+  void enqueue(K cl, unsigned priority, unsigned cost, T item) {
+    if (cost < min_cost)
+      cost = min_cost;
+    if (cost > max_tokens_per_subqueue)
+      cost = max_tokens_per_subqueue;
+    create_queue(priority)->enqueue(cl, cost, item);
+  }
+
+  void enqueue_front(K cl, unsigned priority, unsigned cost, T item) {
+    if (cost < min_cost)
+      cost = min_cost;
+    if (cost > max_tokens_per_subqueue)
+      cost = max_tokens_per_subqueue;
+    create_queue(priority)->enqueue_front(cl, cost, item);
+  }
+
+  bool empty() const {
+    assert(total_priority >= 0);
+    for (unsigned i = 0; i < BITMAP_WORDS; i++) {
+      if (queue_bitmap[i] || high_bitmap[i])
+	return false;
+    }
+    return true;
+  }
+
+  T dequeue() {
+    assert(!empty());
+
+    int h = bit_highest(high_bitmap);
+    if (h >= 0) {
+      SubQueue *sq = high_queue[h];
+      T ret = sq->front().second;
+      sq->pop_front();
+      if (sq->empty())
+	bit_clear(high_bitmap, h);
+      return ret;
+    }
+
+    // if there are multiple subqueues with sufficient tokens, we
+    // behave like a strict priority queue among all subqueues that are
+    // eligible to run.
+    for (int i = bit_next(queue_bitmap, 0); i >= 0;
+	 i = bit_next(queue_bitmap, i + 1)) {
+      SubQueue *sq = queue[i];
+      assert(!sq->empty());
+      sq->refresh_tokens(i, cum_cost, cum_ops, total_priority,
+			 reserved_shares[i]);
+      if (sq->front().first < sq->num_tokens()) {
+	T ret = sq->front().second;
+	unsigned cost = sq->front().first;
+	sq->take_tokens(cost);
+	sq->pop_front();
+	if (sq->empty())
+	  deactivate_queue(i);
+	cum_cost += cost;
+	cum_ops++;
+	return ret;
+      }
+    }
+
+    // if no subqueues have sufficient tokens, we behave like a strict
+    // priority queue.
+    int i = bit_highest(queue_bitmap);
+    assert(i >= 0);
+    SubQueue *sq = queue[i];
+    T ret = sq->front().second;
+    unsigned cost = sq->front().first;
+    sq->pop_front();
+    if (sq->empty())
+      deactivate_queue(i);
+    cum_cost += cost;
+    cum_ops++;
+    return ret;
+  }
+
+  void dump(Formatter *f) const {
+    f->dump_int("total_priority", total_priority);
+    f->dump_int("max_tokens_per_subqueue", max_tokens_per_subqueue);
+    f->dump_int("min_cost", min_cost);
+    f->open_array_section("reservations");
+    for (unsigned i = 0; i < MAX_PRIO; i++) {
+      if (reserved_shares[i]) {
+	f->open_object_section("reservation");
+	f->dump_int("priority", i);
+	f->dump_int("percent", reserved_shares[i]);
+	f->close_section();
+      }
+    }
+    f->close_section();
+    f->open_array_section("high_queues");
+    for (int i = bit_next(high_bitmap, 0); i >= 0;
+	 i = bit_next(high_bitmap, i + 1)) {
+      f->open_object_section("subqueue");
+      f->dump_int("priority", i);
+      high_queue[i]->dump(f);
+      f->close_section();
+    }
+    f->close_section();
+    f->open_array_section("queues");
+    for (int i = bit_next(queue_bitmap, 0); i >= 0;
+	 i = bit_next(queue_bitmap, i + 1)) {
+      f->open_object_section("subqueue");
+      f->dump_int("priority", i);
+      queue[i]->dump(f);
+      f->close_section();
+    }
+    f->close_section();
+  }
+};
+
+#endif
@@ -25,6 +25,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 
 // -----------------------
@@ -80,6 +81,97 @@ new_formatter(const std::string &type)
     else
       return (Formatter *)NULL;
 }
+
+Formatter *
+new_stream_formatter(const std::string &type)
+{
+    std::string mytype = type;
+    if (mytype == "")
+      mytype = "json-pretty";
+
+    if (mytype == "json")
+      return new JSONStreamFormatter(false);
+    else if (mytype == "json-pretty")
+      return new JSONStreamFormatter(true);
+    else if (mytype == "xml")
+      return new XMLStreamFormatter(false);
+    else if (mytype == "xml-pretty")
+      return new XMLStreamFormatter(true);
+    else
+      return (Formatter *)NULL;
+}
+
+// -----------------------
+BufferlistStreambuf::BufferlistStreambuf(unsigned chunk_size)
+  : m_chunk_size(chunk_size), m_handler(NULL)
+{
+}
+
+/*
+ * Trim the chunk being filled to its used length and move it onto the
+ * sealed list.  The put area is left empty; the next write allocates a
+ * fresh chunk via overflow().
+ */
+void BufferlistStreambuf::seal()
+{
+  unsigned used = pptr() - pbase();
+  if (used) {
+    m_ptr.set_length(used);
+    m_bl.push_back(m_ptr);
+    m_ptr = bufferptr();
+  }
+  setp(0, 0);
+}
+
+int BufferlistStreambuf::overflow(int c)
+{
+  seal();
+  if (m_handler && m_bl.length())
+    m_handler->handle_flush(m_bl);
+  m_ptr = bufferptr(buffer::create(m_chunk_size));
+  setp(m_ptr.c_str(), m_ptr.c_str() + m_ptr.length());
+  if (c != EOF) {
+    *pptr() = (char)c;
+    pbump(1);
+  }
+  return 0;
+}
+
+std::streamsize BufferlistStreambuf::xsputn(const char *s, std::streamsize n)
+{
+  std::streamsize left = n;
+  while (left) {
+    if (pptr() == epptr())
+      overflow(EOF);
+    std::streamsize l = epptr() - pptr();
+    if (l > left)
+      l = left;
+    memcpy(pptr(), s, l);
+    pbump(l);
+    s += l;
+    left -= l;
+  }
+  return n;
+}
+
+void BufferlistStreambuf::claim(bufferlist& out)
+{
+  seal();
+  out.claim_append(m_bl);
+}
+
+unsigned BufferlistStreambuf::length() const
+{
+  return m_bl.length() + (pptr() - pbase());
+}
+
+void BufferlistStreambuf::clear()
+{
+  m_ptr = bufferptr();
+  m_bl.clear();
+  setp(0, 0);
+}
+
 // -----------------------
 JSONFormatter::JSONFormatter(bool p)
   : m_pretty(p), m_is_pending_string(false)
@@ -108,19 +200,19 @@ void JSONFormatter::print_comma(json_formatter_stack_entry_d& entry)
 {
   if (entry.size) {
     if (m_pretty) {
-      m_ss << ",\n";
+      os() << ",\n";
       for (unsigned i=1; i < m_stack.size(); i++)
-	m_ss << "    ";
+	os() << "    ";
     } else {
-      m_ss << ",";
+      os() << ",";
     }
   } else if (entry.is_array && m_pretty) {
-    m_ss << "\n";
+    os() << "\n";
     for (unsigned i=1; i < m_stack.size(); i++)
-      m_ss << "    ";
+      os() << "    ";
   }
   if (m_pretty && entry.is_array)
-    m_ss << "    ";
+    os() << "    ";
 }
 
 void JSONFormatter::print_quoted_string(const char *s)
@@ -128,7 +220,7 @@ void JSONFormatter::print_quoted_string(const char *s)
   int len = escape_json_attr_len(s);
   char *escaped = new char[len];
   escape_json_attr(s, escaped);
-  m_ss << '\"' << escaped << '\"';
+  os() << '\"' << escaped << '\"';
   delete[] escaped;
 }
 
@@ -142,15 +234,15 @@ void JSONFormatter::print_name(const char *name)
   if (!entry.is_array) {
     if (m_pretty) {
       if (entry.size)
-	m_ss << "  ";
+	os() << "  ";
       else
-	m_ss << " ";
+	os() << " ";
     }
-    m_ss << "\"" << name << "\"";
+    os() << "\"" << name << "\"";
     if (m_pretty)
-      m_ss << ": ";
+      os() << ": ";
     else
-      m_ss << ':';
+      os() << ':';
   }
   ++entry.size;
 }
@@ -159,9 +251,9 @@ void JSONFormatter::open_section(const char *name, bool is_array)
 {
   print_name(name);
   if (is_array)
-    m_ss << '[';
+    os() << '[';
   else
-    m_ss << '{';
+    os() << '{';
 
   json_formatter_stack_entry_d n;
   n.is_array = is_array;
@@ -198,7 +290,7 @@ void JSONFormatter::close_section()
   finish_pending_string();
 
   struct json_formatter_stack_entry_d& entry = m_stack.back();
-  m_ss << (entry.is_array ? ']' : '}');
+  os() << (entry.is_array ? ']' : '}');
   m_stack.pop_back();
 }
 
@@ -214,13 +306,13 @@ void JSONFormatter::finish_pending_string()
 void JSONFormatter::dump_unsigned(const char *name, uint64_t u)
 {
   print_name(name);
-  m_ss << u;
+  os() << u;
 }
 
 void JSONFormatter::dump_int(const char *name, int64_t s)
 {
   print_name(name);
-  m_ss << s;
+  os() << s;
 }
 
 void JSONFormatter::dump_float(const char *name, double d)
@@ -264,7 +356,7 @@ void JSONFormatter::dump_format_unquoted(const char *name, const char *fmt, ...)
   va_end(ap);
 
   print_name(name);
-  m_ss << buf;
+  os() << buf;
 }
 
 int JSONFormatter::get_len() const
@@ -274,7 +366,40 @@ int JSONFormatter::get_len() const
 
 void JSONFormatter::write_raw_data(const char *data)
 {
-  m_ss << data;
+  os() << data;
+}
+
+// -----------------------
+JSONStreamFormatter::JSONStreamFormatter(bool pretty, unsigned chunk_size)
+  : JSONFormatter(pretty), m_buf(chunk_size), m_out(&m_buf)
+{
+}
+
+void JSONStreamFormatter::flush(std::ostream& os)
+{
+  finish_pending_string();
+  m_out.flush();
+  bufferlist bl;
+  m_buf.claim(bl);
+  bl.write_stream(os);
+}
+
+void JSONStreamFormatter::flush(bufferlist &bl)
+{
+  finish_pending_string();
+  m_out.flush();
+  m_buf.claim(bl);
+}
+
+void JSONStreamFormatter::reset()
+{
+  JSONFormatter::reset();
+  m_buf.clear();
+}
+
+int JSONStreamFormatter::get_len() const
+{
+  return m_buf.length();
 }
 
 const char *XMLFormatter::XML_1_DTD = 
@@ -342,45 +467,45 @@ void XMLFormatter::close_section()
   std::string section = m_sections.back();
   m_sections.pop_back();
   print_spaces();
-  m_ss << "</" << section << ">";
+  os() << "</" << section << ">";
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
 }
 
 void XMLFormatter::dump_unsigned(const char *name, uint64_t u)
 {
   std::string e(name);
   print_spaces();
-  m_ss << "<" << e << ">" << u << "</" << e << ">";
+  os() << "<" << e << ">" << u << "</" << e << ">";
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
 }
 
 void XMLFormatter::dump_int(const char *name, int64_t u)
 {
   std::string e(name);
   print_spaces();
-  m_ss << "<" << e << ">" << u << "</" << e << ">";
+  os() << "<" << e << ">" << u << "</" << e << ">";
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
 }
 
 void XMLFormatter::dump_float(const char *name, double d)
 {
   std::string e(name);
   print_spaces();
-  m_ss << "<" << e << ">" << d << "</" << e << ">";
+  os() << "<" << e << ">" << d << "</" << e << ">";
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
 }
 
 void XMLFormatter::dump_string(const char *name, std::string s)
 {
   std::string e(name);
   print_spaces();
-  m_ss << "<" << e << ">" << escape_xml_str(s.c_str()) << "</" << e << ">";
+  os() << "<" << e << ">" << escape_xml_str(s.c_str()) << "</" << e << ">";
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
 }
 
 void XMLFormatter::dump_string_with_attrs(const char *name, std::string s, const FormatterAttrs& attrs)
@@ -389,16 +514,16 @@ void XMLFormatter::dump_string_with_attrs(const char *name, std::string s, const
   std::string attrs_str;
   get_attrs_str(&attrs, attrs_str);
   print_spaces();
-  m_ss << "<" << e << attrs_str << ">" << escape_xml_str(s.c_str()) << "</" << e << ">";
+  os() << "<" << e << attrs_str << ">" << escape_xml_str(s.c_str()) << "</" << e << ">";
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
 }
 
 std::ostream& XMLFormatter::dump_stream(const char *name)
 {
   print_spaces();
   m_pending_string_name = name;
-  m_ss << "<" << m_pending_string_name << ">";
+  os() << "<" << m_pending_string_name << ">";
   return m_pending_string;
 }
 
@@ -412,9 +537,9 @@ void XMLFormatter::dump_format(const char *name, const char *fmt, ...)
 
   std::string e(name);
   print_spaces();
-  m_ss << "<" << e << ">" << escape_xml_str(buf) << "</" << e << ">";
+  os() << "<" << e << ">" << escape_xml_str(buf) << "</" << e << ">";
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
 }
 
 void XMLFormatter::dump_format_unquoted(const char *name, const char *fmt, ...)
@@ -427,9 +552,9 @@ void XMLFormatter::dump_format_unquoted(const char *name, const char *fmt, ...)
 
   std::string e(name);
   print_spaces();
-  m_ss << "<" << e << ">" << buf << "</" << e << ">";
+  os() << "<" << e << ">" << buf << "</" << e << ">";
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
 }
 
 int XMLFormatter::get_len() const
@@ -439,7 +564,7 @@ int XMLFormatter::get_len() const
 
 void XMLFormatter::write_raw_data(const char *data)
 {
-  m_ss << data;
+  os() << data;
 }
 
 void XMLFormatter::get_attrs_str(const FormatterAttrs *attrs, std::string& attrs_str)
@@ -465,25 +590,25 @@ void XMLFormatter::open_section_in_ns(const char *name, const char *ns, const Fo
   }
 
   if (ns) {
-    m_ss << "<" << name << attrs_str << " xmlns=\"" << ns << "\">";
+    os() << "<" << name << attrs_str << " xmlns=\"" << ns << "\">";
   }
   else {
-    m_ss << "<" << name << attrs_str << ">";
+    os() << "<" << name << attrs_str << ">";
   }
   if (m_pretty)
-    m_ss << "\n";
+    os() << "\n";
   m_sections.push_back(name);
 }
 
 void XMLFormatter::finish_pending_string()
 {
   if (!m_pending_string_name.empty()) {
-    m_ss << escape_xml_str(m_pending_string.str().c_str())
+    os() << escape_xml_str(m_pending_string.str().c_str())
          << "</" << m_pending_string_name << ">";
     m_pending_string_name.clear();
     m_pending_string.str(std::string());
     if (m_pretty) {
-      m_ss << "\n";
+      os() << "\n";
     }
   }
 }
@@ -493,7 +618,7 @@ void XMLFormatter::print_spaces()
   finish_pending_string();
   if (m_pretty) {
     std::string spaces(m_sections.size(), ' ');
-    m_ss << spaces;
+    os() << spaces;
   }
 }
 
@@ -505,4 +630,37 @@ std::string XMLFormatter::escape_xml_str(const char *str)
   return std::string(&escaped[0]);
 }
 
+// -----------------------
+XMLStreamFormatter::XMLStreamFormatter(bool pretty, unsigned chunk_size)
+  : XMLFormatter(pretty), m_buf(chunk_size), m_out(&m_buf)
+{
+}
+
+void XMLStreamFormatter::flush(std::ostream& os)
+{
+  finish_pending_string();
+  m_out.flush();
+  bufferlist bl;
+  m_buf.claim(bl);
+  bl.write_stream(os);
+}
+
+void XMLStreamFormatter::flush(bufferlist &bl)
+{
+  finish_pending_string();
+  m_out.flush();
+  m_buf.claim(bl);
+}
+
+void XMLStreamFormatter::reset()
+{
+  XMLFormatter::reset();
+  m_buf.clear();
+}
+
+int XMLStreamFormatter::get_len() const
+{
+  return m_buf.length();
+}
+
 }
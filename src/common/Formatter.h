@@ -28,7 +28,7 @@ class Formatter {
   virtual ~Formatter();
 
   virtual void flush(std::ostream& os) = 0;
-  void flush(bufferlist &bl) {
+  virtual void flush(bufferlist &bl) {
     std::stringstream os;
     flush(os);
     bl.append(os.str());
@@ -66,6 +66,45 @@ class Formatter {
 };
 
 Formatter *new_formatter(const std::string &type);
+Formatter *new_stream_formatter(const std::string &type);
+
+/*
+ * Streambuf that appends into a bufferlist in fixed-size preallocated
+ * chunks instead of growing a contiguous string.  If a flush handler is
+ * set, filled chunks are handed over as they complete, so a consumer
+ * can start transmitting a large dump while it is still being built and
+ * memory stays flat at roughly one chunk.
+ */
+class BufferlistStreambuf : public std::streambuf {
+ public:
+  struct flush_handler {
+    /// take (or copy) bl; clear it to consume the output so far
+    virtual void handle_flush(bufferlist& bl) = 0;
+    virtual ~flush_handler() {}
+  };
+
+  explicit BufferlistStreambuf(unsigned chunk_size = 65536);
+
+  void set_flush_handler(flush_handler *h) {
+    m_handler = h;
+  }
+  /// move everything accumulated so far into out
+  void claim(bufferlist& out);
+  unsigned length() const;
+  void clear();
+
+ protected:
+  int overflow(int c);
+  std::streamsize xsputn(const char *s, std::streamsize n);
+
+ private:
+  void seal();
+
+  unsigned m_chunk_size;
+  bufferlist m_bl;       ///< sealed chunks
+  bufferptr m_ptr;       ///< chunk being filled (put area points into it)
+  flush_handler *m_handler;
+};
 
 class JSONFormatter : public Formatter {
  public:
@@ -100,11 +139,45 @@ class JSONFormatter : public Formatter {
   void print_quoted_string(const char *s);
   void print_name(const char *name);
   void print_comma(json_formatter_stack_entry_d& entry);
-  void finish_pending_string();
 
   std::stringstream m_ss, m_pending_string;
   std::list<json_formatter_stack_entry_d> m_stack;
   bool m_is_pending_string;
+
+ protected:
+  /// where formatted output goes; subclasses may redirect it
+  virtual std::ostream& os() {
+    return m_ss;
+  }
+  void finish_pending_string();
+};
+
+/*
+ * JSONFormatter that builds its output in a bufferlist rather than a
+ * stringstream.  Large dumps (e.g. 'pg dump' on a big cluster) avoid
+ * the repeated reallocation and final multi-MB string copy, and with a
+ * flush handler installed the output can be streamed out incrementally.
+ */
+class JSONStreamFormatter : public JSONFormatter {
+ public:
+  JSONStreamFormatter(bool pretty = false, unsigned chunk_size = 65536);
+
+  void set_flush_handler(BufferlistStreambuf::flush_handler *h) {
+    m_buf.set_flush_handler(h);
+  }
+  void flush(std::ostream& os);
+  void flush(bufferlist &bl);
+  void reset();
+  int get_len() const;
+
+ protected:
+  std::ostream& os() {
+    return m_out;
+  }
+
+ private:
+  BufferlistStreambuf m_buf;
+  std::ostream m_out;
 };
 
 class XMLFormatter : public Formatter {
@@ -135,7 +208,6 @@ class XMLFormatter : public Formatter {
   void dump_string_with_attrs(const char *name, std::string s, const FormatterAttrs& attrs);
  private:
   void open_section_in_ns(const char *name, const char *ns, const FormatterAttrs *attrs);
-  void finish_pending_string();
   void print_spaces();
   static std::string escape_xml_str(const char *str);
   void get_attrs_str(const FormatterAttrs *attrs, std::string& attrs_str);
@@ -144,6 +216,36 @@ class XMLFormatter : public Formatter {
   std::deque<std::string> m_sections;
   bool m_pretty;
   std::string m_pending_string_name;
+
+ protected:
+  /// where formatted output goes; subclasses may redirect it
+  virtual std::ostream& os() {
+    return m_ss;
+  }
+  void finish_pending_string();
+};
+
+/// bufferlist-backed XMLFormatter; see JSONStreamFormatter
+class XMLStreamFormatter : public XMLFormatter {
+ public:
+  XMLStreamFormatter(bool pretty = false, unsigned chunk_size = 65536);
+
+  void set_flush_handler(BufferlistStreambuf::flush_handler *h) {
+    m_buf.set_flush_handler(h);
+  }
+  void flush(std::ostream& os);
+  void flush(bufferlist &bl);
+  void reset();
+  int get_len() const;
+
+ protected:
+  std::ostream& os() {
+    return m_out;
+  }
+
+ private:
+  BufferlistStreambuf m_buf;
+  std::ostream m_out;
 };
 
 }
@@ -0,0 +1,118 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "include/types.h"
+#include "MemoryBudget.h"
+#include "common/config.h"
+#include "common/Formatter.h"
+#include "debug.h"
+
+#define dout_subsys ceph_subsys_
+
+MemoryBudget::MemoryBudget(CephContext *cct_)
+  : cct(cct_),
+    lock("MemoryBudget::lock"),
+    mem(cct_)
+{
+}
+
+void MemoryBudget::register_client(MemoryBudgetClient *c)
+{
+  Mutex::Locker l(lock);
+  clients.push_back(ClientState(c));
+}
+
+void MemoryBudget::unregister_client(MemoryBudgetClient *c)
+{
+  Mutex::Locker l(lock);
+  for (list<ClientState>::iterator p = clients.begin();
+       p != clients.end();
+       ++p) {
+    if (p->client == c) {
+      clients.erase(p);
+      return;
+    }
+  }
+}
+
+void MemoryBudget::balance(uint64_t target_bytes)
+{
+  Mutex::Locker l(lock);
+  if (clients.empty() || !target_bytes)
+    return;
+
+  MemoryModel::snap s;
+  mem.sample(&s);
+  uint64_t rss = (uint64_t)s.get_rss() << 10;
+
+  uint64_t tracked = 0;
+  uint64_t total_weight = 0;
+  for (list<ClientState>::iterator p = clients.begin();
+       p != clients.end();
+       ++p) {
+    uint64_t hits, misses;
+    p->client->get_cache_stats(&p->bytes, &hits, &misses);
+    tracked += p->bytes;
+    // weight by hits since the last balance; the +1 floor keeps an
+    // idle cache from being starved to nothing by one busy neighbor
+    p->granted = hits - p->last_hits + 1;   // stash the weight here
+    p->last_hits = hits;
+    total_weight += p->granted;
+  }
+
+  // anything we can't attribute to a registered cache still counts
+  // against the budget, so untracked growth squeezes the caches
+  uint64_t untracked = rss > tracked ? rss - tracked : 0;
+  uint64_t avail = target_bytes > untracked ? target_bytes - untracked : 0;
+
+  // leave each cache a sliver even under extreme pressure so it can
+  // recover when the spike passes
+  uint64_t floor = target_bytes / (clients.size() * 64);
+  if (!floor)
+    floor = 1;
+
+  ldout(cct, 10) << "balance target " << target_bytes
+		 << " rss " << rss
+		 << " tracked " << tracked
+		 << " untracked " << untracked
+		 << " avail " << avail << dendl;
+
+  for (list<ClientState>::iterator p = clients.begin();
+       p != clients.end();
+       ++p) {
+    uint64_t share =
+      (uint64_t)((double)avail * p->granted / total_weight);
+    if (share < floor)
+      share = floor;
+    p->granted = share;
+    ldout(cct, 20) << " " << p->client->get_cache_name()
+		   << " using " << p->bytes
+		   << " granted " << share << dendl;
+    p->client->trim_cache_to(share);
+  }
+}
+
+void MemoryBudget::dump(Formatter *f)
+{
+  Mutex::Locker l(lock);
+  MemoryModel::snap s;
+  mem.sample(&s);
+  f->open_object_section("memory_budget");
+  f->dump_unsigned("rss_bytes", (uint64_t)s.get_rss() << 10);
+  f->open_array_section("caches");
+  for (list<ClientState>::iterator p = clients.begin();
+       p != clients.end();
+       ++p) {
+    uint64_t bytes, hits, misses;
+    p->client->get_cache_stats(&bytes, &hits, &misses);
+    f->open_object_section("cache");
+    f->dump_string("name", p->client->get_cache_name());
+    f->dump_unsigned("bytes", bytes);
+    f->dump_unsigned("granted_bytes", p->granted);
+    f->dump_unsigned("hits", hits);
+    f->dump_unsigned("misses", misses);
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
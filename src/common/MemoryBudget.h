@@ -0,0 +1,79 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#ifndef CEPH_MEMORYBUDGET_H
+#define CEPH_MEMORYBUDGET_H
+
+#include <list>
+#include <stdint.h>
+
+#include "common/Mutex.h"
+#include "common/MemoryModel.h"
+
+class CephContext;
+namespace ceph { class Formatter; }
+using ceph::Formatter;
+
+/**
+ * one cache's view of itself, as seen by the memory balancer
+ */
+struct MemoryBudgetClient {
+  virtual ~MemoryBudgetClient() {}
+  /// short name for logs and dumps
+  virtual const char *get_cache_name() const = 0;
+  /// current footprint estimate and cumulative hit/miss counters
+  virtual void get_cache_stats(uint64_t *bytes, uint64_t *hits,
+			       uint64_t *misses) = 0;
+  /// shrink toward the granted byte budget.  a grant above the cache's
+  /// own configured limit does not oblige it to grow.
+  virtual void trim_cache_to(uint64_t bytes) = 0;
+};
+
+/**
+ * Central memory accounting for a daemon's caches.
+ *
+ * Each cache registers a client exposing its footprint, hit/miss
+ * counters, and a trim hook.  balance() samples process memory via
+ * MemoryModel and splits the configured byte budget across the
+ * registered caches in proportion to their recent hit counts.  Memory
+ * the registry can't attribute to any cache -- in-flight messages, pg
+ * logs, allocator slop -- is charged against the budget first, so an
+ * untracked spike squeezes the caches instead of growing the process
+ * toward the oom killer.
+ */
+class MemoryBudget {
+  CephContext *cct;
+  Mutex lock;
+  MemoryModel mem;
+
+  struct ClientState {
+    MemoryBudgetClient *client;
+    uint64_t last_hits;    ///< counter value at the previous balance
+    uint64_t bytes;        ///< footprint reported by the last balance
+    uint64_t granted;      ///< bytes granted by the last balance
+    ClientState(MemoryBudgetClient *c)
+      : client(c), last_hits(0), bytes(0), granted(0) {}
+  };
+  std::list<ClientState> clients;
+
+public:
+  MemoryBudget(CephContext *cct);
+
+  void register_client(MemoryBudgetClient *c);
+  void unregister_client(MemoryBudgetClient *c);
+
+  /// redistribute target_bytes across the registered caches
+  void balance(uint64_t target_bytes);
+
+  void dump(Formatter *f);
+};
+
+#endif
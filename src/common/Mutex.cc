@@ -22,11 +22,12 @@
 
 Mutex::Mutex(const char *n, bool r, bool ld,
 	     bool bt,
-	     CephContext *cct) :
+	     CephContext *cct, bool adapt) :
   name(n), id(-1), recursive(r), lockdep(ld), backtrace(bt),
+  adaptive(adapt),
   nlock(0), locked_by(0), cct(cct), logger(0)
 {
-  if (cct) {
+  if (CEPH_MUTEX_INSTRUMENT && cct) {
     PerfCountersBuilder b(cct, string("mutex-") + name,
 			  l_mutex_first, l_mutex_last);
     b.add_time_avg(l_mutex_wait, "wait");
@@ -77,20 +78,39 @@ Mutex::~Mutex() {
 }
 
 void Mutex::Lock(bool no_lockdep) {
-  if (lockdep && g_lockdep && !no_lockdep) _will_lock();
+  if (CEPH_MUTEX_INSTRUMENT && lockdep && g_lockdep && !no_lockdep)
+    _will_lock();
 
   if (TryLock()) {
     return;
   }
 
+  ncontended.inc();
+
+  if (adaptive) {
+    // spin a bit before parking: short critical sections usually clear
+    // within a few hundred cycles, and a futex wakeup costs far more.
+    // back off exponentially so spinners don't hammer the cache line.
+    unsigned backoff = 1;
+    for (int spins = 64; spins > 0; spins--) {
+      for (unsigned i = 0; i < backoff; i++)
+	mutex_cpu_relax();
+      if (backoff < 256)
+	backoff <<= 1;
+      if (TryLock()) {
+	return;
+      }
+    }
+  }
+
   utime_t start;
-  if (logger && cct && cct->_conf->mutex_perf_counter)
+  if (CEPH_MUTEX_INSTRUMENT && logger && cct && cct->_conf->mutex_perf_counter)
     start = ceph_clock_now(cct);
   int r = pthread_mutex_lock(&_m);
-  if (logger && cct && cct->_conf->mutex_perf_counter)
+  if (CEPH_MUTEX_INSTRUMENT && logger && cct && cct->_conf->mutex_perf_counter)
     logger->tinc(l_mutex_wait,
 		 ceph_clock_now(cct) - start);
   assert(r == 0);
-  if (lockdep && g_lockdep) _locked();
+  if (CEPH_MUTEX_INSTRUMENT && lockdep && g_lockdep) _locked();
   _post_lock();
 }
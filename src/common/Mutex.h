@@ -16,6 +16,7 @@
 #define CEPH_MUTEX_H
 
 #include "include/assert.h"
+#include "include/atomic.h"
 #include "lockdep.h"
 #include "common/ceph_context.h"
 
@@ -31,6 +32,22 @@ enum {
   l_mutex_last
 };
 
+// define CEPH_MUTEX_NO_INSTRUMENT (e.g. for a release build) to compile
+// the lockdep and perf-counter hooks out of the lock/unlock paths
+// entirely instead of just branching around them
+#ifdef CEPH_MUTEX_NO_INSTRUMENT
+# define CEPH_MUTEX_INSTRUMENT 0
+#else
+# define CEPH_MUTEX_INSTRUMENT 1
+#endif
+
+static inline void mutex_cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__("pause" ::: "memory");
+#endif
+}
+
 class Mutex {
 private:
   const char *name;
@@ -38,12 +55,14 @@ private:
   bool recursive;
   bool lockdep;
   bool backtrace;  // gather backtrace on lock acquisition
+  bool adaptive;   // spin briefly before parking
 
   pthread_mutex_t _m;
   int nlock;
   pthread_t locked_by;
   CephContext *cct;
   PerfCounters *logger;
+  atomic_t ncontended;  ///< how often Lock() found the mutex held
 
   // don't allow copying.
   void operator=(Mutex &M);
@@ -64,7 +83,7 @@ private:
 
 public:
   Mutex(const char *n, bool r = false, bool ld=true, bool bt=false,
-	CephContext *cct = 0);
+	CephContext *cct = 0, bool adapt=false);
   ~Mutex();
   bool is_locked() const {
     return (nlock > 0);
@@ -76,12 +95,17 @@ public:
   bool TryLock() {
     int r = pthread_mutex_trylock(&_m);
     if (r == 0) {
-      if (lockdep && g_lockdep) _locked();
+      if (CEPH_MUTEX_INSTRUMENT && lockdep && g_lockdep) _locked();
       _post_lock();
     }
     return r == 0;
   }
 
+  /// number of times Lock() hit contention (approximate, never reset)
+  uint64_t get_num_contended() const {
+    return ncontended.read();
+  }
+
   void Lock(bool no_lockdep=false);
 
   void _post_lock() {
@@ -103,7 +127,7 @@ public:
   }
   void Unlock() {
     _pre_unlock();
-    if (lockdep && g_lockdep) _will_unlock();
+    if (CEPH_MUTEX_INSTRUMENT && lockdep && g_lockdep) _will_unlock();
     int r = pthread_mutex_unlock(&_m);
     assert(r == 0);
   }
@@ -42,12 +42,18 @@
  * Within a priority class, we schedule round robin based on the class
  * of type K used to enqueue items.  e.g. you could use entity_inst_t
  * to provide fairness for different clients.
+ *
+ * A priority may additionally carry a reservation (see
+ * set_reservation): its subqueue then receives at least the reserved
+ * percentage of each distributed cost, guaranteeing that class a
+ * bandwidth floor no matter how many other priorities are active.
  */
 template <typename T, typename K>
 class PrioritizedQueue {
   int64_t total_priority;
   int64_t max_tokens_per_subqueue;
   int64_t min_cost;
+  map<unsigned, unsigned> reserved_shares;  // priority -> min percent of cost
 
   template <class F>
   static unsigned filter_list_pairs(
@@ -221,7 +227,12 @@ class PrioritizedQueue {
     for (typename map<unsigned, SubQueue>::iterator i = queue.begin();
 	 i != queue.end();
 	 ++i) {
-      i->second.put_tokens(((i->first * cost) / total_priority) + 1);
+      unsigned share = (i->first * cost) / total_priority;
+      map<unsigned, unsigned>::const_iterator r =
+	reserved_shares.find(i->first);
+      if (r != reserved_shares.end() && share < (cost * r->second) / 100)
+	share = (cost * r->second) / 100;
+      i->second.put_tokens(share + 1);
     }
   }
 
@@ -232,6 +243,21 @@ public:
       min_cost(min_c)
   {}
 
+  /**
+   * reserve a minimum share of distributed tokens for a priority
+   *
+   * Whenever tokens are distributed, the subqueue at @p priority
+   * receives at least @p percent percent of the cost, regardless of
+   * how many other priorities are competing.  A percent of 0 removes
+   * the reservation.
+   */
+  void set_reservation(unsigned priority, unsigned percent) {
+    if (percent == 0)
+      reserved_shares.erase(priority);
+    else
+      reserved_shares[priority] = percent < 100 ? percent : 100;
+  }
+
   unsigned length() const {
     unsigned total = 0;
     for (typename map<unsigned, SubQueue>::const_iterator i = queue.begin();
@@ -376,6 +402,16 @@ public:
     f->dump_int("total_priority", total_priority);
     f->dump_int("max_tokens_per_subqueue", max_tokens_per_subqueue);
     f->dump_int("min_cost", min_cost);
+    f->open_array_section("reservations");
+    for (map<unsigned, unsigned>::const_iterator p = reserved_shares.begin();
+	 p != reserved_shares.end();
+	 ++p) {
+      f->open_object_section("reservation");
+      f->dump_int("priority", p->first);
+      f->dump_int("percent", p->second);
+      f->close_section();
+    }
+    f->close_section();
     f->open_array_section("high_queues");
     for (typename map<unsigned, SubQueue>::const_iterator p = high_queue.begin();
 	 p != high_queue.end();
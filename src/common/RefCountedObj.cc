@@ -13,6 +13,14 @@
  */
 
 #include "common/RefCountedObj.h"
+#include "common/environment.h"
+
+bool refcount_track_ops = get_env_bool("CEPH_REFCOUNT_TRACK");
+atomic_t refcount_total_ops;
+
+uint64_t refcount_get_total_ops() {
+  return refcount_total_ops.read();
+}
 
 void intrusive_ptr_add_ref(RefCountedObject *p) {
   p->get();
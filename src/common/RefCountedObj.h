@@ -15,25 +15,43 @@
 #ifndef CEPH_REFCOUNTEDOBJ_H
 #define CEPH_REFCOUNTEDOBJ_H
  
+#include <stdint.h>
+
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "include/atomic.h"
 
 
+// refcount op accounting, so hot get/put paths (Message, Connection)
+// can be audited without a profiler; enabled via the
+// CEPH_REFCOUNT_TRACK environment variable, like the buffer trackers,
+// so when off it only costs a predicted branch
+extern bool refcount_track_ops;
+extern atomic_t refcount_total_ops;
+uint64_t refcount_get_total_ops();
+
 struct RefCountedObject {
   atomic_t nref;
   RefCountedObject() : nref(1) {}
   virtual ~RefCountedObject() {}
-  
+
   RefCountedObject *get() {
     //generic_dout(0) << "RefCountedObject::get " << this << " " << nref.read() << " -> " << (nref.read() + 1) << dendl;
+    if (refcount_track_ops)
+      refcount_total_ops.inc();
     nref.inc();
     return this;
   }
   void put() {
     //generic_dout(0) << "RefCountedObject::put " << this << " " << nref.read() << " -> " << (nref.read() - 1) << dendl;
-    if (nref.dec() == 0)
+    if (refcount_track_ops)
+      refcount_total_ops.inc();
+    if (nref.dec() == 0) {
+      // dec() is only a release; acquire here so we see the other
+      // threads' final writes to the object before deleting it
+      atomic_t::read_barrier();
       delete this;
+    }
   }
 };
 
@@ -103,6 +121,7 @@ struct RefCountedWaitObject {
     RefCountedCond *cond = c;
     cond->get();
     if (nref.dec() == 0) {
+      atomic_t::read_barrier();
       cond->done();
       delete this;
       ret = true;
@@ -116,6 +135,7 @@ struct RefCountedWaitObject {
 
     cond->get();
     if (nref.dec() == 0) {
+      atomic_t::read_barrier();
       cond->done();
       delete this;
     } else {
@@ -16,6 +16,8 @@
 #include "common/code_environment.h"
 #include "common/debug.h"
 #include "common/signal.h"
+#include "common/strtol.h"
+#include "include/str_list.h"
 
 #include <dirent.h>
 #include <errno.h>
@@ -128,3 +130,43 @@ int Thread::detach()
 {
   return pthread_detach(thread_id);
 }
+
+int Thread::set_affinity(const std::string &cpu_list)
+{
+  if (!is_started())
+    return -EINVAL;
+  return ceph_pin_thread(thread_id, cpu_list);
+}
+
+int ceph_pin_thread(pthread_t thread, const std::string &cpu_list)
+{
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  std::list<std::string> ranges;
+  get_str_list(cpu_list, ",", ranges);
+  if (ranges.empty())
+    return -EINVAL;
+  for (std::list<std::string>::iterator i = ranges.begin();
+       i != ranges.end();
+       ++i) {
+    std::string err;
+    long first = 0, last = 0;
+    size_t dash = i->find('-');
+    if (dash == std::string::npos) {
+      first = last = strict_strtol(i->c_str(), 10, &err);
+    } else {
+      first = strict_strtol(i->substr(0, dash).c_str(), 10, &err);
+      if (err.empty())
+	last = strict_strtol(i->substr(dash + 1).c_str(), 10, &err);
+    }
+    if (!err.empty() || first < 0 || last < first || last >= CPU_SETSIZE)
+      return -EINVAL;
+    for (long c = first; c <= last; ++c)
+      CPU_SET(c, &cpuset);
+  }
+  return -pthread_setaffinity_np(thread, sizeof(cpuset), &cpuset);
+#else
+  return -EOPNOTSUPP;
+#endif
+}
@@ -17,6 +17,7 @@
 #define CEPH_THREAD_H
 
 #include <pthread.h>
+#include <string>
 
 class Thread {
  private:
@@ -44,6 +45,16 @@ class Thread {
   void create(size_t stacksize = 0);
   int join(void **prval = 0);
   int detach();
+  int set_affinity(const std::string &cpu_list);
 };
 
+/**
+ * Pin a thread to a set of cpus.
+ *
+ * @param thread thread to pin
+ * @param cpu_list cpus to pin to, e.g. "0-5,12-17"
+ * @return 0, -EINVAL on a malformed list, or -errno from the kernel
+ */
+int ceph_pin_thread(pthread_t thread, const std::string &cpu_list);
+
 #endif
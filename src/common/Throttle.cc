@@ -94,7 +94,10 @@ bool Throttle::_wait(int64_t c)
   if (_should_wait(c) || !cond.empty()) { // always wait behind other waiters.
     Cond *cv = new Cond;
     cond.push_back(cv);
-    do {
+    waiters.inc();
+    // recheck after advertising ourselves, so a lock-free put() that
+    // saw no waiters before we registered cannot be missed
+    while (_should_wait(c) || cv != cond.front()) {
       if (!waited) {
 	ldout(cct, 2) << "_wait waiting..." << dendl;
 	if (logger)
@@ -102,7 +105,7 @@ bool Throttle::_wait(int64_t c)
       }
       waited = true;
       cv->Wait(lock);
-    } while (_should_wait(c) || cv != cond.front());
+    }
 
     if (waited) {
       ldout(cct, 3) << "_wait finished waiting" << dendl;
@@ -114,6 +117,7 @@ bool Throttle::_wait(int64_t c)
 
     delete cv;
     cond.pop_front();
+    waiters.dec();
 
     // wake up the next guy
     if (!cond.empty())
@@ -144,10 +148,7 @@ int64_t Throttle::take(int64_t c)
   }
   assert(c >= 0);
   ldout(cct, 10) << "take " << c << dendl;
-  {
-    Mutex::Locker l(lock);
-    count.add(c);
-  }
+  count.add(c);
   if (logger) {
     logger->inc(l_throttle_take);
     logger->inc(l_throttle_take_sum, c);
@@ -164,6 +165,30 @@ bool Throttle::get(int64_t c, int64_t m)
 
   assert(c >= 0);
   ldout(cct, 10) << "get " << c << " (" << count.read() << " -> " << (count.read() + c) << ")" << dendl;
+
+  // fast path: well below the limit and nobody waiting, so we can
+  // take our share with a single cas and never touch the mutex.  the
+  // low-water threshold (3/4 of max) keeps racing getters from
+  // crowding right up against the limit without the slow path's
+  // exact accounting.
+  if (!m && waiters.read() == 0) {
+    int64_t lim = max.read();
+    int64_t fast_max = lim - (lim >> 2);
+    while (true) {
+      int64_t cur = count.read();
+      if (cur + c > fast_max)
+	break;
+      if (count.compare_and_swap(cur, cur + c)) {
+	if (logger) {
+	  logger->inc(l_throttle_get);
+	  logger->inc(l_throttle_get_sum, c);
+	  logger->set(l_throttle_val, count.read());
+	}
+	return false;
+      }
+    }
+  }
+
   bool waited = false;
   {
     Mutex::Locker l(lock);
@@ -192,6 +217,29 @@ bool Throttle::get_or_fail(int64_t c)
   }
 
   assert (c >= 0);
+
+  // same fast path as get(); near the limit we fall through so the
+  // slow path can give an exact answer
+  if (waiters.read() == 0) {
+    int64_t lim = max.read();
+    int64_t fast_max = lim - (lim >> 2);
+    while (true) {
+      int64_t cur = count.read();
+      if (cur + c > fast_max)
+	break;
+      if (count.compare_and_swap(cur, cur + c)) {
+	ldout(cct, 10) << "get_or_fail " << c << " success (" << cur << " -> " << (cur + c) << ")" << dendl;
+	if (logger) {
+	  logger->inc(l_throttle_get_or_fail_success);
+	  logger->inc(l_throttle_get);
+	  logger->inc(l_throttle_get_sum, c);
+	  logger->set(l_throttle_val, count.read());
+	}
+	return true;
+      }
+    }
+  }
+
   Mutex::Locker l(lock);
   if (_should_wait(c) || !cond.empty()) {
     ldout(cct, 10) << "get_or_fail " << c << " failed" << dendl;
@@ -220,6 +268,31 @@ int64_t Throttle::put(int64_t c)
 
   assert(c >= 0);
   ldout(cct, 10) << "put " << c << " (" << count.read() << " -> " << (count.read()-c) << ")" << dendl;
+
+  // fast path: nobody waiting, so the release is a single cas.  if a
+  // waiter registered while we were subtracting, wake it up; _wait
+  // rechecks after advertising itself, so between that and our second
+  // waiters check one side always sees the other.
+  if (c && waiters.read() == 0) {
+    while (true) {
+      int64_t cur = count.read();
+      assert(cur >= c); //if count goes negative, we failed somewhere!
+      if (count.compare_and_swap(cur, cur - c)) {
+	if (waiters.read()) {
+	  Mutex::Locker l(lock);
+	  if (!cond.empty())
+	    cond.front()->SignalOne();
+	}
+	if (logger) {
+	  logger->inc(l_throttle_put);
+	  logger->inc(l_throttle_put_sum, c);
+	  logger->set(l_throttle_val, count.read());
+	}
+	return cur - c;
+      }
+    }
+  }
+
   Mutex::Locker l(lock);
   if (c) {
     if (!cond.empty())
@@ -12,11 +12,21 @@
 class CephContext;
 class PerfCounters;
 
+/**
+ * Throttle.
+ *
+ * get()/put() take a lock-free fast path while the count stays below a
+ * low-water threshold (3/4 of max) and nobody is waiting; only near
+ * saturation do they fall back to the mutex/Cond slow path.  The
+ * per-throttle perf counters (notably the "wait" time average) show
+ * which throttle actually gates throughput.
+ */
 class Throttle {
   CephContext *cct;
   std::string name;
   PerfCounters *logger;
 	ceph::atomic_t count, max;
+  ceph::atomic_t waiters;
   Mutex lock;
   list<Cond*> cond;
   bool use_perf;
@@ -49,7 +49,8 @@ SafeTimer::SafeTimer(CephContext *cct_, Mutex &l, bool safe_callbacks)
   : cct(cct_), lock(l),
     safe_callbacks(safe_callbacks),
     thread(NULL),
-    stopping(false)
+    stopping(false),
+    wheel_tick(utime_to_tick(ceph_clock_now(cct_)))
 {
 }
 
@@ -107,30 +108,73 @@ void SafeTimer::timer_thread()
 	lock.Lock();
     }
 
+    if (!coarse_events.empty()) {
+      std::list<WheelEvent*> expired;
+      _wheel_advance(utime_to_tick(now), &expired);
+      while (!expired.empty()) {
+	WheelEvent *e = expired.front();
+	expired.pop_front();
+	Context *callback = e->callback;
+	delete e;
+	ldout(cct,10) << "timer_thread executing coarse " << callback << dendl;
+
+	if (!safe_callbacks)
+	  lock.Unlock();
+	callback->complete(0);
+	if (!safe_callbacks)
+	  lock.Lock();
+      }
+    }
+
     ldout(cct,20) << "timer_thread going to sleep" << dendl;
-    if (schedule.empty())
+    if (schedule.empty() && coarse_events.empty()) {
       cond.Wait(lock);
-    else
-      cond.WaitUntil(lock, schedule.begin()->first);
+    } else {
+      utime_t next;
+      if (!schedule.empty())
+	next = schedule.begin()->first;
+      if (!coarse_events.empty()) {
+	utime_t w = _wheel_next_wakeup();
+	if (schedule.empty() || w < next)
+	  next = w;
+      }
+      cond.WaitUntil(lock, next);
+    }
     ldout(cct,20) << "timer_thread awake" << dendl;
   }
   ldout(cct,10) << "timer_thread exiting" << dendl;
   lock.Unlock();
 }
 
-void SafeTimer::add_event_after(double seconds, Context *callback)
+void SafeTimer::add_event_after(double seconds, Context *callback, bool coarse)
 {
   assert(lock.is_locked());
 
   utime_t when = ceph_clock_now(cct);
   when += seconds;
-  add_event_at(when, callback);
+  add_event_at(when, callback, coarse);
 }
 
-void SafeTimer::add_event_at(utime_t when, Context *callback)
+void SafeTimer::add_event_at(utime_t when, Context *callback, bool coarse)
 {
   assert(lock.is_locked());
-  ldout(cct,10) << "add_event_at " << when << " -> " << callback << dendl;
+  ldout(cct,10) << "add_event_at " << when << " -> " << callback
+		<< (coarse ? " (coarse)" : "") << dendl;
+
+  if (coarse) {
+    /* If you hit this, you tried to insert the same Context* twice. */
+    assert(coarse_events.find(callback) == coarse_events.end());
+    if (coarse_events.empty()) {
+      // nothing has advanced the wheel while it was empty; catch it up
+      // so the delta below is measured against the present
+      uint64_t now_tick = utime_to_tick(ceph_clock_now(cct));
+      if (now_tick > wheel_tick)
+	wheel_tick = now_tick;
+    }
+    _wheel_insert(new WheelEvent(callback, utime_to_deadline_tick(when)));
+    cond.Signal();
+    return;
+  }
 
   scheduled_map_t::value_type s_val(when, callback);
   scheduled_map_t::iterator i = schedule.insert(s_val);
@@ -151,7 +195,18 @@ void SafeTimer::add_event_at(utime_t when, Context *callback)
 bool SafeTimer::cancel_event(Context *callback)
 {
   assert(lock.is_locked());
-  
+
+  wheel_lookup_map_t::iterator c = coarse_events.find(callback);
+  if (c != coarse_events.end()) {
+    ldout(cct,10) << "cancel_event coarse -> " << callback << dendl;
+    WheelEvent *e = *c->second.second;
+    c->second.first->erase(c->second.second);
+    coarse_events.erase(c);
+    delete e;
+    delete callback;
+    return true;
+  }
+
   std::map<Context*, std::multimap<utime_t, Context*>::iterator>::iterator p = events.find(callback);
   if (p == events.end()) {
     ldout(cct,10) << "cancel_event " << callback << " not found" << dendl;
@@ -178,6 +233,95 @@ void SafeTimer::cancel_all_events()
     schedule.erase(p->second);
     events.erase(p);
   }
+
+  while (!coarse_events.empty()) {
+    wheel_lookup_map_t::iterator c = coarse_events.begin();
+    ldout(cct,10) << " cancelled coarse " << c->first << dendl;
+    WheelEvent *e = *c->second.second;
+    c->second.first->erase(c->second.second);
+    delete e;
+    delete c->first;
+    coarse_events.erase(c);
+  }
+}
+
+void SafeTimer::_wheel_insert(WheelEvent *e)
+{
+  uint64_t t = e->tick;
+  if (t <= wheel_tick)
+    t = wheel_tick + 1;   // already due; fire on the next tick
+  uint64_t delta = t - wheel_tick;
+  wheel_slot_t *sl;
+  if (delta < (uint64_t)WHEEL_L0_SLOTS) {
+    sl = &wheel0[t & (WHEEL_L0_SLOTS - 1)];
+  } else {
+    int level = 0;
+    int shift = WHEEL_L0_BITS;
+    while (level < WHEEL_LEVELS - 2 &&
+	   delta >= 1ull << (shift + WHEEL_BITS)) {
+      shift += WHEEL_BITS;
+      level++;
+    }
+    // past the top wheel's horizon events sit in its last slot and
+    // recascade until they come into range
+    if (delta >= 1ull << (shift + WHEEL_BITS))
+      t = wheel_tick + (1ull << (shift + WHEEL_BITS)) - 1;
+    sl = &wheelN[level][(t >> shift) & (WHEEL_SLOTS - 1)];
+  }
+  sl->push_back(e);
+  wheel_slot_t::iterator it = sl->end();
+  --it;
+  coarse_events[e->callback] = std::make_pair(sl, it);
+}
+
+void SafeTimer::_wheel_cascade(int level, int slot)
+{
+  wheel_slot_t moved;
+  moved.swap(wheelN[level][slot]);
+  while (!moved.empty()) {
+    WheelEvent *e = moved.front();
+    moved.pop_front();
+    _wheel_insert(e);   // records the new location in coarse_events
+  }
+}
+
+void SafeTimer::_wheel_advance(uint64_t now_tick, std::list<WheelEvent*> *expired)
+{
+  while (wheel_tick < now_tick) {
+    ++wheel_tick;
+    int idx = wheel_tick & (WHEEL_L0_SLOTS - 1);
+    if (idx == 0) {
+      int level = 0;
+      int slot;
+      do {
+	slot = (wheel_tick >> (WHEEL_L0_BITS + level * WHEEL_BITS)) &
+	  (WHEEL_SLOTS - 1);
+	_wheel_cascade(level, slot);
+      } while (slot == 0 && ++level < WHEEL_LEVELS - 1);
+    }
+    wheel_slot_t& sl = wheel0[idx];
+    while (!sl.empty()) {
+      WheelEvent *e = sl.front();
+      sl.pop_front();
+      // drop the lookup entry now, so a cancel racing an unlocked
+      // callback can't find (and double-free) an expired event
+      coarse_events.erase(e->callback);
+      expired->push_back(e);
+    }
+  }
+}
+
+utime_t SafeTimer::_wheel_next_wakeup() const
+{
+  // scan the bottom wheel for the next occupied slot; if we reach a
+  // cascade boundary first, wake there so higher levels can spill down
+  uint64_t t = wheel_tick;
+  do {
+    t++;
+    if (!wheel0[t & (WHEEL_L0_SLOTS - 1)].empty())
+      break;
+  } while ((t & (WHEEL_L0_SLOTS - 1)) != 0);
+  return tick_to_utime(t);
 }
 
 void SafeTimer::dump(const char *caller) const
@@ -18,6 +18,7 @@
 #include "Cond.h"
 #include "Mutex.h"
 
+#include <list>
 #include <map>
 
 class CephContext;
@@ -45,6 +46,46 @@ class SafeTimer
   std::map<Context*, std::multimap<utime_t, Context*>::iterator> events;
   bool stopping;
 
+  /* Coarse events go into a hashed hierarchical timing wheel: no tree
+   * rebalancing on add/cancel, at the cost of firing up to one tick
+   * (100ms) late.  Precise events keep the sorted multimap. */
+  struct WheelEvent {
+    Context *callback;
+    uint64_t tick;   ///< absolute expiry tick
+    WheelEvent(Context *c, uint64_t t) : callback(c), tick(t) {}
+  };
+  typedef std::list<WheelEvent*> wheel_slot_t;
+  typedef std::map<Context*,
+		   std::pair<wheel_slot_t*, wheel_slot_t::iterator> > wheel_lookup_map_t;
+
+  static const uint64_t WHEEL_TICK_NSEC = 100000000ull;  ///< 100ms granularity
+  static const int WHEEL_L0_BITS = 8;
+  static const int WHEEL_L0_SLOTS = 1 << WHEEL_L0_BITS;
+  static const int WHEEL_BITS = 6;
+  static const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+  static const int WHEEL_LEVELS = 4;
+
+  wheel_slot_t wheel0[WHEEL_L0_SLOTS];
+  wheel_slot_t wheelN[WHEEL_LEVELS - 1][WHEEL_SLOTS];
+  uint64_t wheel_tick;   ///< last tick the wheel advanced to
+  wheel_lookup_map_t coarse_events;
+
+  static uint64_t utime_to_tick(utime_t t) {
+    return t.to_nsec() / WHEEL_TICK_NSEC;
+  }
+  /// deadlines round up, so coarse events never fire early
+  static uint64_t utime_to_deadline_tick(utime_t t) {
+    return (t.to_nsec() + WHEEL_TICK_NSEC - 1) / WHEEL_TICK_NSEC;
+  }
+  static utime_t tick_to_utime(uint64_t tick) {
+    uint64_t ns = tick * WHEEL_TICK_NSEC;
+    return utime_t(ns / 1000000000ull, ns % 1000000000ull);
+  }
+  void _wheel_insert(WheelEvent *e);
+  void _wheel_cascade(int level, int slot);
+  void _wheel_advance(uint64_t now_tick, std::list<WheelEvent*> *expired);
+  utime_t _wheel_next_wakeup() const;
+
   void dump(const char *caller = 0) const;
 
 public:
@@ -71,9 +112,13 @@ public:
   void shutdown();
 
   /* Schedule an event in the future
-   * Call with the event_lock LOCKED */
-  void add_event_after(double seconds, Context *callback);
-  void add_event_at(utime_t when, Context *callback);
+   * Call with the event_lock LOCKED
+   *
+   * Pass coarse = true for high-frequency timers that tolerate ~100ms
+   * of slack (ticks, heartbeats, watch timeouts); those go through the
+   * O(1) timing wheel instead of the sorted multimap. */
+  void add_event_after(double seconds, Context *callback, bool coarse = false);
+  void add_event_at(utime_t when, Context *callback, bool coarse = false);
 
   /* Cancel an event.
    * Call with the event_lock LOCKED
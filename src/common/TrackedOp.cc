@@ -12,6 +12,8 @@
 
 #include "TrackedOp.h"
 #include "common/Formatter.h"
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <vector>
 #include "common/debug.h"
@@ -30,17 +32,22 @@ static ostream& _prefix(std::ostream* _dout)
 
 void OpHistory::on_shutdown()
 {
+  Mutex::Locker history_lock(ops_history_lock);
   arrived.clear();
   duration.clear();
+  traced.clear();
   shutdown = true;
 }
 
 void OpHistory::insert(utime_t now, TrackedOpRef op)
 {
+  Mutex::Locker history_lock(ops_history_lock);
   if (shutdown)
     return;
   duration.insert(make_pair(op->get_duration(), op));
   arrived.insert(make_pair(op->get_initiated(), op));
+  if (op->is_traced())
+    traced.insert(make_pair(op->get_initiated(), op));
   cleanup(now);
 }
 
@@ -61,10 +68,16 @@ void OpHistory::cleanup(utime_t now)
 	duration.begin()->second));
     duration.erase(duration.begin());
   }
+
+  // traced ops age out by count only; load must not evict them before
+  // the timelines are collected
+  while (traced.size() > history_size)
+    traced.erase(traced.begin());
 }
 
 void OpHistory::dump_ops(utime_t now, Formatter *f)
 {
+  Mutex::Locker history_lock(ops_history_lock);
   cleanup(now);
   f->open_object_section("OpHistory");
   f->dump_int("num to keep", history_size);
@@ -84,36 +97,142 @@ void OpHistory::dump_ops(utime_t now, Formatter *f)
   f->close_section();
 }
 
+void OpHistory::dump_slow_ops(utime_t now, Formatter *f, uint32_t num)
+{
+  Mutex::Locker history_lock(ops_history_lock);
+  cleanup(now);
+  f->open_object_section("OpHistory");
+  f->dump_int("num to show", num);
+  {
+    f->open_array_section("Ops");
+    uint32_t shown = 0;
+    for (set<pair<double, TrackedOpRef> >::const_reverse_iterator i =
+	   duration.rbegin();
+	 i != duration.rend() && shown < num;
+	 ++i, ++shown) {
+      f->open_object_section("Op");
+      i->second->dump(now, f);
+      f->close_section();
+    }
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void OpHistory::dump_traced_ops(utime_t now, Formatter *f)
+{
+  Mutex::Locker history_lock(ops_history_lock);
+  cleanup(now);
+  f->open_object_section("OpHistory");
+  f->dump_int("num to keep", history_size);
+  {
+    f->open_array_section("Ops");
+    for (set<pair<utime_t, TrackedOpRef> >::const_iterator i =
+	   traced.begin();
+	 i != traced.end();
+	 ++i) {
+      f->open_object_section("Op");
+      i->second->dump(now, f);
+      f->close_section();
+    }
+    f->close_section();
+  }
+  f->close_section();
+}
+
 void OpTracker::dump_historic_ops(Formatter *f)
 {
-  Mutex::Locker locker(ops_in_flight_lock);
   utime_t now = ceph_clock_now(cct);
   history.dump_ops(now, f);
 }
 
+void OpTracker::dump_traced_ops(Formatter *f)
+{
+  utime_t now = ceph_clock_now(cct);
+  history.dump_traced_ops(now, f);
+}
+
+void OpTracker::dump_historic_ops_by_duration(Formatter *f, uint32_t num)
+{
+  utime_t now = ceph_clock_now(cct);
+  history.dump_slow_ops(now, f, num);
+}
+
+void OpTracker::record_stage_latency(const string &stage, double lat)
+{
+  Mutex::Locker l(stage_stats_lock);
+  map<string, StageStats>::iterator p = stage_stats.find(stage);
+  if (p == stage_stats.end()) {
+    if (stage_stats.size() >= MAX_TRACKED_STAGES)
+      p = stage_stats.insert(
+	make_pair(string("(other)"), StageStats())).first;
+    else
+      p = stage_stats.insert(make_pair(stage, StageStats())).first;
+  }
+  p->second.count++;
+  p->second.total += lat;
+  if (lat > p->second.max)
+    p->second.max = lat;
+}
+
+void OpTracker::dump_stage_latencies(Formatter *f)
+{
+  Mutex::Locker l(stage_stats_lock);
+  f->open_object_section("op_stage_latencies");
+  f->open_array_section("stages");
+  for (map<string, StageStats>::const_iterator p = stage_stats.begin();
+       p != stage_stats.end();
+       ++p) {
+    f->open_object_section("stage");
+    f->dump_string("event", p->first);
+    f->dump_unsigned("count", p->second.count);
+    f->dump_float("total_sec", p->second.total);
+    f->dump_float("avg_sec", p->second.count ?
+		  p->second.total / p->second.count : 0.0);
+    f->dump_float("max_sec", p->second.max);
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
+
 void OpTracker::dump_ops_in_flight(Formatter *f)
 {
-  Mutex::Locker locker(ops_in_flight_lock);
   f->open_object_section("ops_in_flight"); // overall dump
-  f->dump_int("num_ops", ops_in_flight.size());
+  uint64_t total_ops_in_flight = 0;
+  for (uint32_t i = 0; i < num_optracker_shards; i++) {
+    ShardedTrackingData *sdata = sharded_in_flight_list[i];
+    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
+    total_ops_in_flight += sdata->ops_in_flight_sharded.size();
+  }
+  f->dump_int("num_ops", total_ops_in_flight);
   f->open_array_section("ops"); // list of TrackedOps
   utime_t now = ceph_clock_now(cct);
-  for (xlist<TrackedOp*>::iterator p = ops_in_flight.begin(); !p.end(); ++p) {
-    f->open_object_section("op");
-    (*p)->dump(now, f);
-    f->close_section(); // this TrackedOp
+  for (uint32_t i = 0; i < num_optracker_shards; i++) {
+    ShardedTrackingData *sdata = sharded_in_flight_list[i];
+    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
+    for (xlist<TrackedOp*>::iterator p = sdata->ops_in_flight_sharded.begin();
+	 !p.end();
+	 ++p) {
+      f->open_object_section("op");
+      (*p)->dump(now, f);
+      f->close_section(); // this TrackedOp
+    }
   }
   f->close_section(); // list of TrackedOps
   f->close_section(); // overall dump
 }
 
-void OpTracker::register_inflight_op(xlist<TrackedOp*>::item *i)
+void OpTracker::register_inflight_op(TrackedOp *i)
 {
   if (!tracking_enabled)
     return;
-  Mutex::Locker locker(ops_in_flight_lock);
-  ops_in_flight.push_back(i);
-  ops_in_flight.back()->seq = seq++;
+  uint64_t current_seq = seq.inc();
+  ShardedTrackingData *sdata =
+    sharded_in_flight_list[current_seq % num_optracker_shards];
+  Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
+  sdata->ops_in_flight_sharded.push_back(&i->xitem);
+  sdata->ops_in_flight_sharded.back()->seq = current_seq;
 }
 
 void OpTracker::unregister_inflight_op(TrackedOp *i)
@@ -121,63 +240,89 @@ void OpTracker::unregister_inflight_op(TrackedOp *i)
   // caller checks;
   assert(tracking_enabled);
 
-  Mutex::Locker locker(ops_in_flight_lock);
-  assert(i->xitem.get_list() == &ops_in_flight);
+  ShardedTrackingData *sdata =
+    sharded_in_flight_list[i->seq % num_optracker_shards];
+  {
+    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
+    assert(i->xitem.get_list() == &sdata->ops_in_flight_sharded);
+    i->xitem.remove_myself();
+  }
   utime_t now = ceph_clock_now(cct);
-  i->xitem.remove_myself();
   history.insert(now, TrackedOpRef(i));
 }
 
 bool OpTracker::check_ops_in_flight(std::vector<string> &warning_vector)
 {
-  Mutex::Locker locker(ops_in_flight_lock);
-  if (!ops_in_flight.size()) // this covers tracking_enabled, too
+  if (!tracking_enabled)
     return false;
 
   utime_t now = ceph_clock_now(cct);
   utime_t too_old = now;
   too_old -= complaint_time;
+  utime_t oldest_op = now;
+  uint64_t total_ops_in_flight = 0;
+
+  // each shard list is FIFO by arrival, so the shard fronts are enough
+  // to find the oldest op overall
+  for (uint32_t s = 0; s < num_optracker_shards; s++) {
+    ShardedTrackingData *sdata = sharded_in_flight_list[s];
+    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
+    if (!sdata->ops_in_flight_sharded.empty()) {
+      utime_t oldest_op_tmp =
+	sdata->ops_in_flight_sharded.front()->get_initiated();
+      if (oldest_op_tmp < oldest_op)
+	oldest_op = oldest_op_tmp;
+    }
+    total_ops_in_flight += sdata->ops_in_flight_sharded.size();
+  }
 
-  utime_t oldest_secs = now - ops_in_flight.front()->get_initiated();
+  if (!total_ops_in_flight)
+    return false;
 
-  dout(10) << "ops_in_flight.size: " << ops_in_flight.size()
+  utime_t oldest_secs = now - oldest_op;
+
+  dout(10) << "ops_in_flight.size: " << total_ops_in_flight
            << "; oldest is " << oldest_secs
            << " seconds old" << dendl;
 
   if (oldest_secs < complaint_time)
     return false;
 
-  xlist<TrackedOp*>::iterator i = ops_in_flight.begin();
   warning_vector.reserve(log_threshold + 1);
 
   int slow = 0;     // total slow
   int warned = 0;   // total logged
-  while (!i.end() && (*i)->get_initiated() < too_old) {
-    slow++;
-
-    // exponential backoff of warning intervals
-    if (((*i)->get_initiated() +
-	 (complaint_time * (*i)->warn_interval_multiplier)) < now) {
-      // will warn
-      if (warning_vector.empty())
-	warning_vector.push_back("");
-      warned++;
-      if (warned > log_threshold)
-        break;
-
-      utime_t age = now - (*i)->get_initiated();
-      stringstream ss;
-      ss << "slow request " << age << " seconds old, received at "
-         << (*i)->get_initiated() << ": ";
-      (*i)->_dump_op_descriptor(ss);
-      ss << " currently "
-	 << ((*i)->current.size() ? (*i)->current : (*i)->state_string());
-      warning_vector.push_back(ss.str());
-
-      // only those that have been shown will backoff
-      (*i)->warn_interval_multiplier *= 2;
+  for (uint32_t s = 0; s < num_optracker_shards && warned <= log_threshold; s++) {
+    ShardedTrackingData *sdata = sharded_in_flight_list[s];
+    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
+    xlist<TrackedOp*>::iterator i = sdata->ops_in_flight_sharded.begin();
+    while (!i.end() && (*i)->get_initiated() < too_old) {
+      slow++;
+
+      // exponential backoff of warning intervals
+      if (((*i)->get_initiated() +
+	   (complaint_time * (*i)->warn_interval_multiplier)) < now) {
+	// will warn
+	if (warning_vector.empty())
+	  warning_vector.push_back("");
+	warned++;
+	if (warned > log_threshold)
+	  break;
+
+	utime_t age = now - (*i)->get_initiated();
+	stringstream ss;
+	ss << "slow request " << age << " seconds old, received at "
+	   << (*i)->get_initiated() << ": ";
+	(*i)->_dump_op_descriptor(ss);
+	ss << " currently "
+	   << ((*i)->current.size() ? (*i)->current : (*i)->state_string());
+	warning_vector.push_back(ss.str());
+
+	// only those that have been shown will backoff
+	(*i)->warn_interval_multiplier *= 2;
+      }
+      ++i;
     }
-    ++i;
   }
 
   // only summarize if we warn about any.  if everything has backed
@@ -194,17 +339,29 @@ bool OpTracker::check_ops_in_flight(std::vector<string> &warning_vector)
 
 void OpTracker::get_age_ms_histogram(pow2_hist_t *h)
 {
-  Mutex::Locker locker(ops_in_flight_lock);
-
   h->clear();
-
   utime_t now = ceph_clock_now(NULL);
+
+  // gather ages from every shard, then bin them oldest-first as the
+  // single-list version did
+  vector<uint32_t> ages_ms;
+  for (uint32_t s = 0; s < num_optracker_shards; s++) {
+    ShardedTrackingData *sdata = sharded_in_flight_list[s];
+    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
+    for (xlist<TrackedOp*>::iterator i = sdata->ops_in_flight_sharded.begin();
+	 !i.end();
+	 ++i) {
+      utime_t age = now - (*i)->get_initiated();
+      ages_ms.push_back((long)(age * 1000.0));
+    }
+  }
+  sort(ages_ms.begin(), ages_ms.end(), std::greater<uint32_t>());
+
   unsigned bin = 30;
   uint32_t lb = 1 << (bin-1);  // lower bound for this bin
   int count = 0;
-  for (xlist<TrackedOp*>::iterator i = ops_in_flight.begin(); !i.end(); ++i) {
-    utime_t age = now - (*i)->get_initiated();
-    uint32_t ms = (long)(age * 1000.0);
+  for (vector<uint32_t>::iterator i = ages_ms.begin(); i != ages_ms.end(); ++i) {
+    uint32_t ms = *i;
     if (ms >= lb) {
       count++;
       continue;
@@ -225,14 +382,16 @@ void OpTracker::mark_event(TrackedOp *op, const string &dest)
 {
   if (!tracking_enabled)
     return;
-  utime_t now = ceph_clock_now(cct);
+  utime_t now = ceph_clock_now_coarse(cct);
   return _mark_event(op, dest, now);
 }
 
 void OpTracker::_mark_event(TrackedOp *op, const string &evt,
 			    utime_t time)
 {
-  Mutex::Locker locker(ops_in_flight_lock);
+  // no lock needed here; only build the descriptor if it will be logged
+  if (!cct->_conf->subsys.should_gather(ceph_subsys_optracker, 5))
+    return;
   stringstream ss;
   op->_dump_op_descriptor(ss);
   dout(5) << //"reqid: " << op->get_reqid() <<
@@ -254,11 +413,16 @@ void OpTracker::RemoveOnDelete::operator()(TrackedOp *op) {
 
 void TrackedOp::mark_event(const string &event)
 {
-  utime_t now = ceph_clock_now(g_ceph_context);
+  utime_t now = ceph_clock_now_coarse(g_ceph_context);
+  double lat = -1.0;
   {
     Mutex::Locker l(lock);
+    if (!events.empty())
+      lat = now - events.rbegin()->first;
     events.push_back(make_pair(now, event));
   }
+  if (lat >= 0.0 && tracker->tracking_enabled)
+    tracker->record_stage_latency(event, lat);
   tracker->mark_event(this, event);
   _event_marked();
 }
@@ -18,6 +18,7 @@
 #include <include/utime.h>
 #include "common/Mutex.h"
 #include "common/histogram.h"
+#include "include/atomic.h"
 #include "include/xlist.h"
 #include "msg/Message.h"
 #include "include/memory.h"
@@ -29,22 +30,33 @@ class OpTracker;
 class OpHistory {
   set<pair<utime_t, TrackedOpRef> > arrived;
   set<pair<double, TrackedOpRef> > duration;
+  /**
+   * completed ops that carried a trace flag, kept separately so busy
+   * periods don't evict them before the timelines can be collected;
+   * capped at history_size like the regular archive
+   */
+  set<pair<utime_t, TrackedOpRef> > traced;
   void cleanup(utime_t now);
   bool shutdown;
+  Mutex ops_history_lock;
   uint32_t history_size;
   uint32_t history_duration;
 
 public:
-  OpHistory() : shutdown(false),
+  OpHistory() : shutdown(false), ops_history_lock("OpHistory::lock"),
   history_size(0), history_duration(0) {}
   ~OpHistory() {
     assert(arrived.empty());
     assert(duration.empty());
+    assert(traced.empty());
   }
   void insert(utime_t now, TrackedOpRef op);
   void dump_ops(utime_t now, Formatter *f);
+  void dump_slow_ops(utime_t now, Formatter *f, uint32_t num);
+  void dump_traced_ops(utime_t now, Formatter *f);
   void on_shutdown();
   void set_size_and_duration(uint32_t new_size, uint32_t new_duration) {
+    Mutex::Locker l(ops_history_lock);
     history_size = new_size;
     history_duration = new_duration;
   }
@@ -59,19 +71,56 @@ class OpTracker {
   };
   friend class RemoveOnDelete;
   friend class OpHistory;
-  uint64_t seq;
-  Mutex ops_in_flight_lock;
-  xlist<TrackedOp *> ops_in_flight;
+  atomic64_t seq;
+
+  /**
+   * in-flight registry shard
+   *
+   * Ops hash to a shard by registration seq, so registering and
+   * unregistering only contend within a shard instead of on one
+   * global lock.
+   */
+  struct ShardedTrackingData {
+    Mutex ops_in_flight_lock_sharded;
+    xlist<TrackedOp *> ops_in_flight_sharded;
+    ShardedTrackingData() : ops_in_flight_lock_sharded("OpTracker::shard_lock") {}
+  };
+  vector<ShardedTrackingData*> sharded_in_flight_list;
+  uint32_t num_optracker_shards;
   OpHistory history;
   float complaint_time;
   int log_threshold;
 
+  /**
+   * per-stage latency aggregates
+   *
+   * Each mark_event() attributes the time since the previous event to
+   * the event being marked, so the breakdown shows where ops spend
+   * their time.  The map is capped so a caller generating unbounded
+   * event strings can't grow it forever; overflow lands in "(other)".
+   */
+  struct StageStats {
+    uint64_t count;
+    double total;
+    double max;
+    StageStats() : count(0), total(0.0), max(0.0) {}
+  };
+  static const unsigned MAX_TRACKED_STAGES = 1024;
+  Mutex stage_stats_lock;
+  map<string, StageStats> stage_stats;
+
 public:
   bool tracking_enabled;
   CephContext *cct;
-  OpTracker(CephContext *cct_, bool tracking) : seq(0), ops_in_flight_lock("OpTracker mutex"),
-						complaint_time(0), log_threshold(0),
-						tracking_enabled(tracking), cct(cct_) {}
+  OpTracker(CephContext *cct_, bool tracking, uint32_t num_shards = 1) :
+    seq(0),
+    num_optracker_shards(num_shards ? num_shards : 1),
+    complaint_time(0), log_threshold(0),
+    stage_stats_lock("OpTracker::stage_stats_lock"),
+    tracking_enabled(tracking), cct(cct_) {
+    for (uint32_t i = 0; i < num_optracker_shards; i++)
+      sharded_in_flight_list.push_back(new ShardedTrackingData);
+  }
   void set_complaint_and_threshold(float time, int threshold) {
     complaint_time = time;
     log_threshold = threshold;
@@ -81,7 +130,11 @@ public:
   }
   void dump_ops_in_flight(Formatter *f);
   void dump_historic_ops(Formatter *f);
-  void register_inflight_op(xlist<TrackedOp*>::item *i);
+  void dump_historic_ops_by_duration(Formatter *f, uint32_t num);
+  void dump_traced_ops(Formatter *f);
+  void record_stage_latency(const string &stage, double lat);
+  void dump_stage_latencies(Formatter *f);
+  void register_inflight_op(TrackedOp *i);
   void unregister_inflight_op(TrackedOp *i);
 
   void get_age_ms_histogram(pow2_hist_t *h);
@@ -99,11 +152,14 @@ public:
   void _mark_event(TrackedOp *op, const string &evt, utime_t now);
 
   void on_shutdown() {
-    Mutex::Locker l(ops_in_flight_lock);
     history.on_shutdown();
   }
   ~OpTracker() {
-    assert(ops_in_flight.empty());
+    while (!sharded_in_flight_list.empty()) {
+      assert(sharded_in_flight_list.back()->ops_in_flight_sharded.empty());
+      delete sharded_in_flight_list.back();
+      sharded_in_flight_list.pop_back();
+    }
   }
 
   template <typename T, typename U>
@@ -139,7 +195,7 @@ protected:
     seq(0),
     warn_interval_multiplier(1)
   {
-    tracker->register_inflight_op(&xitem);
+    tracker->register_inflight_op(this);
     events.push_back(make_pair(initiated_at, "initiated"));
   }
 
@@ -166,6 +222,9 @@ public:
   }
 
   void mark_event(const string &event);
+  /// true if this op carries a trace flag and should be archived for
+  /// cross-daemon timeline stitching
+  virtual bool is_traced() const { return false; }
   virtual const char *state_string() const {
     return events.rbegin()->second.c_str();
   }
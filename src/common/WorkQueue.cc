@@ -19,6 +19,8 @@
 #include "WorkQueue.h"
 
 #include "common/config.h"
+#include "common/errno.h"
+#include "common/Formatter.h"
 #include "common/HeartbeatMap.h"
 
 #define dout_subsys ceph_subsys_tp
@@ -47,6 +49,8 @@ ThreadPool::ThreadPool(CephContext *cct_, string nm, int n, const char *option)
     _conf_keys = new const char*[1];
     _conf_keys[0] = NULL;
   }
+  if (cct)
+    cct->register_queue_stats(this);
 }
 
 void ThreadPool::TPHandle::suspend_tp_timeout()
@@ -63,9 +67,33 @@ void ThreadPool::TPHandle::reset_tp_timeout()
 ThreadPool::~ThreadPool()
 {
   assert(_threads.empty());
+  if (cct)
+    cct->unregister_queue_stats(this);
   delete[] _conf_keys;
 }
 
+void ThreadPool::dump_queue_stats(ceph::Formatter *f)
+{
+  Mutex::Locker l(_lock);
+  f->dump_string("type", "thread_pool");
+  f->dump_string("name", name);
+  f->dump_unsigned("threads", _num_threads);
+  f->dump_int("processing", processing);
+  f->open_array_section("work_queues");
+  for (vector<WorkQueue_*>::iterator p = work_queues.begin();
+       p != work_queues.end();
+       ++p) {
+    f->open_object_section("work_queue");
+    f->dump_string("name", (*p)->name);
+    f->dump_bool("empty", (*p)->_empty());
+    int len = (*p)->_length();
+    if (len >= 0)
+      f->dump_int("length", len);
+    f->close_section();
+  }
+  f->close_section();
+}
+
 void ThreadPool::handle_conf_change(const struct md_config_t *conf,
 				    const std::set <std::string> &changed)
 {
@@ -157,6 +185,24 @@ void ThreadPool::start_threads()
     ldout(cct, 10) << "start_threads creating and starting " << wt << dendl;
     _threads.insert(wt);
     wt->create();
+    if (_cpu_list.length())
+      wt->set_affinity(_cpu_list);
+  }
+}
+
+void ThreadPool::set_affinity(const string& cpu_list)
+{
+  Mutex::Locker l(_lock);
+  _cpu_list = cpu_list;
+  for (set<WorkThread*>::iterator p = _threads.begin();
+       p != _threads.end();
+       ++p) {
+    int r = (*p)->set_affinity(cpu_list);
+    if (r < 0) {
+      lderr(cct) << "set_affinity " << name << " to '" << cpu_list
+		 << "' failed: " << cpp_strerror(r) << dendl;
+      break;
+    }
   }
 }
 
@@ -255,3 +301,148 @@ void ThreadPool::drain(WorkQueue_* wq)
   _lock.Unlock();
 }
 
+ShardedThreadPool::ShardedThreadPool(CephContext *cct_, string nm,
+				     uint32_t pnum_threads)
+  : cct(cct_), name(nm),
+    lockname(nm + "::lock"),
+    shardedpool_lock(lockname.c_str()),
+    num_threads(pnum_threads),
+    stop_threads(0),
+    pause_threads(0),
+    drain_threads(0),
+    num_paused(0),
+    num_drained(0),
+    wq(NULL)
+{
+}
+
+void ShardedThreadPool::shardedthreadpool_worker(uint32_t thread_index)
+{
+  assert(wq != NULL);
+  ldout(cct,10) << "worker start" << dendl;
+
+  std::stringstream ss;
+  ss << name << " thread " << (void*)pthread_self();
+  heartbeat_handle_d *hb = cct->get_heartbeat_map()->add_worker(ss.str());
+
+  while (!stop_threads.read()) {
+    if (pause_threads.read()) {
+      shardedpool_lock.Lock();
+      ++num_paused;
+      wait_cond.Signal();
+      while (pause_threads.read()) {
+	cct->get_heartbeat_map()->reset_timeout(
+	  hb, wq->timeout_interval, wq->suicide_interval);
+	shardedpool_cond.WaitInterval(cct, shardedpool_lock, utime_t(1, 0));
+      }
+      --num_paused;
+      shardedpool_lock.Unlock();
+    }
+    if (drain_threads.read()) {
+      shardedpool_lock.Lock();
+      if (wq->is_shard_empty(thread_index)) {
+	++num_drained;
+	wait_cond.Signal();
+	while (drain_threads.read()) {
+	  cct->get_heartbeat_map()->reset_timeout(
+	    hb, wq->timeout_interval, wq->suicide_interval);
+	  shardedpool_cond.WaitInterval(cct, shardedpool_lock, utime_t(1, 0));
+	}
+	--num_drained;
+      }
+      shardedpool_lock.Unlock();
+    }
+
+    cct->get_heartbeat_map()->reset_timeout(
+      hb, wq->timeout_interval, wq->suicide_interval);
+    wq->_process(thread_index, hb);
+  }
+
+  ldout(cct,10) << "worker finish" << dendl;
+  cct->get_heartbeat_map()->remove_worker(hb);
+}
+
+void ShardedThreadPool::start_threads()
+{
+  assert(shardedpool_lock.is_locked());
+  uint32_t thread_index = 0;
+  while (threads_shardedpool.size() < num_threads) {
+    WorkThreadSharded *wt = new WorkThreadSharded(this, thread_index);
+    ldout(cct, 10) << "start_threads creating and starting " << wt << dendl;
+    threads_shardedpool.push_back(wt);
+    wt->create();
+    thread_index++;
+  }
+}
+
+void ShardedThreadPool::start()
+{
+  ldout(cct,10) << "start" << dendl;
+  shardedpool_lock.Lock();
+  start_threads();
+  shardedpool_lock.Unlock();
+  ldout(cct,15) << "started" << dendl;
+}
+
+void ShardedThreadPool::stop()
+{
+  ldout(cct,10) << "stop" << dendl;
+  stop_threads.set(1);
+  assert(wq != NULL);
+  wq->return_waiting_threads();
+  for (vector<WorkThreadSharded*>::iterator p = threads_shardedpool.begin();
+       p != threads_shardedpool.end();
+       ++p) {
+    (*p)->join();
+    delete *p;
+  }
+  threads_shardedpool.clear();
+  ldout(cct,15) << "stopped" << dendl;
+}
+
+void ShardedThreadPool::pause()
+{
+  ldout(cct,10) << "pause" << dendl;
+  shardedpool_lock.Lock();
+  pause_threads.set(1);
+  assert(wq != NULL);
+  wq->return_waiting_threads();
+  while (num_paused < num_threads)
+    wait_cond.Wait(shardedpool_lock);
+  shardedpool_lock.Unlock();
+  ldout(cct,15) << "paused" << dendl;
+}
+
+void ShardedThreadPool::pause_new()
+{
+  ldout(cct,10) << "pause_new" << dendl;
+  pause_threads.set(1);
+  assert(wq != NULL);
+  wq->return_waiting_threads();
+}
+
+void ShardedThreadPool::unpause()
+{
+  ldout(cct,10) << "unpause" << dendl;
+  shardedpool_lock.Lock();
+  pause_threads.set(0);
+  shardedpool_cond.Signal();
+  shardedpool_lock.Unlock();
+  ldout(cct,15) << "unpaused" << dendl;
+}
+
+void ShardedThreadPool::drain()
+{
+  ldout(cct,10) << "drain" << dendl;
+  shardedpool_lock.Lock();
+  drain_threads.set(1);
+  assert(wq != NULL);
+  wq->return_waiting_threads();
+  while (num_drained < num_threads)
+    wait_cond.Wait(shardedpool_lock);
+  drain_threads.set(0);
+  shardedpool_cond.Signal();
+  shardedpool_lock.Unlock();
+  ldout(cct,15) << "drained" << dendl;
+}
+
@@ -18,12 +18,13 @@
 #include "Mutex.h"
 #include "Cond.h"
 #include "Thread.h"
+#include "include/atomic.h"
 #include "common/config_obs.h"
 #include "common/HeartbeatMap.h"
 
 class CephContext;
 
-class ThreadPool : public md_config_obs_t {
+class ThreadPool : public md_config_obs_t, public CephContext::QueueStatsProvider {
   CephContext *cct;
   string name;
   string lockname;
@@ -62,6 +63,8 @@ private:
     virtual ~WorkQueue_() {}
     virtual void _clear() = 0;
     virtual bool _empty() = 0;
+    /// current queue depth, or -1 if the implementation doesn't track it
+    virtual int _length() { return -1; }
     virtual void *_void_dequeue() = 0;
     virtual void _void_process(void *item, TPHandle &handle) = 0;
     virtual void _void_process_finish(void *) = 0;
@@ -321,6 +324,7 @@ private:
   
   set<WorkThread*> _threads;
   list<WorkThread*> _old_threads;  ///< need to be joined
+  string _cpu_list;                ///< pin pool threads to these cpus, if set
   int processing;
 
   void start_threads();
@@ -376,6 +380,9 @@ public:
     _cond.Signal();
   }
 
+  /// pin all pool threads, current and future, to the given cpus
+  void set_affinity(const string& cpu_list);
+
   /// start thread pool thread
   void start();
   /// stop thread pool thread
@@ -388,6 +395,117 @@ public:
   void unpause();
   /// wait for all work to complete
   void drain(WorkQueue_* wq = 0);
+
+  /// dump per-work-queue depth for the dump_queue_stats asok command
+  void dump_queue_stats(ceph::Formatter *f);
+};
+
+/**
+ * A thread pool for work queues that shard their own state.
+ *
+ * The classic ThreadPool funnels every worker through one lock and one
+ * condition variable; with many op threads the wakeup stampede and the
+ * lock handoff around every dequeue dominate.  A ShardedThreadPool
+ * keeps no queue state of its own: the ShardedWQ implementation owns
+ * per-shard structures (queues, locks, conds), each worker thread is
+ * bound to a shard index and blocks on its own shard, and _process()
+ * is driven with that index so an implementation can also steal from a
+ * sibling shard when its own is empty.  Enqueue never touches a global
+ * lock.
+ */
+class ShardedThreadPool {
+  CephContext *cct;
+  string name;
+  string lockname;
+  Mutex shardedpool_lock;
+  Cond shardedpool_cond;
+  Cond wait_cond;
+  uint32_t num_threads;
+  atomic_t stop_threads;
+  atomic_t pause_threads;
+  atomic_t drain_threads;
+  uint32_t num_paused;
+  uint32_t num_drained;
+
+public:
+  struct BaseShardedWQ {
+    time_t timeout_interval, suicide_interval;
+    BaseShardedWQ(time_t ti, time_t sti)
+      : timeout_interval(ti), suicide_interval(sti) {}
+    virtual ~BaseShardedWQ() {}
+    /// service shard thread_index.  implementations block on the
+    /// shard's own cond when idle, and should use a timed wait so a
+    /// pause/drain/stop raised after the emptiness check still gets
+    /// noticed on the next pass.
+    virtual void _process(uint32_t thread_index, heartbeat_handle_d *hb) = 0;
+    /// wake every thread blocked in _process (for pause/drain/stop)
+    virtual void return_waiting_threads() = 0;
+    virtual bool is_shard_empty(uint32_t thread_index) = 0;
+  };
+
+  template <typename T>
+  class ShardedWQ : public BaseShardedWQ {
+    ShardedThreadPool *sharded_pool;
+  protected:
+    virtual void _enqueue(T) = 0;
+    virtual void _enqueue_front(T) = 0;
+  public:
+    ShardedWQ(time_t ti, time_t sti, ShardedThreadPool *tp)
+      : BaseShardedWQ(ti, sti), sharded_pool(tp) {
+      tp->set_wq(this);
+    }
+    ~ShardedWQ() {}
+
+    void queue(T item) {
+      _enqueue(item);
+    }
+    void queue_front(T item) {
+      _enqueue_front(item);
+    }
+    void drain() {
+      sharded_pool->drain();
+    }
+  };
+
+private:
+  BaseShardedWQ *wq;
+
+  struct WorkThreadSharded : public Thread {
+    ShardedThreadPool *pool;
+    uint32_t thread_index;
+    WorkThreadSharded(ShardedThreadPool *p, uint32_t pthread_index)
+      : pool(p), thread_index(pthread_index) {}
+    void *entry() {
+      pool->shardedthreadpool_worker(thread_index);
+      return 0;
+    }
+  };
+
+  vector<WorkThreadSharded*> threads_shardedpool;
+  void start_threads();
+  void shardedthreadpool_worker(uint32_t thread_index);
+  void set_wq(BaseShardedWQ *swq) {
+    wq = swq;
+  }
+
+public:
+  ShardedThreadPool(CephContext *cct_, string nm, uint32_t pnum_threads);
+  ~ShardedThreadPool() {
+    assert(threads_shardedpool.empty());
+  }
+
+  /// start thread pool threads
+  void start();
+  /// stop thread pool threads
+  void stop();
+  /// pause the pool; returns once every worker is idle
+  void pause();
+  /// pause initiation of new work
+  void pause_new();
+  /// resume work.  must match each pause()/pause_new() call 1:1.
+  void unpause();
+  /// wait for all shards to empty
+  void drain();
 };
 
 class GenContextWQ :
@@ -407,6 +525,9 @@ public:
   bool _empty() {
     return _queue.empty();
   }
+  int _length() {
+    return _queue.size();
+  }
   GenContext<ThreadPool::TPHandle&> *_dequeue() {
     assert(!_queue.empty());
     GenContext<ThreadPool::TPHandle&> *c = _queue.front();
@@ -5,6 +5,9 @@
 #include <sys/errno.h>
 #endif
 
+#include "arch/intel.h"
+#include "common/armor_intel_fast.h"
+
 /*
  * base64 encode/decode.
  */
@@ -56,6 +59,15 @@ int ceph_armor_line_break(char *dst, const char *dst_end, const char *src, const
 		return __ret; \
 } while (0);
 
+	/*
+	 * bulk-encode whole blocks with ssse3 when we don't have to
+	 * interleave line breaks; the scalar loop below finishes the
+	 * tail and the padding
+	 */
+	if (!line_width && ceph_arch_intel_ssse3 &&
+	    ceph_armor_intel_fast_exists())
+		olen += ceph_armor_ssse3(&dst, dst_end, &src, end);
+
 	while (src < end) {
 		unsigned char a;
 
@@ -100,6 +112,14 @@ int ceph_unarmor(char *dst, const char *dst_end, const char *src, const char *en
 {
 	int olen = 0;
 
+	/*
+	 * bulk-decode full blocks with ssse3; it stops at the first
+	 * block holding anything beyond the plain alphabet (padding,
+	 * newline, url-safe '-'/'_'), which the loop below handles
+	 */
+	if (ceph_arch_intel_ssse3 && ceph_armor_intel_fast_exists())
+		olen += ceph_unarmor_ssse3(&dst, dst_end, &src, end);
+
 	while (src < end) {
 		int a, b, c, d;
 
@@ -8,7 +8,7 @@ extern "C" {
 int ceph_armor(char *dst, const char *dst_end,
 	       const char *src, const char *end);
 
-int ceph_armor_linebreak(char *dst, const char *dst_end,
+int ceph_armor_line_break(char *dst, const char *dst_end,
 	       const char *src, const char *end,
 	       int line_width);
 int ceph_unarmor(char *dst, const char *dst_end,
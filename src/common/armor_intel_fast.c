@@ -0,0 +1,136 @@
+#include "common/armor_intel_fast.h"
+
+#include <string.h>
+
+#ifdef __x86_64__
+
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+
+#include <tmmintrin.h>
+
+/*
+ * pshufb-based base64, following the technique described by Wojciech
+ * Mula (http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html) and
+ * used by the aklomp/base64 library (BSD licensed).  The encoder turns
+ * 12 input bytes into 16 output characters per step; the decoder turns
+ * 16 characters into 12 bytes and rejects any block containing a
+ * character outside the standard alphabet (padding, newlines and the
+ * url-safe '-'/'_' variants all land in the scalar fallback).
+ */
+
+static inline __m128i enc_reshuffle(__m128i in)
+{
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(
+		10, 11,  9, 10,
+		 7,  8,  6,  7,
+		 4,  5,  3,  4,
+		 1,  2,  0,  1));
+	return _mm_or_si128(
+		_mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+				_mm_set1_epi32(0x04000040)),
+		_mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+				_mm_set1_epi32(0x01000010)));
+}
+
+static inline __m128i enc_translate(__m128i in)
+{
+	const __m128i lut = _mm_setr_epi8(
+		65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	__m128i mask = _mm_cmpgt_epi8(in, _mm_set1_epi8(25));
+	indices = _mm_sub_epi8(indices, mask);
+	return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+int ceph_armor_ssse3(char **pdst, const char *dst_end,
+		     const char **psrc, const char *src_end)
+{
+	char *dst = *pdst;
+	const char *src = *psrc;
+	int olen = 0;
+
+	/*
+	 * each step consumes 12 bytes but loads 16, so keep 4 bytes of
+	 * slack on the input; the output store is a full 16 bytes.
+	 */
+	while (src + 16 <= src_end && dst + 16 <= dst_end) {
+		__m128i in = _mm_loadu_si128((const __m128i *)src);
+		in = enc_translate(enc_reshuffle(in));
+		_mm_storeu_si128((__m128i *)dst, in);
+		src += 12;
+		dst += 16;
+		olen += 16;
+	}
+
+	*pdst = dst;
+	*psrc = src;
+	return olen;
+}
+
+int ceph_unarmor_ssse3(char **pdst, const char *dst_end,
+		       const char **psrc, const char *src_end)
+{
+	const __m128i lut_lo = _mm_setr_epi8(
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(
+		0, 16, 19, 4, -65, -65, -71, -71,
+		0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2F = _mm_set1_epi8(0x2f);
+	char *dst = *pdst;
+	const char *src = *psrc;
+	int olen = 0;
+
+	while (src + 16 <= src_end && dst + 12 <= dst_end) {
+		__m128i str = _mm_loadu_si128((const __m128i *)src);
+		__m128i hi_nibbles =
+			_mm_and_si128(_mm_srli_epi32(str, 4), mask_2F);
+		__m128i lo_nibbles = _mm_and_si128(str, mask_2F);
+		__m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+		__m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+		__m128i eq_2F = _mm_cmpeq_epi8(str, mask_2F);
+		__m128i roll = _mm_shuffle_epi8(
+			lut_roll, _mm_add_epi8(eq_2F, hi_nibbles));
+		char tmp[16];
+
+		if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+						     _mm_setzero_si128())))
+			break;	/* not plain alphabet; scalar decides */
+
+		str = _mm_add_epi8(str, roll);
+		str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+		str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+		str = _mm_shuffle_epi8(str, _mm_setr_epi8(
+			 2,  1,  0,  6,  5,  4, 10,  9,
+			 8, 14, 13, 12, -1, -1, -1, -1));
+		_mm_storeu_si128((__m128i *)tmp, str);
+		memcpy(dst, tmp, 12);
+		src += 16;
+		dst += 12;
+		olen += 12;
+	}
+
+	*pdst = dst;
+	*psrc = src;
+	return olen;
+}
+
+#pragma GCC pop_options
+
+int ceph_armor_intel_fast_exists(void)
+{
+	return 1;
+}
+
+#else
+
+int ceph_armor_intel_fast_exists(void)
+{
+	return 0;
+}
+
+#endif
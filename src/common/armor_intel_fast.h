@@ -0,0 +1,45 @@
+#ifndef CEPH_COMMON_ARMOR_INTEL_FAST_H
+#define CEPH_COMMON_ARMOR_INTEL_FAST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* is the fast version compiled in */
+extern int ceph_armor_intel_fast_exists(void);
+
+#ifdef __x86_64__
+
+/*
+ * Encode/decode as many whole base64 blocks as possible with ssse3,
+ * advancing *psrc and *pdst; the caller finishes the tail (and any
+ * padding, newlines or url-safe characters) with the scalar code.
+ * Both return the number of output bytes produced.  The caller must
+ * check ceph_arch_intel_ssse3 first.
+ */
+extern int ceph_armor_ssse3(char **pdst, const char *dst_end,
+			    const char **psrc, const char *src_end);
+extern int ceph_unarmor_ssse3(char **pdst, const char *dst_end,
+			      const char **psrc, const char *src_end);
+
+#else
+
+static inline int ceph_armor_ssse3(char **pdst, const char *dst_end,
+				   const char **psrc, const char *src_end)
+{
+	return 0;
+}
+
+static inline int ceph_unarmor_ssse3(char **pdst, const char *dst_end,
+				     const char **psrc, const char *src_end)
+{
+	return 0;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
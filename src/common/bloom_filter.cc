@@ -135,3 +135,37 @@ void compressible_bloom_filter::generate_test_instances(list<compressible_bloom_
   ls.back()->compress(20);
   ls.back()->insert("boogggg");
 }
+
+
+void blocked_bloom_filter::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  bloom_filter::encode(bl);
+  ENCODE_FINISH(bl);
+}
+
+void blocked_bloom_filter::decode(bufferlist::iterator& p)
+{
+  DECODE_START(1, p);
+  // the block count comes back with the table; nothing else to restore
+  bloom_filter::decode(p);
+  DECODE_FINISH(p);
+}
+
+void blocked_bloom_filter::dump(Formatter *f) const
+{
+  bloom_filter::dump(f);
+  f->dump_unsigned("block_bytes", block_bytes);
+}
+
+void blocked_bloom_filter::generate_test_instances(list<blocked_bloom_filter*>& ls)
+{
+  ls.push_back(new blocked_bloom_filter(10, .5, 1));
+  ls.push_back(new blocked_bloom_filter(10, .5, 1));
+  ls.back()->insert(1);
+  ls.back()->insert(2);
+  ls.push_back(new blocked_bloom_filter(50, .5, 1));
+  ls.back()->insert(10);
+  ls.back()->insert(20);
+  ls.back()->insert(30);
+}
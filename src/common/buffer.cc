@@ -123,16 +123,34 @@ static uint32_t simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZE
     unsigned len;
     atomic_t nref;
 
-    mutable Mutex crc_lock;
-    map<pair<size_t, size_t>, pair<uint32_t, uint32_t> > crc_map;
+    /*
+     * small cache of crc32c results over this data, so paths that
+     * checksum the same bytes more than once (journal write, then
+     * messenger send to each replica) only pay for the computation
+     * once.  entries map (from, to) to (init crc, result) and are
+     * replaced round robin; a fixed array under a spinlock is cheaper
+     * per raw than a map and a Mutex, and the hot buffers only ever
+     * hold a couple of distinct ranges.
+     */
+    static const unsigned CRC_CACHE_SIZE = 4;
+    struct crc_cache_entry {
+      size_t from, to;
+      uint32_t base, crc;
+    };
+    mutable simple_spinlock_t crc_spinlock;
+    crc_cache_entry crc_cache[CRC_CACHE_SIZE];
+    unsigned crc_cache_len;   ///< entries filled so far
+    unsigned crc_cache_pos;   ///< next slot to replace when full
 
     raw(unsigned l)
       : data(NULL), len(l), nref(0),
-	crc_lock("buffer::raw::crc_lock", false, false)
+	crc_spinlock(SIMPLE_SPINLOCK_INITIALIZER),
+	crc_cache_len(0), crc_cache_pos(0)
     { }
     raw(char *c, unsigned l)
       : data(c), len(l), nref(0),
-	crc_lock("buffer::raw::crc_lock", false, false)
+	crc_spinlock(SIMPLE_SPINLOCK_INITIALIZER),
+	crc_cache_len(0), crc_cache_pos(0)
     { }
     virtual ~raw() {}
 
@@ -163,22 +181,48 @@ static uint32_t simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZE
     }
     bool get_crc(const pair<size_t, size_t> &fromto,
 		 pair<uint32_t, uint32_t> *crc) const {
-      Mutex::Locker l(crc_lock);
-      map<pair<size_t, size_t>, pair<uint32_t, uint32_t> >::const_iterator i =
-	crc_map.find(fromto);
-      if (i == crc_map.end())
-	return false;
-      *crc = i->second;
-      return true;
+      bool found = false;
+      simple_spin_lock(&crc_spinlock);
+      for (unsigned i = 0; i < crc_cache_len; i++) {
+	if (crc_cache[i].from == fromto.first &&
+	    crc_cache[i].to == fromto.second) {
+	  crc->first = crc_cache[i].base;
+	  crc->second = crc_cache[i].crc;
+	  found = true;
+	  break;
+	}
+      }
+      simple_spin_unlock(&crc_spinlock);
+      return found;
     }
     void set_crc(const pair<size_t, size_t> &fromto,
 		 const pair<uint32_t, uint32_t> &crc) {
-      Mutex::Locker l(crc_lock);
-      crc_map[fromto] = crc;
+      simple_spin_lock(&crc_spinlock);
+      unsigned i;
+      for (i = 0; i < crc_cache_len; i++) {
+	if (crc_cache[i].from == fromto.first &&
+	    crc_cache[i].to == fromto.second)
+	  break;
+      }
+      if (i == crc_cache_len) {
+	if (crc_cache_len < CRC_CACHE_SIZE) {
+	  i = crc_cache_len++;
+	} else {
+	  i = crc_cache_pos;
+	  crc_cache_pos = (crc_cache_pos + 1) % CRC_CACHE_SIZE;
+	}
+      }
+      crc_cache[i].from = fromto.first;
+      crc_cache[i].to = fromto.second;
+      crc_cache[i].base = crc.first;
+      crc_cache[i].crc = crc.second;
+      simple_spin_unlock(&crc_spinlock);
     }
     void invalidate_crc() {
-      Mutex::Locker l(crc_lock);
-      crc_map.clear();
+      simple_spin_lock(&crc_spinlock);
+      crc_cache_len = 0;
+      crc_cache_pos = 0;
+      simple_spin_unlock(&crc_spinlock);
     }
   };
 
@@ -500,6 +544,247 @@ static uint32_t simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZE
     }
   };
 
+  class buffer::raw_pooled : public buffer::raw {
+    pool *pl;
+    unsigned index;
+  public:
+    raw_pooled(pool *p, char *b, unsigned l, unsigned i)
+      : raw(b, l), pl(p->get()), index(i) {
+      inc_total_alloc(len);
+      bdout << "raw_pooled " << this << " alloc " << (void *)data << " " << l << " " << buffer::get_total_alloc() << bendl;
+    }
+    ~raw_pooled() {
+      dec_total_alloc(len);
+      bdout << "raw_pooled " << this << " free " << (void *)data << " " << buffer::get_total_alloc() << bendl;
+      pl->recycle(data, index);
+      pl->put();
+    }
+    raw* clone_empty() {
+      return new raw_char(len);
+    }
+  };
+
+  const unsigned buffer::pool::pool_sizes[buffer::pool::NUM_SIZES] = {
+    4096, 65536, 1048576
+  };
+
+  /* free buffers of each size class a thread hangs on to before
+   * spilling to the shared lists */
+  static const unsigned MAX_MAGAZINE = 4;
+
+  static atomic_t pool_stat_alloc[buffer::pool::NUM_SIZES];
+  static atomic_t pool_stat_tls_hit[buffer::pool::NUM_SIZES];
+  static atomic_t pool_stat_shared_hit[buffer::pool::NUM_SIZES];
+
+  void buffer::pool::get_stats(size_class_stats *stats)
+  {
+    for (unsigned i = 0; i < NUM_SIZES; i++) {
+      stats[i].alloc = pool_stat_alloc[i].read();
+      stats[i].tls_hit = pool_stat_tls_hit[i].read();
+      stats[i].shared_hit = pool_stat_shared_hit[i].read();
+    }
+  }
+
+  /* per-thread magazine; holds a reference on the pool, since threads
+   * may outlive the pool's owner */
+  struct buffer::pool::thread_cache {
+    pool *pl;
+    char *bufs[NUM_SIZES];   // intrusive free lists, like the shared ones
+    unsigned count[NUM_SIZES];
+
+    explicit thread_cache(pool *p) : pl(p->get()) {
+      for (unsigned i = 0; i < NUM_SIZES; i++) {
+	bufs[i] = NULL;
+	count[i] = 0;
+      }
+    }
+  };
+
+  buffer::pool::pool(unsigned max)
+    : lock(SIMPLE_SPINLOCK_INITIALIZER), nref(1), max_per_size(max)
+  {
+    for (unsigned i = 0; i < NUM_SIZES; i++) {
+      free_bufs[i] = NULL;
+      free_count[i] = 0;
+    }
+    pthread_key_create(&tls_key, flush_thread_cache);
+  }
+
+  buffer::pool::~pool()
+  {
+    pthread_key_delete(tls_key);
+    for (unsigned i = 0; i < NUM_SIZES; i++) {
+      while (free_bufs[i]) {
+	char *next = *(char**)free_bufs[i];
+	::free(free_bufs[i]);
+	free_bufs[i] = next;
+      }
+    }
+  }
+
+  buffer::pool::thread_cache *buffer::pool::get_thread_cache()
+  {
+    thread_cache *tc = (thread_cache *)pthread_getspecific(tls_key);
+    if (!tc) {
+      tc = new thread_cache(this);
+      pthread_setspecific(tls_key, tc);
+    }
+    return tc;
+  }
+
+  // runs at thread exit; gives the magazine back to the shared lists
+  void buffer::pool::flush_thread_cache(void *p)
+  {
+    thread_cache *tc = (thread_cache *)p;
+    pool *pl = tc->pl;
+    char *overflow = NULL;
+    simple_spin_lock(&pl->lock);
+    for (unsigned i = 0; i < NUM_SIZES; i++) {
+      while (tc->bufs[i]) {
+	char *data = tc->bufs[i];
+	tc->bufs[i] = *(char**)data;
+	if (pl->free_count[i] < pl->max_per_size) {
+	  *(char**)data = pl->free_bufs[i];
+	  pl->free_bufs[i] = data;
+	  pl->free_count[i]++;
+	} else {
+	  *(char**)data = overflow;
+	  overflow = data;
+	}
+      }
+    }
+    simple_spin_unlock(&pl->lock);
+    while (overflow) {
+      char *next = *(char**)overflow;
+      ::free(overflow);
+      overflow = next;
+    }
+    delete tc;
+    pl->put();
+  }
+
+  buffer::pool *buffer::pool::get()
+  {
+    simple_spin_lock(&lock);
+    nref++;
+    simple_spin_unlock(&lock);
+    return this;
+  }
+
+  void buffer::pool::put()
+  {
+    simple_spin_lock(&lock);
+    bool last = (--nref == 0);
+    simple_spin_unlock(&lock);
+    if (last)
+      delete this;
+  }
+
+  buffer::raw* buffer::pool::create_from_class(unsigned index, unsigned len)
+  {
+    thread_cache *tc = get_thread_cache();
+    char *data = NULL;
+    if (tc->bufs[index]) {
+      data = tc->bufs[index];
+      tc->bufs[index] = *(char**)data;
+      tc->count[index]--;
+      pool_stat_tls_hit[index].inc();
+    } else {
+      simple_spin_lock(&lock);
+      if (free_bufs[index]) {
+	data = free_bufs[index];
+	free_bufs[index] = *(char**)data;
+	free_count[index]--;
+	/* refill half a magazine while we hold the lock */
+	unsigned want = MAX_MAGAZINE / 2;
+	while (want-- && free_bufs[index]) {
+	  char *extra = free_bufs[index];
+	  free_bufs[index] = *(char**)extra;
+	  free_count[index]--;
+	  *(char**)extra = tc->bufs[index];
+	  tc->bufs[index] = extra;
+	  tc->count[index]++;
+	}
+      }
+      simple_spin_unlock(&lock);
+      if (data)
+	pool_stat_shared_hit[index].inc();
+    }
+    if (!data) {
+#if defined(DARWIN)
+      data = (char *) valloc (pool_sizes[index]);
+      if (!data)
+	throw bad_alloc();
+#elif defined(__CYGWIN__)
+      // no posix_memalign; give up on alignment rather than pooling
+      data = (char *) malloc(pool_sizes[index]);
+      if (!data)
+	throw bad_alloc();
+#else
+      int r = ::posix_memalign((void**)(void*)&data, CEPH_PAGE_SIZE,
+			       pool_sizes[index]);
+      if (r)
+	throw bad_alloc();
+#endif
+    }
+    pool_stat_alloc[index].inc();
+    return new raw_pooled(this, data, len, index);
+  }
+
+  buffer::raw* buffer::pool::create(unsigned len)
+  {
+    unsigned i = size_index(len);
+    if (i == NUM_SIZES || max_per_size == 0)
+      return buffer::create(len);
+    return create_from_class(i, len);
+  }
+
+  buffer::raw* buffer::pool::create_page_aligned(unsigned len)
+  {
+    unsigned i = size_index(len);
+    if (i == NUM_SIZES || max_per_size == 0)
+      return buffer::create_page_aligned(len);
+    return create_from_class(i, len);
+  }
+
+  void buffer::pool::recycle(char *data, unsigned index)
+  {
+    thread_cache *tc = get_thread_cache();
+    if (tc->count[index] < MAX_MAGAZINE) {
+      *(char**)data = tc->bufs[index];
+      tc->bufs[index] = data;
+      tc->count[index]++;
+      return;
+    }
+
+    /* magazine is full; spill it and this buffer to the shared list */
+    *(char**)data = tc->bufs[index];
+    char *spill = data;
+    tc->bufs[index] = NULL;
+    tc->count[index] = 0;
+
+    char *overflow = NULL;
+    simple_spin_lock(&lock);
+    while (spill) {
+      char *next = *(char**)spill;
+      if (free_count[index] < max_per_size) {
+	*(char**)spill = free_bufs[index];
+	free_bufs[index] = spill;
+	free_count[index]++;
+      } else {
+	*(char**)spill = overflow;
+	overflow = spill;
+      }
+      spill = next;
+    }
+    simple_spin_unlock(&lock);
+    while (overflow) {
+      char *next = *(char**)overflow;
+      ::free(overflow);
+      overflow = next;
+    }
+  }
+
   buffer::raw* buffer::copy(const char *c, unsigned len) {
     raw* r = new raw_char(len);
     memcpy(r->data, c, len);
@@ -617,6 +902,9 @@ static uint32_t simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZE
       bdout << "ptr " << this << " release " << _raw << bendl;
       if (_raw->nref.dec() == 0) {
 	//cout << "hosing raw " << (void*)_raw << " len " << _raw->len << std::endl;
+	// dec() is only a release; acquire before freeing so we see the
+	// other threads' last writes to the raw
+	atomic_t::read_barrier();
 	delete _raw;  // dealloc old (if any)
       }
       _raw = 0;
@@ -851,6 +1139,26 @@ static uint32_t simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZE
     copy(len, dest.c_str());
   }
 
+  void buffer::list::iterator::copy_shallow(unsigned len, ptr &dest)
+  {
+    if (!len) {
+      dest = ptr();
+      return;
+    }
+    if (p == ls->end())
+      seek(off);
+    if (p == ls->end())
+      throw end_of_buffer();
+    if (p->length() - p_off >= len) {
+      // the whole range is in this buffer; share its raw
+      dest = ptr(*p, p_off, len);
+      advance(len);
+    } else {
+      // spans buffers; fall back to flattening into a fresh one
+      copy(len, dest);
+    }
+  }
+
   void buffer::list::iterator::copy(unsigned len, list &dest)
   {
     if (p == ls->end())
@@ -1115,7 +1423,19 @@ void buffer::list::rebuild_page_aligned()
       ++p;
       continue;
     }
-    
+
+    // a page-aligned segment with a partial tail page: keep the whole
+    // pages where they are and let only the tail join the rebuilt run,
+    // instead of copying the entire segment
+    if (p->is_page_aligned() && p->length() > CEPH_PAGE_SIZE) {
+      unsigned keep = p->length() & CEPH_PAGE_MASK;
+      ptr tail(*p, keep, p->length() - keep);
+      p->set_length(keep);
+      ++p;
+      p = _buffers.insert(p, tail);
+      continue;
+    }
+
     // consolidate unaligned items, until we get something that is sized+aligned
     list unaligned;
     unsigned offset = 0;
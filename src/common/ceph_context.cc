@@ -190,6 +190,9 @@ void CephContext::do_command(std::string command, cmdmap_t& cmdmap,
     command == "perf schema") {
     _perf_counters_collection->dump_formatted(f, true);
   }
+  else if (command == "perf rate") {
+    _perf_counters_collection->dump_formatted_rates(f);
+  }
   else {
     f->open_object_section(command.c_str());
     if (command == "config show") {
@@ -238,6 +241,19 @@ void CephContext::do_command(std::string command, cmdmap_t& cmdmap,
     else if (command == "log reopen") {
       _log->reopen_log_file();
     }
+    else if (command == "dump_queue_stats") {
+      f->open_array_section("queues");
+      ceph_spin_lock(&_queue_stats_lock);
+      for (std::vector<QueueStatsProvider*>::iterator p = _queue_stats.begin();
+	   p != _queue_stats.end();
+	   ++p) {
+	f->open_object_section("queue");
+	(*p)->dump_queue_stats(f);
+	f->close_section();
+      }
+      ceph_spin_unlock(&_queue_stats_lock);
+      f->close_section();
+    }
     else {
       assert(0 == "registered under wrong command?");    
     }
@@ -265,6 +281,7 @@ CephContext::CephContext(uint32_t module_type_)
     _crypto_aes(NULL)
 {
   ceph_spin_init(&_service_thread_lock);
+  ceph_spin_init(&_queue_stats_lock);
 
   _log = new ceph::log::Log(&_conf->subsys);
   _log->start();
@@ -283,12 +300,14 @@ CephContext::CephContext(uint32_t module_type_)
   _admin_socket->register_command("perfcounters_schema", "perfcounters_schema", _admin_hook, "");
   _admin_socket->register_command("2", "2", _admin_hook, "");
   _admin_socket->register_command("perf schema", "perf schema", _admin_hook, "dump perfcounters schema");
+  _admin_socket->register_command("perf rate", "perf rate", _admin_hook, "dump perfcounters change per second since the last call");
   _admin_socket->register_command("config show", "config show", _admin_hook, "dump current config settings");
   _admin_socket->register_command("config set", "config set name=var,type=CephString name=val,type=CephString,n=N",  _admin_hook, "config set <field> <val> [<val> ...]: set a config variable");
   _admin_socket->register_command("config get", "config get name=var,type=CephString", _admin_hook, "config get <field>: get the config value");
   _admin_socket->register_command("log flush", "log flush", _admin_hook, "flush log entries to log file");
   _admin_socket->register_command("log dump", "log dump", _admin_hook, "dump recent log entries to log file");
   _admin_socket->register_command("log reopen", "log reopen", _admin_hook, "reopen log file");
+  _admin_socket->register_command("dump_queue_stats", "dump_queue_stats", _admin_hook, "dump queue depth stats for finishers and thread pools");
 
   _crypto_none = new CryptoNone;
   _crypto_aes = new CryptoAES;
@@ -307,6 +326,7 @@ CephContext::~CephContext()
   _admin_socket->unregister_command("1");
   _admin_socket->unregister_command("perfcounters_schema");
   _admin_socket->unregister_command("perf schema");
+  _admin_socket->unregister_command("perf rate");
   _admin_socket->unregister_command("2");
   _admin_socket->unregister_command("config show");
   _admin_socket->unregister_command("config set");
@@ -314,6 +334,7 @@ CephContext::~CephContext()
   _admin_socket->unregister_command("log flush");
   _admin_socket->unregister_command("log dump");
   _admin_socket->unregister_command("log reopen");
+  _admin_socket->unregister_command("dump_queue_stats");
   delete _admin_hook;
   delete _admin_socket;
 
@@ -335,6 +356,7 @@ CephContext::~CephContext()
 
   delete _conf;
   ceph_spin_destroy(&_service_thread_lock);
+  ceph_spin_destroy(&_queue_stats_lock);
 
   delete _crypto_none;
   delete _crypto_aes;
@@ -404,6 +426,27 @@ AdminSocket *CephContext::get_admin_socket()
   return _admin_socket;
 }
 
+void CephContext::register_queue_stats(QueueStatsProvider *p)
+{
+  ceph_spin_lock(&_queue_stats_lock);
+  _queue_stats.push_back(p);
+  ceph_spin_unlock(&_queue_stats_lock);
+}
+
+void CephContext::unregister_queue_stats(QueueStatsProvider *p)
+{
+  ceph_spin_lock(&_queue_stats_lock);
+  for (std::vector<QueueStatsProvider*>::iterator q = _queue_stats.begin();
+       q != _queue_stats.end();
+       ++q) {
+    if (*q == p) {
+      _queue_stats.erase(q);
+      break;
+    }
+  }
+  ceph_spin_unlock(&_queue_stats_lock);
+}
+
 CryptoHandler *CephContext::get_crypto_handler(int type)
 {
   switch (type) {
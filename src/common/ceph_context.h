@@ -23,6 +23,8 @@
 #include "common/cmdparse.h"
 #include "include/Spinlock.h"
 
+#include <vector>
+
 class AdminSocket;
 class CephContextServiceThread;
 class PerfCountersCollection;
@@ -34,6 +36,7 @@ class CryptoAES;
 class CryptoHandler;
 
 namespace ceph {
+  class Formatter;
   class HeartbeatMap;
   namespace log {
     class Log;
@@ -107,6 +110,18 @@ public:
    */
   CryptoHandler *get_crypto_handler(int type);
 
+  /**
+   * Something that can report queue depth statistics through the
+   * "dump_queue_stats" admin socket command (finishers, thread pools).
+   * Implementations dump one formatter object per call.
+   */
+  struct QueueStatsProvider {
+    virtual ~QueueStatsProvider() {}
+    virtual void dump_queue_stats(ceph::Formatter *f) = 0;
+  };
+  void register_queue_stats(QueueStatsProvider *p);
+  void unregister_queue_stats(QueueStatsProvider *p);
+
 private:
   CephContext(const CephContext &rhs);
   CephContext &operator=(const CephContext &rhs);
@@ -141,6 +156,10 @@ private:
   // crypto
   CryptoNone *_crypto_none;
   CryptoAES *_crypto_aes;
+
+  /* queue stats providers, for the dump_queue_stats command */
+  ceph_spinlock_t _queue_stats_lock;
+  std::vector<QueueStatsProvider*> _queue_stats;
 };
 
 #endif
@@ -88,6 +88,7 @@ const char *ceph_osd_op_name(int op)
 	case CEPH_OSD_OP_DNLOCK: return "dnlock";
 
 	case CEPH_OSD_OP_CALL: return "call";
+	case CEPH_OSD_OP_CALL_CHAIN: return "call-chain";
 
 	case CEPH_OSD_OP_PGLS: return "pgls";
 	case CEPH_OSD_OP_PGLS_FILTER: return "pgls-filter";
@@ -95,6 +96,7 @@ const char *ceph_osd_op_name(int op)
 	case CEPH_OSD_OP_PG_HITSET_GET: return "pg-hitset-get";
 	case CEPH_OSD_OP_OMAPGETKEYS: return "omap-get-keys";
 	case CEPH_OSD_OP_OMAPGETVALS: return "omap-get-vals";
+	case CEPH_OSD_OP_OMAPGETVALSFILTERED: return "omap-get-vals-filtered";
 	case CEPH_OSD_OP_OMAPGETHEADER: return "omap-get-header";
 	case CEPH_OSD_OP_OMAPGETVALSBYKEYS: return "omap-get-vals-by-keys";
 	case CEPH_OSD_OP_OMAPSETVALS: return "omap-set-vals";
@@ -103,6 +105,10 @@ const char *ceph_osd_op_name(int op)
 	case CEPH_OSD_OP_OMAPRMKEYS: return "omap-rm-keys";
 
 	case CEPH_OSD_OP_SETALLOCHINT: return "set-alloc-hint";
+
+	case CEPH_OSD_OP_READV: return "readv";
+	case CEPH_OSD_OP_WRITEV: return "writev";
+	case CEPH_OSD_OP_WRITESAME: return "writesame";
 	}
 
 	return "???";
@@ -30,6 +30,7 @@ OPTION(daemonize, OPT_BOOL, false) // default changed by common_preinit()
 OPTION(pid_file, OPT_STR, "") // default changed by common_preinit()
 OPTION(chdir, OPT_STR, "/")
 OPTION(max_open_files, OPT_LONGLONG, 0)
+OPTION(cpu_affinity, OPT_STR, "") // pin the daemon's threads (and, via first-touch, most of its memory) to these cpus, e.g. "0-5,12-17" for one socket; set per daemon to partition numa nodes between osds sharing a host
 OPTION(restapi_log_level, OPT_STR, "") 	// default set by Python code
 OPTION(restapi_base_url, OPT_STR, "")	// "
 OPTION(fatal_signal_handlers, OPT_BOOL, true)
@@ -104,15 +105,21 @@ OPTION(heartbeat_file, OPT_STR, "")
 OPTION(heartbeat_inject_failure, OPT_INT, 0)    // force an unhealthy heartbeat for N seconds
 OPTION(perf, OPT_BOOL, true)       // enable internal perf counters
 
+OPTION(ms_type, OPT_STR, "simple")   // messenger backend: simple or async (experimental)
 OPTION(ms_tcp_nodelay, OPT_BOOL, true)
 OPTION(ms_tcp_rcvbuf, OPT_INT, 0)
 OPTION(ms_initial_backoff, OPT_DOUBLE, .2)
 OPTION(ms_max_backoff, OPT_DOUBLE, 15.0)
 OPTION(ms_nocrc, OPT_BOOL, false)
+OPTION(ms_compress_data, OPT_BOOL, false)          // snappy-compress data payloads to peers that support it; enable on a bandwidth-bound messenger (e.g. cross-dc replication)
+OPTION(ms_compress_data_min_size, OPT_U64, 4096)   // don't bother compressing payloads smaller than this
 OPTION(ms_die_on_bad_msg, OPT_BOOL, false)
 OPTION(ms_die_on_unhandled_msg, OPT_BOOL, false)
 OPTION(ms_die_on_old_message, OPT_BOOL, false)     // assert if we get a dup incoming message and shouldn't have (may be triggered by pre-541cd3c64be0dfa04e8a2df39422e0eb9541a428 code)
 OPTION(ms_dispatch_throttle_bytes, OPT_U64, 100 << 20)
+OPTION(ms_dispatch_shards, OPT_INT, 1)             // dispatch threads per messenger; connections hash to shards to keep per-connection ordering
+OPTION(ms_rx_buffer_pool_size, OPT_INT, 64)        // rx buffers cached per size class per messenger; 0 disables pooling
+OPTION(ms_session_resume_ttl, OPT_DOUBLE, 60)      // seconds a verified connect authorizer may be reused by a reconnect; 0 disables
 OPTION(ms_bind_ipv6, OPT_BOOL, false)
 OPTION(ms_bind_port_min, OPT_INT, 6800)
 OPTION(ms_bind_port_max, OPT_INT, 7300)
@@ -127,6 +134,7 @@ OPTION(ms_inject_delay_max, OPT_DOUBLE, 1)         // seconds
 OPTION(ms_inject_delay_probability, OPT_DOUBLE, 0) // range [0, 1]
 OPTION(ms_inject_internal_delays, OPT_DOUBLE, 0)   // seconds
 OPTION(ms_dump_on_send, OPT_BOOL, false)           // hexdump msg to log on send
+OPTION(ms_async_op_threads, OPT_INT, 2)            // number of worker threads for the async messenger
 
 OPTION(inject_early_sigterm, OPT_BOOL, false)
 
@@ -178,6 +186,7 @@ OPTION(mon_warn_on_old_mons, OPT_BOOL, true) // should mons set health to WARN i
 OPTION(mon_warn_on_legacy_crush_tunables, OPT_BOOL, true) // warn if crush tunables are not optimal
 OPTION(mon_warn_on_osd_down_out_interval_zero, OPT_BOOL, true) // warn if 'mon_osd_down_out_interval == 0'
 OPTION(mon_min_osdmap_epochs, OPT_INT, 500)
+OPTION(mon_osdmap_encode_cache_size, OPT_INT, 1024) // max cached (epoch, feature class) re-encoded osdmap bufferlists
 OPTION(mon_max_pgmap_epochs, OPT_INT, 500)
 OPTION(mon_max_log_epochs, OPT_INT, 500)
 OPTION(mon_max_mdsmap_epochs, OPT_INT, 500)
@@ -188,12 +197,14 @@ OPTION(mon_slurp_bytes, OPT_INT, 256*1024)    // limit size of slurp messages
 OPTION(mon_client_bytes, OPT_U64, 100ul << 20)  // client msg data allowed in memory (in bytes)
 OPTION(mon_daemon_bytes, OPT_U64, 400ul << 20)  // mds, osd message memory cap (in bytes)
 OPTION(mon_max_log_entries_per_event, OPT_INT, 4096)
+OPTION(mon_log_coalesce_duplicates, OPT_BOOL, true) // commit identical pending cluster log messages as one entry with a count
 OPTION(mon_health_data_update_interval, OPT_FLOAT, 60.0)
 OPTION(mon_data_avail_crit, OPT_INT, 5)
 OPTION(mon_data_avail_warn, OPT_INT, 30)
 OPTION(mon_config_key_max_entry_size, OPT_INT, 4096) // max num bytes per config-key entry
 OPTION(mon_sync_timeout, OPT_DOUBLE, 60.0)
 OPTION(mon_sync_max_payload_size, OPT_U32, 1048576) // max size for a sync chunk payload (say, 1MB)
+OPTION(mon_sync_max_inflight_chunks, OPT_U32, 4) // sync chunk requests to keep in flight
 OPTION(mon_sync_debug, OPT_BOOL, false) // enable sync-specific debug
 OPTION(mon_sync_debug_leader, OPT_INT, -1) // monitor to be used as the sync leader
 OPTION(mon_sync_debug_provider, OPT_INT, -1) // monitor to be used as the sync provider
@@ -219,6 +230,7 @@ OPTION(mon_leveldb_max_open_files, OPT_INT, 0) // monitor's leveldb max open fil
 OPTION(mon_leveldb_compression, OPT_BOOL, false) // monitor's leveldb uses compression
 OPTION(mon_leveldb_paranoid, OPT_BOOL, false)   // monitor's leveldb paranoid flag
 OPTION(mon_leveldb_log, OPT_STR, "")
+OPTION(mon_leveldb_compact_pause, OPT_DOUBLE, 1.0) // pause between background range compactions so they do not stall commits
 OPTION(mon_leveldb_size_warn, OPT_U64, 40*1024*1024*1024) // issue a warning when the monitor's leveldb goes over 40GB (in bytes)
 OPTION(mon_force_quorum_join, OPT_BOOL, false) // force monitor to join quorum even if it has been previously removed from the map
 OPTION(paxos_stash_full_interval, OPT_INT, 25)   // how often (in commits) to stash a full copy of the PaxosService state
@@ -231,6 +243,7 @@ OPTION(paxos_trim_max, OPT_INT, 500) // max number of extra proposals to trim at
 OPTION(paxos_service_trim_min, OPT_INT, 250) // minimum amount of versions to trigger a trim (0 disables it)
 OPTION(paxos_service_trim_max, OPT_INT, 500) // maximum amount of versions to trim during a single proposal (0 disables it)
 OPTION(paxos_kill_at, OPT_INT, 0)
+OPTION(paxos_merge_max_bytes, OPT_U64, 4*1024*1024) // merge queued proposals into one round up to this size (0 disables merging)
 OPTION(clock_offset, OPT_DOUBLE, 0) // how much to offset the system clock in Clock.cc
 OPTION(auth_cluster_required, OPT_STR, "cephx")   // required of mon, mds, osd daemons
 OPTION(auth_service_required, OPT_STR, "cephx")   // required by daemons of clients
@@ -244,6 +257,8 @@ OPTION(auth_mon_ticket_ttl, OPT_DOUBLE, 60*60*12)
 OPTION(auth_service_ticket_ttl, OPT_DOUBLE, 60*60)
 OPTION(auth_debug, OPT_BOOL, false)          // if true, assert when weird things happen
 OPTION(mon_client_hunt_interval, OPT_DOUBLE, 3.0)   // try new mon every N seconds until we connect
+OPTION(mon_client_hunt_parallel, OPT_U32, 2)   // probe this many mons at once when hunting; first to answer wins
+OPTION(mon_client_monmap_cache, OPT_STR, "")   // file to cache the latest monmap in between runs
 OPTION(mon_client_ping_interval, OPT_DOUBLE, 10.0)  // ping every N seconds
 OPTION(mon_client_ping_timeout, OPT_DOUBLE, 30.0)   // fail if we don't hear back
 OPTION(mon_client_hunt_interval_backoff, OPT_DOUBLE, 2.0) // each time we reconnect to a monitor, double our timeout
@@ -261,17 +276,21 @@ OPTION(client_trace, OPT_STR, "")
 OPTION(client_readahead_min, OPT_LONGLONG, 128*1024)  // readahead at _least_ this much.
 OPTION(client_readahead_max_bytes, OPT_LONGLONG, 0)  //8 * 1024*1024
 OPTION(client_readahead_max_periods, OPT_LONGLONG, 4)  // as multiple of file layout period (object size * num stripes)
+OPTION(client_readahead_stride_reads, OPT_INT, 4)  // chunks to prefetch once a constant read stride is detected (0 = off)
 OPTION(client_snapdir, OPT_STR, ".snap")
 OPTION(client_mountpoint, OPT_STR, "/")
 OPTION(client_notify_timeout, OPT_INT, 10) // in seconds
 OPTION(osd_client_watch_timeout, OPT_INT, 30) // in seconds
 OPTION(client_caps_release_delay, OPT_INT, 5) // in seconds
+OPTION(client_max_cap_releases, OPT_INT, 4096)
+OPTION(client_caps_soft_limit, OPT_INT, 0)  // proactively trim session caps above this on tick (0 = only when the mds recalls)  // flush the queued cap release message once this many are pending
 OPTION(client_oc, OPT_BOOL, true)
 OPTION(client_oc_size, OPT_INT, 1024*1024* 200)    // MB * n
 OPTION(client_oc_max_dirty, OPT_INT, 1024*1024* 100)    // MB * n  (dirty OR tx.. bigish)
 OPTION(client_oc_target_dirty, OPT_INT, 1024*1024* 8) // target dirty (keep this smallish)
 OPTION(client_oc_max_dirty_age, OPT_DOUBLE, 5.0)      // max age in cache before writeback
 OPTION(client_oc_max_objects, OPT_INT, 1000)      // max objects in cache
+OPTION(objectcacher_max_trim_per_call, OPT_INT, 1024)  // max lru evictions per trim pass (<0 = unbounded)
 OPTION(client_debug_force_sync_read, OPT_BOOL, false)     // always read synchronously (go to osds)
 OPTION(client_debug_inject_tick_delay, OPT_INT, 0) // delay the client tick for a number of seconds
 OPTION(client_max_inline_size, OPT_U64, 4096)
@@ -286,19 +305,25 @@ OPTION(fuse_multithreaded, OPT_BOOL, false)
 
 OPTION(crush_location, OPT_STR, "")       // whitespace-separated list of key=value pairs describing crush location
 
+OPTION(filer_max_purge_ops, OPT_U32, 10)  // max in-flight object deletes per purge_range
 OPTION(objecter_tick_interval, OPT_DOUBLE, 5.0)
 OPTION(objecter_timeout, OPT_DOUBLE, 10.0)    // before we ask for a map
 OPTION(objecter_inflight_op_bytes, OPT_U64, 1024*1024*100) // max in-flight data (both directions)
 OPTION(objecter_inflight_ops, OPT_U64, 1024)               // max in-flight ios
+OPTION(objecter_trace_every, OPT_U64, 0) // mark every nth op for cross-daemon tracing (0 = off)
 OPTION(journaler_allow_split_entries, OPT_BOOL, true)
 OPTION(journaler_write_head_interval, OPT_INT, 15)
 OPTION(journaler_prefetch_periods, OPT_INT, 10)   // * journal object size
+OPTION(journaler_prefetch_stripe_reads, OPT_BOOL, true) // issue prefetch per stripe unit, not per period
 OPTION(journaler_prezero_periods, OPT_INT, 5)     // * journal object size
+OPTION(journaler_write_head_max_lag, OPT_U64, 0)  // write head once safe_pos leads it by this many bytes; 0 = interval only
+OPTION(journaler_coalesce_stripe_writes, OPT_BOOL, false) // flush filled stripe units eagerly, buffering the partial tail
 OPTION(journaler_batch_interval, OPT_DOUBLE, .001)   // seconds.. max add'l latency we artificially incur
 OPTION(journaler_batch_max, OPT_U64, 0)  // max bytes we'll delay flushing; disable, for now....
 OPTION(mds_data, OPT_STR, "/var/lib/ceph/mds/$cluster-$id")
 OPTION(mds_max_file_size, OPT_U64, 1ULL << 40)
 OPTION(mds_cache_size, OPT_INT, 100000)
+OPTION(mds_max_purge_files, OPT_U32, 64)  // max stray files purging in parallel; 0 for no limit
 OPTION(mds_cache_mid, OPT_FLOAT, .7)
 OPTION(mds_mem_max, OPT_INT, 1048576)        // KB
 OPTION(mds_dir_max_commit_size, OPT_INT, 10) // MB
@@ -325,7 +350,10 @@ OPTION(mds_log_segment_size, OPT_INT, 0)  // segment size for mds log,
 	      // defaults to g_default_file_layout.fl_object_size (4MB)
 OPTION(mds_log_max_segments, OPT_INT, 30)
 OPTION(mds_log_max_expiring, OPT_INT, 20)
+OPTION(mds_log_max_expiring_ops, OPT_INT, 1024) // max outstanding segment expiry completions (0 = no limit)
+OPTION(mds_readdir_prefetch_frags, OPT_INT, 4)  // max sibling dirfrags to prefetch on readdir of an incomplete frag
 OPTION(mds_bal_sample_interval, OPT_FLOAT, 3.0)  // every 5 seconds
+OPTION(mds_bal_hit_sample, OPT_INT, 1)        // account only 1 in N hits, scaled by N (1 = every hit)
 OPTION(mds_bal_replicate_threshold, OPT_FLOAT, 8000)
 OPTION(mds_bal_unreplicate_threshold, OPT_FLOAT, 0)
 OPTION(mds_bal_frag, OPT_BOOL, false)
@@ -343,6 +371,7 @@ OPTION(mds_bal_max, OPT_INT, -1)
 OPTION(mds_bal_max_until, OPT_INT, -1)
 OPTION(mds_bal_mode, OPT_INT, 0)
 OPTION(mds_bal_min_rebalance, OPT_FLOAT, .1)  // must be this much above average before we export anything
+OPTION(mds_bal_overload_epochs, OPT_INT, 2)   // must be overloaded this many heartbeats before we export anything
 OPTION(mds_bal_min_start, OPT_FLOAT, .2)      // if we need less than this, we don't do anything
 OPTION(mds_bal_need_min, OPT_FLOAT, .8)       // take within this range of what we need
 OPTION(mds_bal_need_max, OPT_FLOAT, 1.2)
@@ -400,8 +429,20 @@ OPTION(osd_backfill_full_ratio, OPT_FLOAT, 0.85)
 // Seconds to wait before retrying refused backfills
 OPTION(osd_backfill_retry_interval, OPT_DOUBLE, 10.0)
 
+// If true, scale the number of backfill reservation grants between 1
+// and osd_max_backfills based on the measured apply latency of the
+// local store, so a saturated device sheds concurrent backfills
+// instead of convoying them
+OPTION(osd_backfill_reservation_adaptive, OPT_BOOL, false)
+
+// Apply latency (ms) above which an osd starts shedding backfill
+// reservation grants; grants grow back once latency drops below half
+// this value
+OPTION(osd_backfill_apply_latency_high, OPT_INT, 1000)
+
 // max agent flush ops
 OPTION(osd_agent_max_ops, OPT_INT, 4)
+OPTION(osd_agent_threads, OPT_INT, 1) // workers draining the tiering agent queue
 OPTION(osd_agent_min_evict_effort, OPT_FLOAT, .1)
 OPTION(osd_agent_quantize_effort, OPT_FLOAT, .1)
 OPTION(osd_agent_delay_time, OPT_FLOAT, 5.0)
@@ -413,6 +454,11 @@ OPTION(osd_agent_hist_halflife, OPT_INT, 1000)
 // this amount below the threshold to disable.
 OPTION(osd_agent_slop, OPT_FLOAT, .02)
 
+// in-osd cache of hot object reads; 0 disables
+OPTION(osd_read_cache_size, OPT_U64, 0)
+OPTION(osd_read_cache_shards, OPT_U32, 8)
+OPTION(osd_read_cache_max_extent, OPT_U64, 64*1024) // don't cache reads larger than this
+
 OPTION(osd_uuid, OPT_UUID, uuid_d())
 OPTION(osd_data, OPT_STR, "/var/lib/ceph/osd/$cluster-$id")
 OPTION(osd_journal, OPT_STR, "/var/lib/ceph/osd/$cluster-$id/journal")
@@ -457,9 +503,14 @@ OPTION(osd_tier_default_cache_hit_set_type, OPT_STR, "bloom")
 OPTION(osd_map_dedup, OPT_BOOL, true)
 OPTION(osd_map_max_advance, OPT_INT, 200) // make this < cache_size!
 OPTION(osd_map_cache_size, OPT_INT, 500)
+OPTION(osd_memory_target, OPT_U64, 0) // shrink registered caches to keep rss near this many bytes (0 = off)
+OPTION(osd_memory_balance_interval, OPT_FLOAT, 30) // seconds between cache budget rebalances
 OPTION(osd_map_message_max, OPT_INT, 100)  // max maps per MOSDMap message
 OPTION(osd_map_share_max_epochs, OPT_INT, 100)  // cap on # of inc maps we send to peers, clients
 OPTION(osd_op_threads, OPT_INT, 2)    // 0 == no threading
+OPTION(osd_pg_load_threads, OPT_INT, 1)  // threads reading pg metadata at startup (1 == serial)
+OPTION(osd_op_num_shards, OPT_INT, 0)  // 0 == single op queue; > 0, shard op queue by pg, one thread pool per shard
+OPTION(osd_op_num_threads_per_shard, OPT_INT, 2)
 OPTION(osd_peering_wq_batch_size, OPT_U64, 20)
 OPTION(osd_op_pq_max_tokens_per_priority, OPT_U64, 4194304)
 OPTION(osd_op_pq_min_cost, OPT_U64, 65536)
@@ -477,6 +528,8 @@ OPTION(osd_op_thread_timeout, OPT_INT, 15)
 OPTION(osd_recovery_thread_timeout, OPT_INT, 30)
 OPTION(osd_snap_trim_thread_timeout, OPT_INT, 60*60*1)
 OPTION(osd_snap_trim_sleep, OPT_FLOAT, 0)
+OPTION(osd_snap_trim_batch_size, OPT_U32, 16) // objects fetched/trimmed per trimmer wakeup
+OPTION(osd_snap_trim_cost_budget, OPT_U64, 16<<20) // clone bytes trimmed per trimmer wakeup, 0 disables
 OPTION(osd_scrub_thread_timeout, OPT_INT, 60)
 OPTION(osd_scrub_finalize_thread_timeout, OPT_INT, 60*10)
 OPTION(osd_scrub_invalid_stats, OPT_BOOL, true)
@@ -487,6 +540,8 @@ OPTION(osd_age_time, OPT_INT, 0)
 OPTION(osd_heartbeat_addr, OPT_ADDR, entity_addr_t())
 OPTION(osd_heartbeat_interval, OPT_INT, 6)       // (seconds) how often we ping peers
 OPTION(osd_heartbeat_grace, OPT_INT, 20)         // (seconds) how long before we decide a peer has failed
+OPTION(osd_heartbeat_use_min_delay_socket, OPT_BOOL, false) // prio the heartbeat tcp socket and set dscp as minimal delay
+OPTION(osd_heartbeat_thread_rt_priority, OPT_INT, 0) // SCHED_RR priority for the heartbeat thread so pings go out on time under load (0 = normal scheduling)
 OPTION(osd_heartbeat_min_peers, OPT_INT, 10)     // minimum number of peers
 
 // minimum number of peers tha tmust be reachable to mark ourselves
@@ -497,14 +552,17 @@ OPTION(osd_mon_heartbeat_interval, OPT_INT, 30)  // (seconds) how often to ping
 OPTION(osd_mon_report_interval_max, OPT_INT, 120)
 OPTION(osd_mon_report_interval_min, OPT_INT, 5)  // pg stats, failures, up_thru, boot.
 OPTION(osd_pg_stat_report_interval_max, OPT_INT, 500)  // report pg stats for any given pg at least this often
+OPTION(osd_pg_stat_resend_interval, OPT_INT, 120)  // (seconds) resend pg stats the mon has not acked at least this often
 OPTION(osd_mon_ack_timeout, OPT_INT, 30) // time out a mon if it doesn't ack stats
 OPTION(osd_default_data_pool_replay_window, OPT_INT, 45)
 OPTION(osd_preserve_trimmed_log, OPT_BOOL, false)
 OPTION(osd_auto_mark_unfound_lost, OPT_BOOL, false)
+OPTION(osd_async_recovery, OPT_BOOL, false) // let writes proceed while replicas catch up through recovery
 OPTION(osd_recovery_delay_start, OPT_FLOAT, 0)
 OPTION(osd_recovery_max_active, OPT_INT, 15)
 OPTION(osd_recovery_max_single_start, OPT_INT, 5)
 OPTION(osd_recovery_max_chunk, OPT_U64, 8<<20)  // max size of push chunk
+OPTION(osd_recovery_push_window, OPT_INT, 1)  // push chunks kept in flight per object/peer; >1 pipelines large objects over high-latency links
 OPTION(osd_copyfrom_max_chunk, OPT_U64, 8<<20)   // max size of a COPYFROM chunk
 OPTION(osd_push_per_object_cost, OPT_U64, 1000)  // push cost per object
 OPTION(osd_max_push_cost, OPT_U64, 8<<20)  // max size of push message
@@ -516,6 +574,8 @@ OPTION(osd_scrub_min_interval, OPT_FLOAT, 60*60*24)    // if load is low
 OPTION(osd_scrub_max_interval, OPT_FLOAT, 7*60*60*24)  // regardless of load
 OPTION(osd_scrub_chunk_min, OPT_INT, 5)
 OPTION(osd_scrub_chunk_max, OPT_INT, 25)
+OPTION(osd_scrub_chunk_max_bytes, OPT_U64, 8*1024*1024) // shrink chunks below osd_scrub_chunk_max when map entries are large, to bound in-memory scrub map size
+OPTION(osd_scrub_sleep, OPT_FLOAT, 0)   // sleep between scrub chunks so client io can interleave
 OPTION(osd_deep_scrub_interval, OPT_FLOAT, 60*60*24*7) // once a week
 OPTION(osd_deep_scrub_stride, OPT_INT, 524288)
 OPTION(osd_scan_list_ping_tp_interval, OPT_U64, 100)
@@ -533,6 +593,7 @@ OPTION(osd_pg_epoch_persisted_max_stale, OPT_U32, 200)
 
 OPTION(osd_min_pg_log_entries, OPT_U32, 3000)  // number of entries to keep in the pg log when trimming it
 OPTION(osd_max_pg_log_entries, OPT_U32, 10000) // max entries, say when degraded, before we trim
+OPTION(osd_pg_log_trim_max, OPT_U32, 0) // max entries to trim per call (0 == no bound); the rest goes on later calls
 OPTION(osd_op_complaint_time, OPT_FLOAT, 30) // how many seconds old makes an op complaint-worthy
 OPTION(osd_command_max_records, OPT_INT, 256)
 OPTION(osd_op_log_threshold, OPT_INT, 5) // how many op log messages to show in one go
@@ -548,8 +609,11 @@ OPTION(osd_debug_verify_stray_on_activate, OPT_BOOL, false)
 OPTION(osd_debug_skip_full_check_in_backfill_reservation, OPT_BOOL, false)
 OPTION(osd_debug_reject_backfill_probability, OPT_DOUBLE, 0)
 OPTION(osd_enable_op_tracker, OPT_BOOL, true) // enable/disable OSD op tracking
+OPTION(osd_num_op_tracker_shard, OPT_U32, 32) // The number of shards for holding the ops
 OPTION(osd_op_history_size, OPT_U32, 20)    // Max number of completed ops to track
 OPTION(osd_op_history_duration, OPT_U32, 600) // Oldest completed op to track
+OPTION(osd_op_capture_file, OPT_STR, "") // record the shape of incoming client ops (no payloads) to this file; "" disables
+OPTION(osd_op_capture_every, OPT_U64, 1) // record every Nth op (sampling for busy OSDs)
 OPTION(osd_target_transaction_size, OPT_INT, 30)     // to adjust various transactions that batch smaller items
 OPTION(osd_failsafe_full_ratio, OPT_FLOAT, .97) // what % full makes an OSD "full" (failsafe)
 OPTION(osd_failsafe_nearfull_ratio, OPT_FLOAT, .90) // what % full makes an OSD near full (failsafe)
@@ -567,6 +631,7 @@ OPTION(osd_debug_pg_log_writeout, OPT_BOOL, false)
 
 OPTION(leveldb_write_buffer_size, OPT_U64, 8 *1024*1024) // leveldb write buffer size
 OPTION(leveldb_cache_size, OPT_U64, 128 *1024*1024) // leveldb cache size
+OPTION(leveldb_cache_shared, OPT_BOOL, false) // share one block cache between all leveldb stores in the process
 OPTION(leveldb_block_size, OPT_U64, 0) // leveldb block size
 OPTION(leveldb_bloom_size, OPT_INT, 0) // leveldb bloom bits per entry
 OPTION(leveldb_max_open_files, OPT_INT, 0) // leveldb max open files
@@ -574,6 +639,7 @@ OPTION(leveldb_compression, OPT_BOOL, true) // leveldb uses compression
 OPTION(leveldb_paranoid, OPT_BOOL, false) // leveldb paranoid flag
 OPTION(leveldb_log, OPT_STR, "/dev/null")  // enable leveldb log file
 OPTION(leveldb_compact_on_mount, OPT_BOOL, false)
+OPTION(leveldb_compact_pause, OPT_DOUBLE, 0) // seconds to pause between queued background range compactions
 
 /**
  * osd_client_op_priority and osd_recovery_op_priority adjust the relative
@@ -588,6 +654,10 @@ OPTION(leveldb_compact_on_mount, OPT_BOOL, false)
  */
 OPTION(osd_client_op_priority, OPT_U32, 63)
 OPTION(osd_recovery_op_priority, OPT_U32, 10)
+// minimum percent of op queue bandwidth reserved for each class,
+// regardless of what else is queued (0 == purely proportional)
+OPTION(osd_op_queue_client_share_min, OPT_U32, 0)
+OPTION(osd_op_queue_recovery_share_min, OPT_U32, 0)
 OPTION(osd_recovery_op_warn_multiple, OPT_U32, 16)
 
 // Max time to wait between notifying mon of shutdown and shutting down
@@ -624,6 +694,9 @@ OPTION(filestore_wbthrottle_xfs_inodes_start_flusher, OPT_U64, 500)
 /// These must be less than the fd limit
 OPTION(filestore_wbthrottle_btrfs_inodes_hard_limit, OPT_U64, 5000)
 OPTION(filestore_wbthrottle_xfs_inodes_hard_limit, OPT_U64, 5000)
+// scale the wbthrottle limits by measured flush latency (per device)
+OPTION(filestore_wbthrottle_adaptive, OPT_BOOL, false)
+OPTION(filestore_wbthrottle_flush_latency_target, OPT_DOUBLE, .5)
 
 // Tests index failure paths
 OPTION(filestore_index_retry_probability, OPT_DOUBLE, 0)
@@ -632,7 +705,12 @@ OPTION(filestore_index_retry_probability, OPT_DOUBLE, 0)
 OPTION(filestore_debug_inject_read_err, OPT_BOOL, false)
 
 OPTION(filestore_debug_omap_check, OPT_BOOL, 0) // Expensive debugging check on sync
-OPTION(filestore_omap_header_cache_size, OPT_INT, 1024) 
+OPTION(filestore_omap_header_cache_size, OPT_INT, 1024)
+OPTION(filestore_omap_flatten_on_write, OPT_BOOL, false) // collapse omap clone chains on set_keys
+OPTION(filestore_omap_background_flatten, OPT_BOOL, false) // flatten deep omap clone chains in the background
+OPTION(filestore_omap_flatten_interval, OPT_FLOAT, 30) // seconds between background flatten scans
+OPTION(filestore_omap_flatten_min_depth, OPT_INT, 3) // only flatten chains at least this deep
+OPTION(filestore_omap_flatten_max_per_cycle, OPT_U64, 64) // cap objects flattened per scan
 
 // Use omap for xattrs for attrs over
 // filestore_max_inline_xattr_size or
@@ -652,6 +730,16 @@ OPTION(filestore_sloppy_crc_block_size, OPT_INT, 65536)
 
 OPTION(filestore_max_alloc_hint_size, OPT_U64, 1ULL << 20) // bytes
 
+// keep data for objects up to this size inline in the omap kv store
+// (0 = disabled); the backing file stays zero-length until the object
+// outgrows the threshold
+OPTION(filestore_inline_data_size, OPT_U64, 0)
+
+// maintain an ordered object index in the omap kv store for newly
+// created collections, so listing them is a range scan instead of a
+// readdir walk; pre-existing collections keep using the dir index
+OPTION(filestore_collection_index, OPT_BOOL, false)
+
 OPTION(filestore_max_sync_interval, OPT_DOUBLE, 5)    // seconds
 OPTION(filestore_min_sync_interval, OPT_DOUBLE, .01)  // seconds
 OPTION(filestore_btrfs_snap, OPT_BOOL, true)
@@ -676,6 +764,9 @@ OPTION(filestore_split_multiple, OPT_INT, 2)
 OPTION(filestore_update_to, OPT_INT, 1000)
 OPTION(filestore_blackhole, OPT_BOOL, false)     // drop any new transactions on the floor
 OPTION(filestore_fd_cache_size, OPT_INT, 128)    // FD lru size
+OPTION(filestore_fd_cache_shards, OPT_INT, 16)   // FD number of shards
+OPTION(filestore_aio_reads, OPT_BOOL, false)     // use libaio + O_DIRECT for aio_read (requires libaio)
+OPTION(filestore_aio_read_depth, OPT_INT, 128)   // max aio reads in flight
 OPTION(filestore_dump_file, OPT_STR, "")         // file onto which store transaction dumps
 OPTION(filestore_kill_at, OPT_INT, 0)            // inject a failure at the n'th opportunity
 OPTION(filestore_inject_stall, OPT_INT, 0)       // artificially stall for N seconds in op queue thread
@@ -692,6 +783,18 @@ OPTION(keyvaluestore_debug_check_backend, OPT_BOOL, 0) // Expensive debugging ch
 OPTION(keyvaluestore_op_threads, OPT_INT, 2)
 OPTION(keyvaluestore_op_thread_timeout, OPT_INT, 60)
 OPTION(keyvaluestore_op_thread_suicide_timeout, OPT_INT, 180)
+OPTION(keyvaluestore_parallel_apply, OPT_BOOL, true) // apply ops on disjoint objects in parallel
+OPTION(keyvaluestore_default_strip_size, OPT_INT, 1024) // size of the values object data is striped into
+OPTION(keyvaluestore_pool_strip_size, OPT_STR, "") // per-pool strip size overrides, "<pool>=<size>[,<pool>=<size>]"; affects new objects only
+OPTION(keyvaluestore_batch_sync, OPT_BOOL, false) // withhold ondisk acks and group transactions per backend sync
+OPTION(keyvaluestore_max_sync_interval, OPT_DOUBLE, .1) // seconds between batched syncs
+OPTION(keyvaluestore_sync_max_ops, OPT_INT, 256) // sync earlier once this many ops are waiting
+
+OPTION(memstore_max_bytes, OPT_U64, 0) // resident object bytes before cold objects spill to the backing store (0 = unbounded)
+OPTION(memstore_backing_type, OPT_STR, "") // ObjectStore type cold objects spill to ("" = none)
+OPTION(memstore_backing_path, OPT_STR, "") // data path for the backing store
+OPTION(memstore_backing_journal, OPT_STR, "") // journal path for the backing store
+OPTION(memstore_snapshot_interval, OPT_DOUBLE, 0) // seconds between snapshots of resident state (0 = only at umount)
 
 // max bytes to search ahead in journal searching for corruption
 OPTION(journal_max_corrupt_search, OPT_U64, 10<<20)
@@ -699,6 +802,8 @@ OPTION(journal_block_align, OPT_BOOL, true)
 OPTION(journal_write_header_frequency, OPT_U64, 0)
 OPTION(journal_max_write_bytes, OPT_INT, 10 << 20)
 OPTION(journal_max_write_entries, OPT_INT, 100)
+OPTION(journal_batch_interval, OPT_DOUBLE, 0)     // group-commit latency budget in seconds; 0 writes as soon as anything is queued
+OPTION(journal_aio_queue_depth, OPT_INT, 0)       // >0: fixed aio in-flight window (flash); 0: adaptive batching heuristic (spindles)
 OPTION(journal_queue_max_ops, OPT_INT, 300)
 OPTION(journal_queue_max_bytes, OPT_INT, 32 << 20)
 OPTION(journal_align_min_size, OPT_INT, 64 << 10)  // align data payloads >= this.
@@ -708,6 +813,7 @@ OPTION(journal_ignore_corruption, OPT_BOOL, false) // assume journal is not corr
 
 OPTION(rados_mon_op_timeout, OPT_DOUBLE, 0) // how many seconds to wait for a response from the monitor before returning an error from a rados operation. 0 means on limit.
 OPTION(rados_osd_op_timeout, OPT_DOUBLE, 0) // how many seconds to wait for a response from osds before returning an error from a rados operation. 0 means no limit.
+OPTION(rados_client_finishers, OPT_INT, 1) // callback threads; >1 drops global callback ordering (per-completion ordering is kept)
 
 OPTION(rbd_cache, OPT_BOOL, false) // whether to enable caching (writeback unless rbd_cache_max_dirty is 0)
 OPTION(rbd_cache_writethrough_until_flush, OPT_BOOL, false) // whether to make writeback caching writethrough until flush is called, to be sure the user of librbd will send flushs so that writeback is safe
@@ -717,10 +823,14 @@ OPTION(rbd_cache_target_dirty, OPT_LONGLONG, 16<<20) // target dirty limit in by
 OPTION(rbd_cache_max_dirty_age, OPT_FLOAT, 1.0)      // seconds in cache before writeback starts
 OPTION(rbd_cache_block_writes_upfront, OPT_BOOL, false) // whether to block writes to the cache before the aio_write call completes (true), or block before the aio completion is called (false)
 OPTION(rbd_concurrent_management_ops, OPT_INT, 10) // how many operations can be in flight for a management operation like deleting or resizing an image
+OPTION(rbd_flatten_chunk_size, OPT_U64, 1024) // objects copied between flatten checkpoints; an interrupted flatten resumes from the last checkpoint. 0 disables checkpointing
+OPTION(rbd_flatten_sleep, OPT_FLOAT, 0) // seconds to sleep between flatten chunks, to pace a flatten running in the background
 OPTION(rbd_balance_snap_reads, OPT_BOOL, false)
 OPTION(rbd_localize_snap_reads, OPT_BOOL, false)
 OPTION(rbd_balance_parent_reads, OPT_BOOL, false)
 OPTION(rbd_localize_parent_reads, OPT_BOOL, true)
+OPTION(rbd_clone_copy_on_read, OPT_BOOL, false) // copy the object into the clone after a read is served from the parent, so repeated reads hit the child
+OPTION(rbd_discard_coalesce_window, OPT_INT, 0) // ms to hold guest discards for merging before issuing them; 0 disables coalescing
 
 /*
  * The following options change the behavior for librbd's image creation methods that
@@ -753,6 +863,7 @@ OPTION(rgw_data, OPT_STR, "/var/lib/ceph/radosgw/$cluster-$id")
 OPTION(rgw_enable_apis, OPT_STR, "s3, swift, swift_auth, admin")
 OPTION(rgw_cache_enabled, OPT_BOOL, true)   // rgw cache enabled
 OPTION(rgw_cache_lru_size, OPT_INT, 10000)   // num of entries in rgw cache
+OPTION(rgw_cache_shards, OPT_INT, 8)   // number of independently locked shards the rgw cache is split into
 OPTION(rgw_socket_path, OPT_STR, "")   // path to unix domain socket, if not specified, rgw will not run as external fcgi
 OPTION(rgw_host, OPT_STR, "")  // host for radosgw, can be an IP, default is 0.0.0.0
 OPTION(rgw_port, OPT_STR, "")  // port to listen, format as "8080" "5000", if not specified, rgw will not run external fcgi
@@ -799,6 +910,10 @@ OPTION(rgw_enable_usage_log, OPT_BOOL, false) // enable logging bandwidth usage
 OPTION(rgw_ops_log_rados, OPT_BOOL, true) // whether ops log should go to rados
 OPTION(rgw_ops_log_socket_path, OPT_STR, "") // path to unix domain socket where ops log can go
 OPTION(rgw_ops_log_data_backlog, OPT_INT, 5 << 20) // max data backlog for ops log
+OPTION(rgw_ops_log_flush_threshold, OPT_INT, 1024) // flush pending rados ops log entries when this many accumulate
+OPTION(rgw_ops_log_tick_interval, OPT_INT, 30) // flush pending rados ops log data every X seconds
+OPTION(rgw_qos_max_queue_length, OPT_INT, 1024) // requests queued beyond this are answered 503, 0 disables
+OPTION(rgw_qos_retry_after_secs, OPT_INT, 2) // Retry-After returned with the 503 on overload
 OPTION(rgw_usage_log_flush_threshold, OPT_INT, 1024) // threshold to flush pending log data
 OPTION(rgw_usage_log_tick_interval, OPT_INT, 30) // flush pending log data every X seconds
 OPTION(rgw_intent_log_object_name, OPT_STR, "%Y-%m-%d-%i-%n")  // man date to see codes (a subset are supported)
@@ -809,6 +924,8 @@ OPTION(rgw_gc_max_objs, OPT_INT, 32)
 OPTION(rgw_gc_obj_min_wait, OPT_INT, 2 * 3600)    // wait time before object may be handled by gc
 OPTION(rgw_gc_processor_max_time, OPT_INT, 3600)  // total run time for a single gc processor work
 OPTION(rgw_gc_processor_period, OPT_INT, 3600)  // gc processor cycle time
+OPTION(rgw_gc_processor_threads, OPT_INT, 4)  // number of concurrent gc worker threads, shards are split among them
+OPTION(rgw_gc_max_concurrent_io, OPT_INT, 10)  // max concurrent chained object removals per gc worker
 OPTION(rgw_s3_success_create_obj_status, OPT_INT, 0) // alternative success status response for create-obj (0 - default)
 OPTION(rgw_resolve_cname, OPT_BOOL, false)  // should rgw try to resolve hostname as a dns cname record
 OPTION(rgw_obj_stripe_size, OPT_INT, 4 << 20)
@@ -829,6 +946,7 @@ OPTION(rgw_copy_obj_progress_every_bytes, OPT_INT, 1024 * 1024) // min bytes bet
 OPTION(rgw_data_log_window, OPT_INT, 30) // data log entries window (in seconds)
 OPTION(rgw_data_log_changes_size, OPT_INT, 1000) // number of in-memory entries to hold for data changes log
 OPTION(rgw_data_log_num_shards, OPT_INT, 128) // number of objects to keep data changes log on
+OPTION(rgw_bucket_index_max_shards, OPT_INT, 0) // number of shards for new bucket indexes, 0 keeps a single (unsharded) index object
 OPTION(rgw_data_log_obj_prefix, OPT_STR, "data_log") // 
 OPTION(rgw_replica_log_obj_prefix, OPT_STR, "replica_log") // 
 
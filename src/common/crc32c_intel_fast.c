@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "acconfig.h"
 #include "include/int_types.h"
 #include "common/crc32c_intel_baseline.h"
@@ -36,6 +38,42 @@ int ceph_crc32c_intel_fast_exists(void)
 	return 1;
 }
 
+#elif defined(__x86_64__)
+
+/*
+ * No usable yasm, so no pipelined asm version; fall back to a simple
+ * crc32q/crc32b loop in inline asm.  This doesn't overlap the three
+ * crc streams like the asm version does, but it is still roughly an
+ * order of magnitude faster than the table-driven baseline.  We are
+ * only ever called if the runtime probe found SSE 4.2, so the
+ * instructions are safe to issue unconditionally.
+ */
+uint32_t ceph_crc32c_intel_fast(uint32_t crc, unsigned char const *buffer, unsigned len)
+{
+	uint64_t c = crc;
+
+	while (len >= 8) {
+		uint64_t v = 0;
+		if (buffer) {
+			memcpy(&v, buffer, 8);
+			buffer += 8;
+		}
+		__asm__ __volatile__("crc32q %1, %0" : "+r" (c) : "rm" (v));
+		len -= 8;
+	}
+	while (len > 0) {
+		unsigned char b = buffer ? *buffer++ : 0;
+		__asm__ __volatile__("crc32b %1, %0" : "+r" (c) : "rm" (b));
+		len--;
+	}
+	return (uint32_t)c;
+}
+
+int ceph_crc32c_intel_fast_exists(void)
+{
+	return 1;
+}
+
 #else
 
 int ceph_crc32c_intel_fast_exists(void)
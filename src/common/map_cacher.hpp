@@ -21,6 +21,7 @@
 #include <set>
 #include <map>
 #include <utility>
+#include <vector>
 #include <string>
 #include <errno.h>
 
@@ -69,6 +70,30 @@ public:
     pair<K, V> *next    ///< [out] first key after key
     ) = 0; ///< @return 0 on success, -ENOENT if there is no next
 
+  /**
+   * Returns up to max pairs after key, in order.  Drivers that can
+   * iterate natively should override this; the default does a seek
+   * per pair.
+   */
+  virtual int get_next_batch(
+    const K &key,       ///< [in] key after which to fetch
+    size_t max,         ///< [in] max pairs to return
+    std::vector<pair<K, V> > *out ///< [out] pairs fetched
+    ) {
+    K cur = key;
+    while (out->size() < max) {
+      pair<K, V> next;
+      int r = get_next(cur, &next);
+      if (r == -ENOENT)
+	break;
+      if (r < 0)
+	return r;
+      cur = next.first;
+      out->push_back(next);
+    }
+    return out->empty() ? -ENOENT : 0;
+  } ///< @return 0 on success, -ENOENT if there are no more entries
+
   virtual ~StoreDriver() {}
 };
 
@@ -130,6 +155,55 @@ public:
     return -EINVAL;
   } ///< @return error value, 0 on success, -ENOENT if no more entries
 
+  /**
+   * Fetch up to max key/value pairs after key using one backend pass
+   * per window instead of a seek per pair.  As with get_next, cached
+   * in-progress updates override what the store returns.
+   */
+  int get_next_batch(
+    K key,                             ///< [in] key after which to fetch
+    size_t max,                        ///< [in] max pairs to return
+    std::vector<std::pair<K, V> > *out ///< [out] next pairs, in order
+    ) {
+    while (out->size() < max) {
+      size_t want = max - out->size();
+      std::vector<std::pair<K, V> > store;
+      int r = driver->get_next_batch(key, want, &store);
+      if (r < 0 && r != -ENOENT)
+	return r;
+      bool store_done = (store.size() < want);
+
+      // merge cached updates covering this window
+      typename std::vector<std::pair<K, V> >::iterator si = store.begin();
+      K cur = key;
+      while (out->size() < max) {
+	std::pair<K, boost::optional<V> > cached;
+	bool got_cached = in_progress.get_next(cur, &cached);
+	if (got_cached && !store_done &&
+	    cached.first > store.rbegin()->first)
+	  got_cached = false; // past this window; the next pass gets it
+	while (si != store.end() && si->first <= cur)
+	  ++si;
+	bool got_store = (si != store.end());
+	if (!got_cached && !got_store)
+	  break;
+	if (got_cached && (!got_store || cached.first <= si->first)) {
+	  cur = cached.first;
+	  if (cached.second)
+	    out->push_back(std::make_pair(cached.first, cached.second.get()));
+	  // else: value was cached as removed, skip it
+	} else {
+	  cur = si->first;
+	  out->push_back(*si);
+	}
+      }
+      if (store_done)
+	break;
+      key = store.rbegin()->first;
+    }
+    return out->empty() ? -ENOENT : 0;
+  } ///< @return error value, 0 on success, -ENOENT if no more entries
+
   /// Adds operation setting keys to Transaction
   void set_keys(
     const map<K, V> &keys,  ///< [in] keys/values to set
@@ -15,6 +15,7 @@
  * it will just loop forever.
  */
 #include "common/Cond.h"
+#include "common/Formatter.h"
 #include "obj_bencher.h"
 
 #include <iostream>
@@ -25,12 +26,17 @@
 #include <stdlib.h>
 #include <time.h>
 #include <sstream>
+#include <algorithm>
 #include <vector>
 
 
 const std::string BENCH_LASTRUN_METADATA = "benchmark_last_metadata";
 const std::string BENCH_PREFIX = "benchmark_data";
 
+// how many latencies we keep for percentile estimates; the reservoir
+// keeps memory bounded no matter how long the run is
+static const uint64_t LATENCY_RESERVOIR_SIZE = 65536;
+
 static std::string generate_object_prefix(int pid = 0) {
   char hostname[30];
   gethostname(hostname, sizeof(hostname)-1);
@@ -83,7 +89,7 @@ void *ObjBencher::status_printer(void *_bencher) {
   while(!data.done) {
     utime_t cur_time = ceph_clock_now(bencher->cct);
 
-    if (i % 20 == 0) {
+    if (i % 20 == 0 && !bencher->formatter) {
       if (i > 0)
 	cur_time.localtime(cout) << "min lat: " << data.min_latency
 	     << " max lat: " << data.max_latency
@@ -121,7 +127,8 @@ void *ObjBencher::status_printer(void *_bencher) {
     if (previous_writes != data.finished) {
       previous_writes = data.finished;
       cycleSinceChange = 0;
-      bencher->out(cout, cur_time) << setfill(' ')
+      if (!bencher->formatter)
+	bencher->out(cout, cur_time) << setfill(' ')
 	   << setw(5) << i
 	   << setw(8) << data.in_flight
 	   << setw(10) << data.started
@@ -131,7 +138,7 @@ void *ObjBencher::status_printer(void *_bencher) {
 	   << setw(10) << (double)data.cur_latency
 	   << setw(10) << data.avg_latency << std::endl;
     }
-    else {
+    else if (!bencher->formatter) {
       bencher->out(cout, cur_time) << setfill(' ')
 	   << setw(5) << i
 	   << setw(8) << data.in_flight
@@ -187,6 +194,8 @@ int ObjBencher::aio_bench(
   data.avg_latency = 0;
   data.idata.min_bandwidth = 99999999.0;
   data.idata.max_bandwidth = 0;
+  data.latency_samples.clear();
+  data.latency_ops = 0;
   data.object_contents = contentsChars;
   lock.Unlock();
 
@@ -264,6 +273,54 @@ static double vec_stddev(vector<double>& v)
   return sqrt(stddev);
 }
 
+static uint64_t rand64()
+{
+  // rand() only covers 31 bits; splice two draws so reservoir indexes
+  // stay unbiased once the op count exceeds RAND_MAX
+  return ((uint64_t)rand() << 31) | (uint64_t)rand();
+}
+
+static double vec_percentile(vector<double> v, double percentile)
+{
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  size_t pos = (size_t)((v.size() - 1) * percentile + 0.5);
+  return v[pos];
+}
+
+// feed data.cur_latency to the reservoir (Vitter's algorithm R): every
+// completed op has an equal chance of being retained, so the percentiles
+// we report are unbiased estimates for the whole run.  Called with lock
+// held, right after the min/max/avg bookkeeping.
+void ObjBencher::sample_latency()
+{
+  double lat = data.cur_latency;
+  ++data.latency_ops;
+  if (data.latency_samples.size() < LATENCY_RESERVOIR_SIZE) {
+    data.latency_samples.push_back(lat);
+  } else {
+    uint64_t j = rand64() % data.latency_ops;
+    if (j < LATENCY_RESERVOIR_SIZE)
+      data.latency_samples[j] = lat;
+  }
+}
+
+// open-loop pacing: each op gets a scheduled issue time derived from the
+// target rate, and we sleep out any head start before dispatching.  That
+// way queueing delay shows up in the measured latency instead of being
+// absorbed by the closed loop slowing down.
+void ObjBencher::rate_pace()
+{
+  if (target_iops <= 0)
+    return;
+  utime_t next = data.start_time;
+  next += (double)data.started / target_iops;
+  utime_t now = ceph_clock_now(cct);
+  if (now < next)
+    usleep((useconds_t)((double)(next - now) * 1000000.0));
+}
+
 int ObjBencher::fetch_bench_metadata(const std::string& metadata_file, int* object_size, int* num_objects, int* prevPid) {
   int r = 0;
   bufferlist object_data;
@@ -327,6 +384,7 @@ int ObjBencher::write_bench(int secondsToRun, int maxObjectsToCreate,
   data.start_time = ceph_clock_now(cct);
   lock.Unlock();
   for (int i = 0; i<concurrentios; ++i) {
+    rate_pace();
     start_times[i] = ceph_clock_now(cct);
     r = create_completion(i, _aio_cb, (void *)&lc);
     if (r < 0)
@@ -387,6 +445,7 @@ int ObjBencher::write_bench(int secondsToRun, int maxObjectsToCreate,
     total_latency += data.cur_latency;
     if( data.cur_latency > data.max_latency) data.max_latency = data.cur_latency;
     if (data.cur_latency < data.min_latency) data.min_latency = data.cur_latency;
+    sample_latency();
     ++data.finished;
     data.avg_latency = total_latency / data.finished;
     --data.in_flight;
@@ -396,6 +455,7 @@ int ObjBencher::write_bench(int secondsToRun, int maxObjectsToCreate,
 
     //write new stuff to backend, then delete old stuff
     //and save locations of new stuff for later deletion
+    rate_pace();
     start_times[slot] = ceph_clock_now(cct);
     r = create_completion(slot, _aio_cb, &lc);
     if (r < 0)
@@ -428,6 +488,7 @@ int ObjBencher::write_bench(int secondsToRun, int maxObjectsToCreate,
     total_latency += data.cur_latency;
     if (data.cur_latency > data.max_latency) data.max_latency = data.cur_latency;
     if (data.cur_latency < data.min_latency) data.min_latency = data.cur_latency;
+    sample_latency();
     ++data.finished;
     data.avg_latency = total_latency / data.finished;
     --data.in_flight;
@@ -449,7 +510,29 @@ int ObjBencher::write_bench(int secondsToRun, int maxObjectsToCreate,
   char bw[20];
   snprintf(bw, sizeof(bw), "%.3lf \n", bandwidth);
 
-  out(cout) << "Total time run:         " << timePassed << std::endl
+  if (formatter) {
+    formatter->open_object_section("bench");
+    formatter->dump_string("op", "write");
+    formatter->dump_float("total_time_run", (double)timePassed);
+    formatter->dump_int("total_writes_made", data.finished);
+    formatter->dump_int("write_size", data.object_size);
+    formatter->dump_float("bandwidth_mb_sec", bandwidth);
+    formatter->dump_float("stddev_bandwidth", vec_stddev(data.history.bandwidth));
+    formatter->dump_float("max_bandwidth_mb_sec", data.idata.max_bandwidth);
+    formatter->dump_float("min_bandwidth_mb_sec", data.idata.min_bandwidth);
+    formatter->dump_float("average_latency", data.avg_latency);
+    formatter->dump_float("stddev_latency", vec_stddev(data.history.latency));
+    formatter->dump_float("max_latency", data.max_latency);
+    formatter->dump_float("min_latency", data.min_latency);
+    formatter->dump_float("latency_p50", vec_percentile(data.latency_samples, 0.50));
+    formatter->dump_float("latency_p95", vec_percentile(data.latency_samples, 0.95));
+    formatter->dump_float("latency_p99", vec_percentile(data.latency_samples, 0.99));
+    formatter->dump_float("latency_p999", vec_percentile(data.latency_samples, 0.999));
+    formatter->close_section();
+    formatter->flush(cout);
+    cout << std::endl;
+  } else {
+    out(cout) << "Total time run:         " << timePassed << std::endl
        << "Total writes made:      " << data.finished << std::endl
        << "Write size:             " << data.object_size << std::endl
        << "Bandwidth (MB/sec):     " << bw << std::endl
@@ -459,7 +542,12 @@ int ObjBencher::write_bench(int secondsToRun, int maxObjectsToCreate,
        << "Average Latency:        " << data.avg_latency << std::endl
        << "Stddev Latency:         " << vec_stddev(data.history.latency) << std::endl
        << "Max latency:            " << data.max_latency << std::endl
-       << "Min latency:            " << data.min_latency << std::endl;
+       << "Min latency:            " << data.min_latency << std::endl
+       << "Latency p50:            " << vec_percentile(data.latency_samples, 0.50) << std::endl
+       << "Latency p95:            " << vec_percentile(data.latency_samples, 0.95) << std::endl
+       << "Latency p99:            " << vec_percentile(data.latency_samples, 0.99) << std::endl
+       << "Latency p99.9:          " << vec_percentile(data.latency_samples, 0.999) << std::endl;
+  }
 
   //write object size/number data for read benchmarks
   ::encode(data.object_size, b_write);
@@ -521,6 +609,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
   //start initial reads
   for (int i = 0; i < concurrentios; ++i) {
     index[i] = i;
+    rate_pace();
     start_times[i] = ceph_clock_now(cct);
     create_completion(i, _aio_cb, (void *)&lc);
     r = aio_read(name[i], i, contents[i], data.object_size);
@@ -576,6 +665,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
     total_latency += data.cur_latency;
     if( data.cur_latency > data.max_latency) data.max_latency = data.cur_latency;
     if (data.cur_latency < data.min_latency) data.min_latency = data.cur_latency;
+    sample_latency();
     ++data.finished;
     data.avg_latency = total_latency / data.finished;
     --data.in_flight;
@@ -584,6 +674,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
     cur_contents = contents[slot];
 
     //start new read and check data if requested
+    rate_pace();
     start_times[slot] = ceph_clock_now(cct);
     contents[slot] = new bufferlist();
     create_completion(slot, _aio_cb, (void *)&lc);
@@ -619,6 +710,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
     total_latency += data.cur_latency;
     if (data.cur_latency > data.max_latency) data.max_latency = data.cur_latency;
     if (data.cur_latency < data.min_latency) data.min_latency = data.cur_latency;
+    sample_latency();
     ++data.finished;
     data.avg_latency = total_latency / data.finished;
     --data.in_flight;
@@ -645,13 +737,36 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
   char bw[20];
   snprintf(bw, sizeof(bw), "%.3lf \n", bandwidth);
 
-  out(cout) << "Total time run:        " << runtime << std::endl
+  if (formatter) {
+    formatter->open_object_section("bench");
+    formatter->dump_string("op", "seq");
+    formatter->dump_float("total_time_run", (double)runtime);
+    formatter->dump_int("total_reads_made", data.finished);
+    formatter->dump_int("read_size", data.object_size);
+    formatter->dump_float("bandwidth_mb_sec", bandwidth);
+    formatter->dump_float("average_latency", data.avg_latency);
+    formatter->dump_float("max_latency", data.max_latency);
+    formatter->dump_float("min_latency", data.min_latency);
+    formatter->dump_float("latency_p50", vec_percentile(data.latency_samples, 0.50));
+    formatter->dump_float("latency_p95", vec_percentile(data.latency_samples, 0.95));
+    formatter->dump_float("latency_p99", vec_percentile(data.latency_samples, 0.99));
+    formatter->dump_float("latency_p999", vec_percentile(data.latency_samples, 0.999));
+    formatter->close_section();
+    formatter->flush(cout);
+    cout << std::endl;
+  } else {
+    out(cout) << "Total time run:        " << runtime << std::endl
        << "Total reads made:     " << data.finished << std::endl
        << "Read size:            " << data.object_size << std::endl
        << "Bandwidth (MB/sec):    " << bw << std::endl
        << "Average Latency:       " << data.avg_latency << std::endl
        << "Max latency:           " << data.max_latency << std::endl
-       << "Min latency:           " << data.min_latency << std::endl;
+       << "Min latency:           " << data.min_latency << std::endl
+       << "Latency p50:           " << vec_percentile(data.latency_samples, 0.50) << std::endl
+       << "Latency p95:           " << vec_percentile(data.latency_samples, 0.95) << std::endl
+       << "Latency p99:           " << vec_percentile(data.latency_samples, 0.99) << std::endl
+       << "Latency p99.9:         " << vec_percentile(data.latency_samples, 0.999) << std::endl;
+  }
 
   completions_done();
 
@@ -707,6 +822,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
   //start initial reads
   for (int i = 0; i < concurrentios; ++i) {
     index[i] = i;
+    rate_pace();
     start_times[i] = ceph_clock_now(g_ceph_context);
     create_completion(i, _aio_cb, (void *)&lc);
     r = aio_read(name[i], i, contents[i], data.object_size);
@@ -763,6 +879,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
     total_latency += data.cur_latency;
     if( data.cur_latency > data.max_latency) data.max_latency = data.cur_latency;
     if (data.cur_latency < data.min_latency) data.min_latency = data.cur_latency;
+    sample_latency();
     ++data.finished;
     data.avg_latency = total_latency / data.finished;
     --data.in_flight;
@@ -771,6 +888,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
     cur_contents = contents[slot];
 
     //start new read and check data if requested
+    rate_pace();
     start_times[slot] = ceph_clock_now(g_ceph_context);
     contents[slot] = new bufferlist();
     create_completion(slot, _aio_cb, (void *)&lc);
@@ -806,6 +924,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
     total_latency += data.cur_latency;
     if (data.cur_latency > data.max_latency) data.max_latency = data.cur_latency;
     if (data.cur_latency < data.min_latency) data.min_latency = data.cur_latency;
+    sample_latency();
     ++data.finished;
     data.avg_latency = total_latency / data.finished;
     --data.in_flight;
@@ -832,13 +951,36 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
   char bw[20];
   snprintf(bw, sizeof(bw), "%.3lf \n", bandwidth);
 
-  out(cout) << "Total time run:        " << runtime << std::endl
+  if (formatter) {
+    formatter->open_object_section("bench");
+    formatter->dump_string("op", "rand");
+    formatter->dump_float("total_time_run", (double)runtime);
+    formatter->dump_int("total_reads_made", data.finished);
+    formatter->dump_int("read_size", data.object_size);
+    formatter->dump_float("bandwidth_mb_sec", bandwidth);
+    formatter->dump_float("average_latency", data.avg_latency);
+    formatter->dump_float("max_latency", data.max_latency);
+    formatter->dump_float("min_latency", data.min_latency);
+    formatter->dump_float("latency_p50", vec_percentile(data.latency_samples, 0.50));
+    formatter->dump_float("latency_p95", vec_percentile(data.latency_samples, 0.95));
+    formatter->dump_float("latency_p99", vec_percentile(data.latency_samples, 0.99));
+    formatter->dump_float("latency_p999", vec_percentile(data.latency_samples, 0.999));
+    formatter->close_section();
+    formatter->flush(cout);
+    cout << std::endl;
+  } else {
+    out(cout) << "Total time run:        " << runtime << std::endl
        << "Total reads made:     " << data.finished << std::endl
        << "Read size:            " << data.object_size << std::endl
        << "Bandwidth (MB/sec):    " << bw << std::endl
        << "Average Latency:       " << data.avg_latency << std::endl
        << "Max latency:           " << data.max_latency << std::endl
-       << "Min latency:           " << data.min_latency << std::endl;
+       << "Min latency:           " << data.min_latency << std::endl
+       << "Latency p50:           " << vec_percentile(data.latency_samples, 0.50) << std::endl
+       << "Latency p95:           " << vec_percentile(data.latency_samples, 0.95) << std::endl
+       << "Latency p99:           " << vec_percentile(data.latency_samples, 0.99) << std::endl
+       << "Latency p99.9:         " << vec_percentile(data.latency_samples, 0.999) << std::endl;
+  }
 
   completions_done();
 
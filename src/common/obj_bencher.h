@@ -18,6 +18,10 @@
 #include "common/Cond.h"
 #include "common/ceph_context.h"
 
+namespace ceph {
+  class Formatter;
+}
+
 struct bench_interval_data {
   double min_bandwidth;
   double max_bandwidth;
@@ -41,6 +45,8 @@ struct bench_data {
   double avg_latency;
   struct bench_interval_data idata; // data that is updated by time intervals and not by events
   struct bench_history history; // data history, used to calculate stddev
+  vector<double> latency_samples; // bounded latency reservoir, used for percentiles
+  uint64_t latency_ops; // number of latencies offered to the reservoir
   utime_t cur_latency; //latency of last completed transaction
   utime_t start_time; //start time for benchmark
   char *object_contents; //pointer to the contents written to each object
@@ -52,6 +58,8 @@ const int OP_RAND_READ = 3;
 
 class ObjBencher {
   bool show_time;
+  ceph::Formatter *formatter;
+  int target_iops; //if positive, pace new ops at this rate (open loop)
 public:
   CephContext *cct;
 protected:
@@ -61,6 +69,9 @@ protected:
 
   struct bench_data data;
 
+  void sample_latency();
+  void rate_pace();
+
   int fetch_bench_metadata(const std::string& metadata_file, int* object_size, int* num_objects, int* prevPid);
 
   int write_bench(int secondsToRun, int maxObjects, int concurrentios, const string& run_name_meta);
@@ -93,7 +104,7 @@ protected:
   ostream& out(ostream& os);
   ostream& out(ostream& os, utime_t& t);
 public:
-  ObjBencher(CephContext *cct_) : show_time(false), cct(cct_), lock("ObjBencher::lock") {}
+  ObjBencher(CephContext *cct_) : show_time(false), formatter(NULL), target_iops(0), cct(cct_), lock("ObjBencher::lock") {}
   virtual ~ObjBencher() {}
   int aio_bench(
     int operation, int secondsToRun, int maxObjectsToCreate,
@@ -103,6 +114,14 @@ public:
   void set_show_time(bool dt) {
     show_time = dt;
   }
+
+  void set_formatter(ceph::Formatter *f) {
+    formatter = f;
+  }
+
+  void set_target_iops(int iops) {
+    target_iops = iops;
+  }
 };
 
 
@@ -15,6 +15,7 @@
 #include "include/int_types.h"
 
 #include "common/perf_counters.h"
+#include "common/Clock.h"
 #include "common/dout.h"
 #include "common/errno.h"
 #include "common/Formatter.h"
@@ -90,10 +91,75 @@ void PerfCountersCollection::dump_formatted(Formatter *f, bool schema)
   f->close_section();
 }
 
+void PerfCountersCollection::dump_formatted_rates(Formatter *f)
+{
+  Mutex::Locker lck(m_lock);
+  utime_t now = ceph_clock_now(m_cct);
+  double elapsed = 0;
+  if (!m_rate_stamp.is_zero())
+    elapsed = (double)(now - m_rate_stamp);
+  m_rate_stamp = now;
+  f->open_object_section("perfcounter_rates");
+  f->dump_float("interval", elapsed);
+  for (perf_counters_set_t::iterator l = m_loggers.begin();
+       l != m_loggers.end();
+       ++l)
+    (*l)->dump_formatted_rates(f, elapsed, &m_rate_prev);
+  f->close_section();
+}
+
 // ---------------------------
 
 PerfCounters::~PerfCounters()
 {
+  pthread_key_delete(m_tls_key);
+  Mutex::Locker lck(m_lock);
+  for (std::set<perf_counter_thread_slots*>::iterator s = m_thread_slots.begin();
+       s != m_thread_slots.end();
+       ++s)
+    delete *s;
+  m_thread_slots.clear();
+}
+
+int64_t *PerfCounters::get_thread_deltas()
+{
+  perf_counter_thread_slots *ts =
+    static_cast<perf_counter_thread_slots*>(pthread_getspecific(m_tls_key));
+  if (!ts) {
+    ts = new perf_counter_thread_slots;
+    ts->owner = this;
+    ts->deltas.resize(m_data.size(), 0);
+    pthread_setspecific(m_tls_key, ts);
+    Mutex::Locker lck(m_lock);
+    m_thread_slots.insert(ts);
+  }
+  return &ts->deltas[0];
+}
+
+void PerfCounters::thread_slots_dtor(void *p)
+{
+  perf_counter_thread_slots *ts = static_cast<perf_counter_thread_slots*>(p);
+  PerfCounters *pc = ts->owner;
+  Mutex::Locker lck(pc->m_lock);
+  // fold this thread's deltas into the shared base values
+  for (unsigned i = 0; i < ts->deltas.size(); i++) {
+    if (ts->deltas[i])
+      pc->m_data[i].u64.add(ts->deltas[i]);
+  }
+  pc->m_thread_slots.erase(ts);
+  delete ts;
+}
+
+uint64_t PerfCounters::read_u64(const perf_counter_data_any_d &data) const
+{
+  unsigned off = &data - &m_data[0];
+  uint64_t v = data.u64.read();
+  Mutex::Locker lck(m_lock);
+  for (std::set<perf_counter_thread_slots*>::const_iterator s = m_thread_slots.begin();
+       s != m_thread_slots.end();
+       ++s)
+    v += (*s)->deltas[off];
+  return v;
 }
 
 void PerfCounters::inc(int idx, uint64_t amt)
@@ -111,7 +177,9 @@ void PerfCounters::inc(int idx, uint64_t amt)
     data.u64.add(amt);
     data.avgcount2.inc();
   } else {
-    data.u64.add(amt);
+    // plain u64s go through the thread-local delta slot; readers
+    // aggregate, so no shared cache line is touched here
+    get_thread_deltas()[idx - m_lower_bound - 1] += amt;
   }
 }
 
@@ -126,7 +194,7 @@ void PerfCounters::dec(int idx, uint64_t amt)
   assert(!(data.type & PERFCOUNTER_LONGRUNAVG));
   if (!(data.type & PERFCOUNTER_U64))
     return;
-  data.u64.sub(amt);
+  get_thread_deltas()[idx - m_lower_bound - 1] -= amt;
 }
 
 void PerfCounters::set(int idx, uint64_t amt)
@@ -139,13 +207,21 @@ void PerfCounters::set(int idx, uint64_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_U64))
     return;
-  data.u64.set(amt);
   if (data.type & PERFCOUNTER_LONGRUNAVG) {
     data.avgcount.inc();
     data.u64.set(amt);
     data.avgcount2.inc();
   } else {
-    data.u64.set(amt);
+    // make the aggregate read amt without touching other threads'
+    // delta slots: write the base minus whatever is outstanding
+    int off = idx - m_lower_bound - 1;
+    int64_t sum = 0;
+    Mutex::Locker lck(m_lock);
+    for (std::set<perf_counter_thread_slots*>::const_iterator s = m_thread_slots.begin();
+	 s != m_thread_slots.end();
+	 ++s)
+      sum += (*s)->deltas[off];
+    data.u64.set(amt - sum);
   }
 }
 
@@ -159,7 +235,9 @@ uint64_t PerfCounters::get(int idx) const
   const perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_U64))
     return 0;
-  return data.u64.read();
+  if (data.type & PERFCOUNTER_LONGRUNAVG)
+    return data.u64.read();
+  return read_u64(data);
 }
 
 void PerfCounters::tinc(int idx, utime_t amt)
@@ -181,6 +259,25 @@ void PerfCounters::tinc(int idx, utime_t amt)
   }
 }
 
+void PerfCounters::hinc(int idx, utime_t amt)
+{
+  if (!m_cct->_conf->perf)
+    return;
+
+  assert(idx > m_lower_bound);
+  assert(idx < m_upper_bound);
+  perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
+  if (!(data.type & PERFCOUNTER_HISTOGRAM))
+    return;
+  uint64_t usec = amt.to_nsec() / 1000;
+  int bucket = 0;
+  while (usec && bucket < perf_counter_data_any_d::HISTOGRAM_BUCKETS - 1) {
+    usec >>= 1;
+    bucket++;
+  }
+  data.histogram[bucket].inc();
+}
+
 void PerfCounters::tset(int idx, utime_t amt)
 {
   if (!m_cct->_conf->perf)
@@ -241,7 +338,12 @@ void PerfCounters::dump_formatted(Formatter *f, bool schema)
       f->dump_int("type", d->type);
       f->close_section();
     } else {
-      if (d->type & PERFCOUNTER_LONGRUNAVG) {
+      if (d->type & PERFCOUNTER_HISTOGRAM) {
+	f->open_array_section(d->name);
+	for (int i = 0; i < perf_counter_data_any_d::HISTOGRAM_BUCKETS; i++)
+	  f->dump_unsigned("count", d->histogram[i].read());
+	f->close_section();
+      } else if (d->type & PERFCOUNTER_LONGRUNAVG) {
 	f->open_object_section(d->name);
 	pair<uint64_t,uint64_t> a = d->read_avg();
 	if (d->type & PERFCOUNTER_U64) {
@@ -257,7 +359,11 @@ void PerfCounters::dump_formatted(Formatter *f, bool schema)
 	}
 	f->close_section();
       } else {
-	uint64_t v = d->u64.read();
+	uint64_t v;
+	if (d->type & PERFCOUNTER_U64)
+	  v = read_u64(*d);
+	else
+	  v = d->u64.read();
 	if (d->type & PERFCOUNTER_U64) {
 	  f->dump_unsigned(d->name, v);
 	} else if (d->type & PERFCOUNTER_TIME) {
@@ -276,6 +382,61 @@ void PerfCounters::dump_formatted(Formatter *f, bool schema)
   f->close_section();
 }
 
+/*
+ * Emit per-interval rates instead of absolute values: counters become
+ * events per second over the elapsed interval, running averages become
+ * <ops per second, mean value over the interval>, and plain values
+ * (gauges, e.g. queue depths) are passed through as-is.  prev holds
+ * what each counter read last time and is rebaselined as we go; with
+ * elapsed == 0 (the first sample) all rates are reported as zero.
+ */
+void PerfCounters::dump_formatted_rates(Formatter *f, double elapsed,
+    std::map<std::string, std::pair<uint64_t, uint64_t> > *prev)
+{
+  f->open_object_section(m_name.c_str());
+  for (perf_counter_data_vec_t::const_iterator d = m_data.begin();
+       d != m_data.end();
+       ++d) {
+    if (d->type == PERFCOUNTER_NONE)
+      continue;
+    if (d->type & PERFCOUNTER_HISTOGRAM)
+      continue;  // per-bucket deltas aren't worth the clutter here
+    std::pair<uint64_t, uint64_t> &last = (*prev)[m_name + "." + d->name];
+    if (d->type & PERFCOUNTER_LONGRUNAVG) {
+      pair<uint64_t, uint64_t> a = d->read_avg();
+      uint64_t dsum = a.first - last.first;
+      uint64_t dcount = a.second - last.second;
+      f->open_object_section(d->name);
+      f->dump_float("rate", elapsed > 0 ? (double)dcount / elapsed : 0);
+      double avg = 0;
+      if (dcount) {
+	avg = (double)dsum / (double)dcount;
+	if (d->type & PERFCOUNTER_TIME)
+	  avg /= 1000000000.0;  // sum is kept in nanoseconds
+      }
+      f->dump_float("avg", avg);
+      f->close_section();
+      last = a;
+    } else {
+      uint64_t v;
+      if (d->type & PERFCOUNTER_U64)
+	v = read_u64(*d);
+      else
+	v = d->u64.read();
+      if (d->type & PERFCOUNTER_COUNTER) {
+	f->dump_float(d->name,
+		      elapsed > 0 ? (double)(v - last.first) / elapsed : 0);
+      } else if (d->type & PERFCOUNTER_TIME) {
+	f->dump_float(d->name, (double)v / 1000000000.0);
+      } else {
+	f->dump_unsigned(d->name, v);
+      }
+      last.first = v;
+    }
+  }
+  f->close_section();
+}
+
 const std::string &PerfCounters::get_name() const
 {
   return m_name;
@@ -291,6 +452,7 @@ PerfCounters::PerfCounters(CephContext *cct, const std::string &name,
     m_lock(m_lock_name.c_str())
 {
   m_data.resize(upper_bound - lower_bound - 1);
+  pthread_key_create(&m_tls_key, thread_slots_dtor);
 }
 
 PerfCountersBuilder::PerfCountersBuilder(CephContext *cct, const std::string &name,
@@ -326,6 +488,11 @@ void PerfCountersBuilder::add_time(int idx, const char *name)
   add_impl(idx, name, PERFCOUNTER_TIME);
 }
 
+void PerfCountersBuilder::add_time_hist(int idx, const char *name)
+{
+  add_impl(idx, name, PERFCOUNTER_TIME | PERFCOUNTER_HISTOGRAM);
+}
+
 void PerfCountersBuilder::add_time_avg(int idx, const char *name)
 {
   add_impl(idx, name, PERFCOUNTER_TIME | PERFCOUNTER_LONGRUNAVG);
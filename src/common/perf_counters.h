@@ -22,6 +22,7 @@
 #include "include/utime.h"
 
 #include <stdint.h>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -36,6 +37,7 @@ enum perfcounter_type_d
   PERFCOUNTER_U64 = 0x2,
   PERFCOUNTER_LONGRUNAVG = 0x4,
   PERFCOUNTER_COUNTER = 0x8,
+  PERFCOUNTER_HISTOGRAM = 0x10,
 };
 
 /*
@@ -61,6 +63,17 @@ enum perfcounter_type_d
  * For the time average, it returns the current value and
  * the "avgcount" member when read off. avgcount is incremented when you call
  * tinc. Calling tset on an average is an error and will assert out.
+ *
+ * A histogram counter keeps a per-bucket sample count, where bucket n
+ * holds samples in [2^(n-1), 2^n) microseconds; use hinc() to record a
+ * sample.  Averages hide multimodal latency, so use this alongside a
+ * time average when the distribution matters.
+ *
+ * Plain u64 counters are updated through per-thread delta slots, so
+ * inc()/dec() on hot paths touch only thread-local memory and never
+ * contend; readers (get() and the admin socket dump) aggregate the base
+ * value with the live per-thread deltas, and a thread's deltas are
+ * folded into the base when it exits.
  */
 class PerfCounters
 {
@@ -94,7 +107,12 @@ public:
   void tinc(int idx, utime_t v);
   utime_t tget(int idx) const;
 
+  void hinc(int idx, utime_t v);
+
   void dump_formatted(ceph::Formatter *f, bool schema);
+  void dump_formatted_rates(
+    ceph::Formatter *f, double elapsed,
+    std::map<std::string, std::pair<uint64_t, uint64_t> > *prev);
 
   pair<uint64_t, uint64_t> get_tavg_ms(int idx) const;
 
@@ -111,6 +129,8 @@ private:
 
   /** Represents a PerfCounters data element. */
   struct perf_counter_data_any_d {
+    static const int HISTOGRAM_BUCKETS = 32;
+
     perf_counter_data_any_d()
       : name(NULL),
 	type(PERFCOUNTER_NONE),
@@ -126,6 +146,8 @@ private:
       u64.set(a.first);
       avgcount.set(a.second);
       avgcount2.set(a.second);
+      for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+	histogram[i].set(other.histogram[i].read());
     }
 
     void write_schema_json(char *buf, size_t buf_sz) const;
@@ -136,6 +158,7 @@ private:
     atomic64_t u64;
     atomic64_t avgcount;
     atomic64_t avgcount2;
+    atomic64_t histogram[HISTOGRAM_BUCKETS];
 
     perf_counter_data_any_d& operator=(const perf_counter_data_any_d& other) {
       name = other.name;
@@ -144,6 +167,8 @@ private:
       u64.set(a.first);
       avgcount.set(a.second);
       avgcount2.set(a.second);
+      for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+	histogram[i].set(other.histogram[i].read());
       return *this;
     }
 
@@ -159,17 +184,30 @@ private:
   };
   typedef std::vector<perf_counter_data_any_d> perf_counter_data_vec_t;
 
+  /** per-thread deltas for the plain u64 counters */
+  struct perf_counter_thread_slots {
+    PerfCounters *owner;
+    std::vector<int64_t> deltas;
+  };
+
+  int64_t *get_thread_deltas();
+  static void thread_slots_dtor(void *p);
+  uint64_t read_u64(const perf_counter_data_any_d &data) const;
+
   CephContext *m_cct;
   int m_lower_bound;
   int m_upper_bound;
   std::string m_name;
   const std::string m_lock_name;
 
-  /** Protects m_data */
+  /** Protects m_thread_slots (and m_data layout changes at build time) */
   mutable Mutex m_lock;
 
   perf_counter_data_vec_t m_data;
 
+  pthread_key_t m_tls_key;
+  std::set<perf_counter_thread_slots*> m_thread_slots;
+
   friend class PerfCountersBuilder;
 };
 
@@ -194,6 +232,7 @@ public:
   void remove(class PerfCounters *l);
   void clear();
   void dump_formatted(ceph::Formatter *f, bool schema);
+  void dump_formatted_rates(ceph::Formatter *f);
 private:
   CephContext *m_cct;
 
@@ -202,6 +241,14 @@ private:
 
   perf_counters_set_t m_loggers;
 
+  /**
+   * state for dump_formatted_rates: the <sum-or-value, avgcount> each
+   * counter held at the previous call, keyed "<logger>.<counter>", and
+   * when that call happened.  Protected by m_lock.
+   */
+  std::map<std::string, std::pair<uint64_t, uint64_t> > m_rate_prev;
+  utime_t m_rate_stamp;
+
   friend class PerfCountersCollectionTest;
 };
 
@@ -224,6 +271,7 @@ public:
   void add_u64_avg(int key, const char *name);
   void add_time(int key, const char *name);
   void add_time_avg(int key, const char *name);
+  void add_time_hist(int key, const char *name);
   PerfCounters* create_perf_counters();
 private:
   PerfCountersBuilder(const PerfCountersBuilder &rhs);
@@ -1,4 +1,4 @@
-// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*- 
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 /*
  * Ceph - scalable distributed file system
@@ -7,9 +7,9 @@
  *
  * This is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Lesser General Public
- * License version 2.1, as published by the Free Software 
+ * License version 2.1, as published by the Free Software
  * Foundation.  See file COPYING.
- * 
+ *
  */
 
 #ifndef CEPH_SHAREDCACHE_H
@@ -21,149 +21,251 @@
 #include <utility>
 #include "common/Mutex.h"
 #include "common/Cond.h"
+#include "include/hash_namespace.h"
 
-template <class K, class V>
+/*
+ * LRU cache of shared_ptrs, optionally sharded: with NumShards > 1 the
+ * keyspace is split by hash, each shard has its own lock and LRU, and
+ * callers under contention (e.g. the OSD map cache) scale by bumping
+ * the template argument.  max_size is the aggregate across shards.
+ * Ordered operations (lower_bound, cached_key_lower_bound) consult
+ * every shard.
+ */
+template <class K, class V, unsigned NumShards = 1,
+	  class Hash = CEPH_HASH_NAMESPACE::hash<K> >
 class SharedLRU {
   typedef ceph::shared_ptr<V> VPtr;
   typedef ceph::weak_ptr<V> WeakVPtr;
-  Mutex lock;
-  size_t max_size;
-  Cond cond;
-  unsigned size;
 
-  map<K, typename list<pair<K, VPtr> >::iterator > contents;
-  list<pair<K, VPtr> > lru;
+  struct Shard {
+    Mutex lock;
+    size_t max_size;
+    Cond cond;
+    unsigned size;
+    uint64_t hits, misses;
+
+    map<K, typename list<pair<K, VPtr> >::iterator > contents;
+    list<pair<K, VPtr> > lru;
+
+    map<K, WeakVPtr> weak_refs;
 
-  map<K, WeakVPtr> weak_refs;
+    Shard() : lock("SharedLRU::Shard::lock"), max_size(0), size(0),
+	      hits(0), misses(0) {}
 
-  void trim_cache(list<VPtr> *to_release) {
-    while (size > max_size) {
-      to_release->push_back(lru.back().second);
-      lru_remove(lru.back().first);
+    void trim_cache(list<VPtr> *to_release) {
+      while (size > max_size) {
+	to_release->push_back(lru.back().second);
+	lru_remove(lru.back().first);
+      }
     }
-  }
 
-  void lru_remove(K key) {
-    typename map<K, typename list<pair<K, VPtr> >::iterator>::iterator i =
-      contents.find(key);
-    if (i == contents.end())
-      return;
-    lru.erase(i->second);
-    --size;
-    contents.erase(i);
-  }
+    void lru_remove(K key) {
+      typename map<K, typename list<pair<K, VPtr> >::iterator>::iterator i =
+	contents.find(key);
+      if (i == contents.end())
+	return;
+      lru.erase(i->second);
+      --size;
+      contents.erase(i);
+    }
 
-  void lru_add(K key, VPtr val, list<VPtr> *to_release) {
-    typename map<K, typename list<pair<K, VPtr> >::iterator>::iterator i =
-      contents.find(key);
-    if (i != contents.end()) {
-      lru.splice(lru.begin(), lru, i->second);
-    } else {
-      ++size;
-      lru.push_front(make_pair(key, val));
-      contents[key] = lru.begin();
-      trim_cache(to_release);
+    void lru_add(K key, VPtr val, list<VPtr> *to_release) {
+      typename map<K, typename list<pair<K, VPtr> >::iterator>::iterator i =
+	contents.find(key);
+      if (i != contents.end()) {
+	lru.splice(lru.begin(), lru, i->second);
+      } else {
+	++size;
+	lru.push_front(make_pair(key, val));
+	contents[key] = lru.begin();
+	trim_cache(to_release);
+      }
     }
+  };
+
+  Shard shards[NumShards];
+
+  Shard& shard(const K& key) {
+    if (NumShards == 1)
+      return shards[0];
+    return shards[Hash()(key) % NumShards];
   }
 
   void remove(K key) {
-    Mutex::Locker l(lock);
-    weak_refs.erase(key);
-    cond.Signal();
+    Shard& s = shard(key);
+    Mutex::Locker l(s.lock);
+    s.weak_refs.erase(key);
+    s.cond.Signal();
   }
 
   class Cleanup {
   public:
-    SharedLRU<K, V> *cache;
+    SharedLRU<K, V, NumShards, Hash> *cache;
     K key;
-    Cleanup(SharedLRU<K, V> *cache, K key) : cache(cache), key(key) {}
+    Cleanup(SharedLRU<K, V, NumShards, Hash> *cache, K key)
+      : cache(cache), key(key) {}
     void operator()(V *ptr) {
       cache->remove(key);
       delete ptr;
     }
   };
 
+  // original lower_bound logic, applied to one shard; returns the
+  // candidate key/value, promoting it in that shard's lru
+  bool shard_lower_bound(Shard& s, K key, K *out_key, VPtr *out_val,
+			 list<VPtr> *to_release) {
+    Mutex::Locker l(s.lock);
+    VPtr val;
+    K k = K();
+    bool retry = false;
+    do {
+      retry = false;
+      if (s.weak_refs.empty())
+	return false;
+      typename map<K, WeakVPtr>::iterator i = s.weak_refs.lower_bound(key);
+      if (i == s.weak_refs.end())
+	--i;
+      k = i->first;
+      val = i->second.lock();
+      if (val) {
+	s.lru_add(k, val, to_release);
+      } else {
+	retry = true;
+      }
+      if (retry)
+	s.cond.Wait(s.lock);
+    } while (retry);
+    *out_key = k;
+    *out_val = val;
+    return true;
+  }
+
 public:
-  SharedLRU(size_t max_size = 20)
-    : lock("SharedLRU::lock"), max_size(max_size), size(0) {}
-  
+  SharedLRU(size_t max_size = 20) {
+    set_size(max_size);
+  }
+
   ~SharedLRU() {
-    contents.clear();
-    lru.clear();
-    assert(weak_refs.empty());
+    for (unsigned i = 0; i < NumShards; ++i) {
+      shards[i].contents.clear();
+      shards[i].lru.clear();
+      assert(shards[i].weak_refs.empty());
+    }
   }
 
   void clear(K key) {
     VPtr val; // release any ref we have after we drop the lock
     {
-      Mutex::Locker l(lock);
-      if (weak_refs.count(key)) {
-	val = weak_refs[key].lock();
+      Shard& s = shard(key);
+      Mutex::Locker l(s.lock);
+      if (s.weak_refs.count(key)) {
+	val = s.weak_refs[key].lock();
       }
-      lru_remove(key);
+      s.lru_remove(key);
     }
   }
 
   void set_size(size_t new_size) {
+    size_t per_shard = new_size / NumShards;
+    if (!per_shard)
+      per_shard = 1;
     list<VPtr> to_release;
-    {
-      Mutex::Locker l(lock);
-      max_size = new_size;
-      trim_cache(&to_release);
+    for (unsigned i = 0; i < NumShards; ++i) {
+      Mutex::Locker l(shards[i].lock);
+      shards[i].max_size = per_shard;
+      shards[i].trim_cache(&to_release);
+    }
+  }
+
+  size_t get_size() {
+    size_t total = 0;
+    for (unsigned i = 0; i < NumShards; ++i) {
+      Mutex::Locker l(shards[i].lock);
+      total += shards[i].size;
+    }
+    return total;
+  }
+
+  void get_cache_counters(uint64_t *hits, uint64_t *misses) {
+    *hits = *misses = 0;
+    for (unsigned i = 0; i < NumShards; ++i) {
+      Mutex::Locker l(shards[i].lock);
+      *hits += shards[i].hits;
+      *misses += shards[i].misses;
     }
   }
 
   // Returns K key s.t. key <= k for all currently cached k,v
   K cached_key_lower_bound() {
-    Mutex::Locker l(lock);
-    return weak_refs.begin()->first;
+    K best = K();
+    bool found = false;
+    for (unsigned i = 0; i < NumShards; ++i) {
+      Mutex::Locker l(shards[i].lock);
+      if (shards[i].weak_refs.empty())
+	continue;
+      K k = shards[i].weak_refs.begin()->first;
+      if (!found || k < best) {
+	best = k;
+	found = true;
+      }
+    }
+    return best;
   }
 
   VPtr lower_bound(K key) {
-    VPtr val;
     list<VPtr> to_release;
-    {
-      Mutex::Locker l(lock);
-      bool retry = false;
-      do {
-	retry = false;
-	if (weak_refs.empty())
-	  break;
-	typename map<K, WeakVPtr>::iterator i = weak_refs.lower_bound(key);
-	if (i == weak_refs.end())
-	  --i;
-	val = i->second.lock();
-	if (val) {
-	  lru_add(i->first, val, &to_release);
-	} else {
-	  retry = true;
-	}
-	if (retry)
-	  cond.Wait(lock);
-      } while (retry);
+    K best_key = K();
+    VPtr best;
+    bool best_ge = false;
+    bool found = false;
+    for (unsigned i = 0; i < NumShards; ++i) {
+      K k;
+      VPtr v;
+      if (!shard_lower_bound(shards[i], key, &k, &v, &to_release))
+	continue;
+      // prefer the smallest key >= key; fall back to the largest key
+      bool ge = !(k < key);
+      bool better;
+      if (!found)
+	better = true;
+      else if (ge != best_ge)
+	better = ge;
+      else
+	better = ge ? (k < best_key) : (best_key < k);
+      if (better) {
+	best_key = k;
+	best = v;
+	best_ge = ge;
+	found = true;
+      }
     }
-    return val;
+    return best;
   }
 
   VPtr lookup(K key) {
     VPtr val;
     list<VPtr> to_release;
     {
-      Mutex::Locker l(lock);
+      Shard& s = shard(key);
+      Mutex::Locker l(s.lock);
       bool retry = false;
       do {
 	retry = false;
-	if (weak_refs.count(key)) {
-	  val = weak_refs[key].lock();
+	if (s.weak_refs.count(key)) {
+	  val = s.weak_refs[key].lock();
 	  if (val) {
-	    lru_add(key, val, &to_release);
+	    s.lru_add(key, val, &to_release);
 	  } else {
 	    retry = true;
 	  }
 	}
 	if (retry)
-	  cond.Wait(lock);
+	  s.cond.Wait(s.lock);
       } while (retry);
+      if (val)
+	++s.hits;
+      else
+	++s.misses;
     }
     return val;
   }
@@ -172,9 +274,10 @@ public:
     VPtr val(value, Cleanup(this, key));
     list<VPtr> to_release;
     {
-      Mutex::Locker l(lock);
-      weak_refs.insert(make_pair(key, val));
-      lru_add(key, val, &to_release);
+      Shard& s = shard(key);
+      Mutex::Locker l(s.lock);
+      s.weak_refs.insert(make_pair(key, val));
+      s.lru_add(key, val, &to_release);
     }
     return val;
   }
@@ -19,37 +19,58 @@
 #include <memory>
 #include "common/Mutex.h"
 #include "common/Cond.h"
+#include "include/hash_namespace.h"
 
 /**
  * Provides a registry of shared_ptr<V> indexed by K while
  * the references are alive.
+ *
+ * With NumShards > 1 the keyspace is split by hash and each shard has
+ * its own lock, so heavily contended registries (e.g. per-object
+ * contexts at high op rates) scale by bumping the template argument.
+ * get_next() remains a total ordering across all shards.
  */
-template <class K, class V>
+template <class K, class V, unsigned NumShards = 1,
+	  class Hash = CEPH_HASH_NAMESPACE::hash<K> >
 class SharedPtrRegistry {
 public:
   typedef ceph::shared_ptr<V> VPtr;
   typedef ceph::weak_ptr<V> WeakVPtr;
+  // approximate when sharded: incremented under different shard locks
   int waiting;
 private:
-  Mutex lock;
-  Cond cond;
-  map<K, pair<WeakVPtr, V*> > contents;
+  struct Shard {
+    Mutex lock;
+    Cond cond;
+    map<K, pair<WeakVPtr, V*> > contents;
+    Shard() : lock("SharedPtrRegistry::Shard::lock") {}
+  };
+
+  Shard shards[NumShards];
+
+  Shard& shard(const K& key) {
+    if (NumShards == 1)
+      return shards[0];
+    return shards[Hash()(key) % NumShards];
+  }
 
   class OnRemoval {
-    SharedPtrRegistry<K,V> *parent;
+    SharedPtrRegistry<K,V,NumShards,Hash> *parent;
     K key;
   public:
-    OnRemoval(SharedPtrRegistry<K,V> *parent, K key) :
+    OnRemoval(SharedPtrRegistry<K,V,NumShards,Hash> *parent, K key) :
       parent(parent), key(key) {}
     void operator()(V *to_remove) {
       {
-	Mutex::Locker l(parent->lock);
+	typename SharedPtrRegistry<K,V,NumShards,Hash>::Shard &s =
+	  parent->shard(key);
+	Mutex::Locker l(s.lock);
 	typename map<K, pair<WeakVPtr, V*> >::iterator i =
-	  parent->contents.find(key);
-	if (i != parent->contents.end() &&
+	  s.contents.find(key);
+	if (i != s.contents.end() &&
 	    i->second.second == to_remove) {
-	  parent->contents.erase(i);
-	  parent->cond.Signal();
+	  s.contents.erase(i);
+	  s.cond.Signal();
 	}
       }
       delete to_remove;
@@ -59,58 +80,61 @@ private:
 
 public:
   SharedPtrRegistry() :
-    waiting(0),
-    lock("SharedPtrRegistry::lock")
+    waiting(0)
   {}
 
   bool empty() {
-    Mutex::Locker l(lock);
-    return contents.empty();
+    for (unsigned i = 0; i < NumShards; ++i) {
+      Mutex::Locker l(shards[i].lock);
+      if (!shards[i].contents.empty())
+	return false;
+    }
+    return true;
   }
 
   bool get_next(const K &key, pair<K, VPtr> *next) {
     pair<K, VPtr> r;
-    {
-      Mutex::Locker l(lock);
+    bool found = false;
+    for (unsigned j = 0; j < NumShards; ++j) {
+      Shard &s = shards[j];
+      Mutex::Locker l(s.lock);
       VPtr next_val;
       typename map<K, pair<WeakVPtr, V*> >::iterator i =
-	contents.upper_bound(key);
-      while (i != contents.end() &&
+	s.contents.upper_bound(key);
+      while (i != s.contents.end() &&
 	     !(next_val = i->second.first.lock()))
 	++i;
-      if (i == contents.end())
-	return false;
-      if (next)
+      if (i == s.contents.end())
+	continue;
+      if (!found || i->first < r.first) {
 	r = make_pair(i->first, next_val);
+	found = true;
+      }
     }
+    if (!found)
+      return false;
     if (next)
       *next = r;
     return true;
   }
 
-  
   bool get_next(const K &key, pair<K, V> *next) {
-    VPtr next_val;
-    Mutex::Locker l(lock);
-    typename map<K, pair<WeakVPtr, V*> >::iterator i =
-      contents.upper_bound(key);
-    while (i != contents.end() &&
-	   !(next_val = i->second.first.lock()))
-      ++i;
-    if (i == contents.end())
+    pair<K, VPtr> r;
+    if (!get_next(key, &r))
       return false;
     if (next)
-      *next = make_pair(i->first, *next_val);
+      *next = make_pair(r.first, *r.second);
     return true;
   }
 
   VPtr lookup(const K &key) {
-    Mutex::Locker l(lock);
+    Shard &s = shard(key);
+    Mutex::Locker l(s.lock);
     waiting++;
     while (1) {
       typename map<K, pair<WeakVPtr, V*> >::iterator i =
-	contents.find(key);
-      if (i != contents.end()) {
+	s.contents.find(key);
+      if (i != s.contents.end()) {
 	VPtr retval = i->second.first.lock();
 	if (retval) {
 	  waiting--;
@@ -119,19 +143,20 @@ public:
       } else {
 	break;
       }
-      cond.Wait(lock);
+      s.cond.Wait(s.lock);
     }
     waiting--;
     return VPtr();
   }
 
   VPtr lookup_or_create(const K &key) {
-    Mutex::Locker l(lock);
+    Shard &s = shard(key);
+    Mutex::Locker l(s.lock);
     waiting++;
     while (1) {
       typename map<K, pair<WeakVPtr, V*> >::iterator i =
-	contents.find(key);
-      if (i != contents.end()) {
+	s.contents.find(key);
+      if (i != s.contents.end()) {
 	VPtr retval = i->second.first.lock();
 	if (retval) {
 	  waiting--;
@@ -140,34 +165,40 @@ public:
       } else {
 	break;
       }
-      cond.Wait(lock);
+      s.cond.Wait(s.lock);
     }
     V *ptr = new V();
     VPtr retval(ptr, OnRemoval(this, key));
-    contents.insert(make_pair(key, make_pair(retval, ptr)));
+    s.contents.insert(make_pair(key, make_pair(retval, ptr)));
     waiting--;
     return retval;
   }
 
   unsigned size() {
-    Mutex::Locker l(lock);
-    return contents.size();
+    unsigned count = 0;
+    for (unsigned i = 0; i < NumShards; ++i) {
+      Mutex::Locker l(shards[i].lock);
+      count += shards[i].contents.size();
+    }
+    return count;
   }
 
   void remove(const K &key) {
-    Mutex::Locker l(lock);
-    contents.erase(key);
-    cond.Signal();
+    Shard &s = shard(key);
+    Mutex::Locker l(s.lock);
+    s.contents.erase(key);
+    s.cond.Signal();
   }
 
   template<class A>
   VPtr lookup_or_create(const K &key, const A &arg) {
-    Mutex::Locker l(lock);
+    Shard &s = shard(key);
+    Mutex::Locker l(s.lock);
     waiting++;
     while (1) {
       typename map<K, pair<WeakVPtr, V*> >::iterator i =
-	contents.find(key);
-      if (i != contents.end()) {
+	s.contents.find(key);
+      if (i != s.contents.end()) {
 	VPtr retval = i->second.first.lock();
 	if (retval) {
 	  waiting--;
@@ -176,11 +207,11 @@ public:
       } else {
 	break;
       }
-      cond.Wait(lock);
+      s.cond.Wait(s.lock);
     }
     V *ptr = new V(arg);
     VPtr retval(ptr, OnRemoval(this, key));
-    contents.insert(make_pair(key, make_pair(retval, ptr)));
+    s.contents.insert(make_pair(key, make_pair(retval, ptr)));
     waiting--;
     return retval;
   }
@@ -25,6 +25,7 @@ template <class K, class V>
 class SimpleLRU {
   Mutex lock;
   size_t max_size;
+  uint64_t hits, misses;
   map<K, typename list<pair<K, V> >::iterator> contents;
   list<pair<K, V> > lru;
   map<K, V> pinned;
@@ -43,7 +44,8 @@ class SimpleLRU {
   }
 
 public:
-  SimpleLRU(size_t max_size) : lock("SimpleLRU::lock"), max_size(max_size) {}
+  SimpleLRU(size_t max_size) : lock("SimpleLRU::lock"), max_size(max_size),
+			       hits(0), misses(0) {}
 
   void pin(K key, V val) {
     Mutex::Locker l(lock);
@@ -85,15 +87,29 @@ public:
     if (loc != lru.end()) {
       *out = loc->second;
       lru.splice(lru.begin(), lru, loc);
+      ++hits;
       return true;
     }
     if (pinned.count(key)) {
       *out = pinned[key];
+      ++hits;
       return true;
     }
+    ++misses;
     return false;
   }
 
+  size_t get_size() {
+    Mutex::Locker l(lock);
+    return lru.size() + pinned.size();
+  }
+
+  void get_cache_counters(uint64_t *h, uint64_t *m) {
+    Mutex::Locker l(lock);
+    *h = hits;
+    *m = misses;
+  }
+
   void add(K key, V value) {
     Mutex::Locker l(lock);
     _add(key, value);
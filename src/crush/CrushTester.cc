@@ -350,6 +350,73 @@ void CrushTester::write_integer_indexed_scalar_data_string(vector<string> &dst,
   dst.push_back( data_buffer.str() );
 }
 
+static bool buckets_equal(const struct crush_bucket *a,
+			  const struct crush_bucket *b)
+{
+  if (!a || !b)
+    return a == b;
+  if (a->alg != b->alg || a->hash != b->hash ||
+      a->type != b->type || a->size != b->size)
+    return false;
+  for (unsigned i = 0; i < a->size; i++) {
+    if (a->items[i] != b->items[i])
+      return false;
+    if (crush_get_bucket_item_weight(a, i) !=
+	crush_get_bucket_item_weight(b, i))
+      return false;
+  }
+  return true;
+}
+
+bool CrushTester::rule_affected_by_delta(int ruleno)
+{
+  const struct crush_map *map = crush.crush;
+  const struct crush_map *old = baseline->crush;
+
+  // a tunable change can affect any rule
+  if (map->choose_local_tries != old->choose_local_tries ||
+      map->choose_local_fallback_tries != old->choose_local_fallback_tries ||
+      map->choose_total_tries != old->choose_total_tries ||
+      map->chooseleaf_descend_once != old->chooseleaf_descend_once ||
+      map->chooseleaf_vary_r != old->chooseleaf_vary_r)
+    return true;
+
+  if ((unsigned)ruleno >= old->max_rules || !old->rules[ruleno])
+    return true;
+  const struct crush_rule *r = map->rules[ruleno];
+  const struct crush_rule *o = old->rules[ruleno];
+  if (r->len != o->len ||
+      memcmp(&r->mask, &o->mask, sizeof(r->mask)))
+    return true;
+  for (unsigned s = 0; s < r->len; s++)
+    if (memcmp(&r->steps[s], &o->steps[s], sizeof(r->steps[s])))
+      return true;
+
+  // walk every bucket reachable from the rule's take steps and
+  // compare it against the same bucket in the baseline map
+  list<int> queue;
+  set<int> seen;
+  for (unsigned s = 0; s < r->len; s++)
+    if (r->steps[s].op == CRUSH_RULE_TAKE)
+      queue.push_back(r->steps[s].arg1);
+  while (!queue.empty()) {
+    int id = queue.front();
+    queue.pop_front();
+    if (id >= 0 || !seen.insert(id).second)
+      continue;
+    int bidx = -1 - id;
+    if (bidx >= map->max_buckets || bidx >= old->max_buckets)
+      return true;
+    const struct crush_bucket *b = map->buckets[bidx];
+    if (!buckets_equal(b, old->buckets[bidx]))
+      return true;
+    for (unsigned i = 0; i < b->size; i++)
+      if (b->items[i] < 0)
+	queue.push_back(b->items[i]);
+  }
+  return false;
+}
+
 int CrushTester::test()
 {
   if (min_rule < 0 || max_rule < 0) {
@@ -399,6 +466,11 @@ int CrushTester::test()
         err << "rule " << r << " dne" << std::endl;
       continue;
     }
+    if (baseline && !rule_affected_by_delta(r)) {
+      if (output_statistics)
+	err << "rule " << r << " unaffected by delta, skipping" << std::endl;
+      continue;
+    }
     int minr = min_rep, maxr = max_rep;
     if (min_rep < 0 || max_rep < 0) {
       minr = crush.get_rule_mask_min_size(r);
@@ -479,9 +551,20 @@ int CrushTester::test()
         for (unsigned i = 0; i < per.size() ; i++)
           batch_num_objects_expected[i] = (proportional_weights[i]*batch_expected_objects);
 
-        // create a vector to hold placement results temporarily 
+        // create a vector to hold placement results temporarily
         vector<int> temporary_per ( per.size() );
 
+        // map the whole batch up front across threads; the
+        // statistics below still run single threaded, in x order
+        vector<vector<int> > batch_out;
+        if (use_crush && num_threads > 1) {
+          vector<int> xs(batch_max - batch_min + 1);
+          for (int x = batch_min; x <= batch_max; x++)
+            xs[x - batch_min] = x;
+          crush.do_rule_batch_parallel(r, xs, batch_out, nr, weight,
+				       num_threads);
+        }
+
         for (int x = batch_min; x <= batch_max; x++) {
           // create a vector to hold the results of a CRUSH placement or RNG simulation
           vector<int> out;
@@ -489,7 +572,10 @@ int CrushTester::test()
           if (use_crush) {
             if (output_statistics)
               err << "CRUSH"; // prepend CRUSH to placement output
-            crush.do_rule(r, x, out, nr, weight);
+            if (!batch_out.empty())
+              out.swap(batch_out[x - batch_min]);
+            else
+              crush.do_rule(r, x, out, nr, weight);
           } else {
             if (output_statistics)
               err << "RNG"; // prepend RNG to placement output to denote simulation
@@ -21,6 +21,9 @@ class CrushTester {
   int num_batches;
   bool use_crush;
 
+  int num_threads;
+  CrushWrapper *baseline;
+
   float mark_down_device_ratio;
   float mark_down_bucket_ratio;
 
@@ -46,6 +49,13 @@ class CrushTester {
    */
   int get_maximum_affected_by_rule(int ruleno);
 
+  /*
+   * true if the mapping of ruleno could differ from what the baseline
+   * map would produce, i.e. if the rule itself, the tunables, or any
+   * bucket reachable from the rule's take steps changed
+   */
+  bool rule_affected_by_delta(int ruleno);
+
   /*
    * for maps where in devices have non-sequential id numbers, return a mapping of device id
    * to a sequential id number. For example, if we have devices with id's 0 1 4 5 6 return a map
@@ -171,6 +181,8 @@ public:
       min_rep(-1), max_rep(-1),
       num_batches(1),
       use_crush(true),
+      num_threads(1),
+      baseline(0),
       mark_down_device_ratio(0.0),
       mark_down_bucket_ratio(1.0),
       output_utilization(false),
@@ -247,6 +259,21 @@ public:
     return num_batches;
   }
 
+  void set_num_threads(int t) {
+    num_threads = t;
+  }
+  int get_num_threads() const {
+    return num_threads;
+  }
+
+  /**
+   * only test rules whose mapping could differ from what @p b
+   * produces; unaffected rules are skipped entirely
+   */
+  void set_baseline(CrushWrapper *b) {
+    baseline = b;
+  }
+
   void set_random_placement() {
     use_crush = false;
   }
@@ -26,6 +26,19 @@ bool CrushWrapper::has_v2_rules() const
   return false;
 }
 
+bool CrushWrapper::has_v4_buckets() const
+{
+  // check for use of the straw2 bucket algorithm
+  for (int i=0; i<crush->max_buckets; i++) {
+    crush_bucket *b = crush->buckets[i];
+    if (!b)
+      continue;
+    if (b->alg == CRUSH_BUCKET_STRAW2)
+      return true;
+  }
+  return false;
+}
+
 bool CrushWrapper::has_v3_rules() const
 {
   // check rules for use of SET_CHOOSELEAF_VARY_R step
@@ -906,6 +919,12 @@ void CrushWrapper::encode(bufferlist& bl, bool lean) const
       }
       break;
 
+    case CRUSH_BUCKET_STRAW2:
+      for (unsigned j=0; j<crush->buckets[i]->size; j++) {
+	::encode(((crush_bucket_straw2*)crush->buckets[i])->item_weights[j], bl);
+      }
+      break;
+
     default:
       assert(0);
       break;
@@ -1050,6 +1069,9 @@ void CrushWrapper::decode_crush_bucket(crush_bucket** bptr, bufferlist::iterator
   case CRUSH_BUCKET_STRAW:
     size = sizeof(crush_bucket_straw);
     break;
+  case CRUSH_BUCKET_STRAW2:
+    size = sizeof(crush_bucket_straw2);
+    break;
   default:
     {
       char str[128];
@@ -1113,6 +1135,15 @@ void CrushWrapper::decode_crush_bucket(crush_bucket** bptr, bufferlist::iterator
     break;
   }
 
+  case CRUSH_BUCKET_STRAW2: {
+    crush_bucket_straw2* cbs = (crush_bucket_straw2*)bucket;
+    cbs->item_weights = (__u32*)calloc(1, bucket->size * sizeof(__u32));
+    for (unsigned j = 0; j < bucket->size; ++j) {
+      ::decode(cbs->item_weights[j], blp);
+    }
+    break;
+  }
+
   default:
     // We should have handled this case in the first switch statement
     assert(0);
@@ -25,6 +25,7 @@ extern "C" {
 
 
 #include "common/Mutex.h"
+#include "common/Thread.h"
 
 #include "include/assert.h"
 #define BUG_ON(x) assert(!(x))
@@ -51,6 +52,37 @@ inline static void decode(crush_rule_step &s, bufferlist::iterator &p)
 using namespace std;
 class CrushWrapper {
   mutable Mutex mapper_lock;
+
+  /**
+   * reusable mapper scratch space
+   *
+   * do_rule() and do_rule_batch() run under mapper_lock, so one arena
+   * per wrapper is enough to make CRUSH evaluation allocation free:
+   * the vectors are sized on first use and only ever grow, since the
+   * sizes depend only on result_max and the batch size, not on the
+   * map contents.
+   */
+  struct MapperArena {
+    vector<int> result;       ///< one row of result_max
+    vector<int> batch_result; ///< num_x rows of result_max
+    vector<int> batch_len;    ///< num_x result lengths
+    vector<int> scratch;      ///< 3 * result_max
+    void reserve(int result_max) {
+      if ((int)result.size() < result_max)
+	result.resize(result_max);
+      if ((int)scratch.size() < result_max * 3)
+	scratch.resize(result_max * 3);
+    }
+    void reserve_batch(unsigned num, int result_max) {
+      reserve(result_max);
+      if (batch_result.size() < num * (size_t)result_max)
+	batch_result.resize(num * (size_t)result_max);
+      if (batch_len.size() < num)
+	batch_len.resize(num);
+    }
+  };
+  mutable MapperArena mapper_arena;
+
 public:
   struct crush_map *crush;
   std::map<int32_t, string> type_map; /* bucket/device type names */
@@ -215,6 +247,7 @@ public:
   }
   bool has_v2_rules() const;
   bool has_v3_rules() const;
+  bool has_v4_buckets() const;
 
 
   // bucket types
@@ -908,14 +941,124 @@ public:
   void do_rule(int rule, int x, vector<int>& out, int maxout,
 	       const vector<__u32>& weight) const {
     Mutex::Locker l(mapper_lock);
-    int rawout[maxout];
-    int scratch[maxout * 3];
-    int numrep = crush_do_rule(crush, rule, x, rawout, maxout, &weight[0], weight.size(), scratch);
+    mapper_arena.reserve(maxout);
+    int numrep = crush_do_rule(crush, rule, x, &mapper_arena.result[0],
+			       maxout, &weight[0], weight.size(),
+			       &mapper_arena.scratch[0]);
     if (numrep < 0)
       numrep = 0;
     out.resize(numrep);
     for (int i=0; i<numrep; i++)
-      out[i] = rawout[i];
+      out[i] = mapper_arena.result[i];
+  }
+
+private:
+  /// maps a contiguous slice of inputs; used by the batch mappers
+  struct BatchMapperJob : public Thread {
+    const struct crush_map *crush;
+    int rule;
+    const int *xs;
+    unsigned num;
+    vector<vector<int> > *out; ///< rows base..base+num-1
+    unsigned base;
+    int maxout;
+    const __u32 *weight;
+    int weight_max;
+    MapperArena *arena;  ///< buffers to (re)use, or NULL for private ones
+    void *entry() {
+      if (!num)
+	return NULL;
+      MapperArena local;
+      MapperArena *a = arena ? arena : &local;
+      a->reserve_batch(num, maxout);
+      crush_do_rule_batch(crush, rule, xs, num,
+			  &a->batch_result[0], &a->batch_len[0],
+			  maxout, weight, weight_max, &a->scratch[0]);
+      for (unsigned i = 0; i < num; i++) {
+	int numrep = a->batch_len[i];
+	if (numrep < 0)
+	  numrep = 0;
+	(*out)[base + i].resize(numrep);
+	for (int j = 0; j < numrep; j++)
+	  (*out)[base + i][j] = a->batch_result[i * maxout + j];
+      }
+      return NULL;
+    }
+  };
+
+public:
+  /**
+   * Map a batch of inputs with one rule.
+   *
+   * The rule lookup and scratch allocation happen once for the whole
+   * batch and the inputs are walked back to back, which keeps the
+   * bucket data hot in cache.  Results are identical to calling
+   * do_rule() once per input.  Intended for full-map walks (OSDMap
+   * rebuilds, osdmaptool --test-map-pgs, creating-pg placement).
+   */
+  void do_rule_batch(int rule, const vector<int>& xs,
+		     vector<vector<int> >& out, int maxout,
+		     const vector<__u32>& weight) const {
+    Mutex::Locker l(mapper_lock);
+    out.resize(xs.size());
+    if (xs.empty())
+      return;
+    BatchMapperJob job;
+    job.crush = crush;
+    job.rule = rule;
+    job.xs = &xs[0];
+    job.num = xs.size();
+    job.out = &out;
+    job.base = 0;
+    job.maxout = maxout;
+    job.weight = &weight[0];
+    job.weight_max = weight.size();
+    job.arena = &mapper_arena;
+    job.entry();
+  }
+
+  /**
+   * Thread-parallel variant of do_rule_batch() for tools.
+   *
+   * The mapper is read-only on the crush map, so slices of the input
+   * array can be mapped concurrently as long as each worker has its
+   * own scratch space; mapper_lock is held for the duration to keep
+   * concurrent map mutation out.  Don't use this from daemons -- it
+   * spawns num_threads threads per call.
+   */
+  void do_rule_batch_parallel(int rule, const vector<int>& xs,
+			      vector<vector<int> >& out, int maxout,
+			      const vector<__u32>& weight,
+			      unsigned num_threads) const {
+    if (num_threads <= 1 || xs.size() < num_threads) {
+      do_rule_batch(rule, xs, out, maxout, weight);
+      return;
+    }
+    Mutex::Locker l(mapper_lock);
+    out.resize(xs.size());
+    vector<BatchMapperJob*> jobs(num_threads);
+    unsigned per = xs.size() / num_threads;
+    unsigned rem = xs.size() % num_threads;
+    unsigned pos = 0;
+    for (unsigned t = 0; t < num_threads; t++) {
+      jobs[t] = new BatchMapperJob;
+      jobs[t]->crush = crush;
+      jobs[t]->rule = rule;
+      jobs[t]->xs = &xs[pos];
+      jobs[t]->num = per + (t < rem ? 1 : 0);
+      jobs[t]->out = &out;
+      jobs[t]->base = pos;
+      jobs[t]->maxout = maxout;
+      jobs[t]->weight = &weight[0];
+      jobs[t]->weight_max = weight.size();
+      jobs[t]->arena = NULL; // workers keep private scratch
+      pos += jobs[t]->num;
+      jobs[t]->create();
+    }
+    for (unsigned t = 0; t < num_threads; t++) {
+      jobs[t]->join();
+      delete jobs[t];
+    }
   }
 
   int read_from_file(const char *fn) {
@@ -0,0 +1,151 @@
+#ifndef CEPH_CRUSH_LN_TABLE_H
+#define CEPH_CRUSH_LN_TABLE_H
+
+#include "include/int_types.h"
+
+/*
+ * RH_LH_tbl[2*k]   = 2^56 / (256 + 2*k)         (RH, reciprocal)
+ * RH_LH_tbl[2*k+1] = 2^48 * log2((256 + 2*k)/256)  (LH, log high part)
+ *
+ * LL_tbl[j] = 2^48 * log2(1 + j / 2^15)            (log low part)
+ *
+ * Used by crush_ln() in mapper.c to compute a 16.48 fixed-point
+ * -ln(x) for the straw2 bucket without floating point.
+ */
+
+static __s64 __RH_LH_tbl[128*2+2] = {
+	0x0001000000000000ll, 0x0000000000000000ll, 0x0000fe03f80fe03fll, 0x000002dfca16dde1ll,
+	0x0000fc0fc0fc0fc0ll, 0x000005b9e5a170b5ll, 0x0000fa232cf25213ll, 0x0000088e68ea899all,
+	0x0000f83e0f83e0f8ll, 0x00000b5d69bac77fll, 0x0000f6603d980f66ll, 0x00000e26fd5c8556ll,
+	0x0000f4898d5f85bbll, 0x000010eb389fa2a0ll, 0x0000f2b9d6480f2bll, 0x000013aa2fdd27f2ll,
+	0x0000f0f0f0f0f0f0ll, 0x00001663f6fac913ll, 0x0000ef2eb71fc434ll, 0x00001918a16e4633ll,
+	0x0000ed7303b5cc0ell, 0x00001bc84240adacll, 0x0000ebbdb2a5c161ll, 0x00001e72ec117fa6ll,
+	0x0000ea0ea0ea0ea0ll, 0x00002118b119b4f4ll, 0x0000e865ac7b7603ll, 0x000023b9a32eaa57ll,
+	0x0000e6c2b4481cd8ll, 0x00002655d3c4f15cll, 0x0000e525982af70cll, 0x000028ed53f307efll,
+	0x0000e38e38e38e38ll, 0x00002b803473f7adll, 0x0000e1fc780e1fc7ll, 0x00002e0e85a9de05ll,
+	0x0000e070381c0e07ll, 0x0000309857a05e07ll, 0x0000dee95c4ca037ll, 0x0000331dba0efce2ll,
+	0x0000dd67c8a60dd6ll, 0x0000359ebc5b69d9ll, 0x0000dbeb61eed19cll, 0x0000381b6d9bb29cll,
+	0x0000da740da740dall, 0x00003a93dc9864b3ll, 0x0000d901b2036406ll, 0x00003d0817ce9cd5ll,
+	0x0000d79435e50d79ll, 0x00003f782d7204d0ll, 0x0000d62b80d62b80ll, 0x000041e42b6ec0c0ll,
+	0x0000d4c77b03531dll, 0x0000444c1f6b4c2ell, 0x0000d3680d3680d3ll, 0x000046b016ca47c2ll,
+	0x0000d20d20d20d20ll, 0x000049101eac381dll, 0x0000d0b69fcbd258ll, 0x00004b6c43f1366bll,
+	0x0000cf6474a8819ell, 0x00004dc4933a9338ll, 0x0000ce168a772508ll, 0x0000501918ec6c11ll,
+	0x0000ccccccccccccll, 0x00005269e12f346ell, 0x0000cb8727c065c3ll, 0x000054b6f7f1325bll,
+	0x0000ca4587e6b74fll, 0x0000570068e7ef5all, 0x0000c907da4e8711ll, 0x000059463f919defll,
+	0x0000c7ce0c7ce0c7ll, 0x00005b8887367433ll, 0x0000c6980c6980c6ll, 0x00005dc74ae9fbedll,
+	0x0000c565c87b5f9dll, 0x00006002958c5871ll, 0x0000c4372f855d82ll, 0x0000623a71cb82c9ll,
+	0x0000c30c30c30c30ll, 0x0000646eea247c5cll, 0x0000c1e4bbd595f6ll, 0x000066a008e4788dll,
+	0x0000c0c0c0c0c0c0ll, 0x000068cdd829fd81ll, 0x0000bfa02fe80bfall, 0x00006af861e5fc7dll,
+	0x0000be82fa0be82fll, 0x00006d1fafdce20bll, 0x0000bd6910470766ll, 0x00006f43cba79e41ll,
+	0x0000bc52640bc526ll, 0x00007164beb4a56dll, 0x0000bb3ee721a54dll, 0x000073829248e962ll,
+	0x0000ba2e8ba2e8ball, 0x0000759d4f80cba8ll, 0x0000b92143fa36f5ll, 0x000077b4ff5108d9ll,
+	0x0000b81702e05c0bll, 0x000079c9aa879d53ll, 0x0000b70fbb5a19bell, 0x00007bdb59cca388ll,
+	0x0000b60b60b60b60ll, 0x00007dea15a32c1bll, 0x0000b509e68a9b94ll, 0x00007ff5e66a0ffell,
+	0x0000b40b40b40b40ll, 0x000081fed45cbcccll, 0x0000b30f63528917ll, 0x00008404e793fb82ll,
+	0x0000b21642c8590bll, 0x000086082806b1d5ll, 0x0000b11fd3b80b11ll, 0x000088089d8a9e47ll,
+	0x0000b02c0b02c0b0ll, 0x00008a064fd50f2all, 0x0000af3addc680afll, 0x00008c01467b94bbll,
+	0x0000ae4c415c9882ll, 0x00008df988f4ae80ll, 0x0000ad602b580ad6ll, 0x00008fef1e987409ll,
+	0x0000ac7691840ac7ll, 0x000091e20ea1393ell, 0x0000ab8f69e28359ll, 0x000093d2602c2e60ll,
+	0x0000aaaaaaaaaaaall, 0x000095c01a39fbd7ll, 0x0000a9c84a47a07fll, 0x000097ab43af59f9ll,
+	0x0000a8e83f5717c0ll, 0x00009993e355a4e5ll, 0x0000a80a80a80a80ll, 0x00009b79ffdb6c8bll,
+	0x0000a72f05397829ll, 0x00009d5d9fd5010bll, 0x0000a655c4392d7bll, 0x00009f3ec9bcfb81ll,
+	0x0000a57eb50295fall, 0x0000a11d83f4c355ll, 0x0000a4a9cf1d9683ll, 0x0000a2f9d4c5103all,
+	0x0000a3d70a3d70a3ll, 0x0000a4d3c25e68dcll, 0x0000a3065e3fae7cll, 0x0000a6ab52d99e76ll,
+	0x0000a237c32b16cfll, 0x0000a8808c384548ll, 0x0000a16b312ea8fcll, 0x0000aa5374652a1cll,
+	0x0000a0a0a0a0a0a0ll, 0x0000ac241134c4eall, 0x00009fd809fd809fll, 0x0000adf26865a8a2ll,
+	0x00009f1165e72548ll, 0x0000afbe7fa0f04dll, 0x00009e4cad23dd5fll, 0x0000b1885c7aa982ll,
+	0x00009d89d89d89d8ll, 0x0000b35004723c46ll, 0x00009cc8e160c3fbll, 0x0000b5157cf2d078ll,
+	0x00009c09c09c09c0ll, 0x0000b6d8cb53b0call, 0x00009b4c6f9ef03all, 0x0000b899f4d8ab64ll,
+	0x00009a90e7d95bc6ll, 0x0000ba58feb2703bll, 0x000099d722dabde5ll, 0x0000bc15edfeed33ll,
+	0x0000991f1a515885ll, 0x0000bdd0c7c9a817ll, 0x00009868c809868cll, 0x0000bf89910c1679ll,
+	0x000097b425ed097bll, 0x0000c1404eadf384ll, 0x000097012e025c04ll, 0x0000c2f5058593d9ll,
+	0x0000964fda6c0964ll, 0x0000c4a7ba58377cll, 0x000095a02568095all, 0x0000c65871da59dell,
+	0x000094f2094f2094ll, 0x0000c80730b00016ll, 0x0000944580944580ll, 0x0000c9b3fb6d0559ll,
+	0x0000939a85c40939ll, 0x0000cb5ed69565b0ll, 0x000092f113840497ll, 0x0000cd07c69d8702ll,
+	0x0000924924924924ll, 0x0000ceaecfea8086ll, 0x000091a2b3c4d5e6ll, 0x0000d053f6d26089ll,
+	0x000090fdbc090fdbll, 0x0000d1f73f9c70c1ll, 0x0000905a38633e06ll, 0x0000d398ae817906ll,
+	0x00008fb823ee08fbll, 0x0000d53847ac00a7ll, 0x00008f1779d9fdc3ll, 0x0000d6d60f388e42ll,
+	0x00008e78356d1408ll, 0x0000d8720935e643ll, 0x00008dda52023769ll, 0x0000da0c39a54804ll,
+	0x00008d3dcb08d3dcll, 0x0000dba4a47aa997ll, 0x00008ca29c046514ll, 0x0000dd3b4d9cf24bll,
+	0x00008c08c08c08c0ll, 0x0000ded038e633f3ll, 0x00008b70344a139bll, 0x0000e0636a23e2efll,
+	0x00008ad8f2fba938ll, 0x0000e1f4e5170d03ll, 0x00008a42f8705669ll, 0x0000e384ad748f0ell,
+	0x000089ae4089ae40ll, 0x0000e512c6e54999ll, 0x0000891ac73ae981ll, 0x0000e69f35065448ll,
+	0x0000888888888888ll, 0x0000e829fb693045ll, 0x000087f78087f780ll, 0x0000e9b31d93f98fll,
+	0x00008767ab5f34e4ll, 0x0000eb3a9f019750ll, 0x000086d905447a34ll, 0x0000ecc08321eb31ll,
+	0x0000864b8a7de6d1ll, 0x0000ee44cd59ffabll, 0x000085bf37612ceell, 0x0000efc781043579ll,
+	0x0000853408534085ll, 0x0000f148a170700all, 0x000084a9f9c8084all, 0x0000f2c831e44116ll,
+	0x0000842108421084ll, 0x0000f446359b1354ll, 0x0000839930523fbell, 0x0000f5c2afc65448ll,
+	0x000083126e978d4fll, 0x0000f73da38d9d4all, 0x0000828cbfbeb9a0ll, 0x0000f8b7140edbb2ll,
+	0x0000820820820820ll, 0x0000fa2f045e7833ll, 0x000081848da8faf0ll, 0x0000fba577877d7dll,
+	0x0000810204081020ll, 0x0000fd1a708bbe12ll, 0x0000808080808080ll, 0x0000fe8df263f958ll,
+	0x0000800000000000ll, 0x0001000000000000ll,
+};
+
+static __s64 __LL_tbl[256] = {
+	0x0000000000000000ll, 0x000000017153bda9ll, 0x00000002e2a60a00ll, 0x0000000453f6e509ll,
+	0x00000005c5464ec6ll, 0x000000073694473all, 0x00000008a7e0ce68ll, 0x0000000a192be453ll,
+	0x0000000b8a7588fdll, 0x0000000cfbbdbc6all, 0x0000000e6d047e9dll, 0x0000000fde49cf98ll,
+	0x000000114f8daf5ell, 0x00000012c0d01df3ll, 0x0000001432111b58ll, 0x00000015a350a792ll,
+	0x00000017148ec2a2ll, 0x0000001885cb6c8cll, 0x00000019f706a552ll, 0x0000001b68406cf8ll,
+	0x0000001cd978c380ll, 0x0000001e4aafa8eell, 0x0000001fbbe51d43ll, 0x000000212d192084ll,
+	0x000000229e4bb2b2ll, 0x000000240f7cd3d1ll, 0x0000002580ac83e4ll, 0x00000026f1dac2eell,
+	0x00000028630790f0ll, 0x00000029d432edefll, 0x0000002b455cd9edll, 0x0000002cb68554eell,
+	0x0000002e27ac5ef3ll, 0x0000002f98d1f800ll, 0x0000003109f62017ll, 0x000000327b18d73cll,
+	0x00000033ec3a1d72ll, 0x000000355d59f2bbll, 0x00000036ce78571all, 0x000000383f954a92ll,
+	0x00000039b0b0cd26ll, 0x0000003b21caded9ll, 0x0000003c92e37faell, 0x0000003e03faafa8ll,
+	0x0000003f75106ec8ll, 0x00000040e624bd14ll, 0x0000004257379a8cll, 0x00000043c8490735ll,
+	0x0000004539590310ll, 0x00000046aa678e22ll, 0x000000481b74a86cll, 0x000000498c8051f2ll,
+	0x0000004afd8a8ab6ll, 0x0000004c6e9352bcll, 0x0000004ddf9aaa06ll, 0x0000004f50a09098ll,
+	0x00000050c1a50673ll, 0x0000005232a80b9bll, 0x00000053a3a9a013ll, 0x0000005514a9c3dell,
+	0x0000005685a876fell, 0x00000057f6a5b977ll, 0x0000005967a18b4bll, 0x0000005ad89bec7dll,
+	0x0000005c4994dd10ll, 0x0000005dba8c5d07ll, 0x0000005f2b826c65ll, 0x000000609c770b2cll,
+	0x000000620d6a3961ll, 0x000000637e5bf704ll, 0x00000064ef4c441all, 0x00000066603b20a5ll,
+	0x00000067d1288ca8ll, 0x0000006942148826ll, 0x0000006ab2ff1322ll, 0x0000006c23e82d9fll,
+	0x0000006d94cfd79fll, 0x0000006f05b61126ll, 0x00000070769ada36ll, 0x00000071e77e32d2ll,
+	0x0000007358601afdll, 0x00000074c94092ball, 0x000000763a1f9a0cll, 0x00000077aafd30f6ll,
+	0x000000791bd9577all, 0x0000007a8cb40d9cll, 0x0000007bfd8d535ell, 0x0000007d6e6528c3ll,
+	0x0000007edf3b8dcfll, 0x0000008050108283ll, 0x00000081c0e406e3ll, 0x0000008331b61af2ll,
+	0x00000084a286beb2ll, 0x000000861355f227ll, 0x000000878423b553ll, 0x00000088f4f00839ll,
+	0x0000008a65baeadcll, 0x0000008bd6845d40ll, 0x0000008d474c5f66ll, 0x0000008eb812f151ll,
+	0x0000009028d81306ll, 0x00000091999bc485ll, 0x000000930a5e05d3ll, 0x000000947b1ed6f2ll,
+	0x00000095ebde37e5ll, 0x000000975c9c28b0ll, 0x00000098cd58a953ll, 0x0000009a3e13b9d4ll,
+	0x0000009baecd5a34ll, 0x0000009d1f858a76ll, 0x0000009e903c4a9ell, 0x000000a000f19aaell,
+	0x000000a171a57aa8ll, 0x000000a2e257ea91ll, 0x000000a45308ea6all, 0x000000a5c3b87a38ll,
+	0x000000a7346699fbll, 0x000000a8a51349b8ll, 0x000000aa15be8971ll, 0x000000ab86685929ll,
+	0x000000acf710b8e3ll, 0x000000ae67b7a8a2ll, 0x000000afd85d2869ll, 0x000000b14901383all,
+	0x000000b2b9a3d819ll, 0x000000b42a450808ll, 0x000000b59ae4c80all, 0x000000b70b831822ll,
+	0x000000b87c1ff854ll, 0x000000b9ecbb68a1ll, 0x000000bb5d55690cll, 0x000000bccdedf999ll,
+	0x000000be3e851a4bll, 0x000000bfaf1acb24ll, 0x000000c11faf0c27ll, 0x000000c29041dd57ll,
+	0x000000c400d33eb6ll, 0x000000c571633049ll, 0x000000c6e1f1b211ll, 0x000000c8527ec412ll,
+	0x000000c9c30a664ell, 0x000000cb339498c8ll, 0x000000cca41d5b83ll, 0x000000ce14a4ae82ll,
+	0x000000cf852a91c8ll, 0x000000d0f5af0558ll, 0x000000d266320934ll, 0x000000d3d6b39d5fll,
+	0x000000d54733c1ddll, 0x000000d6b7b276b0ll, 0x000000d8282fbbdbll, 0x000000d998ab9161ll,
+	0x000000db0925f744ll, 0x000000dc799eed89ll, 0x000000ddea167430ll, 0x000000df5a8c8b3ell,
+	0x000000e0cb0132b5ll, 0x000000e23b746a98ll, 0x000000e3abe632eall, 0x000000e51c568baell,
+	0x000000e68cc574e7ll, 0x000000e7fd32ee97ll, 0x000000e96d9ef8c1ll, 0x000000eade099369ll,
+	0x000000ec4e72be91ll, 0x000000edbeda7a3cll, 0x000000ef2f40c66cll, 0x000000f09fa5a325ll,
+	0x000000f21009106all, 0x000000f3806b0e3ell, 0x000000f4f0cb9ca2ll, 0x000000f6612abb9bll,
+	0x000000f7d1886b2bll, 0x000000f941e4ab54ll, 0x000000fab23f7c1all, 0x000000fc2298dd80ll,
+	0x000000fd92f0cf89ll, 0x000000ff03475237ll, 0x00000100739c658dll, 0x00000101e3f0098ell,
+	0x0000010354423e3cll, 0x00000104c493039cll, 0x0000010634e259afll, 0x00000107a5304079ll,
+	0x00000109157cb7fcll, 0x0000010a85c7c03cll, 0x0000010bf611593all, 0x0000010d665982fbll,
+	0x0000010ed6a03d80ll, 0x0000011046e588cdll, 0x00000111b72964e4ll, 0x00000113276bd1c9ll,
+	0x0000011497accf7ell, 0x0000011607ec5e06ll, 0x00000117782a7d64ll, 0x00000118e8672d9bll,
+	0x0000011a58a26eaell, 0x0000011bc8dc409fll, 0x0000011d3914a372ll, 0x0000011ea94b9729ll,
+	0x0000012019811bc7ll, 0x0000012189b5314fll, 0x00000122f9e7d7c3ll, 0x000001246a190f28ll,
+	0x00000125da48d77fll, 0x000001274a7730ccll, 0x00000128baa41b10ll, 0x0000012a2acf9650ll,
+	0x0000012b9af9a28ell, 0x0000012d0b223fcdll, 0x0000012e7b496e0fll, 0x0000012feb6f2d58ll,
+	0x000001315b937dabll, 0x00000132cbb65f0all, 0x000001343bd7d178ll, 0x00000135abf7d4f7ll,
+	0x000001371c16698cll, 0x000001388c338f39ll, 0x00000139fc4f4600ll, 0x0000013b6c698de4ll,
+	0x0000013cdc8266e9ll, 0x0000013e4c99d111ll, 0x0000013fbcafcc5fll, 0x000001412cc458d6ll,
+	0x000001429cd77678ll, 0x000001440ce92549ll, 0x000001457cf9654cll, 0x00000146ed083682ll,
+	0x000001485d1598f0ll, 0x00000149cd218c98ll, 0x0000014b3d2c117dll, 0x0000014cad3527a1ll,
+	0x0000014e1d3ccf08ll, 0x0000014f8d4307b4ll, 0x00000150fd47d1a9ll, 0x000001526d4b2ce9ll,
+	0x00000153dd4d1977ll, 0x000001554d4d9755ll, 0x00000156bd4ca687ll, 0x000001582d4a4710ll,
+	0x000001599d4678f2ll, 0x0000015b0d413c31ll, 0x0000015c7d3a90cell, 0x0000015ded3276cell,
+	0x0000015f5d28ee32ll, 0x00000160cd1df6fell, 0x000001623d119134ll, 0x00000163ad03bcd8ll,
+	0x000001651cf479ecll, 0x000001668ce3c873ll, 0x00000167fcd1a870ll, 0x000001696cbe19e6ll,
+	0x0000016adca91cd8ll, 0x0000016c4c92b148ll, 0x0000016dbc7ad739ll, 0x0000016f2c618eaell,
+};
+
+#endif
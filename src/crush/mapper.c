@@ -22,6 +22,7 @@
 
 #include "crush.h"
 #include "hash.h"
+#include "crush_ln_table.h"
 
 /*
  * Implement the core CRUSH mapping algorithm.
@@ -239,6 +240,101 @@ static int bucket_straw_choose(struct crush_bucket_straw *bucket,
 	return bucket->h.items[high];
 }
 
+/* compute 2^44*log2(x+1) */
+static __u64 crush_ln(unsigned int xin)
+{
+	unsigned int x = xin, x1;
+	int iexpon, index1, index2;
+	__u64 RH, LH, LL, xl64, result;
+
+	x++;
+
+	/* normalize input */
+	iexpon = 15;
+	while (!(x & 0x18000)) {
+		x <<= 1;
+		iexpon--;
+	}
+
+	index1 = (x >> 8) << 1;
+	/* RH ~ 2^56/index1 */
+	RH = __RH_LH_tbl[index1 - 256];
+	/* LH ~ 2^48 * log2(index1/256) */
+	LH = __RH_LH_tbl[index1 + 1 - 256];
+
+	/* RH*x ~ 2^48 * (2^15 + xf), xf<2^8 */
+	xl64 = (__s64)x * RH;
+	xl64 >>= 48;
+	x1 = xl64;
+
+	result = iexpon;
+	result <<= (12 + 32);
+
+	index2 = x1 & 0xff;
+	/* LL ~ 2^48*log2(1.0+index2/2^15) */
+	LL = __LL_tbl[index2];
+
+	LH = LH + LL;
+
+	LH >>= (48 - 12 - 32);
+	result += LH;
+
+	return result;
+}
+
+/*
+ * straw2
+ *
+ * for reference, we calculate the drawn straw for item i as
+ *
+ *     ln(hash(x, i, r) / 0x10000) / weight_i
+ *
+ * the item with the largest (least negative) draw wins.  because the
+ * draw depends only on that item's own weight, changing one weight
+ * moves inputs only to or from that item, never between the others.
+ */
+static int bucket_straw2_choose(struct crush_bucket_straw2 *bucket,
+				int x, int r)
+{
+	unsigned i, high = 0;
+	unsigned u;
+	unsigned w;
+	__s64 ln, draw, high_draw = 0;
+
+	for (i = 0; i < bucket->h.size; i++) {
+		w = bucket->item_weights[i];
+		if (w) {
+			u = crush_hash32_3(bucket->h.hash, x,
+					   bucket->h.items[i], r);
+			u &= 0xffff;
+
+			/*
+			 * the ln lookup maps [0,0xffff] (corresponding to
+			 * real numbers (0,1]) to [-0x1000000000000, 0]
+			 * (corresponding to ln of those numbers, in 16.48
+			 * fixed point).
+			 */
+			ln = crush_ln(u) - 0x1000000000000ll;
+
+			/*
+			 * divide by the 16.16 fixed-point weight.  note
+			 * that the ln value is negative, so a larger
+			 * weight means a larger (less negative) value
+			 * for draw.
+			 */
+			draw = ln / w;
+		} else {
+			draw = -0x7fffffffffffffffll - 1ll;
+		}
+
+		if (i == 0 || draw > high_draw) {
+			high = i;
+			high_draw = draw;
+		}
+	}
+	return bucket->h.items[high];
+}
+
 static int crush_bucket_choose(struct crush_bucket *in, int x, int r)
 {
 	dprintk(" crush_bucket_choose %d x=%d r=%d\n", in->id, x, r);
@@ -256,6 +352,9 @@ static int crush_bucket_choose(struct crush_bucket *in, int x, int r)
 	case CRUSH_BUCKET_STRAW:
 		return bucket_straw_choose((struct crush_bucket_straw *)in,
 					   x, r);
+	case CRUSH_BUCKET_STRAW2:
+		return bucket_straw2_choose((struct crush_bucket_straw2 *)in,
+					    x, r);
 	default:
 		dprintk("unknown bucket %d alg %d\n", in->id, in->alg);
 		return in->items[0];
@@ -656,21 +755,16 @@ static void crush_choose_indep(const struct crush_map *map,
 #endif
 }
 
-/**
- * crush_do_rule - calculate a mapping with the given input and rule
- * @map: the crush_map
- * @ruleno: the rule id
- * @x: hash input
- * @result: pointer to result vector
- * @result_max: maximum result size
- * @weight: weight vector (for map leaves)
- * @weight_max: size of weight vector
- * @scratch: scratch vector for private use; must be >= 3 * result_max
+/*
+ * crush_do_rule_impl - run a single already-looked-up rule for one input.
+ * Factored out of crush_do_rule so batch callers can hoist the ruleno
+ * validation and rule lookup out of their loop.
  */
-int crush_do_rule(const struct crush_map *map,
-		  int ruleno, int x, int *result, int result_max,
-		  const __u32 *weight, int weight_max,
-		  int *scratch)
+static int crush_do_rule_impl(const struct crush_map *map,
+			      const struct crush_rule *rule,
+			      int x, int *result, int result_max,
+			      const __u32 *weight, int weight_max,
+			      int *scratch)
 {
 	int result_len;
 	int *a = scratch;
@@ -682,7 +776,6 @@ int crush_do_rule(const struct crush_map *map,
 	int *o;
 	int osize;
 	int *tmp;
-	struct crush_rule *rule;
 	__u32 step;
 	int i, j;
 	int numrep;
@@ -701,19 +794,13 @@ int crush_do_rule(const struct crush_map *map,
 
 	int vary_r = map->chooseleaf_vary_r;
 
-	if ((__u32)ruleno >= map->max_rules) {
-		dprintk(" bad ruleno %d\n", ruleno);
-		return 0;
-	}
-
-	rule = map->rules[ruleno];
 	result_len = 0;
 	w = a;
 	o = b;
 
 	for (step = 0; step < rule->len; step++) {
 		int firstn = 0;
-		struct crush_rule_step *curstep = &rule->steps[step];
+		const struct crush_rule_step *curstep = &rule->steps[step];
 
 		switch (curstep->op) {
 		case CRUSH_RULE_TAKE:
@@ -848,4 +935,74 @@ int crush_do_rule(const struct crush_map *map,
 	return result_len;
 }
 
+/**
+ * crush_do_rule - calculate a mapping with the given input and rule
+ * @map: the crush_map
+ * @ruleno: the rule id
+ * @x: hash input
+ * @result: pointer to result vector
+ * @result_max: maximum result size
+ * @weight: weight vector (for map leaves)
+ * @weight_max: size of weight vector
+ * @scratch: scratch vector for private use; must be >= 3 * result_max
+ */
+int crush_do_rule(const struct crush_map *map,
+		  int ruleno, int x, int *result, int result_max,
+		  const __u32 *weight, int weight_max,
+		  int *scratch)
+{
+	if ((__u32)ruleno >= map->max_rules) {
+		dprintk(" bad ruleno %d\n", ruleno);
+		return 0;
+	}
+
+	return crush_do_rule_impl(map, map->rules[ruleno], x,
+				  result, result_max,
+				  weight, weight_max, scratch);
+}
+
+/**
+ * crush_do_rule_batch - map many inputs with one rule in a single call
+ * @map: the crush_map
+ * @ruleno: the rule id
+ * @x: array of hash inputs
+ * @num_x: number of hash inputs
+ * @results: output array, num_x rows of result_max entries
+ * @result_lens: per-input result length, num_x entries
+ * @result_max: maximum result size per input
+ * @weight: weight vector (for map leaves)
+ * @weight_max: size of weight vector
+ * @scratch: scratch vector for private use; must be >= 3 * result_max
+ *
+ * The rule is validated and looked up once for the whole batch, the
+ * scratch vector is reused across inputs, and walking the inputs back
+ * to back keeps the bucket data hot in cache.  Mapping results are
+ * identical to calling crush_do_rule() once per input.
+ */
+void crush_do_rule_batch(const struct crush_map *map,
+			 int ruleno,
+			 const int *x, int num_x,
+			 int *results, int *result_lens, int result_max,
+			 const __u32 *weight, int weight_max,
+			 int *scratch)
+{
+	const struct crush_rule *rule;
+	int i;
+
+	if ((__u32)ruleno >= map->max_rules) {
+		dprintk(" bad ruleno %d\n", ruleno);
+		for (i = 0; i < num_x; i++)
+			result_lens[i] = 0;
+		return;
+	}
+
+	rule = map->rules[ruleno];
+	for (i = 0; i < num_x; i++)
+		result_lens[i] = crush_do_rule_impl(map, rule, x[i],
+						    results + i * result_max,
+						    result_max,
+						    weight, weight_max,
+						    scratch);
+}
+
 
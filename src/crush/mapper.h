@@ -16,5 +16,12 @@ extern int crush_do_rule(const struct crush_map *map,
 			 int x, int *result, int result_max,
 			 const __u32 *weights, int weight_max,
 			 int *scratch);
+extern void crush_do_rule_batch(const struct crush_map *map,
+				int ruleno,
+				const int *x, int num_x,
+				int *results, int *result_lens,
+				int result_max,
+				const __u32 *weights, int weight_max,
+				int *scratch);
 
 #endif
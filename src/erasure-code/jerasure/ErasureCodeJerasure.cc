@@ -119,11 +119,17 @@ int ErasureCodeJerasure::encode(const set<int> &want_to_encode,
   unsigned coding_length = blocksize * m;
   bufferptr coding(buffer::create_page_aligned(coding_length));
   out.push_back(coding);
-  out.rebuild_page_aligned();
   char *chunks[k + m];
   for (int i = 0; i < k + m; i++) {
     bufferlist &chunk = (*encoded)[i];
     chunk.substr_of(out, i * blocksize, blocksize);
+    // copy only the chunks that are fragmented or misaligned for the
+    // vectorized kernels instead of rebuilding the whole input: a
+    // contiguous, aligned buffer (the common case) encodes in place
+    if (!chunk.is_contiguous() ||
+	((long)chunk.buffers().front().c_str() %
+	 LARGEST_VECTOR_WORDSIZE))
+      chunk.rebuild_page_aligned();
     chunks[i] = chunk.c_str();
   }
   jerasure_encode(&chunks[0], &chunks[k], blocksize);
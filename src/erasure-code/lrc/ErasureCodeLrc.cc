@@ -0,0 +1,333 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ * Copyright (C) 2014 Cloudwatt <libre.licensing@cloudwatt.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <errno.h>
+#include <algorithm>
+#include "common/debug.h"
+#include "erasure-code/ErasureCodePlugin.h"
+#include "ErasureCodeLrc.h"
+#include "crush/CrushWrapper.h"
+#include "osd/osd_types.h"
+
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix _prefix(_dout)
+
+static ostream& _prefix(std::ostream* _dout)
+{
+  return *_dout << "ErasureCodeLrc: ";
+}
+
+static int to_int(const map<string,string> &parameters,
+		  const string &name,
+		  int default_value)
+{
+  map<string,string>::const_iterator i = parameters.find(name);
+  if (i == parameters.end())
+    return default_value;
+  return atoi(i->second.c_str());
+}
+
+int ErasureCodeLrc::init(const map<string,string> &parameters)
+{
+  map<string,string>::const_iterator parameter;
+  parameter = parameters.find("ruleset-root");
+  if (parameter != parameters.end())
+    ruleset_root = parameter->second;
+  parameter = parameters.find("ruleset-failure-domain");
+  if (parameter != parameters.end())
+    ruleset_failure_domain = parameter->second;
+
+  k = to_int(parameters, "k", 8);
+  m = to_int(parameters, "m", 3);
+  l = to_int(parameters, "l", 2);
+  if (k < 2 || m < 1 || l < 1) {
+    derr << "k=" << k << " m=" << m << " l=" << l
+	 << " must satisfy k >= 2, m >= 1, l >= 1" << dendl;
+    return -EINVAL;
+  }
+  if (k % l) {
+    derr << "k=" << k << " must be a multiple of the number"
+	 << " of local groups l=" << l << dendl;
+    return -EINVAL;
+  }
+
+  // the m global parities are computed by a jerasure code over the
+  // same k data chunks; the local XOR parities are layered on top
+  map<string,string> global_parameters = parameters;
+  if (global_parameters.count("technique") == 0)
+    global_parameters["technique"] = "reed_sol_van";
+  ErasureCodePluginRegistry &registry = ErasureCodePluginRegistry::instance();
+  stringstream ss;
+  int r = registry.factory("jerasure", global_parameters, &global_code, ss);
+  if (r) {
+    derr << "failed to load the global code: " << ss.str() << dendl;
+    return r;
+  }
+  return 0;
+}
+
+int ErasureCodeLrc::create_ruleset(const string &name,
+				   CrushWrapper &crush,
+				   ostream *ss) const
+{
+  return crush.add_simple_ruleset(name, ruleset_root, ruleset_failure_domain,
+				  "indep", pg_pool_t::TYPE_ERASURE, ss);
+}
+
+unsigned int ErasureCodeLrc::get_chunk_size(unsigned int object_size) const
+{
+  return global_code->get_chunk_size(object_size);
+}
+
+int ErasureCodeLrc::group_of(int chunk) const
+{
+  if (chunk < k)
+    return chunk / (k / l);
+  if (chunk < k + m)
+    return -1;
+  return chunk - (k + m);
+}
+
+void ErasureCodeLrc::group_chunks(int group, set<int> *chunks) const
+{
+  int group_size = k / l;
+  for (int i = group * group_size; i < (group + 1) * group_size; ++i)
+    chunks->insert(i);
+  chunks->insert(k + m + group);
+}
+
+void ErasureCodeLrc::chunk_xor(const bufferlist &in, bufferptr &out)
+{
+  assert(in.length() == out.length());
+  char *dst = out.c_str();
+  uint64_t offset = 0;
+  for (std::list<bufferptr>::const_iterator i = in.buffers().begin();
+       i != in.buffers().end();
+       ++i) {
+    const char *src = i->c_str();
+    for (unsigned j = 0; j < i->length(); ++j)
+      dst[offset + j] ^= src[j];
+    offset += i->length();
+  }
+}
+
+int ErasureCodeLrc::minimum_to_decode(const set<int> &want_to_read,
+				      const set<int> &available_chunks,
+				      set<int> *minimum)
+{
+  if (includes(available_chunks.begin(), available_chunks.end(),
+	       want_to_read.begin(), want_to_read.end())) {
+    *minimum = want_to_read;
+    return 0;
+  }
+
+  // repair each missing chunk within its local group if the rest of
+  // the group survived; this is the cheap path that motivates the code
+  set<int> min_set;
+  bool local_ok = true;
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i) {
+    if (available_chunks.count(*i)) {
+      min_set.insert(*i);
+      continue;
+    }
+    int group = group_of(*i);
+    if (group < 0) {
+      local_ok = false;
+      break;
+    }
+    set<int> members;
+    group_chunks(group, &members);
+    members.erase(*i);
+    if (!includes(available_chunks.begin(), available_chunks.end(),
+		  members.begin(), members.end())) {
+      local_ok = false;
+      break;
+    }
+    min_set.insert(members.begin(), members.end());
+  }
+  if (local_ok) {
+    *minimum = min_set;
+    return 0;
+  }
+
+  // fall back to the global code: read enough of the data and global
+  // parity chunks to decode everything we want
+  set<int> global_want;
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i) {
+    if (*i < k + m) {
+      global_want.insert(*i);
+    } else {
+      // a local parity is recomputed from its group's data chunks
+      int group_size = k / l;
+      int group = *i - (k + m);
+      for (int j = group * group_size; j < (group + 1) * group_size; ++j)
+	global_want.insert(j);
+    }
+  }
+  set<int> global_available;
+  for (set<int>::const_iterator i = available_chunks.begin();
+       i != available_chunks.end();
+       ++i) {
+    if (*i < k + m)
+      global_available.insert(*i);
+  }
+  return global_code->minimum_to_decode(global_want, global_available,
+					minimum);
+}
+
+int ErasureCodeLrc::minimum_to_decode_with_cost(const set<int> &want_to_read,
+						const map<int, int> &available,
+						set<int> *minimum)
+{
+  set<int> available_chunks;
+  for (map<int, int>::const_iterator i = available.begin();
+       i != available.end();
+       ++i)
+    available_chunks.insert(i->first);
+  return minimum_to_decode(want_to_read, available_chunks, minimum);
+}
+
+int ErasureCodeLrc::encode(const set<int> &want_to_encode,
+			   const bufferlist &in,
+			   map<int, bufferlist> *encoded)
+{
+  set<int> global_want;
+  for (int i = 0; i < k + m; ++i)
+    global_want.insert(i);
+  int r = global_code->encode(global_want, in, encoded);
+  if (r)
+    return r;
+
+  unsigned blocksize = (*encoded)[0].length();
+  int group_size = k / l;
+  for (int group = 0; group < l; ++group) {
+    bufferptr parity(buffer::create(blocksize));
+    parity.zero();
+    for (int i = group * group_size; i < (group + 1) * group_size; ++i)
+      chunk_xor((*encoded)[i], parity);
+    (*encoded)[k + m + group].push_back(parity);
+  }
+
+  for (int i = 0; i < (int)get_chunk_count(); ++i) {
+    if (want_to_encode.count(i) == 0)
+      encoded->erase(i);
+  }
+  return 0;
+}
+
+int ErasureCodeLrc::decode(const set<int> &want_to_read,
+			   const map<int, bufferlist> &chunks,
+			   map<int, bufferlist> *decoded)
+{
+  assert(!chunks.empty());
+  map<int, bufferlist> have(chunks);
+  unsigned blocksize = have.begin()->second.length();
+
+  // cheap path: single erasures repaired inside their local group
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i) {
+    if (have.count(*i))
+      continue;
+    int group = group_of(*i);
+    if (group < 0)
+      continue;
+    set<int> members;
+    group_chunks(group, &members);
+    members.erase(*i);
+    bool can_repair = true;
+    for (set<int>::iterator j = members.begin(); j != members.end(); ++j) {
+      if (!have.count(*j)) {
+	can_repair = false;
+	break;
+      }
+    }
+    if (!can_repair)
+      continue;
+    bufferptr repaired(buffer::create(blocksize));
+    repaired.zero();
+    for (set<int>::iterator j = members.begin(); j != members.end(); ++j)
+      chunk_xor(have[*j], repaired);
+    have[*i].push_back(repaired);
+  }
+
+  // whatever is still missing needs the global code
+  set<int> still_missing;
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i) {
+    if (!have.count(*i))
+      still_missing.insert(*i);
+  }
+  if (!still_missing.empty()) {
+    set<int> global_want;
+    for (int i = 0; i < k; ++i)
+      global_want.insert(i);
+    for (set<int>::iterator i = still_missing.begin();
+	 i != still_missing.end();
+	 ++i) {
+      if (*i >= k && *i < k + m)
+	global_want.insert(*i);
+    }
+    map<int, bufferlist> global_chunks;
+    for (map<int, bufferlist>::iterator i = have.begin();
+	 i != have.end();
+	 ++i) {
+      if (i->first < k + m)
+	global_chunks[i->first] = i->second;
+    }
+    map<int, bufferlist> global_decoded;
+    int r = global_code->decode(global_want, global_chunks, &global_decoded);
+    if (r)
+      return r;
+    for (map<int, bufferlist>::iterator i = global_decoded.begin();
+	 i != global_decoded.end();
+	 ++i) {
+      if (!have.count(i->first))
+	have[i->first] = i->second;
+    }
+    // local parities are recomputed from the repaired data
+    for (set<int>::iterator i = still_missing.begin();
+	 i != still_missing.end();
+	 ++i) {
+      if (have.count(*i))
+	continue;
+      assert(*i >= k + m);
+      int group = *i - (k + m);
+      int group_size = k / l;
+      bufferptr parity(buffer::create(blocksize));
+      parity.zero();
+      for (int j = group * group_size; j < (group + 1) * group_size; ++j) {
+	if (!have.count(j))
+	  return -EIO;
+	chunk_xor(have[j], parity);
+      }
+      have[*i].push_back(parity);
+    }
+  }
+
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i) {
+    if (!have.count(*i))
+      return -EIO;
+    (*decoded)[*i] = have[*i];
+  }
+  return 0;
+}
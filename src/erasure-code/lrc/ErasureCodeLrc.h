@@ -0,0 +1,97 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ * Copyright (C) 2014 Cloudwatt <libre.licensing@cloudwatt.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef CEPH_ERASURE_CODE_LRC_H
+#define CEPH_ERASURE_CODE_LRC_H
+
+#include "erasure-code/ErasureCodeInterface.h"
+
+/**
+ * Locally repairable code.
+ *
+ * The k data chunks are split into l local groups of k/l chunks and
+ * each group gets an additional XOR parity chunk, layered on top of a
+ * global code (jerasure) that provides m parity chunks over all k
+ * data chunks.  The chunk layout is:
+ *
+ *   [0, k)          data chunks
+ *   [k, k+m)        global parity chunks, from the global code
+ *   [k+m, k+m+l)    local XOR parity chunks, one per group
+ *
+ * Losing a single chunk of a group is repaired by XORing the k/l
+ * surviving chunks of that group instead of reading k chunks for a
+ * global decode, which is what cuts recovery traffic.  Multiple
+ * losses within a group fall back to the global code.
+ */
+class ErasureCodeLrc : public ErasureCodeInterface {
+public:
+  int k;  ///< data chunks
+  int m;  ///< global parity chunks
+  int l;  ///< local groups, each of k/l data chunks plus one XOR parity
+  string ruleset_root;
+  string ruleset_failure_domain;
+  ErasureCodeInterfaceRef global_code;
+
+  ErasureCodeLrc() :
+    k(0), m(0), l(0),
+    ruleset_root("default"),
+    ruleset_failure_domain("host")
+  {}
+
+  virtual ~ErasureCodeLrc() {}
+
+  /// @return 0 on success, a negative errno if the parameters are invalid
+  int init(const map<string,string> &parameters);
+
+  virtual int create_ruleset(const string &name,
+			     CrushWrapper &crush,
+			     ostream *ss) const;
+
+  virtual unsigned int get_chunk_count() const {
+    return k + m + l;
+  }
+
+  virtual unsigned int get_data_chunk_count() const {
+    return k;
+  }
+
+  virtual unsigned int get_chunk_size(unsigned int object_size) const;
+
+  virtual int minimum_to_decode(const set<int> &want_to_read,
+				const set<int> &available_chunks,
+				set<int> *minimum);
+
+  virtual int minimum_to_decode_with_cost(const set<int> &want_to_read,
+					  const map<int, int> &available,
+					  set<int> *minimum);
+
+  virtual int encode(const set<int> &want_to_encode,
+		     const bufferlist &in,
+		     map<int, bufferlist> *encoded);
+
+  virtual int decode(const set<int> &want_to_read,
+		     const map<int, bufferlist> &chunks,
+		     map<int, bufferlist> *decoded);
+
+private:
+  /// group of a chunk, or -1 for a global parity chunk
+  int group_of(int chunk) const;
+
+  /// all chunks of a group: its data chunks and its local parity
+  void group_chunks(int group, set<int> *chunks) const;
+
+  static void chunk_xor(const bufferlist &in, bufferptr &out);
+};
+
+#endif
@@ -128,6 +128,15 @@ void global_init(std::vector < const char * > *alt_def_args,
   if (g_conf->log_flush_on_exit)
     g_ceph_context->_log->set_flush_on_exit();
 
+  // pin ourselves before any worker threads spawn, so every thread
+  // (and its first-touch allocations) inherits the mask
+  if (g_conf->cpu_affinity.length()) {
+    int r = ceph_pin_thread(pthread_self(), g_conf->cpu_affinity);
+    if (r < 0)
+      derr << "warning: unable to pin to cpus '" << g_conf->cpu_affinity
+	   << "': " << cpp_strerror(r) << dendl;
+  }
+
   if (g_conf->run_dir.length() &&
       code_env == CODE_ENVIRONMENT_DAEMON &&
       !(flags & CINIT_FLAG_NO_DAEMON_ACTIONS)) {
@@ -41,6 +41,13 @@ namespace ceph {
       val = v;
       ceph_spin_unlock(&lock);
     }
+    void set_release(size_t v) {
+      // the spinlock is already a full barrier
+      set(v);
+    }
+    static void read_barrier() {
+      // the spinlock is already a full barrier
+    }
     T inc() {
       ceph_spin_lock(&lock);
       T r = ++val;
@@ -70,6 +77,16 @@ namespace ceph {
       ceph_spin_unlock(&lock);
       return ret;
     }
+    bool compare_and_swap(T o, T n) {
+      bool success = false;
+      ceph_spin_lock(&lock);
+      if (val == o) {
+	success = true;
+	val = n;
+      }
+      ceph_spin_unlock(&lock);
+      return success;
+    }
   private:
     // forbid copying
     atomic_spinlock_t(const atomic_spinlock_t<T> &other);
@@ -94,10 +111,26 @@ namespace ceph {
     void set(size_t v) {
       AO_store(&val, v);
     }
+    void set_release(size_t v) {
+      // write (release) barrier; publishes data written before the
+      // store, e.g. a lock-free ring slot
+      AO_store_release(&val, v);
+    }
+    static void read_barrier() {
+      // read (acquire) barrier; pairs with the release in dec() so a
+      // thread that saw the count hit zero also sees every other
+      // thread's writes to the object before tearing it down
+      AO_nop_read();
+    }
     AO_t inc() {
+      // no barrier; taking an additional reference (e.g. buffer::raw,
+      // RefCountedObject) needs no ordering of its own, and the plain
+      // fetch_and_add avoids a full fence on every ptr copy
       return AO_fetch_and_add1(&val) + 1;
     }
     AO_t dec() {
+      // write (release) barrier, so everything we did to the object is
+      // visible before the count drops and another thread may free it
       return AO_fetch_and_sub1_write(&val) - 1;
     }
     void add(AO_t add_me) {
@@ -113,6 +146,9 @@ namespace ceph {
       // at some point.  this hack can go away someday...
       return AO_load_full((AO_t *)&val);
     }
+    bool compare_and_swap(AO_t o, AO_t n) {
+      return AO_compare_and_swap(&val, o, n);
+    }
   private:
     // forbid copying
     atomic_t(const atomic_t &other);
@@ -47,8 +47,11 @@
 #include <string>
 #include <exception>
 
+#include <pthread.h>
+
 #include "page.h"
 #include "crc32c.h"
+#include "common/simple_spin.h"
 
 #ifdef __CEPH__
 # include "include/assert.h"
@@ -130,6 +133,7 @@ private:
   class raw_hack_aligned;
   class raw_char;
   class raw_pipe;
+  class raw_pooled;
 
   friend std::ostream& operator<<(std::ostream& out, const raw &r);
 
@@ -147,6 +151,77 @@ public:
   static raw* create_page_aligned(unsigned len);
   static raw* create_zero_copy(unsigned len, int fd, int64_t *offset);
 
+  /*
+   * a recycling allocator for receive buffers.
+   *
+   * keeps per-size-class free lists of page aligned buffers (4k, 64k,
+   * 1m).  create() hands out a raw backed by a pooled buffer; when the
+   * last reference to that raw drops, the memory goes back on the free
+   * list instead of to the heap allocator.  requests that do not fit a
+   * size class (or a zero max_per_size) fall through to the plain
+   * buffer::create*() constructors.  reference counted, since
+   * outstanding buffers may outlive the pool's owner.
+   *
+   * each thread keeps a small magazine of free buffers in front of the
+   * shared lists, so the common alloc/free pattern never touches the
+   * pool spinlock; magazines refill from and spill to the shared lists
+   * in batches.
+   */
+  class pool {
+  public:
+    static const unsigned NUM_SIZES = 3;
+    static const unsigned pool_sizes[NUM_SIZES];
+
+    /// allocation counters for one size class, summed over all pools
+    struct size_class_stats {
+      uint64_t alloc;       ///< pooled raws handed out
+      uint64_t tls_hit;     ///< satisfied from the thread's magazine
+      uint64_t shared_hit;  ///< satisfied from the shared free list
+    };
+    /// copy out per-size-class counters; stats must hold NUM_SIZES entries
+    static void get_stats(size_class_stats *stats);
+
+  private:
+    simple_spinlock_t lock;
+    unsigned nref;
+    unsigned max_per_size;       ///< free buffers to cache per size class
+    char *free_bufs[NUM_SIZES];  ///< intrusive free lists (next ptr in buffer)
+    unsigned free_count[NUM_SIZES];
+
+    struct thread_cache;
+    pthread_key_t tls_key;
+    thread_cache *get_thread_cache();
+    static void flush_thread_cache(void *p);
+
+    friend class raw_pooled;
+    /// take memory back from a dying raw_pooled
+    void recycle(char *data, unsigned index);
+
+    unsigned size_index(unsigned len) {
+      unsigned i = 0;
+      while (i < NUM_SIZES && len > pool_sizes[i])
+	i++;
+      return i;
+    }
+    raw *create_from_class(unsigned index, unsigned len);
+
+    ~pool();
+
+    // no copying.
+    pool(const pool &other);
+    const pool& operator=(const pool &other);
+
+  public:
+    explicit pool(unsigned max);
+    pool *get();
+    void put();
+
+    /// like buffer::create, but drawing from the pool when len fits
+    raw *create(unsigned len);
+    /// like buffer::create_page_aligned; pooled buffers are always aligned
+    raw *create_page_aligned(unsigned len);
+  };
+
   /*
    * a buffer pointer.  references (a subsequence of) a raw buffer.
    */
@@ -297,6 +372,12 @@ public:
       void copy(unsigned len, std::string &dest);
       void copy_all(list &dest);
 
+      // like copy(len, ptr&), but when the range lies within the
+      // current buffer the ptr aliases it (taking a ref on the
+      // underlying raw) instead of copying.  the view pins the whole
+      // raw in memory, so keep it short-lived.
+      void copy_shallow(unsigned len, ptr &dest);
+
       // copy data in
       void copy_in(unsigned len, const char *src);
       void copy_in(unsigned len, const list& otherl);
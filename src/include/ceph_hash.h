@@ -3,11 +3,18 @@
 
 #define CEPH_STR_HASH_LINUX      0x1  /* linux dcache hash */
 #define CEPH_STR_HASH_RJENKINS   0x2  /* robert jenkins' */
+#define CEPH_STR_HASH_CRC32C     0x3  /* crc32c; hw-accelerated when available */
 
 extern unsigned ceph_str_hash_linux(const char *s, unsigned len);
 extern unsigned ceph_str_hash_rjenkins(const char *s, unsigned len);
+extern unsigned ceph_str_hash_crc32c(const char *s, unsigned len);
 
 extern unsigned ceph_str_hash(int type, const char *s, unsigned len);
 extern const char *ceph_str_hash_name(int type);
 
+/* hash n strings of the given type into out[] */
+extern void ceph_str_hash_batch(int type, unsigned n,
+				const char * const *strs,
+				const unsigned *lens, unsigned *out);
+
 #endif
@@ -741,6 +741,56 @@ int ceph_read(struct ceph_mount_info *cmount, int fd, char *buf, int64_t size, i
 int ceph_write(struct ceph_mount_info *cmount, int fd, const char *buf, int64_t size,
 	       int64_t offset);
 
+/**
+ * The type of the callback invoked when an asynchronous read or write
+ * completes.  It is called from an internal thread and must not block;
+ * it may call back into libcephfs.
+ *
+ * @param res the number of bytes read/written, or a negative error code.
+ * @param priv the opaque pointer the caller passed when submitting the I/O.
+ */
+typedef void (*ceph_aio_callback_t)(int res, void *priv);
+
+/**
+ * Start an asynchronous read from the file.
+ *
+ * @param cmount the ceph mount handle to use for performing the read.
+ * @param fd the file descriptor of the open file to read from.
+ * @param buf the buffer to read data into; it must stay valid until the
+ *        callback fires.
+ * @param size the size of the buffer.
+ * @param offset the offset in the file to read from.  Unlike ceph_read,
+ *        this must not be negative; asynchronous I/O never uses the file
+ *        descriptor's implicit position.
+ * @param cb the completion callback.
+ * @param priv an opaque pointer passed through to the callback.
+ * @returns 0 if the read was submitted (the callback will be invoked
+ *          exactly once), or a negative error code if submission failed
+ *          (the callback is not invoked).
+ */
+int ceph_aio_read(struct ceph_mount_info *cmount, int fd, char *buf, int64_t size,
+		  int64_t offset, ceph_aio_callback_t cb, void *priv);
+
+/**
+ * Start an asynchronous write to a file.
+ *
+ * @param cmount the ceph mount handle to use for performing the write.
+ * @param fd the file descriptor of the open file to write to.
+ * @param buf the bytes to write; the buffer may be reused once the
+ *        callback fires.
+ * @param size the size of the buf array.
+ * @param offset the offset of the file to write into.  Unlike ceph_write,
+ *        this must not be negative; asynchronous I/O never uses the file
+ *        descriptor's implicit position.
+ * @param cb the completion callback.
+ * @param priv an opaque pointer passed through to the callback.
+ * @returns 0 if the write was submitted (the callback will be invoked
+ *          exactly once), or a negative error code if submission failed
+ *          (the callback is not invoked).
+ */
+int ceph_aio_write(struct ceph_mount_info *cmount, int fd, const char *buf,
+		   int64_t size, int64_t offset, ceph_aio_callback_t cb, void *priv);
+
 /**
  * Truncate a file to the given size.
  *
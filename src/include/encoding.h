@@ -57,8 +57,63 @@ inline void decode_raw(T& t, bufferlist::iterator &p)
   p.copy(sizeof(t), (char*)&t);
 }
 
+// --------------------------------------
+// compile-time encoding traits
+//
+// Fixed-size, endian-safe types declare their exact wire size here, so
+// composite encoders can sum them at compile time, reserve one
+// contiguous region and fill it with plain stores instead of going
+// through bufferlist::append's bounds checks for every field.  The
+// wire format is unchanged; this only generates better code.
+
+template<class T>
+struct fixed_encoding {
+  enum { is_fixed = 0, wire_size = 0 };
+};
+
+#define WRITE_FIXED_ENCODING(type, bytes)				\
+  template<> struct fixed_encoding<type> {				\
+    enum { is_fixed = 1, wire_size = bytes };				\
+  };
+
+/*
+ * Append encoded bytes into a region reserved up front.  The caller
+ * computes the exact size (typically from fixed_encoding<> sums); the
+ * destructor appends the filled buffer to the bufferlist and asserts
+ * the reservation was filled exactly.
+ */
+class contiguous_appender {
+  bufferlist &bl;
+  buffer::ptr bp;
+  char *pos;
+
+  // no copying; the destructor appends
+  contiguous_appender(const contiguous_appender &);
+  contiguous_appender& operator=(const contiguous_appender &);
+
+ public:
+  contiguous_appender(bufferlist &_bl, unsigned len)
+    : bl(_bl), bp(buffer::create(len)), pos(bp.c_str()) {}
+  ~contiguous_appender() {
+    assert(pos == bp.c_str() + bp.length());
+    bl.append(bp);
+  }
+  void append(const void *s, unsigned len) {
+    assert(pos + len <= bp.c_str() + bp.length());
+    memcpy(pos, s, len);
+    pos += len;
+  }
+};
+
+template<class T>
+inline void encode_raw(const T& t, contiguous_appender& a)
+{
+  a.append((const char *)&t, sizeof(t));
+}
+
 #define WRITE_RAW_ENCODER(type)						\
   inline void encode(const type &v, bufferlist& bl, uint64_t features=0) { encode_raw(v, bl); } \
+  inline void encode(const type &v, contiguous_appender& a) { encode_raw(v, a); } \
   inline void decode(type &v, bufferlist::iterator& p) { __ASSERT_FUNCTION decode_raw(v, p); }
 
 WRITE_RAW_ENCODER(__u8)
@@ -76,6 +131,10 @@ inline void encode(const bool &v, bufferlist& bl) {
   __u8 vv = v;
   encode_raw(vv, bl);
 }
+inline void encode(const bool &v, contiguous_appender& a) {
+  __u8 vv = v;
+  encode_raw(vv, a);
+}
 inline void decode(bool &v, bufferlist::iterator& p) {
   __u8 vv;
   decode_raw(vv, p);
@@ -92,6 +151,11 @@ inline void decode(bool &v, bufferlist::iterator& p) {
     e = v;                                                              \
     encode_raw(e, bl);							\
   }									\
+  inline void encode(type v, contiguous_appender& a) {			\
+    ceph_##etype e;					                \
+    e = v;                                                              \
+    encode_raw(e, a);							\
+  }									\
   inline void decode(type &v, bufferlist::iterator& p) {		\
     ceph_##etype e;							\
     decode_raw(e, p);							\
@@ -105,6 +169,22 @@ WRITE_INTTYPE_ENCODER(int32_t, le32)
 WRITE_INTTYPE_ENCODER(uint16_t, le16)
 WRITE_INTTYPE_ENCODER(int16_t, le16)
 
+WRITE_FIXED_ENCODING(__u8, 1)
+WRITE_FIXED_ENCODING(__s8, 1)
+WRITE_FIXED_ENCODING(char, 1)
+WRITE_FIXED_ENCODING(bool, 1)
+WRITE_FIXED_ENCODING(ceph_le64, 8)
+WRITE_FIXED_ENCODING(ceph_le32, 4)
+WRITE_FIXED_ENCODING(ceph_le16, 2)
+WRITE_FIXED_ENCODING(float, 4)
+WRITE_FIXED_ENCODING(double, 8)
+WRITE_FIXED_ENCODING(uint64_t, 8)
+WRITE_FIXED_ENCODING(int64_t, 8)
+WRITE_FIXED_ENCODING(uint32_t, 4)
+WRITE_FIXED_ENCODING(int32_t, 4)
+WRITE_FIXED_ENCODING(uint16_t, 2)
+WRITE_FIXED_ENCODING(int16_t, 2)
+
 #ifdef ENCODE_DUMP
 # include <stdio.h>
 # include <sys/types.h>
@@ -224,16 +304,22 @@ inline void decode(buffer::ptr& bp, bufferlist::iterator& p)
 {
   __u32 len;
   decode(len, p);
+  p.copy_shallow(len, bp);
+}
 
-  bufferlist s;
-  p.copy(len, s);
-
-  if (len) {
-    if (s.buffers().size() == 1)
-      bp = s.buffers().front();
-    else
-      bp = buffer::copy(s.c_str(), s.length());
-  }
+/*
+ * decode a string- or bufferlist-encoded payload (they share the u32
+ * length + bytes wire format) as a view aliasing the source buffer
+ * where possible.  The returned ptr holds a ref on the underlying
+ * buffer::raw, so it outlives the iterator, but it pins the whole
+ * receive buffer in memory -- use for short-lived decodes on hot paths
+ * instead of copying into a std::string.
+ */
+inline void decode_view(buffer::ptr& bp, bufferlist::iterator& p)
+{
+  __u32 len;
+  decode(len, p);
+  p.copy_shallow(len, bp);
 }
 
 // bufferlist (encapsulated)
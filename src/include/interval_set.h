@@ -16,6 +16,7 @@
 #ifndef CEPH_INTERVAL_SET_H
 #define CEPH_INTERVAL_SET_H
 
+#include <algorithm>
 #include <iterator>
 #include <map>
 #include <ostream>
@@ -31,7 +32,134 @@ using namespace std;
 #endif
 
 
-template<typename T>
+/*
+ * Minimal map-like container for interval_set: a sorted contiguous
+ * vector of (start, len) pairs with a small inline buffer.  Dense sets
+ * that are built roughly in order and then iterated (missing sets,
+ * cached extents, recovery unions) stay in a single allocation with
+ * cache-friendly layout, and sets of up to N intervals never touch the
+ * heap at all.  Only the slice of the std::map interface interval_set
+ * needs is provided; iterators are plain pointers and any mutation
+ * invalidates them.
+ */
+template<typename T, unsigned N = 4>
+class flat_interval_map {
+ public:
+  typedef std::pair<T,T> value_type;
+  typedef value_type* iterator;
+  typedef const value_type* const_iterator;
+
+  flat_interval_map() : _data(_inline), _len(0), _cap(N) {}
+  flat_interval_map(const flat_interval_map& other)
+    : _data(_inline), _len(0), _cap(N) {
+    *this = other;
+  }
+  ~flat_interval_map() {
+    if (_data != _inline)
+      delete[] _data;
+  }
+  flat_interval_map& operator=(const flat_interval_map& other) {
+    if (this == &other)
+      return *this;
+    _len = 0;
+    reserve(other._len);
+    for (size_t i = 0; i < other._len; i++)
+      _data[i] = other._data[i];
+    _len = other._len;
+    return *this;
+  }
+
+  iterator begin() { return _data; }
+  iterator end() { return _data + _len; }
+  const_iterator begin() const { return _data; }
+  const_iterator end() const { return _data + _len; }
+  size_t size() const { return _len; }
+  bool empty() const { return _len == 0; }
+  void clear() { _len = 0; }
+
+  bool operator==(const flat_interval_map& other) const {
+    if (_len != other._len)
+      return false;
+    for (size_t i = 0; i < _len; i++)
+      if (_data[i] != other._data[i])
+	return false;
+    return true;
+  }
+
+  void swap(flat_interval_map& other) {
+    if (_data != _inline && other._data != other._inline) {
+      std::swap(_data, other._data);
+      std::swap(_len, other._len);
+      std::swap(_cap, other._cap);
+      return;
+    }
+    // one side is inline; fall back to copying (cheap, it's small)
+    flat_interval_map tmp(*this);
+    *this = other;
+    other = tmp;
+  }
+
+  iterator lower_bound(const T& k) {
+    return std::lower_bound(begin(), end(), k, key_cmp());
+  }
+  const_iterator lower_bound(const T& k) const {
+    return std::lower_bound(begin(), end(), k, key_cmp());
+  }
+
+  void erase(iterator p) {
+    for (iterator q = p; q + 1 != end(); ++q)
+      *q = *(q + 1);
+    _len--;
+  }
+
+  /// find or insert; appending in key order is O(1) amortized
+  T& operator[](const T& k) {
+    iterator p = lower_bound(k);
+    if (p != end() && p->first == k)
+      return p->second;
+    size_t idx = p - _data;
+    reserve(_len + 1);
+    for (size_t i = _len; i > idx; i--)
+      _data[i] = _data[i-1];
+    _data[idx] = value_type(k, T());
+    _len++;
+    return _data[idx].second;
+  }
+
+ private:
+  struct key_cmp {
+    bool operator()(const value_type& v, const T& k) const {
+      return v.first < k;
+    }
+  };
+
+  void reserve(size_t n) {
+    if (n <= _cap)
+      return;
+    size_t c = _cap * 2;
+    if (c < n)
+      c = n;
+    value_type *nd = new value_type[c];
+    for (size_t i = 0; i < _len; i++)
+      nd[i] = _data[i];
+    if (_data != _inline)
+      delete[] _data;
+    _data = nd;
+    _cap = c;
+  }
+
+  value_type _inline[N];
+  value_type *_data;
+  size_t _len, _cap;
+};
+
+/*
+ * The default interval_set is backed by std::map.  Code whose access
+ * pattern is build-then-iterate can select the flat backing instead,
+ * e.g. interval_set<uint64_t, flat_interval_map<uint64_t> >; the two
+ * encode identically on the wire.
+ */
+template<typename T, typename Map = std::map<T,T> >
 class interval_set {
  public:
 
@@ -40,7 +168,7 @@ class interval_set {
   class iterator : public std::iterator <std::forward_iterator_tag, T>
   {
     public:
-        explicit iterator(typename std::map<T,T>::iterator iter)
+        explicit iterator(typename Map::iterator iter)
           : _iter(iter)
         { }
 
@@ -90,17 +218,17 @@ class interval_set {
                 return prev;
         }
 
-    friend class interval_set<T>::const_iterator;
+    friend class interval_set<T,Map>::const_iterator;
 
     protected:
-        typename map<T,T>::iterator _iter;
-    friend class interval_set<T>;
+        typename Map::iterator _iter;
+    friend class interval_set<T,Map>;
   };
 
   class const_iterator : public std::iterator <std::forward_iterator_tag, T>
   {
     public:
-        explicit const_iterator(typename std::map<T,T>::const_iterator iter)
+        explicit const_iterator(typename Map::const_iterator iter)
           : _iter(iter)
         { }
 
@@ -150,7 +278,7 @@ class interval_set {
         }
 
     protected:
-        typename map<T,T>::const_iterator _iter;
+        typename Map::const_iterator _iter;
   };
 
   interval_set() : _size(0) {}
@@ -160,26 +288,26 @@ class interval_set {
     return m.size();
   }
 
-  typename interval_set<T>::iterator begin() {
-    return typename interval_set<T>::iterator(m.begin());
+  typename interval_set<T,Map>::iterator begin() {
+    return typename interval_set<T,Map>::iterator(m.begin());
   }
 
-  typename interval_set<T>::iterator end() {
-    return typename interval_set<T>::iterator(m.end());
+  typename interval_set<T,Map>::iterator end() {
+    return typename interval_set<T,Map>::iterator(m.end());
   }
 
-  typename interval_set<T>::const_iterator begin() const {
-    return typename interval_set<T>::const_iterator(m.begin());
+  typename interval_set<T,Map>::const_iterator begin() const {
+    return typename interval_set<T,Map>::const_iterator(m.begin());
   }
 
-  typename interval_set<T>::const_iterator end() const {
-    return typename interval_set<T>::const_iterator(m.end());
+  typename interval_set<T,Map>::const_iterator end() const {
+    return typename interval_set<T,Map>::const_iterator(m.end());
   }
 
   // helpers
  private:
-  typename map<T,T>::const_iterator find_inc(T start) const {
-    typename map<T,T>::const_iterator p = m.lower_bound(start);  // p->first >= start
+  typename Map::const_iterator find_inc(T start) const {
+    typename Map::const_iterator p = m.lower_bound(start);  // p->first >= start
     if (p != m.begin() &&
         (p == m.end() || p->first > start)) {
       p--;   // might overlap?
@@ -189,8 +317,8 @@ class interval_set {
     return p;
   }
   
-  typename map<T,T>::iterator find_inc_m(T start) {
-    typename map<T,T>::iterator p = m.lower_bound(start);
+  typename Map::iterator find_inc_m(T start) {
+    typename Map::iterator p = m.lower_bound(start);
     if (p != m.begin() &&
         (p == m.end() || p->first > start)) {
       p--;   // might overlap?
@@ -200,8 +328,8 @@ class interval_set {
     return p;
   }
   
-  typename map<T,T>::const_iterator find_adj(T start) const {
-    typename map<T,T>::const_iterator p = m.lower_bound(start);
+  typename Map::const_iterator find_adj(T start) const {
+    typename Map::const_iterator p = m.lower_bound(start);
     if (p != m.begin() &&
         (p == m.end() || p->first > start)) {
       p--;   // might touch?
@@ -211,8 +339,8 @@ class interval_set {
     return p;
   }
   
-  typename map<T,T>::iterator find_adj_m(T start) {
-    typename map<T,T>::iterator p = m.lower_bound(start);
+  typename Map::iterator find_adj_m(T start) {
+    typename Map::iterator p = m.lower_bound(start);
     if (p != m.begin() &&
         (p == m.end() || p->first > start)) {
       p--;   // might touch?
@@ -231,27 +359,36 @@ class interval_set {
     return _size;
   }
 
+  // encoded identically to the std::map<T,T> encoder, so flat and
+  // map-backed sets are wire compatible
   void encode(bufferlist& bl) const {
-    ::encode(m, bl);
+    __u32 n = m.size();
+    ::encode(n, bl);
+    encode_nohead(bl);
   }
   void encode_nohead(bufferlist& bl) const {
-    ::encode_nohead(m, bl);
+    for (typename Map::const_iterator p = m.begin();
+         p != m.end();
+         p++) {
+      ::encode(p->first, bl);
+      ::encode(p->second, bl);
+    }
   }
   void decode(bufferlist::iterator& bl) {
-    ::decode(m, bl);
-    _size = 0;
-    for (typename map<T,T>::const_iterator p = m.begin();
-         p != m.end();
-         p++)
-      _size += p->second;
+    __u32 n;
+    ::decode(n, bl);
+    decode_nohead(n, bl);
   }
   void decode_nohead(int n, bufferlist::iterator& bl) {
-    ::decode_nohead(n, m, bl);
+    m.clear();
     _size = 0;
-    for (typename map<T,T>::const_iterator p = m.begin();
-         p != m.end();
-         p++)
-      _size += p->second;
+    while (n--) {
+      T start, len;
+      ::decode(start, bl);
+      ::decode(len, bl);
+      m[start] = len;
+      _size += len;
+    }
   }
 
   void clear() {
@@ -260,7 +397,7 @@ class interval_set {
   }
 
   bool contains(T i) const {
-    typename map<T,T>::const_iterator p = find_inc(i);
+    typename Map::const_iterator p = find_inc(i);
     if (p == m.end()) return false;
     if (p->first > i) return false;
     if (p->first+p->second <= i) return false;
@@ -268,7 +405,7 @@ class interval_set {
     return true;
   }
   bool contains(T start, T len) const {
-    typename map<T,T>::const_iterator p = find_inc(start);
+    typename Map::const_iterator p = find_inc(start);
     if (p == m.end()) return false;
     if (p->first > start) return false;
     if (p->first+p->second <= start) return false;
@@ -291,12 +428,12 @@ class interval_set {
   }
   T range_start() const {
     assert(!empty());
-    typename map<T,T>::const_iterator p = m.begin();
+    typename Map::const_iterator p = m.begin();
     return p->first;
   }
   T range_end() const {
     assert(!empty());
-    typename map<T,T>::const_iterator p = m.end();
+    typename Map::const_iterator p = m.end();
     p--;
     return p->first+p->second;
   }
@@ -304,20 +441,20 @@ class interval_set {
   // interval start after p (where p not in set)
   bool starts_after(T i) const {
     assert(!contains(i));
-    typename map<T,T>::const_iterator p = find_inc(i);
+    typename Map::const_iterator p = find_inc(i);
     if (p == m.end()) return false;
     return true;
   }
   T start_after(T i) const {
     assert(!contains(i));
-    typename map<T,T>::const_iterator p = find_inc(i);
+    typename Map::const_iterator p = find_inc(i);
     return p->first;
   }
 
   // interval end that contains start
   T end_after(T start) const {
     assert(contains(start));
-    typename map<T,T>::const_iterator p = find_inc(start);
+    typename Map::const_iterator p = find_inc(start);
     return p->first+p->second;
   }
   
@@ -329,7 +466,7 @@ class interval_set {
     //cout << "insert " << start << "~" << len << endl;
     assert(len > 0);
     _size += len;
-    typename map<T,T>::iterator p = find_adj_m(start);
+    typename Map::iterator p = find_adj_m(start);
     if (p == m.end()) {
       m[start] = len;                  // new interval
     } else {
@@ -343,7 +480,7 @@ class interval_set {
         assert(p->first + p->second == start);
         p->second += len;               // append to end
         
-        typename map<T,T>::iterator n = p;
+        typename Map::iterator n = p;
         n++;
         if (n != m.end() && 
             start+len == n->first) {   // combine with next, too!
@@ -352,8 +489,9 @@ class interval_set {
         }
       } else {
         if (start+len == p->first) {
-          m[start] = len + p->second;  // append to front 
+          T psecond = p->second;
           m.erase(p);
+          m[start] = len + psecond;    // append to front
         } else {
           assert(p->first > start+len);
           m[start] = len;              // new interval
@@ -362,7 +500,7 @@ class interval_set {
     }
   }
 
-  void swap(interval_set<T>& other) {
+  void swap(interval_set<T,Map>& other) {
     m.swap(other.m);
     int64_t t = _size;
     _size = other._size;
@@ -379,7 +517,7 @@ class interval_set {
   }
 
   void erase(T start, T len) {
-    typename map<T,T>::iterator p = find_inc_m(start);
+    typename Map::iterator p = find_inc_m(start);
 
     _size -= len;
     assert(_size >= 0);
@@ -401,14 +539,14 @@ class interval_set {
 
 
   void subtract(const interval_set &a) {
-    for (typename map<T,T>::const_iterator p = a.m.begin();
+    for (typename Map::const_iterator p = a.m.begin();
          p != a.m.end();
          p++)
       erase(p->first, p->second);
   }
 
   void insert(const interval_set &a) {
-    for (typename map<T,T>::const_iterator p = a.m.begin();
+    for (typename Map::const_iterator p = a.m.begin();
          p != a.m.end();
          p++)
       insert(p->first, p->second);
@@ -420,8 +558,8 @@ class interval_set {
     assert(&b != this);
     clear();
 
-    typename map<T,T>::const_iterator pa = a.m.begin();
-    typename map<T,T>::const_iterator pb = b.m.begin();
+    typename Map::const_iterator pa = a.m.begin();
+    typename Map::const_iterator pb = b.m.begin();
     
     while (pa != a.m.end() && pb != b.m.end()) {
       // passing?
@@ -449,21 +587,41 @@ class interval_set {
     assert(&a != this);
     assert(&b != this);
     clear();
-    
-    //cout << "union_of" << endl;
 
-    // a
-    m = a.m;
-    _size = a._size;
-
-    // - (a*b)
-    interval_set ab;
-    ab.intersection_of(a, b);
-    subtract(ab);
-
-    // + b
-    insert(b);
-    return;
+    // merge pass: pull whichever interval starts first and extend or
+    // emit the pending one.  inserts are in increasing order, so this
+    // is O(n) on top of the per-insert cost.
+    typename Map::const_iterator pa = a.m.begin();
+    typename Map::const_iterator pb = b.m.begin();
+    T start = 0, end = 0;
+    bool open = false;
+    while (pa != a.m.end() || pb != b.m.end()) {
+      T s, l;
+      if (pb == b.m.end() ||
+          (pa != a.m.end() && pa->first <= pb->first)) {
+        s = pa->first;
+        l = pa->second;
+        pa++;
+      } else {
+        s = pb->first;
+        l = pb->second;
+        pb++;
+      }
+      if (!open) {
+        start = s;
+        end = s + l;
+        open = true;
+      } else if (s <= end) {
+        if (s + l > end)
+          end = s + l;    // overlaps or abuts; extend
+      } else {
+        insert(start, end - start);
+        start = s;
+        end = s + l;
+      }
+    }
+    if (open)
+      insert(start, end - start);
   }
   void union_of(const interval_set &b) {
     interval_set a;
@@ -472,7 +630,7 @@ class interval_set {
   }
 
   bool subset_of(const interval_set &big) const {
-    for (typename map<T,T>::const_iterator i = m.begin();
+    for (typename Map::const_iterator i = m.begin();
          i != m.end();
          i++) 
       if (!big.contains(i->first, i->second)) return false;
@@ -486,7 +644,7 @@ class interval_set {
    */
   void span_of(const interval_set &other, T start, T len) {
     clear();
-    typename map<T,T>::const_iterator p = other.find_inc(start);
+    typename Map::const_iterator p = other.find_inc(start);
     if (p == other.m.end())
       return;
     if (p->first < start) {
@@ -517,15 +675,15 @@ class interval_set {
 private:
   // data
   int64_t _size;
-  map<T,T> m;   // map start -> len
+  Map m;        // map start -> len
 };
 
 
-template<class T>
-inline ostream& operator<<(ostream& out, const interval_set<T> &s) {
+template<class T, class Map>
+inline ostream& operator<<(ostream& out, const interval_set<T,Map> &s) {
   out << "[";
   const char *prequel = "";
-  for (typename interval_set<T>::const_iterator i = s.begin();
+  for (typename interval_set<T,Map>::const_iterator i = s.begin();
        i != s.end();
        ++i)
   {
@@ -536,13 +694,13 @@ inline ostream& operator<<(ostream& out, const interval_set<T> &s) {
   return out;
 }
 
-template<class T>
-inline void encode(const interval_set<T>& s, bufferlist& bl)
+template<class T, class Map>
+inline void encode(const interval_set<T,Map>& s, bufferlist& bl)
 {
   s.encode(bl);
 }
-template<class T>
-inline void decode(interval_set<T>& s, bufferlist::iterator& p)
+template<class T, class Map>
+inline void decode(interval_set<T,Map>& s, bufferlist::iterator& p)
 {
   s.decode(p);
 }
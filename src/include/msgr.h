@@ -163,6 +163,13 @@ struct ceph_msg_header {
 	__le32 crc;       /* header crc32c */
 } __attribute__ ((packed));
 
+/*
+ * ceph_msg_header.reserved values.  Negotiated via
+ * CEPH_FEATURE_MSG_DATA_COMPRESS; data_len is then the wire (compressed)
+ * length while the footer data_crc still covers the uncompressed payload.
+ */
+#define CEPH_MSG_DATA_SNAPPY  1   /* data payload is snappy-compressed */
+
 #define CEPH_MSG_PRIO_LOW     64
 #define CEPH_MSG_PRIO_DEFAULT 127
 #define CEPH_MSG_PRIO_HIGH    196
@@ -245,6 +245,15 @@ enum {
 	/* hints */
 	CEPH_OSD_OP_SETALLOCHINT = CEPH_OSD_OP_MODE_WR | CEPH_OSD_OP_TYPE_DATA | 35,
 
+	/* vectored i/o; extent list and (for writev) packed data in payload */
+	CEPH_OSD_OP_READV  = CEPH_OSD_OP_MODE_RD | CEPH_OSD_OP_TYPE_DATA | 36,
+	CEPH_OSD_OP_WRITEV = CEPH_OSD_OP_MODE_WR | CEPH_OSD_OP_TYPE_DATA | 37,
+	CEPH_OSD_OP_WRITESAME = CEPH_OSD_OP_MODE_WR | CEPH_OSD_OP_TYPE_DATA | 38,
+
+	/* omap scan with the predicate evaluated osd-side */
+	CEPH_OSD_OP_OMAPGETVALSFILTERED =
+	  CEPH_OSD_OP_MODE_RD | CEPH_OSD_OP_TYPE_DATA | 39,
+
 	/** multi **/
 	CEPH_OSD_OP_CLONERANGE = CEPH_OSD_OP_MODE_WR | CEPH_OSD_OP_TYPE_MULTI | 1,
 	CEPH_OSD_OP_ASSERT_SRC_VERSION = CEPH_OSD_OP_MODE_RD | CEPH_OSD_OP_TYPE_MULTI | 2,
@@ -284,6 +293,9 @@ enum {
 	/** exec **/
 	/* note: the RD bit here is wrong; see special-case below in helper */
 	CEPH_OSD_OP_CALL    = CEPH_OSD_OP_MODE_RD | CEPH_OSD_OP_TYPE_EXEC | 1,
+	/* like CALL, but the previous op's outdata is appended to indata
+	 * before the method runs, chaining dependent calls server-side */
+	CEPH_OSD_OP_CALL_CHAIN = CEPH_OSD_OP_MODE_RD | CEPH_OSD_OP_TYPE_EXEC | 2,
 
 	/** pg **/
 	CEPH_OSD_OP_PGLS      = CEPH_OSD_OP_MODE_RD | CEPH_OSD_OP_TYPE_PG | 1,
@@ -324,7 +336,8 @@ static inline int ceph_osd_op_mode_subop(int op)
 static inline int ceph_osd_op_mode_read(int op)
 {
 	return (op & CEPH_OSD_OP_MODE_RD) &&
-		op != CEPH_OSD_OP_CALL;
+		op != CEPH_OSD_OP_CALL &&
+		op != CEPH_OSD_OP_CALL_CHAIN;
 }
 static inline int ceph_osd_op_mode_modify(int op)
 {
@@ -376,6 +389,8 @@ enum {
 						 */
 	CEPH_OSD_FLAG_ENFORCE_SNAPC    =0x100000,  /* use snapc provided even if
 						      pool uses pool snaps */
+	CEPH_OSD_FLAG_TRACE =         0x200000,  /* trace this (sampled) op
+						    through the op tracker */
 };
 
 enum {
@@ -190,6 +190,13 @@ namespace librados
     void exec(const char *cls, const char *method, bufferlist& inbl);
     void exec(const char *cls, const char *method, bufferlist& inbl, bufferlist *obl, int *prval);
     void exec(const char *cls, const char *method, bufferlist& inbl, ObjectOperationCompletion *completion);
+    /**
+     * Like exec, but the output of the preceding op in this operation is
+     * appended to inbl before the method runs, so dependent class calls
+     * on one object chain server-side in a single round trip.
+     */
+    void exec_chain(const char *cls, const char *method, bufferlist& inbl);
+    void exec_chain(const char *cls, const char *method, bufferlist& inbl, bufferlist *obl, int *prval);
     /**
      * Guard operation with a check that object version == ver
      *
@@ -252,6 +259,22 @@ namespace librados
     void create(bool exclusive);
     void create(bool exclusive, const std::string& category);
     void write(uint64_t off, const bufferlist& bl);
+    /**
+     * writev: write a list of extents in one osd op
+     *
+     * bl holds the data for all extents packed in list order; its
+     * length must be at least the sum of the extent lengths.
+     */
+    void writev(const std::vector<std::pair<uint64_t,uint64_t> >& extents,
+		const bufferlist& bl);
+    /**
+     * writesame: write the pattern in bl repeatedly over off~write_len
+     *
+     * write_len must be a multiple of bl's length.  only the pattern
+     * travels over the wire, so zeroing or pattern-filling a large
+     * extent costs one small op.
+     */
+    void writesame(uint64_t off, uint64_t write_len, const bufferlist& bl);
     void write_full(const bufferlist& bl);
     void append(const bufferlist& bl);
     void remove();
@@ -349,6 +372,15 @@ namespace librados
     void getxattr(const char *name, bufferlist *pbl, int *prval);
     void getxattrs(std::map<std::string, bufferlist> *pattrs, int *prval);
     void read(size_t off, uint64_t len, bufferlist *pbl, int *prval);
+    /**
+     * readv: read a list of extents in one osd op
+     *
+     * Each extent contributes exactly its requested length to *pbl, in
+     * list order, zero-filled past the end of the object, so the
+     * result can be carved back up by the caller.
+     */
+    void readv(const std::vector<std::pair<uint64_t,uint64_t> >& extents,
+	       bufferlist *pbl, int *prval);
     /**
      * see aio_sparse_read()
      */
@@ -390,6 +422,37 @@ namespace librados
       std::map<std::string, bufferlist> *out_vals,
       int *prval);
 
+    /**
+     * omap_get_vals_filtered: omap scan with the predicate run osd-side
+     *
+     * Only entries matching the key prefix/range and value predicate are
+     * shipped back, so a selective scan moves the matches instead of the
+     * whole range.
+     *
+     * @param start_after [in] list keys starting after start_after
+     * @param max_return [in] list no more than max_return matches
+     * @param max_scan [in] examine no more than max_scan entries, 0 = all
+     * @param filter_prefix [in] list only keys beginning with filter_prefix
+     * @param key_end [in] stop before this key, empty = unbounded
+     * @param value_contains [in] list only values containing these bytes,
+     *        empty = any
+     * @param out_vals [out] place returned values in out_vals on completion
+     * @param next_after [out] last key examined; resume here when more
+     * @param more [out] set if the scan stopped before the range ended
+     * @param prval [out] place error code in prval upon completion
+     */
+    void omap_get_vals_filtered(
+      const std::string &start_after,
+      uint64_t max_return,
+      uint64_t max_scan,
+      const std::string &filter_prefix,
+      const std::string &key_end,
+      const std::string &value_contains,
+      std::map<std::string, bufferlist> *out_vals,
+      std::string *next_after,
+      bool *more,
+      int *prval);
+
 
     /**
      * omap_get_keys: keys from the object omap
@@ -708,6 +771,26 @@ namespace librados
      */
     int aio_read(const std::string& oid, AioCompletion *c,
 		 bufferlist *pbl, size_t len, uint64_t off, uint64_t snapid);
+    /**
+     * Asynchronously read from an object into a caller-provided buffer
+     *
+     * The buffer is registered with the messenger as the receive buffer
+     * for the reply, so the data payload is read off the socket directly
+     * into the caller's memory with no intermediate copy.  The buffer
+     * must remain valid until the completion fires.
+     *
+     * The return value of the completion will be number of bytes read on
+     * success, negative error code on failure.
+     *
+     * @param oid the name of the object to read from
+     * @param c what to do when the read is complete
+     * @param buf where to store the results; must stay valid until completion
+     * @param len the number of bytes to read
+     * @param off the offset to start reading from in the object
+     * @returns 0 on success, negative error code on failure
+     */
+    int aio_read(const std::string& oid, AioCompletion *c,
+		 char *buf, size_t len, uint64_t off);
     int aio_sparse_read(const std::string& oid, AioCompletion *c,
 			std::map<uint64_t,uint64_t> *m, bufferlist *data_bl,
 			size_t len, uint64_t off);
@@ -785,6 +868,22 @@ namespace librados
     int operate(const std::string& oid, ObjectReadOperation *op, bufferlist *pbl);
     int aio_operate(const std::string& oid, AioCompletion *c, ObjectWriteOperation *op);
     int aio_operate(const std::string& oid, AioCompletion *c, ObjectWriteOperation *op, int flags);
+    /**
+     * Schedule a batch of async write operations in one call
+     *
+     * Equivalent to calling the first aio_operate() once per entry, but
+     * the client lock is taken once for the whole batch, so per-op
+     * submission overhead is amortized.  The three vectors are parallel
+     * and must be the same length; each completion fires independently.
+     *
+     * @param oids the objects to operate on
+     * @param ops which operations to perform on each object
+     * @param comps what to do as each operation completes
+     * @returns 0 on success, negative error code on failure
+     */
+    int aio_operate_batch(const std::vector<std::string>& oids,
+			  const std::vector<ObjectWriteOperation*>& ops,
+			  const std::vector<AioCompletion*>& comps);
     /**
      * Schedule an async write operation with explicit snapshot parameters
      *
@@ -817,8 +916,28 @@ namespace librados
     // watch/notify
     int watch(const std::string& o, uint64_t ver, uint64_t *handle,
 	      librados::WatchCtx *ctx);
+    /**
+     * aio_watch: register a watch without blocking
+     *
+     * The completion fires once the osd has acked (or refused) the
+     * registration; on failure the handle is already torn down when
+     * the callback runs.  Re-establishment across osd failover is
+     * handled by the objecter's linger machinery and never blocks the
+     * caller.
+     */
+    int aio_watch(const std::string& o, AioCompletion *c, uint64_t ver,
+		  uint64_t *handle, librados::WatchCtx *ctx);
     int unwatch(const std::string& o, uint64_t handle);
+    int aio_unwatch(const std::string& o, uint64_t handle, AioCompletion *c);
     int notify(const std::string& o, uint64_t ver, bufferlist& bl);
+    /**
+     * notify2: notify with a per-call timeout
+     *
+     * Returns once every watcher acked or timeout_ms elapsed on the
+     * osd (0 means the ioctx notify timeout), so one dead watcher
+     * cannot stall the notifier indefinitely.
+     */
+    int notify2(const std::string& o, bufferlist& bl, uint64_t timeout_ms);
     int list_watchers(const std::string& o, std::list<obj_watch_t> *out_watchers);
     int list_snaps(const std::string& o, snap_set_t *out_snaps);
     void set_notify_timeout(uint32_t timeout);
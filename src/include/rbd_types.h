@@ -32,6 +32,7 @@
 #define RBD_HEADER_PREFIX      "rbd_header."
 #define RBD_DATA_PREFIX        "rbd_data."
 #define RBD_ID_PREFIX          "rbd_id."
+#define RBD_OBJECT_MAP_PREFIX  "rbd_object_map."
 
 /*
  * old-style rbd image 'foo' consists of objects
@@ -62,6 +63,13 @@
 #define RBD_CHILDREN		"rbd_children"
 #define RBD_LOCK_NAME		"rbd_lock"
 
+/*
+ * xattr on the image header object recording how far an in-progress
+ * flatten has gotten, so an interrupted flatten can resume instead of
+ * recopying from object zero.  removed when the flatten completes.
+ */
+#define RBD_FLATTEN_POS_XATTR	"flatten_position"
+
 #define RBD_DEFAULT_OBJ_ORDER	22   /* 4MB */
 
 #define RBD_MAX_OBJ_NAME_SIZE	96
@@ -93,6 +93,10 @@ public:
     ::encode(tv.tv_sec, bl);
     ::encode(tv.tv_nsec, bl);
   }
+  void encode(contiguous_appender &a) const {
+    ::encode(tv.tv_sec, a);
+    ::encode(tv.tv_nsec, a);
+  }
   void decode(bufferlist::iterator &p) {
     ::decode(tv.tv_sec, p);
     ::decode(tv.tv_nsec, p);
@@ -293,6 +297,10 @@ public:
   }
 };
 WRITE_CLASS_ENCODER(utime_t)
+inline void encode(const utime_t &t, contiguous_appender &a) {
+  t.encode(a);
+}
+WRITE_FIXED_ENCODING(utime_t, 8)
 
 
 // arithmetic operators
@@ -686,6 +686,24 @@ extern "C" int ceph_write(struct ceph_mount_info *cmount, int fd, const char *bu
   return cmount->get_client()->write(fd, buf, size, offset);
 }
 
+extern "C" int ceph_aio_read(struct ceph_mount_info *cmount, int fd, char *buf,
+			     int64_t size, int64_t offset,
+			     ceph_aio_callback_t cb, void *priv)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  return cmount->get_client()->aio_read(fd, buf, size, offset, cb, priv);
+}
+
+extern "C" int ceph_aio_write(struct ceph_mount_info *cmount, int fd, const char *buf,
+			      int64_t size, int64_t offset,
+			      ceph_aio_callback_t cb, void *priv)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  return cmount->get_client()->aio_write(fd, buf, size, offset, cb, priv);
+}
+
 extern "C" int ceph_ftruncate(struct ceph_mount_info *cmount, int fd, int64_t size)
 {
   if (!cmount->is_mounted())
@@ -107,7 +107,7 @@ void librados::IoCtxImpl::complete_aio_write(AioCompletionImpl *c)
     ldout(client->cct, 20) << " waking waiters on seq " << waiters->first << dendl;
     for (std::list<AioCompletionImpl*>::iterator it = waiters->second.begin();
 	 it != waiters->second.end(); ++it) {
-      client->finisher.queue(new C_AioCompleteAndSafe(*it));
+      client->get_finisher(*it)->queue(new C_AioCompleteAndSafe(*it));
       (*it)->put();
     }
     aio_write_waiters.erase(waiters++);
@@ -127,7 +127,7 @@ void librados::IoCtxImpl::flush_aio_writes_async(AioCompletionImpl *c)
   if (aio_write_list.empty()) {
     ldout(client->cct, 20) << "flush_aio_writes_async no writes. (tid "
 			   << seq << ")" << dendl;
-    client->finisher.queue(new C_AioCompleteAndSafe(c));
+    client->get_finisher(c)->queue(new C_AioCompleteAndSafe(c));
   } else {
     ldout(client->cct, 20) << "flush_aio_writes_async " << aio_write_list.size()
 			   << " writes in flight; waiting on tid " << seq << dendl;
@@ -617,6 +617,43 @@ int librados::IoCtxImpl::aio_operate(const object_t& oid,
   return 0;
 }
 
+int librados::IoCtxImpl::aio_operate_batch(const std::vector<object_t>& oids,
+					   const std::vector< ::ObjectOperation*>& ops,
+					   const std::vector<AioCompletionImpl*>& comps,
+					   const SnapContext& snap_context,
+					   int flags)
+{
+  utime_t ut = ceph_clock_now(client->cct);
+  /* can't write to a snapshot */
+  if (snap_seq != CEPH_NOSNAP)
+    return -EROFS;
+
+  assert(oids.size() == ops.size());
+  assert(oids.size() == comps.size());
+
+  for (std::vector<AioCompletionImpl*>::const_iterator p = comps.begin();
+       p != comps.end();
+       ++p) {
+    (*p)->io = this;
+    queue_aio_write(*p);
+  }
+
+  // take the client lock once for the whole batch.  each op is still
+  // targeted and queued individually underneath, but the per-op lock
+  // handoff and dispatch wakeups are amortized across the batch, and
+  // ops bound for the same OSD coalesce in its connection queue.
+  Mutex::Locker l(*lock);
+  for (size_t i = 0; i < oids.size(); ++i) {
+    AioCompletionImpl *c = comps[i];
+    Context *onack = new C_aio_Ack(c);
+    Context *oncommit = new C_aio_Safe(c);
+    objecter->mutate(oids[i], oloc, *ops[i], snap_context, ut, flags,
+		     onack, oncommit, &c->objver);
+  }
+
+  return 0;
+}
+
 int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 				  bufferlist *pbl, size_t len, uint64_t off,
 				  uint64_t snapid)
@@ -1101,6 +1138,31 @@ int librados::IoCtxImpl::watch(const object_t& oid, uint64_t ver,
 }
 
 
+int librados::IoCtxImpl::aio_watch(const object_t& oid, AioCompletionImpl *c,
+				   uint64_t ver, uint64_t *cookie,
+				   librados::WatchCtx *ctx)
+{
+  ::ObjectOperation wr;
+
+  lock->Lock();
+  WatchContext *wc = new WatchContext(this, oid, ctx);
+  client->register_watcher(wc, cookie);
+  prepare_assert_ops(&wr);
+  wr.watch(*cookie, ver, 1);
+  bufferlist bl;
+  c->io = this;
+  queue_aio_write(c);
+  Context *onack = new C_aio_watch_Ack(c, this, *cookie);
+  Context *oncommit = new C_aio_Safe(c);
+  wc->linger_id = objecter->linger_mutate(oid, oloc, wr,
+					  snapc, ceph_clock_now(NULL), bl,
+					  0,
+					  onack, oncommit, &c->objver);
+  lock->Unlock();
+
+  return 0;
+}
+
 /* this is called with IoCtxImpl::lock held */
 int librados::IoCtxImpl::_notify_ack(
   const object_t& oid,
@@ -1145,10 +1207,35 @@ int librados::IoCtxImpl::unwatch(const object_t& oid, uint64_t cookie)
   return r;
 }
 
-int librados::IoCtxImpl::notify(const object_t& oid, uint64_t ver, bufferlist& bl)
+int librados::IoCtxImpl::aio_unwatch(const object_t& oid, uint64_t cookie,
+				     AioCompletionImpl *c)
+{
+  lock->Lock();
+
+  client->unregister_watcher(cookie);
+
+  ::ObjectOperation wr;
+  prepare_assert_ops(&wr);
+  wr.watch(cookie, 0, 0);
+  c->io = this;
+  queue_aio_write(c);
+  Context *onack = new C_aio_Ack(c);
+  Context *oncommit = new C_aio_Safe(c);
+  objecter->mutate(oid, oloc, wr, snapc, ceph_clock_now(client->cct), 0,
+		   onack, oncommit, &c->objver);
+  lock->Unlock();
+
+  return 0;
+}
+
+int librados::IoCtxImpl::notify(const object_t& oid, uint64_t ver, bufferlist& bl,
+				uint32_t timeout)
 {
   bufferlist inbl, outbl;
 
+  if (!timeout)
+    timeout = notify_timeout;
+
   Mutex mylock("IoCtxImpl::notify::mylock");
   Mutex mylock_all("IoCtxImpl::notify::mylock_all");
   Cond cond, cond_all;
@@ -1166,7 +1253,6 @@ int librados::IoCtxImpl::notify(const object_t& oid, uint64_t ver, bufferlist& b
   WatchContext *wc = new WatchContext(this, oid, ctx);
   client->register_watcher(wc, &cookie);
   uint32_t prot_ver = 1;
-  uint32_t timeout = notify_timeout;
   ::encode(prot_ver, inbl);
   ::encode(timeout, inbl);
   ::encode(bl, inbl);
@@ -1197,6 +1283,19 @@ int librados::IoCtxImpl::notify(const object_t& oid, uint64_t ver, bufferlist& b
   return r;
 }
 
+int librados::IoCtxImpl::notify2(const object_t& oid, bufferlist& bl,
+				 uint64_t timeout_ms)
+{
+  // the notify timeout travels in the payload in whole seconds; the
+  // osd completes the notify once every watcher acked or the timeout
+  // ran out, so a per-call timeout bounds how long a dead watcher can
+  // stall us
+  uint32_t timeout = 0;
+  if (timeout_ms)
+    timeout = (timeout_ms + 999) / 1000;
+  return notify(oid, 0, bl, timeout);
+}
+
 int librados::IoCtxImpl::set_alloc_hint(const object_t& oid,
                                         uint64_t expected_object_size,
                                         uint64_t expected_write_size)
@@ -1248,10 +1347,10 @@ void librados::IoCtxImpl::C_aio_Ack::finish(int r)
   }
 
   if (c->callback_complete) {
-    c->io->client->finisher.queue(new C_AioComplete(c));
+    c->io->client->get_finisher(c)->queue(new C_AioComplete(c));
   }
   if (c->is_read && c->callback_safe) {
-    c->io->client->finisher.queue(new C_AioSafe(c));
+    c->io->client->get_finisher(c)->queue(new C_AioSafe(c));
   }
 
   c->put_unlock();
@@ -1278,7 +1377,7 @@ void librados::IoCtxImpl::C_aio_stat_Ack::finish(int r)
   }
 
   if (c->callback_complete) {
-    c->io->client->finisher.queue(new C_AioComplete(c));
+    c->io->client->get_finisher(c)->queue(new C_AioComplete(c));
   }
 
   c->put_unlock();
@@ -1302,7 +1401,7 @@ void librados::IoCtxImpl::C_aio_Safe::finish(int r)
   c->cond.Signal();
 
   if (c->callback_safe) {
-    c->io->client->finisher.queue(new C_AioSafe(c));
+    c->io->client->get_finisher(c)->queue(new C_AioSafe(c));
   }
 
   c->io->complete_aio_write(c);
@@ -1310,6 +1409,36 @@ void librados::IoCtxImpl::C_aio_Safe::finish(int r)
   c->put_unlock();
 }
 
+//////////////////////// C_aio_watch_Ack ///////////////////////////////
+
+librados::IoCtxImpl::C_aio_watch_Ack::C_aio_watch_Ack(AioCompletionImpl *_c,
+						      IoCtxImpl *io,
+						      uint64_t _cookie)
+  : c(_c), ioctx(io), cookie(_cookie)
+{
+  c->get();
+}
+
+void librados::IoCtxImpl::C_aio_watch_Ack::finish(int r)
+{
+  // runs under the client lock, like any objecter callback.  a failed
+  // registration tears the watcher back down before the caller sees
+  // the completion; no notify can be in flight for it yet.
+  if (r < 0)
+    ioctx->client->unregister_watcher(cookie);
+
+  c->lock.Lock();
+  c->rval = r;
+  c->ack = true;
+  c->cond.Signal();
+
+  if (c->callback_complete) {
+    c->io->client->get_finisher(c)->queue(new C_AioComplete(c));
+  }
+
+  c->put_unlock();
+}
+
 ///////////////////////// C_NotifyComplete /////////////////////////////
 
 librados::IoCtxImpl::C_NotifyComplete::C_NotifyComplete(Mutex *_l,
@@ -145,6 +145,10 @@ struct librados::IoCtxImpl {
   int aio_operate(const object_t& oid, ::ObjectOperation *o,
 		  AioCompletionImpl *c, const SnapContext& snap_context,
 		  int flags);
+  int aio_operate_batch(const std::vector<object_t>& oids,
+			const std::vector< ::ObjectOperation*>& ops,
+			const std::vector<AioCompletionImpl*>& comps,
+			const SnapContext& snap_context, int flags);
   int aio_operate_read(const object_t& oid, ::ObjectOperation *o,
 		       AioCompletionImpl *c, int flags, bufferlist *pbl);
 
@@ -168,6 +172,14 @@ struct librados::IoCtxImpl {
     void finish(int r);
   };
 
+  struct C_aio_watch_Ack : public Context {
+    AioCompletionImpl *c;
+    IoCtxImpl *ioctx;
+    uint64_t cookie;
+    C_aio_watch_Ack(AioCompletionImpl *_c, IoCtxImpl *io, uint64_t _cookie);
+    void finish(int r);
+  };
+
   int aio_read(const object_t oid, AioCompletionImpl *c,
 	       bufferlist *pbl, size_t len, uint64_t off, uint64_t snapid);
   int aio_read(object_t oid, AioCompletionImpl *c,
@@ -196,8 +208,13 @@ struct librados::IoCtxImpl {
 
   void set_sync_op_version(version_t ver);
   int watch(const object_t& oid, uint64_t ver, uint64_t *cookie, librados::WatchCtx *ctx);
+  int aio_watch(const object_t& oid, AioCompletionImpl *c, uint64_t ver,
+		uint64_t *cookie, librados::WatchCtx *ctx);
   int unwatch(const object_t& oid, uint64_t cookie);
-  int notify(const object_t& oid, uint64_t ver, bufferlist& bl);
+  int aio_unwatch(const object_t& oid, uint64_t cookie, AioCompletionImpl *c);
+  int notify(const object_t& oid, uint64_t ver, bufferlist& bl,
+	     uint32_t timeout = 0);
+  int notify2(const object_t& oid, bufferlist& bl, uint64_t timeout_ms);
   int _notify_ack(
     const object_t& oid, uint64_t notify_id, uint64_t ver,
     uint64_t cookie);
@@ -275,6 +275,11 @@ int librados::RadosClient::connect()
   monclient.renew_subs();
 
   finisher.start();
+  for (int i = 1; i < cct->_conf->rados_client_finishers; i++) {
+    Finisher *f = new Finisher(cct);
+    f->start();
+    finisher_shards.push_back(f);
+  }
 
   state = CONNECTED;
   instance_id = monclient.get_global_id();
@@ -299,6 +304,13 @@ void librados::RadosClient::shutdown()
   }
   if (state == CONNECTED) {
     finisher.stop();
+    for (vector<Finisher*>::iterator p = finisher_shards.begin();
+	 p != finisher_shards.end();
+	 ++p) {
+      (*p)->stop();
+      delete *p;
+    }
+    finisher_shards.clear();
   }
   bool need_objecter = false;
   if (objecter && state == CONNECTED) {
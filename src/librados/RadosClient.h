@@ -84,6 +84,19 @@ private:
 public:
   Finisher finisher;
 
+  // optional extra completion threads (rados_client_finishers > 1).
+  // all completions for one key land on one finisher, so the
+  // complete-before-safe ordering of a single aio is preserved; with
+  // the default single finisher everything stays globally ordered as
+  // before.
+  std::vector<Finisher*> finisher_shards;
+  Finisher *get_finisher(void *key) {
+    if (finisher_shards.empty())
+      return &finisher;
+    size_t i = ((uintptr_t)key >> 6) % (finisher_shards.size() + 1);
+    return i ? finisher_shards[i - 1] : &finisher;
+  }
+
   RadosClient(CephContext *cct_);
   ~RadosClient();
   int ping_monitor(string mon_id, string *result);
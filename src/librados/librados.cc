@@ -147,6 +147,18 @@ void librados::ObjectOperation::exec(const char *cls, const char *method, buffer
   o->call(cls, method, inbl, outbl, NULL, prval);
 }
 
+void librados::ObjectOperation::exec_chain(const char *cls, const char *method, bufferlist& inbl)
+{
+  ::ObjectOperation *o = (::ObjectOperation *)impl;
+  o->call_chain(cls, method, inbl);
+}
+
+void librados::ObjectOperation::exec_chain(const char *cls, const char *method, bufferlist& inbl, bufferlist *outbl, int *prval)
+{
+  ::ObjectOperation *o = (::ObjectOperation *)impl;
+  o->call_chain(cls, method, inbl, outbl, NULL, prval);
+}
+
 class ObjectOpCompletionCtx : public Context {
   librados::ObjectOperationCompletion *completion;
   bufferlist bl;
@@ -183,6 +195,13 @@ void librados::ObjectReadOperation::read(size_t off, uint64_t len, bufferlist *p
   o->read(off, len, pbl, prval, NULL);
 }
 
+void librados::ObjectReadOperation::readv(const std::vector<std::pair<uint64_t,uint64_t> >& extents,
+					  bufferlist *pbl, int *prval)
+{
+  ::ObjectOperation *o = (::ObjectOperation *)impl;
+  o->readv(extents, pbl, prval);
+}
+
 void librados::ObjectReadOperation::sparse_read(uint64_t off, uint64_t len,
 						std::map<uint64_t,uint64_t> *m,
 						bufferlist *data_bl, int *prval)
@@ -224,6 +243,24 @@ void librados::ObjectReadOperation::omap_get_vals(
   o->omap_get_vals(start_after, "", max_return, out_vals, prval);
 }
 
+void librados::ObjectReadOperation::omap_get_vals_filtered(
+  const std::string &start_after,
+  uint64_t max_return,
+  uint64_t max_scan,
+  const std::string &filter_prefix,
+  const std::string &key_end,
+  const std::string &value_contains,
+  std::map<std::string, bufferlist> *out_vals,
+  std::string *next_after,
+  bool *more,
+  int *prval)
+{
+  ::ObjectOperation *o = (::ObjectOperation *)impl;
+  o->omap_get_vals_filtered(start_after, max_return, max_scan, filter_prefix,
+			    key_end, value_contains, out_vals, next_after,
+			    more, prval);
+}
+
 void librados::ObjectReadOperation::omap_get_keys(
   const std::string &start_after,
   uint64_t max_return,
@@ -321,6 +358,22 @@ void librados::ObjectWriteOperation::write(uint64_t off, const bufferlist& bl)
   o->write(off, c);
 }
 
+void librados::ObjectWriteOperation::writev(const std::vector<std::pair<uint64_t,uint64_t> >& extents,
+					    const bufferlist& bl)
+{
+  ::ObjectOperation *o = (::ObjectOperation *)impl;
+  bufferlist c = bl;
+  o->writev(extents, c);
+}
+
+void librados::ObjectWriteOperation::writesame(uint64_t off, uint64_t write_len,
+					       const bufferlist& bl)
+{
+  ::ObjectOperation *o = (::ObjectOperation *)impl;
+  bufferlist c = bl;
+  o->writesame(off, write_len, c);
+}
+
 void librados::ObjectWriteOperation::write_full(const bufferlist& bl)
 {
   ::ObjectOperation *o = (::ObjectOperation *)impl;
@@ -1046,6 +1099,27 @@ int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
   return io_ctx_impl->aio_operate(obj, (::ObjectOperation*)o->impl, c->pc,
 				  io_ctx_impl->snapc, 0);
 }
+int librados::IoCtx::aio_operate_batch(const std::vector<std::string>& oids,
+				       const std::vector<ObjectWriteOperation*>& ops,
+				       const std::vector<AioCompletion*>& comps)
+{
+  if (oids.size() != ops.size() || oids.size() != comps.size())
+    return -EINVAL;
+
+  std::vector<object_t> objs;
+  objs.reserve(oids.size());
+  std::vector< ::ObjectOperation*> oo;
+  oo.reserve(ops.size());
+  std::vector<AioCompletionImpl*> cs;
+  cs.reserve(comps.size());
+  for (size_t i = 0; i < oids.size(); ++i) {
+    objs.push_back(object_t(oids[i]));
+    oo.push_back((::ObjectOperation*)ops[i]->impl);
+    cs.push_back(comps[i]->pc);
+  }
+  return io_ctx_impl->aio_operate_batch(objs, oo, cs, io_ctx_impl->snapc, 0);
+}
+
 int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
 				 ObjectWriteOperation *o, int flags)
 {
@@ -1312,6 +1386,13 @@ int librados::IoCtx::aio_read(const std::string& oid, librados::AioCompletion *c
   return io_ctx_impl->aio_read(oid, c->pc, pbl, len, off, snapid);
 }
 
+int librados::IoCtx::aio_read(const std::string& oid, librados::AioCompletion *c,
+			      char *buf, size_t len, uint64_t off)
+{
+  return io_ctx_impl->aio_read(oid, c->pc, buf, len, off,
+			       io_ctx_impl->snap_seq);
+}
+
 int librados::IoCtx::aio_exec(const std::string& oid,
 			      librados::AioCompletion *c, const char *cls,
 			      const char *method, bufferlist& inbl,
@@ -1389,6 +1470,14 @@ int librados::IoCtx::watch(const string& oid, uint64_t ver, uint64_t *cookie,
   return io_ctx_impl->watch(obj, ver, cookie, ctx);
 }
 
+int librados::IoCtx::aio_watch(const string& oid, AioCompletion *c,
+			       uint64_t ver, uint64_t *cookie,
+			       librados::WatchCtx *ctx)
+{
+  object_t obj(oid);
+  return io_ctx_impl->aio_watch(obj, c->pc, ver, cookie, ctx);
+}
+
 int librados::IoCtx::unwatch(const string& oid, uint64_t handle)
 {
   uint64_t cookie = handle;
@@ -1396,12 +1485,26 @@ int librados::IoCtx::unwatch(const string& oid, uint64_t handle)
   return io_ctx_impl->unwatch(obj, cookie);
 }
 
+int librados::IoCtx::aio_unwatch(const string& oid, uint64_t handle,
+				 AioCompletion *c)
+{
+  object_t obj(oid);
+  return io_ctx_impl->aio_unwatch(obj, handle, c->pc);
+}
+
 int librados::IoCtx::notify(const string& oid, uint64_t ver, bufferlist& bl)
 {
   object_t obj(oid);
   return io_ctx_impl->notify(obj, ver, bl);
 }
 
+int librados::IoCtx::notify2(const string& oid, bufferlist& bl,
+			     uint64_t timeout_ms)
+{
+  object_t obj(oid);
+  return io_ctx_impl->notify2(obj, bl, timeout_ms);
+}
+
 int librados::IoCtx::list_watchers(const std::string& oid,
                                    std::list<obj_watch_t> *out_watchers)
 {
@@ -19,15 +19,19 @@ namespace librbd {
 
   void AioCompletion::finish_adding_requests(CephContext *cct)
   {
-    ldout(cct, 20) << "AioCompletion::finish_adding_requests " << (void*)this << " pending " << pending_count << dendl;
-    lock.Lock();
+    ldout(cct, 20) << "AioCompletion::finish_adding_requests " << (void*)this << " pending " << pending_count.read() << dendl;
     assert(building);
     building = false;
-    if (!pending_count) {
+    // drop the extra count taken at construction; if every request
+    // already completed, this is the final decrement
+    int count = pending_count.dec();
+    assert(count >= 0);
+    if (!count) {
       finalize(cct, rval);
+      lock.Lock();
       complete();
+      lock.Unlock();
     }
-    lock.Unlock();
   }
 
   void AioCompletion::finalize(CephContext *cct, ssize_t rval)
@@ -58,21 +62,27 @@ namespace librbd {
   {
     ldout(cct, 20) << "AioCompletion::complete_request() "
 		   << (void *)this << " complete_cb=" << (void *)complete_cb
-		   << " pending " << pending_count << dendl;
-    lock.Lock();
+		   << " pending " << pending_count.read() << dendl;
+    ceph_spin_lock(&result_lock);
     if (rval >= 0) {
       if (r < 0 && r != -EEXIST)
 	rval = r;
       else if (r > 0)
 	rval += r;
     }
-    assert(pending_count);
-    int count = --pending_count;
-    if (!count && !building) {
+    ceph_spin_unlock(&result_lock);
+    // the thread doing the final decrement (which includes the extra
+    // count held while building) finalizes and fires the callback; no
+    // mutex is taken until then
+    int count = pending_count.dec();
+    assert(count >= 0);
+    if (!count) {
       finalize(cct, rval);
+      lock.Lock();
       complete();
+      lock.Unlock();
     }
-    put_unlock();
+    put();
   }
 
   void C_AioRead::finish(int r)
@@ -88,11 +98,11 @@ namespace librbd {
       if (m_req->m_ext_map.empty())
 	m_req->m_ext_map[m_req->m_object_off] = m_req->data().length();
 
-      m_completion->lock.Lock();
+      ceph_spin_lock(&m_completion->result_lock);
       m_completion->destriper.add_partial_sparse_result(
 	  m_cct, m_req->data(), m_req->m_ext_map, m_req->m_object_off,
 	  m_req->m_buffer_extents);
-      m_completion->lock.Unlock();
+      ceph_spin_unlock(&m_completion->result_lock);
       r = m_req->m_object_len;
     }
     m_completion->complete_request(m_cct, r);
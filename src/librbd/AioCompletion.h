@@ -6,6 +6,8 @@
 #include "common/Cond.h"
 #include "common/Mutex.h"
 #include "common/ceph_context.h"
+#include "include/atomic.h"
+#include "include/Spinlock.h"
 #include "common/perf_counters.h"
 #include "include/Context.h"
 #include "include/utime.h"
@@ -39,23 +41,31 @@ namespace librbd {
    * count from reaching 0 while more requests are being added. When
    * all requests have been added, finish_adding_requests() releases
    * this initial reference.
+   *
+   * Sub-request completion is lock-free: pending_count carries an
+   * extra count while building, and whichever thread performs the
+   * final decrement finalizes and fires the callback.  The mutex only
+   * serializes the blocking wait_for_complete() path; the spinlock
+   * guards rval merging and the read destriper, which several rados
+   * callbacks can touch concurrently.
    */
   struct AioCompletion {
-    Mutex lock;
+    Mutex lock;          ///< blocking wait path only (done/cond)
     Cond cond;
     bool done;
     ssize_t rval;
     callback_t complete_cb;
     void *complete_arg;
     rbd_completion_t rbd_comp;
-    int pending_count;   ///< number of requests
+    atomic_t pending_count; ///< number of requests, +1 while building
     bool building;       ///< true if we are still building this completion
-    int ref;
+    atomic_t ref;
     bool released;
     ImageCtx *ictx;
     utime_t start_time;
     aio_type_t aio_type;
 
+    ceph_spinlock_t result_lock;
     Striper::StripedReadResult destriper;
     bufferlist *read_bl;
     char *read_buf;
@@ -64,12 +74,14 @@ namespace librbd {
     AioCompletion() : lock("AioCompletion::lock", true),
 		      done(false), rval(0), complete_cb(NULL),
 		      complete_arg(NULL), rbd_comp(NULL),
-		      pending_count(0), building(true),
+		      pending_count(1), building(true),
 		      ref(1), released(false), ictx(NULL),
 		      aio_type(AIO_TYPE_NONE),
 		      read_bl(NULL), read_buf(NULL), read_buf_len(0) {
+      ceph_spin_init(&result_lock);
     }
     ~AioCompletion() {
+      ceph_spin_destroy(&result_lock);
     }
 
     int wait_for_complete() {
@@ -81,9 +93,7 @@ namespace librbd {
     }
 
     void add_request() {
-      lock.Lock();
-      pending_count++;
-      lock.Unlock();
+      pending_count.inc();
       get();
     }
 
@@ -103,9 +113,13 @@ namespace librbd {
       elapsed = ceph_clock_now(ictx->cct) - start_time;
       switch (aio_type) {
       case AIO_TYPE_READ:
-	ictx->perfcounter->tinc(l_librbd_aio_rd_latency, elapsed); break;
+	ictx->perfcounter->tinc(l_librbd_aio_rd_latency, elapsed);
+	ictx->perfcounter->hinc(l_librbd_aio_rd_latency_hist, elapsed);
+	break;
       case AIO_TYPE_WRITE:
-	ictx->perfcounter->tinc(l_librbd_aio_wr_latency, elapsed); break;
+	ictx->perfcounter->tinc(l_librbd_aio_wr_latency, elapsed);
+	ictx->perfcounter->hinc(l_librbd_aio_wr_latency_hist, elapsed);
+	break;
       case AIO_TYPE_DISCARD:
 	ictx->perfcounter->tinc(l_librbd_aio_discard_latency, elapsed); break;
       case AIO_TYPE_FLUSH:
@@ -141,25 +155,17 @@ namespace librbd {
     }
 
     void get() {
-      lock.Lock();
-      assert(ref > 0);
-      ref++;
-      lock.Unlock();
+      assert(ref.read() > 0);
+      ref.inc();
     }
     void release() {
-      lock.Lock();
       assert(!released);
       released = true;
-      put_unlock();
+      put();
     }
     void put() {
-      lock.Lock();
-      put_unlock();
-    }
-    void put_unlock() {
-      assert(ref > 0);
-      int n = --ref;
-      lock.Unlock();
+      int n = ref.dec();
+      assert(n >= 0);
       if (!n)
 	delete this;
     }
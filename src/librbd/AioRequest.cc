@@ -52,6 +52,114 @@ namespace librbd {
 	     m_parent_completion);
   }
 
+  /** copy-on-read **/
+
+  namespace {
+    // drops the in-flight marker once the whole request is done
+    struct C_CopyOnReadFinish : public Context {
+      ImageCtx *ictx;
+      uint64_t object_no;
+      C_CopyOnReadFinish(ImageCtx *i, uint64_t ono)
+	: ictx(i), object_no(ono) {}
+      virtual void finish(int r) {
+	Mutex::Locker l(ictx->copyup_lock);
+	ictx->copyup_in_progress.erase(object_no);
+	ictx->copyup_cond.Signal();
+      }
+    };
+  }
+
+  CopyOnReadRequest::CopyOnReadRequest(ImageCtx *ictx, const std::string &oid,
+				       uint64_t objectno,
+				       const ::SnapContext &snapc,
+				       Context *completion)
+    : AioRequest(ictx, oid, objectno, 0, ictx->layout.fl_object_size,
+		 CEPH_NOSNAP, completion, false),
+      m_state(COR_STATE_READ_FROM_PARENT), m_snap_seq(snapc.seq.val)
+  {
+    for (std::vector<snapid_t>::const_iterator it = snapc.snaps.begin();
+	 it != snapc.snaps.end(); ++it) {
+      m_snaps.push_back(it->val);
+    }
+  }
+
+  bool CopyOnReadRequest::should_complete(int r)
+  {
+    ldout(m_ictx->cct, 20) << "copy-on-read should_complete " << this << " "
+			   << m_oid << " r = " << r << dendl;
+
+    switch (m_state) {
+    case COR_STATE_READ_FROM_PARENT:
+      if (r < 0 || m_read_data.length() == 0)
+	return true;
+      m_state = COR_STATE_COPYUP;
+      // the object map must say the object may exist before it can
+      r = m_ictx->mark_objects_exist(m_object_no, m_object_no + 1);
+      if (r < 0)
+	return true;
+      send_copyup();
+      return false;
+
+    case COR_STATE_COPYUP:
+      if (r < 0)
+	ldout(m_ictx->cct, 10) << "copy-on-read copyup of " << m_oid
+			       << " failed: r = " << r << dendl;
+      return true;
+
+    default:
+      lderr(m_ictx->cct) << "invalid request state: " << m_state << dendl;
+      assert(0);
+    }
+    return true;
+  }
+
+  int CopyOnReadRequest::send()
+  {
+    ldout(m_ictx->cct, 20) << "copy-on-read send " << this << " " << m_oid
+			   << dendl;
+
+    vector<pair<uint64_t,uint64_t> > image_extents;
+    {
+      RWLock::RLocker l(m_ictx->snap_lock);
+      RWLock::RLocker l2(m_ictx->parent_lock);
+
+      if (m_ictx->parent) {
+	Striper::extent_to_file(m_ictx->cct, &m_ictx->layout,
+				m_object_no, 0, m_ictx->layout.fl_object_size,
+				image_extents);
+	uint64_t image_overlap = 0;
+	int r = m_ictx->get_parent_overlap(CEPH_NOSNAP, &image_overlap);
+	if (r < 0 ||
+	    m_ictx->prune_parent_extents(image_extents, image_overlap) == 0)
+	  image_extents.clear();
+      }
+    }
+
+    if (image_extents.empty()) {
+      // parent went away or overlap shrank to zero; nothing to copy
+      complete(0);
+      return 0;
+    }
+
+    read_from_parent(image_extents);
+    return 0;
+  }
+
+  void CopyOnReadRequest::send_copyup()
+  {
+    ldout(m_ictx->cct, 20) << "copy-on-read send_copyup " << this << " "
+			   << m_oid << dendl;
+
+    librados::ObjectWriteOperation op;
+    op.exec("rbd", "copyup", m_read_data);
+
+    librados::AioCompletion *rados_completion =
+      librados::Rados::aio_create_completion(this, NULL, rados_req_cb);
+    m_ictx->md_ctx.aio_operate(m_oid, rados_completion, &op,
+			       m_snap_seq, m_snaps);
+    rados_completion->release();
+  }
+
   /** read **/
 
   bool AioRead::should_complete(int r)
@@ -82,6 +190,33 @@ namespace librbd {
       }
     }
 
+    if (m_tried_parent && r >= 0 &&
+	m_ictx->cct->_conf->rbd_clone_copy_on_read &&
+	m_snap_id == CEPH_NOSNAP && !m_ictx->read_only) {
+      // localize the object for future reads, off the latency path.
+      // only one copy per object at a time; concurrent parent reads of
+      // the same object piggyback on the one already in flight.
+      bool start = false;
+      {
+	Mutex::Locker l(m_ictx->copyup_lock);
+	if (m_ictx->copyup_in_progress.count(m_object_no) == 0) {
+	  m_ictx->copyup_in_progress.insert(m_object_no);
+	  start = true;
+	}
+      }
+      if (start) {
+	::SnapContext snapc;
+	{
+	  RWLock::RLocker l(m_ictx->snap_lock);
+	  snapc = m_ictx->snapc;
+	}
+	CopyOnReadRequest *req =
+	  new CopyOnReadRequest(m_ictx, m_oid, m_object_no, snapc,
+				new C_CopyOnReadFinish(m_ictx, m_object_no));
+	req->send();
+      }
+    }
+
     return true;
   }
 
@@ -88,6 +88,36 @@ namespace librbd {
     bool m_sparse;
   };
 
+  /**
+   * Copies an entire object from the parent into the child in the
+   * background, kicked off after a read had to be served from the
+   * parent (rbd_clone_copy_on_read), so that repeated reads of a
+   * cloned image localize to the child.  The copyup class method is a
+   * no-op on the OSD if the child object exists by the time it
+   * arrives, so this can never clobber a more recent child write.
+   */
+  class CopyOnReadRequest : public AioRequest {
+  public:
+    CopyOnReadRequest(ImageCtx *ictx, const std::string &oid,
+		      uint64_t objectno, const ::SnapContext &snapc,
+		      Context *completion);
+    virtual ~CopyOnReadRequest() {}
+    virtual bool should_complete(int r);
+    virtual int send();
+
+  private:
+    enum cor_state_d {
+      COR_STATE_READ_FROM_PARENT,
+      COR_STATE_COPYUP
+    };
+
+    void send_copyup();
+
+    cor_state_d m_state;
+    uint64_t m_snap_seq;
+    std::vector<librados::snap_t> m_snaps;
+  };
+
   class AbstractWrite : public AioRequest {
   public:
     AbstractWrite();
@@ -6,6 +6,7 @@
 #include "common/dout.h"
 #include "common/errno.h"
 #include "common/perf_counters.h"
+#include "common/Timer.h"
 
 #include "librbd/internal.h"
 #include "librbd/WatchCtx.h"
@@ -51,7 +52,13 @@ namespace librbd {
       format_string(NULL),
       id(image_id), parent(NULL),
       stripe_unit(0), stripe_count(0),
-      object_cacher(NULL), writeback_handler(NULL), object_set(NULL)
+      object_cacher(NULL), writeback_handler(NULL), object_set(NULL),
+      object_map_lock("librbd::ImageCtx::object_map_lock"),
+      object_map_enabled(false),
+      copyup_lock("librbd::ImageCtx::copyup_lock"),
+      discard_lock("librbd::ImageCtx::discard_lock"),
+      discard_timer(NULL),
+      discard_flush_scheduled(false)
   {
     md_ctx.dup(p);
     data_ctx.dup(p);
@@ -99,6 +106,13 @@ namespace librbd {
   }
 
   ImageCtx::~ImageCtx() {
+    if (discard_timer) {
+      discard_lock.Lock();
+      discard_timer->shutdown();
+      discard_lock.Unlock();
+      delete discard_timer;
+      discard_timer = NULL;
+    }
     perf_stop();
     if (object_cacher) {
       delete object_cacher;
@@ -117,6 +131,10 @@ namespace librbd {
 
   int ImageCtx::init() {
     int r;
+    if (cct->_conf->rbd_discard_coalesce_window > 0) {
+      discard_timer = new SafeTimer(cct, discard_lock, false);
+      discard_timer->init();
+    }
     if (id.length()) {
       old_format = false;
     } else {
@@ -138,6 +156,7 @@ namespace librbd {
       }
 
       header_oid = header_name(id);
+      object_map_oid = RBD_OBJECT_MAP_PREFIX + id;
       r = cls_client::get_immutable_metadata(&md_ctx, header_oid,
 					     &object_prefix, &order);
       if (r < 0) {
@@ -205,9 +224,11 @@ namespace librbd {
     plb.add_u64_counter(l_librbd_rd, "rd");
     plb.add_u64_counter(l_librbd_rd_bytes, "rd_bytes");
     plb.add_time_avg(l_librbd_rd_latency, "rd_latency");
+    plb.add_time_hist(l_librbd_rd_latency_hist, "rd_latency_hist");
     plb.add_u64_counter(l_librbd_wr, "wr");
     plb.add_u64_counter(l_librbd_wr_bytes, "wr_bytes");
     plb.add_time_avg(l_librbd_wr_latency, "wr_latency");
+    plb.add_time_hist(l_librbd_wr_latency_hist, "wr_latency_hist");
     plb.add_u64_counter(l_librbd_discard, "discard");
     plb.add_u64_counter(l_librbd_discard_bytes, "discard_bytes");
     plb.add_time_avg(l_librbd_discard_latency, "discard_latency");
@@ -215,9 +236,11 @@ namespace librbd {
     plb.add_u64_counter(l_librbd_aio_rd, "aio_rd");
     plb.add_u64_counter(l_librbd_aio_rd_bytes, "aio_rd_bytes");
     plb.add_time_avg(l_librbd_aio_rd_latency, "aio_rd_latency");
+    plb.add_time_hist(l_librbd_aio_rd_latency_hist, "aio_rd_latency_hist");
     plb.add_u64_counter(l_librbd_aio_wr, "aio_wr");
     plb.add_u64_counter(l_librbd_aio_wr_bytes, "aio_wr_bytes");
     plb.add_time_avg(l_librbd_aio_wr_latency, "aio_wr_latency");
+    plb.add_time_hist(l_librbd_aio_wr_latency_hist, "aio_wr_latency_hist");
     plb.add_u64_counter(l_librbd_aio_discard, "aio_discard");
     plb.add_u64_counter(l_librbd_aio_discard_bytes, "aio_discard_bytes");
     plb.add_time_avg(l_librbd_aio_discard_latency, "aio_discard_latency");
@@ -341,6 +364,88 @@ namespace librbd {
     return stripe_count * (1ull << order);
   }
 
+  int ImageCtx::load_object_map()
+  {
+    if (old_format || !(features & RBD_FEATURE_OBJECT_MAP))
+      return 0;
+
+    uint64_t map_size;
+    int r = md_ctx.stat(object_map_oid, &map_size, NULL);
+    if (r < 0) {
+      lderr(cct) << "error reading object map size: " << cpp_strerror(r)
+		 << dendl;
+      return r;
+    }
+    bufferlist bl;
+    r = md_ctx.read(object_map_oid, bl, map_size, 0);
+    if (r < 0) {
+      lderr(cct) << "error reading object map: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    Mutex::Locker l(object_map_lock);
+    object_map.resize(bl.length());
+    if (bl.length())
+      bl.copy(0, bl.length(), (char *)&object_map[0]);
+    object_map_enabled = true;
+    ldout(cct, 10) << "loaded object map, " << object_map.size()
+		   << " bytes" << dendl;
+    return 0;
+  }
+
+  bool ImageCtx::object_may_exist(uint64_t ono)
+  {
+    Mutex::Locker l(object_map_lock);
+    if (!object_map_enabled)
+      return true;
+    if (ono >= object_map.size() * 8ull)
+      return true;       // not covered by the map; assume the worst
+    return (object_map[ono >> 3] & (1 << (ono & 7))) != 0;
+  }
+
+  int ImageCtx::mark_objects_exist(uint64_t start_ono, uint64_t end_ono)
+  {
+    {
+      Mutex::Locker l(object_map_lock);
+      if (!object_map_enabled)
+	return 0;
+      bool need_update = false;
+      for (uint64_t i = start_ono; i < end_ono; i++) {
+	if (i >= object_map.size() * 8ull ||
+	    !(object_map[i >> 3] & (1 << (i & 7)))) {
+	  need_update = true;
+	  break;
+	}
+      }
+      if (!need_update)
+	return 0;
+    }
+
+    // first touch of an object in the range.  the bits must be durable
+    // before any write is issued, so that a crash cannot leave behind
+    // an object the map claims was never written.
+    int r = cls_client::object_map_update(&md_ctx, object_map_oid,
+					  start_ono, end_ono);
+    if (r < 0) {
+      lderr(cct) << "error updating object map: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    Mutex::Locker l(object_map_lock);
+    for (uint64_t i = start_ono;
+	 i < end_ono && (i >> 3) < object_map.size();
+	 i++)
+      object_map[i >> 3] |= 1 << (i & 7);
+    return 0;
+  }
+
+  void ImageCtx::object_map_resized(uint64_t num_objects)
+  {
+    Mutex::Locker l(object_map_lock);
+    if (object_map_enabled)
+      object_map.resize((num_objects + 7) / 8);
+  }
+
   uint64_t ImageCtx::get_num_objects() const
   {
     uint64_t period = get_stripe_period();
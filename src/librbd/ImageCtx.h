@@ -5,15 +5,18 @@
 
 #include "include/int_types.h"
 
+#include <list>
 #include <map>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "common/Cond.h"
 #include "common/Mutex.h"
 #include "common/RWLock.h"
 #include "common/snap_types.h"
 #include "include/buffer.h"
+#include "include/interval_set.h"
 #include "include/rbd/librbd.hpp"
 #include "include/rbd_types.h"
 #include "include/types.h"
@@ -26,9 +29,11 @@
 
 class CephContext;
 class PerfCounters;
+class SafeTimer;
 
 namespace librbd {
 
+  struct AioCompletion;
   class WatchCtx;
 
   struct ImageCtx {
@@ -89,6 +94,32 @@ namespace librbd {
     LibrbdWriteback *writeback_handler;
     ObjectCacher::ObjectSet *object_set;
 
+    // object existence map (RBD_FEATURE_OBJECT_MAP): bit per data
+    // object, set once the object may have been written.  bits are
+    // only ever set (monotonic), so a cached copy can go stale only
+    // in the safe direction.
+    Mutex object_map_lock;
+    bool object_map_enabled;
+    std::vector<uint8_t> object_map;
+    std::string object_map_oid;
+
+    // objects with a background copy-on-read from the parent in
+    // flight (rbd_clone_copy_on_read), to avoid issuing duplicate
+    // copyups for concurrent reads of the same object.  close_image()
+    // waits for this to drain.
+    Mutex copyup_lock;
+    Cond copyup_cond;
+    std::set<uint64_t> copyup_in_progress;
+
+    // discard coalescing (rbd_discard_coalesce_window): guest trims
+    // are queued and merged here, then issued as one batch when the
+    // window expires or a write/flush needs to order behind them
+    Mutex discard_lock;
+    SafeTimer *discard_timer;
+    bool discard_flush_scheduled;
+    interval_set<uint64_t> pending_discards;
+    std::list<AioCompletion*> discard_waiters;
+
     /**
      * Either image_name or image_id must be set.
      * If id is not known, pass the empty std::string,
@@ -119,6 +150,11 @@ namespace librbd {
     uint64_t get_stripe_count() const;
     uint64_t get_stripe_period() const;
 
+    int load_object_map();
+    bool object_may_exist(uint64_t ono);
+    int mark_objects_exist(uint64_t start_ono, uint64_t end_ono);
+    void object_map_resized(uint64_t num_objects);
+
     void add_snap(std::string in_snap_name, librados::snap_t id,
 		  uint64_t in_size, uint64_t features,
 		  parent_info parent, uint8_t protection_status);
@@ -108,6 +108,27 @@ namespace librbd {
     assert(r >= 0);
   }
 
+  void LibrbdWriteback::read_sparse(const object_t& oid,
+				    const object_locator_t& oloc,
+				    uint64_t off, uint64_t len,
+				    snapid_t snapid,
+				    map<uint64_t, uint64_t> *extents,
+				    bufferlist *pbl, uint64_t trunc_size,
+				    __u32 trunc_seq, Context *onfinish)
+  {
+    // on completion, take the mutex and then call onfinish.
+    Context *req = new C_Request(m_ictx->cct, onfinish, &m_lock);
+    librados::AioCompletion *rados_completion =
+      librados::Rados::aio_create_completion(req, context_cb, NULL);
+    librados::ObjectReadOperation op;
+    op.sparse_read(off, len, extents, pbl, NULL);
+    int flags = m_ictx->get_read_flags(snapid);
+    int r = m_ictx->data_ctx.aio_operate(oid.name, rados_completion, &op,
+					 flags, NULL);
+    rados_completion->release();
+    assert(r >= 0);
+  }
+
   bool LibrbdWriteback::may_copy_on_write(const object_t& oid, uint64_t read_off, uint64_t read_len, snapid_t snapid)
   {
     m_ictx->snap_lock.get_read();
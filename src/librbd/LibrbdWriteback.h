@@ -28,6 +28,13 @@ namespace librbd {
 		      bufferlist *pbl, uint64_t trunc_size,  __u32 trunc_seq,
 		      Context *onfinish);
 
+    virtual bool can_read_sparse() { return true; }
+    virtual void read_sparse(const object_t& oid, const object_locator_t& oloc,
+			     uint64_t off, uint64_t len, snapid_t snapid,
+			     map<uint64_t, uint64_t> *extents, bufferlist *pbl,
+			     uint64_t trunc_size, __u32 trunc_seq,
+			     Context *onfinish);
+
     // Determine whether a read to this extent could be affected by a write-triggered copy-on-write
     virtual bool may_copy_on_write(const object_t& oid, uint64_t read_off, uint64_t read_len, snapid_t snapid);
 
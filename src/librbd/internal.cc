@@ -43,6 +43,8 @@ using librados::IoCtx;
 using librados::Rados;
 
 namespace librbd {
+  void flush_pending_discards(ImageCtx *ictx);
+
   const string id_obj_name(const string &name)
   {
     return RBD_ID_PREFIX + name;
@@ -53,6 +55,11 @@ namespace librbd {
     return RBD_HEADER_PREFIX + image_id;
   }
 
+  const string object_map_name(const string &image_id)
+  {
+    return RBD_OBJECT_MAP_PREFIX + image_id;
+  }
+
   const string old_header_name(const string &image_name)
   {
     return image_name + RBD_SUFFIX;
@@ -170,6 +177,12 @@ namespace librbd {
       ldout(cct, 2) << "trim_image objects " << delete_start << " to "
 		    << (num_objects - 1) << dendl;
       for (uint64_t i = delete_start; i < num_objects; ++i) {
+	if (!ictx->object_may_exist(i)) {
+	  // never written; don't pay for a round trip to delete nothing
+	  prog_ctx.update_progress((i - delete_start) * object_size,
+				   (num_objects - delete_start) * object_size);
+	  continue;
+	}
 	string oid = ictx->get_object_name(i);
 	Context *req_comp = new C_SimpleThrottle(&throttle);
 	librados::AioCompletion *rados_completion =
@@ -797,6 +810,19 @@ reprotect_and_return_err:
       }
     }
 
+    if (features & RBD_FEATURE_OBJECT_MAP) {
+      uint64_t count = stripe_count ? stripe_count : 1;
+      uint64_t period = count * (1ull << order);
+      uint64_t num_objects = ((size + period - 1) / period) * count;
+      r = cls_client::object_map_resize(&io_ctx, object_map_name(id),
+					num_objects);
+      if (r < 0) {
+	lderr(cct) << "error creating object map: " << cpp_strerror(r)
+		   << dendl;
+	goto err_remove_header;
+      }
+    }
+
     ldout(cct, 2) << "done." << dendl;
     return 0;
 
@@ -1407,6 +1433,16 @@ reprotect_and_return_err:
 	lderr(cct) << "error removing header: " << cpp_strerror(-r) << dendl;
 	return r;
       }
+
+      if (!old_format) {
+	ldout(cct, 2) << "removing object map..." << dendl;
+	r = io_ctx.remove(object_map_name(id));
+	if (r < 0 && r != -ENOENT) {
+	  lderr(cct) << "error removing object map: " << cpp_strerror(-r)
+		     << dendl;
+	  return r;
+	}
+      }
     }
 
     if (old_format || unknown_format) {
@@ -1489,6 +1525,18 @@ reprotect_and_return_err:
       notify_change(ictx->md_ctx, ictx->header_oid, NULL, ictx);
     }
 
+    if (ictx->object_map_enabled) {
+      uint64_t num_objects = ictx->get_num_objects();
+      r = cls_client::object_map_resize(&ictx->md_ctx, ictx->object_map_oid,
+					num_objects);
+      if (r < 0) {
+	lderr(cct) << "error resizing object map: " << cpp_strerror(-r)
+		   << dendl;
+	return r;
+      }
+      ictx->object_map_resized(num_objects);
+    }
+
     return 0;
   }
 
@@ -1813,6 +1861,13 @@ reprotect_and_return_err:
       _flush(ictx);
     }
 
+    if (!ictx->old_format && (ictx->features & RBD_FEATURE_OBJECT_MAP) &&
+	!ictx->object_map_enabled) {
+      int r = ictx->load_object_map();
+      if (r < 0)
+	return r;
+    }
+
     ictx->refresh_lock.Lock();
     ictx->last_refresh = refresh_seq;
     ictx->refresh_lock.Unlock();
@@ -2110,11 +2165,21 @@ reprotect_and_return_err:
   void close_image(ImageCtx *ictx)
   {
     ldout(ictx->cct, 20) << "close_image " << ictx << dendl;
+    if (ictx->discard_timer)
+      flush_pending_discards(ictx);
     if (ictx->object_cacher)
       ictx->shutdown_cache(); // implicitly flushes
     else
       flush(ictx);
 
+    {
+      // wait for any background copy-on-read requests, which aren't
+      // tracked by user-visible completions
+      Mutex::Locker l(ictx->copyup_lock);
+      while (!ictx->copyup_in_progress.empty())
+	ictx->copyup_cond.Wait(ictx->copyup_lock);
+    }
+
     if (ictx->parent) {
       close_image(ictx->parent);
       ictx->parent = NULL;
@@ -2175,9 +2240,33 @@ reprotect_and_return_err:
       overlap_objects = overlap_periods * ictx->get_stripe_count();
     }
 
+    // resume an interrupted flatten from its last checkpoint, if any.
+    // already-copied objects exist in the child, so re-issuing their
+    // copyups would be harmless no-ops, just a lot of wasted ops.
+    uint64_t start_ono = 0;
+    {
+      bufferlist posbl;
+      r = ictx->md_ctx.getxattr(ictx->header_oid, RBD_FLATTEN_POS_XATTR,
+				posbl);
+      if (r >= 0) {
+	try {
+	  bufferlist::iterator it = posbl.begin();
+	  ::decode(start_ono, it);
+	} catch (const buffer::error &err) {
+	  start_ono = 0;
+	}
+	if (start_ono > overlap_objects)
+	  start_ono = 0;
+	ldout(cct, 10) << "resuming flatten at object " << start_ono << "/"
+		       << overlap_objects << dendl;
+      }
+    }
+
+    uint64_t chunk_size = cct->_conf->rbd_flatten_chunk_size;
+
     SimpleThrottle throttle(cct->_conf->rbd_concurrent_management_ops, false);
 
-    for (uint64_t ono = 0; ono < overlap_objects; ono++) {
+    for (uint64_t ono = start_ono; ono < overlap_objects; ono++) {
       {
 	RWLock::RLocker l(ictx->parent_lock);
 	// stop early if the parent went away - it just means
@@ -2208,6 +2297,30 @@ reprotect_and_return_err:
       }
 
       prog_ctx.update_progress(ono, overlap_objects);
+
+      // at chunk boundaries, drain in-flight ops and checkpoint our
+      // position so an interrupted flatten can pick up from here
+      if (chunk_size && (ono + 1) % chunk_size == 0 &&
+	  ono + 1 < overlap_objects) {
+	r = throttle.wait_for_ret();
+	if (r < 0) {
+	  lderr(cct) << "failed to flatten at least one object: "
+		     << cpp_strerror(r) << dendl;
+	  goto err;
+	}
+	bufferlist posbl;
+	::encode(ono + 1, posbl);
+	r = ictx->md_ctx.setxattr(ictx->header_oid, RBD_FLATTEN_POS_XATTR,
+				  posbl);
+	if (r < 0)
+	  ldout(cct, 10) << "failed to checkpoint flatten position: "
+			 << cpp_strerror(r) << dendl;
+	if (cct->_conf->rbd_flatten_sleep > 0) {
+	  utime_t t;
+	  t.set_from_double(cct->_conf->rbd_flatten_sleep);
+	  t.sleep();
+	}
+      }
     }
 
     r = throttle.wait_for_ret();
@@ -2223,6 +2336,7 @@ reprotect_and_return_err:
       lderr(cct) << "error removing parent" << dendl;
       return r;
     }
+    ictx->md_ctx.rmxattr(ictx->header_oid, RBD_FLATTEN_POS_XATTR);
 
     // and if there are no snaps, remove from the children object as well
     // (if snapshots remain, they have their own parent info, and the child
@@ -2422,6 +2536,7 @@ reprotect_and_return_err:
 
     elapsed = ceph_clock_now(ictx->cct) - start_time;
     ictx->perfcounter->tinc(l_librbd_rd_latency, elapsed);
+    ictx->perfcounter->hinc(l_librbd_rd_latency_hist, elapsed);
     ictx->perfcounter->inc(l_librbd_rd);
     ictx->perfcounter->inc(l_librbd_rd_bytes, mylen);
     return total_read;
@@ -2682,6 +2797,7 @@ reprotect_and_return_err:
 
     elapsed = ceph_clock_now(ictx->cct) - start_time;
     ictx->perfcounter->tinc(l_librbd_wr_latency, elapsed);
+    ictx->perfcounter->hinc(l_librbd_wr_latency_hist, elapsed);
     ictx->perfcounter->inc(l_librbd_wr);
     ictx->perfcounter->inc(l_librbd_wr_bytes, mylen);
     return mylen;
@@ -2833,6 +2949,9 @@ reprotect_and_return_err:
     if (r < 0)
       return r;
 
+    if (ictx->discard_timer)
+      flush_pending_discards(ictx);
+
     ictx->user_flushed();
 
     c->get();
@@ -2863,6 +2982,9 @@ reprotect_and_return_err:
     if (r < 0)
       return r;
 
+    if (ictx->discard_timer)
+      flush_pending_discards(ictx);
+
     ictx->user_flushed();
     r = _flush(ictx);
     ictx->perfcounter->inc(l_librbd_flush);
@@ -2910,6 +3032,11 @@ reprotect_and_return_err:
     if (r < 0)
       return r;
 
+    // a queued discard overlapping this write must reach the osd
+    // first; issuing it now preserves per-object ordering
+    if (ictx->discard_timer)
+      flush_pending_discards(ictx);
+
     uint64_t mylen = len;
     r = clip_io(ictx, off, &mylen);
     if (r < 0)
@@ -2936,6 +3063,21 @@ reprotect_and_return_err:
 			       &ictx->layout, off, mylen, 0, extents);
     }
 
+    // the object map bits must be durable before any write is issued
+    // (a cached, already-set range costs nothing here)
+    if (!extents.empty()) {
+      uint64_t min_ono = extents.front().objectno;
+      uint64_t max_ono = min_ono;
+      for (vector<ObjectExtent>::iterator p = extents.begin();
+	   p != extents.end(); ++p) {
+	min_ono = MIN(min_ono, p->objectno);
+	max_ono = MAX(max_ono, p->objectno);
+      }
+      r = ictx->mark_objects_exist(min_ono, max_ono + 1);
+      if (r < 0)
+	return r;
+    }
+
     c->get();
     c->init_time(ictx, AIO_TYPE_WRITE);
     for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
@@ -2981,11 +3123,12 @@ reprotect_and_return_err:
     return r;
   }
 
-  int aio_discard(ImageCtx *ictx, uint64_t off, uint64_t len, AioCompletion *c)
+  int do_aio_discard(ImageCtx *ictx, uint64_t off, uint64_t len,
+		     AioCompletion *c)
   {
     CephContext *cct = ictx->cct;
-    ldout(cct, 20) << "aio_discard " << ictx << " off = " << off << " len = "
-		   << len << dendl;
+    ldout(cct, 20) << "do_aio_discard " << ictx << " off = " << off
+		   << " len = " << len << dendl;
 
     int r = ictx_check(ictx);
     if (r < 0)
@@ -3020,6 +3163,15 @@ reprotect_and_return_err:
     for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
       ldout(cct, 20) << " oid " << p->oid << " " << p->offset << "~" << p->length
 		     << " from " << p->buffer_extents << dendl;
+
+      // a boundary truncate or zero can instantiate the object on the
+      // osd, so it has to be marked in the object map like a write
+      if (!(p->offset == 0 && p->length == ictx->layout.fl_object_size)) {
+	r = ictx->mark_objects_exist(p->objectno, p->objectno + 1);
+	if (r < 0)
+	  goto done;
+      }
+
       C_AioWrite *req_comp = new C_AioWrite(cct, c);
       AbstractWrite *req;
       c->add_request();
@@ -3060,13 +3212,120 @@ reprotect_and_return_err:
     c->finish_adding_requests(ictx->cct);
     c->put();
 
-    ictx->perfcounter->inc(l_librbd_aio_discard);
-    ictx->perfcounter->inc(l_librbd_aio_discard_bytes, len);
-
     /* FIXME: cleanup all the allocated stuff */
     return r;
   }
 
+  // completes all the guest discards queued behind one merged batch
+  class C_DiscardBatch : public Context {
+  public:
+    C_DiscardBatch(ImageCtx *ictx, std::list<AioCompletion*> &waiters)
+      : m_ictx(ictx) {
+      m_waiters.swap(waiters);
+    }
+    virtual void finish(int r) {
+      for (std::list<AioCompletion*>::iterator p = m_waiters.begin();
+	   p != m_waiters.end(); ++p)
+	(*p)->complete_request(m_ictx->cct, r);
+    }
+  private:
+    ImageCtx *m_ictx;
+    std::list<AioCompletion*> m_waiters;
+  };
+
+  struct C_DiscardFlush : public Context {
+    ImageCtx *ictx;
+    C_DiscardFlush(ImageCtx *i) : ictx(i) {}
+    virtual void finish(int r) {
+      flush_pending_discards(ictx);
+    }
+  };
+
+  void flush_pending_discards(ImageCtx *ictx)
+  {
+    interval_set<uint64_t> pending;
+    std::list<AioCompletion*> waiters;
+    {
+      Mutex::Locker l(ictx->discard_lock);
+      if (ictx->discard_waiters.empty())
+	return;
+      pending.swap(ictx->pending_discards);
+      waiters.swap(ictx->discard_waiters);
+      ictx->discard_flush_scheduled = false;
+    }
+
+    ldout(ictx->cct, 20) << "flush_pending_discards "
+			 << pending.num_intervals() << " merged extents, "
+			 << waiters.size() << " waiters" << dendl;
+
+    C_GatherBuilder gather(ictx->cct, new C_DiscardBatch(ictx, waiters));
+    for (interval_set<uint64_t>::iterator p = pending.begin();
+	 p != pending.end(); ++p) {
+      Context *sub = gather.new_sub();
+      AioCompletion *c = aio_create_completion_internal(sub, rbd_ctx_cb);
+      int r = do_aio_discard(ictx, p.get_start(), p.get_len(), c);
+      if (r < 0 && c->building) {
+	// failed before any sub-request was issued, so the completion
+	// will never fire on its own
+	sub->complete(r);
+      }
+      c->release();
+    }
+    gather.activate();
+  }
+
+  int aio_discard(ImageCtx *ictx, uint64_t off, uint64_t len, AioCompletion *c)
+  {
+    CephContext *cct = ictx->cct;
+    ldout(cct, 20) << "aio_discard " << ictx << " off = " << off << " len = "
+		   << len << dendl;
+
+    int window = cct->_conf->rbd_discard_coalesce_window;
+    if (ictx->discard_timer && window > 0 && len > 0) {
+      // queue the discard so adjacent trims can merge; it is issued
+      // when the window expires or a write/flush orders behind it.
+      // nothing is promised to the guest until c completes.
+      int r = ictx_check(ictx);
+      if (r < 0)
+	return r;
+      r = clip_io(ictx, off, &len);
+      if (r < 0)
+	return r;
+
+      ictx->snap_lock.get_read();
+      snapid_t snap_id = ictx->snap_id;
+      ictx->snap_lock.put_read();
+      if (snap_id != CEPH_NOSNAP || ictx->read_only)
+	return -EROFS;
+
+      c->get();
+      c->init_time(ictx, AIO_TYPE_DISCARD);
+      c->add_request();
+      {
+	Mutex::Locker l(ictx->discard_lock);
+	interval_set<uint64_t> tmp;
+	tmp.insert(off, len);
+	ictx->pending_discards.union_of(tmp);
+	ictx->discard_waiters.push_back(c);
+	if (!ictx->discard_flush_scheduled) {
+	  ictx->discard_timer->add_event_after(window / 1000.0,
+					       new C_DiscardFlush(ictx));
+	  ictx->discard_flush_scheduled = true;
+	}
+      }
+      c->finish_adding_requests(cct);
+      c->put();
+    } else {
+      int r = do_aio_discard(ictx, off, len, c);
+      if (r < 0)
+	return r;
+    }
+
+    ictx->perfcounter->inc(l_librbd_aio_discard);
+    ictx->perfcounter->inc(l_librbd_aio_discard_bytes, len);
+    return 0;
+  }
+
   void rbd_req_cb(completion_t cb, void *arg)
   {
     AioRequest *req = reinterpret_cast<AioRequest *>(arg);
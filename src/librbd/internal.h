@@ -20,9 +20,11 @@ enum {
   l_librbd_rd,               // read ops
   l_librbd_rd_bytes,         // bytes read
   l_librbd_rd_latency,       // average latency
+  l_librbd_rd_latency_hist,  // latency histogram, log2(usec) buckets
   l_librbd_wr,
   l_librbd_wr_bytes,
   l_librbd_wr_latency,
+  l_librbd_wr_latency_hist,
   l_librbd_discard,
   l_librbd_discard_bytes,
   l_librbd_discard_latency,
@@ -31,9 +33,11 @@ enum {
   l_librbd_aio_rd,               // read ops
   l_librbd_aio_rd_bytes,         // bytes read
   l_librbd_aio_rd_latency,
+  l_librbd_aio_rd_latency_hist,
   l_librbd_aio_wr,
   l_librbd_aio_wr_bytes,
   l_librbd_aio_wr_latency,
+  l_librbd_aio_wr_latency_hist,
   l_librbd_aio_discard,
   l_librbd_aio_discard_bytes,
   l_librbd_aio_discard_latency,
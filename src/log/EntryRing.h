@@ -0,0 +1,70 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef __CEPH_LOG_ENTRYRING_H
+#define __CEPH_LOG_ENTRYRING_H
+
+#include <string.h>
+
+#include "Entry.h"
+#include "include/atomic.h"
+
+namespace ceph {
+namespace log {
+
+/*
+ * Single-producer/single-consumer ring of submitted entries.  Each
+ * logging thread owns one ring (the producer side); the flusher thread
+ * drains them all (the consumer side, serialized by Log's flush mutex),
+ * so the common submit path never takes a lock.  When a ring fills up
+ * the submitter falls back on Log's mutex-protected queue, which also
+ * provides the backpressure the old path had.
+ */
+struct EntryRing {
+  enum { RING_SIZE = 4096 };  // must be a power of two
+
+  Entry *m_slot[RING_SIZE];
+  atomic_t m_head;    ///< next slot the producer fills
+  atomic_t m_tail;    ///< next slot the consumer drains
+  atomic_t m_in_use;  ///< claimed by a live thread
+  EntryRing *m_next;  ///< registration list, protected by Log
+
+  EntryRing() : m_next(NULL) {
+    memset(m_slot, 0, sizeof(m_slot));
+  }
+  ~EntryRing() {
+    Entry *e;
+    while ((e = pop()) != NULL)
+      delete e;
+  }
+
+  bool empty() const {
+    return m_tail.read() == m_head.read();
+  }
+
+  /// producer only; false if the ring is full
+  bool push(Entry *e) {
+    unsigned h = m_head.read();
+    if (h - (unsigned)m_tail.read() >= (unsigned)RING_SIZE)
+      return false;
+    m_slot[h & (RING_SIZE - 1)] = e;
+    m_head.set_release(h + 1);   // publish the slot before the head
+    return true;
+  }
+
+  /// consumer only; NULL if the ring is empty
+  Entry *pop() {
+    unsigned t = m_tail.read();
+    if (t == (unsigned)m_head.read())
+      return NULL;
+    Entry *e = m_slot[t & (RING_SIZE - 1)];
+    m_slot[t & (RING_SIZE - 1)] = NULL;
+    m_tail.set_release(t + 1);   // free the slot only after we read it
+    return e;
+  }
+};
+
+}
+}
+
+#endif
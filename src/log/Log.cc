@@ -5,9 +5,12 @@
 
 #include <errno.h>
 #include <syslog.h>
+#include <time.h>
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include "common/errno.h"
 #include "common/safe_io.h"
@@ -33,10 +36,24 @@ static void log_on_exit(void *p)
     l->flush();
 }
 
+static void ring_release(void *p)
+{
+  // thread exit: give the ring up for reuse.  any entries still queued
+  // stay put; the flusher drains them as usual.
+  ((EntryRing *)p)->m_in_use.set(0);
+}
+
+struct EntryStampLess {
+  bool operator()(Entry *l, Entry *r) const {
+    return l->m_stamp < r->m_stamp;
+  }
+};
+
 Log::Log(SubsystemMap *s)
   : m_indirect_this(NULL),
     m_subs(s),
     m_new(), m_recent(),
+    m_rings(NULL),
     m_fd(-1),
     m_syslog_log(-2), m_syslog_crash(-2),
     m_stderr_log(1), m_stderr_crash(-1),
@@ -58,6 +75,9 @@ Log::Log(SubsystemMap *s)
   ret = pthread_cond_init(&m_cond_flusher, NULL);
   assert(ret == 0);
 
+  ret = pthread_key_create(&m_ring_key, ring_release);
+  assert(ret == 0);
+
   // kludge for prealloc testing
   if (false)
     for (int i=0; i < PREALLOC; i++)
@@ -74,6 +94,14 @@ Log::~Log()
   if (m_fd >= 0)
     VOID_TEMP_FAILURE_RETRY(::close(m_fd));
 
+  // nobody may log against us any more; tear down the rings
+  pthread_key_delete(m_ring_key);
+  while (m_rings) {
+    EntryRing *r = m_rings;
+    m_rings = r->m_next;
+    delete r;
+  }
+
   pthread_mutex_destroy(&m_queue_mutex);
   pthread_mutex_destroy(&m_flush_mutex);
   pthread_cond_destroy(&m_cond_loggers);
@@ -137,8 +165,44 @@ void Log::set_stderr_level(int log, int crash)
   pthread_mutex_unlock(&m_flush_mutex);
 }
 
+EntryRing *Log::_get_ring()
+{
+  EntryRing *ring = (EntryRing *)pthread_getspecific(m_ring_key);
+  if (ring)
+    return ring;
+
+  // claim a dormant ring from an exited thread, if any
+  pthread_mutex_lock(&m_queue_mutex);
+  for (EntryRing *r = m_rings; r; r = r->m_next) {
+    if (r->m_in_use.compare_and_swap(0, 1)) {
+      ring = r;
+      break;
+    }
+  }
+  if (!ring) {
+    ring = new EntryRing;
+    ring->m_in_use.set(1);
+    ring->m_next = m_rings;
+    m_rings = ring;
+  }
+  pthread_mutex_unlock(&m_queue_mutex);
+
+  pthread_setspecific(m_ring_key, ring);
+  return ring;
+}
+
 void Log::submit_entry(Entry *e)
 {
+  // fast path: lock-free push onto this thread's ring
+  if (_get_ring()->push(e)) {
+    // signaling without the mutex can race with the flusher going to
+    // sleep; its timed wait (entry()) bounds how long we can lose
+    pthread_cond_signal(&m_cond_flusher);
+    return;
+  }
+
+  // ring full: fall back on the locked queue, which also gives us
+  // backpressure when the flusher can't keep up
   pthread_mutex_lock(&m_queue_mutex);
 
   // wait for flush to catch up
@@ -167,12 +231,41 @@ Entry *Log::create_entry(int level, int subsys)
   }
 }
 
+// gather everything sitting in the rings and the fallback queue into
+// *q, in timestamp order.  caller must hold m_flush_mutex (we are the
+// single consumer of the rings) and m_queue_mutex (for the ring list).
+void Log::_drain_rings(EntryQueue *q)
+{
+  std::vector<Entry*> v;
+  v.reserve(q->m_len);
+  Entry *e;
+  while ((e = q->dequeue()) != NULL)
+    v.push_back(e);
+  for (EntryRing *r = m_rings; r; r = r->m_next) {
+    while ((e = r->pop()) != NULL)
+      v.push_back(e);
+  }
+  // each source is stamped in order, but sources interleave
+  std::stable_sort(v.begin(), v.end(), EntryStampLess());
+  for (std::vector<Entry*>::iterator p = v.begin(); p != v.end(); ++p)
+    q->enqueue(*p);
+}
+
+bool Log::_rings_have_entries()
+{
+  for (EntryRing *r = m_rings; r; r = r->m_next)
+    if (!r->empty())
+      return true;
+  return false;
+}
+
 void Log::flush()
 {
   pthread_mutex_lock(&m_flush_mutex);
   pthread_mutex_lock(&m_queue_mutex);
   EntryQueue t;
   t.swap(m_new);
+  _drain_rings(&t);
   pthread_cond_broadcast(&m_cond_loggers);
   pthread_mutex_unlock(&m_queue_mutex);
   _flush(&t, &m_recent, false);
@@ -257,6 +350,7 @@ void Log::dump_recent()
   pthread_mutex_lock(&m_queue_mutex);
   EntryQueue t;
   t.swap(m_new);
+  _drain_rings(&t);
   pthread_mutex_unlock(&m_queue_mutex);
   _flush(&t, &m_recent, false);
 
@@ -313,14 +407,24 @@ void *Log::entry()
 {
   pthread_mutex_lock(&m_queue_mutex);
   while (!m_stop) {
-    if (!m_new.empty()) {
+    if (!m_new.empty() || _rings_have_entries()) {
       pthread_mutex_unlock(&m_queue_mutex);
       flush();
       pthread_mutex_lock(&m_queue_mutex);
       continue;
     }
 
-    pthread_cond_wait(&m_cond_flusher, &m_queue_mutex);
+    // timed wait: ring submitters signal without holding the mutex, so
+    // a wakeup can slip by; the timeout bounds how long an entry can
+    // sit in a ring unnoticed
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 100000000;  // 100ms
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_nsec -= 1000000000L;
+      ts.tv_sec++;
+    }
+    pthread_cond_timedwait(&m_cond_flusher, &m_queue_mutex, &ts);
   }
   pthread_mutex_unlock(&m_queue_mutex);
   flush();
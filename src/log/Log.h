@@ -10,6 +10,7 @@
 
 #include "Entry.h"
 #include "EntryQueue.h"
+#include "EntryRing.h"
 #include "SubsystemMap.h"
 
 namespace ceph {
@@ -26,9 +27,12 @@ class Log : private Thread
   pthread_cond_t m_cond_loggers;
   pthread_cond_t m_cond_flusher;
 
-  EntryQueue m_new;    ///< new entries
+  EntryQueue m_new;    ///< new entries (fallback/backpressure path)
   EntryQueue m_recent; ///< recent (less new) entries we've already written at low detail
 
+  pthread_key_t m_ring_key;  ///< this thread's EntryRing
+  EntryRing *m_rings;        ///< all rings; guarded by m_queue_mutex
+
   std::string m_log_file;
   int m_fd;
 
@@ -41,6 +45,10 @@ class Log : private Thread
 
   void *entry();
 
+  EntryRing *_get_ring();
+  void _drain_rings(EntryQueue *q);
+  bool _rings_have_entries();
+
   void _flush(EntryQueue *q, EntryQueue *requeue, bool crash);
 
   void _log_message(const char *s, bool crash);
@@ -171,6 +171,50 @@ TEST(Log, ManyGatherLogPrebufOverflow)
   log.stop();
 }
 
+struct log_hammer_args {
+  Log *log;
+  SubsystemMap *subs;
+  int count;
+};
+
+static void *log_hammer(void *va)
+{
+  log_hammer_args *a = (log_hammer_args *)va;
+  for (int i = 0; i < a->count; i++) {
+    int l = 10;
+    if (a->subs->should_gather(1, l))
+      a->log->submit_entry(
+	new Entry(ceph_clock_now(NULL), pthread_self(), l, 1,
+		  "lock-free ring entry"));
+  }
+  return NULL;
+}
+
+TEST(Log, ManyThreads)
+{
+  SubsystemMap subs;
+  subs.add(1, "foo", 20, 10);
+  Log log(&subs);
+  log.start();
+  log.set_log_file("/tmp/big");
+  log.reopen_log_file();
+
+  const int nthreads = 8;
+  pthread_t tids[nthreads];
+  log_hammer_args args;
+  args.log = &log;
+  args.subs = &subs;
+  args.count = many / nthreads;
+  for (int i = 0; i < nthreads; i++)
+    ASSERT_EQ(0, pthread_create(&tids[i], NULL, log_hammer, &args));
+  for (int i = 0; i < nthreads; i++)
+    ASSERT_EQ(0, pthread_join(tids[i], NULL));
+
+  log.flush();
+  log.dump_recent();
+  log.stop();
+}
+
 TEST(Log, ManyGather)
 {
   SubsystemMap subs;
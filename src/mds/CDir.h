@@ -54,6 +54,7 @@ private:
   static boost::pool<> pool;
 public:
   static void *operator new(size_t num_bytes) { 
+    assert(num_bytes == sizeof(CDir));
     void *n = pool.malloc();
     if (!n)
       throw std::bad_alloc();
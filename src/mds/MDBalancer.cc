@@ -500,7 +500,7 @@ void MDBalancer::prep_rebalance(int beat)
     last_epoch_over = beat_epoch;
 
     // am i over long enough?
-    if (last_epoch_under && beat_epoch - last_epoch_under < 2) {
+    if (last_epoch_under && beat_epoch - last_epoch_under < g_conf->mds_bal_overload_epochs) {
       dout(5) << "  i am overloaded, but only for " << (beat_epoch - last_epoch_under) << " epochs" << dendl;
       return;
     }
@@ -651,7 +651,7 @@ void MDBalancer::try_rebalance()
     double amount = (*it).second;
 
     if (amount < MIN_OFFLOAD) continue;
-    if (amount / target_load < .2) continue;
+    if (amount / target_load < g_conf->mds_bal_min_start) continue;  // not worth the migration freeze/churn
 
     dout(5) << "want to send " << amount << " to mds." << target
       //<< " .. " << (*it).second << " * " << load_fac
@@ -971,6 +971,16 @@ void MDBalancer::hit_inode(utime_t now, CInode *in, int type, int who)
 
 void MDBalancer::hit_dir(utime_t now, CDir *dir, int type, int who, double amount)
 {
+  // sampled accounting?  the ancestor walk below touches counters all
+  // the way up to the subtree root on every request; only account 1 in
+  // N hits, scaled by N, so the decayed rates stay right in expectation
+  // but the per-request cost drops by N.
+  if (g_conf->mds_bal_hit_sample > 1) {
+    if (++hit_count % g_conf->mds_bal_hit_sample != 0)
+      return;
+    amount *= g_conf->mds_bal_hit_sample;
+  }
+
   // hit me
   double v = dir->pop_me.get(type).hit(now, amount);
 
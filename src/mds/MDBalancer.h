@@ -39,8 +39,10 @@ class MDBalancer {
   MDS *mds;
   int beat_epoch;
 
-  int last_epoch_under;  
-  int last_epoch_over; 
+  int last_epoch_under;
+  int last_epoch_over;
+
+  uint64_t hit_count;     // for sampled hit accounting (mds_bal_hit_sample)
 
   utime_t last_heartbeat;
   utime_t last_fragment;
@@ -77,7 +79,8 @@ public:
   MDBalancer(MDS *m) : 
     mds(m),
     beat_epoch(0),
-    last_epoch_under(0), last_epoch_over(0), my_load(0.0), target_load(0.0) { }
+    last_epoch_under(0), last_epoch_over(0), hit_count(0),
+    my_load(0.0), target_load(0.0) { }
   
   mds_load_t get_load(utime_t);
 
@@ -142,6 +142,7 @@ MDCache::MDCache(MDS *m) :
 
   num_inodes_with_caps = 0;
   num_caps = 0;
+  num_strays_purging = 0;
 
   max_dir_commit_size = g_conf->mds_dir_max_commit_size ?
                         (g_conf->mds_dir_max_commit_size << 20) :
@@ -9154,6 +9155,13 @@ void MDCache::eval_stray(CDentry *dn, bool delay)
     if (delay) {
       if (!dn->item_stray.is_on_list())
 	delayed_eval_stray.push_back(&dn->item_stray);
+    } else if (g_conf->mds_max_purge_files > 0 &&
+	       num_strays_purging >= g_conf->mds_max_purge_files) {
+      // enough rados deletes in flight already; we'll get re-evaluated
+      // as purges complete (or on the next trim)
+      dout(20) << " over mds_max_purge_files, delaying purge" << dendl;
+      if (!dn->item_stray.is_on_list())
+	delayed_eval_stray.push_back(&dn->item_stray);
     } else
       purge_stray(dn);
   }
@@ -9224,6 +9232,10 @@ void MDCache::purge_stray(CDentry *dn)
   dn->get(CDentry::PIN_PURGING);
   in->state_set(CInode::STATE_PURGING);
 
+  num_strays_purging++;
+  if (mds->logger)
+    mds->logger->set(l_mds_stray_purging, num_strays_purging);
+
   if (dn->item_stray.is_on_list())
     dn->item_stray.remove_myself();
 
@@ -9340,6 +9352,23 @@ void MDCache::_purge_stray_purged(CDentry *dn, int r)
   CInode *in = dn->get_projected_linkage()->get_inode();
   dout(10) << "_purge_stray_purged " << *dn << " " << *in << dendl;
 
+  assert(num_strays_purging > 0);
+  num_strays_purging--;
+  if (mds->logger) {
+    mds->logger->set(l_mds_stray_purging, num_strays_purging);
+    mds->logger->inc(l_mds_stray_purged);
+  }
+
+  // if the purge throttle delayed any strays, start the next one now
+  // that this one's rados deletes are done
+  if (!delayed_eval_stray.empty() &&
+      (g_conf->mds_max_purge_files <= 0 ||
+       num_strays_purging < g_conf->mds_max_purge_files)) {
+    CDentry *sdn = delayed_eval_stray.front();
+    sdn->item_stray.remove_myself();
+    eval_stray(sdn);
+  }
+
   if (in->get_num_ref() == (int)in->is_dirty() &&
       dn->get_num_ref() == (int)dn->is_dirty() + !!in->get_num_ref() + 1/*PIN_PURGING*/) {
     // kill dentry.
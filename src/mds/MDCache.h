@@ -858,6 +858,7 @@ public:
   // -- stray --
 public:
   elist<CDentry*> delayed_eval_stray;
+  int num_strays_purging;   ///< strays with rados deletes in flight
 
   void eval_stray(CDentry *dn, bool delay=false);
   void eval_remote(CDentry *dn);
@@ -328,7 +328,8 @@ void MDLog::trim(int m)
   dout(10) << "trim " 
 	   << segments.size() << " / " << max_segments << " segments, " 
 	   << num_events << " / " << max_events << " events"
-	   << ", " << expiring_segments.size() << " (" << expiring_events << ") expiring"
+	   << ", " << expiring_segments.size() << " (" << expiring_events << " ev, "
+	   << expiring_ops << " ops) expiring"
 	   << ", " << expired_segments.size() << " (" << expired_events << ") expired"
 	   << dendl;
 
@@ -353,6 +354,15 @@ void MDLog::trim(int m)
     if (num_expiring_segments >= g_conf->mds_log_max_expiring)
       break;
 
+    // back-pressure on outstanding expiry i/o, not just segment count:
+    // segments vary wildly in how much dirty state they flush.
+    if (g_conf->mds_log_max_expiring_ops > 0 &&
+	expiring_ops >= g_conf->mds_log_max_expiring_ops) {
+      dout(10) << "trim " << expiring_ops << " expiry ops in flight >= "
+	       << g_conf->mds_log_max_expiring_ops << ", waiting" << dendl;
+      break;
+    }
+
     int op_prio = CEPH_MSG_PRIO_LOW +
 		  (CEPH_MSG_PRIO_HIGH - CEPH_MSG_PRIO_LOW) *
 		  num_expiring_segments / g_conf->mds_log_max_expiring;
@@ -387,9 +397,12 @@ void MDLog::try_expire(LogSegment *ls, int op_prio)
   ls->try_to_expire(mds, gather_bld, op_prio);
   if (gather_bld.has_subs()) {
     assert(expiring_segments.count(ls) == 0);
-    expiring_segments.insert(ls);
+    int num_ops = gather_bld.num_subs_created();
+    expiring_segments[ls] = num_ops;
+    expiring_ops += num_ops;
     expiring_events += ls->num_events;
-    dout(5) << "try_expire expiring segment " << ls->offset << dendl;
+    dout(5) << "try_expire expiring segment " << ls->offset
+	    << ", " << num_ops << " ops" << dendl;
     gather_bld.set_finisher(new C_MaybeExpiredSegment(this, ls, op_prio));
     gather_bld.activate();
   } else {
@@ -404,8 +417,10 @@ void MDLog::try_expire(LogSegment *ls, int op_prio)
 void MDLog::_maybe_expired(LogSegment *ls, int op_prio)
 {
   dout(10) << "_maybe_expired segment " << ls->offset << " " << ls->num_events << " events" << dendl;
-  assert(expiring_segments.count(ls));
-  expiring_segments.erase(ls);
+  map<LogSegment*,int>::iterator q = expiring_segments.find(ls);
+  assert(q != expiring_segments.end());
+  expiring_ops -= q->second;
+  expiring_segments.erase(q);
   expiring_events -= ls->num_events;
   try_expire(ls, op_prio);
 }
@@ -822,8 +837,12 @@ void MDLog::_replay_thread()
       continue;
     assert(r);
     
-    // unpack event
+    // unpack event.  decoding is pure cpu work on a private buffer, so
+    // do it outside mds_lock; during a long replay the tick and beacon
+    // paths need the lock or we start looking laggy to the monitors.
+    mds->mds_lock.Unlock();
     LogEvent *le = LogEvent::decode(bl);
+    mds->mds_lock.Lock();
     if (!le) {
       dout(0) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
 	      << " -- unable to decode event" << dendl;
@@ -115,10 +115,11 @@ protected:
 
   // -- segments --
   map<uint64_t,LogSegment*> segments;
-  set<LogSegment*> expiring_segments;
+  map<LogSegment*,int> expiring_segments;  // segment -> outstanding expiry completions
   set<LogSegment*> expired_segments;
   int expiring_events;
   int expired_events;
+  int expiring_ops;       // total outstanding expiry completions, for back-pressure
 
   // -- subtreemaps --
   friend class ESubtreeMap;
@@ -169,6 +170,7 @@ public:
 		  already_replayed(false),
 		  recovery_thread(this),
 		  expiring_events(0), expired_events(0),
+		  expiring_ops(0),
 		  cur_event(NULL) { }		  
   ~MDLog();
 
@@ -344,6 +344,8 @@ void MDS::create_logger()
     mds_plb.add_u64_counter(l_mds_iexp, "iexp");
     mds_plb.add_u64_counter(l_mds_im, "im");
     mds_plb.add_u64_counter(l_mds_iim, "iim");
+    mds_plb.add_u64(l_mds_stray_purging, "stray_purging");
+    mds_plb.add_u64_counter(l_mds_stray_purged, "stray_purged");
     logger = mds_plb.create_perf_counters();
     g_ceph_context->get_perfcounters_collection()->add(logger);
   }
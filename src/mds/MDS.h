@@ -75,6 +75,8 @@ enum {
   l_mds_iexp,
   l_mds_im,
   l_mds_iim,
+  l_mds_stray_purging,
+  l_mds_stray_purged,
   l_mds_last,
 };
 
@@ -143,6 +145,20 @@ class AuthAuthorizeHandlerRegistry;
 
 class MDS : public Dispatcher, public md_config_obs_t {
  public:
+  /**
+   * The big MDS lock.  All dispatch, tick and journal completion work
+   * runs under this one mutex.
+   *
+   * Sharding this (e.g. per-subtree or per-dirfrag lock domains) comes
+   * up regularly as a scalability item, but it is not a local change:
+   * the inode hash, the unified LRU, the journal/segment machinery,
+   * the Locker state machines and the subtree map all span dirfrags,
+   * and every one of them would need its own consistency story before
+   * two dispatch threads could safely touch the cache concurrently.
+   * Until then, keeping per-operation work under mds_lock short (and
+   * anything expensive, like journal flushes and message encoding, off
+   * of it) is what actually buys us throughput.
+   */
   Mutex        mds_lock;
   SafeTimer    timer;
 
@@ -2875,6 +2875,29 @@ void Server::handle_client_readdir(MDRequestRef& mdr)
     // fetch
     dout(10) << " incomplete dir contents for readdir on " << *dir << ", fetching" << dendl;
     dir->fetch(new C_MDS_RetryRequest(mdcache, mdr), true);
+
+    // also prefetch sibling dirfrags.  a client listing a large
+    // fragmented directory will walk every frag in order; fetching the
+    // siblings now makes a cold listing bounded by osd parallelism
+    // instead of one fetch round trip per frag.
+    if (g_conf->mds_readdir_prefetch_frags > 0) {
+      list<frag_t> leaves;
+      diri->dirfragtree.get_leaves(leaves);
+      int n = g_conf->mds_readdir_prefetch_frags;
+      for (list<frag_t>::iterator p = leaves.begin();
+	   p != leaves.end() && n > 0;
+	   ++p) {
+	if (*p == dir->get_frag())
+	  continue;
+	CDir *sib = diri->get_or_open_dirfrag(mdcache, *p);
+	if (!sib->is_auth() || sib->is_complete() ||
+	    sib->state_test(CDir::STATE_FETCHING) || !sib->can_auth_pin())
+	  continue;
+	dout(10) << " prefetching sibling dirfrag " << *sib << dendl;
+	sib->fetch(NULL);
+	n--;
+      }
+    }
     return;
   }
 
@@ -29,6 +29,13 @@ class MOSDMap : public Message {
   map<epoch_t, bufferlist> maps;
   map<epoch_t, bufferlist> incremental_maps;
   epoch_t oldest_map, newest_map;
+  /**
+   * feature bits the map bufferlists were encoded with, or 0 if unknown.
+   * if the sender already encoded them for the target's features (see
+   * OSDMonitor's encoded-map cache), encode_payload does not need to
+   * re-encode.
+   */
+  uint64_t encode_features;
 
   epoch_t get_first() const {
     epoch_t e = 0;
@@ -56,11 +63,12 @@ class MOSDMap : public Message {
   }
 
 
-  MOSDMap() : Message(CEPH_MSG_OSD_MAP, HEAD_VERSION) { }
+  MOSDMap() : Message(CEPH_MSG_OSD_MAP, HEAD_VERSION),
+	      oldest_map(0), newest_map(0), encode_features(0) { }
   MOSDMap(const uuid_d &f, OSDMap *oc=0)
     : Message(CEPH_MSG_OSD_MAP, HEAD_VERSION),
       fsid(f),
-      oldest_map(0), newest_map(0) {
+      oldest_map(0), newest_map(0), encode_features(0) {
     if (oc)
       oc->encode(maps[oc->get_epoch()]);
   }
@@ -94,35 +102,39 @@ public:
       else if ((features & CEPH_FEATURE_OSDENC) == 0)
 	header.version = 2;  // old pg_pool_t
 
-      // reencode maps using old format
-      //
-      // FIXME: this can probably be done more efficiently higher up
-      // the stack, or maybe replaced with something that only
-      // includes the pools the client cares about.
-      for (map<epoch_t,bufferlist>::iterator p = incremental_maps.begin();
-	   p != incremental_maps.end();
-	   ++p) {
-	OSDMap::Incremental inc;
-	bufferlist::iterator q = p->second.begin();
-	inc.decode(q);
-	p->second.clear();
-	if (inc.fullmap.length()) {
-	  // embedded full map?
+      if (!encode_features) {
+	// reencode maps using old format
+	//
+	// FIXME: this can probably be done more efficiently higher up
+	// the stack, or maybe replaced with something that only
+	// includes the pools the client cares about.
+	for (map<epoch_t,bufferlist>::iterator p = incremental_maps.begin();
+	     p != incremental_maps.end();
+	     ++p) {
+	  OSDMap::Incremental inc;
+	  bufferlist::iterator q = p->second.begin();
+	  inc.decode(q);
+	  p->second.clear();
+	  if (inc.fullmap.length()) {
+	    // embedded full map?
+	    OSDMap m;
+	    m.decode(inc.fullmap);
+	    inc.fullmap.clear();
+	    m.encode(inc.fullmap, features);
+	  }
+	  inc.encode(p->second, features);
+	}
+	for (map<epoch_t,bufferlist>::iterator p = maps.begin();
+	     p != maps.end();
+	     ++p) {
 	  OSDMap m;
-	  m.decode(inc.fullmap);
-	  inc.fullmap.clear();
-	  m.encode(inc.fullmap, features);
+	  m.decode(p->second);
+	  p->second.clear();
+	  m.encode(p->second, features);
 	}
-	inc.encode(p->second, features);
-      }
-      for (map<epoch_t,bufferlist>::iterator p = maps.begin();
-	   p != maps.end();
-	   ++p) {
-	OSDMap m;
-	m.decode(p->second);
-	p->second.clear();
-	m.encode(p->second, features);
       }
+      // else: the sender already encoded the maps for our feature set
+      // (e.g. via the monitor's encoded-map cache)
     }
     ::encode(incremental_maps, payload);
     ::encode(maps, payload);
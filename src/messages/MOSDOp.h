@@ -54,6 +54,10 @@ private:
   snapid_t snap_seq;
   vector<snapid_t> snaps;
 
+  // lazily decoded tail of the payload; see finish_decode()
+  bool final_decode_needed;
+  bufferlist::iterator tail_iter;
+
 public:
   friend class MOSDOpReply;
 
@@ -91,14 +95,16 @@ public:
   utime_t get_mtime() { return mtime; }
 
   MOSDOp()
-    : Message(CEPH_MSG_OSD_OP, HEAD_VERSION, COMPAT_VERSION) { }
+    : Message(CEPH_MSG_OSD_OP, HEAD_VERSION, COMPAT_VERSION),
+      final_decode_needed(false) { }
   MOSDOp(int inc, long tid,
          object_t& _oid, object_locator_t& _oloc, pg_t _pgid, epoch_t _osdmap_epoch,
 	 int _flags)
     : Message(CEPH_MSG_OSD_OP, HEAD_VERSION, COMPAT_VERSION),
       client_inc(inc),
       osdmap_epoch(_osdmap_epoch), flags(_flags), retry_attempt(-1),
-      oid(_oid), oloc(_oloc), pgid(_pgid) {
+      oid(_oid), oloc(_oloc), pgid(_pgid),
+      final_decode_needed(false) {
     set_tid(tid);
   }
 private:
@@ -317,24 +323,48 @@ struct ceph_osd_request_head {
 
       ::decode(oid, p);
 
-      //::decode(ops, p);
-      __u16 num_ops;
-      ::decode(num_ops, p);
-      ops.resize(num_ops);
-      for (unsigned i = 0; i < num_ops; i++)
-	::decode(ops[i].op, p);
+      // defer the rest; most dropped/resent ops never need it.  leave
+      // snapid looking unset so print() stays sensible meanwhile.
+      snapid = CEPH_NOSNAP;
+      tail_iter = p;
+      final_decode_needed = true;
+      return;
+    }
 
-      ::decode(snapid, p);
-      ::decode(snap_seq, p);
-      ::decode(snaps, p);
+    OSDOp::split_osd_op_vector_in_data(ops, data);
+    final_decode_needed = false;
+  }
 
-      if (header.version >= 4)
-	::decode(retry_attempt, p);
-      else
-	retry_attempt = -1;
-    }
+  /**
+   * Decode the parts of the payload that routing doesn't need: the op
+   * vector, snap context, retry attempt, and the per-op data split.
+   * decode_payload() defers these so that ops dropped or resent during
+   * map churn never pay for them; callers must finish the decode
+   * before the encoded payload is released (OSD::handle_op does this
+   * right before clear_payload).
+   */
+  void finish_decode() {
+    if (!final_decode_needed)
+      return;
+    bufferlist::iterator p = tail_iter;
+
+    __u16 num_ops;
+    ::decode(num_ops, p);
+    ops.resize(num_ops);
+    for (unsigned i = 0; i < num_ops; i++)
+      ::decode(ops[i].op, p);
+
+    ::decode(snapid, p);
+    ::decode(snap_seq, p);
+    ::decode(snaps, p);
+
+    if (header.version >= 4)
+      ::decode(retry_attempt, p);
+    else
+      retry_attempt = -1;
 
     OSDOp::split_osd_op_vector_in_data(ops, data);
+    final_decode_needed = false;
   }
 
   void clear_buffers() {
@@ -25,22 +25,32 @@ class MOSDPGInfo : public Message {
 
   epoch_t epoch;
 
+  // lazily decoded tail of the payload; see finish_decode()
+  bool final_decode_needed;
+  bufferlist::iterator tail_iter;
+
 public:
   vector<pair<pg_notify_t,pg_interval_map_t> > pg_list;
 
   epoch_t get_epoch() { return epoch; }
 
   MOSDPGInfo()
-    : Message(MSG_OSD_PG_INFO, HEAD_VERSION, COMPAT_VERSION) {}
+    : Message(MSG_OSD_PG_INFO, HEAD_VERSION, COMPAT_VERSION),
+      final_decode_needed(false) {}
   MOSDPGInfo(version_t mv)
     : Message(MSG_OSD_PG_INFO, HEAD_VERSION, COMPAT_VERSION),
-      epoch(mv) { }
+      epoch(mv),
+      final_decode_needed(false) { }
 private:
   ~MOSDPGInfo() {}
 
 public:
   const char *get_type_name() const { return "pg_info"; }
   void print(ostream& out) const {
+    if (final_decode_needed) {
+      out << "pg_info(e" << epoch << " +undecoded)";
+      return;
+    }
     out << "pg_info(" << pg_list.size() << " pgs e" << epoch << ":";
 
     for (vector<pair<pg_notify_t,pg_interval_map_t> >::const_iterator i = pg_list.begin();
@@ -92,6 +102,23 @@ public:
     bufferlist::iterator p = payload.begin();
     ::decode(epoch, p);
 
+    // defer decoding the per-pg vectors; stale messages discarded
+    // during map churn never need them.
+    tail_iter = p;
+    final_decode_needed = true;
+  }
+
+  /**
+   * Decode the per-pg payload.  decode_payload() defers this so that
+   * messages dropped by the peer/epoch checks never pay for it;
+   * callers must finish the decode before touching pg_list
+   * (OSD::handle_pg_info does this once the message survives).
+   */
+  void finish_decode() {
+    if (!final_decode_needed)
+      return;
+    bufferlist::iterator p = tail_iter;
+
     // decode pg_info_t portion of the vector
     __u32 n;
     ::decode(n, p);
@@ -131,6 +158,7 @@ public:
 	::decode(i->first.to, p);
       }
     }
+    final_decode_needed = false;
   }
 };
 
@@ -30,6 +30,10 @@ class MOSDPGLog : public Message {
   /// queries.
   epoch_t query_epoch;
 
+  // lazily decoded tail of the payload; see finish_decode()
+  bool final_decode_needed;
+  bufferlist::iterator tail_iter;
+
 public:
   shard_id_t to;
   shard_id_t from;
@@ -42,16 +46,19 @@ public:
   spg_t get_pgid() { return spg_t(info.pgid.pgid, to); }
   epoch_t get_query_epoch() { return query_epoch; }
 
-  MOSDPGLog() : Message(MSG_OSD_PG_LOG, HEAD_VERSION, COMPAT_VERSION) { }
+  MOSDPGLog() : Message(MSG_OSD_PG_LOG, HEAD_VERSION, COMPAT_VERSION),
+		final_decode_needed(false) { }
   MOSDPGLog(shard_id_t to, shard_id_t from, version_t mv, pg_info_t& i)
     : Message(MSG_OSD_PG_LOG, HEAD_VERSION, COMPAT_VERSION),
       epoch(mv), query_epoch(mv),
+      final_decode_needed(false),
       to(to), from(from),
       info(i)  { }
   MOSDPGLog(shard_id_t to, shard_id_t from,
 	    version_t mv, pg_info_t& i, epoch_t query_epoch)
     : Message(MSG_OSD_PG_LOG, HEAD_VERSION, COMPAT_VERSION),
       epoch(mv), query_epoch(query_epoch),
+      final_decode_needed(false),
       to(to), from(from),
       info(i)  { }
 
@@ -61,6 +68,10 @@ private:
 public:
   const char *get_type_name() const { return "PGlog"; }
   void print(ostream& out) const {
+    if (final_decode_needed) {
+      out << "pg_log(epoch " << epoch << " +undecoded)";
+      return;
+    }
     out << "pg_log(" << info.pgid << " epoch " << epoch
 	<< " log " << log
 	<< " query_epoch " << query_epoch << ")";
@@ -79,6 +90,24 @@ public:
   void decode_payload() {
     bufferlist::iterator p = payload.begin();
     ::decode(epoch, p);
+
+    // defer the expensive part (info, log, missing, intervals); stale
+    // messages discarded during map churn never need it.
+    tail_iter = p;
+    final_decode_needed = true;
+  }
+
+  /**
+   * Decode everything past the routing epoch.  decode_payload() defers
+   * this so that messages dropped by the peer/epoch checks never pay
+   * for decoding a potentially large log; callers must finish the
+   * decode before using the pg fields or releasing the payload
+   * (OSD::handle_pg_log does this once the message survives).
+   */
+  void finish_decode() {
+    if (!final_decode_needed)
+      return;
+    bufferlist::iterator p = tail_iter;
     ::decode(info, p);
     log.decode(p, info.pgid.pool());
     missing.decode(p, info.pgid.pool());
@@ -95,6 +124,7 @@ public:
       to = shard_id_t::NO_SHARD;
       from = shard_id_t::NO_SHARD;
     }
+    final_decode_needed = false;
   }
 };
 
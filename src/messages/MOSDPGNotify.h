@@ -35,15 +35,24 @@ class MOSDPGNotify : public Message {
   /// queries.
   vector<pair<pg_notify_t,pg_interval_map_t> > pg_list;   // pgid -> version
 
+  // lazily decoded tail of the payload; see finish_decode()
+  bool final_decode_needed;
+  bufferlist::iterator tail_iter;
+
  public:
   version_t get_epoch() { return epoch; }
-  vector<pair<pg_notify_t,pg_interval_map_t> >& get_pg_list() { return pg_list; }
+  vector<pair<pg_notify_t,pg_interval_map_t> >& get_pg_list() {
+    assert(!final_decode_needed);
+    return pg_list;
+  }
 
   MOSDPGNotify()
-    : Message(MSG_OSD_PG_NOTIFY, HEAD_VERSION, COMPAT_VERSION) { }
+    : Message(MSG_OSD_PG_NOTIFY, HEAD_VERSION, COMPAT_VERSION),
+      final_decode_needed(false) { }
   MOSDPGNotify(epoch_t e, vector<pair<pg_notify_t,pg_interval_map_t> >& l)
     : Message(MSG_OSD_PG_NOTIFY, HEAD_VERSION, COMPAT_VERSION),
-      epoch(e) {
+      epoch(e),
+      final_decode_needed(false) {
     pg_list.swap(l);
   }
 private:
@@ -93,10 +102,27 @@ public:
     }
   }
   void decode_payload() {
-    epoch_t query_epoch;
     bufferlist::iterator p = payload.begin();
     ::decode(epoch, p);
 
+    // defer decoding the per-pg vectors; stale notifies discarded
+    // during map churn never need them.
+    tail_iter = p;
+    final_decode_needed = true;
+  }
+
+  /**
+   * Decode the per-pg payload.  decode_payload() defers this so that
+   * messages dropped by the peer/epoch checks never pay for it;
+   * callers must finish the decode before touching pg_list
+   * (OSD::handle_pg_notify does this once the message survives).
+   */
+  void finish_decode() {
+    if (!final_decode_needed)
+      return;
+    epoch_t query_epoch;
+    bufferlist::iterator p = tail_iter;
+
     // decode pg_info_t portion of the vector
     __u32 n;
     ::decode(n, p);
@@ -138,8 +164,13 @@ public:
 	::decode(i->first.to, p);
       }
     }
+    final_decode_needed = false;
   }
   void print(ostream& out) const {
+    if (final_decode_needed) {
+      out << "pg_notify(epoch " << epoch << " +undecoded)";
+      return;
+    }
     out << "pg_notify(";
     for (vector<pair<pg_notify_t,pg_interval_map_t> >::const_iterator i = pg_list.begin();
          i != pg_list.end();
@@ -25,7 +25,7 @@
 
 class MOSDSubOp : public Message {
 
-  static const int HEAD_VERSION = 10;
+  static const int HEAD_VERSION = 11;
   static const int COMPAT_VERSION = 1;
 
 public:
@@ -93,6 +93,9 @@ public:
   /// non-empty if this transaction involves a hit_set history update
   boost::optional<pg_hit_set_history_t> updated_hit_set_history;
 
+  /// client op carried CEPH_OSD_FLAG_TRACE; trace this sub op too
+  bool traced;
+
   int get_cost() const {
     if (ops.size() == 1 && ops[0].op.op == CEPH_OSD_OP_PULL)
       return ops[0].op.extent.length;
@@ -175,6 +178,10 @@ public:
     if (header.version >= 10) {
       ::decode(updated_hit_set_history, p);
     }
+    if (header.version >= 11)
+      ::decode(traced, p);
+    else
+      traced = false;
   }
 
   virtual void encode_payload(uint64_t features) {
@@ -224,10 +231,12 @@ public:
     ::encode(from, payload);
     ::encode(pgid.shard, payload);
     ::encode(updated_hit_set_history, payload);
+    ::encode(traced, payload);
   }
 
   MOSDSubOp()
-    : Message(MSG_OSD_SUBOP, HEAD_VERSION, COMPAT_VERSION) { }
+    : Message(MSG_OSD_SUBOP, HEAD_VERSION, COMPAT_VERSION),
+      traced(false) { }
   MOSDSubOp(osd_reqid_t r, pg_shard_t from,
 	    spg_t p, const hobject_t& po, bool noop_, int aw,
 	    epoch_t mape, ceph_tid_t rtid, eversion_t v)
@@ -242,7 +251,8 @@ public:
       old_exists(false), old_size(0),
       version(v),
       first(false), complete(false),
-      hobject_incorrect_pool(false) {
+      hobject_incorrect_pool(false),
+      traced(false) {
     memset(&peer_stat, 0, sizeof(peer_stat));
     set_tid(rtid);
   }
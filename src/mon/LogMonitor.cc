@@ -184,6 +184,7 @@ void LogMonitor::store_do_append(MonitorDBStore::Transaction *t,
 void LogMonitor::create_pending()
 {
   pending_log.clear();
+  pending_dup_count.clear();
   pending_summary = summary;
   dout(10) << "create_pending v " << (get_last_committed() + 1) << dendl;
 }
@@ -196,8 +197,18 @@ void LogMonitor::encode_pending(MonitorDBStore::Transaction *t)
   __u8 v = 1;
   ::encode(v, bl);
   multimap<utime_t,LogEntry>::iterator p;
-  for (p = pending_log.begin(); p != pending_log.end(); ++p)
-    p->second.encode(bl);
+  for (p = pending_log.begin(); p != pending_log.end(); ++p) {
+    LogEntry e = p->second;
+    map<pair<int,string>, unsigned>::iterator q =
+      pending_dup_count.find(make_pair((int)e.type, e.msg));
+    if (q != pending_dup_count.end() && q->second > 1) {
+      // summarize the duplicates we swallowed in prepare_log
+      ostringstream oss;
+      oss << e.msg << " (+" << (q->second - 1) << " duplicates)";
+      e.msg = oss.str();
+    }
+    e.encode(bl);
+  }
 
   put_version(t, version, bl);
   put_last_committed(t, version);
@@ -305,6 +316,20 @@ bool LogMonitor::prepare_log(MLog *m)
     dout(10) << " logging " << *p << dendl;
     if (!pending_summary.contains(p->key())) {
       pending_summary.add(*p);
+      if (g_conf->mon_log_coalesce_duplicates) {
+	pair<int,string> dupkey((int)p->type, p->msg);
+	map<pair<int,string>, unsigned>::iterator q =
+	  pending_dup_count.find(dupkey);
+	if (q != pending_dup_count.end()) {
+	  // an identical message is already pending; count it instead of
+	  // committing another copy through paxos
+	  q->second++;
+	  dout(10) << "  coalescing with pending duplicate ("
+		   << q->second << " total)" << dendl;
+	  continue;
+	}
+	pending_dup_count[dupkey] = 1;
+      }
       pending_log.insert(pair<utime_t,LogEntry>(p->stamp, *p));
     }
   }
@@ -33,6 +33,15 @@ private:
   multimap<utime_t,LogEntry> pending_log;
   LogSummary pending_summary, summary;
 
+  /**
+   * how many times each distinct (type, msg) text is pending, so that a
+   * storm of identical messages (e.g. every osd complaining about the
+   * same peer) is committed as a single entry with a count instead of
+   * hundreds of paxos-committed duplicates.  cleared along with
+   * pending_log on each new pending.
+   */
+  map<pair<int,string>, unsigned> pending_dup_count;
+
   void create_initial();
   void update_from_paxos(bool *need_bootstrap);
   void create_pending();  // prepare a new pending
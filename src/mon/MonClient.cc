@@ -89,7 +89,37 @@ MonClient::~MonClient()
 int MonClient::build_initial_monmap()
 {
   ldout(cct, 10) << "build_initial_monmap" << dendl;
-  return monmap.build_initial(cct, cerr);
+  int r = monmap.build_initial(cct, cerr);
+
+  // a monmap cached from a prior run knows every mon, not just the ones
+  // listed in the local config, so hunting can start from the full set
+  const string& path = cct->_conf->mon_client_monmap_cache;
+  if (path.empty())
+    return r;
+  MonMap cached;
+  if (cached.read(path.c_str()) < 0 || cached.size() == 0)
+    return r;
+
+  // make sure the cache is for the cluster we are pointed at: either
+  // the configured fsid matches, or the cache covers one of the
+  // configured mon addrs
+  bool same_cluster = false;
+  if (!cct->_conf->fsid.is_zero()) {
+    same_cluster = cct->_conf->fsid == cached.fsid;
+  } else {
+    for (unsigned i = 0; i < monmap.size() && !same_cluster; i++)
+      same_cluster = cached.contains(monmap.get_addr(i));
+  }
+  if (!same_cluster) {
+    ldout(cct, 10) << "ignoring cached monmap " << path
+		   << ", does not match configured cluster" << dendl;
+    return r;
+  }
+
+  ldout(cct, 10) << "using cached monmap epoch " << cached.get_epoch()
+		 << " with " << cached.size() << " mons from " << path << dendl;
+  monmap = cached;
+  return 0;
 }
 
 int MonClient::get_monmap()
@@ -324,6 +354,8 @@ void MonClient::handle_monmap(MMonMap *m)
 
   _sub_got("monmap", monmap.get_epoch());
 
+  _cache_monmap();
+
   if (!monmap.get_addr_name(cur_con->get_peer_addr(), cur_mon)) {
     ldout(cct, 10) << "mon." << cur_mon << " went away" << dendl;
     _reopen_session();  // can't find the mon we were talking to (above)
@@ -335,6 +367,20 @@ void MonClient::handle_monmap(MMonMap *m)
   m->put();
 }
 
+void MonClient::_cache_monmap()
+{
+  const string& path = cct->_conf->mon_client_monmap_cache;
+  if (path.empty())
+    return;
+  int r = monmap.write(path.c_str());
+  if (r < 0)
+    ldout(cct, 10) << "failed to cache monmap to " << path << ": "
+		   << cpp_strerror(r) << dendl;
+  else
+    ldout(cct, 10) << "cached monmap epoch " << monmap.get_epoch()
+		   << " to " << path << dendl;
+}
+
 // ----------------------
 
 int MonClient::init()
@@ -416,6 +462,7 @@ void MonClient::shutdown()
   monc_lock.Lock();
   timer.shutdown();
 
+  _drop_hunting_probes();
   messenger->mark_down(cur_con);
   cur_con.reset(NULL);
 
@@ -464,6 +511,35 @@ int MonClient::authenticate(double timeout)
 
 void MonClient::handle_auth(MAuthReply *m)
 {
+  if (!hunting_cons.empty()) {
+    ConnectionRef con = m->get_connection();
+    if (con != cur_con) {
+      bool adopted = false;
+      for (list<pair<string, ConnectionRef> >::iterator p = hunting_cons.begin();
+	   p != hunting_cons.end();
+	   ++p) {
+	if (p->second == con) {
+	  ldout(cct, 10) << "handle_auth mon." << p->first
+			 << " answered first, adopting" << dendl;
+	  messenger->mark_down(cur_con);
+	  cur_mon = p->first;
+	  cur_con = con;
+	  hunting_cons.erase(p);
+	  adopted = true;
+	  break;
+	}
+      }
+      if (!adopted) {
+	ldout(cct, 10) << "handle_auth stray reply from "
+		       << con->get_peer_addr() << dendl;
+	m->put();
+	return;
+      }
+    }
+    // one mon answered; tear down the rest of the probes
+    _drop_hunting_probes();
+  }
+
   Context *cb = NULL;
   bufferlist::iterator p = m->result_bl.begin();
   if (state == MC_STATE_NEGOTIATING) {
@@ -592,6 +668,7 @@ void MonClient::_reopen_session(int rank, string name)
     cur_mon = monmap.get_name(rank);
   }
 
+  _drop_hunting_probes();
   if (cur_con) {
     messenger->mark_down(cur_con);
   }
@@ -642,10 +719,48 @@ void MonClient::_reopen_session(int rank, string name)
   ::encode(global_id, m->auth_payload);
   _send_mon_message(m, true);
 
+  // probe additional mons in parallel.  the initial auth negotiation
+  // carries no per-session state, so we can safely send it to several
+  // mons; whichever answers first becomes the session (handle_auth)
+  // and the others are torn down.
+  unsigned parallel = cct->_conf->mon_client_hunt_parallel;
+  if (parallel > 1 && monmap.size() > 1) {
+    int start = rng() % monmap.size();
+    for (unsigned i = 0;
+	 i < monmap.size() && hunting_cons.size() + 1 < parallel;
+	 ++i) {
+      string extra = monmap.get_name((start + i) % monmap.size());
+      if (extra == cur_mon)
+	continue;
+      ConnectionRef con = messenger->get_connection(monmap.get_inst(extra));
+      ldout(cct, 10) << "also probing mon." << extra
+		     << " addr " << con->get_peer_addr() << dendl;
+      messenger->send_keepalive(con.get());
+      MAuth *ma = new MAuth;
+      ma->protocol = 0;
+      ma->monmap_epoch = monmap.get_epoch();
+      ::encode(struct_v, ma->auth_payload);
+      ::encode(auth_supported->get_supported_set(), ma->auth_payload);
+      ::encode(entity_name, ma->auth_payload);
+      ::encode(global_id, ma->auth_payload);
+      messenger->send_message(ma, con);
+      hunting_cons.push_back(make_pair(extra, con));
+    }
+  }
+
   if (!sub_have.empty())
     _renew_subs();
 }
 
+void MonClient::_drop_hunting_probes()
+{
+  assert(monc_lock.is_locked());
+  while (!hunting_cons.empty()) {
+    messenger->mark_down(hunting_cons.front().second);
+    hunting_cons.pop_front();
+  }
+}
+
 
 bool MonClient::ms_handle_reset(Connection *con)
 {
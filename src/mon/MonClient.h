@@ -153,6 +153,13 @@ private:
   // monitor session
   bool hunting;
 
+  /// extra connections probed in parallel while hunting; the first
+  /// MAuthReply wins and the rest are torn down (see handle_auth)
+  list<pair<string, ConnectionRef> > hunting_cons;
+  void _drop_hunting_probes();
+
+  void _cache_monmap();
+
   struct C_Tick : public Context {
     MonClient *monc;
     C_Tick(MonClient *m) : monc(m) {}
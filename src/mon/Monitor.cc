@@ -138,6 +138,7 @@ Monitor::Monitor(CephContext* cct_, string nm, MonitorDBStore *s,
   con_self(m ? m->get_loopback_connection() : NULL),
   lock("Monitor::lock"),
   timer(cct_, lock),
+  cmd_worker(cct_, "mon_cmd"),
   has_ever_joined(false),
   logger(NULL), cluster_logger(NULL), cluster_logger_registered(false),
   monmap(map),
@@ -588,6 +589,8 @@ int Monitor::init()
   timer.init();
   new_tick();
 
+  cmd_worker.start();
+
   // i'm ready!
   messenger->add_dispatcher_tail(this);
 
@@ -662,6 +665,8 @@ void Monitor::shutdown()
   dout(1) << "shutdown" << dendl;
   lock.Lock();
 
+  wait_for_paxos_write();
+
   state = STATE_SHUTDOWN;
 
   if (admin_hook) {
@@ -704,12 +709,31 @@ void Monitor::shutdown()
   // unlock before msgr shutdown...
   lock.Unlock();
 
+  // drain the command worker; queued contexts take the monitor lock to
+  // send their replies, so we cannot stop it while we hold the lock.
+  cmd_worker.stop();
+
   messenger->shutdown();  // last thing!  ceph_mon.cc will delete mon.
 }
 
+// block and wait for any pending paxos commit to hit disk.  any state
+// change that takes us out of the leader/peon states must do this first,
+// so that Paxos::commit_finish runs while the old quorum is still intact.
+void Monitor::wait_for_paxos_write()
+{
+  if (paxos->is_writing() || paxos->is_writing_previous()) {
+    dout(10) << __func__ << " flushing pending write" << dendl;
+    lock.Unlock();
+    store->flush();
+    lock.Lock();
+    dout(10) << __func__ << " flush complete" << dendl;
+  }
+}
+
 void Monitor::bootstrap()
 {
   dout(10) << "bootstrap" << dendl;
+  wait_for_paxos_write();
 
   sync_reset_requester();
   unregister_cluster_logger();
@@ -959,25 +983,50 @@ void Monitor::sync_start(entity_inst_t &other, bool full)
 
   sync_full = full;
 
+  pair<string,string> resume_key;
+  bool resume = false;
+
   if (sync_full) {
-    // stash key state, and mark that we are syncing
-    MonitorDBStore::Transaction t;
-    sync_stash_critical_state(&t);
-    t.put("mon_sync", "in_sync", 1);
+    // do we have usable progress from an interrupted full sync?  if so
+    // we can pick up where it left off instead of starting over; any
+    // already-synced keys that changed since are corrected by the
+    // paxos replay in sync_finish.
+    if (store->exists("mon_sync", "in_sync") &&
+	store->exists("mon_sync", "last_key") &&
+	store->exists("mon_sync", "start_version")) {
+      bufferlist lk;
+      int err = store->get("mon_sync", "last_key", lk);
+      assert(err == 0);
+      bufferlist::iterator p = lk.begin();
+      ::decode(resume_key.first, p);
+      ::decode(resume_key.second, p);
+      sync_start_version = store->get("mon_sync", "start_version");
+      resume = (sync_start_version > 0);
+    }
 
-    sync_last_committed_floor = MAX(sync_last_committed_floor, paxos->get_version());
-    dout(10) << __func__ << " marking sync in progress, storing sync_last_committed_floor "
-	     << sync_last_committed_floor << dendl;
-    t.put("mon_sync", "last_committed_floor", sync_last_committed_floor);
+    if (resume) {
+      dout(10) << __func__ << " resuming interrupted full sync from v"
+	       << sync_start_version << " after key " << resume_key << dendl;
+    } else {
+      // stash key state, and mark that we are syncing
+      MonitorDBStore::Transaction t;
+      sync_stash_critical_state(&t);
+      t.put("mon_sync", "in_sync", 1);
 
-    store->apply_transaction(t);
+      sync_last_committed_floor = MAX(sync_last_committed_floor, paxos->get_version());
+      dout(10) << __func__ << " marking sync in progress, storing sync_last_committed_floor "
+	       << sync_last_committed_floor << dendl;
+      t.put("mon_sync", "last_committed_floor", sync_last_committed_floor);
 
-    assert(g_conf->mon_sync_requester_kill_at != 1);
+      store->apply_transaction(t);
 
-    // clear the underlying store
-    set<string> targets = get_sync_targets_names();
-    dout(10) << __func__ << " clearing prefixes " << targets << dendl;
-    store->clear(targets);
+      assert(g_conf->mon_sync_requester_kill_at != 1);
+
+      // clear the underlying store
+      set<string> targets = get_sync_targets_names();
+      dout(10) << __func__ << " clearing prefixes " << targets << dendl;
+      store->clear(targets);
+    }
 
     // make sure paxos knows it has been reset.  this prevents a
     // bootstrap and then different probe reply order from possibly
@@ -994,8 +1043,16 @@ void Monitor::sync_start(entity_inst_t &other, bool full)
   sync_reset_timeout();
 
   MMonSync *m = new MMonSync(sync_full ? MMonSync::OP_GET_COOKIE_FULL : MMonSync::OP_GET_COOKIE_RECENT);
-  if (!sync_full)
+  if (!sync_full) {
     m->last_committed = paxos->get_version();
+  } else if (resume) {
+    // ask the provider to position its iterator after what we already
+    // have, and to replay paxos from our original start point.  an old
+    // provider ignores last_key and simply starts over, which is still
+    // correct, just slower.
+    m->last_committed = sync_start_version;
+    m->last_key = resume_key;
+  }
   messenger->send_message(m, sync_provider);
 }
 
@@ -1044,6 +1101,8 @@ void Monitor::sync_finish(version_t last_committed)
   t.erase("mon_sync", "in_sync");
   t.erase("mon_sync", "force_sync");
   t.erase("mon_sync", "last_committed_floor");
+  t.erase("mon_sync", "last_key");
+  t.erase("mon_sync", "start_version");
   store->apply_transaction(t);
 
   assert(g_conf->mon_sync_requester_kill_at != 9);
@@ -1136,7 +1195,26 @@ void Monitor::handle_sync_get_cookie(MMonSync *m)
   if (m->op == MMonSync::OP_GET_COOKIE_FULL) {
     // full scan
     sync_targets = get_sync_targets_names();
-    sp.last_committed = paxos->get_version();
+    if (m->last_key.first.length() || m->last_key.second.length()) {
+      // requester is resuming an interrupted full sync: position our
+      // iterator after the last key it already holds and replay paxos
+      // from its original start point, so earlier keys that changed
+      // since get corrected by its replay in sync_finish.
+      if (m->last_committed < paxos->get_first_committed() &&
+	  paxos->get_first_committed() > 1) {
+	dout(10) << __func__ << " resuming requester fell behind paxos, their lc "
+		 << m->last_committed << " < our fc "
+		 << paxos->get_first_committed() << dendl;
+	sync_providers.erase(cookie);
+	_sync_reply_no_cookie(m);
+	return;
+      }
+      sp.last_key = m->last_key;
+      sp.last_committed = m->last_committed;
+      dout(10) << __func__ << " resuming full sync after key " << sp.last_key << dendl;
+    } else {
+      sp.last_committed = paxos->get_version();
+    }
     sp.synchronizer = store->get_synchronizer(sp.last_key, sync_targets);
     sp.full = true;
     dout(10) << __func__ << " will sync prefixes " << sync_targets << dendl;
@@ -1229,8 +1307,24 @@ void Monitor::handle_sync_cookie(MMonSync *m)
   sync_cookie = m->cookie;
   sync_start_version = m->last_committed;
 
+  if (sync_full) {
+    // record where the paxos replay in sync_finish will have to start,
+    // so that an interrupted sync can be resumed
+    MonitorDBStore::Transaction t;
+    t.put("mon_sync", "start_version", sync_start_version);
+    store->apply_transaction(t);
+  }
+
   sync_reset_timeout();
-  sync_get_next_chunk();
+
+  // keep several chunk requests in flight so throughput is bounded by
+  // bandwidth rather than round trips.  the provider handles these in
+  // order, so the chunks still arrive in sequence.
+  uint32_t window = g_conf->mon_sync_max_inflight_chunks;
+  if (window < 1)
+    window = 1;
+  for (uint32_t i = 0; i < window; ++i)
+    sync_get_next_chunk();
 
   assert(g_conf->mon_sync_requester_kill_at != 3);
 }
@@ -1267,6 +1361,16 @@ void Monitor::handle_sync_chunk(MMonSync *m)
   MonitorDBStore::Transaction tx;
   tx.append_from_encoded(m->chunk_bl);
 
+  if (sync_full &&
+      (m->last_key.first.length() || m->last_key.second.length())) {
+    // persist our position atomically with the chunk so an interrupted
+    // sync can resume from here instead of starting over
+    bufferlist lk;
+    ::encode(m->last_key.first, lk);
+    ::encode(m->last_key.second, lk);
+    tx.put("mon_sync", "last_key", lk);
+  }
+
   dout(30) << __func__ << " tx dump:\n";
   JSONFormatter f(true);
   tx.dump(&f);
@@ -1304,6 +1408,18 @@ void Monitor::handle_sync_chunk(MMonSync *m)
 void Monitor::handle_sync_no_cookie(MMonSync *m)
 {
   dout(10) << __func__ << dendl;
+  if (m->cookie && m->cookie != sync_cookie) {
+    // a stale reply to one of our pipelined chunk requests from a sync
+    // that is already over; ignore it
+    dout(10) << __func__ << " stale cookie " << m->cookie << ", ignoring" << dendl;
+    return;
+  }
+  // whatever resume state we had did not work out; make sure the next
+  // attempt starts from scratch
+  MonitorDBStore::Transaction t;
+  t.erase("mon_sync", "last_key");
+  t.erase("mon_sync", "start_version");
+  store->apply_transaction(t);
   bootstrap();
 }
 
@@ -1581,6 +1697,7 @@ void Monitor::handle_probe_reply(MMonProbe *m)
 void Monitor::join_election()
 {
   dout(10) << __func__ << dendl;
+  wait_for_paxos_write();
   state = STATE_ELECTING;
   _reset();
 }
@@ -1588,6 +1705,7 @@ void Monitor::join_election()
 void Monitor::start_election()
 {
   dout(10) << "start_election" << dendl;
+  wait_for_paxos_write();
   state = STATE_ELECTING;
   _reset();
 
@@ -38,6 +38,7 @@
 #include "common/LogClient.h"
 #include "common/SimpleRNG.h"
 #include "common/cmdparse.h"
+#include "common/Finisher.h"
 
 #include "auth/cephx/CephxKeyServer.h"
 #include "auth/AuthMethodList.h"
@@ -115,7 +116,11 @@ public:
   ConnectionRef con_self;
   Mutex lock;
   SafeTimer timer;
-  
+
+  /// worker that formats replies to heavy read-only commands (e.g. 'pg
+  /// dump') from a snapshot, without holding the monitor lock
+  Finisher cmd_worker;
+
   /// true if we have ever joined a quorum.  if false, we are either a
   /// new cluster, a newly joining monitor, or a just-upgraded
   /// monitor.
@@ -538,6 +543,8 @@ private:
   void _reset();   ///< called from bootstrap, start_, or join_election
 public:
   void bootstrap();
+  void wait_for_paxos_write();
+
   void join_election();
   void start_election();
   void win_standalone_election();
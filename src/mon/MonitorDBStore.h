@@ -24,6 +24,7 @@
 #include "os/LevelDBStore.h"
 
 #include "include/assert.h"
+#include "common/Finisher.h"
 #include "common/Formatter.h"
 #include "common/errno.h"
 
@@ -33,6 +34,9 @@ class MonitorDBStore
   bool do_dump;
   int dump_fd;
 
+  Finisher io_work;
+  bool is_open;
+
  public:
 
   struct Op {
@@ -264,6 +268,39 @@ class MonitorDBStore
     return r;
   }
 
+  /**
+   * Queue a transaction to be applied by the io_work thread.
+   *
+   * The write (and the fsync that comes with it) happens off the caller's
+   * thread; @p oncommit is completed on the io_work thread once the
+   * transaction is durable.  Queued transactions are applied in the order
+   * they were queued.
+   */
+  struct C_DoTransaction : public Context {
+    MonitorDBStore *store;
+    MonitorDBStore::Transaction t;
+    Context *oncommit;
+    C_DoTransaction(MonitorDBStore *s, MonitorDBStore::Transaction& t,
+		    Context *f)
+      : store(s), t(t), oncommit(f)
+    {}
+    void finish(int r) {
+      int ret = store->apply_transaction(t);
+      oncommit->complete(ret);
+    }
+  };
+
+  void queue_transaction(MonitorDBStore::Transaction& t, Context *oncommit) {
+    io_work.queue(new C_DoTransaction(this, t, oncommit));
+  }
+
+  /**
+   * block and flush all io_work workloads
+   */
+  void flush() {
+    io_work.wait_for_empty();
+  }
+
   class StoreIteratorImpl {
   protected:
     bool done;
@@ -504,16 +541,34 @@ class MonitorDBStore
       db->options.paranoid_checks = g_conf->mon_leveldb_paranoid;
     if (g_conf->mon_leveldb_log.length())
       db->options.log_file = g_conf->mon_leveldb_log;
+    if (g_conf->mon_leveldb_compact_pause)
+      db->options.compact_pause = g_conf->mon_leveldb_compact_pause;
   }
 
   int open(ostream &out) {
     init_options();
-    return db->open(out);
+    int r = db->open(out);
+    if (r < 0)
+      return r;
+    io_work.start();
+    is_open = true;
+    return 0;
   }
 
   int create_and_open(ostream &out) {
     init_options();
-    return db->create_and_open(out);
+    int r = db->create_and_open(out);
+    if (r < 0)
+      return r;
+    io_work.start();
+    is_open = true;
+    return 0;
+  }
+
+  void close() {
+    // there should be no work queued!
+    io_work.stop();
+    is_open = false;
   }
 
   void compact() {
@@ -529,7 +584,9 @@ class MonitorDBStore
   }
 
   MonitorDBStore(const string& path) :
-    db(0), do_dump(false), dump_fd(-1) {
+    db(0), do_dump(false), dump_fd(-1),
+    io_work(g_ceph_context, "monstore"),
+    is_open(false) {
     string::const_reverse_iterator rit;
     int pos = 0;
     for (rit = path.rbegin(); rit != path.rend(); ++rit, ++pos) {
@@ -561,10 +618,14 @@ class MonitorDBStore
     }
   }
   MonitorDBStore(LevelDBStore *db_ptr) :
-    db(0), do_dump(false), dump_fd(-1) {
+    db(0), do_dump(false), dump_fd(-1),
+    io_work(g_ceph_context, "monstore"),
+    is_open(false) {
     db.reset(db_ptr);
   }
   ~MonitorDBStore() {
+    if (is_open)
+      close();
     if (do_dump)
       ::close(dump_fd);
   }
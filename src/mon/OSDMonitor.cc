@@ -635,7 +635,8 @@ void OSDMonitor::share_map_with_random_osd()
 
   dout(10) << "committed, telling random " << s->inst << " all about it" << dendl;
   // whatev, they'll request more if they need it
-  MOSDMap *m = build_incremental(osdmap.get_epoch() - 1, osdmap.get_epoch());
+  MOSDMap *m = build_incremental(osdmap.get_epoch() - 1, osdmap.get_epoch(),
+				 s->con->get_features());
   mon->messenger->send_message(m, s->inst);
 }
 
@@ -1285,8 +1286,8 @@ bool OSDMonitor::prepare_boot(MOSDBoot *m)
 	(g_conf->mon_osd_auto_mark_new_in && (oldstate & CEPH_OSD_NEW)) ||
 	(g_conf->mon_osd_auto_mark_in)) {
       if (can_mark_in(from)) {
-	if (osdmap.osd_xinfo[from].old_weight > 0)
-	  pending_inc.new_weight[from] = osdmap.osd_xinfo[from].old_weight;
+	if ((*osdmap.osd_xinfo)[from].old_weight > 0)
+	  pending_inc.new_weight[from] = (*osdmap.osd_xinfo)[from].old_weight;
 	else
 	  pending_inc.new_weight[from] = CEPH_OSD_IN;
       } else {
@@ -1629,24 +1630,127 @@ void OSDMonitor::send_latest(PaxosServiceMessage *m, epoch_t start)
 }
 
 
-MOSDMap *OSDMonitor::build_latest_full()
+uint64_t OSDMonitor::significant_osdmap_features(uint64_t features)
 {
-  MOSDMap *r = new MOSDMap(mon->monmap->fsid, &osdmap);
+  // only these bits change how an OSDMap or Incremental is encoded for
+  // the wire (see MOSDMap::encode_payload)
+  return features & (CEPH_FEATURE_PGID64 |
+		     CEPH_FEATURE_PGPOOL3 |
+		     CEPH_FEATURE_OSDENC |
+		     CEPH_FEATURE_OSDMAP_ENC);
+}
+
+void OSDMonitor::trim_encoded_map_caches()
+{
+  // keys sort by epoch first, so epochs nobody can request any more are
+  // at the front; also cap the overall size in case a mixed-feature
+  // population keeps many classes alive.
+  version_t floor = get_first_committed();
+  while (!cached_inc_bl.empty() &&
+	 (cached_inc_bl.begin()->first.first < floor ||
+	  (int)cached_inc_bl.size() > g_conf->mon_osdmap_encode_cache_size))
+    cached_inc_bl.erase(cached_inc_bl.begin());
+  while (!cached_full_bl.empty() &&
+	 (cached_full_bl.begin()->first.first < floor ||
+	  (int)cached_full_bl.size() > g_conf->mon_osdmap_encode_cache_size))
+    cached_full_bl.erase(cached_full_bl.begin());
+}
+
+int OSDMonitor::get_version(version_t ver, uint64_t features, bufferlist& bl)
+{
+  uint64_t significant = significant_osdmap_features(features);
+  if (significant == significant_osdmap_features((uint64_t)-1)) {
+    // the stored encoding is already suitable
+    return get_version(ver, bl);
+  }
+
+  pair<version_t,uint64_t> key(ver, significant);
+  map<pair<version_t,uint64_t>,bufferlist>::iterator p =
+    cached_inc_bl.find(key);
+  if (p != cached_inc_bl.end()) {
+    bl = p->second;
+    return 0;
+  }
+
+  bufferlist orig;
+  int err = get_version(ver, orig);
+  if (err < 0)
+    return err;
+
+  // re-encode for the subscriber's features, once per feature class
+  OSDMap::Incremental inc;
+  bufferlist::iterator q = orig.begin();
+  inc.decode(q);
+  if (inc.fullmap.length()) {
+    // embedded full map?
+    OSDMap m;
+    m.decode(inc.fullmap);
+    inc.fullmap.clear();
+    m.encode(inc.fullmap, features);
+  }
+  inc.encode(bl, features);
+
+  cached_inc_bl[key] = bl;
+  trim_encoded_map_caches();
+  return 0;
+}
+
+int OSDMonitor::get_version_full(version_t ver, uint64_t features,
+				 bufferlist& bl)
+{
+  uint64_t significant = significant_osdmap_features(features);
+  if (significant == significant_osdmap_features((uint64_t)-1)) {
+    // the stored encoding is already suitable
+    return get_version_full(ver, bl);
+  }
+
+  pair<version_t,uint64_t> key(ver, significant);
+  map<pair<version_t,uint64_t>,bufferlist>::iterator p =
+    cached_full_bl.find(key);
+  if (p != cached_full_bl.end()) {
+    bl = p->second;
+    return 0;
+  }
+
+  bufferlist orig;
+  int err = get_version_full(ver, orig);
+  if (err < 0)
+    return err;
+
+  OSDMap m;
+  m.decode(orig);
+  m.encode(bl, features);
+
+  cached_full_bl[key] = bl;
+  trim_encoded_map_caches();
+  return 0;
+}
+
+MOSDMap *OSDMonitor::build_latest_full(uint64_t features)
+{
+  MOSDMap *r = new MOSDMap(mon->monmap->fsid);
+  int err = get_version_full(osdmap.get_epoch(), features,
+			     r->maps[osdmap.get_epoch()]);
+  assert(err == 0);
   r->oldest_map = get_first_committed();
   r->newest_map = osdmap.get_epoch();
+  r->encode_features = features;
   return r;
 }
 
-MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to)
+MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to,
+				       uint64_t features)
 {
-  dout(10) << "build_incremental [" << from << ".." << to << "]" << dendl;
+  dout(10) << "build_incremental [" << from << ".." << to << "]"
+	   << " with features " << std::hex << features << std::dec << dendl;
   MOSDMap *m = new MOSDMap(mon->monmap->fsid);
   m->oldest_map = get_first_committed();
   m->newest_map = osdmap.get_epoch();
+  m->encode_features = features;
 
   for (epoch_t e = to; e >= from && e > 0; e--) {
     bufferlist bl;
-    int err = get_version(e, bl);
+    int err = get_version(e, features, bl);
     if (err == 0) {
       assert(bl.length());
       // if (get_version(e, bl) > 0) {
@@ -1656,7 +1760,7 @@ MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to)
     } else {
       assert(err == -ENOENT);
       assert(!bl.length());
-      get_version_full(e, bl);
+      get_version_full(e, features, bl);
       if (bl.length() > 0) {
       //else if (get_version("full", e, bl) > 0) {
       dout(20) << "build_incremental   full " << e << " "
@@ -1673,7 +1777,7 @@ MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to)
 void OSDMonitor::send_full(PaxosServiceMessage *m)
 {
   dout(5) << "send_full to " << m->get_orig_source_inst() << dendl;
-  mon->send_reply(m, build_latest_full());
+  mon->send_reply(m, build_latest_full(m->get_connection()->get_features()));
 }
 
 /* TBH, I'm fairly certain these two functions could somehow be using a single
@@ -1701,10 +1805,12 @@ void OSDMonitor::send_incremental(PaxosServiceMessage *req, epoch_t first)
     }
   }
 
+  uint64_t features = req->get_connection()->get_features();
+
   if (first < get_first_committed()) {
     first = get_first_committed();
     bufferlist bl;
-    int err = get_version_full(first, bl);
+    int err = get_version_full(first, features, bl);
     assert(err == 0);
     assert(bl.length());
 
@@ -1715,6 +1821,7 @@ void OSDMonitor::send_incremental(PaxosServiceMessage *req, epoch_t first)
     m->oldest_map = first;
     m->newest_map = osdmap.get_epoch();
     m->maps[first] = bl;
+    m->encode_features = features;
     mon->send_reply(req, m);
 
     if (osd >= 0)
@@ -1725,7 +1832,7 @@ void OSDMonitor::send_incremental(PaxosServiceMessage *req, epoch_t first)
   // send some maps.  it may not be all of them, but it will get them
   // started.
   epoch_t last = MIN(first + g_conf->osd_map_message_max, osdmap.get_epoch());
-  MOSDMap *m = build_incremental(first, last);
+  MOSDMap *m = build_incremental(first, last, features);
   m->oldest_map = get_first_committed();
   m->newest_map = osdmap.get_epoch();
   mon->send_reply(req, m);
@@ -1734,7 +1841,8 @@ void OSDMonitor::send_incremental(PaxosServiceMessage *req, epoch_t first)
     osd_epoch[osd] = last;
 }
 
-void OSDMonitor::send_incremental(epoch_t first, entity_inst_t& dest, bool onetime)
+void OSDMonitor::send_incremental(epoch_t first, entity_inst_t& dest,
+				  bool onetime, uint64_t features)
 {
   dout(5) << "send_incremental [" << first << ".." << osdmap.get_epoch() << "]"
 	  << " to " << dest << dendl;
@@ -1742,7 +1850,7 @@ void OSDMonitor::send_incremental(epoch_t first, entity_inst_t& dest, bool oneti
   if (first < get_first_committed()) {
     first = get_first_committed();
     bufferlist bl;
-    int err = get_version_full(first, bl);
+    int err = get_version_full(first, features, bl);
     assert(err == 0);
     assert(bl.length());
 
@@ -1753,13 +1861,14 @@ void OSDMonitor::send_incremental(epoch_t first, entity_inst_t& dest, bool oneti
     m->oldest_map = first;
     m->newest_map = osdmap.get_epoch();
     m->maps[first] = bl;
+    m->encode_features = features;
     mon->messenger->send_message(m, dest);
     first++;
   }
 
   while (first <= osdmap.get_epoch()) {
     epoch_t last = MIN(first + g_conf->osd_map_message_max, osdmap.get_epoch());
-    MOSDMap *m = build_incremental(first, last);
+    MOSDMap *m = build_incremental(first, last, features);
     mon->messenger->send_message(m, dest);
     first = last + 1;
     if (onetime)
@@ -1797,10 +1906,12 @@ void OSDMonitor::check_sub(Subscription *sub)
   dout(10) << __func__ << " " << sub << " next " << sub->next
 	   << (sub->onetime ? " (onetime)":" (ongoing)") << dendl;
   if (sub->next <= osdmap.get_epoch()) {
+    uint64_t features = sub->session->con->get_features();
     if (sub->next >= 1)
-      send_incremental(sub->next, sub->session->inst, sub->incremental_onetime);
+      send_incremental(sub->next, sub->session->inst,
+		       sub->incremental_onetime, features);
     else
-      mon->messenger->send_message(build_latest_full(),
+      mon->messenger->send_message(build_latest_full(features),
 				   sub->session->inst);
     if (sub->onetime)
       mon->session_map.remove_sub(sub);
@@ -1889,8 +2000,8 @@ void OSDMonitor::tick()
 
 	  // remember previous weight
 	  if (pending_inc.new_xinfo.count(o) == 0)
-	    pending_inc.new_xinfo[o] = osdmap.osd_xinfo[o];
-	  pending_inc.new_xinfo[o].old_weight = osdmap.osd_weight[o];
+	    pending_inc.new_xinfo[o] = (*osdmap.osd_xinfo)[o];
+	  pending_inc.new_xinfo[o].old_weight = (*osdmap.osd_weight)[o];
 
 	  do_propose = true;
 	
@@ -2126,6 +2237,45 @@ void OSDMonitor::dump_info(Formatter *f)
   f->close_section();
 }
 
+/**
+ * decode and format an 'osd dump' reply on the command worker thread.
+ * the encoded full map is our snapshot; we only retake the monitor
+ * lock to send the reply.
+ */
+struct C_DumpOSDMap : public Context {
+  Monitor *mon;
+  MMonCommand *m;
+  bufferlist map_bl;   ///< encoded full map for the requested epoch
+  string format;
+  version_t version;
+  C_DumpOSDMap(Monitor *mon_, MMonCommand *m_, bufferlist& bl,
+	       const string& format_, version_t v)
+    : mon(mon_), m(m_), map_bl(bl), format(format_), version(v) {}
+  void finish(int r) {
+    OSDMap p;
+    p.decode(map_bl);
+    stringstream ds;
+    boost::scoped_ptr<Formatter> f(new_formatter(format));
+    if (f) {
+      f->open_object_section("osdmap");
+      p.dump(f.get());
+      f->close_section();
+      f->flush(ds);
+    } else {
+      p.print(ds);
+    }
+    bufferlist rdata;
+    rdata.append(ds);
+
+    Mutex::Locker l(mon->lock);
+    if (mon->is_shutdown()) {
+      m->put();
+      return;
+    }
+    mon->reply_command(m, 0, "", rdata, version);
+  }
+};
+
 bool OSDMonitor::preprocess_command(MMonCommand *m)
 {
   int r = 0;
@@ -2159,8 +2309,31 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
     else
       rdata.append(ds);
   }
-  else if (prefix == "osd dump" ||
-	   prefix == "osd tree" ||
+  else if (prefix == "osd dump") {
+    epoch_t epoch = 0;
+    int64_t epochnum;
+    cmd_getval(g_ceph_context, cmdmap, "epoch", epochnum, (int64_t)0);
+    epoch = epochnum;
+    if (!epoch)
+      epoch = osdmap.get_epoch();
+
+    bufferlist b;
+    int err = get_version_full(epoch, b);
+    if (err == -ENOENT) {
+      r = -ENOENT;
+      ss << "there is no map for epoch " << epoch;
+      goto reply;
+    }
+    assert(err == 0);
+    assert(b.length());
+
+    // decode and format on the worker thread so we do not hold the
+    // monitor lock while generating the dump
+    mon->cmd_worker.queue(new C_DumpOSDMap(mon, m, b, format,
+					   get_last_committed()));
+    return true;
+  }
+  else if (prefix == "osd tree" ||
 	   prefix == "osd ls" ||
 	   prefix == "osd getmap" ||
 	   prefix == "osd getcrushmap" ||
@@ -2186,20 +2359,7 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
       p = new OSDMap;
       p->decode(b);
     }
-    if (prefix == "osd dump") {
-      stringstream ds;
-      if (f) {
-	f->open_object_section("osdmap");
-	p->dump(f.get());
-	f->close_section();
-	f->flush(ds);
-      } else {
-	p->print(ds);
-      } 
-      rdata.append(ds);
-      if (!f)
-	ds << " ";
-    } else if (prefix == "osd ls") {
+    if (prefix == "osd ls") {
       if (f) {
 	f->open_array_section("osds");
 	for (int i = 0; i < osdmap.get_max_osd(); i++) {
@@ -2483,10 +2643,15 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
 	f->dump_int("hit_set_period", p->hit_set_period);
       } else if (var == "hit_set_count") {
 	f->dump_int("hit_set_count", p->hit_set_count);
+      } else if (var == "rate_limit_iops") {
+	f->dump_int("rate_limit_iops", p->rate_limit_iops);
+      } else if (var == "rate_limit_bps") {
+	f->dump_int("rate_limit_bps", p->rate_limit_bps);
       } else if (var == "hit_set_type") {
 	f->dump_string("hit_set_type", HitSet::get_type_name(p->hit_set_params.get_type()));
       } else if (var == "hit_set_fpp") {
-	if (p->hit_set_params.get_type() != HitSet::TYPE_BLOOM) {
+	if (p->hit_set_params.get_type() != HitSet::TYPE_BLOOM &&
+	    p->hit_set_params.get_type() != HitSet::TYPE_BLOCKED_BLOOM) {
 	  f->close_section();
 	  ss << "hit set is no of type Bloom; invalid to get a false positive rate!";
 	  r = -EINVAL;
@@ -2518,10 +2683,15 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
 	ss << "hit_set_period: " << p->hit_set_period;
       } else if (var == "hit_set_count") {
 	ss << "hit_set_count: " << p->hit_set_count;
+      } else if (var == "rate_limit_iops") {
+	ss << "rate_limit_iops: " << p->rate_limit_iops;
+      } else if (var == "rate_limit_bps") {
+	ss << "rate_limit_bps: " << p->rate_limit_bps;
       } else if (var == "hit_set_type") {
 	ss << "hit_set_type: " <<  HitSet::get_type_name(p->hit_set_params.get_type());
       } else if (var == "hit_set_fpp") {
-	if (p->hit_set_params.get_type() != HitSet::TYPE_BLOOM) {
+	if (p->hit_set_params.get_type() != HitSet::TYPE_BLOOM &&
+	    p->hit_set_params.get_type() != HitSet::TYPE_BLOCKED_BLOOM) {
 	  ss << "hit set is no of type Bloom; invalid to get a false positive rate!";
 	  r = -EINVAL;
 	  goto reply;
@@ -3398,10 +3568,13 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
 	 << ')';
       return -E2BIG;
     }
-    for(set<pg_t>::iterator i = mon->pgmon()->pg_map.creating_pgs.begin();
-	i != mon->pgmon()->pg_map.creating_pgs.end();
-	++i) {
-      if (i->m_pool == static_cast<uint64_t>(pool)) {
+    // creating_pgs sorts by pool, so one probe tells us whether any
+    // pg of this pool is still being created
+    {
+      set<pg_t>::iterator i =
+	mon->pgmon()->pg_map.creating_pgs.lower_bound(pg_t(0, pool, -1));
+      if (i != mon->pgmon()->pg_map.creating_pgs.end() &&
+	  i->m_pool == static_cast<uint64_t>(pool)) {
 	ss << "currently creating pgs, wait";
 	return -EBUSY;
       }
@@ -3420,10 +3593,13 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
       ss << "specified pgp_num " << n << " > pg_num " << p.get_pg_num();
       return -EINVAL;
     }
-    for(set<pg_t>::iterator i = mon->pgmon()->pg_map.creating_pgs.begin();
-	i != mon->pgmon()->pg_map.creating_pgs.end();
-	++i) {
-      if (i->m_pool == static_cast<uint64_t>(pool)) {
+    // creating_pgs sorts by pool, so one probe tells us whether any
+    // pg of this pool is still being created
+    {
+      set<pg_t>::iterator i =
+	mon->pgmon()->pg_map.creating_pgs.lower_bound(pg_t(0, pool, -1));
+      if (i != mon->pgmon()->pg_map.creating_pgs.end() &&
+	  i->m_pool == static_cast<uint64_t>(pool)) {
 	ss << "currently creating pgs, wait";
 	return -EBUSY;
       }
@@ -3449,6 +3625,15 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
       ss << "expecting value 'true', 'false', '0', or '1'";
       return -EINVAL;
     }
+  } else if (var == "balance_reads") {
+    if (val == "true" || (interr.empty() && n == 1)) {
+      p.flags |= pg_pool_t::FLAG_BALANCE_READS;
+    } else if (val == "false" || (interr.empty() && n == 0)) {
+      p.flags &= ~pg_pool_t::FLAG_BALANCE_READS;
+    } else {
+      ss << "expecting value 'true', 'false', '0', or '1'";
+      return -EINVAL;
+    }
   } else if (var == "hit_set_type") {
     if (val == "none")
       p.hit_set_params = HitSet::Params();
@@ -3460,6 +3645,10 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
 	BloomHitSet::Params *bsp = new BloomHitSet::Params;
 	bsp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
 	p.hit_set_params = HitSet::Params(bsp);
+      } else if (val == "blocked_bloom") {
+	BlockedBloomHitSet::Params *bsp = new BlockedBloomHitSet::Params;
+	bsp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
+	p.hit_set_params = HitSet::Params(bsp);
       } else if (val == "explicit_hash")
 	p.hit_set_params = HitSet::Params(new ExplicitHashHitSet::Params);
       else if (val == "explicit_object")
@@ -3486,10 +3675,12 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
       ss << "error parsing floating point value '" << val << "': " << floaterr;
       return -EINVAL;
     }
-    if (p.hit_set_params.get_type() != HitSet::TYPE_BLOOM) {
+    if (p.hit_set_params.get_type() != HitSet::TYPE_BLOOM &&
+	p.hit_set_params.get_type() != HitSet::TYPE_BLOCKED_BLOOM) {
       ss << "hit set is not of type Bloom; invalid to set a false positive rate!";
       return -EINVAL;
     }
+    // the blocked bloom params derive from the bloom params
     BloomHitSet::Params *bloomp = static_cast<BloomHitSet::Params*>(p.hit_set_params.impl.get());
     bloomp->set_fpp(f);
   } else if (var == "debug_fake_ec_pool") {
@@ -3540,6 +3731,18 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
       return -EINVAL;
     }
     p.cache_min_evict_age = n;
+  } else if (var == "rate_limit_iops") {
+    if (interr.length()) {
+      ss << "error parsing int '" << val << "': " << interr;
+      return -EINVAL;
+    }
+    p.rate_limit_iops = n;
+  } else if (var == "rate_limit_bps") {
+    if (interr.length()) {
+      ss << "error parsing int '" << val << "': " << interr;
+      return -EINVAL;
+    }
+    p.rate_limit_bps = n;
   } else {
     ss << "unrecognized variable '" << var << "'";
     return -EINVAL;
@@ -5285,6 +5488,10 @@ done:
       BloomHitSet::Params *bsp = new BloomHitSet::Params;
       bsp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
       hsp = HitSet::Params(bsp);
+    } else if (g_conf->osd_tier_default_cache_hit_set_type == "blocked_bloom") {
+      BlockedBloomHitSet::Params *bsp = new BlockedBloomHitSet::Params;
+      bsp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
+      hsp = HitSet::Params(bsp);
     } else if (g_conf->osd_tier_default_cache_hit_set_type == "explicit_hash") {
       hsp = HitSet::Params(new ExplicitHashHitSet::Params);
     }
@@ -204,11 +204,31 @@ private:
   bool can_mark_in(int o);
 
   // ...
-  MOSDMap *build_latest_full();
-  MOSDMap *build_incremental(epoch_t first, epoch_t last);
+  /**
+   * cache of map bufferlists re-encoded for subscribers that lack some of
+   * the significant encoding features, keyed by (epoch, significant
+   * feature bits).  during a map storm each epoch is re-encoded once per
+   * feature class instead of once per client.
+   */
+  map<pair<version_t,uint64_t>, bufferlist> cached_inc_bl;
+  map<pair<version_t,uint64_t>, bufferlist> cached_full_bl;
+
+  static uint64_t significant_osdmap_features(uint64_t features);
+  void trim_encoded_map_caches();
+
+public:
+  using PaxosService::get_version;
+  using PaxosService::get_version_full;
+  int get_version(version_t ver, uint64_t features, bufferlist& bl);
+  int get_version_full(version_t ver, uint64_t features, bufferlist& bl);
+private:
+
+  MOSDMap *build_latest_full(uint64_t features);
+  MOSDMap *build_incremental(epoch_t first, epoch_t last, uint64_t features);
   void send_full(PaxosServiceMessage *m);
   void send_incremental(PaxosServiceMessage *m, epoch_t first);
-  void send_incremental(epoch_t first, entity_inst_t& dest, bool onetime);
+  void send_incremental(epoch_t first, entity_inst_t& dest, bool onetime,
+			uint64_t features);
 
   int reweight_by_utilization(int oload, std::string& out_str);
 
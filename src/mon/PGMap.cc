@@ -271,6 +271,10 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
     const pg_t &removed_pg(*p);
     ceph::unordered_map<pg_t,pg_stat_t>::iterator s = pg_stat.find(removed_pg);
     if (s != pg_stat.end()) {
+      // this pg may have been holding the min up
+      if (min_last_epoch_clean &&
+	  s->second.get_effective_last_epoch_clean() == min_last_epoch_clean)
+	min_last_epoch_clean = 0;
       stat_pg_sub(removed_pg, s->second);
       pg_stat.erase(s);
     }
@@ -292,6 +296,13 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
       stat_osd_sub(t->second);
       osd_stat.erase(t);
     }
+    ceph::unordered_map<int32_t,epoch_t>::iterator i = osd_epochs.find(*p);
+    if (i != osd_epochs.end()) {
+      // this osd may have been holding the min up
+      if (min_last_epoch_clean && i->second == min_last_epoch_clean)
+	min_last_epoch_clean = 0;
+      osd_epochs.erase(i);
+    }
 
     // remove these old osds from full/nearfull set(s), too
     nearfull_osds.erase(*p);
@@ -318,7 +329,10 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
   if (inc.pg_scan)
     last_pg_scan = inc.pg_scan;
 
-  min_last_epoch_clean = 0;  // invalidate
+  // note: min_last_epoch_clean is invalidated above, as we go, only if
+  // an update or removal may actually have moved it; that way a stats
+  // batch does not force get_min_last_epoch_clean() to rescan the
+  // entire map.
 }
 
 void PGMap::redo_full_sets()
@@ -359,6 +373,9 @@ void PGMap::calc_stats()
   pg_pool_sum.clear();
   pg_sum = pool_stat_t();
   osd_sum = osd_stat_t();
+  inactive_pgs.clear();
+  unclean_pgs.clear();
+  stale_pgs.clear();
 
   for (ceph::unordered_map<pg_t,pg_stat_t>::iterator p = pg_stat.begin();
        p != pg_stat.end();
@@ -428,6 +445,14 @@ void PGMap::stat_pg_add(const pg_t &pgid, const pg_stat_t &s)
   num_pg_by_state[s.state]++;
   pg_pool_sum[pgid.pool()].add(s);
   pg_sum.add(s);
+
+  if ((s.state & PG_STATE_ACTIVE) == 0)
+    inactive_pgs.insert(pgid);
+  if ((s.state & PG_STATE_CLEAN) == 0)
+    unclean_pgs.insert(pgid);
+  if (s.state & PG_STATE_STALE)
+    stale_pgs.insert(pgid);
+
   if (s.state & PG_STATE_CREATING) {
     creating_pgs.insert(pgid);
     if (s.acting_primary >= 0)
@@ -447,6 +472,14 @@ void PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s)
     pg_pool_sum.erase(pgid.pool());
 
   pg_sum.sub(s);
+
+  if ((s.state & PG_STATE_ACTIVE) == 0)
+    inactive_pgs.erase(pgid);
+  if ((s.state & PG_STATE_CLEAN) == 0)
+    unclean_pgs.erase(pgid);
+  if (s.state & PG_STATE_STALE)
+    stale_pgs.erase(pgid);
+
   if (s.state & PG_STATE_CREATING) {
     creating_pgs.erase(pgid);
     if (s.acting_primary >= 0) {
@@ -740,28 +773,39 @@ void PGMap::dump(ostream& ss) const
 void PGMap::get_stuck_stats(PGMap::StuckPG type, utime_t cutoff,
 			    ceph::unordered_map<pg_t, pg_stat_t>& stuck_pgs) const
 {
-  for (ceph::unordered_map<pg_t, pg_stat_t>::const_iterator i = pg_stat.begin();
-       i != pg_stat.end();
-       ++i) {
+  // only look at the candidate set for this type; anything else cannot
+  // possibly be stuck.
+  const set<pg_t> *candidates = 0;
+  switch (type) {
+  case STUCK_INACTIVE:
+    candidates = &inactive_pgs;
+    break;
+  case STUCK_UNCLEAN:
+    candidates = &unclean_pgs;
+    break;
+  case STUCK_STALE:
+    candidates = &stale_pgs;
+    break;
+  default:
+    assert(0 == "invalid type");
+  }
+
+  for (set<pg_t>::const_iterator p = candidates->begin();
+       p != candidates->end();
+       ++p) {
+    ceph::unordered_map<pg_t, pg_stat_t>::const_iterator i = pg_stat.find(*p);
+    assert(i != pg_stat.end());
     utime_t val;
     switch (type) {
     case STUCK_INACTIVE:
-      if (i->second.state & PG_STATE_ACTIVE)
-	continue;
       val = i->second.last_active;
       break;
     case STUCK_UNCLEAN:
-      if (i->second.state & PG_STATE_CLEAN)
-	continue;
       val = i->second.last_clean;
       break;
-    case STUCK_STALE:
-      if ((i->second.state & PG_STATE_STALE) == 0)
-	continue;
+    default:
       val = i->second.last_unstale;
       break;
-    default:
-      assert(0 == "invalid type");
     }
 
     if (val < cutoff) {
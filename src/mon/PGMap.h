@@ -107,6 +107,13 @@ public:
   osd_stat_t osd_sum;
   mutable epoch_t min_last_epoch_clean;
 
+  // candidate sets for get_stuck_stats(), maintained by
+  // stat_pg_add/stat_pg_sub so we do not have to scan every pg on each
+  // health check
+  set<pg_t> inactive_pgs;   // !PG_STATE_ACTIVE
+  set<pg_t> unclean_pgs;    // !PG_STATE_CLEAN
+  set<pg_t> stale_pgs;      // PG_STATE_STALE
+
   utime_t stamp;
 
   // recent deltas, and summation
@@ -1040,19 +1040,32 @@ bool PGMonitor::register_new_pgs()
     }
   }
 
-  // deleted pools?
-  for (ceph::unordered_map<pg_t,pg_stat_t>::const_iterator p = pg_map.pg_stat.begin();
-       p != pg_map.pg_stat.end(); ++p) {
-    if (!osdmap->have_pg_pool(p->first.pool())) {
-      dout(20) << " removing pg_stat " << p->first << " because "
-	       << "containing pool deleted" << dendl;
-      pending_inc.pg_remove.insert(p->first);
-      ++removed;
+  // deleted pools?  detecting one only takes the per-pool sums; only
+  // walk the full pg_stat table (which can be huge) when a pool has
+  // actually gone away.
+  bool pool_deleted = false;
+  for (ceph::unordered_map<int,pool_stat_t>::const_iterator p =
+	 pg_map.pg_pool_sum.begin();
+       p != pg_map.pg_pool_sum.end(); ++p) {
+    if (!osdmap->have_pg_pool(p->first)) {
+      pool_deleted = true;
+      break;
     }
-    if (p->first.preferred() >= 0) {
-      dout(20) << " removing localized pg " << p->first << dendl;
-      pending_inc.pg_remove.insert(p->first);
-      ++removed;
+  }
+  if (pool_deleted) {
+    for (ceph::unordered_map<pg_t,pg_stat_t>::const_iterator p = pg_map.pg_stat.begin();
+	 p != pg_map.pg_stat.end(); ++p) {
+      if (!osdmap->have_pg_pool(p->first.pool())) {
+	dout(20) << " removing pg_stat " << p->first << " because "
+		 << "containing pool deleted" << dendl;
+	pending_inc.pg_remove.insert(p->first);
+	++removed;
+      }
+      if (p->first.preferred() >= 0) {
+	dout(20) << " removing localized pg " << p->first << dendl;
+	pending_inc.pg_remove.insert(p->first);
+	++removed;
+      }
     }
   }
 
@@ -1076,23 +1089,32 @@ void PGMonitor::map_pg_creates()
   dout(10) << "map_pg_creates to " << pg_map.creating_pgs.size() << " pgs osdmap epoch " << osdmap->get_epoch() << dendl;
   last_map_pg_create_osd_epoch = osdmap->get_epoch();
 
+  // place all creating pgs in one batch so each pool's crush rule is
+  // looked up and executed once instead of per pg
+  vector<pg_t> pgids, on;
+  pgids.reserve(pg_map.creating_pgs.size());
+  on.reserve(pg_map.creating_pgs.size());
   for (set<pg_t>::iterator p = pg_map.creating_pgs.begin();
        p != pg_map.creating_pgs.end();
        ++p) {
-    pg_t pgid = *p;
-    pg_t on = pgid;
+    pgids.push_back(*p);
+    pg_stat_t& s = pg_map.pg_stat[*p];
+    on.push_back(s.parent_split_bits ? s.parent : *p);
+  }
+
+  vector<vector<int> > ups, actings;
+  vector<int> up_primaries, acting_primaries;
+  osdmap->pg_to_up_acting_osds_batch(on, &ups, &up_primaries,
+				     &actings, &acting_primaries);
+
+  for (unsigned i = 0; i < pgids.size(); ++i) {
+    pg_t pgid = pgids[i];
     pg_stat_t& s = pg_map.pg_stat[pgid];
-    if (s.parent_split_bits)
-      on = s.parent;
 
-    vector<int> up, acting;
-    int up_primary, acting_primary;
-    osdmap->pg_to_up_acting_osds(
-      on,
-      &up,
-      &up_primary,
-      &acting,
-      &acting_primary);
+    vector<int>& up = ups[i];
+    vector<int>& acting = actings[i];
+    int up_primary = up_primaries[i];
+    int acting_primary = acting_primaries[i];
 
     if (s.acting_primary != -1) {
       pg_map.creating_pgs_by_osd[s.acting_primary].erase(pgid);
@@ -1421,6 +1443,72 @@ void PGMonitor::dump_info(Formatter *f)
   f->dump_unsigned("pgmap_last_committed", get_last_committed());
 }
 
+/**
+ * format a 'pg dump' reply from a private snapshot of the PGMap on the
+ * command worker thread, so we do not hold the monitor lock while
+ * generating what can be many MB of output.
+ */
+struct C_DumpPGMap : public Context {
+  Monitor *mon;
+  MMonCommand *m;
+  PGMap pg_map;        ///< our snapshot
+  set<string> what;
+  string format;
+  version_t version;
+  C_DumpPGMap(Monitor *mon_, MMonCommand *m_, const PGMap& map,
+	      const set<string>& what_, const string& format_, version_t v)
+    : mon(mon_), m(m_), pg_map(map), what(what_), format(format_), version(v) {}
+  void finish(int r) {
+    stringstream ss, ds;
+    bufferlist rdata;
+    // the stream variant appends to rdata in chunks instead of building
+    // the whole dump in one contiguous string
+    boost::scoped_ptr<Formatter> f(new_stream_formatter(format));
+    if (f) {
+      if (what.count("all")) {
+	f->open_object_section("pg_map");
+	pg_map.dump(f.get());
+	f->close_section();
+      } else if (what.count("summary") || what.count("sum")) {
+	f->open_object_section("pg_map");
+	pg_map.dump_basic(f.get());
+	f->close_section();
+      } else {
+	if (what.count("pools")) {
+	  pg_map.dump_pool_stats(f.get());
+	}
+	if (what.count("osds")) {
+	  pg_map.dump_osd_stats(f.get());
+	}
+	if (what.count("pgs")) {
+	  pg_map.dump_pg_stats(f.get(), false);
+	}
+	if (what.count("pgs_brief")) {
+	  pg_map.dump_pg_stats(f.get(), true);
+	}
+	if (what.count("delta")) {
+	  f->open_object_section("delta");
+	  pg_map.dump_delta(f.get());
+	  f->close_section();
+	}
+      }
+      f->flush(rdata);
+    } else {
+      // plain format ignores dumpcontents
+      pg_map.dump(ds);
+      rdata.append(ds);
+    }
+    ss << "dumped " << what << " in format " << format;
+
+    Mutex::Locker l(mon->lock);
+    if (mon->is_shutdown()) {
+      m->put();
+      return;
+    }
+    mon->reply_command(m, 0, ss.str(), rdata, version);
+  }
+};
+
 bool PGMonitor::preprocess_command(MMonCommand *m)
 {
   int r = -1;
@@ -1495,46 +1583,11 @@ bool PGMonitor::preprocess_command(MMonCommand *m)
     }
     if (what.empty())
       what.insert("all");
-    if (f) {
-      vector<string> dumpcontents;
-      if (cmd_getval(g_ceph_context, cmdmap, "dumpcontents", dumpcontents)) {
-	copy(dumpcontents.begin(), dumpcontents.end(),
-	     inserter(what, what.end()));
-      }
-      if (what.count("all")) {
-	f->open_object_section("pg_map");
-	pg_map.dump(f.get());
-	f->close_section();
-      } else if (what.count("summary") || what.count("sum")) {
-	f->open_object_section("pg_map");
-	pg_map.dump_basic(f.get());
-	f->close_section();
-      } else {
-	if (what.count("pools")) {
-	  pg_map.dump_pool_stats(f.get());
-	}
-	if (what.count("osds")) {
-	  pg_map.dump_osd_stats(f.get());
-	}
-	if (what.count("pgs")) {
-	  pg_map.dump_pg_stats(f.get(), false);
-	}
-	if (what.count("pgs_brief")) {
-	  pg_map.dump_pg_stats(f.get(), true);
-	}
-	if (what.count("delta")) {
-	  f->open_object_section("delta");
-	  pg_map.dump_delta(f.get());
-	  f->close_section();
-	}
-      }
-      f->flush(ds);
-    } else {
-      // plain format ignores dumpcontents
-      pg_map.dump(ds);
-    }
-    ss << "dumped " << what << " in format " << format;
-    r = 0;
+    // snapshot the pg_map and format the reply on the worker thread;
+    // the copy is cheap relative to stalling paxos for the dump.
+    mon->cmd_worker.queue(new C_DumpPGMap(mon, m, pg_map, what, format,
+					  get_last_committed()));
+    return true;
   } else if (prefix == "pg dump_stuck") {
     vector<string> stuckop_vec;
     cmd_getval(g_ceph_context, cmdmap, "stuckops", stuckop_vec);
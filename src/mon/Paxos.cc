@@ -579,16 +579,7 @@ void Paxos::begin(bufferlist& v)
 
   if (mon->get_quorum().size() == 1) {
     // we're alone, take it easy
-    commit();
-    if (do_refresh()) {
-      assert(is_updating());  // we can't be updating-previous with quorum of 1
-      commit_proposal();
-      finish_round();
-      finish_contexts(g_ceph_context, waiting_for_active);
-      finish_contexts(g_ceph_context, waiting_for_commit);
-      finish_contexts(g_ceph_context, waiting_for_readable);
-      finish_contexts(g_ceph_context, waiting_for_writeable);
-    }
+    commit_start();
     return;
   }
 
@@ -699,28 +690,7 @@ void Paxos::handle_accept(MMonPaxos *accept)
   if (accepted == mon->get_quorum()) {
     // yay, commit!
     dout(10) << " got majority, committing, done with update" << dendl;
-    commit();
-    if (!do_refresh())
-      goto out;
-    if (is_updating())
-      commit_proposal();
-    finish_contexts(g_ceph_context, waiting_for_commit);
-
-    // cancel timeout event
-    mon->timer.cancel_event(accept_timeout_event);
-    accept_timeout_event = 0;
-
-    // yay!
-    extend_lease();
-
-    assert(g_conf->paxos_kill_at != 10);
-
-    finish_round();
-
-    // wake people up
-    finish_contexts(g_ceph_context, waiting_for_active);
-    finish_contexts(g_ceph_context, waiting_for_readable);
-    finish_contexts(g_ceph_context, waiting_for_writeable);
+    commit_start();
   }
 
  out:
@@ -732,27 +702,28 @@ void Paxos::accept_timeout()
   dout(1) << "accept timeout, calling fresh election" << dendl;
   accept_timeout_event = 0;
   assert(mon->is_leader());
-  assert(is_updating() || is_updating_previous());
+  assert(is_updating() || is_updating_previous() ||
+	 is_writing() || is_writing_previous());
   mon->bootstrap();
 }
 
-void Paxos::commit()
+void Paxos::C_Committed::finish(int r)
 {
-  dout(10) << "commit " << last_committed+1 << dendl;
+  assert(r >= 0);
+  Mutex::Locker l(paxos->mon->lock);
+  paxos->commit_finish();
+}
 
-  // cancel lease - it was for the old value.
-  //  (this would only happen if message layer lost the 'begin', but
-  //   leader still got a majority and committed with out us.)
-  lease_expire = utime_t();  // cancel lease
+void Paxos::commit_start()
+{
+  dout(10) << __func__ << " " << (last_committed+1) << dendl;
 
   assert(g_conf->paxos_kill_at != 7);
 
   MonitorDBStore::Transaction t;
 
   // commit locally
-  last_committed++;
-  last_commit_time = ceph_clock_now(g_ceph_context);
-  t.put(get_name(), "last_committed", last_committed);
+  t.put(get_name(), "last_committed", last_committed + 1);
 
   // decode the value and apply its transaction to the store.
   // this value can now be read from last_committed.
@@ -764,10 +735,30 @@ void Paxos::commit()
   f.flush(*_dout);
   *_dout << dendl;
 
-  get_store()->apply_transaction(t);
+  get_store()->queue_transaction(t, new C_Committed(this));
+
+  if (is_updating_previous())
+    state = STATE_WRITING_PREVIOUS;
+  else if (is_updating())
+    state = STATE_WRITING;
+  else
+    assert(0);
+}
+
+void Paxos::commit_finish()
+{
+  dout(20) << __func__ << " " << (last_committed+1) << dendl;
 
   assert(g_conf->paxos_kill_at != 8);
 
+  // cancel lease - it was for the old value.
+  //  (this would only happen if message layer lost the 'begin', but
+  //   leader still got a majority and committed with out us.)
+  lease_expire = utime_t();  // cancel lease
+
+  last_committed++;
+  last_commit_time = ceph_clock_now(g_ceph_context);
+
   // refresh first_committed; this txn may have trimmed.
   first_committed = get_store()->get(get_name(), "first_committed");
 
@@ -795,6 +786,37 @@ void Paxos::commit()
   new_value.clear();
 
   remove_legacy_versions();
+
+  // cancel the accept timeout; the round is committed.  there is no
+  // event to cancel if we were alone in the quorum.
+  if (accept_timeout_event) {
+    mon->timer.cancel_event(accept_timeout_event);
+    accept_timeout_event = 0;
+  }
+
+  // WRITING -> REFRESH
+  // among other things, this lets do_refresh() -> mon->bootstrap() know
+  // it doesn't need to flush the store queue
+  assert(is_writing() || is_writing_previous());
+  state = STATE_REFRESH;
+
+  if (do_refresh()) {
+    commit_proposal();
+    if (mon->get_quorum().size() > 1) {
+      extend_lease();
+    }
+
+    finish_contexts(g_ceph_context, waiting_for_commit);
+
+    assert(g_conf->paxos_kill_at != 10);
+
+    finish_round();
+
+    // wake people up
+    finish_contexts(g_ceph_context, waiting_for_active);
+    finish_contexts(g_ceph_context, waiting_for_readable);
+    finish_contexts(g_ceph_context, waiting_for_writeable);
+  }
 }
 
 
@@ -899,16 +921,25 @@ void Paxos::commit_proposal()
 {
   dout(10) << __func__ << dendl;
   assert(mon->is_leader());
-  assert(!proposals.empty());
-  assert(is_updating());
+  assert(is_refresh());
 
-  C_Proposal *proposal = static_cast<C_Proposal*>(proposals.front());
-  assert(proposal->proposed);
-  dout(10) << __func__ << " proposal " << proposal << " took "
-	   << (ceph_clock_now(NULL) - proposal->proposal_time)
-	   << " to finish" << dendl;
-  proposals.pop_front();
-  proposal->complete(0);
+  // if we just committed a value learned from a previous quorum, nothing
+  // in our queue was proposed in this round.
+  if (proposals.empty() ||
+      !static_cast<C_Proposal*>(proposals.front())->proposed)
+    return;
+
+  // complete every proposal that was merged into the committed value
+  while (!proposals.empty()) {
+    C_Proposal *proposal = static_cast<C_Proposal*>(proposals.front());
+    if (!proposal->proposed)
+      break;
+    dout(10) << __func__ << " proposal " << proposal << " took "
+	     << (ceph_clock_now(NULL) - proposal->proposal_time)
+	     << " to finish" << dendl;
+    proposals.pop_front();
+    proposal->complete(0);
+  }
 }
 
 void Paxos::finish_round()
@@ -1191,6 +1222,12 @@ void Paxos::peon_init()
 void Paxos::restart()
 {
   dout(10) << "restart -- canceling timeouts" << dendl;
+
+  // anyone taking us out of leader/peon state flushed the store queue
+  // first (see Monitor::wait_for_paxos_write), so there is no commit in
+  // flight that could complete under our feet.
+  assert(!is_writing() && !is_writing_previous());
+
   cancel_events();
   new_value.clear();
 
@@ -1264,16 +1301,22 @@ void Paxos::dispatch(PaxosServiceMessage *m)
 
 bool Paxos::is_readable(version_t v)
 {
-  dout(1) << "is_readable now=" << ceph_clock_now(g_ceph_context) << " lease_expire=" << lease_expire
-	  << " has v" << v << " lc " << last_committed << dendl;
+  bool ret;
   if (v > last_committed)
-    return false;
-  return 
-    (mon->is_peon() || mon->is_leader()) &&
-    (is_active() || is_updating()) &&
-    last_committed > 0 &&           // must have a value
-    (mon->get_quorum().size() == 1 ||  // alone, or
-     is_lease_valid()); // have lease
+    ret = false;
+  else
+    ret =
+      (mon->is_peon() || mon->is_leader()) &&
+      (is_active() || is_updating() || is_writing()) &&
+      last_committed > 0 &&           // must have a value
+      (mon->get_quorum().size() == 1 ||  // alone, or
+       is_lease_valid()); // have lease
+  dout(5) << __func__ << " = " << (int)ret
+	  << " - now=" << ceph_clock_now(g_ceph_context)
+	  << " lease_expire=" << lease_expire
+	  << " has v" << v << " lc " << last_committed
+	  << dendl;
+  return ret;
 }
 
 bool Paxos::read(version_t v, bufferlist &bl)
@@ -1327,16 +1370,45 @@ void Paxos::propose_queued()
   assert(!proposal->proposed);
 
   cancel_events();
-  dout(10) << __func__ << " " << (last_committed + 1)
-	  << " " << proposal->bl.length() << " bytes" << dendl;
+
+  bufferlist value = proposal->bl;
   proposal->proposed = true;
+  unsigned num_merged = 1;
+
+  // every queued proposal is an encoded MonitorDBStore transaction,
+  // so a burst of them can be merged into a single value and commit
+  // in one round trip instead of one round each.  commit_proposal
+  // finishes every proposal that was marked proposed here.
+  uint64_t max_bytes = g_conf->paxos_merge_max_bytes;
+  if (max_bytes && proposals.size() > 1) {
+    MonitorDBStore::Transaction t;
+    t.append_from_encoded(value);
+    list<Context*>::iterator p = proposals.begin();
+    for (++p; p != proposals.end(); ++p) {
+      C_Proposal *next = static_cast<C_Proposal*>(*p);
+      assert(!next->proposed);
+      if (value.length() + next->bl.length() > max_bytes)
+	break;
+      t.append_from_encoded(next->bl);
+      next->proposed = true;
+      ++num_merged;
+    }
+    if (num_merged > 1) {
+      value.clear();
+      t.encode(value);
+    }
+  }
+
+  dout(10) << __func__ << " " << (last_committed + 1)
+	  << " " << value.length() << " bytes from "
+	  << num_merged << " proposal(s)" << dendl;
 
   dout(30) << __func__ << " ";
   list_proposals(*_dout);
   *_dout << dendl;
 
   state = STATE_UPDATING;
-  begin(proposal->bl);
+  begin(value);
 }
 
 void Paxos::queue_proposal(bufferlist& bl, Context *onfinished)
@@ -180,6 +180,17 @@ public:
      * Leader proposing an old value
      */
     STATE_UPDATING_PREVIOUS,
+    /*
+     * Leader/Peon is writing a new commit.  readable, but not
+     * writeable.
+     */
+    STATE_WRITING,
+    /*
+     * Leader/Peon is writing a new commit from a previous round.
+     */
+    STATE_WRITING_PREVIOUS,
+    // leader: refresh following a commit
+    STATE_REFRESH,
   };
 
   /**
@@ -201,6 +212,12 @@ public:
       return "updating";
     case STATE_UPDATING_PREVIOUS:
       return "updating-previous";
+    case STATE_WRITING:
+      return "writing";
+    case STATE_WRITING_PREVIOUS:
+      return "writing-previous";
+    case STATE_REFRESH:
+      return "refresh";
     default:
       return "UNKNOWN";
     }
@@ -241,6 +258,15 @@ public:
    */
   bool is_updating_previous() const { return state == STATE_UPDATING_PREVIOUS; }
 
+  /// @return 'true' if we are writing an update to disk
+  bool is_writing() const { return state == STATE_WRITING; }
+
+  /// @return 'true' if we are writing an update-previous to disk
+  bool is_writing_previous() const { return state == STATE_WRITING_PREVIOUS; }
+
+  /// @return 'true' if we are refreshing an update just committed
+  bool is_refresh() const { return state == STATE_REFRESH; }
+
 private:
   /**
    * @defgroup Paxos_h_recovery_vars Common recovery-related member variables
@@ -605,6 +631,21 @@ private:
     }
   };
 
+  /**
+   * Callback class responsible for finishing a commit once the new value
+   * is durable on disk.
+   *
+   * Queued on the store's io_work thread by Paxos::commit_start; takes the
+   * monitor lock and calls Paxos::commit_finish once the transaction has
+   * been applied.
+   */
+  class C_Committed : public Context {
+    Paxos *paxos;
+  public:
+    C_Committed(Paxos *p) : paxos(p) {}
+    void finish(int r);   // defined in Paxos.cc; needs the Monitor lock
+  };
+
   class C_Trimmed : public Context {
     Paxos *paxos;
   public:
@@ -830,17 +871,31 @@ private:
   /**
    * Commit a value throughout the system.
    *
-   * The Leader will cancel the current lease (as it was for the old value),
-   * and will store the committed value locally. It will then instruct every
-   * quorum member to do so as well.
+   * The Leader will queue the committed value to the store's io_work
+   * thread, so the disk write (and its fsync) does not block the monitor;
+   * in the mean time we move on to STATE_WRITING (or
+   * STATE_WRITING_PREVIOUS) and may keep accumulating proposals for the
+   * next round.  Once the value is durable, Paxos::commit_finish will
+   * cancel the current lease (as it was for the old value), instruct every
+   * quorum member to commit as well, and finish the round.
    *
    * @pre We are the Leader
-   * @pre We are on STATE_UPDATING
+   * @pre We are on STATE_UPDATING or STATE_UPDATING_PREVIOUS
    * @pre A majority of quorum members accepted our proposal
-   * @post Value locally stored
-   * @post Quorum members instructed to commit the new value.
+   * @post We are on STATE_WRITING or STATE_WRITING_PREVIOUS
+   * @post Value queued for local storage
    */
-  void commit();
+  void commit_start();
+  /**
+   * Complete a commit once the value is durable on disk.
+   *
+   * Runs under the monitor lock via Paxos::C_Committed.
+   *
+   * @pre We are on STATE_WRITING or STATE_WRITING_PREVIOUS
+   * @post Quorum members instructed to commit the new value
+   * @post We went through STATE_REFRESH and finished the round
+   */
+  void commit_finish();
   /**
    * Commit the new value to stable storage as being the latest available
    * version.
@@ -1191,6 +1246,12 @@ public:
    *  @li we do not have a committed value yet
    *  @li we do not have a valid lease
    *
+   * Note that the Peons serve reads too: while a Peon holds a valid
+   * lease (granted and renewed by the Leader via extend_lease()), it
+   * can answer version-consistent reads locally, which is what spreads
+   * the monitor read load across the whole quorum instead of funneling
+   * it all through the Leader.
+   *
    * @param seen The version we want to check if it is readable.
    * @return 'true' if the version is readable; 'false' otherwise.
    */
@@ -549,7 +549,7 @@ public:
   bool is_active() {
     return
       !is_proposing() &&
-      (paxos->is_active() || paxos->is_updating());
+      (paxos->is_active() || paxos->is_updating() || paxos->is_writing());
   }
 
   /**
@@ -588,7 +588,7 @@ public:
     return
       !is_proposing() &&
       is_write_ready() &&
-      (paxos->is_active() || paxos->is_updating());
+      (paxos->is_active() || paxos->is_updating() || paxos->is_writing());
   }
 
   /**
@@ -1,4 +1,4 @@
-// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*- 
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 /*
  * Ceph - scalable distributed file system
@@ -7,15 +7,16 @@
  *
  * This is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Lesser General Public
- * License version 2.1, as published by the Free Software 
+ * License version 2.1, as published by the Free Software
  * Foundation.  See file COPYING.
- * 
+ *
  */
 
 #include "msg/Message.h"
 #include "DispatchQueue.h"
-#include "SimpleMessenger.h"
+#include "Messenger.h"
 #include "common/ceph_context.h"
+#include "common/perf_counters.h"
 
 #define dout_subsys ceph_subsys_ms
 #include "common/debug.h"
@@ -28,12 +29,51 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "-- " << msgr->get_myaddr() << " "
 
+DispatchQueue::DispatchQueue(CephContext *cct, Messenger *msgr)
+  : cct(cct), msgr(msgr),
+    lock("SimpleMessenger::DispatchQeueu::lock"),
+    next_pipe_id(1),
+    local_delivery_lock("SimpleMessenger::DispatchQueue::local_delivery_lock"),
+    stop_local_delivery(false),
+    local_delivery_thread(this),
+    stop(false)
+{
+  int n = cct->_conf->ms_dispatch_shards;
+  if (n < 1)
+    n = 1;
+  for (int i = 0; i < n; ++i) {
+    Shard *shard = new Shard(cct->_conf->ms_pq_max_tokens_per_priority,
+			     cct->_conf->ms_pq_min_cost);
+    shards.push_back(shard);
+    dispatch_threads.push_back(new DispatchThread(this, shard));
+  }
+}
+
+DispatchQueue::~DispatchQueue()
+{
+  for (unsigned i = 0; i < shards.size(); ++i) {
+    // queue items own a message ref; drop any that never dispatched
+    while (!shards[i]->mqueue.empty()) {
+      QueueItem qitem = shards[i]->mqueue.dequeue();
+      if (!qitem.is_code())
+	qitem.get_message()->put();
+    }
+    delete dispatch_threads[i];
+    delete shards[i];
+  }
+}
+
 double DispatchQueue::get_max_age(utime_t now) {
-  Mutex::Locker l(lock);
-  if (marrival.empty())
-    return 0;
-  else
-    return (now - marrival.begin()->first);
+  double max = 0;
+  for (unsigned i = 0; i < shards.size(); ++i) {
+    Mutex::Locker l(shards[i]->lock);
+    if (!shards[i]->marrival.empty()) {
+      double age = now - shards[i]->marrival.begin()->first;
+      if (age > max)
+	max = age;
+    }
+  }
+  return max;
 }
 
 uint64_t DispatchQueue::pre_dispatch(Message *m)
@@ -49,6 +89,12 @@ uint64_t DispatchQueue::pre_dispatch(Message *m)
 	       << " " << m->get_footer().data_crc << ")"
 	       << " " << m << " con " << m->get_connection()
 	       << dendl;
+  if (msgr->ms_logger) {
+    msgr->ms_logger->tinc(l_msgr_dispatch_latency,
+			  ceph_clock_now(cct) - m->get_recv_stamp());
+    if (refcount_track_ops)
+      msgr->ms_logger->set(l_msgr_refcount_ops, refcount_get_total_ops());
+  }
   uint64_t msize = m->get_dispatch_throttle_size();
   m->set_dispatch_throttle_size(0); // clear it out, in case we requeue this message.
   return msize;
@@ -79,24 +125,26 @@ void DispatchQueue::fast_preprocess(Message *m)
 
 void DispatchQueue::enqueue(Message *m, int priority, uint64_t id)
 {
-
-  Mutex::Locker l(lock);
+  Shard *s = shard_of(id);
+  Mutex::Locker l(s->lock);
   ldout(cct,20) << "queue " << m << " prio " << priority << dendl;
-  add_arrival(m);
+  if (msgr->ms_logger)
+    msgr->ms_logger->inc(l_msgr_dispatch_queue_len);
+  s->add_arrival(m);
   if (priority >= CEPH_MSG_PRIO_LOW) {
-    mqueue.enqueue_strict(
+    s->mqueue.enqueue_strict(
         id, priority, QueueItem(m));
   } else {
-    mqueue.enqueue(
+    s->mqueue.enqueue(
         id, priority, m->get_cost(), QueueItem(m));
   }
-  cond.Signal();
+  s->cond.Signal();
 }
 
 void DispatchQueue::local_delivery(Message *m, int priority)
 {
-  m->set_connection(msgr->local_connection.get());
-  m->set_recv_stamp(ceph_clock_now(msgr->cct));
+  m->set_connection(msgr->get_loopback_connection().get());
+  m->set_recv_stamp(ceph_clock_now(cct));
   Mutex::Locker l(local_delivery_lock);
   if (local_messages.empty())
     local_delivery_cond.Signal();
@@ -123,16 +171,19 @@ void DispatchQueue::run_local_delivery()
     if (can_fast_dispatch(m)) {
       fast_dispatch(m);
     } else {
-      Mutex::Locker l(lock);
-      add_arrival(m);
+      Shard *s = shard_of(0);
+      Mutex::Locker l(s->lock);
+      if (msgr->ms_logger)
+	msgr->ms_logger->inc(l_msgr_dispatch_queue_len);
+      s->add_arrival(m);
       if (priority >= CEPH_MSG_PRIO_LOW) {
-        mqueue.enqueue_strict(
+        s->mqueue.enqueue_strict(
             0, priority, QueueItem(m));
       } else {
-        mqueue.enqueue(
+        s->mqueue.enqueue(
             0, priority, m->get_cost(), QueueItem(m));
       }
-      cond.Signal();
+      s->cond.Signal();
     }
     local_delivery_lock.Lock();
   }
@@ -148,15 +199,18 @@ void DispatchQueue::run_local_delivery()
  * end of the queue. If the queue is empty; it's removed.
  * The message is then delivered and the process starts again.
  */
-void DispatchQueue::entry()
+void DispatchQueue::entry(Shard *shard)
 {
-  lock.Lock();
+  shard->lock.Lock();
   while (true) {
-    while (!mqueue.empty()) {
-      QueueItem qitem = mqueue.dequeue();
-      if (!qitem.is_code())
-	remove_arrival(qitem.get_message());
-      lock.Unlock();
+    while (!shard->mqueue.empty()) {
+      QueueItem qitem = shard->mqueue.dequeue();
+      if (!qitem.is_code()) {
+	shard->remove_arrival(qitem.get_message());
+	if (msgr->ms_logger)
+	  msgr->ms_logger->dec(l_msgr_dispatch_queue_len);
+      }
+      shard->lock.Unlock();
 
       if (qitem.is_code()) {
 	switch (qitem.get_code()) {
@@ -187,27 +241,30 @@ void DispatchQueue::entry()
 	}
       }
 
-      lock.Lock();
+      shard->lock.Lock();
     }
     if (stop)
       break;
 
     // wait for something to be put on queue
-    cond.Wait(lock);
+    shard->cond.Wait(shard->lock);
   }
-  lock.Unlock();
+  shard->lock.Unlock();
 }
 
 void DispatchQueue::discard_queue(uint64_t id) {
-  Mutex::Locker l(lock);
+  Shard *s = shard_of(id);
+  Mutex::Locker l(s->lock);
   list<QueueItem> removed;
-  mqueue.remove_by_class(id, &removed);
+  s->mqueue.remove_by_class(id, &removed);
   for (list<QueueItem>::iterator i = removed.begin();
        i != removed.end();
        ++i) {
     assert(!(i->is_code())); // We don't discard id 0, ever!
     Message *m = i->get_message();
-    remove_arrival(m);
+    s->remove_arrival(m);
+    if (msgr->ms_logger)
+      msgr->ms_logger->dec(l_msgr_dispatch_queue_len);
     msgr->dispatch_throttle_release(m->get_dispatch_throttle_size());
     m->put();
   }
@@ -216,15 +273,18 @@ void DispatchQueue::discard_queue(uint64_t id) {
 void DispatchQueue::start()
 {
   assert(!stop);
-  assert(!dispatch_thread.is_started());
-  dispatch_thread.create();
+  for (unsigned i = 0; i < dispatch_threads.size(); ++i) {
+    assert(!dispatch_threads[i]->is_started());
+    dispatch_threads[i]->create();
+  }
   local_delivery_thread.create();
 }
 
 void DispatchQueue::wait()
 {
   local_delivery_thread.join();
-  dispatch_thread.join();
+  for (unsigned i = 0; i < dispatch_threads.size(); ++i)
+    dispatch_threads[i]->join();
 }
 
 void DispatchQueue::shutdown()
@@ -235,9 +295,12 @@ void DispatchQueue::shutdown()
   local_delivery_cond.Signal();
   local_delivery_lock.Unlock();
 
-  // stop my dispatch thread
-  lock.Lock();
+  // stop my dispatch threads
+  for (unsigned i = 0; i < shards.size(); ++i)
+    shards[i]->lock.Lock();
   stop = true;
-  cond.Signal();
-  lock.Unlock();
+  for (unsigned i = 0; i < shards.size(); ++i) {
+    shards[i]->cond.Signal();
+    shards[i]->lock.Unlock();
+  }
 }
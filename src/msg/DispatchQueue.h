@@ -1,4 +1,4 @@
-// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*- 
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 /*
  * Ceph - scalable distributed file system
@@ -7,15 +7,16 @@
  *
  * This is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Lesser General Public
- * License version 2.1, as published by the Free Software 
+ * License version 2.1, as published by the Free Software
  * Foundation.  See file COPYING.
- * 
+ *
  */
 
 #ifndef CEPH_DISPATCHQUEUE_H
 #define CEPH_DISPATCHQUEUE_H
 
 #include <map>
+#include <vector>
 #include <boost/intrusive_ptr.hpp>
 #include "include/assert.h"
 #include "include/xlist.h"
@@ -24,12 +25,12 @@
 #include "common/Cond.h"
 #include "common/Thread.h"
 #include "common/RefCountedObj.h"
-#include "common/PrioritizedQueue.h"
+#include "common/FlatPrioritizedQueue.h"
 
 class CephContext;
 class DispatchQueue;
 class Pipe;
-class SimpleMessenger;
+class Messenger;
 class Message;
 struct Connection;
 
@@ -37,13 +38,23 @@ struct Connection;
  * The DispatchQueue contains all the Pipes which have Messages
  * they want to be dispatched, carefully organized by Message priority
  * and permitted to deliver in a round-robin fashion.
- * See SimpleMessenger::dispatch_entry for details.
+ *
+ * The queue is split into ms_dispatch_shards shards, each with its own
+ * lock, priority queue and dispatch thread.  Connections are mapped to
+ * shards by their id, so messages (and connect/reset events) for one
+ * connection always dispatch in order from the same thread while
+ * unrelated connections can dispatch in parallel.  The default of one
+ * shard preserves the historical single-threaded behavior.
  */
 class DispatchQueue {
   class QueueItem {
     int type;
     ConnectionRef con;
-    MessageRef m;
+    /// owned: the queue inherits the enqueuer's ref and passes it on
+    /// to the dispatcher (or put()s it on discard).  A plain pointer,
+    /// not a MessageRef, so copying the item through the priority
+    /// queue costs no refcount traffic.
+    Message *m;
   public:
     QueueItem(Message *m) : type(-1), con(0), m(m) {}
     QueueItem(int type, Connection *con) : type(type), con(con), m(0) {}
@@ -56,55 +67,72 @@ class DispatchQueue {
     }
     Message *get_message() {
       assert(!is_code());
-      return m.get();
+      return m;
     }
     Connection *get_connection() {
       assert(is_code());
       return con.get();
     }
   };
-    
+
+  struct Shard {
+    Mutex lock;
+    Cond cond;
+
+    FlatPrioritizedQueue<QueueItem, uint64_t> mqueue;
+
+    set<pair<double, Message*> > marrival;
+    map<Message *, set<pair<double, Message*> >::iterator> marrival_map;
+    void add_arrival(Message *m) {
+      marrival_map.insert(
+	make_pair(
+	  m,
+	  marrival.insert(make_pair(m->get_recv_stamp(), m)).first
+	  )
+	);
+    }
+    void remove_arrival(Message *m) {
+      map<Message *, set<pair<double, Message*> >::iterator>::iterator i =
+	marrival_map.find(m);
+      assert(i != marrival_map.end());
+      marrival.erase(i->second);
+      marrival_map.erase(i);
+    }
+
+    Shard(uint64_t max_tokens, uint64_t min_cost)
+      : lock("SimpleMessenger::DispatchQueue::Shard::lock"),
+	mqueue(max_tokens, min_cost)
+      {}
+  };
+
   CephContext *cct;
-  SimpleMessenger *msgr;
+  Messenger *msgr;
   Mutex lock;
-  Cond cond;
-
-  PrioritizedQueue<QueueItem, uint64_t> mqueue;
-
-  set<pair<double, Message*> > marrival;
-  map<Message *, set<pair<double, Message*> >::iterator> marrival_map;
-  void add_arrival(Message *m) {
-    marrival_map.insert(
-      make_pair(
-	m,
-	marrival.insert(make_pair(m->get_recv_stamp(), m)).first
-	)
-      );
-  }
-  void remove_arrival(Message *m) {
-    map<Message *, set<pair<double, Message*> >::iterator>::iterator i =
-      marrival_map.find(m);
-    assert(i != marrival_map.end());
-    marrival.erase(i->second);
-    marrival_map.erase(i);
+
+  vector<Shard*> shards;
+
+  Shard *shard_of(uint64_t id) {
+    return shards[id % shards.size()];
   }
 
   uint64_t next_pipe_id;
-    
+
   enum { D_CONNECT = 1, D_ACCEPT, D_BAD_REMOTE_RESET, D_BAD_RESET, D_NUM_CODES };
 
   /**
-   * The DispatchThread runs dispatch_entry to empty out the dispatch_queue.
+   * Each DispatchThread runs entry() on its shard of the queue.
    */
   class DispatchThread : public Thread {
     DispatchQueue *dq;
+    Shard *shard;
   public:
-    DispatchThread(DispatchQueue *dq) : dq(dq) {}
+    DispatchThread(DispatchQueue *dq, Shard *shard) : dq(dq), shard(shard) {}
     void *entry() {
-      dq->entry();
+      dq->entry(shard);
       return 0;
     }
-  } dispatch_thread;
+  };
+  vector<DispatchThread*> dispatch_threads;
 
   Mutex local_delivery_lock;
   Cond local_delivery_cond;
@@ -123,6 +151,18 @@ class DispatchQueue {
   uint64_t pre_dispatch(Message *m);
   void post_dispatch(Message *m, uint64_t msize);
 
+  void queue_code(int code, Connection *con, uint64_t id) {
+    Shard *s = shard_of(id);
+    Mutex::Locker l(s->lock);
+    if (stop)
+      return;
+    s->mqueue.enqueue_strict(
+      0,
+      CEPH_MSG_PRIO_HIGHEST,
+      QueueItem(code, con));
+    s->cond.Signal();
+  }
+
   public:
   bool stop;
   void local_delivery(Message *m, int priority);
@@ -131,49 +171,25 @@ class DispatchQueue {
   double get_max_age(utime_t now);
 
   int get_queue_len() {
-    Mutex::Locker l(lock);
-    return mqueue.length();
+    int l = 0;
+    for (unsigned i = 0; i < shards.size(); ++i) {
+      Mutex::Locker lk(shards[i]->lock);
+      l += shards[i]->mqueue.length();
+    }
+    return l;
   }
-    
-  void queue_connect(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_CONNECT, con));
-    cond.Signal();
+
+  void queue_connect(Connection *con, uint64_t id) {
+    queue_code(D_CONNECT, con, id);
   }
-  void queue_accept(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_ACCEPT, con));
-    cond.Signal();
+  void queue_accept(Connection *con, uint64_t id) {
+    queue_code(D_ACCEPT, con, id);
   }
-  void queue_remote_reset(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_BAD_REMOTE_RESET, con));
-    cond.Signal();
+  void queue_remote_reset(Connection *con, uint64_t id) {
+    queue_code(D_BAD_REMOTE_RESET, con, id);
   }
-  void queue_reset(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_BAD_RESET, con));
-    cond.Signal();
+  void queue_reset(Connection *con, uint64_t id) {
+    queue_code(D_BAD_RESET, con, id);
   }
 
   bool can_fast_dispatch(Message *m);
@@ -186,23 +202,13 @@ class DispatchQueue {
     return next_pipe_id++;
   }
   void start();
-  void entry();
+  void entry(Shard *shard);
   void wait();
   void shutdown();
-  bool is_started() {return dispatch_thread.is_started();}
-
-  DispatchQueue(CephContext *cct, SimpleMessenger *msgr)
-    : cct(cct), msgr(msgr),
-      lock("SimpleMessenger::DispatchQeueu::lock"), 
-      mqueue(cct->_conf->ms_pq_max_tokens_per_priority,
-	     cct->_conf->ms_pq_min_cost),
-      next_pipe_id(1),
-      dispatch_thread(this),
-      local_delivery_lock("SimpleMessenger::DispatchQueue::local_delivery_lock"),
-      stop_local_delivery(false),
-      local_delivery_thread(this),
-      stop(false)
-    {}
+  bool is_started() {return dispatch_threads[0]->is_started();}
+
+  DispatchQueue(CephContext *cct, Messenger *msgr);
+  ~DispatchQueue();
 };
 
 #endif
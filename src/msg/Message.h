@@ -382,6 +382,11 @@ public:
   void set_connection(const ConnectionRef& c) {
     connection = c;
   }
+  void set_connection(Connection *c) {
+    // raw pointer overload; skips the temporary ConnectionRef (and its
+    // refcount round trip) that callers passing ref.get() would create
+    connection = c;
+  }
   void set_byte_throttler(Throttle *t) { byte_throttler = t; }
   Throttle *get_byte_throttler() { return byte_throttler; }
   void set_message_throttler(Throttle *t) { msg_throttler = t; }
@@ -1,13 +1,50 @@
 
 #include "include/types.h"
+#include "common/debug.h"
+#include "common/perf_counters.h"
 #include "Messenger.h"
 
 #include "SimpleMessenger.h"
+#include "msg/async/AsyncMessenger.h"
+
+Messenger::~Messenger()
+{
+  if (ms_logger) {
+    cct->get_perfcounters_collection()->remove(ms_logger);
+    delete ms_logger;
+  }
+}
+
+void Messenger::init_perf_logger(const string &name)
+{
+  PerfCountersBuilder plb(cct, string("msgr-") + name,
+			  l_msgr_first, l_msgr_last);
+  plb.add_u64_counter(l_msgr_recv_messages, "msgr_recv_messages");
+  plb.add_u64_counter(l_msgr_send_messages, "msgr_send_messages");
+  plb.add_u64_counter(l_msgr_recv_bytes, "msgr_recv_bytes");
+  plb.add_u64_counter(l_msgr_send_bytes, "msgr_send_bytes");
+  plb.add_u64(l_msgr_dispatch_queue_len, "msgr_dispatch_queue_len");
+  plb.add_time_avg(l_msgr_dispatch_latency, "msgr_dispatch_latency");
+  plb.add_u64_counter(l_msgr_compress_orig_bytes, "msgr_compress_orig_bytes");
+  plb.add_u64_counter(l_msgr_compress_sent_bytes, "msgr_compress_sent_bytes");
+  plb.add_time_avg(l_msgr_compress_lat, "msgr_compress_lat");
+  plb.add_time_avg(l_msgr_decompress_lat, "msgr_decompress_lat");
+  // process-wide RefCountedObject get/put tally; only ticks when
+  // CEPH_REFCOUNT_TRACK is set in the environment
+  plb.add_u64(l_msgr_refcount_ops, "msgr_refcount_ops");
+  ms_logger = plb.create_perf_counters();
+  cct->get_perfcounters_collection()->add(ms_logger);
+}
 
 Messenger *Messenger::create(CephContext *cct,
 			     entity_name_t name,
 			     string lname,
 			     uint64_t nonce)
 {
-  return new SimpleMessenger(cct, name, lname, nonce);
+  if (cct->_conf->ms_type == "simple")
+    return new SimpleMessenger(cct, name, lname, nonce);
+  else if (cct->_conf->ms_type == "async")
+    return new AsyncMessenger(cct, name, lname, nonce);
+  lderr(cct) << "unrecognized ms_type '" << cct->_conf->ms_type << "'" << dendl;
+  return NULL;
 }
@@ -34,6 +34,27 @@ using namespace std;
 
 class MDS;
 class Timer;
+class PerfCounters;
+
+// SO_PRIORITY value for sockets carrying latency-sensitive traffic
+// (maps to the kernel's lowest-delay band; see socket(7))
+#define SOCKET_PRIORITY_MIN_DELAY 6
+
+enum {
+  l_msgr_first = 94000,
+  l_msgr_recv_messages,
+  l_msgr_send_messages,
+  l_msgr_recv_bytes,
+  l_msgr_send_bytes,
+  l_msgr_dispatch_queue_len,
+  l_msgr_dispatch_latency,
+  l_msgr_compress_orig_bytes,
+  l_msgr_compress_sent_bytes,
+  l_msgr_compress_lat,
+  l_msgr_decompress_lat,
+  l_msgr_refcount_ops,
+  l_msgr_last,
+};
 
 
 class Messenger {
@@ -45,6 +66,8 @@ protected:
   /// the "name" of the local daemon. eg client.99
   entity_inst_t my_inst;
   int default_send_priority;
+  /// SO_PRIORITY for this Messenger's sockets, or -1 to leave them alone
+  int socket_priority;
   /// set to true once the Messenger has started, and set to false on shutdown
   bool started;
 
@@ -55,6 +78,9 @@ public:
    */
   CephContext *cct;
 
+  /// messenger perf counters ("msgr-<name>" in perf dump); may be NULL
+  PerfCounters *ms_logger;
+
   /**
    * A Policy describes the rules of a Connection. Is there a limit on how
    * much data this Connection can have locally? When the underlying connection
@@ -125,12 +151,21 @@ public:
    */
   Messenger(CephContext *cct_, entity_name_t w)
     : my_inst(),
-      default_send_priority(CEPH_MSG_PRIO_DEFAULT), started(false),
-      cct(cct_)
+      default_send_priority(CEPH_MSG_PRIO_DEFAULT),
+      socket_priority(-1), started(false),
+      cct(cct_), ms_logger(NULL)
   {
     my_inst.name = w;
   }
-  virtual ~Messenger() {}
+  virtual ~Messenger();
+
+  /**
+   * Create and register this Messenger's perf counters (throughput,
+   * dispatch queue depth and latency).  Implementations should call
+   * this from their constructor; the counters show up in the admin
+   * socket "perf dump" output as "msgr-<name>".
+   */
+  void init_perf_logger(const string &name);
 
   /**
    * create a new messenger
@@ -292,6 +327,21 @@ public:
     assert(!started);
     default_send_priority = p;
   }
+  /**
+   * Set the SO_PRIORITY to apply to this Messenger's sockets, so that
+   * different traffic classes (e.g. heartbeats vs bulk data) can land
+   * in different kernel/network queues.  This is an init-time function
+   * and must be called *before* calling start().
+   *
+   * @param p The priority, or -1 to leave the sockets alone (default).
+   */
+  void set_socket_priority(int p) {
+    assert(!started);
+    socket_priority = p;
+  }
+  int get_socket_priority() {
+    return socket_priority;
+  }
   /**
    * Add a new Dispatcher to the front of the list. If you add
    * a Dispatcher which is already included, it will get a duplicate
@@ -465,6 +515,14 @@ public:
    * Get the Connection object associated with ourselves.
    */
   virtual ConnectionRef get_loopback_connection() = 0;
+  /**
+   * Release memory accounting back to the dispatch throttler, if the
+   * implementation has one.  Called by the DispatchQueue when it is
+   * done with a message.
+   *
+   * @param msize The amount of memory to release.
+   */
+  virtual void dispatch_throttle_release(uint64_t msize) {}
   /**
    * Send a "keepalive" ping to the given dest, if it has a working Connection.
    * If the Messenger doesn't already have a Connection, or if the underlying
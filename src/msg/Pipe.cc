@@ -13,10 +13,12 @@
  */
 
 #include <sys/socket.h>
+#include <netinet/ip.h>
 #include <netinet/tcp.h>
 #include <sys/uio.h>
 #include <limits.h>
 #include <poll.h>
+#include <snappy-c.h>
 
 #include "Message.h"
 #include "Pipe.h"
@@ -24,6 +26,7 @@
 
 #include "common/debug.h"
 #include "common/errno.h"
+#include "common/perf_counters.h"
 
 // Below included to get encode_encrypt(); That probably should be in Crypto.h, instead
 
@@ -79,7 +82,8 @@ Pipe::Pipe(SimpleMessenger *r, int st, Connection *con)
     conn_id(r->dispatch_queue.get_id()),
     sd(-1), port(0),
     peer_type(-1),
-    pipe_lock("SimpleMessenger::Pipe::pipe_lock"),
+    pipe_lock("SimpleMessenger::Pipe::pipe_lock", false, true, false, 0,
+	      true /* adaptive; reader/writer hold it only briefly */),
     state(st),
     connection_state(NULL),
     reader_running(false), reader_needs_join(false),
@@ -90,7 +94,8 @@ Pipe::Pipe(SimpleMessenger *r, int st, Connection *con)
     send_keepalive_ack(false),
     close_on_empty(false),
     connect_seq(0), peer_global_seq(0),
-    out_seq(0), in_seq(0), in_seq_acked(0) {
+    out_seq(0), in_seq(0), in_seq_acked(0),
+    cached_authorizer(NULL) {
   if (con) {
     connection_state = con;
     connection_state->reset_pipe(this);
@@ -114,6 +119,7 @@ Pipe::~Pipe()
   assert(out_q.empty());
   assert(sent.empty());
   delete delay_thread;
+  delete cached_authorizer;
 }
 
 void Pipe::handle_ack(uint64_t seq)
@@ -257,6 +263,7 @@ int Pipe::accept()
   bufferptr bp;
   bufferlist authorizer, authorizer_reply;
   bool authorizer_valid;
+  bool authorizer_cached;
   uint64_t feat_missing;
   bool replaced = false;
   // this variable denotes if the connection attempt from peer is a hard 
@@ -422,9 +429,43 @@ int Pipe::accept()
 
     pipe_lock.Unlock();
 
-    if (!msgr->verify_authorizer(connection_state.get(), peer_type, connect.authorizer_protocol, authorizer,
+    // Before doing the (expensive) crypto, see if this is a reconnect of
+    // an existing session presenting the very same authorizer we already
+    // verified recently.  If so we can reuse the session key and replay
+    // our previous reply; the peer built the reply check from the same
+    // nonce, so it still verifies.  Replaying an authorizer within its
+    // validity window is already possible in this protocol, so bounding
+    // the reuse by ms_session_resume_ttl does not weaken the model.
+    authorizer_cached = false;
+    if (connect.connect_seq > 0 && authorizer.length() &&
+	msgr->cct->_conf->ms_session_resume_ttl > 0) {
+      msgr->lock.Lock();
+      Pipe *ex = msgr->_lookup_pipe(peer_addr);
+      if (ex) {
+	ex->pipe_lock.Lock(true);  // skip lockdep check (we are locking a second Pipe here)
+	if (ex->auth_verified_bl.length() &&
+	    ex->auth_verified_bl.contents_equal(authorizer) &&
+	    ceph_clock_now(msgr->cct) - ex->auth_verified_stamp <=
+	      msgr->cct->_conf->ms_session_resume_ttl) {
+	  ldout(msgr->cct,10) << "accept reusing cached authorizer verification from "
+			      << ex << dendl;
+	  session_key = ex->auth_session_key;
+	  authorizer_reply = ex->auth_reply_bl;
+	  auth_verified_bl = ex->auth_verified_bl;
+	  auth_reply_bl = ex->auth_reply_bl;
+	  auth_session_key = ex->auth_session_key;
+	  auth_verified_stamp = ex->auth_verified_stamp;
+	  authorizer_cached = true;
+	}
+	ex->pipe_lock.Unlock();
+      }
+      msgr->lock.Unlock();
+    }
+
+    if (!authorizer_cached &&
+	(!msgr->verify_authorizer(connection_state.get(), peer_type, connect.authorizer_protocol, authorizer,
 				 authorizer_reply, authorizer_valid, session_key) ||
-	!authorizer_valid) {
+	 !authorizer_valid)) {
       ldout(msgr->cct,0) << "accept: got bad authorizer" << dendl;
       pipe_lock.Lock();
       if (state != STATE_ACCEPTING)
@@ -432,7 +473,16 @@ int Pipe::accept()
       reply.tag = CEPH_MSGR_TAG_BADAUTHORIZER;
       session_security.reset();
       goto reply;
-    } 
+    }
+
+    // remember this verification so a quick reconnect of the same session
+    // can skip it
+    if (!authorizer_cached && authorizer.length()) {
+      auth_verified_bl = authorizer;
+      auth_reply_bl = authorizer_reply;
+      auth_session_key = session_key;
+      auth_verified_stamp = ceph_clock_now(msgr->cct);
+    }
 
     // We've verified the authorizer for this pipe, so set up the session security structure.  PLR
 
@@ -614,10 +664,11 @@ int Pipe::accept()
     // disconnect from the Connection
     assert(existing->connection_state);
     if (existing->connection_state->clear_pipe(existing))
-      msgr->dispatch_queue.queue_reset(existing->connection_state.get());
+      msgr->dispatch_queue.queue_reset(existing->connection_state.get(),
+				      existing->conn_id);
   } else {
     // queue a reset on the new connection, which we're dumping for the old
-    msgr->dispatch_queue.queue_reset(connection_state.get());
+    msgr->dispatch_queue.queue_reset(connection_state.get(), conn_id);
 
     // drop my Connection, and take a ref to the existing one. do not
     // clear existing->connection_state, since read_message and
@@ -685,7 +736,7 @@ int Pipe::accept()
 			       connection_state->get_features()));
 
   // notify
-  msgr->dispatch_queue.queue_accept(connection_state.get());
+  msgr->dispatch_queue.queue_accept(connection_state.get(), conn_id);
   msgr->ms_deliver_handle_fast_accept(connection_state.get());
 
   // ok!
@@ -808,6 +859,29 @@ void Pipe::set_socket_options()
     ldout(msgr->cct,0) << "couldn't set SO_NOSIGPIPE: " << cpp_strerror(r) << dendl;
   }
 #endif
+
+  int prio = msgr->get_socket_priority();
+  if (prio >= 0) {
+#ifdef IPTOS_LOWDELAY
+    int iptos = IPTOS_LOWDELAY;
+    int r = ::setsockopt(sd, IPPROTO_IP, IP_TOS, (void*)&iptos, sizeof(iptos));
+    if (r < 0) {
+      r = -errno;
+      ldout(msgr->cct,0) << "couldn't set IP_TOS to " << iptos
+			 << ": " << cpp_strerror(r) << dendl;
+    }
+#endif
+#ifdef SO_PRIORITY
+    // setsockopt(IPTOS_LOWDELAY) sets the Type-of-Service field;
+    // SO_PRIORITY additionally picks the kernel egress queueing band
+    int r2 = ::setsockopt(sd, SOL_SOCKET, SO_PRIORITY, (void*)&prio, sizeof(prio));
+    if (r2 < 0) {
+      r2 = -errno;
+      ldout(msgr->cct,0) << "couldn't set SO_PRIORITY to " << prio
+			 << ": " << cpp_strerror(r2) << dendl;
+    }
+#endif
+  }
 }
 
 int Pipe::connect()
@@ -931,8 +1005,9 @@ int Pipe::connect()
 
 
   while (1) {
-    delete authorizer;
-    authorizer = msgr->get_authorizer(peer_type, false);
+    if (!cached_authorizer)
+      cached_authorizer = msgr->get_authorizer(peer_type, false);
+    authorizer = cached_authorizer;
     bufferlist authorizer_reply;
 
     ceph_msg_connect connect;
@@ -1040,8 +1115,8 @@ int Pipe::connect()
         goto stop_locked;
       got_bad_auth = true;
       pipe_lock.Unlock();
-      delete authorizer;
-      authorizer = msgr->get_authorizer(peer_type, true);  // try harder
+      delete cached_authorizer;
+      cached_authorizer = msgr->get_authorizer(peer_type, true);  // try harder
       continue;
     }
     if (reply.tag == CEPH_MSGR_TAG_RESETSESSION) {
@@ -1131,7 +1206,7 @@ int Pipe::connect()
 	session_security.reset();
       }
 
-      msgr->dispatch_queue.queue_connect(connection_state.get());
+      msgr->dispatch_queue.queue_connect(connection_state.get(), conn_id);
       msgr->ms_deliver_handle_fast_connect(connection_state.get());
       
       if (!reader_running) {
@@ -1139,7 +1214,7 @@ int Pipe::connect()
 	start_reader();
       }
       maybe_start_delay_thread();
-      delete authorizer;
+      // keep cached_authorizer around; a quick reconnect presents it again
       return 0;
     }
     
@@ -1165,7 +1240,6 @@ int Pipe::connect()
 		       << " != connecting, stopping" << dendl;
 
  stop_locked:
-  delete authorizer;
   return -1;
 }
 
@@ -1279,7 +1353,7 @@ void Pipe::fault(bool onread)
       state == STATE_CLOSING) {
     ldout(msgr->cct,10) << "fault already closed|closing" << dendl;
     if (connection_state->clear_pipe(this))
-      msgr->dispatch_queue.queue_reset(connection_state.get());
+      msgr->dispatch_queue.queue_reset(connection_state.get(), conn_id);
     return;
   }
 
@@ -1316,7 +1390,7 @@ void Pipe::fault(bool onread)
     // will be dropped.
     assert(connection_state);
     if (connection_state->clear_pipe(this))
-      msgr->dispatch_queue.queue_reset(connection_state.get());
+      msgr->dispatch_queue.queue_reset(connection_state.get(), conn_id);
     return;
   }
 
@@ -1382,7 +1456,7 @@ void Pipe::was_session_reset()
     delay_thread->discard();
   discard_out_queue();
 
-  msgr->dispatch_queue.queue_remote_reset(connection_state.get());
+  msgr->dispatch_queue.queue_remote_reset(connection_state.get(), conn_id);
 
   if (randomize_out_seq()) {
     lsubdout(msgr->cct,ms,15) << "was_session_reset(): Could not get random bytes to set seq number for session reset; set seq number to " << out_seq << dendl;
@@ -1541,6 +1615,15 @@ void Pipe::reader()
 
       m->set_connection(connection_state.get());
 
+      if (msgr->ms_logger) {
+	msgr->ms_logger->inc(l_msgr_recv_messages);
+	msgr->ms_logger->inc(l_msgr_recv_bytes,
+			     m->get_payload().length() +
+			     m->get_middle().length() +
+			     m->get_data().length() +
+			     sizeof(ceph_msg_header) + sizeof(ceph_msg_footer));
+      }
+
       // note last received message.
       in_seq = m->get_seq();
 
@@ -1696,7 +1779,7 @@ void Pipe::writer()
 	m->set_seq(++out_seq);
 	if (!policy.lossy || close_on_empty) {
 	  // put on sent list
-	  sent.push_back(m); 
+	  sent.push_back(m);
 	  m->get();
 	}
 
@@ -1704,6 +1787,22 @@ void Pipe::writer()
 	m->set_connection(connection_state.get());
 
 	uint64_t features = connection_state->get_features();
+
+	// if more messages are queued we can ask the kernel to coalesce
+	// this send with the next one
+	bool more = !out_q.empty();
+
+	// grab a reference to the session security handler, like the
+	// reader does, so we can sign outside pipe_lock
+	ceph::shared_ptr<AuthSessionHandler> sec = session_security;
+
+	// Encoding, crc calculation and signing can be expensive for
+	// large messages; do them outside pipe_lock so submitters
+	// (_send) aren't blocked behind us.  Nobody else touches the
+	// message buffers while it sits on the sent list, and only this
+	// thread re-sends requeued messages after a reconnect.
+	pipe_lock.Unlock();
+
 	if (m->empty_payload())
 	  ldout(msgr->cct,20) << "writer encoding " << m->get_seq() << " features " << features
 			      << " " << m << " " << *m << dendl;
@@ -1723,10 +1822,10 @@ void Pipe::writer()
 	// security set up.  Some session security options do not
 	// actually calculate and check the signature, but they should
 	// handle the calls to sign_message and check_signature.  PLR
-	if (session_security.get() == NULL) {
+	if (sec.get() == NULL) {
 	  ldout(msgr->cct, 20) << "writer no session security" << dendl;
 	} else {
-	  if (session_security->sign_message(m)) {
+	  if (sec->sign_message(m)) {
 	    ldout(msgr->cct, 20) << "writer failed to sign seq # " << header.seq
 				 << "): sig = " << footer.sig << dendl;
 	  } else {
@@ -1737,19 +1836,58 @@ void Pipe::writer()
 
 	bufferlist blist = m->get_payload();
 	blist.append(m->get_middle());
-	blist.append(m->get_data());
 
-	pipe_lock.Unlock();
+	// compress the data payload if the peer can decompress it and it
+	// looks worthwhile.  we send a patched copy of the envelope; the
+	// message itself is left alone (it may be requeued and resent),
+	// and the footer data_crc keeps covering the uncompressed bytes,
+	// so payload integrity stays end to end.
+	ceph_msg_header zheader;
+	bool compressed = false;
+	if (msgr->cct->_conf->ms_compress_data &&
+	    (features & CEPH_FEATURE_MSG_DATA_COMPRESS) &&
+	    m->get_data().length() >=
+	      msgr->cct->_conf->ms_compress_data_min_size) {
+	  utime_t start = ceph_clock_now(msgr->cct);
+	  bufferlist zdata;
+	  if (compress_data(m->get_data(), &zdata) == 0 &&
+	      zdata.length() < m->get_data().length()) {
+	    zheader = header;
+	    zheader.data_len = cpu_to_le32(zdata.length());
+	    zheader.reserved = cpu_to_le16(CEPH_MSG_DATA_SNAPPY);
+	    zheader.crc = ceph_crc32c(0, (unsigned char*)&zheader,
+				      sizeof(zheader) - sizeof(zheader.crc));
+	    ldout(msgr->cct,20) << "writer compressed data payload "
+				<< m->get_data().length() << " -> "
+				<< zdata.length() << dendl;
+	    if (msgr->ms_logger) {
+	      msgr->ms_logger->inc(l_msgr_compress_orig_bytes,
+				   m->get_data().length());
+	      msgr->ms_logger->inc(l_msgr_compress_sent_bytes, zdata.length());
+	      msgr->ms_logger->tinc(l_msgr_compress_lat,
+				    ceph_clock_now(msgr->cct) - start);
+	    }
+	    blist.claim_append(zdata);
+	    compressed = true;
+	  }
+	}
+	if (!compressed)
+	  blist.append(m->get_data());
 
         ldout(msgr->cct,20) << "writer sending " << m->get_seq() << " " << m << dendl;
-	int rc = write_message(header, footer, blist);
+	int rc = write_message(compressed ? zheader : header, footer, blist, more);
 
 	pipe_lock.Lock();
 	if (rc < 0) {
           ldout(msgr->cct,1) << "writer error sending " << m << ", "
 		  << cpp_strerror(errno) << dendl;
 	  fault();
-        }
+        } else if (msgr->ms_logger) {
+	  msgr->ms_logger->inc(l_msgr_send_messages);
+	  msgr->ms_logger->inc(l_msgr_send_bytes,
+			       blist.length() +
+			       sizeof(ceph_msg_header) + sizeof(ceph_msg_footer));
+	}
 	m->put();
       }
       continue;
@@ -1788,7 +1926,41 @@ void Pipe::unlock_maybe_reap()
   }
 }
 
-static void alloc_aligned_buffer(bufferlist& data, unsigned len, unsigned off)
+// compress a data payload for the wire; 0 on success.  the input is
+// flattened for the snappy C api, so callers should only bother for
+// payloads large enough to win the copy back in bandwidth.
+static int compress_data(const bufferlist &in, bufferlist *out)
+{
+  bufferlist flat(in);   // shares buffers; c_str() rebuilds locally if needed
+  size_t zlen = snappy_max_compressed_length(flat.length());
+  bufferptr bp = buffer::create(zlen);
+  if (snappy_compress(flat.c_str(), flat.length(), bp.c_str(), &zlen) !=
+      SNAPPY_OK)
+    return -EIO;
+  bp.set_length(zlen);
+  out->push_back(bp);
+  return 0;
+}
+
+// inverse of compress_data; 0 on success
+static int decompress_data(const bufferlist &in, bufferlist *out)
+{
+  bufferlist flat(in);
+  size_t ulen;
+  if (snappy_uncompressed_length(flat.c_str(), flat.length(), &ulen) !=
+      SNAPPY_OK)
+    return -EIO;
+  bufferptr bp = buffer::create(ulen);
+  if (snappy_uncompress(flat.c_str(), flat.length(), bp.c_str(), &ulen) !=
+      SNAPPY_OK)
+    return -EIO;
+  bp.set_length(ulen);
+  out->push_back(bp);
+  return 0;
+}
+
+static void alloc_aligned_buffer(buffer::pool *pool, bufferlist& data,
+				 unsigned len, unsigned off)
 {
   // create a buffer to read into that matches the data alignment
   unsigned left = len;
@@ -1796,18 +1968,18 @@ static void alloc_aligned_buffer(bufferlist& data, unsigned len, unsigned off)
     // head
     unsigned head = 0;
     head = MIN(CEPH_PAGE_SIZE - (off & ~CEPH_PAGE_MASK), left);
-    bufferptr bp = buffer::create(head);
+    bufferptr bp = pool->create(head);
     data.push_back(bp);
     left -= head;
   }
   unsigned middle = left & CEPH_PAGE_MASK;
   if (middle > 0) {
-    bufferptr bp = buffer::create_page_aligned(middle);
+    bufferptr bp = pool->create_page_aligned(middle);
     data.push_back(bp);
     left -= middle;
   }
   if (left) {
-    bufferptr bp = buffer::create(left);
+    bufferptr bp = pool->create(left);
     data.push_back(bp);
   }
 }
@@ -1856,7 +2028,7 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
   unsigned data_len, data_off;
   int aborted;
   Message *message;
-  utime_t recv_stamp = ceph_clock_now(msgr->cct);
+  utime_t recv_stamp = ceph_clock_now_coarse(msgr->cct);
 
   if (policy.throttler_messages) {
     ldout(msgr->cct,10) << "reader wants " << 1 << " message from policy throttler "
@@ -1884,12 +2056,12 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
     msgr->dispatch_throttler.get(message_size);
   }
 
-  utime_t throttle_stamp = ceph_clock_now(msgr->cct);
+  utime_t throttle_stamp = ceph_clock_now_coarse(msgr->cct);
 
   // read front
   front_len = header.front_len;
   if (front_len) {
-    bufferptr bp = buffer::create(front_len);
+    bufferptr bp = msgr->rx_pool->create(front_len);
     if (tcp_read(bp.c_str(), front_len) < 0)
       goto out_dethrottle;
     front.push_back(bp);
@@ -1899,7 +2071,7 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
   // read middle
   middle_len = header.middle_len;
   if (middle_len) {
-    bufferptr bp = buffer::create(middle_len);
+    bufferptr bp = msgr->rx_pool->create(middle_len);
     if (tcp_read(bp.c_str(), middle_len) < 0)
       goto out_dethrottle;
     middle.push_back(bp);
@@ -1942,7 +2114,7 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
       } else {
 	if (!newbuf.length()) {
 	  ldout(msgr->cct,20) << "reader allocating new rx buffer at offset " << offset << dendl;
-	  alloc_aligned_buffer(newbuf, data_len, data_off);
+	  alloc_aligned_buffer(msgr->rx_pool, newbuf, data_len, data_off);
 	  blp = newbuf.begin();
 	  blp.advance(offset);
 	}
@@ -1988,6 +2160,39 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
     goto out_dethrottle;
   }
 
+  // decompress the data payload?
+  if (le16_to_cpu(header.reserved) == CEPH_MSG_DATA_SNAPPY &&
+      connection_state->has_feature(CEPH_FEATURE_MSG_DATA_COMPRESS)) {
+    utime_t start = ceph_clock_now(msgr->cct);
+    bufferlist udata;
+    if (decompress_data(data, &udata) < 0) {
+      ldout(msgr->cct,0) << "reader failed to decompress data payload" << dendl;
+      ret = -EINVAL;
+      goto out_dethrottle;
+    }
+    ldout(msgr->cct,20) << "reader decompressed data payload " << data.length()
+			<< " -> " << udata.length() << dendl;
+    // we throttled the wire size; take the difference now so the
+    // message releases its true (uncompressed) size when it dies
+    if (udata.length() > data.length()) {
+      uint64_t inflate = udata.length() - data.length();
+      if (policy.throttler_bytes)
+	policy.throttler_bytes->take(inflate);
+      msgr->dispatch_throttler.take(inflate);
+      message_size += inflate;
+    }
+    data.claim(udata);
+    // restore the envelope to describe the uncompressed payload, so the
+    // crcs the signature check covers match what the sender signed
+    header.data_len = cpu_to_le32(data.length());
+    header.reserved = 0;
+    header.crc = ceph_crc32c(0, (unsigned char *)&header,
+			     sizeof(header) - sizeof(header.crc));
+    if (msgr->ms_logger)
+      msgr->ms_logger->tinc(l_msgr_decompress_lat,
+			    ceph_clock_now(msgr->cct) - start);
+  }
+
   ldout(msgr->cct,20) << "reader got " << front.length() << " + " << middle.length() << " + " << data.length()
 	   << " byte message" << dendl;
   message = decode_message(msgr->cct, header, footer, front, middle, data);
@@ -2019,7 +2224,7 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
 
   message->set_recv_stamp(recv_stamp);
   message->set_throttle_stamp(throttle_stamp);
-  message->set_recv_complete_stamp(ceph_clock_now(msgr->cct));
+  message->set_recv_complete_stamp(ceph_clock_now_coarse(msgr->cct));
 
   *pm = message;
   return 0;
@@ -2156,7 +2361,8 @@ int Pipe::write_keepalive2(char tag, const utime_t& t)
 }
 
 
-int Pipe::write_message(ceph_msg_header& header, ceph_msg_footer& footer, bufferlist& blist)
+int Pipe::write_message(ceph_msg_header& header, ceph_msg_footer& footer, bufferlist& blist,
+			bool more)
 {
   int ret;
 
@@ -2261,8 +2467,10 @@ int Pipe::write_message(ceph_msg_header& header, ceph_msg_footer& footer, buffer
     msg.msg_iovlen++;
   }
 
-  // send
-  if (do_sendmsg(&msg, msglen))
+  // send.  if the writer has more messages queued behind this one, ask
+  // the kernel to hold off (MSG_MORE) so small messages coalesce into
+  // fewer segments on the wire.
+  if (do_sendmsg(&msg, msglen, more))
     goto fail;
 
   ret = 0;
@@ -189,7 +189,25 @@ class DispatchQueue;
     __u32 connect_seq, peer_global_seq;
     uint64_t out_seq;
     uint64_t in_seq, in_seq_acked;
-    
+
+    /// authorizer we presented and that the peer accepted; kept so a
+    /// quick reconnect can present it again without rebuilding it
+    AuthAuthorizer *cached_authorizer;
+
+    /**
+     * Cache of the last connect authorizer we successfully verified,
+     * along with the reply we sent and the session key it produced.
+     * A reconnect of this session presenting the identical authorizer
+     * within ms_session_resume_ttl can skip the crypto; replaying our
+     * previous reply still verifies on the peer since the nonce is
+     * unchanged.
+     */
+    bufferlist auth_verified_bl;
+    bufferlist auth_reply_bl;
+    CryptoKey auth_session_key;
+    utime_t auth_verified_stamp;
+
+
     void set_socket_options();
 
     int accept();   // server handshake
@@ -202,7 +220,15 @@ class DispatchQueue;
 
     int read_message(Message **pm,
 		     AuthSessionHandler *session_security_copy);
-    int write_message(ceph_msg_header& h, ceph_msg_footer& f, bufferlist& body);
+    /**
+     * Write an encoded message to the socket.  The tag, envelope, payload
+     * segments and footer are gathered into a single iovec over the
+     * buffer::ptr segments (no copy) and pushed out with as few sendmsg
+     * calls as IOV_MAX allows.  If more is set, MSG_MORE is passed on the
+     * final send so the kernel can coalesce with the next queued message.
+     */
+    int write_message(ceph_msg_header& h, ceph_msg_footer& f, bufferlist& body,
+		      bool more=false);
     /**
      * Write the given data (of length len) to the Pipe's socket. This function
      * will loop until all passed data has been written out.
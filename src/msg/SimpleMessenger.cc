@@ -50,11 +50,13 @@ SimpleMessenger::SimpleMessenger(CephContext *cct, entity_name_t name,
     cluster_protocol(0),
     policy_lock("SimpleMessenger::policy_lock"),
     dispatch_throttler(cct, string("msgr_dispatch_throttler-") + mname, cct->_conf->ms_dispatch_throttle_bytes),
+    rx_pool(new buffer::pool(cct->_conf->ms_rx_buffer_pool_size)),
     reaper_started(false), reaper_stop(false),
     timeout(0),
     local_connection(new Connection(this))
 {
   ceph_spin_init(&global_seq_lock);
+  init_perf_logger(mname);
   init_local_connection();
 }
 
@@ -67,6 +69,7 @@ SimpleMessenger::~SimpleMessenger()
   assert(!did_bind); // either we didn't bind or we shut down the Accepter
   assert(rank_pipe.empty()); // we don't have any running Pipes.
   assert(reaper_stop && !reaper_started); // the reaper thread is stopped
+  rx_pool->put();
 }
 
 void SimpleMessenger::ready()
@@ -602,7 +605,7 @@ void SimpleMessenger::mark_down_all()
     p->stop_and_wait();
     ConnectionRef con = p->connection_state;
     if (con && con->clear_pipe(p))
-      dispatch_queue.queue_reset(con.get());
+      dispatch_queue.queue_reset(con.get(), p->conn_id);
     p->pipe_lock.Unlock();
   }
   accepting_pipes.clear();
@@ -617,7 +620,7 @@ void SimpleMessenger::mark_down_all()
     p->stop_and_wait();
     ConnectionRef con = p->connection_state;
     if (con && con->clear_pipe(p))
-      dispatch_queue.queue_reset(con.get());
+      dispatch_queue.queue_reset(con.get(), p->conn_id);
     p->pipe_lock.Unlock();
   }
   lock.Unlock();
@@ -638,7 +641,7 @@ void SimpleMessenger::mark_down(const entity_addr_t& addr)
       // not Connection* based) interface
       ConnectionRef con = p->connection_state;
       if (con && con->clear_pipe(p))
-	dispatch_queue.queue_reset(con.get());
+	dispatch_queue.queue_reset(con.get(), p->conn_id);
     }
     p->pipe_lock.Unlock();
   } else {
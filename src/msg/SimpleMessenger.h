@@ -346,6 +346,10 @@ private:
   /// Throttle preventing us from building up a big backlog waiting for dispatch
   Throttle dispatch_throttler;
 
+  /// Recycled receive buffers for the Pipe readers (refcounted; raws
+  /// drawn from it may outlive us)
+  buffer::pool *rx_pool;
+
   bool reaper_started, reaper_stop;
   Cond reaper_cond;
 
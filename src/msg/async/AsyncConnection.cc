@@ -0,0 +1,1569 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <unistd.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <poll.h>
+
+#include "common/errno.h"
+#include "auth/Crypto.h"
+#include "AsyncMessenger.h"
+#include "AsyncConnection.h"
+
+// see Pipe.cc: limit starting sequence number to 2^31
+#define SEQ_MASK  0x7fffffff
+
+#define dout_subsys ceph_subsys_ms
+#undef dout_prefix
+#define dout_prefix _conn_prefix(_dout)
+ostream& AsyncConnection::_conn_prefix(std::ostream *_dout) {
+  return *_dout << "-- " << async_msgr->get_myaddr() << " >> " << peer_addr
+		<< " conn(" << this << " sd=" << sd
+		<< " s=" << get_state_name(state)
+		<< " pgs=" << peer_global_seq
+		<< " cs=" << connect_seq
+		<< " l=" << policy.lossy
+		<< ").";
+}
+
+class C_handle_read : public EventCallback {
+  AsyncConnectionRef conn;
+ public:
+  C_handle_read(AsyncConnectionRef c): conn(c) {}
+  void do_request(int fd_or_id) {
+    conn->process();
+  }
+};
+
+class C_handle_write : public EventCallback {
+  AsyncConnectionRef conn;
+ public:
+  C_handle_write(AsyncConnectionRef c): conn(c) {}
+  void do_request(int fd_or_id) {
+    conn->handle_write();
+  }
+};
+
+class C_handle_reset : public EventCallback {
+  AsyncConnectionRef conn;
+ public:
+  C_handle_reset(AsyncConnectionRef c): conn(c) {}
+  void do_request(int fd_or_id) {
+    conn->handle_stop();
+  }
+};
+
+AsyncConnection::AsyncConnection(CephContext *c, AsyncMessenger *m, EventCenter *cen)
+  : async_msgr(m), cct(c), state(STATE_NONE), sd(-1), port(-1),
+    peer_type(-1), connection_state(new Connection(m)),
+    lock("AsyncConnection::lock"), conn_id(0),
+    center(cen), net(c), open_write(false), keepalive(false),
+    keepalive_ack(false), close_on_empty(false),
+    connect_seq(0), peer_global_seq(0), global_seq(0),
+    out_seq(0), in_seq(0), in_seq_acked(0),
+    got_msg_throttle(false), got_bytes_throttle(false),
+    got_dispatch_throttle(0),
+    authorizer(NULL), got_bad_auth(false), backoff_us(0)
+{
+  connection_state->pipe = get();
+  read_handler = new C_handle_read(this);
+  write_handler = new C_handle_write(this);
+  reset_handler = new C_handle_reset(this);
+  memset(&connect_msg, 0, sizeof(connect_msg));
+  memset(&connect_reply, 0, sizeof(connect_reply));
+  memset(&current_header, 0, sizeof(current_header));
+}
+
+AsyncConnection::~AsyncConnection()
+{
+  assert(sd < 0);
+  assert(out_q.empty());
+  assert(sent.empty());
+  delete authorizer;
+  delete read_handler;
+  delete write_handler;
+  delete reset_handler;
+}
+
+/* return: 0 means the needed bytes are in bl
+ *         1 means out of data for now (wait for the next readable event)
+ *        -1 means error
+ */
+int AsyncConnection::read_until(uint64_t len, bufferlist &bl)
+{
+  assert(lock.is_locked());
+  while (recv_bl.length() < len) {
+    bufferptr bp = buffer::create(len - recv_bl.length());
+    ssize_t r = ::read(sd, bp.c_str(), bp.length());
+    if (r == 0) {
+      ldout(cct, 1) << __func__ << " peer closed connection" << dendl;
+      return -1;
+    } else if (r < 0) {
+      if (errno == EINTR)
+	continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+	return 1;
+      ldout(cct, 1) << __func__ << " read failed: " << cpp_strerror(errno) << dendl;
+      return -1;
+    }
+    bp.set_length(r);
+    recv_bl.append(bp);
+  }
+  bl.clear();
+  bl.claim(recv_bl);
+  return 0;
+}
+
+/* append bl to the pending output and try to push it to the socket.
+ * return: 0 all pending data is on the wire
+ *         1 data remains; a writable event has been registered
+ *        -1 error
+ */
+int AsyncConnection::_try_send(bufferlist &bl, bool send)
+{
+  assert(lock.is_locked());
+  if (bl.length())
+    outcoming_bl.claim_append(bl);
+  if (!send)
+    return 0;
+
+  while (outcoming_bl.length()) {
+    struct msghdr msg;
+    struct iovec msgvec[IOV_MAX];
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = msgvec;
+    unsigned msglen = 0;
+    for (std::list<buffer::ptr>::const_iterator pb = outcoming_bl.buffers().begin();
+	 pb != outcoming_bl.buffers().end() && msg.msg_iovlen < IOV_MAX;
+	 ++pb) {
+      msgvec[msg.msg_iovlen].iov_base = (void*)pb->c_str();
+      msgvec[msg.msg_iovlen].iov_len = pb->length();
+      msg.msg_iovlen++;
+      msglen += pb->length();
+    }
+
+    ssize_t r = ::sendmsg(sd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (r == 0)
+      break;
+    if (r < 0) {
+      if (errno == EINTR)
+	continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+	break;
+      ldout(cct, 1) << __func__ << " write failed: " << cpp_strerror(errno) << dendl;
+      return -1;
+    }
+
+    if ((unsigned)r == outcoming_bl.length()) {
+      outcoming_bl.clear();
+    } else {
+      bufferlist swapped;
+      swapped.substr_of(outcoming_bl, r, outcoming_bl.length() - r);
+      outcoming_bl.swap(swapped);
+    }
+    if ((unsigned)r < msglen)
+      break;   // socket is full
+  }
+
+  if (outcoming_bl.length()) {
+    if (!open_write) {
+      center->create_file_event(sd, EVENT_WRITABLE, write_handler);
+      open_write = true;
+    }
+    return 1;
+  }
+  if (open_write) {
+    center->delete_file_event(sd, EVENT_WRITABLE);
+    open_write = false;
+  }
+  return 0;
+}
+
+void AsyncConnection::process()
+{
+  Mutex::Locker l(lock);
+  int r = 0;
+
+  while (1) {
+    switch (state) {
+    case STATE_OPEN:
+      {
+	bufferlist bl;
+	r = read_until(1, bl);
+	if (r != 0)
+	  break;
+	char tag = bl.c_str()[0];
+	ldout(cct, 20) << __func__ << " got tag " << (int)tag << dendl;
+	if (tag == CEPH_MSGR_TAG_KEEPALIVE) {
+	  ldout(cct, 20) << __func__ << " got KEEPALIVE" << dendl;
+	} else if (tag == CEPH_MSGR_TAG_KEEPALIVE2) {
+	  state = STATE_OPEN_KEEPALIVE2;
+	} else if (tag == CEPH_MSGR_TAG_KEEPALIVE2_ACK) {
+	  state = STATE_OPEN_KEEPALIVE2_ACK;
+	} else if (tag == CEPH_MSGR_TAG_ACK) {
+	  state = STATE_OPEN_TAG_ACK;
+	} else if (tag == CEPH_MSGR_TAG_MSG) {
+	  state = STATE_OPEN_MESSAGE_HEADER;
+	} else if (tag == CEPH_MSGR_TAG_CLOSE) {
+	  state = STATE_OPEN_TAG_CLOSE;
+	} else {
+	  ldout(cct, 0) << __func__ << " bad tag " << (int)tag << dendl;
+	  r = -1;
+	}
+	break;
+      }
+
+    case STATE_OPEN_KEEPALIVE2:
+      {
+	bufferlist bl;
+	r = read_until(sizeof(ceph_timespec), bl);
+	if (r != 0)
+	  break;
+	ceph_timespec *t = (ceph_timespec*)bl.c_str();
+	keepalive_ack = true;
+	keepalive_ack_stamp = utime_t(*t);
+	ldout(cct, 20) << __func__ << " got KEEPALIVE2 " << keepalive_ack_stamp << dendl;
+	center->dispatch_event_external(write_handler);
+	state = STATE_OPEN;
+	break;
+      }
+
+    case STATE_OPEN_KEEPALIVE2_ACK:
+      {
+	bufferlist bl;
+	r = read_until(sizeof(ceph_timespec), bl);
+	if (r != 0)
+	  break;
+	ceph_timespec *t = (ceph_timespec*)bl.c_str();
+	connection_state->last_keepalive_ack = utime_t(*t);
+	ldout(cct, 20) << __func__ << " got KEEPALIVE_ACK" << dendl;
+	state = STATE_OPEN;
+	break;
+      }
+
+    case STATE_OPEN_TAG_ACK:
+      {
+	bufferlist bl;
+	r = read_until(sizeof(ceph_le64), bl);
+	if (r != 0)
+	  break;
+	ceph_le64 seq;
+	memcpy(&seq, bl.c_str(), sizeof(seq));
+	ldout(cct, 20) << __func__ << " got ACK " << seq << dendl;
+	handle_ack(seq);
+	state = STATE_OPEN;
+	break;
+      }
+
+    case STATE_OPEN_MESSAGE_HEADER:
+      {
+	bufferlist bl;
+	__u32 header_crc = 0;
+	if (connection_state->has_feature(CEPH_FEATURE_NOSRCADDR)) {
+	  r = read_until(sizeof(ceph_msg_header), bl);
+	  if (r != 0)
+	    break;
+	  ceph_msg_header *header = (ceph_msg_header*)bl.c_str();
+	  current_header = *header;
+	  header_crc = ceph_crc32c(0, (unsigned char *)header,
+				   sizeof(*header) - sizeof(header->crc));
+	} else {
+	  r = read_until(sizeof(ceph_msg_header_old), bl);
+	  if (r != 0)
+	    break;
+	  ceph_msg_header_old *header = (ceph_msg_header_old*)bl.c_str();
+	  memcpy(&current_header, header, sizeof(current_header));
+	  current_header.src = header->src.name;
+	  current_header.reserved = header->reserved;
+	  current_header.crc = header->crc;
+	  header_crc = ceph_crc32c(0, (unsigned char *)header,
+				   sizeof(*header) - sizeof(header->crc));
+	}
+
+	ldout(cct, 20) << __func__ << " got envelope type=" << current_header.type
+		       << " src " << entity_name_t(current_header.src)
+		       << " front=" << current_header.front_len
+		       << " data=" << current_header.data_len
+		       << " off " << current_header.data_off << dendl;
+
+	if (header_crc != current_header.crc) {
+	  ldout(cct, 0) << __func__ << " got bad header crc " << header_crc
+			<< " != " << current_header.crc << dendl;
+	  r = -1;
+	  break;
+	}
+
+	recv_stamp = ceph_clock_now(cct);
+	state = STATE_OPEN_MESSAGE_THROTTLE;
+	break;
+      }
+
+    case STATE_OPEN_MESSAGE_THROTTLE:
+      {
+	// we cannot block the event thread on a Throttle, so retry with a
+	// short time event when it is full
+	if (policy.throttler_messages && !got_msg_throttle) {
+	  if (!policy.throttler_messages->get_or_fail()) {
+	    ldout(cct, 10) << __func__ << " wants 1 message from policy throttler "
+			   << policy.throttler_messages->get_current() << "/"
+			   << policy.throttler_messages->get_max()
+			   << " failed, just wait." << dendl;
+	    center->create_time_event(1000, read_handler);
+	    r = 1;
+	    break;
+	  }
+	  got_msg_throttle = true;
+	}
+
+	uint64_t message_size = current_header.front_len + current_header.middle_len
+	  + current_header.data_len;
+	if (message_size) {
+	  if (policy.throttler_bytes && !got_bytes_throttle) {
+	    if (!policy.throttler_bytes->get_or_fail(message_size)) {
+	      ldout(cct, 10) << __func__ << " wants " << message_size
+			     << " bytes from policy throttler "
+			     << policy.throttler_bytes->get_current() << "/"
+			     << policy.throttler_bytes->get_max()
+			     << " failed, just wait." << dendl;
+	      center->create_time_event(1000, read_handler);
+	      r = 1;
+	      break;
+	    }
+	    got_bytes_throttle = true;
+	  }
+	  if (!got_dispatch_throttle) {
+	    if (!async_msgr->dispatch_throttler.get_or_fail(message_size)) {
+	      ldout(cct, 10) << __func__ << " wants " << message_size
+			     << " bytes from dispatch throttler "
+			     << async_msgr->dispatch_throttler.get_current() << "/"
+			     << async_msgr->dispatch_throttler.get_max()
+			     << " failed, just wait." << dendl;
+	      center->create_time_event(1000, read_handler);
+	      r = 1;
+	      break;
+	    }
+	    got_dispatch_throttle = message_size;
+	  }
+	}
+
+	throttle_stamp = ceph_clock_now(cct);
+	state = STATE_OPEN_MESSAGE_READ_FRONT;
+	break;
+      }
+
+    case STATE_OPEN_MESSAGE_READ_FRONT:
+      {
+	front.clear();
+	if (current_header.front_len) {
+	  r = read_until(current_header.front_len, front);
+	  if (r != 0)
+	    break;
+	}
+	state = STATE_OPEN_MESSAGE_READ_MIDDLE;
+	break;
+      }
+
+    case STATE_OPEN_MESSAGE_READ_MIDDLE:
+      {
+	middle.clear();
+	if (current_header.middle_len) {
+	  r = read_until(current_header.middle_len, middle);
+	  if (r != 0)
+	    break;
+	}
+	state = STATE_OPEN_MESSAGE_READ_DATA;
+	break;
+      }
+
+    case STATE_OPEN_MESSAGE_READ_DATA:
+      {
+	data.clear();
+	if (current_header.data_len) {
+	  // TODO: select any rx_buffers the Connection owns, and allocate
+	  // page-aligned buffers like Pipe::read_message does
+	  r = read_until(current_header.data_len, data);
+	  if (r != 0)
+	    break;
+	}
+	state = STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH;
+	break;
+      }
+
+    case STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH:
+      {
+	bufferlist bl;
+	ceph_msg_footer footer;
+	if (connection_state->has_feature(CEPH_FEATURE_MSG_AUTH)) {
+	  r = read_until(sizeof(ceph_msg_footer), bl);
+	  if (r != 0)
+	    break;
+	  footer = *(ceph_msg_footer*)bl.c_str();
+	} else {
+	  r = read_until(sizeof(ceph_msg_footer_old), bl);
+	  if (r != 0)
+	    break;
+	  ceph_msg_footer_old *old_footer = (ceph_msg_footer_old*)bl.c_str();
+	  footer.front_crc = old_footer->front_crc;
+	  footer.middle_crc = old_footer->middle_crc;
+	  footer.data_crc = old_footer->data_crc;
+	  footer.sig = 0;
+	  footer.flags = old_footer->flags;
+	}
+
+	int aborted = (footer.flags & CEPH_MSG_FOOTER_COMPLETE) == 0;
+	ldout(cct, 10) << __func__ << " aborted = " << aborted << dendl;
+	if (aborted) {
+	  ldout(cct, 0) << __func__ << " got " << front.length() << " + "
+			<< middle.length() << " + " << data.length()
+			<< " byte message.. ABORTED" << dendl;
+	  release_throttles();
+	  state = STATE_OPEN;
+	  break;
+	}
+
+	Message *message = decode_message(cct, current_header, footer,
+					  front, middle, data);
+	if (!message) {
+	  ldout(cct, 1) << __func__ << " decode message failed" << dendl;
+	  r = -1;
+	  break;
+	}
+
+	if (session_security.get() &&
+	    session_security->check_message_signature(message)) {
+	  ldout(cct, 0) << __func__ << " signature check failed" << dendl;
+	  message->put();
+	  r = -1;
+	  break;
+	}
+
+	message->set_byte_throttler(policy.throttler_bytes);
+	message->set_message_throttler(policy.throttler_messages);
+	message->set_dispatch_throttle_size(got_dispatch_throttle);
+	got_msg_throttle = got_bytes_throttle = false;
+	got_dispatch_throttle = 0;
+
+	message->set_recv_stamp(recv_stamp);
+	message->set_throttle_stamp(throttle_stamp);
+	message->set_recv_complete_stamp(ceph_clock_now(cct));
+
+	// check received seq#.  if it is old, drop the message.
+	if (message->get_seq() <= in_seq) {
+	  ldout(cct, 0) << __func__ << " got old message "
+			<< message->get_seq() << " <= " << in_seq << " " << message
+			<< ", discarding" << dendl;
+	  async_msgr->dispatch_throttle_release(message->get_dispatch_throttle_size());
+	  message->put();
+	  if (connection_state->has_feature(CEPH_FEATURE_RECONNECT_SEQ) &&
+	      cct->_conf->ms_die_on_old_message)
+	    assert(0 == "old msgs despite reconnect_seq feature");
+	  state = STATE_OPEN;
+	  break;
+	}
+
+	message->set_connection(connection_state.get());
+	in_seq = message->get_seq();
+	ldout(cct, 10) << __func__ << " got message " << message->get_seq()
+		       << " " << message << " " << *message << dendl;
+
+	// let the writer ack it
+	center->dispatch_event_external(write_handler);
+
+	DispatchQueue *in_q = &async_msgr->dispatch_queue;
+	in_q->fast_preprocess(message);
+	if (in_q->can_fast_dispatch(message)) {
+	  lock.Unlock();
+	  in_q->fast_dispatch(message);
+	  lock.Lock();
+	  if (state == STATE_CLOSED) {
+	    r = 1;
+	    break;
+	  }
+	} else {
+	  in_q->enqueue(message, message->get_priority(), conn_id);
+	}
+	state = STATE_OPEN;
+	break;
+      }
+
+    case STATE_OPEN_TAG_CLOSE:
+      {
+	ldout(cct, 20) << __func__ << " got CLOSE" << dendl;
+	_stop();
+	r = 1;
+	break;
+      }
+
+    case STATE_CLOSED:
+    case STATE_WAIT:
+    case STATE_STANDBY:
+      r = 1;
+      break;
+
+    default:
+      r = _process_connection();
+      break;
+    }
+
+    if (r < 0) {
+      fault();
+      return;
+    }
+    if (r > 0)
+      return;       // waiting for io or externally stopped
+  }
+}
+
+int AsyncConnection::_process_connection()
+{
+  int r = 0;
+
+  switch (state) {
+  case STATE_CONNECTING:
+    {
+      assert(!policy.server);
+
+      if (authorizer) {
+	delete authorizer;
+	authorizer = NULL;
+      }
+      got_bad_auth = false;
+
+      if (sd >= 0) {
+	center->delete_file_event(sd, EVENT_READABLE|EVENT_WRITABLE);
+	open_write = false;
+	::close(sd);
+      }
+      recv_bl.clear();
+      outcoming_bl.clear();
+
+      sd = net.nonblock_connect(peer_addr);
+      if (sd < 0) {
+	r = -1;
+	break;
+      }
+
+      center->create_file_event(sd, EVENT_READABLE, read_handler);
+      state = STATE_CONNECTING_WAIT_BANNER;
+      break;
+    }
+
+  case STATE_CONNECTING_WAIT_BANNER:
+    {
+      bufferlist bl;
+      r = read_until(strlen(CEPH_BANNER), bl);
+      if (r != 0)
+	break;
+      if (memcmp(bl.c_str(), CEPH_BANNER, strlen(CEPH_BANNER))) {
+	ldout(cct, 0) << __func__ << " connect protocol error (bad banner) on peer "
+		      << peer_addr << dendl;
+	r = -1;
+	break;
+      }
+
+      ldout(cct, 10) << __func__ << " get banner, ready to send banner" << dendl;
+      bufferlist out;
+      out.append(CEPH_BANNER, strlen(CEPH_BANNER));
+      r = _try_send(out);
+      if (r < 0)
+	break;
+      r = 0;
+      state = STATE_CONNECTING_WAIT_IDENTIFY_PEER;
+      break;
+    }
+
+  case STATE_CONNECTING_WAIT_IDENTIFY_PEER:
+    {
+      bufferlist bl;
+      entity_addr_t paddr, peer_addr_for_me;
+
+      r = read_until(sizeof(ceph_entity_addr)*2, bl);
+      if (r != 0)
+	break;
+      bufferlist::iterator p = bl.begin();
+      ::decode(paddr, p);
+      ::decode(peer_addr_for_me, p);
+      port = peer_addr_for_me.get_port();
+      ldout(cct, 20) << __func__ << " connect read peer addr " << paddr
+		     << " on socket " << sd << dendl;
+      if (peer_addr != paddr) {
+	if (paddr.is_blank_ip() && peer_addr.get_port() == paddr.get_port() &&
+	    peer_addr.get_nonce() == paddr.get_nonce()) {
+	  ldout(cct, 0) << __func__ << " connect claims to be " << paddr << " not "
+			<< peer_addr << " - presumably this is the same node!" << dendl;
+	} else {
+	  ldout(cct, 0) << __func__ << " connect claims to be " << paddr << " not "
+			<< peer_addr << " - wrong node!" << dendl;
+	  r = -1;
+	  break;
+	}
+      }
+
+      ldout(cct, 20) << __func__ << " connect peer addr for me is "
+		     << peer_addr_for_me << dendl;
+      async_msgr->learned_addr(peer_addr_for_me);
+
+      bufferlist myaddrbl;
+      ::encode(async_msgr->get_myaddr(), myaddrbl);
+      r = _try_send(myaddrbl);
+      if (r < 0)
+	break;
+      r = 0;
+      ldout(cct, 10) << __func__ << " connect sent my addr "
+		     << async_msgr->get_myaddr() << dendl;
+      state = STATE_CONNECTING_SEND_CONNECT_MSG;
+      break;
+    }
+
+  case STATE_CONNECTING_SEND_CONNECT_MSG:
+    {
+      if (!got_bad_auth) {
+	delete authorizer;
+	authorizer = async_msgr->get_authorizer(peer_type, false);
+      }
+
+      ceph_msg_connect connect;
+      connect.features = policy.features_supported;
+      connect.host_type = async_msgr->get_myinst().name.type();
+      connect.global_seq = global_seq;
+      connect.connect_seq = connect_seq;
+      connect.protocol_version = async_msgr->get_proto_version(peer_type, true);
+      connect.authorizer_protocol = authorizer ? authorizer->protocol : 0;
+      connect.authorizer_len = authorizer ? authorizer->bl.length() : 0;
+      connect.flags = 0;
+      if (policy.lossy)
+	connect.flags |= CEPH_MSG_CONNECT_LOSSY;  // this is fyi, actually, server decides!
+
+      bufferlist bl;
+      bl.append((char*)&connect, sizeof(connect));
+      if (authorizer)
+	bl.append(authorizer->bl.c_str(), authorizer->bl.length());
+
+      ldout(cct, 10) << __func__ << " connect sending gseq=" << global_seq
+		     << " cseq=" << connect_seq
+		     << " proto=" << connect.protocol_version << dendl;
+      r = _try_send(bl);
+      if (r < 0)
+	break;
+      r = 0;
+      state = STATE_CONNECTING_WAIT_CONNECT_REPLY;
+      break;
+    }
+
+  case STATE_CONNECTING_WAIT_CONNECT_REPLY:
+    {
+      bufferlist bl;
+      r = read_until(sizeof(connect_reply), bl);
+      if (r != 0)
+	break;
+      memcpy(&connect_reply, bl.c_str(), sizeof(connect_reply));
+      connect_reply.features = ceph_sanitize_features(connect_reply.features);
+
+      ldout(cct, 20) << __func__ << " connect got reply tag " << (int)connect_reply.tag
+		     << " connect_seq " << connect_reply.connect_seq
+		     << " global_seq " << connect_reply.global_seq
+		     << " proto " << connect_reply.protocol_version
+		     << " flags " << (int)connect_reply.flags
+		     << " features " << connect_reply.features << dendl;
+      state = STATE_CONNECTING_WAIT_CONNECT_REPLY_AUTH;
+      break;
+    }
+
+  case STATE_CONNECTING_WAIT_CONNECT_REPLY_AUTH:
+    {
+      bufferlist authorizer_reply;
+      if (connect_reply.authorizer_len) {
+	r = read_until(connect_reply.authorizer_len, authorizer_reply);
+	if (r != 0)
+	  break;
+	if (authorizer) {
+	  bufferlist::iterator iter = authorizer_reply.begin();
+	  if (!authorizer->verify_reply(iter)) {
+	    ldout(cct, 0) << __func__ << " failed verifying authorize reply" << dendl;
+	    r = -1;
+	    break;
+	  }
+	}
+      }
+      r = handle_connect_reply(connect_msg, connect_reply);
+      break;
+    }
+
+  case STATE_CONNECTING_WAIT_ACK_SEQ:
+    {
+      bufferlist bl;
+      r = read_until(sizeof(uint64_t), bl);
+      if (r != 0)
+	break;
+      uint64_t newly_acked_seq = 0;
+      memcpy(&newly_acked_seq, bl.c_str(), sizeof(newly_acked_seq));
+      ldout(cct, 2) << __func__ << " got newly_acked_seq " << newly_acked_seq
+		    << " vs out_seq " << out_seq << dendl;
+      while (newly_acked_seq > out_seq) {
+	Message *m = _get_next_outgoing();
+	assert(m);
+	ldout(cct, 2) << __func__ << " discarding previously sent " << m->get_seq()
+		      << " " << *m << dendl;
+	assert(m->get_seq() <= newly_acked_seq);
+	m->put();
+	++out_seq;
+      }
+      bufferlist out;
+      out.append((char*)&in_seq, sizeof(in_seq));
+      r = _try_send(out);
+      if (r < 0)
+	break;
+      r = 0;
+      state = STATE_CONNECTING_READY;
+      break;
+    }
+
+  case STATE_CONNECTING_READY:
+    {
+      // hooray!
+      peer_global_seq = connect_reply.global_seq;
+      policy.lossy = connect_reply.flags & CEPH_MSG_CONNECT_LOSSY;
+      state = STATE_OPEN;
+      connect_seq += 1;
+      assert(connect_seq == connect_reply.connect_seq);
+      backoff_us = 0;
+      connection_state->set_features((uint64_t)connect_reply.features &
+				     (uint64_t)connect_msg.features);
+      ldout(cct, 10) << __func__ << " connect success " << connect_seq
+		     << ", lossy = " << policy.lossy << ", features "
+		     << connection_state->get_features() << dendl;
+
+      if (authorizer) {
+	session_security.reset(
+	    get_auth_session_handler(cct, authorizer->protocol,
+				     authorizer->session_key,
+				     connection_state->get_features()));
+      } else {
+	// no authorizer, so we shouldn't be applying security to messages
+	session_security.reset();
+      }
+
+      async_msgr->dispatch_queue.queue_connect(connection_state.get(), conn_id);
+      async_msgr->ms_deliver_handle_fast_connect(connection_state.get());
+
+      // kick the writer in case messages were queued while connecting
+      center->dispatch_event_external(write_handler);
+      break;
+    }
+
+  case STATE_ACCEPTING:
+    {
+      net.set_socket_options(sd);
+
+      bufferlist bl;
+      bl.append(CEPH_BANNER, strlen(CEPH_BANNER));
+
+      ::encode(async_msgr->get_myaddr(), bl);
+      port = async_msgr->get_myaddr().get_port();
+
+      // and peer's socket addr (they might not know their ip)
+      entity_addr_t socket_addr;
+      socklen_t len = sizeof(socket_addr.ss_addr());
+      r = ::getpeername(sd, (sockaddr*)&socket_addr.ss_addr(), &len);
+      if (r < 0) {
+	ldout(cct, 0) << __func__ << " failed to getpeername "
+		      << cpp_strerror(errno) << dendl;
+	r = -1;
+	break;
+      }
+      ::encode(socket_addr, bl);
+      ldout(cct, 1) << __func__ << " sd=" << sd << " " << socket_addr << dendl;
+
+      r = _try_send(bl);
+      if (r < 0)
+	break;
+      r = 0;
+      center->create_file_event(sd, EVENT_READABLE, read_handler);
+      state = STATE_ACCEPTING_WAIT_BANNER_ADDR;
+      break;
+    }
+
+  case STATE_ACCEPTING_WAIT_BANNER_ADDR:
+    {
+      bufferlist bl;
+      r = read_until(strlen(CEPH_BANNER) + sizeof(ceph_entity_addr), bl);
+      if (r != 0)
+	break;
+
+      if (memcmp(bl.c_str(), CEPH_BANNER, strlen(CEPH_BANNER))) {
+	ldout(cct, 1) << __func__ << " accept peer sent bad banner '" << bl.c_str()
+		      << "' (should be '" << CEPH_BANNER << "')" << dendl;
+	r = -1;
+	break;
+      }
+
+      bufferlist addr_bl;
+      entity_addr_t peer_addr;
+      addr_bl.substr_of(bl, strlen(CEPH_BANNER), sizeof(ceph_entity_addr));
+      {
+	bufferlist::iterator ti = addr_bl.begin();
+	::decode(peer_addr, ti);
+      }
+
+      ldout(cct, 10) << __func__ << " accept peer addr is " << peer_addr << dendl;
+      if (peer_addr.is_blank_ip()) {
+	// peer apparently doesn't know what ip they have; figure it out for them.
+	entity_addr_t socket_addr;
+	socklen_t len = sizeof(socket_addr.ss_addr());
+	::getpeername(sd, (sockaddr*)&socket_addr.ss_addr(), &len);
+	int port = peer_addr.get_port();
+	peer_addr.addr = socket_addr.addr;
+	peer_addr.set_port(port);
+	ldout(cct, 0) << __func__ << " accept peer addr is really " << peer_addr
+		      << " (socket is " << socket_addr << ")" << dendl;
+      }
+      set_peer_addr(peer_addr);  // so that connection_state gets set up
+      state = STATE_ACCEPTING_WAIT_CONNECT_MSG;
+      break;
+    }
+
+  case STATE_ACCEPTING_WAIT_CONNECT_MSG:
+    {
+      bufferlist bl;
+      r = read_until(sizeof(connect_msg), bl);
+      if (r != 0)
+	break;
+      memcpy(&connect_msg, bl.c_str(), sizeof(connect_msg));
+      // sanitize features
+      connect_msg.features = ceph_sanitize_features(connect_msg.features);
+      state = STATE_ACCEPTING_WAIT_CONNECT_MSG_AUTH;
+      break;
+    }
+
+  case STATE_ACCEPTING_WAIT_CONNECT_MSG_AUTH:
+    {
+      bufferlist authorizer_bl;
+      if (connect_msg.authorizer_len) {
+	r = read_until(connect_msg.authorizer_len, authorizer_bl);
+	if (r != 0)
+	  break;
+      }
+      r = handle_connect_msg(connect_msg, authorizer_bl);
+      break;
+    }
+
+  case STATE_ACCEPTING_READY:
+    {
+      state = STATE_OPEN;
+      center->dispatch_event_external(write_handler);
+      break;
+    }
+
+  default:
+    {
+      lderr(cct) << __func__ << " bad state " << get_state_name(state) << dendl;
+      assert(0 == "bad async connection state");
+      break;
+    }
+  }
+
+  return r;
+}
+
+int AsyncConnection::handle_connect_reply(ceph_msg_connect &connect,
+					  ceph_msg_connect_reply &reply)
+{
+  uint64_t feat_missing;
+
+  if (reply.tag == CEPH_MSGR_TAG_FEATURES) {
+    ldout(cct, 0) << __func__ << " connect protocol feature mismatch, my "
+		  << std::hex << policy.features_supported << " < peer "
+		  << reply.features << " missing "
+		  << (reply.features & ~policy.features_supported)
+		  << std::dec << dendl;
+    return -1;
+  }
+
+  if (reply.tag == CEPH_MSGR_TAG_BADPROTOVER) {
+    ldout(cct, 0) << __func__ << " connect protocol version mismatch, my "
+		  << async_msgr->get_proto_version(peer_type, true)
+		  << " != " << reply.protocol_version << dendl;
+    return -1;
+  }
+
+  if (reply.tag == CEPH_MSGR_TAG_BADAUTHORIZER) {
+    ldout(cct, 0) << __func__ << " connect got BADAUTHORIZER" << dendl;
+    if (got_bad_auth)
+      return -1;
+    got_bad_auth = true;
+    delete authorizer;
+    authorizer = async_msgr->get_authorizer(peer_type, true);  // try harder
+    state = STATE_CONNECTING_SEND_CONNECT_MSG;
+    return 0;
+  }
+
+  if (reply.tag == CEPH_MSGR_TAG_RESETSESSION) {
+    ldout(cct, 0) << __func__ << " connect got RESETSESSION" << dendl;
+    was_session_reset();
+    connect_seq = 0;
+    state = STATE_CONNECTING_SEND_CONNECT_MSG;
+    return 0;
+  }
+
+  if (reply.tag == CEPH_MSGR_TAG_RETRY_GLOBAL) {
+    global_seq = async_msgr->get_global_seq(reply.global_seq);
+    ldout(cct, 10) << __func__ << " connect got RETRY_GLOBAL "
+		   << reply.global_seq << " chose new " << global_seq << dendl;
+    state = STATE_CONNECTING_SEND_CONNECT_MSG;
+    return 0;
+  }
+
+  if (reply.tag == CEPH_MSGR_TAG_RETRY_SESSION) {
+    assert(reply.connect_seq > connect_seq);
+    ldout(cct, 10) << __func__ << " connect got RETRY_SESSION " << connect_seq
+		   << " -> " << reply.connect_seq << dendl;
+    connect_seq = reply.connect_seq;
+    state = STATE_CONNECTING_SEND_CONNECT_MSG;
+    return 0;
+  }
+
+  if (reply.tag == CEPH_MSGR_TAG_WAIT) {
+    ldout(cct, 3) << __func__ << " connect got WAIT (connection race)" << dendl;
+    state = STATE_WAIT;
+    return 1;
+  }
+
+  if (reply.tag == CEPH_MSGR_TAG_READY ||
+      reply.tag == CEPH_MSGR_TAG_SEQ) {
+    feat_missing = policy.features_required & ~(uint64_t)reply.features;
+    if (feat_missing) {
+      ldout(cct, 1) << __func__ << " missing required features "
+		    << std::hex << feat_missing << std::dec << dendl;
+      return -1;
+    }
+
+    if (reply.tag == CEPH_MSGR_TAG_SEQ) {
+      ldout(cct, 10) << __func__
+		     << " got CEPH_MSGR_TAG_SEQ, reading acked_seq and writing in_seq"
+		     << dendl;
+      state = STATE_CONNECTING_WAIT_ACK_SEQ;
+      return 0;
+    }
+
+    state = STATE_CONNECTING_READY;
+    return 0;
+  }
+
+  ldout(cct, 0) << __func__ << " connect got bad tag " << (int)reply.tag << dendl;
+  return -1;
+}
+
+int AsyncConnection::handle_connect_msg(ceph_msg_connect &connect,
+					bufferlist &authorizer_bl)
+{
+  ldout(cct, 20) << __func__ << " accept got peer connect_seq "
+		 << connect.connect_seq << " global_seq "
+		 << connect.global_seq << dendl;
+  set_peer_type(connect.host_type);
+  policy = async_msgr->get_policy(connect.host_type);
+  ldout(cct, 10) << __func__ << " accept of host_type " << connect.host_type
+		 << ", policy.lossy=" << policy.lossy
+		 << " policy.server=" << policy.server
+		 << " policy.standby=" << policy.standby
+		 << " policy.resetcheck=" << policy.resetcheck << dendl;
+
+  ceph_msg_connect_reply reply;
+  memset(&reply, 0, sizeof(reply));
+  reply.protocol_version = async_msgr->get_proto_version(peer_type, false);
+
+  // mismatch?
+  ldout(cct, 10) << __func__ << " accept my proto " << reply.protocol_version
+		 << ", their proto " << connect.protocol_version << dendl;
+  if (connect.protocol_version != reply.protocol_version) {
+    reply.tag = CEPH_MSGR_TAG_BADPROTOVER;
+    return _reply_accept(reply, authorizer_reply_bl);
+  }
+
+  // require signatures for cephx?
+  if (connect.authorizer_protocol == CEPH_AUTH_CEPHX) {
+    if (peer_type == CEPH_ENTITY_TYPE_OSD ||
+	peer_type == CEPH_ENTITY_TYPE_MDS) {
+      if (cct->_conf->cephx_require_signatures ||
+	  cct->_conf->cephx_cluster_require_signatures) {
+	ldout(cct, 10) << __func__
+		       << " using cephx, requiring MSG_AUTH feature bit for cluster"
+		       << dendl;
+	policy.features_required |= CEPH_FEATURE_MSG_AUTH;
+      }
+    } else {
+      if (cct->_conf->cephx_require_signatures ||
+	  cct->_conf->cephx_service_require_signatures) {
+	ldout(cct, 10) << __func__
+		       << " using cephx, requiring MSG_AUTH feature bit for service"
+		       << dendl;
+	policy.features_required |= CEPH_FEATURE_MSG_AUTH;
+      }
+    }
+  }
+
+  uint64_t feat_missing = policy.features_required & ~(uint64_t)connect.features;
+  if (feat_missing) {
+    ldout(cct, 1) << __func__ << " peer missing required features " << std::hex
+		  << feat_missing << std::dec << dendl;
+    reply.tag = CEPH_MSGR_TAG_FEATURES;
+    return _reply_accept(reply, authorizer_reply_bl);
+  }
+
+  // check the authorizer
+  bool authorizer_valid;
+  CryptoKey session_key;
+  authorizer_reply_bl.clear();
+  if (!async_msgr->verify_authorizer(connection_state.get(), peer_type,
+				     connect.authorizer_protocol, authorizer_bl,
+				     authorizer_reply_bl, authorizer_valid,
+				     session_key) ||
+      !authorizer_valid) {
+    ldout(cct, 0) << __func__ << " accept: got bad authorizer" << dendl;
+    session_security.reset();
+    reply.tag = CEPH_MSGR_TAG_BADAUTHORIZER;
+    return _reply_accept(reply, authorizer_reply_bl);
+  }
+
+  // existing connection for this peer?
+  AsyncConnectionRef existing = async_msgr->lookup_conn(peer_addr);
+  if (existing == this)
+    existing = NULL;
+  if (existing) {
+    // NOTE: unlike Pipe::accept we never take the existing connection's
+    // lock here (it belongs to another event thread); racing state reads
+    // are benign because the worst case is an unnecessary session reset.
+    if (connect.global_seq < existing->peer_global_seq) {
+      ldout(cct, 10) << __func__ << " accept existing " << existing << ".gseq "
+		     << existing->peer_global_seq << " > " << connect.global_seq
+		     << ", RETRY_GLOBAL" << dendl;
+      reply.tag = CEPH_MSGR_TAG_RETRY_GLOBAL;
+      reply.global_seq = existing->peer_global_seq;
+      return _reply_accept(reply, authorizer_reply_bl);
+    }
+
+    if (!existing->policy.lossy &&
+	connect.connect_seq == existing->connect_seq &&
+	existing->state == STATE_CONNECTING &&
+	peer_addr > async_msgr->get_myaddr()) {
+      // connection race and our outgoing attempt should win
+      ldout(cct, 10) << __func__ << " accept connection race, sending WAIT" << dendl;
+      reply.tag = CEPH_MSGR_TAG_WAIT;
+      return _reply_accept(reply, authorizer_reply_bl);
+    }
+
+    // otherwise the incoming connection wins.  We can't steal the
+    // existing session state (it lives in another thread); instead the
+    // old connection is torn down and lossless peers see a reset.
+    ldout(cct, 10) << __func__ << " accept replacing existing " << existing << dendl;
+    existing->stop();
+    if (!existing->policy.lossy)
+      async_msgr->dispatch_queue.queue_reset(existing->connection_state.get(),
+					     existing->conn_id);
+  } else if (policy.resetcheck && connect.connect_seq > 0) {
+    // we reset, and they are opening a new session
+    ldout(cct, 0) << __func__ << " accept we reset (peer sent cseq "
+		  << connect.connect_seq << "), sending RESETSESSION" << dendl;
+    reply.tag = CEPH_MSGR_TAG_RESETSESSION;
+    return _reply_accept(reply, authorizer_reply_bl);
+  }
+
+  // open
+  connect_seq = connect.connect_seq + 1;
+  peer_global_seq = connect.global_seq;
+  ldout(cct, 10) << __func__ << " accept success, connect_seq = " << connect_seq
+		 << ", sending READY" << dendl;
+
+  reply.tag = CEPH_MSGR_TAG_READY;
+  reply.features = policy.features_supported;
+  reply.global_seq = async_msgr->get_global_seq();
+  reply.connect_seq = connect_seq;
+  reply.flags = 0;
+  reply.authorizer_len = authorizer_reply_bl.length();
+  if (policy.lossy)
+    reply.flags = reply.flags | CEPH_MSG_CONNECT_LOSSY;
+
+  connection_state->set_features((uint64_t)reply.features &
+				 (uint64_t)connect.features);
+  ldout(cct, 10) << __func__ << " accept features "
+		 << connection_state->get_features() << dendl;
+
+  session_security.reset(
+      get_auth_session_handler(cct, connect.authorizer_protocol, session_key,
+			       connection_state->get_features()));
+
+  bufferlist reply_bl;
+  reply_bl.append((char*)&reply, sizeof(reply));
+  if (reply.authorizer_len)
+    reply_bl.append(authorizer_reply_bl.c_str(), authorizer_reply_bl.length());
+  authorizer_reply_bl.clear();
+  int r = _try_send(reply_bl);
+  if (r < 0)
+    return -1;
+
+  // register and notify
+  async_msgr->accept_conn(this);
+  async_msgr->dispatch_queue.queue_accept(connection_state.get(), conn_id);
+  async_msgr->ms_deliver_handle_fast_accept(connection_state.get());
+
+  state = STATE_ACCEPTING_READY;
+  ldout(cct, 20) << __func__ << " accept done" << dendl;
+  return 0;
+}
+
+int AsyncConnection::_reply_accept(ceph_msg_connect_reply &reply,
+				   bufferlist &authorizer_reply)
+{
+  reply.features = ((uint64_t)connect_msg.features & policy.features_supported) |
+    policy.features_required;
+  reply.authorizer_len = authorizer_reply.length();
+
+  bufferlist reply_bl;
+  reply_bl.append((char*)&reply, sizeof(reply));
+  if (reply.authorizer_len)
+    reply_bl.append(authorizer_reply.c_str(), authorizer_reply.length());
+  authorizer_reply.clear();
+  int r = _try_send(reply_bl);
+  if (r < 0)
+    return -1;
+  // wait for the peer's next connect message (or a WAIT shutdown)
+  if (reply.tag == CEPH_MSGR_TAG_WAIT) {
+    state = STATE_WAIT;
+    return 1;
+  }
+  state = STATE_ACCEPTING_WAIT_CONNECT_MSG;
+  return 0;
+}
+
+void AsyncConnection::connect(const entity_addr_t &addr, int type)
+{
+  ldout(cct, 10) << __func__ << " csq=" << connect_seq << dendl;
+
+  Mutex::Locker l(lock);
+  set_peer_type(type);
+  set_peer_addr(addr);
+  policy = async_msgr->get_policy(type);
+  global_seq = async_msgr->get_global_seq();
+  state = STATE_CONNECTING;
+  // rescheduler connection in working thread
+  center->dispatch_event_external(read_handler);
+}
+
+void AsyncConnection::accept(int incoming)
+{
+  ldout(cct, 10) << __func__ << " sd=" << incoming << dendl;
+  Mutex::Locker l(lock);
+  assert(sd < 0);
+  sd = incoming;
+  state = STATE_ACCEPTING;
+  net.set_nonblock(sd);
+  // rescheduler connection in working thread
+  center->dispatch_event_external(read_handler);
+}
+
+int AsyncConnection::send_message(Message *m)
+{
+  ldout(cct, 10) << __func__ << " m=" << m << dendl;
+  Mutex::Locker l(lock);
+  if (state == STATE_CLOSED) {
+    ldout(cct, 10) << __func__ << " connection closed, dropping " << m << dendl;
+    m->put();
+    return 0;
+  }
+  out_q[m->get_priority()].push_back(m);
+  center->dispatch_event_external(write_handler);
+  return 0;
+}
+
+void AsyncConnection::send_keepalive()
+{
+  Mutex::Locker l(lock);
+  keepalive = true;
+  center->dispatch_event_external(write_handler);
+}
+
+void AsyncConnection::requeue_sent()
+{
+  assert(lock.is_locked());
+  if (sent.empty())
+    return;
+
+  list<Message*>& rq = out_q[CEPH_MSG_PRIO_HIGHEST];
+  while (!sent.empty()) {
+    Message *m = sent.back();
+    sent.pop_back();
+    ldout(cct, 10) << __func__ << " " << *m << " for resend seq " << out_seq
+		   << " (" << m->get_seq() << ")" << dendl;
+    rq.push_front(m);
+    out_seq--;
+  }
+}
+
+void AsyncConnection::discard_out_queue()
+{
+  assert(lock.is_locked());
+  ldout(cct, 10) << __func__ << " started" << dendl;
+
+  for (list<Message*>::iterator p = sent.begin(); p != sent.end(); ++p) {
+    ldout(cct, 20) << __func__ << " discard " << *p << dendl;
+    (*p)->put();
+  }
+  sent.clear();
+  for (map<int, list<Message*> >::iterator p = out_q.begin();
+       p != out_q.end(); ++p)
+    for (list<Message*>::iterator r = p->second.begin(); r != p->second.end();
+	 ++r) {
+      ldout(cct, 20) << __func__ << " discard " << *r << dendl;
+      (*r)->put();
+    }
+  out_q.clear();
+  outcoming_bl.clear();
+}
+
+int AsyncConnection::randomize_out_seq()
+{
+  if (connection_state->get_features() & CEPH_FEATURE_MSG_AUTH) {
+    // Set out_seq to a random value, so CRC won't be predictable.   Don't bother checking seq_error
+    // here.  We'll check it on the call.  PLR
+    int seq_error = get_random_bytes((char *)&out_seq, sizeof(out_seq));
+    out_seq &= SEQ_MASK;
+    ldout(cct, 10) << __func__ << " randomize_out_seq " << out_seq << dendl;
+    return seq_error;
+  } else {
+    // previously, seq #'s always started at 0.
+    out_seq = 0;
+    return 0;
+  }
+}
+
+void AsyncConnection::was_session_reset()
+{
+  assert(lock.is_locked());
+  ldout(cct, 10) << __func__ << " started" << dendl;
+  discard_out_queue();
+
+  async_msgr->dispatch_queue.queue_remote_reset(connection_state.get(), conn_id);
+
+  if (randomize_out_seq()) {
+    lsubdout(cct, ms, 15) << __func__ << " could not get random bytes to set seq number for session reset; set seq number to " << out_seq << dendl;
+  }
+
+  in_seq = 0;
+  connect_seq = 0;
+}
+
+void AsyncConnection::handle_ack(uint64_t seq)
+{
+  assert(lock.is_locked());
+  // trim sent list
+  while (!sent.empty() && sent.front()->get_seq() <= seq) {
+    Message *m = sent.front();
+    sent.pop_front();
+    ldout(cct, 10) << __func__ << " got ack seq " << seq
+		   << " >= " << m->get_seq() << " on " << m << " " << *m << dendl;
+    m->put();
+  }
+}
+
+void AsyncConnection::fault()
+{
+  assert(lock.is_locked());
+  ldout(cct, 10) << __func__ << dendl;
+
+  if (state == STATE_CLOSED) {
+    ldout(cct, 10) << __func__ << " connection is already closed" << dendl;
+    return;
+  }
+
+  release_throttles();
+
+  if (policy.lossy &&
+      !(state >= STATE_CONNECTING && state < STATE_CONNECTING_READY)) {
+    ldout(cct, 10) << __func__ << " on lossy channel, failing" << dendl;
+    connection_state->failed = true;
+    async_msgr->dispatch_queue.queue_reset(connection_state.get(), conn_id);
+    _stop();
+    return;
+  }
+
+  if (sd >= 0) {
+    center->delete_file_event(sd, EVENT_READABLE|EVENT_WRITABLE);
+    open_write = false;
+    ::close(sd);
+    sd = -1;
+  }
+  recv_bl.clear();
+  outcoming_bl.clear();
+
+  requeue_sent();
+
+  if (policy.standby && !is_queued()) {
+    ldout(cct, 0) << __func__ << " with nothing to send, going to standby" << dendl;
+    state = STATE_STANDBY;
+    return;
+  }
+  if (policy.server) {
+    ldout(cct, 0) << __func__ << " server, going to standby" << dendl;
+    state = STATE_STANDBY;
+    return;
+  }
+
+  // requeue the connect with backoff
+  if (backoff_us == 0) {
+    backoff_us = (uint64_t)(cct->_conf->ms_initial_backoff * 1000000);
+  } else {
+    backoff_us *= 2;
+    uint64_t max = (uint64_t)(cct->_conf->ms_max_backoff * 1000000);
+    if (backoff_us > max)
+      backoff_us = max;
+  }
+  connect_seq++;
+  global_seq = async_msgr->get_global_seq();
+  state = STATE_CONNECTING;
+  ldout(cct, 10) << __func__ << " waiting " << backoff_us
+		 << "us before reconnect" << dendl;
+  center->create_time_event(backoff_us, read_handler);
+}
+
+void AsyncConnection::stop()
+{
+  // hand the actual teardown to the owning event thread; this may be
+  // called from arbitrary threads (mark_down, replacement)
+  center->dispatch_event_external(reset_handler);
+}
+
+void AsyncConnection::handle_stop()
+{
+  Mutex::Locker l(lock);
+  if (state != STATE_CLOSED)
+    _stop();
+}
+
+void AsyncConnection::_stop()
+{
+  assert(lock.is_locked());
+  ldout(cct, 10) << __func__ << dendl;
+
+  release_throttles();
+
+  async_msgr->unregister_conn(this);
+  if (sd >= 0) {
+    center->delete_file_event(sd, EVENT_READABLE|EVENT_WRITABLE);
+    ::shutdown(sd, SHUT_RDWR);
+    ::close(sd);
+    sd = -1;
+  }
+  open_write = false;
+  state = STATE_CLOSED;
+  discard_out_queue();
+  if (connection_state->clear_pipe(this))
+    async_msgr->dispatch_queue.queue_reset(connection_state.get(), conn_id);
+}
+
+void AsyncConnection::release_throttles()
+{
+  if (got_msg_throttle) {
+    policy.throttler_messages->put();
+    got_msg_throttle = false;
+  }
+  if (got_bytes_throttle) {
+    uint64_t message_size = current_header.front_len + current_header.middle_len
+      + current_header.data_len;
+    policy.throttler_bytes->put(message_size);
+    got_bytes_throttle = false;
+  }
+  if (got_dispatch_throttle) {
+    async_msgr->dispatch_throttle_release(got_dispatch_throttle);
+    got_dispatch_throttle = 0;
+  }
+}
+
+int AsyncConnection::write_message(Message *m)
+{
+  assert(lock.is_locked());
+  m->set_seq(++out_seq);
+  if (!policy.lossy) {
+    // put on sent list
+    sent.push_back(m);
+    m->get();
+  }
+
+  // associate message with Connection (for benefit of encode_payload)
+  m->set_connection(connection_state.get());
+
+  uint64_t features = connection_state->get_features();
+  if (m->empty_payload())
+    ldout(cct, 20) << __func__ << " encoding " << m->get_seq() << " features "
+		   << features << " " << m << " " << *m << dendl;
+  else
+    ldout(cct, 20) << __func__ << " half-reencoding " << m->get_seq()
+		   << " features " << features << " " << m << " " << *m << dendl;
+
+  // encode and copy out of *m
+  m->encode(features, !cct->_conf->ms_nocrc);
+
+  ceph_msg_header& header = m->get_header();
+  ceph_msg_footer& footer = m->get_footer();
+
+  // sign the message, if session security is set up
+  if (session_security.get()) {
+    if (session_security->sign_message(m)) {
+      ldout(cct, 20) << __func__ << " failed to sign seq # " << header.seq
+		     << "): sig = " << footer.sig << dendl;
+    } else {
+      ldout(cct, 20) << __func__ << " signed seq # " << header.seq
+		     << "): sig = " << footer.sig << dendl;
+    }
+  }
+
+  bufferlist bl;
+  bl.append(CEPH_MSGR_TAG_MSG);
+
+  // send envelope
+  ceph_msg_header_old oldheader;
+  if (connection_state->has_feature(CEPH_FEATURE_NOSRCADDR)) {
+    bl.append((char*)&header, sizeof(header));
+  } else {
+    memcpy(&oldheader, &header, sizeof(header));
+    oldheader.src.name = header.src;
+    oldheader.src.addr = connection_state->get_peer_addr();
+    oldheader.orig_src = oldheader.src;
+    oldheader.reserved = header.reserved;
+    oldheader.crc = ceph_crc32c(0, (unsigned char*)&oldheader,
+				sizeof(oldheader) - sizeof(oldheader.crc));
+    bl.append((char*)&oldheader, sizeof(oldheader));
+  }
+
+  // payload (front+middle+data); these are reference-counted segments,
+  // so this is cheap and the sendmsg below is scatter-gather
+  bl.append(m->get_payload());
+  bl.append(m->get_middle());
+  bl.append(m->get_data());
+
+  // send footer; if receiver doesn't support signatures, use the old footer
+  if (connection_state->has_feature(CEPH_FEATURE_MSG_AUTH)) {
+    bl.append((char*)&footer, sizeof(footer));
+  } else {
+    ceph_msg_footer_old old_footer;
+    if (cct->_conf->ms_nocrc)
+      old_footer.flags = CEPH_MSG_FOOTER_NOCRC;
+    else
+      old_footer.flags = footer.flags;
+    old_footer.front_crc = footer.front_crc;
+    old_footer.middle_crc = footer.middle_crc;
+    old_footer.data_crc = footer.data_crc;
+    bl.append((char*)&old_footer, sizeof(old_footer));
+  }
+
+  ldout(cct, 20) << __func__ << " sending " << m->get_seq() << " " << m << dendl;
+  int rc = _try_send(bl);
+  if (rc < 0)
+    ldout(cct, 1) << __func__ << " error sending " << m << ", "
+		  << cpp_strerror(errno) << dendl;
+  m->put();
+  return rc;
+}
+
+void AsyncConnection::handle_write()
+{
+  ldout(cct, 10) << __func__ << dendl;
+  Mutex::Locker l(lock);
+
+  if (state == STATE_STANDBY && !policy.server && is_queued()) {
+    ldout(cct, 10) << __func__ << " state is standby, reconnecting" << dendl;
+    connect_seq++;
+    global_seq = async_msgr->get_global_seq();
+    state = STATE_CONNECTING;
+    center->dispatch_event_external(read_handler);
+    return;
+  }
+
+  if (state != STATE_OPEN &&
+      !(state > STATE_OPEN && state < STATE_OPEN_TAG_CLOSE)) {
+    // not ready to send yet; the messages stay in out_q until the
+    // session is established
+    return;
+  }
+
+  int r = 0;
+  if (keepalive) {
+    bufferlist bl;
+    if (connection_state->has_feature(CEPH_FEATURE_MSGR_KEEPALIVE2)) {
+      struct ceph_timespec ts;
+      utime_t t = ceph_clock_now(cct);
+      t.encode_timeval(&ts);
+      bl.append(CEPH_MSGR_TAG_KEEPALIVE2);
+      bl.append((char*)&ts, sizeof(ts));
+    } else {
+      bl.append(CEPH_MSGR_TAG_KEEPALIVE);
+    }
+    keepalive = false;
+    r = _try_send(bl);
+    if (r < 0) {
+      fault();
+      return;
+    }
+  }
+
+  if (keepalive_ack) {
+    bufferlist bl;
+    struct ceph_timespec ts;
+    keepalive_ack_stamp.encode_timeval(&ts);
+    bl.append(CEPH_MSGR_TAG_KEEPALIVE2_ACK);
+    bl.append((char*)&ts, sizeof(ts));
+    keepalive_ack = false;
+    r = _try_send(bl);
+    if (r < 0) {
+      fault();
+      return;
+    }
+  }
+
+  // send ack?
+  if (in_seq > in_seq_acked) {
+    uint64_t send_seq = in_seq;
+    bufferlist bl;
+    ceph_le64 s;
+    s = send_seq;
+    bl.append(CEPH_MSGR_TAG_ACK);
+    bl.append((char*)&s, sizeof(s));
+    r = _try_send(bl);
+    if (r < 0) {
+      fault();
+      return;
+    }
+    in_seq_acked = send_seq;
+  }
+
+  while (1) {
+    Message *m = _get_next_outgoing();
+    if (!m)
+      break;
+    r = write_message(m);
+    if (r < 0) {
+      fault();
+      return;
+    }
+    if (r > 0)
+      break;   // out buffer is full; the writable event continues the send
+  }
+
+  if (r == 0 && close_on_empty && !is_queued() && sent.empty()) {
+    ldout(cct, 10) << __func__ << " out and sent queues empty, closing" << dendl;
+    bufferlist bl;
+    bl.append(CEPH_MSGR_TAG_CLOSE);
+    _try_send(bl);
+    _stop();
+  }
+}
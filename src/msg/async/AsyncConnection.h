@@ -0,0 +1,243 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNCCONNECTION_H
+#define CEPH_MSG_ASYNCCONNECTION_H
+
+#include <map>
+using namespace std;
+
+#include "auth/AuthSessionHandler.h"
+#include "common/Mutex.h"
+#include "include/buffer.h"
+#include "msg/Messenger.h"
+#include "Event.h"
+#include "net_handler.h"
+
+class AsyncMessenger;
+
+/*
+ * AsyncConnection is the event-driven counterpart of Pipe: it owns one
+ * nonblocking socket and implements the messenger wire protocol as a
+ * state machine driven from an EventCenter rather than from dedicated
+ * reader/writer threads.  All protocol processing happens in the owning
+ * EventCenter's thread; send_message() may be called from any thread and
+ * hands the message over via the out_q and an external event.
+ *
+ * This is still experimental: message replay across reconnects of
+ * lossless sessions is cruder than Pipe's (we requeue what was never
+ * acked, but do not negotiate in-flight sequence state with TAG_SEQ on
+ * replacement), and delay injection is not supported.
+ */
+class AsyncConnection : public RefCountedObject {
+  int read_until(uint64_t needed, bufferlist &bl);
+  int _try_send(bufferlist &bl, bool send=true);
+  int _process_connection();
+  void _stop();
+  int handle_connect_reply(ceph_msg_connect &connect, ceph_msg_connect_reply &r);
+  int handle_connect_msg(ceph_msg_connect &m, bufferlist &authorizer_bl);
+  int _reply_accept(ceph_msg_connect_reply &reply, bufferlist &authorizer_reply);
+  void was_session_reset();
+  void handle_ack(uint64_t seq);
+  void requeue_sent();
+  void discard_out_queue();
+  int randomize_out_seq();
+  void fault();
+  void release_throttles();
+  int write_message(Message *m);
+
+  Message *_get_next_outgoing() {
+    assert(lock.is_locked());
+    Message *m = 0;
+    while (!m && !out_q.empty()) {
+      map<int, list<Message*> >::reverse_iterator p = out_q.rbegin();
+      if (!p->second.empty()) {
+	m = p->second.front();
+	p->second.pop_front();
+      }
+      if (p->second.empty())
+	out_q.erase(p->first);
+    }
+    return m;
+  }
+
+ public:
+  AsyncConnection(CephContext *cct, AsyncMessenger *m, EventCenter *c);
+  ~AsyncConnection();
+
+  ostream& _conn_prefix(std::ostream *_dout);
+
+  enum {
+    STATE_NONE,
+    STATE_OPEN,
+    STATE_OPEN_KEEPALIVE2,
+    STATE_OPEN_KEEPALIVE2_ACK,
+    STATE_OPEN_TAG_ACK,
+    STATE_OPEN_MESSAGE_HEADER,
+    STATE_OPEN_MESSAGE_THROTTLE,
+    STATE_OPEN_MESSAGE_READ_FRONT,
+    STATE_OPEN_MESSAGE_READ_MIDDLE,
+    STATE_OPEN_MESSAGE_READ_DATA,
+    STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH,
+    STATE_OPEN_TAG_CLOSE,
+    STATE_CONNECTING,
+    STATE_CONNECTING_WAIT_BANNER,
+    STATE_CONNECTING_WAIT_IDENTIFY_PEER,
+    STATE_CONNECTING_SEND_CONNECT_MSG,
+    STATE_CONNECTING_WAIT_CONNECT_REPLY,
+    STATE_CONNECTING_WAIT_CONNECT_REPLY_AUTH,
+    STATE_CONNECTING_WAIT_ACK_SEQ,
+    STATE_CONNECTING_READY,
+    STATE_ACCEPTING,
+    STATE_ACCEPTING_WAIT_BANNER_ADDR,
+    STATE_ACCEPTING_WAIT_CONNECT_MSG,
+    STATE_ACCEPTING_WAIT_CONNECT_MSG_AUTH,
+    STATE_ACCEPTING_READY,
+    STATE_STANDBY,
+    STATE_CLOSED,
+    STATE_WAIT,
+  };
+
+  static const char *get_state_name(int state) {
+    const char* const statenames[] = {"STATE_NONE",
+                                      "STATE_OPEN",
+                                      "STATE_OPEN_KEEPALIVE2",
+                                      "STATE_OPEN_KEEPALIVE2_ACK",
+                                      "STATE_OPEN_TAG_ACK",
+                                      "STATE_OPEN_MESSAGE_HEADER",
+                                      "STATE_OPEN_MESSAGE_THROTTLE",
+                                      "STATE_OPEN_MESSAGE_READ_FRONT",
+                                      "STATE_OPEN_MESSAGE_READ_MIDDLE",
+                                      "STATE_OPEN_MESSAGE_READ_DATA",
+                                      "STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH",
+                                      "STATE_OPEN_TAG_CLOSE",
+                                      "STATE_CONNECTING",
+                                      "STATE_CONNECTING_WAIT_BANNER",
+                                      "STATE_CONNECTING_WAIT_IDENTIFY_PEER",
+                                      "STATE_CONNECTING_SEND_CONNECT_MSG",
+                                      "STATE_CONNECTING_WAIT_CONNECT_REPLY",
+                                      "STATE_CONNECTING_WAIT_CONNECT_REPLY_AUTH",
+                                      "STATE_CONNECTING_WAIT_ACK_SEQ",
+                                      "STATE_CONNECTING_READY",
+                                      "STATE_ACCEPTING",
+                                      "STATE_ACCEPTING_WAIT_BANNER_ADDR",
+                                      "STATE_ACCEPTING_WAIT_CONNECT_MSG",
+                                      "STATE_ACCEPTING_WAIT_CONNECT_MSG_AUTH",
+                                      "STATE_ACCEPTING_READY",
+                                      "STATE_STANDBY",
+                                      "STATE_CLOSED",
+                                      "STATE_WAIT"};
+    return statenames[state];
+  }
+
+  AsyncMessenger *async_msgr;
+  CephContext *cct;
+  int state;
+  int sd;
+  int port;
+  int peer_type;
+  entity_addr_t peer_addr;
+  Messenger::Policy policy;
+  ConnectionRef connection_state;
+
+  Mutex lock;       ///< protects out_q and the fields shared with other threads
+  uint64_t conn_id; ///< assigned by the messenger; keys the DispatchQueue
+
+  /// called from the messenger (any thread); queues m and pokes the event loop
+  int send_message(Message *m);
+  void send_keepalive();
+  /// start an outgoing session (caller must have registered us)
+  void connect(const entity_addr_t& addr, int type);
+  /// take ownership of an accepted socket
+  void accept(int newsd);
+  /// externally stop this connection (mark_down); safe from any thread
+  void stop();
+  /// flush the queue, send a close tag, then stop
+  void mark_down_on_empty() {
+    Mutex::Locker l(lock);
+    close_on_empty = true;
+    center->dispatch_event_external(write_handler);
+  }
+
+  bool is_queued() {
+    assert(lock.is_locked());
+    return !out_q.empty() || outcoming_bl.length();
+  }
+
+  entity_addr_t& get_peer_addr() { return peer_addr; }
+  void set_peer_addr(const entity_addr_t& a) {
+    peer_addr = a;
+    connection_state->set_peer_addr(a);
+  }
+  void set_peer_type(int t) {
+    peer_type = t;
+    connection_state->set_peer_type(t);
+  }
+
+  // event handlers, invoked from the EventCenter thread
+  void process();
+  void handle_write();
+  void handle_stop();
+
+  EventCenter *center;
+  EventCallbackRef read_handler;
+  EventCallbackRef write_handler;
+  EventCallbackRef reset_handler;
+
+ private:
+  NetHandler net;
+
+  map<int, list<Message*> > out_q;  ///< priority queue of outbound messages
+  list<Message*> sent;              ///< unacked, in case we must requeue
+  bufferlist outcoming_bl;          ///< encoded bytes not yet on the wire
+  bool open_write;                  ///< writable event registered
+  bool keepalive;
+  bool keepalive_ack;
+  utime_t keepalive_ack_stamp;
+  bool close_on_empty;
+
+  __u32 connect_seq, peer_global_seq;
+  __u32 global_seq;
+  uint64_t out_seq;
+  uint64_t in_seq, in_seq_acked;
+
+  // throttle state for the message currently being read; remembered
+  // across event-loop retries so we never double-acquire
+  bool got_msg_throttle;
+  bool got_bytes_throttle;
+  uint64_t got_dispatch_throttle;
+
+  // handshake scratch state
+  bufferlist recv_bl;               ///< partially read protocol chunk
+  ceph_msg_connect connect_msg;
+  ceph_msg_connect_reply connect_reply;
+  bufferlist authorizer_reply_bl;   ///< authorizer reply bytes for accept
+  AuthAuthorizer *authorizer;
+  bool got_bad_auth;
+  uint64_t backoff_us;
+
+  // incoming message scratch state
+  ceph_msg_header current_header;
+  bufferlist front, middle, data;
+  utime_t recv_stamp;
+  utime_t throttle_stamp;
+
+  ceph::shared_ptr<AuthSessionHandler> session_security;
+
+  friend class AsyncMessenger;
+};
+
+typedef boost::intrusive_ptr<AsyncConnection> AsyncConnectionRef;
+
+#endif
@@ -0,0 +1,848 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+#include "AsyncMessenger.h"
+
+#include "common/config.h"
+#include "common/errno.h"
+#include "auth/Crypto.h"
+#include "include/Spinlock.h"
+
+#define dout_subsys ceph_subsys_ms
+#undef dout_prefix
+#define dout_prefix _prefix(_dout, this)
+static ostream& _prefix(std::ostream *_dout, AsyncMessenger *msgr) {
+  return *_dout << "-- " << msgr->get_myaddr() << " ";
+}
+
+static ostream& _prefix(std::ostream *_dout, Processor *p) {
+  return *_dout << " Processor -- ";
+}
+
+static ostream& _prefix(std::ostream *_dout, Worker *w) {
+  return *_dout << " Worker -- ";
+}
+
+
+/*******************
+ * Processor
+ */
+
+#undef dout_prefix
+#define dout_prefix _prefix(_dout, this)
+
+int Processor::bind(const entity_addr_t &bind_addr, const set<int>& avoid_ports)
+{
+  const md_config_t *conf = msgr->cct->_conf;
+  // bind to a socket
+  ldout(msgr->cct, 10) << __func__ << dendl;
+
+  int family;
+  switch (bind_addr.get_family()) {
+  case AF_INET:
+  case AF_INET6:
+    family = bind_addr.get_family();
+    break;
+
+  default:
+    // bind_addr is empty
+    family = conf->ms_bind_ipv6 ? AF_INET6 : AF_INET;
+  }
+
+  /* socket creation */
+  listen_sd = ::socket(family, SOCK_STREAM, 0);
+  if (listen_sd < 0) {
+    lderr(msgr->cct) << __func__ << " unable to create socket: "
+		     << cpp_strerror(errno) << dendl;
+    return -errno;
+  }
+
+  // use whatever user specified (if anything)
+  entity_addr_t listen_addr = bind_addr;
+  listen_addr.set_family(family);
+
+  /* bind to port */
+  int rc = -1;
+  if (listen_addr.get_port()) {
+    // specific port
+
+    // reuse addr+port when possible
+    int on = 1;
+    rc = ::setsockopt(listen_sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (rc < 0) {
+      lderr(msgr->cct) << __func__ << " unable to setsockopt: "
+		       << cpp_strerror(errno) << dendl;
+      return -errno;
+    }
+
+    rc = ::bind(listen_sd, (struct sockaddr *)&listen_addr.ss_addr(),
+		listen_addr.addr_size());
+    if (rc < 0) {
+      lderr(msgr->cct) << __func__ << " unable to bind to " << listen_addr.ss_addr()
+		       << ": " << cpp_strerror(errno) << dendl;
+      return -errno;
+    }
+  } else {
+    // try a range of ports
+    for (int port = msgr->cct->_conf->ms_bind_port_min;
+	 port <= msgr->cct->_conf->ms_bind_port_max; port++) {
+      if (avoid_ports.count(port))
+	continue;
+      listen_addr.set_port(port);
+      rc = ::bind(listen_sd, (struct sockaddr *)&listen_addr.ss_addr(),
+		  listen_addr.addr_size());
+      if (rc == 0)
+	break;
+    }
+    if (rc < 0) {
+      lderr(msgr->cct) << __func__ << " unable to bind to " << listen_addr.ss_addr()
+		       << " on any port in range " << msgr->cct->_conf->ms_bind_port_min
+		       << "-" << msgr->cct->_conf->ms_bind_port_max
+		       << ": " << cpp_strerror(errno) << dendl;
+      return -errno;
+    }
+    ldout(msgr->cct, 10) << __func__ << " bound on random port "
+			 << listen_addr << dendl;
+  }
+
+  // what port did we get?
+  socklen_t llen = sizeof(listen_addr.ss_addr());
+  rc = getsockname(listen_sd, (sockaddr*)&listen_addr.ss_addr(), &llen);
+  if (rc < 0) {
+    rc = -errno;
+    lderr(msgr->cct) << __func__ << " failed getsockname: "
+		     << cpp_strerror(rc) << dendl;
+    return rc;
+  }
+
+  ldout(msgr->cct, 10) << __func__ << " bound to " << listen_addr << dendl;
+
+  // listen!
+  rc = ::listen(listen_sd, 128);
+  if (rc < 0) {
+    rc = -errno;
+    lderr(msgr->cct) << __func__ << " unable to listen on " << listen_addr
+		     << ": " << cpp_strerror(rc) << dendl;
+    return rc;
+  }
+
+  msgr->set_myaddr(bind_addr);
+  if (bind_addr != entity_addr_t())
+    msgr->learned_addr(bind_addr);
+  else
+    assert(msgr->get_need_addr());  // should still be true.
+
+  if (msgr->get_myaddr().get_port() == 0) {
+    msgr->set_myaddr(listen_addr);
+  }
+  entity_addr_t addr = msgr->get_myaddr();
+  addr.nonce = nonce;
+  msgr->set_myaddr(addr);
+
+  msgr->init_local_connection();
+
+  ldout(msgr->cct, 1) << __func__ << " my_inst.addr is " << msgr->get_myaddr()
+		      << " need_addr=" << msgr->get_need_addr() << dendl;
+  return 0;
+}
+
+int Processor::rebind(const set<int>& avoid_ports)
+{
+  ldout(msgr->cct, 1) << __func__ << " rebind avoid " << avoid_ports << dendl;
+
+  // invalidate our previously learned address.
+  msgr->unlearn_addr();
+
+  entity_addr_t addr = msgr->get_myaddr();
+  set<int> new_avoid = avoid_ports;
+  new_avoid.insert(addr.get_port());
+  addr.set_port(0);
+
+  // adjust the nonce; we want our entity_addr_t to be truly unique.
+  nonce += 1000000;
+  msgr->my_inst.addr.nonce = nonce;
+  ldout(msgr->cct, 10) << __func__ << " new nonce " << nonce << " and inst "
+		       << msgr->my_inst << dendl;
+
+  ldout(msgr->cct, 10) << __func__ << " will try " << addr
+		       << " and avoid ports " << new_avoid << dendl;
+  int r = bind(addr, new_avoid);
+  if (r == 0)
+    start();
+  return r;
+}
+
+int Processor::start()
+{
+  ldout(msgr->cct, 1) << __func__ << dendl;
+
+  // start thread
+  create();
+
+  return 0;
+}
+
+void *Processor::entry()
+{
+  ldout(msgr->cct, 10) << __func__ << " starting" << dendl;
+  int errors = 0;
+
+  struct pollfd pfd;
+  pfd.fd = listen_sd;
+  pfd.events = POLLIN | POLLERR | POLLNVAL | POLLHUP;
+  while (!done) {
+    ldout(msgr->cct, 20) << __func__ << " calling poll" << dendl;
+    int r = poll(&pfd, 1, -1);
+    if (r < 0)
+      break;
+    ldout(msgr->cct, 20) << __func__ << " poll got " << r << dendl;
+
+    if (pfd.revents & (POLLERR | POLLNVAL | POLLHUP))
+      break;
+
+    ldout(msgr->cct, 10) << __func__ << " pfd.revents=" << pfd.revents << dendl;
+    if (done)
+      break;
+
+    // accept
+    entity_addr_t addr;
+    socklen_t slen = sizeof(addr.ss_addr());
+    int sd = ::accept(listen_sd, (sockaddr*)&addr.ss_addr(), &slen);
+    if (sd >= 0) {
+      errors = 0;
+      ldout(msgr->cct, 10) << __func__ << " accepted incoming on sd " << sd << dendl;
+
+      msgr->add_accept(sd);
+    } else {
+      ldout(msgr->cct, 0) << __func__ << " no incoming connection?  sd = " << sd
+			  << " errno " << errno << " " << cpp_strerror(errno) << dendl;
+      if (++errors > 4)
+	break;
+    }
+  }
+
+  ldout(msgr->cct, 20) << __func__ << " closing" << dendl;
+  // don't close socket, in case we start up again?  blech.
+  if (listen_sd >= 0) {
+    ::close(listen_sd);
+    listen_sd = -1;
+  }
+  ldout(msgr->cct, 10) << __func__ << " stopping" << dendl;
+  return 0;
+}
+
+void Processor::stop()
+{
+  done = true;
+  ldout(msgr->cct, 10) << __func__ << dendl;
+
+  if (listen_sd >= 0) {
+    ::shutdown(listen_sd, SHUT_RDWR);
+  }
+
+  // wait for thread to stop before closing the socket, to avoid
+  // racing against fd re-use.
+  if (is_started()) {
+    join();
+  }
+
+  if (listen_sd >= 0) {
+    ::close(listen_sd);
+    listen_sd = -1;
+  }
+  done = false;
+}
+
+
+/*******************
+ * Worker
+ */
+
+void *Worker::entry()
+{
+  ldout(msgr->cct, 10) << __func__ << " starting" << dendl;
+  center.set_owner(pthread_self());
+
+  while (!done) {
+    ldout(msgr->cct, 20) << __func__ << " calling event process" << dendl;
+    int r = center.process_events(30000000);
+    if (r < 0) {
+      ldout(msgr->cct, 20) << __func__ << " process events failed: "
+			   << cpp_strerror(errno) << dendl;
+      // TODO do something?
+    }
+  }
+
+  return 0;
+}
+
+void Worker::stop()
+{
+  ldout(msgr->cct, 10) << __func__ << dendl;
+  done = true;
+  center.wakeup();
+}
+
+
+/*******************
+ * AsyncMessenger
+ */
+
+#undef dout_prefix
+#define dout_prefix _prefix(_dout, this)
+
+AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
+                               string mname, uint64_t _nonce)
+  : Messenger(cct, name),
+    nonce(_nonce),
+    lock("AsyncMessenger::lock"), need_addr(true), did_bind(false),
+    global_seq(0),
+    conn_count(0),
+    cluster_protocol(0),
+    policy_lock("AsyncMessenger::policy_lock"),
+    local_connection(new Connection(this)),
+    processor(this, _nonce),
+    dispatch_queue(cct, this),
+    dispatch_throttler(cct, string("msgr_dispatch_throttler-") + mname,
+		       cct->_conf->ms_dispatch_throttle_bytes)
+{
+  ceph_spin_init(&global_seq_lock);
+
+  int threads = cct->_conf->ms_async_op_threads;
+  if (threads < 1)
+    threads = 1;
+  for (int i = 0; i < threads; ++i) {
+    Worker *w = new Worker(this, cct);
+    int r = w->center.init(5000);
+    assert(r == 0);
+    workers.push_back(w);
+  }
+
+  init_perf_logger(mname);
+  init_local_connection();
+}
+
+AsyncMessenger::~AsyncMessenger()
+{
+  assert(!did_bind); // either we didn't bind or we shut down the Processor
+  for (vector<Worker*>::iterator it = workers.begin(); it != workers.end(); ++it)
+    delete *it;
+}
+
+void AsyncMessenger::ready()
+{
+  ldout(cct,10) << __func__ << " " << get_myaddr() << dendl;
+  dispatch_queue.start();
+
+  lock.Lock();
+  if (did_bind)
+    processor.start();
+  lock.Unlock();
+}
+
+int AsyncMessenger::shutdown()
+{
+  ldout(cct,10) << __func__ << " " << get_myaddr() << dendl;
+  mark_down_all();
+  dispatch_queue.shutdown();
+  return 0;
+}
+
+int AsyncMessenger::_send_message(Message *m, const entity_inst_t& dest,
+                                  bool lazy)
+{
+  // set envelope
+  m->get_header().src = get_myname();
+
+  if (!m->get_priority()) m->set_priority(get_default_send_priority());
+
+  ldout(cct, 1) << (lazy ? "lazy " : "") << "--> " << dest.name << " "
+		<< dest.addr << " -- " << *m
+		<< " -- ?+" << m->get_data().length()
+		<< " " << m
+		<< dendl;
+
+  if (dest.addr == entity_addr_t()) {
+    ldout(cct,0) << (lazy ? "lazy_" : "") << "send_message message " << *m
+                 << " with empty dest " << dest.addr << dendl;
+    m->put();
+    return -EINVAL;
+  }
+
+  Mutex::Locker l(lock);
+  AsyncConnectionRef conn = _lookup_conn(dest.addr);
+  submit_message(m, conn, dest.addr, dest.name.type(), lazy);
+  return 0;
+}
+
+int AsyncMessenger::_send_message(Message *m, Connection *con, bool lazy)
+{
+  //set envelope
+  m->get_header().src = get_myname();
+
+  if (!m->get_priority()) m->set_priority(get_default_send_priority());
+
+  ldout(cct, 1) << (lazy ? "lazy " : "") << "--> " << con->get_peer_addr()
+		<< " -- " << *m
+		<< " -- ?+" << m->get_data().length()
+		<< " " << m << " con " << con
+		<< dendl;
+
+  AsyncConnection *c = static_cast<AsyncConnection*>(con->get_pipe());
+  if (c) {
+    c->send_message(m);
+    c->put();
+    return 0;
+  }
+
+  // failed lossy connection, or the connection has no live
+  // AsyncConnection behind it any more; fall back to address lookup
+  if (!con->is_connected()) {
+    ldout(cct, 0) << __func__ << " " << *m << " remote, "
+		  << con->get_peer_addr() << ", failed lossy con, dropping message "
+		  << m << dendl;
+    m->put();
+    return 0;
+  }
+  Mutex::Locker l(lock);
+  submit_message(m, NULL, con->get_peer_addr(), con->get_peer_type(), lazy);
+  return 0;
+}
+
+/**
+ * If my_inst.addr doesn't have an IP set, this function
+ * will fill it in from the passed addr. Otherwise it does nothing and returns.
+ */
+void AsyncMessenger::set_addr_unknowns(entity_addr_t &addr)
+{
+  if (my_inst.addr.is_blank_ip()) {
+    int port = my_inst.addr.get_port();
+    my_inst.addr.addr = addr.addr;
+    my_inst.addr.set_port(port);
+    init_local_connection();
+  }
+}
+
+int AsyncMessenger::get_proto_version(int peer_type, bool connect)
+{
+  // set reply protocol version
+  if (peer_type == my_inst.name.type()) {
+    // internal
+    return cluster_protocol;
+  } else {
+    // public
+    if (connect) {
+      switch (peer_type) {
+      case CEPH_ENTITY_TYPE_OSD: return CEPH_OSDC_PROTOCOL;
+      case CEPH_ENTITY_TYPE_MDS: return CEPH_MDSC_PROTOCOL;
+      case CEPH_ENTITY_TYPE_MON: return CEPH_MONC_PROTOCOL;
+      }
+    } else {
+      switch (my_inst.name.type()) {
+      case CEPH_ENTITY_TYPE_OSD: return CEPH_OSDC_PROTOCOL;
+      case CEPH_ENTITY_TYPE_MDS: return CEPH_MDSC_PROTOCOL;
+      case CEPH_ENTITY_TYPE_MON: return CEPH_MONC_PROTOCOL;
+      }
+    }
+  }
+  return 0;
+}
+
+void AsyncMessenger::dispatch_throttle_release(uint64_t msize)
+{
+  if (msize) {
+    ldout(cct, 10) << __func__ << " " << msize << " to dispatch throttler "
+		   << dispatch_throttler.get_current() << "/"
+		   << dispatch_throttler.get_max() << dendl;
+    dispatch_throttler.put(msize);
+  }
+}
+
+int AsyncMessenger::bind(const entity_addr_t &bind_addr)
+{
+  lock.Lock();
+  if (started) {
+    ldout(cct,10) << __func__ << " already started" << dendl;
+    lock.Unlock();
+    return -1;
+  }
+  ldout(cct,10) << __func__ << " " << bind_addr << dendl;
+  lock.Unlock();
+
+  // bind to a socket
+  set<int> avoid_ports;
+  int r = processor.bind(bind_addr, avoid_ports);
+  if (r >= 0)
+    did_bind = true;
+  return r;
+}
+
+int AsyncMessenger::rebind(const set<int>& avoid_ports)
+{
+  ldout(cct,1) << __func__ << " rebind avoid " << avoid_ports << dendl;
+  assert(did_bind);
+  processor.stop();
+  mark_down_all();
+  return processor.rebind(avoid_ports);
+}
+
+int AsyncMessenger::start()
+{
+  lock.Lock();
+  ldout(cct,1) << __func__ << " start" << dendl;
+
+  // register at least one entity, first!
+  assert(my_inst.name.type() >= 0);
+
+  assert(!started);
+  started = true;
+
+  if (!did_bind) {
+    my_inst.addr.nonce = nonce;
+    init_local_connection();
+  }
+
+  lock.Unlock();
+
+  for (vector<Worker*>::iterator it = workers.begin(); it != workers.end(); ++it)
+    (*it)->create();
+
+  return 0;
+}
+
+void AsyncMessenger::wait()
+{
+  lock.Lock();
+  if (!started) {
+    lock.Unlock();
+    return;
+  }
+  lock.Unlock();
+
+  if (dispatch_queue.is_started()) {
+    ldout(cct,10) << __func__ << ": waiting for dispatch queue" << dendl;
+    dispatch_queue.wait();
+    ldout(cct,10) << __func__ << ": dispatch queue is stopped" << dendl;
+  }
+
+  // done!  clean up.
+  if (did_bind) {
+    ldout(cct,20) << __func__ << ": stopping processor thread" << dendl;
+    processor.stop();
+    did_bind = false;
+    ldout(cct,20) << __func__ << ": stopped processor thread" << dendl;
+  }
+
+  // close all connections
+  mark_down_all();
+  lock.Lock();
+  while (!conns.empty() || !accepting_conns.empty()) {
+    ldout(cct,10) << __func__ << ": waiting for " << conns.size() << " + "
+		  << accepting_conns.size() << " conns to close" << dendl;
+    stop_cond.Wait(lock);
+  }
+  lock.Unlock();
+
+  // stop the workers once nothing needs their event loops any more
+  for (vector<Worker*>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    (*it)->stop();
+    (*it)->join();
+  }
+
+  ldout(cct, 10) << __func__ << ": done." << dendl;
+  ldout(cct, 1) << __func__ << " complete." << dendl;
+  started = false;
+}
+
+AsyncConnectionRef AsyncMessenger::create_connect(const entity_addr_t& addr,
+						  int type)
+{
+  assert(lock.is_locked());
+  assert(addr != my_inst.addr);
+
+  ldout(cct, 10) << __func__ << " " << addr
+		 << ", creating connection and registering" << dendl;
+
+  // create connection
+  Worker *w = get_worker();
+  AsyncConnectionRef conn = new AsyncConnection(cct, this, &w->center);
+  conn->conn_id = dispatch_queue.get_id();
+  conn->connect(addr, type);
+  assert(conns.count(addr) == 0);
+  conns[addr] = conn;
+
+  return conn;
+}
+
+void AsyncMessenger::add_accept(int sd)
+{
+  lock.Lock();
+  Worker *w = get_worker();
+  AsyncConnectionRef conn = new AsyncConnection(cct, this, &w->center);
+  conn->conn_id = dispatch_queue.get_id();
+  accepting_conns.insert(conn);
+  lock.Unlock();
+  conn->accept(sd);
+}
+
+AuthAuthorizer *AsyncMessenger::get_authorizer(int peer_type, bool force_new)
+{
+  return ms_deliver_get_authorizer(peer_type, force_new);
+}
+
+bool AsyncMessenger::verify_authorizer(Connection *con, int peer_type,
+				       int protocol, bufferlist& authorizer,
+				       bufferlist& authorizer_reply,
+				       bool& isvalid, CryptoKey& session_key)
+{
+  return ms_deliver_verify_authorizer(con, peer_type, protocol, authorizer,
+				      authorizer_reply, isvalid, session_key);
+}
+
+ConnectionRef AsyncMessenger::get_connection(const entity_inst_t& dest)
+{
+  Mutex::Locker l(lock);
+  if (my_inst.addr == dest.addr) {
+    // local
+    return local_connection;
+  }
+
+  AsyncConnectionRef conn = _lookup_conn(dest.addr);
+  if (conn) {
+    ldout(cct, 10) << __func__ << " " << dest << " existing " << conn << dendl;
+  } else {
+    conn = create_connect(dest.addr, dest.name.type());
+    ldout(cct, 10) << __func__ << " " << dest << " new " << conn << dendl;
+  }
+
+  return conn->connection_state;
+}
+
+ConnectionRef AsyncMessenger::get_loopback_connection()
+{
+  return local_connection;
+}
+
+void AsyncMessenger::submit_message(Message *m, AsyncConnectionRef con,
+				    const entity_addr_t& dest_addr,
+				    int dest_type, bool lazy)
+{
+  assert(lock.is_locked());
+  if (cct->_conf->ms_dump_on_send) {
+    m->encode(-1, true);
+    ldout(cct, 0) << __func__ << " " << *m << "\n";
+    m->get_payload().hexdump(*_dout);
+    if (m->get_data().length() > 0) {
+      *_dout << " data:\n";
+      m->get_data().hexdump(*_dout);
+    }
+    *_dout << dendl;
+    m->clear_payload();
+  }
+
+  // existing connection?
+  if (con) {
+    ldout(cct, 20) << __func__ << " " << *m << " remote, " << dest_addr
+		   << ", have connection." << dendl;
+    con->send_message(m);
+    return;
+  }
+
+  // local?
+  if (my_inst.addr == dest_addr) {
+    // local
+    ldout(cct, 20) << __func__ << " " << *m << " local" << dendl;
+    dispatch_queue.local_delivery(m, m->get_priority());
+    return;
+  }
+
+  // remote, no existing connection.
+  const Policy& policy = get_policy(dest_type);
+  if (policy.server) {
+    ldout(cct, 20) << __func__ << " " << *m << " remote, " << dest_addr
+		   << ", lossy server for target type "
+		   << ceph_entity_type_name(dest_type)
+		   << ", no session, dropping." << dendl;
+    m->put();
+  } else if (lazy) {
+    ldout(cct, 20) << __func__ << " " << *m << " remote, " << dest_addr
+		   << ", lazy, dropping." << dendl;
+    m->put();
+  } else {
+    ldout(cct, 20) << __func__ << " " << *m << " remote, " << dest_addr
+		   << ", new connection." << dendl;
+    create_connect(dest_addr, dest_type)->send_message(m);
+  }
+}
+
+int AsyncMessenger::send_keepalive(const entity_inst_t& dest)
+{
+  const entity_addr_t dest_addr = dest.addr;
+  int ret = 0;
+
+  Mutex::Locker l(lock);
+  if (my_inst.addr != dest_addr) {
+    // remote.
+    AsyncConnectionRef conn = _lookup_conn(dest_addr);
+    if (conn) {
+      ldout(cct, 20) << __func__ << " remote, " << dest_addr
+		     << ", have connection." << dendl;
+      conn->send_keepalive();
+    } else {
+      ldout(cct, 20) << __func__ << " no connection for " << dest_addr
+		     << ", doing nothing." << dendl;
+      ret = -EINVAL;
+    }
+  }
+  return ret;
+}
+
+int AsyncMessenger::send_keepalive(Connection *con)
+{
+  int ret = 0;
+  AsyncConnection *conn = static_cast<AsyncConnection*>(con->get_pipe());
+  if (conn) {
+    ldout(cct, 20) << __func__ << " con " << con << ", have connection." << dendl;
+    assert(conn->async_msgr == this);
+    conn->send_keepalive();
+    conn->put();
+  } else {
+    ldout(cct, 0) << __func__ << " con " << con << ", no connection." << dendl;
+    ret = -EPIPE;
+  }
+  return ret;
+}
+
+void AsyncMessenger::mark_down_all()
+{
+  ldout(cct,1) << __func__ << dendl;
+  // collect under the lock, stop outside it: AsyncConnection::stop()
+  // only queues an event on the owning center, but keep the rule that
+  // we never touch a connection while holding the msgr lock.
+  list<AsyncConnectionRef> to_stop;
+  lock.Lock();
+  for (set<AsyncConnectionRef>::iterator q = accepting_conns.begin();
+       q != accepting_conns.end(); ++q)
+    to_stop.push_back(*q);
+  for (ceph::unordered_map<entity_addr_t, AsyncConnectionRef>::iterator it =
+	 conns.begin(); it != conns.end(); ++it)
+    to_stop.push_back(it->second);
+  lock.Unlock();
+
+  for (list<AsyncConnectionRef>::iterator p = to_stop.begin();
+       p != to_stop.end(); ++p) {
+    ldout(cct, 5) << __func__ << " " << (*p)->get_peer_addr() << " " << *p << dendl;
+    (*p)->stop();
+  }
+}
+
+void AsyncMessenger::mark_down(const entity_addr_t& addr)
+{
+  lock.Lock();
+  AsyncConnectionRef conn = _lookup_conn(addr);
+  lock.Unlock();
+  if (conn) {
+    ldout(cct, 1) << __func__ << " " << addr << " -- " << conn << dendl;
+    conn->stop();
+  } else {
+    ldout(cct, 1) << __func__ << " " << addr << " -- connection dne" << dendl;
+  }
+}
+
+void AsyncMessenger::mark_down(Connection *con)
+{
+  if (con == NULL)
+    return;
+  AsyncConnection *conn = static_cast<AsyncConnection*>(con->get_pipe());
+  if (conn) {
+    ldout(cct, 1) << __func__ << " " << con << " -- " << conn << dendl;
+    assert(conn->async_msgr == this);
+    // do not generate a reset event for the caller in this case,
+    // since they asked for it.
+    con->clear_pipe(conn);
+    conn->stop();
+    conn->put();
+  } else {
+    ldout(cct, 1) << __func__ << " " << con << " -- connection dne" << dendl;
+  }
+}
+
+void AsyncMessenger::mark_down_on_empty(Connection *con)
+{
+  AsyncConnection *conn = static_cast<AsyncConnection*>(con->get_pipe());
+  if (conn) {
+    ldout(cct, 1) << __func__ << " " << con << " -- " << conn << dendl;
+    assert(conn->async_msgr == this);
+    conn->mark_down_on_empty();
+    conn->put();
+  } else {
+    ldout(cct, 1) << __func__ << " " << con << " -- connection dne" << dendl;
+  }
+}
+
+void AsyncMessenger::mark_disposable(Connection *con)
+{
+  AsyncConnection *conn = static_cast<AsyncConnection*>(con->get_pipe());
+  if (conn) {
+    ldout(cct, 1) << __func__ << " " << con << " -- " << conn << dendl;
+    assert(conn->async_msgr == this);
+    Mutex::Locker l(conn->lock);
+    conn->policy.lossy = true;
+    conn->put();
+  } else {
+    ldout(cct, 1) << __func__ << " " << con << " -- connection dne" << dendl;
+  }
+}
+
+void AsyncMessenger::learned_addr(const entity_addr_t &peer_addr_for_me)
+{
+  // be careful here: multiple threads may block here, and readers of
+  // my_inst.addr do NOT hold any lock.
+
+  // this always goes from true -> false under the protection of the
+  // mutex.  if it is already false, we need not retake the mutex at
+  // all.
+  if (!need_addr)
+    return;
+
+  lock.Lock();
+  if (need_addr) {
+    entity_addr_t t = peer_addr_for_me;
+    t.set_port(my_inst.addr.get_port());
+    my_inst.addr.addr = t.addr;
+    ldout(cct, 1) << __func__ << " learned my addr " << my_inst.addr << dendl;
+    need_addr = false;
+    init_local_connection();
+  }
+  lock.Unlock();
+}
+
+void AsyncMessenger::unlearn_addr()
+{
+  lock.Lock();
+  need_addr = true;
+  lock.Unlock();
+}
+
+void AsyncMessenger::init_local_connection()
+{
+  local_connection->peer_addr = my_inst.addr;
+  local_connection->peer_type = my_inst.name.type();
+  ms_deliver_handle_fast_connect(local_connection.get());
+}
@@ -0,0 +1,478 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_ASYNCMESSENGER_H
+#define CEPH_ASYNCMESSENGER_H
+
+#include <list>
+#include <map>
+using namespace std;
+#include "include/types.h"
+#include "include/unordered_map.h"
+#include "include/unordered_set.h"
+
+#include "common/Mutex.h"
+#include "common/Cond.h"
+#include "common/Thread.h"
+#include "common/Throttle.h"
+#include "include/atomic.h"
+#include "include/Spinlock.h"
+
+#include "msg/Messenger.h"
+#include "msg/Message.h"
+#include "msg/DispatchQueue.h"
+#include "include/assert.h"
+#include "AsyncConnection.h"
+#include "Event.h"
+#include "net_handler.h"
+
+class AsyncMessenger;
+
+/**
+ * A Worker wraps one EventCenter and runs its loop in a dedicated
+ * thread.  Connections are assigned to a Worker at creation time and
+ * stay with it for life; all their socket processing happens there.
+ */
+class Worker : public Thread {
+  AsyncMessenger *msgr;
+  bool done;
+
+ public:
+  EventCenter center;
+  Worker(AsyncMessenger *m, CephContext *c)
+    : msgr(m), done(false), center(c) {}
+  void *entry();
+  void stop();
+};
+
+/**
+ * The Processor listens on the messenger's socket and hands accepted
+ * sockets off to AsyncMessenger::add_accept().  It is the analogue of
+ * Accepter; accept(2) itself remains a (cheap) blocking thread.
+ */
+class Processor : public Thread {
+  AsyncMessenger *msgr;
+  bool done;
+  uint64_t nonce;
+  int listen_sd;
+
+ public:
+  Processor(AsyncMessenger *r, uint64_t n)
+    : msgr(r), done(false), nonce(n), listen_sd(-1) {}
+
+  void *entry();
+  void stop();
+  int bind(const entity_addr_t &bind_addr, const set<int>& avoid_ports);
+  int rebind(const set<int>& avoid_port);
+  int start();
+};
+
+/*
+ * AsyncMessenger is an experimental event-driven implementation of
+ * Messenger.  Where SimpleMessenger runs two threads per Pipe, this
+ * multiplexes all AsyncConnections over a small fixed pool of Worker
+ * threads, each running an epoll loop.  Delivery to dispatchers still
+ * goes through the shared DispatchQueue, so ordering and fast dispatch
+ * semantics match SimpleMessenger.
+ *
+ * Select it with ms type = async.
+ *
+ * Lock ordering:
+ *
+ *   AsyncConnection::lock
+ *       AsyncMessenger::lock
+ *           DispatchQueue::lock
+ */
+class AsyncMessenger : public Messenger {
+  // First we have the public Messenger interface implementation...
+public:
+  /**
+   * Initialize the AsyncMessenger!
+   *
+   * @param cct The CephContext to use
+   * @param name The name to assign ourselves
+   * _nonce A unique ID to use for this AsyncMessenger. It should not
+   * be a value that will be repeated if the daemon restarts.
+   */
+  AsyncMessenger(CephContext *cct, entity_name_t name,
+                 string mname, uint64_t _nonce);
+
+  /**
+   * Destroy the AsyncMessenger. Pretty simple since all the work is done
+   * elsewhere.
+   */
+  virtual ~AsyncMessenger();
+
+  /** @defgroup Accessors
+   * @{
+   */
+  void set_addr_unknowns(entity_addr_t& addr);
+
+  int get_dispatch_queue_len() {
+    return dispatch_queue.get_queue_len();
+  }
+
+  double get_dispatch_queue_max_age(utime_t now) {
+    return dispatch_queue.get_max_age(now);
+  }
+  /** @} Accessors */
+
+  /**
+   * @defgroup Configuration functions
+   * @{
+   */
+  void set_cluster_protocol(int p) {
+    assert(!started && !did_bind);
+    cluster_protocol = p;
+  }
+
+  void set_default_policy(Policy p) {
+    Mutex::Locker l(policy_lock);
+    default_policy = p;
+  }
+
+  void set_policy(int type, Policy p) {
+    Mutex::Locker l(policy_lock);
+    policy_map[type] = p;
+  }
+
+  void set_policy_throttlers(int type, Throttle *byte_throttle, Throttle *msg_throttle) {
+    Mutex::Locker l(policy_lock);
+    if (policy_map.count(type)) {
+      policy_map[type].throttler_bytes = byte_throttle;
+      policy_map[type].throttler_messages = msg_throttle;
+    } else {
+      default_policy.throttler_bytes = byte_throttle;
+      default_policy.throttler_messages = msg_throttle;
+    }
+  }
+
+  int bind(const entity_addr_t& bind_addr);
+  int rebind(const set<int>& avoid_ports);
+
+  /** @} Configuration functions */
+
+  /**
+   * @defgroup Startup/Shutdown
+   * @{
+   */
+  virtual int start();
+  virtual void wait();
+  virtual int shutdown();
+
+  /** @} // Startup/Shutdown */
+
+  /**
+   * @defgroup Messaging
+   * @{
+   */
+  virtual int send_message(Message *m, const entity_inst_t& dest) {
+    return _send_message(m, dest, false);
+  }
+
+  virtual int send_message(Message *m, Connection *con) {
+    return _send_message(m, con, false);
+  }
+
+  virtual int lazy_send_message(Message *m, const entity_inst_t& dest) {
+    return _send_message(m, dest, true);
+  }
+
+  virtual int lazy_send_message(Message *m, Connection *con) {
+    return _send_message(m, con, true);
+  }
+  /** @} // Messaging */
+
+  /**
+   * @defgroup Connection Management
+   * @{
+   */
+  virtual ConnectionRef get_connection(const entity_inst_t& dest);
+  virtual ConnectionRef get_loopback_connection();
+  virtual int send_keepalive(const entity_inst_t& addr);
+  virtual int send_keepalive(Connection *con);
+  virtual void mark_down(const entity_addr_t& addr);
+  virtual void mark_down(Connection *con);
+  virtual void mark_down_on_empty(Connection *con);
+  virtual void mark_disposable(Connection *con);
+  virtual void mark_down_all();
+  /** @} // Connection Management */
+protected:
+  /**
+   * @defgroup Messenger Interfaces
+   * @{
+   */
+  /**
+   * Start up the DispatchQueue thread once we have somebody to dispatch to.
+   */
+  virtual void ready();
+  /** @} // Messenger Interfaces */
+private:
+  /**
+   * @defgroup Utility functions
+   * @{
+   */
+
+  /**
+   * Create a connection associated with the given entity (of the given type).
+   * Initiate the connection. (This function returning does not guarantee
+   * connection success.)
+   *
+   * @param addr The address of the entity to connect to.
+   * @param type The peer type of the entity at the address.
+   *
+   * @return a pointer to the newly-created connection. Caller does not own a
+   * reference; take one if you need it.
+   */
+  AsyncConnectionRef create_connect(const entity_addr_t& addr, int type);
+  /**
+   * Send a message, lazily or not.
+   * This just glues [lazy_]send_message together and passes
+   * the input on to submit_message.
+   */
+  int _send_message(Message *m, const entity_inst_t& dest, bool lazy);
+  /**
+   * Same as above, but for the Connection-based variants.
+   */
+  int _send_message(Message *m, Connection *con, bool lazy);
+  /**
+   * Queue up a Message for delivery to the entity specified
+   * by addr and dest_type.
+   * submit_message() is responsible for creating
+   * new connections (and closing old ones) as necessary.
+   *
+   * @param m The Message to queue up. This function eats a reference.
+   * @param con The existing Connection to use, or NULL if you don't know of one.
+   * @param addr The address to send the Message to.
+   * @param dest_type The peer type of the address we're sending to
+   * @param lazy If true, do not establish or fix a Connection to send the Message;
+   * just drop silently under failure.
+   */
+  void submit_message(Message *m, AsyncConnectionRef con,
+                      const entity_addr_t& addr, int dest_type, bool lazy);
+
+  /// pick the next Worker for a new connection, round-robin
+  Worker *get_worker() {
+    return workers[(conn_count++) % workers.size()];
+  }
+
+  /**
+   * @} // Utility functions
+   */
+
+  // AsyncMessenger stuff
+  /// approximately unique ID set by the Constructor for use in entity_addr_t
+  uint64_t nonce;
+  /// overall lock used for AsyncMessenger data structures
+  Mutex lock;
+  // AsyncMessenger stuff
+  /// true, specifying we haven't learned our addr; set false when we find it.
+  // maybe this should be protected by the lock?
+  bool need_addr;
+
+public:
+  bool get_need_addr() const { return need_addr; }
+
+private:
+  /**
+   *  false; set to true if the AsyncMessenger bound to a specific address;
+   *  and set false again by Accepter::stop(). This isn't lock-protected
+   *  since you shouldn't be able to race the only writers.
+   */
+  bool did_bind;
+  /// counter for the global seq our connection protocol uses
+  __u32 global_seq;
+  /// lock to protect the global_seq
+  ceph_spinlock_t global_seq_lock;
+
+  vector<Worker*> workers;
+  int conn_count;
+
+  /**
+   * hash map of addresses to connections
+   *
+   * NOTE: a AsyncConnection* with state CLOSED may still be in the map but is
+   * considered invalid and can be replaced by anyone holding the msgr lock
+   */
+  ceph::unordered_map<entity_addr_t, AsyncConnectionRef> conns;
+
+  /**
+   * set of connections accepted but not yet registered in conns (we
+   * don't know the peer's address until the handshake completes)
+   */
+  set<AsyncConnectionRef> accepting_conns;
+
+  /// internal cluster protocol version, if any, for talking to entities of the same type.
+  int cluster_protocol;
+
+  /// lock protecting policy
+  Mutex policy_lock;
+  /// the default Policy we use for connections
+  Policy default_policy;
+  /// map specifying different Policies for specific peer types
+  map<int, Policy> policy_map; // entity_name_t::type -> Policy
+
+  Cond  stop_cond;
+  bool stopped;
+
+  AsyncConnectionRef _lookup_conn(const entity_addr_t& k) {
+    assert(lock.is_locked());
+    ceph::unordered_map<entity_addr_t, AsyncConnectionRef>::iterator p = conns.find(k);
+    if (p == conns.end())
+      return NULL;
+    if (p->second->state == AsyncConnection::STATE_CLOSED)
+      return NULL;
+    return p->second;
+  }
+
+public:
+
+  /// con used for sending messages to ourselves
+  ConnectionRef local_connection;
+
+  Processor processor;
+  DispatchQueue dispatch_queue;
+
+  /// Throttle preventing us from building up a big backlog waiting for dispatch
+  Throttle dispatch_throttler;
+
+  friend class Processor;
+  friend class AsyncConnection;
+
+  /**
+   * @defgroup AsyncMessenger internals
+   * @{
+   */
+
+  /**
+   * Start accepting a socket; creates a connection and hands it to a Worker.
+   */
+  void add_accept(int sd);
+
+  /**
+   * This wraps ms_deliver_get_authorizer. We use it for AsyncConnection.
+   */
+  AuthAuthorizer *get_authorizer(int peer_type, bool force_new);
+  /**
+   * This wraps ms_deliver_verify_authorizer; we use it for AsyncConnection.
+   */
+  bool verify_authorizer(Connection *con, int peer_type, int protocol, bufferlist& auth, bufferlist& auth_reply,
+                         bool& isvalid, CryptoKey& session_key);
+  /**
+   * Increment the global sequence for this AsyncMessenger and return it.
+   * This is for the connect protocol, although it doesn't hurt if somebody
+   * else calls it.
+   *
+   * @return a global sequence ID that nobody else has seen.
+   */
+  __u32 get_global_seq(__u32 old=0) {
+    ceph_spin_lock(&global_seq_lock);
+    if (old > global_seq)
+      global_seq = old;
+    __u32 ret = ++global_seq;
+    ceph_spin_unlock(&global_seq_lock);
+    return ret;
+  }
+  /**
+   * Get the protocol version we support for the given peer type: either
+   * a peer protocol (if it matches our own), the protocol version for the
+   * peer (if we're connecting), or our protocol version (if we're accepting).
+   */
+  int get_proto_version(int peer_type, bool connect);
+
+  /**
+   * Fill in the address and peer type for the local connection, which
+   * is used for delivering messages back to ourself.
+   */
+  void init_local_connection();
+  /**
+   * Tell the AsyncMessenger its full IP address.
+   *
+   * This is used by connections when connecting to other endpoints, and
+   * probably shouldn't be called by anybody else.
+   */
+  void learned_addr(const entity_addr_t &peer_addr_for_me);
+
+  /**
+   * Tell the AsyncMessenger its address is no longer known
+   *
+   * This happens when we rebind to a new port.
+   */
+  void unlearn_addr();
+
+  /**
+   * Get the Policy associated with a type of peer.
+   * @param t The peer type to get the default policy for.
+   *
+   * @return A const Policy reference.
+   */
+  Policy get_policy(int t) {
+    Mutex::Locker l(policy_lock);
+    if (policy_map.count(t))
+      return policy_map[t];
+    else
+      return default_policy;
+  }
+  Policy get_default_policy() {
+    Mutex::Locker l(policy_lock);
+    return default_policy;
+  }
+
+  /**
+   * Release memory accounting back to the dispatch throttler.
+   *
+   * @param msize The amount of memory to release.
+   */
+  virtual void dispatch_throttle_release(uint64_t msize);
+
+  /**
+   * Look up an existing, non-closed connection for an address.
+   */
+  AsyncConnectionRef lookup_conn(const entity_addr_t& k) {
+    Mutex::Locker l(lock);
+    return _lookup_conn(k);
+  }
+
+  /**
+   * An accepting connection identified its peer; move it from
+   * accepting_conns to the conns map, replacing any closed entry.
+   */
+  void accept_conn(AsyncConnectionRef conn) {
+    Mutex::Locker l(lock);
+    conns[conn->get_peer_addr()] = conn;
+    accepting_conns.erase(conn);
+  }
+
+  /**
+   * A connection stopped; drop it from our tables (but only if it is
+   * still the registered connection for its address: a replacement may
+   * already have taken its slot).
+   */
+  void unregister_conn(AsyncConnectionRef conn) {
+    Mutex::Locker l(lock);
+    accepting_conns.erase(conn);
+    ceph::unordered_map<entity_addr_t, AsyncConnectionRef>::iterator p =
+      conns.find(conn->get_peer_addr());
+    if (p != conns.end() && p->second == conn)
+      conns.erase(p);
+
+    if (conns.empty() && accepting_conns.empty())
+      stop_cond.Signal();
+  }
+  /**
+   * @} // AsyncMessenger Internals
+   */
+} ;
+
+#endif /* CEPH_ASYNCMESSENGER_H */
@@ -0,0 +1,290 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+#include "common/errno.h"
+#include "common/ceph_context.h"
+#include "common/debug.h"
+#include "Event.h"
+
+#define dout_subsys ceph_subsys_ms
+
+#undef dout_prefix
+#define dout_prefix *_dout << "EventCenter(" << this << ") "
+
+EventCenter::EventCenter(CephContext *c)
+  : cct(c), nevent(0), owner(0),
+    external_lock("EventCenter::external_lock"),
+    epfd(-1), events(NULL), time_event_next_id(1),
+    notify_receive_fd(-1), notify_send_fd(-1),
+    already_wakeup(0)
+{
+}
+
+EventCenter::~EventCenter()
+{
+  if (notify_receive_fd >= 0)
+    ::close(notify_receive_fd);
+  if (notify_send_fd >= 0)
+    ::close(notify_send_fd);
+  if (epfd >= 0)
+    ::close(epfd);
+  delete[] events;
+}
+
+int EventCenter::init(int n)
+{
+  nevent = n;
+  events = new struct epoll_event[nevent];
+
+  epfd = epoll_create(1024);   // size field is ignored by modern kernels
+  if (epfd < 0) {
+    lderr(cct) << __func__ << " unable to do epoll_create: "
+	       << cpp_strerror(errno) << dendl;
+    return -errno;
+  }
+
+  int fds[2];
+  if (pipe(fds) < 0) {
+    lderr(cct) << __func__ << " can't create notify pipe: "
+	       << cpp_strerror(errno) << dendl;
+    return -errno;
+  }
+  notify_receive_fd = fds[0];
+  notify_send_fd = fds[1];
+  ::fcntl(notify_receive_fd, F_SETFL, O_NONBLOCK);
+  ::fcntl(notify_send_fd, F_SETFL, O_NONBLOCK);
+
+  struct epoll_event ee;
+  memset(&ee, 0, sizeof(ee));
+  ee.events = EPOLLIN;
+  ee.data.fd = notify_receive_fd;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, notify_receive_fd, &ee) == -1) {
+    lderr(cct) << __func__ << " add notify pipe failed: "
+	       << cpp_strerror(errno) << dendl;
+    return -errno;
+  }
+  return 0;
+}
+
+int EventCenter::create_file_event(int fd, int mask, EventCallbackRef ctxt)
+{
+  assert(pthread_equal(pthread_self(), owner));
+  FileEvent *event = &file_events[fd];
+  if ((event->mask & mask) == mask)
+    return 0;
+
+  int op = event->mask == EVENT_NONE ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  int new_mask = event->mask | mask;
+
+  struct epoll_event ee;
+  memset(&ee, 0, sizeof(ee));
+  if (new_mask & EVENT_READABLE)
+    ee.events |= EPOLLIN;
+  if (new_mask & EVENT_WRITABLE)
+    ee.events |= EPOLLOUT;
+  ee.data.fd = fd;
+  if (epoll_ctl(epfd, op, fd, &ee) == -1) {
+    lderr(cct) << __func__ << " epoll_ctl: add fd=" << fd << " failed. "
+	       << cpp_strerror(errno) << dendl;
+    return -errno;
+  }
+
+  event->mask = new_mask;
+  if (mask & EVENT_READABLE)
+    event->read_cb = ctxt;
+  if (mask & EVENT_WRITABLE)
+    event->write_cb = ctxt;
+  ldout(cct, 20) << __func__ << " create event fd=" << fd
+		 << " mask=" << mask << " now " << event->mask << dendl;
+  return 0;
+}
+
+void EventCenter::delete_file_event(int fd, int mask)
+{
+  assert(pthread_equal(pthread_self(), owner));
+  FileEvent *event = _get_file_event(fd);
+  if (!event || event->mask == EVENT_NONE)
+    return;
+
+  int new_mask = event->mask & (~mask);
+  struct epoll_event ee;
+  memset(&ee, 0, sizeof(ee));
+  if (new_mask & EVENT_READABLE)
+    ee.events |= EPOLLIN;
+  if (new_mask & EVENT_WRITABLE)
+    ee.events |= EPOLLOUT;
+  ee.data.fd = fd;
+  if (new_mask != EVENT_NONE) {
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ee);
+  } else {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ee);
+  }
+
+  event->mask = new_mask;
+  if (mask & EVENT_READABLE)
+    event->read_cb = NULL;
+  if (mask & EVENT_WRITABLE)
+    event->write_cb = NULL;
+  if (event->mask == EVENT_NONE)
+    file_events.erase(fd);
+  ldout(cct, 20) << __func__ << " delete event fd=" << fd
+		 << " mask=" << mask << dendl;
+}
+
+uint64_t EventCenter::create_time_event(uint64_t microseconds, EventCallbackRef ctxt)
+{
+  assert(pthread_equal(pthread_self(), owner));
+  uint64_t id = time_event_next_id++;
+  utime_t expire = ceph_clock_now(cct);
+  expire += (double)microseconds / 1000000.0;
+
+  TimeEvent event;
+  event.id = id;
+  event.time_cb = ctxt;
+  time_events.insert(make_pair(expire, event));
+  ldout(cct, 20) << __func__ << " id=" << id << " expire=" << expire << dendl;
+  return id;
+}
+
+void EventCenter::delete_time_event(uint64_t id)
+{
+  assert(pthread_equal(pthread_self(), owner));
+  for (multimap<utime_t, TimeEvent>::iterator it = time_events.begin();
+       it != time_events.end();
+       ++it) {
+    if (it->second.id == id) {
+      time_events.erase(it);
+      return;
+    }
+  }
+}
+
+int EventCenter::process_time_events()
+{
+  int processed = 0;
+  utime_t now = ceph_clock_now(cct);
+
+  while (!time_events.empty()) {
+    multimap<utime_t, TimeEvent>::iterator it = time_events.begin();
+    if (it->first > now)
+      break;
+    TimeEvent e = it->second;
+    time_events.erase(it);
+    ldout(cct, 20) << __func__ << " process time event: id=" << e.id << dendl;
+    e.time_cb->do_request(e.id);
+    processed++;
+  }
+  return processed;
+}
+
+int EventCenter::process_events(int timeout_us)
+{
+  int numevents = 0;
+
+  // shrink the epoll timeout if a time event will expire sooner
+  utime_t period, shortest, now = ceph_clock_now(cct);
+  shortest = now;
+  shortest += (double)timeout_us / 1000000.0;
+  if (!time_events.empty() && time_events.begin()->first < shortest) {
+    shortest = time_events.begin()->first;
+    if (shortest > now) {
+      period = shortest - now;
+      timeout_us = period.to_nsec() / 1000;
+    } else {
+      timeout_us = 0;
+    }
+  }
+
+  int retval = epoll_wait(epfd, events, nevent,
+			  timeout_us >= 0 ? timeout_us / 1000 : -1);
+  if (retval > 0) {
+    for (int j = 0; j < retval; j++) {
+      struct epoll_event *ev = &events[j];
+
+      if (ev->data.fd == notify_receive_fd) {
+	char buf[256];
+	// drain all pending wakeups
+	while (::read(notify_receive_fd, buf, sizeof(buf)) > 0)
+	  ;
+	already_wakeup.set(0);
+	continue;
+      }
+
+      // on error/hangup fire every registered callback so the owner
+      // notices the failure even if only one direction is registered
+      int mask = 0;
+      if (ev->events & (EPOLLIN|EPOLLERR|EPOLLHUP))
+	mask |= EVENT_READABLE;
+      if (ev->events & (EPOLLOUT|EPOLLERR|EPOLLHUP))
+	mask |= EVENT_WRITABLE;
+
+      FileEvent *event = _get_file_event(ev->data.fd);
+      if (!event)
+	continue;
+
+      // the read callback may delete the write event (or the whole
+      // connection); re-check before invoking the write callback.
+      if ((mask & EVENT_READABLE) && event->read_cb) {
+	event->read_cb->do_request(ev->data.fd);
+	event = _get_file_event(ev->data.fd);
+      }
+      if (event && (mask & EVENT_WRITABLE) && event->write_cb)
+	event->write_cb->do_request(ev->data.fd);
+
+      numevents++;
+    }
+  }
+
+  numevents += process_time_events();
+
+  // external events last: they may have been queued while we slept
+  while (1) {
+    EventCallbackRef e;
+    {
+      Mutex::Locker l(external_lock);
+      if (external_events.empty())
+	break;
+      e = external_events.front();
+      external_events.pop_front();
+    }
+    e->do_request(0);
+    numevents++;
+  }
+  return numevents;
+}
+
+void EventCenter::dispatch_event_external(EventCallbackRef e)
+{
+  {
+    Mutex::Locker l(external_lock);
+    external_events.push_back(e);
+  }
+  wakeup();
+}
+
+void EventCenter::wakeup()
+{
+  if (already_wakeup.compare_and_swap(0, 1)) {
+    char buf[1];
+    buf[0] = 'c';
+    int n = ::write(notify_send_fd, buf, 1);
+    // meaningless to retry; the pipe being full already guarantees a wakeup
+    (void)n;
+  }
+}
@@ -0,0 +1,117 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_EVENT_H
+#define CEPH_MSG_EVENT_H
+
+#include <map>
+#include <list>
+using namespace std;
+
+#include "include/atomic.h"
+#include "include/Context.h"
+#include "common/Mutex.h"
+#include "common/Clock.h"
+
+#define EVENT_NONE 0
+#define EVENT_READABLE 1
+#define EVENT_WRITABLE 2
+
+class CephContext;
+
+/**
+ * An EventCallback is a bit of work attached to a file descriptor
+ * or timer in an EventCenter.  It is always invoked from the owning
+ * EventCenter's thread.
+ */
+class EventCallback {
+ public:
+  virtual void do_request(int fd_or_id) = 0;
+  virtual ~EventCallback() {}
+};
+
+typedef EventCallback* EventCallbackRef;
+
+/**
+ * EventCenter is a single-threaded epoll event loop.  One worker
+ * thread runs process_events() in a loop; file events, time events
+ * and externally submitted events (from other threads) are all
+ * delivered as callbacks from that thread, so callbacks never need
+ * to lock against each other within the same center.
+ */
+class EventCenter {
+  struct FileEvent {
+    int mask;
+    EventCallbackRef read_cb;
+    EventCallbackRef write_cb;
+    FileEvent(): mask(EVENT_NONE), read_cb(NULL), write_cb(NULL) {}
+  };
+
+  struct TimeEvent {
+    uint64_t id;
+    EventCallbackRef time_cb;
+    TimeEvent(): id(0), time_cb(NULL) {}
+  };
+
+  CephContext *cct;
+  int nevent;
+  pthread_t owner;
+
+  Mutex external_lock;
+  list<EventCallbackRef> external_events;
+
+  int epfd;
+  struct epoll_event *events;
+  map<int, FileEvent> file_events;
+
+  // time events are only touched by the owner thread; no lock needed
+  uint64_t time_event_next_id;
+  multimap<utime_t, TimeEvent> time_events;
+
+  int notify_receive_fd;
+  int notify_send_fd;
+
+  FileEvent *_get_file_event(int fd) {
+    map<int, FileEvent>::iterator it = file_events.find(fd);
+    if (it == file_events.end())
+      return NULL;
+    return &it->second;
+  }
+
+  int process_time_events();
+
+ public:
+  atomic_t already_wakeup;
+
+  EventCenter(CephContext *c);
+  ~EventCenter();
+  int init(int nevent);
+  void set_owner(pthread_t p) { owner = p; }
+  pthread_t get_owner() { return owner; }
+
+  // file and time events may only be created/deleted from the owner thread.
+  int create_file_event(int fd, int mask, EventCallbackRef ctxt);
+  void delete_file_event(int fd, int mask);
+  uint64_t create_time_event(uint64_t microseconds, EventCallbackRef ctxt);
+  void delete_time_event(uint64_t id);
+
+  /// run the loop once; timeout_us bounds how long we may sleep in epoll.
+  int process_events(int timeout_us);
+
+  /// submit a callback for execution in the event thread; any thread may call.
+  void dispatch_event_external(EventCallbackRef e);
+  void wakeup();
+};
+
+#endif
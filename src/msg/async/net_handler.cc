@@ -0,0 +1,142 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "net_handler.h"
+#include "common/config.h"
+#include "common/errno.h"
+#include "common/debug.h"
+
+#define dout_subsys ceph_subsys_ms
+
+#undef dout_prefix
+#define dout_prefix *_dout << "NetHandler "
+
+int NetHandler::create_socket(int domain, bool reuse_addr)
+{
+  int s, on = 1;
+
+  if ((s = ::socket(domain, SOCK_STREAM, 0)) == -1) {
+    lderr(cct) << __func__ << " couldn't created socket " << cpp_strerror(errno) << dendl;
+    return -errno;
+  }
+
+  if (reuse_addr) {
+    if (::setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1) {
+      lderr(cct) << __func__ << " setsockopt SO_REUSEADDR failed: "
+		 << cpp_strerror(errno) << dendl;
+      ::close(s);
+      return -errno;
+    }
+  }
+  return s;
+}
+
+int NetHandler::set_nonblock(int sd)
+{
+  int flags;
+
+  /* Set the socket nonblocking.
+   * Note that fcntl(2) for F_GETFL and F_SETFL can't be
+   * interrupted by a signal. */
+  if ((flags = fcntl(sd, F_GETFL)) < 0 ) {
+    lderr(cct) << __func__ << " fcntl(F_GETFL) failed: " << cpp_strerror(errno) << dendl;
+    return -errno;
+  }
+  if (fcntl(sd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    lderr(cct) << __func__ << " fcntl(F_SETFL,O_NONBLOCK): " << cpp_strerror(errno) << dendl;
+    return -errno;
+  }
+
+  return 0;
+}
+
+void NetHandler::set_socket_options(int sd)
+{
+  // disable Nagle algorithm?
+  if (cct->_conf->ms_tcp_nodelay) {
+    int flag = 1;
+    int r = ::setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(flag));
+    if (r < 0) {
+      r = -errno;
+      ldout(cct, 0) << "couldn't set TCP_NODELAY: " << cpp_strerror(r) << dendl;
+    }
+  }
+  if (cct->_conf->ms_tcp_rcvbuf) {
+    int size = cct->_conf->ms_tcp_rcvbuf;
+    int r = ::setsockopt(sd, SOL_SOCKET, SO_RCVBUF, (void*)&size, sizeof(size));
+    if (r < 0)  {
+      r = -errno;
+      ldout(cct, 0) << "couldn't set SO_RCVBUF to " << size << ": " << cpp_strerror(r) << dendl;
+    }
+  }
+
+  // block ESIGPIPE
+#ifdef CEPH_USE_SO_NOSIGPIPE
+  int val = 1;
+  int r = ::setsockopt(sd, SOL_SOCKET, SO_NOSIGPIPE, (void*)&val, sizeof(val));
+  if (r) {
+    r = -errno;
+    ldout(cct, 0) << "couldn't set SO_NOSIGPIPE: " << cpp_strerror(r) << dendl;
+  }
+#endif
+}
+
+int NetHandler::connect(const entity_addr_t &addr)
+{
+  int ret;
+  int s = create_socket(addr.get_family());
+  if (s < 0)
+    return s;
+
+  ret = ::connect(s, (sockaddr*)&addr.addr, addr.addr_size());
+  if (ret < 0) {
+    ldout(cct, 10) << __func__ << " connect: " << cpp_strerror(errno) << dendl;
+    ::close(s);
+    return -errno;
+  }
+
+  set_socket_options(s);
+  return s;
+}
+
+int NetHandler::nonblock_connect(const entity_addr_t &addr)
+{
+  int ret;
+  int s = create_socket(addr.get_family());
+  if (s < 0)
+    return s;
+
+  ret = set_nonblock(s);
+  if (ret < 0) {
+    ::close(s);
+    return ret;
+  }
+
+  set_socket_options(s);
+
+  ret = ::connect(s, (sockaddr*)&addr.addr, addr.addr_size());
+  if (ret < 0 && errno != EINPROGRESS) {
+    ldout(cct, 10) << __func__ << " connect: " << cpp_strerror(errno) << dendl;
+    ::close(s);
+    return -errno;
+  }
+
+  return s;
+}
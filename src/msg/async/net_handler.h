@@ -0,0 +1,35 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2013 Inktank, Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_NET_HANDLER_H
+#define CEPH_MSG_NET_HANDLER_H
+
+#include "msg/msg_types.h"
+
+class CephContext;
+
+/// small collection of socket helpers shared by the async messenger bits
+class NetHandler {
+  int create_socket(int domain, bool reuse_addr=false);
+  CephContext *cct;
+ public:
+  NetHandler(CephContext *c): cct(c) {}
+  int set_nonblock(int sd);
+  void set_socket_options(int sd);
+  int connect(const entity_addr_t &addr);
+  /// like connect(), but O_NONBLOCK; may return with connect in progress
+  int nonblock_connect(const entity_addr_t &addr);
+};
+
+#endif
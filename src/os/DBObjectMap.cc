@@ -17,6 +17,7 @@
 
 #include "common/debug.h"
 #include "common/config.h"
+#include "global/global_context.h"
 #include "include/assert.h"
 
 #define dout_subsys ceph_subsys_filestore
@@ -304,11 +305,17 @@ int DBObjectMap::DBObjectMapIteratorImpl::init()
       assert(0);
       return -EINVAL;
     }
-    parent_iter.reset(new DBObjectMapIteratorImpl(map, parent));
+    parent_iter.reset(new DBObjectMapIteratorImpl(map, parent, snapshot));
+  }
+  if (snapshot) {
+    key_iter = map->db->get_snapshot_iterator(map->user_prefix(header));
+    assert(key_iter);
+    complete_iter = map->db->get_snapshot_iterator(map->complete_prefix(header));
+  } else {
+    key_iter = map->db->get_iterator(map->user_prefix(header));
+    assert(key_iter);
+    complete_iter = map->db->get_iterator(map->complete_prefix(header));
   }
-  key_iter = map->db->get_iterator(map->user_prefix(header));
-  assert(key_iter);
-  complete_iter = map->db->get_iterator(map->complete_prefix(header));
   assert(complete_iter);
   cur_iter = key_iter;
   assert(cur_iter);
@@ -325,6 +332,15 @@ ObjectMap::ObjectMapIterator DBObjectMap::get_iterator(
   return _get_iterator(header);
 }
 
+ObjectMap::ObjectMapIterator DBObjectMap::get_snapshot_iterator(
+  const ghobject_t &oid)
+{
+  Header header = lookup_map_header(oid);
+  if (!header)
+    return ObjectMapIterator(new EmptyIteratorImpl());
+  return _get_iterator(header, true);
+}
+
 int DBObjectMap::DBObjectMapIteratorImpl::seek_to_first()
 {
   init();
@@ -416,6 +432,23 @@ int DBObjectMap::DBObjectMapIteratorImpl::next()
   return adjust();
 }
 
+int DBObjectMap::DBObjectMapIteratorImpl::get_next_n(uint64_t max,
+						     std::map<string, bufferlist> *out)
+{
+  if (!valid())
+    return 0;
+  uint64_t got = 0;
+  while (got < max && !invalid) {
+    out->insert(out->end(), make_pair(cur_iter->key(), cur_iter->value()));
+    ++got;
+    cur_iter->next();
+    r = adjust();
+    if (r < 0)
+      return r;
+  }
+  return got;
+}
+
 int DBObjectMap::DBObjectMapIteratorImpl::next_parent()
 {
   if (!parent_iter || !parent_iter->valid()) {
@@ -513,6 +546,14 @@ int DBObjectMap::set_keys(const ghobject_t &oid,
   if (check_spos(oid, header, spos))
     return 0;
 
+  // Collapse the clone chain before applying the new keys; the keys in
+  // set are added afterwards so they override any copied parent values.
+  if (header->parent && g_conf->filestore_omap_flatten_on_write) {
+    int r = _flatten(oid, header, t);
+    if (r < 0)
+      return r;
+  }
+
   t->set(user_prefix(header), set);
 
   return db->submit_transaction(t);
@@ -678,6 +719,35 @@ int DBObjectMap::copy_up_header(Header header,
   return 0;
 }
 
+int DBObjectMap::_flatten(const ghobject_t &oid, Header header,
+			  KeyValueDB::Transaction t)
+{
+  dout(20) << __func__ << " " << oid << " parent seq " << header->parent
+	   << dendl;
+  {
+    DBObjectMapIterator iter = _get_iterator(header);
+    map<string, bufferlist> to_write;
+    for (iter->seek_to_first(); iter->valid(); iter->next()) {
+      if (iter->status())
+	return iter->status();
+      if (iter->on_parent())
+	to_write[iter->key()].append(iter->value());
+    }
+    t->set(user_prefix(header), to_write);
+  }
+  copy_up_header(header, t);
+  Header parent = lookup_parent(header);
+  if (!parent)
+    return -EINVAL;
+  assert(parent->num_children > 0);
+  parent->num_children--;
+  _clear(parent, t);
+  header->parent = 0;
+  set_map_header(oid, *header, t);
+  t->rmkeys_by_prefix(complete_prefix(header));
+  return 0;
+}
+
 int DBObjectMap::need_parent(DBObjectMapIterator iter)
 {
   int r = iter->seek_to_first();
@@ -1077,9 +1147,99 @@ int DBObjectMap::init(bool do_upgrade)
     state.seq = 1;
   }
   dout(20) << "(init)dbobjectmap: seq is " << state.seq << dendl;
+  flatten_thread.create();
   return 0;
 }
 
+void DBObjectMap::flatten_thread_entry()
+{
+  dout(10) << __func__ << " start" << dendl;
+  flatten_lock.Lock();
+  while (!flatten_stop) {
+    utime_t interval;
+    interval.set_from_double(g_conf->filestore_omap_flatten_interval);
+    flatten_cond.WaitInterval(g_ceph_context, flatten_lock, interval);
+    if (flatten_stop)
+      break;
+    if (!g_conf->filestore_omap_background_flatten)
+      continue;
+    flatten_lock.Unlock();
+    unsigned n = do_flatten_round(g_conf->filestore_omap_flatten_max_per_cycle);
+    if (n)
+      dout(10) << __func__ << " flattened " << n << " objects" << dendl;
+    flatten_lock.Lock();
+  }
+  flatten_lock.Unlock();
+  dout(10) << __func__ << " finish" << dendl;
+}
+
+unsigned DBObjectMap::do_flatten_round(unsigned max)
+{
+  unsigned flattened = 0;
+  int min_depth = g_conf->filestore_omap_flatten_min_depth;
+  if (min_depth < 1)
+    min_depth = 1;
+  KeyValueDB::Iterator iter = db->get_iterator(HOBJECT_TO_SEQ);
+  for (iter->seek_to_first(); iter->valid() && flattened < max; iter->next()) {
+    if (flatten_stop)
+      break;
+    bufferlist bl = iter->value();
+    bufferlist::iterator bliter = bl.begin();
+    _Header header;
+    header.decode(bliter);
+    if (!header.parent)
+      continue;
+
+    // walk the parent links to find the chain depth.  this is a
+    // read-only probe; a racing foreground op at worst makes us skip
+    // an object or recheck it next cycle
+    int depth = 0;
+    _Header cur = header;
+    while (cur.parent && depth < min_depth) {
+      set<string> to_get;
+      to_get.insert(HEADER_KEY);
+      map<string, bufferlist> got;
+      if (db->get(sys_parent_prefix(cur), to_get, &got) < 0 || got.empty())
+	break;
+      bufferlist::iterator p = got.begin()->second.begin();
+      cur.decode(p);
+      ++depth;
+    }
+    if (depth < min_depth)
+      continue;
+
+    if (flatten_one(header.oid) == 0)
+      ++flattened;
+  }
+  return flattened;
+}
+
+int DBObjectMap::flatten_one(const ghobject_t &oid)
+{
+  Header header;
+  {
+    Mutex::Locker l(header_lock);
+    if (map_header_in_use.count(oid))
+      return -EBUSY;      // a foreground op holds it; try again next cycle
+    header = _lookup_map_header(oid);
+    if (!header || !header->parent)
+      return -ENOENT;     // raced with a foreground op; nothing to do
+    flattening_in_progress.insert(oid);
+  }
+  dout(10) << __func__ << " " << oid << " parent seq " << header->parent
+	   << dendl;
+  KeyValueDB::Transaction t = db->get_transaction();
+  int r = _flatten(oid, header, t);
+  if (r == 0)
+    r = db->submit_transaction(t);
+  {
+    Mutex::Locker l(header_lock);
+    flattening_in_progress.erase(oid);
+    map_header_cond.SignalAll();
+  }
+  return r;
+}
+
 int DBObjectMap::sync(const ghobject_t *oid,
 		      const SequencerPosition *spos) {
   KeyValueDB::Transaction t = db->get_transaction();
@@ -1111,13 +1271,14 @@ int DBObjectMap::write_state(KeyValueDB::Transaction _t) {
 
 DBObjectMap::Header DBObjectMap::_lookup_map_header(const ghobject_t &oid)
 {
-  while (map_header_in_use.count(oid))
-    header_cond.Wait(header_lock);
+  while (flattening_in_progress.count(oid))
+    map_header_cond.Wait(header_lock);
 
   _Header *header = new _Header();
   {
     Mutex::Locker l(cache_lock);
     if (caches.lookup(oid, header)) {
+      map_header_in_use.insert(oid);
       return Header(header, RemoveMapHeaderOnDelete(this, oid));
     }
   }
@@ -1131,6 +1292,7 @@ DBObjectMap::Header DBObjectMap::_lookup_map_header(const ghobject_t &oid)
     return Header();
   }
 
+  map_header_in_use.insert(oid);
   Header ret(header, RemoveMapHeaderOnDelete(this, oid));
   bufferlist::iterator iter = out.begin()->second.begin();
   ret->decode(iter);
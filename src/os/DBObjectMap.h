@@ -16,7 +16,9 @@
 #include "osd/osd_types.h"
 #include "common/Mutex.h"
 #include "common/Cond.h"
+#include "common/Thread.h"
 #include "common/simple_cache.hpp"
+#include "common/MemoryBudget.h"
 
 /**
  * DBObjectMap: Implements ObjectMap in terms of KeyValueDB
@@ -52,7 +54,7 @@
  * key set.  During rm_keys, we copy keys from the parent and update the
  * complete set to reflect the change @see rm_keys.
  */
-class DBObjectMap : public ObjectMap {
+class DBObjectMap : public ObjectMap, public MemoryBudgetClient {
 public:
   boost::scoped_ptr<KeyValueDB> db;
 
@@ -67,13 +69,53 @@ public:
    * Set of headers currently in use
    */
   set<uint64_t> in_use;
-  set<ghobject_t> map_header_in_use;
+  /// map headers with outstanding references; a multiset because one
+  /// caller may legitimately look the same header up twice
+  multiset<ghobject_t> map_header_in_use;
+  /// objects the background flattener is rewriting; lookups wait
+  set<ghobject_t> flattening_in_progress;
 
   DBObjectMap(KeyValueDB *db) : db(db), header_lock("DBOBjectMap"),
                                 cache_lock("DBObjectMap::CacheLock"),
-                                caches(g_conf->filestore_omap_header_cache_size)
+                                mem_budget(NULL),
+                                caches(g_conf->filestore_omap_header_cache_size),
+                                flatten_thread(this),
+                                flatten_lock("DBObjectMap::FlattenLock"),
+                                flatten_stop(false)
     {}
 
+  ~DBObjectMap() {
+    flatten_lock.Lock();
+    flatten_stop = true;
+    flatten_cond.Signal();
+    flatten_lock.Unlock();
+    if (flatten_thread.is_started())
+      flatten_thread.join();
+    if (mem_budget)
+      mem_budget->unregister_client(this);
+  }
+
+  void register_budget(MemoryBudget *budget) {
+    mem_budget = budget;
+    mem_budget->register_client(this);
+  }
+
+  /// MemoryBudgetClient
+  const char *get_cache_name() const {
+    return "omap_header_cache";
+  }
+  void get_cache_stats(uint64_t *bytes, uint64_t *hits, uint64_t *misses) {
+    caches.get_cache_counters(hits, misses);
+    *bytes = caches.get_size() * BYTES_PER_HEADER;
+  }
+  void trim_cache_to(uint64_t bytes) {
+    // the budget only shrinks us; the configured size stays the ceiling
+    uint64_t entries = bytes / BYTES_PER_HEADER;
+    if (entries > (uint64_t)g_conf->filestore_omap_header_cache_size)
+      entries = g_conf->filestore_omap_header_cache_size;
+    caches.set_size(entries);
+  }
+
   int set_keys(
     const ghobject_t &oid,
     const map<string, bufferlist> &set,
@@ -177,6 +219,8 @@ public:
 
   ObjectMapIterator get_iterator(const ghobject_t &oid);
 
+  ObjectMapIterator get_snapshot_iterator(const ghobject_t &oid);
+
   static const string USER_PREFIX;
   static const string XATTR_PREFIX;
   static const string SYS_PREFIX;
@@ -284,8 +328,39 @@ private:
   /// Implicit lock on Header->seq
   typedef ceph::shared_ptr<_Header> Header;
   Mutex cache_lock;
+  MemoryBudget *mem_budget;
+
+  /// rough footprint of a cached _Header (seqs plus coll and oid strings)
+  static const uint64_t BYTES_PER_HEADER = 512;
   SimpleLRU<ghobject_t, _Header> caches;
 
+  /**
+   * Background clone-chain flattener.
+   *
+   * Snapshot-heavy workloads leave omaps whose reads chase a parent
+   * link per clone generation.  This thread periodically walks the
+   * leaf headers and materializes any chain deeper than
+   * filestore_omap_flatten_min_depth, bounding read depth to one.
+   * @see flatten_thread_entry
+   */
+  struct FlattenThread : public Thread {
+    DBObjectMap *map;
+    FlattenThread(DBObjectMap *m) : map(m) {}
+    void *entry() {
+      map->flatten_thread_entry();
+      return 0;
+    }
+  } flatten_thread;
+  Mutex flatten_lock;
+  Cond flatten_cond;
+  bool flatten_stop;
+
+  void flatten_thread_entry();
+  /// flatten up to max deep chains; returns the number flattened
+  unsigned do_flatten_round(unsigned max);
+  /// flatten one object, excluding concurrent access to its header
+  int flatten_one(const ghobject_t &oid);
+
   string map_header_key(const ghobject_t &oid);
   string header_key(uint64_t seq);
   string complete_prefix(Header header);
@@ -319,6 +394,9 @@ private:
     /// NOTE: implicit lock on header->seq AND for all ancestors
     Header header;
 
+    /// iterate over a db snapshot instead of the live store
+    bool snapshot;
+
     /// parent_iter == NULL iff no parent
     ceph::shared_ptr<DBObjectMapIteratorImpl> parent_iter;
     KeyValueDB::Iterator key_iter;
@@ -333,8 +411,10 @@ private:
     /// past end
     bool invalid;
 
-    DBObjectMapIteratorImpl(DBObjectMap *map, Header header) :
-      map(map), header(header), r(0), ready(false), invalid(true) {}
+    DBObjectMapIteratorImpl(DBObjectMap *map, Header header,
+			    bool snapshot = false) :
+      map(map), header(header), snapshot(snapshot),
+      r(0), ready(false), invalid(true) {}
     int seek_to_first();
     int seek_to_last();
     int upper_bound(const string &after);
@@ -344,6 +424,7 @@ private:
     string key();
     bufferlist value();
     int status();
+    int get_next_n(uint64_t max, std::map<string, bufferlist> *out);
 
     bool on_parent() {
       return cur_iter == parent_iter;
@@ -365,8 +446,9 @@ private:
   };
 
   typedef ceph::shared_ptr<DBObjectMapIteratorImpl> DBObjectMapIterator;
-  DBObjectMapIterator _get_iterator(Header header) {
-    return DBObjectMapIterator(new DBObjectMapIteratorImpl(this, header));
+  DBObjectMapIterator _get_iterator(Header header, bool snapshot = false) {
+    return DBObjectMapIterator(
+      new DBObjectMapIteratorImpl(this, header, snapshot));
   }
 
   /// sys
@@ -446,6 +528,15 @@ private:
   int copy_up_header(Header header,
 		     KeyValueDB::Transaction t);
 
+  /**
+   * Copies all keys visible through the parent chain into oid's own
+   * level and drops the parent link, so later accesses pay a single
+   * leveldb lookup instead of one per clone generation.
+   * @see set_keys
+   */
+  int _flatten(const ghobject_t &oid, Header header,
+	       KeyValueDB::Transaction t);
+
   /// Sets header @see set_header
   void _set_header(Header header, const bufferlist &bl,
 		   KeyValueDB::Transaction t);
@@ -462,7 +553,9 @@ private:
       db(db), oid(oid) {}
     void operator() (_Header *header) {
       Mutex::Locker l(db->header_lock);
-      db->map_header_in_use.erase(oid);
+      multiset<ghobject_t>::iterator i = db->map_header_in_use.find(oid);
+      assert(i != db->map_header_in_use.end());
+      db->map_header_in_use.erase(i);
       db->map_header_cond.Signal();
       delete header;
     }
@@ -0,0 +1,132 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <errno.h>
+
+#include "ExtentAllocator.h"
+#include "include/assert.h"
+
+void ExtentAllocator::_insert_free(uint64_t offset, uint64_t length)
+{
+  assert(lock.is_locked());
+
+  // coalesce with the extent to our left, if adjacent
+  std::map<uint64_t, uint64_t>::iterator p = free_map.lower_bound(offset);
+  if (p != free_map.begin()) {
+    std::map<uint64_t, uint64_t>::iterator prev = p;
+    --prev;
+    assert(prev->first + prev->second <= offset);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      length += prev->second;
+      free_map.erase(prev);
+    }
+  }
+
+  // and with the extent to our right
+  if (p != free_map.end()) {
+    assert(offset + length <= p->first);
+    if (offset + length == p->first) {
+      length += p->second;
+      free_map.erase(p);
+    }
+  }
+
+  free_map[offset] = length;
+}
+
+void ExtentAllocator::init_add_free(uint64_t offset, uint64_t length)
+{
+  Mutex::Locker l(lock);
+  _insert_free(offset, length);
+  num_free += length;
+}
+
+void ExtentAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  Mutex::Locker l(lock);
+
+  std::map<uint64_t, uint64_t>::iterator p = free_map.upper_bound(offset);
+  assert(p != free_map.begin());
+  --p;
+  assert(p->first <= offset);
+  assert(p->first + p->second >= offset + length);
+
+  uint64_t left = offset - p->first;
+  uint64_t right = (p->first + p->second) - (offset + length);
+  free_map.erase(p);
+  if (left)
+    free_map[offset - left] = left;
+  if (right)
+    free_map[offset + length] = right;
+  num_free -= length;
+}
+
+int ExtentAllocator::allocate(uint64_t want_len, uint64_t alloc_unit,
+			      uint64_t *offset, uint64_t *length)
+{
+  Mutex::Locker l(lock);
+  assert(alloc_unit > 0);
+  assert((alloc_unit & (alloc_unit - 1)) == 0);  // power of two
+
+  want_len = ROUND_UP_TO(want_len, alloc_unit);
+
+  // first fit from the cursor, wrapping around once; starting where
+  // the last allocation left off keeps sequential allocations laid
+  // out sequentially and avoids rescanning the (fragmented) start of
+  // the device every time
+  for (int pass = 0; pass < 2; ++pass) {
+    std::map<uint64_t, uint64_t>::iterator p =
+      free_map.lower_bound(pass ? 0 : cursor);
+    std::map<uint64_t, uint64_t>::iterator end =
+      pass ? free_map.lower_bound(cursor) : free_map.end();
+    for (; p != end; ++p) {
+      uint64_t off = ROUND_UP_TO(p->first, alloc_unit);
+      uint64_t extent_end = p->first + p->second;
+      if (off + alloc_unit > extent_end)
+	continue;  // alignment ate the whole extent
+      uint64_t len = extent_end - off;
+      len -= len % alloc_unit;
+      if (len > want_len)
+	len = want_len;
+
+      // carve [off, off+len) out of *p
+      uint64_t orig_off = p->first;
+      uint64_t orig_len = p->second;
+      free_map.erase(p);
+      if (off > orig_off)
+	free_map[orig_off] = off - orig_off;
+      if (off + len < orig_off + orig_len)
+	free_map[off + len] = (orig_off + orig_len) - (off + len);
+
+      num_free -= len;
+      cursor = off + len;
+      *offset = off;
+      *length = len;
+      return 0;
+    }
+  }
+  return -ENOSPC;
+}
+
+void ExtentAllocator::release(uint64_t offset, uint64_t length)
+{
+  Mutex::Locker l(lock);
+  _insert_free(offset, length);
+  num_free += length;
+}
+
+uint64_t ExtentAllocator::get_free()
+{
+  Mutex::Locker l(lock);
+  return num_free;
+}
@@ -0,0 +1,80 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_EXTENTALLOCATOR_H
+#define CEPH_EXTENTALLOCATOR_H
+
+#include <map>
+#include "include/types.h"
+#include "common/Mutex.h"
+
+/**
+ * ExtentAllocator
+ *
+ * Tracks free space on a raw block device as a set of extents and
+ * hands out aligned allocations from it.  This is the space manager
+ * for an ObjectStore backend that writes object data to a block
+ * device directly instead of through a filesystem; the allocator
+ * itself is deliberately independent of any backend so it can be unit
+ * tested (and reused) on its own.
+ *
+ * Allocation is first-fit from a rolling cursor, which keeps the
+ * structure simple and tends to lay sequential writes out
+ * sequentially.  An allocate() call returns a single contiguous
+ * extent of up to the wanted length; callers needing more loop until
+ * satisfied, building up an extent list.
+ *
+ * All sizes and offsets are bytes.  Thread safe.
+ */
+class ExtentAllocator {
+  Mutex lock;
+  std::map<uint64_t, uint64_t> free_map;  ///< offset -> length, coalesced
+  uint64_t num_free;                      ///< total free bytes
+  uint64_t cursor;                        ///< where the next search starts
+
+  void _insert_free(uint64_t offset, uint64_t length);
+
+public:
+  ExtentAllocator() :
+    lock("ExtentAllocator::lock"),
+    num_free(0), cursor(0) {}
+
+  /// add a region to the free set (initialization / release of space)
+  void init_add_free(uint64_t offset, uint64_t length);
+
+  /// remove a region from the free set (initialization; region must be free)
+  void init_rm_free(uint64_t offset, uint64_t length);
+
+  /**
+   * allocate up to want_len bytes as one contiguous extent
+   *
+   * Both the returned offset and length are multiples of alloc_unit.
+   * A shorter extent than want_len may be returned when the free
+   * space is fragmented; the caller loops to gather the remainder.
+   *
+   * @param want_len number of bytes wanted (rounded up to alloc_unit)
+   * @param alloc_unit allocation granularity, must be a power of two
+   * @param offset [out] start of the allocated extent
+   * @param length [out] length of the allocated extent
+   * @return 0 on success, -ENOSPC if no aligned extent is free
+   */
+  int allocate(uint64_t want_len, uint64_t alloc_unit,
+	       uint64_t *offset, uint64_t *length);
+
+  /// return an allocated extent to the free set
+  void release(uint64_t offset, uint64_t length);
+
+  /// total free bytes (not all of it may be allocatable at a given unit)
+  uint64_t get_free();
+};
+
+#endif
@@ -22,12 +22,22 @@
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "common/shared_cache.hpp"
+#include "common/ceph_context.h"
+#include "common/perf_counters.h"
+#include "common/MemoryBudget.h"
 #include "include/compat.h"
 
+enum {
+  l_fdcache_first = 999190,
+  l_fdcache_hit,
+  l_fdcache_miss,
+  l_fdcache_last,
+};
+
 /**
  * FD Cache
  */
-class FDCache : public md_config_obs_t {
+class FDCache : public md_config_obs_t, public MemoryBudgetClient {
 public:
   /**
    * FD
@@ -49,32 +59,100 @@ public:
   };
 
 private:
-  SharedLRU<ghobject_t, FD> registry;
   CephContext *cct;
+  PerfCounters *logger;
+  MemoryBudget *mem_budget;
+
+  /// nominal charge per cached fd: the descriptor itself is cheap, but
+  /// each one pins a kernel file struct, dentry and inode
+  static const uint64_t BYTES_PER_FD = 1024;
+
+  /// the registry is sharded by object hash so that lookups on
+  /// different objects do not all contend on a single LRU lock
+  int registry_shards;
+  SharedLRU<ghobject_t, FD> *registry;
+
+  SharedLRU<ghobject_t, FD> &shard(const ghobject_t &hoid) {
+    return registry[hoid.hobj.hash % registry_shards];
+  }
+
+  void set_size(int size) {
+    int per_shard = size / registry_shards;
+    if (per_shard < 1)
+      per_shard = 1;
+    for (int i = 0; i < registry_shards; ++i)
+      registry[i].set_size(per_shard);
+  }
 
 public:
-  FDCache(CephContext *cct) : cct(cct) {
+  FDCache(CephContext *cct) : cct(cct), logger(NULL), mem_budget(NULL) {
     assert(cct);
     cct->_conf->add_observer(this);
-    registry.set_size(cct->_conf->filestore_fd_cache_size);
+    registry_shards = cct->_conf->filestore_fd_cache_shards;
+    if (registry_shards < 1)
+      registry_shards = 1;
+    registry = new SharedLRU<ghobject_t, FD>[registry_shards];
+    set_size(cct->_conf->filestore_fd_cache_size);
+
+    PerfCountersBuilder b(cct, "fdcache", l_fdcache_first, l_fdcache_last);
+    b.add_u64_counter(l_fdcache_hit, "hit");
+    b.add_u64_counter(l_fdcache_miss, "miss");
+    logger = b.create_perf_counters();
+    cct->get_perfcounters_collection()->add(logger);
   }
   ~FDCache() {
+    if (mem_budget)
+      mem_budget->unregister_client(this);
     cct->_conf->remove_observer(this);
+    cct->get_perfcounters_collection()->remove(logger);
+    delete logger;
+    delete[] registry;
   }
   typedef ceph::shared_ptr<FD> FDRef;
 
   FDRef lookup(const ghobject_t &hoid) {
-    return registry.lookup(hoid);
+    FDRef ref = shard(hoid).lookup(hoid);
+    logger->inc(ref ? l_fdcache_hit : l_fdcache_miss);
+    return ref;
   }
 
   FDRef add(const ghobject_t &hoid, int fd) {
-    return registry.add(hoid, new FD(fd));
+    return shard(hoid).add(hoid, new FD(fd));
   }
 
   /// clear cached fd for hoid, subsequent lookups will get an empty FD
   void clear(const ghobject_t &hoid) {
-    registry.clear(hoid);
-    assert(!registry.lookup(hoid));
+    shard(hoid).clear(hoid);
+    assert(!shard(hoid).lookup(hoid));
+  }
+
+  void register_budget(MemoryBudget *budget) {
+    mem_budget = budget;
+    mem_budget->register_client(this);
+  }
+
+  /// MemoryBudgetClient
+  const char *get_cache_name() const {
+    return "fdcache";
+  }
+  void get_cache_stats(uint64_t *bytes, uint64_t *hits, uint64_t *misses) {
+    size_t entries = 0;
+    *hits = *misses = 0;
+    for (int i = 0; i < registry_shards; ++i) {
+      entries += registry[i].get_size();
+      uint64_t h, m;
+      registry[i].get_cache_counters(&h, &m);
+      *hits += h;
+      *misses += m;
+    }
+    *bytes = entries * BYTES_PER_FD;
+  }
+  void trim_cache_to(uint64_t bytes) {
+    // the budget only shrinks us; the configured size stays the ceiling
+    uint64_t entries = bytes / BYTES_PER_FD;
+    if (entries > (uint64_t)cct->_conf->filestore_fd_cache_size)
+      entries = cct->_conf->filestore_fd_cache_size;
+    set_size(entries);
   }
 
   /// md_config_obs_t
@@ -88,7 +166,7 @@ public:
   void handle_conf_change(const md_config_t *conf,
 			  const std::set<std::string> &changed) {
     if (changed.count("filestore_fd_cache_size")) {
-      registry.set_size(conf->filestore_fd_cache_size);
+      set_size(conf->filestore_fd_cache_size);
     }
   }
 
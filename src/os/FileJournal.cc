@@ -1100,6 +1100,7 @@ void FileJournal::write_thread_entry()
 {
   dout(10) << "write_thread_entry start" << dendl;
   while (1) {
+    utime_t batch_oldest;
     {
       Mutex::Locker locker(writeq_lock);
       if (writeq.empty()) {
@@ -1110,8 +1111,34 @@ void FileJournal::write_thread_entry()
 	dout(20) << "write_thread_entry woke up" << dendl;
 	continue;
       }
+
+      // group commit: while the oldest queued entry is still within
+      // its latency budget, wait for more entries so this submission
+      // merges them into one journal write instead of many tiny ones.
+      // we give up early once we have a full write's worth queued.
+      double budget = g_conf->journal_batch_interval;
+      if (budget > 0) {
+	while (!write_stop &&
+	       (int)writeq.size() < g_conf->journal_max_write_entries &&
+	       throttle_bytes.get_current() <
+		 (int64_t)g_conf->journal_max_write_bytes) {
+	  double age = ceph_clock_now(g_ceph_context) -
+	    writeq.front().queue_stamp;
+	  if (age >= budget)
+	    break;
+	  dout(20) << "write_thread_entry batching, " << writeq.size()
+		   << " entries, oldest " << age << " of " << budget
+		   << " budget" << dendl;
+	  utime_t t;
+	  t.set_from_double(budget - age);
+	  writeq_cond.WaitInterval(g_ceph_context, writeq_lock, t);
+	}
+	if (writeq.empty())
+	  continue;
+      }
+      batch_oldest = writeq.front().queue_stamp;
     }
-    
+
 #ifdef HAVE_LIBAIO
     if (aio) {
       Mutex::Locker locker(aio_lock);
@@ -1126,7 +1153,20 @@ void FileJournal::write_thread_entry()
       // but should be fine given that we will have plenty of aios in
       // flight if we hit this limit to ensure we keep the device
       // saturated.
-      while (aio_num > 0) {
+      int depth = g_conf->journal_aio_queue_depth;
+      if (depth > 0) {
+	// fixed window: submit freely until the configured number of
+	// aios are in flight.  the adaptive heuristic below optimizes
+	// for spindles by accumulating larger aios; on flash many
+	// small concurrent writes are what keeps the device busy, so
+	// just keep its queue full.
+	while (aio_num >= depth) {
+	  dout(20) << "write_thread_entry aio queue full: " << aio_num
+		   << " >= " << depth << ", waiting" << dendl;
+	  aio_cond.Wait(aio_lock);
+	  dout(20) << "write_thread_entry woke up" << dendl;
+	}
+      } else while (aio_num > 0) {
 	int exp = MIN(aio_num * 2, 24);
 	long unsigned min_new = 1ull << exp;
 	long unsigned cur = throttle_bytes.get_current();
@@ -1161,6 +1201,9 @@ void FileJournal::write_thread_entry()
     if (logger) {
       logger->inc(l_os_j_wr);
       logger->inc(l_os_j_wr_bytes, bl.length());
+      logger->inc(l_os_j_wr_entries, orig_ops);
+      logger->tinc(l_os_j_batch_lat,
+		   ceph_clock_now(g_ceph_context) - batch_oldest);
     }
 
 #ifdef HAVE_LIBAIO
@@ -1438,12 +1481,15 @@ void FileJournal::submit_entry(uint64_t seq, bufferlist& e, int alignment,
   }
 
   {
+    utime_t now = ceph_clock_now(g_ceph_context);
     Mutex::Locker l1(writeq_lock);  // ** lock **
     Mutex::Locker l2(completions_lock);  // ** lock **
     completions.push_back(
       completion_item(
-	seq, oncommit, ceph_clock_now(g_ceph_context), osd_op));
-    writeq.push_back(write_item(seq, e, alignment, osd_op));
+	seq, oncommit, now, osd_op));
+    write_item w(seq, e, alignment, osd_op);
+    w.queue_stamp = now;
+    writeq.push_back(w);
     writeq_cond.Signal();
   }
 }
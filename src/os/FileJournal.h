@@ -51,6 +51,7 @@ public:
     uint64_t seq;
     bufferlist bl;
     int alignment;
+    utime_t queue_stamp;   ///< when the entry was queued, for group commit
     TrackedOpRef tracked_op;
     write_item(uint64_t s, bufferlist& b, int al, TrackedOpRef opref) :
       seq(s), alignment(al), tracked_op(opref) {
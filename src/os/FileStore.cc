@@ -68,6 +68,7 @@
 #include "common/fd.h"
 #include "HashIndex.h"
 #include "DBObjectMap.h"
+#include "GenericObjectMap.h"
 #include "LevelDBStore.h"
 
 #include "common/ceph_crypto.h"
@@ -94,6 +95,18 @@ using ceph::crypto::SHA1;
 #define XATTR_NO_SPILL_OUT "0"
 #define XATTR_SPILL_OUT "1"
 
+// prefix for inline object data in the omap kv store; must not collide
+// with the DBObjectMap prefixes
+const string INLINE_DATA_PREFIX = "_ILINEDATA_";
+
+// ordered per-collection object index in the omap kv store; keys are
+// GenericObjectMap::header_key(cid, oid), so a range scan yields the
+// collection's objects in ghobject_t order
+const string COLL_INDEX_PREFIX = "_COLLINDEX_";
+// per-collection marker (keyed by coll_t string) recording that the
+// index above is complete for that collection
+const string COLL_INDEX_META_PREFIX = "_COLLINDEXMETA_";
+
 //Initial features in new superblock.
 static CompatSet get_fs_initial_compat_set() {
   CompatSet::FeatureSet ceph_osd_feature_compat;
@@ -395,6 +408,11 @@ int FileStore::lfn_unlink(coll_t cid, const ghobject_t& o,
 	assert(!m_filestore_fail_eio || r != -EIO);
 	return r;
       }
+      r = _inline_rm(o);
+      if (r < 0) {
+	assert(!m_filestore_fail_eio || r != -EIO);
+	return r;
+      }
       if (g_conf->filestore_debug_inject_read_err) {
 	debug_obj_on_delete(o);
       }
@@ -408,7 +426,10 @@ int FileStore::lfn_unlink(coll_t cid, const ghobject_t& o,
 	object_map->sync(&o, &spos);
     }
   }
-  return index->unlink(o);
+  r = index->unlink(o);
+  if (r < 0)
+    return r;
+  return _cindex_rm(cid, o);
 }
 
 FileStore::FileStore(const std::string &base, const std::string &jdev, const char *name, bool do_update) :
@@ -420,6 +441,8 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, const cha
   basedir_fd(-1), current_fd(-1),
   backend(NULL),
   index_manager(do_update),
+  inline_db(NULL),
+  coll_index_lock("FileStore::coll_index_lock"),
   ondisk_finisher(g_ceph_context),
   lock("FileStore::lock"),
   force_sync(false), sync_epoch(0),
@@ -436,6 +459,13 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, const cha
   op_tp(g_ceph_context, "FileStore::op_tp", g_conf->filestore_op_threads, "filestore_op_threads"),
   op_wq(this, g_conf->filestore_op_thread_timeout,
 	g_conf->filestore_op_thread_suicide_timeout, &op_tp),
+#ifdef HAVE_LIBAIO
+  read_aio_lock("FileStore::read_aio_lock"),
+  read_aio_ctx(0),
+  read_aio_num(0), read_aio_stop(false),
+  read_aio_thread(this),
+  read_finisher(g_ceph_context),
+#endif
   logger(NULL),
   read_error_lock("FileStore::read_error_lock"),
   m_filestore_commit_timeout(g_conf->filestore_commit_timeout),
@@ -447,6 +477,7 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, const cha
   m_filestore_min_sync_interval(g_conf->filestore_min_sync_interval),
   m_filestore_fail_eio(g_conf->filestore_fail_eio),
   m_filestore_replica_fadvise(g_conf->filestore_replica_fadvise),
+  m_filestore_aio_reads(g_conf->filestore_aio_reads),
   do_update(do_update),
   m_journal_dio(g_conf->journal_dio),
   m_journal_aio(g_conf->journal_aio),
@@ -462,6 +493,8 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, const cha
   m_filestore_sloppy_crc(g_conf->filestore_sloppy_crc),
   m_filestore_sloppy_crc_block_size(g_conf->filestore_sloppy_crc_block_size),
   m_filestore_max_alloc_hint_size(g_conf->filestore_max_alloc_hint_size),
+  m_filestore_inline_data_size(g_conf->filestore_inline_data_size),
+  m_filestore_collection_index(g_conf->filestore_collection_index),
   m_fs_type(0),
   m_filestore_max_inline_xattr_size(0),
   m_filestore_max_inline_xattrs(0)
@@ -492,6 +525,8 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, const cha
   plb.add_time_avg(l_os_j_lat, "journal_latency");
   plb.add_u64_counter(l_os_j_wr, "journal_wr");
   plb.add_u64_avg(l_os_j_wr_bytes, "journal_wr_bytes");
+  plb.add_u64_avg(l_os_j_wr_entries, "journal_wr_entries");
+  plb.add_time_avg(l_os_j_batch_lat, "journal_batch_latency");
   plb.add_u64(l_os_oq_max_ops, "op_queue_max_ops");
   plb.add_u64(l_os_oq_ops, "op_queue_ops");
   plb.add_u64_counter(l_os_ops, "ops");
@@ -1399,6 +1434,19 @@ int FileStore::mount()
       goto close_current_fd;
     }
     object_map.reset(dbomap);
+    inline_db = omap_store;
+
+    // load the set of collections whose object index lives in the kv store
+    {
+      Mutex::Locker l(coll_index_lock);
+      indexed_colls.clear();
+      KeyValueDB::Iterator it = inline_db->get_iterator(COLL_INDEX_META_PREFIX);
+      for (it->seek_to_first(); it->valid(); it->next())
+	indexed_colls.insert(coll_t(it->key()));
+      if (!indexed_colls.empty())
+	dout(10) << "mount: " << indexed_colls.size()
+		 << " collection(s) indexed in kv store" << dendl;
+    }
   }
 
   // journal
@@ -1497,6 +1545,23 @@ int FileStore::mount()
   op_finisher.start();
   ondisk_finisher.start();
 
+#ifdef HAVE_LIBAIO
+  if (m_filestore_aio_reads) {
+    read_aio_ctx = 0;
+    ret = io_setup(g_conf->filestore_aio_read_depth, &read_aio_ctx);
+    if (ret < 0) {
+      derr << "mount io_setup failed: " << cpp_strerror(ret)
+	   << ", falling back to synchronous reads" << dendl;
+      m_filestore_aio_reads = false;
+      ret = 0;
+    } else {
+      read_aio_stop = false;
+      read_aio_thread.create();
+      read_finisher.start();
+    }
+  }
+#endif
+
   timer.init();
 
   // all okay.
@@ -1516,7 +1581,14 @@ done:
   return ret;
 }
 
-int FileStore::umount() 
+void FileStore::register_caches(MemoryBudget *budget)
+{
+  fdcache.register_budget(budget);
+  if (object_map)
+    object_map->register_budget(budget);
+}
+
+int FileStore::umount()
 {
   dout(5) << "umount " << basedir << dendl;
   
@@ -1536,6 +1608,18 @@ int FileStore::umount()
   op_finisher.stop();
   ondisk_finisher.stop();
 
+#ifdef HAVE_LIBAIO
+  if (read_aio_thread.is_started()) {
+    read_aio_lock.Lock();
+    read_aio_stop = true;
+    read_aio_lock.Unlock();
+    read_aio_thread.join();
+    read_finisher.stop();
+    io_destroy(read_aio_ctx);
+    read_aio_ctx = 0;
+  }
+#endif
+
   if (fsid_fd >= 0) {
     VOID_TEMP_FAILURE_RETRY(::close(fsid_fd));
     fsid_fd = -1;
@@ -1556,7 +1640,12 @@ int FileStore::umount()
   delete backend;
   backend = NULL;
 
+  inline_db = NULL;  // owned by object_map
   object_map.reset();
+  {
+    Mutex::Locker l(coll_index_lock);
+    indexed_colls.clear();
+  }
 
   {
     Mutex::Locker l(sync_entry_timeo_lock);
@@ -2595,11 +2684,289 @@ bool FileStore::exists(coll_t cid, const ghobject_t& oid)
     return false;
 }
   
+// -- inline object data --
+
+int FileStore::_inline_get(const ghobject_t& oid, bufferlist *bl)
+{
+  if (!inline_db)
+    return -ENOENT;
+  set<string> keys;
+  map<string, bufferlist> got;
+  keys.insert(DBObjectMap::ghobject_key(oid));
+  int r = inline_db->get(INLINE_DATA_PREFIX, keys, &got);
+  if (r < 0)
+    return r;
+  if (got.empty())
+    return -ENOENT;
+  bl->claim(got.begin()->second);
+  return 0;
+}
+
+int FileStore::_inline_set(const ghobject_t& oid, const bufferlist& bl)
+{
+  assert(inline_db);
+  KeyValueDB::Transaction t = inline_db->get_transaction();
+  t->set(INLINE_DATA_PREFIX, DBObjectMap::ghobject_key(oid), bl);
+  return inline_db->submit_transaction(t);
+}
+
+int FileStore::_inline_rm(const ghobject_t& oid)
+{
+  if (!inline_db)
+    return 0;
+  KeyValueDB::Transaction t = inline_db->get_transaction();
+  t->rmkey(INLINE_DATA_PREFIX, DBObjectMap::ghobject_key(oid));
+  return inline_db->submit_transaction(t);
+}
+
+int FileStore::_inline_write(const ghobject_t& oid, uint64_t offset, size_t len,
+			     const bufferlist& bl, const FDRef& fd)
+{
+  if (!inline_db)
+    return 0;
+  struct stat st;
+  int r = ::fstat(**fd, &st);
+  if (r < 0)
+    return -errno;
+  if (st.st_size > 0)
+    return 0;   // never inline once the object has file data
+  bufferlist old;
+  r = _inline_get(oid, &old);
+  bool had = (r == 0);
+  if (r < 0 && r != -ENOENT)
+    return r;
+  if (m_filestore_inline_data_size &&
+      !m_filestore_sloppy_crc &&
+      offset + len <= m_filestore_inline_data_size) {
+    // splice the write into the existing inline bytes
+    bufferlist ibl;
+    if (offset) {
+      if (old.length() >= offset) {
+	ibl.substr_of(old, 0, offset);
+      } else {
+	ibl.substr_of(old, 0, old.length());
+	ibl.append_zero(offset - old.length());
+      }
+    }
+    ibl.append(bl);
+    if (old.length() > ibl.length()) {
+      bufferlist tail;
+      tail.substr_of(old, ibl.length(), old.length() - ibl.length());
+      ibl.append(tail);
+    }
+    r = _inline_set(oid, ibl);
+    if (r < 0)
+      return r;
+    dout(15) << "_inline_write " << oid << " " << offset << "~" << len
+	     << " (" << ibl.length() << " inline)" << dendl;
+    return 1;
+  }
+  if (had) {
+    // outgrew the threshold (or inlining is off); move the existing
+    // bytes into the file before the new write lands
+    dout(15) << "_inline_write " << oid << " pushing " << old.length()
+	     << " inline bytes out to the file" << dendl;
+    r = old.write_fd(**fd);
+    if (r < 0)
+      return r;
+    r = _inline_rm(oid);
+    if (r < 0)
+      return r;
+  }
+  return 0;
+}
+
+int FileStore::_inline_materialize(coll_t cid, const ghobject_t& oid)
+{
+  bufferlist bl;
+  int r = _inline_get(oid, &bl);
+  if (r == -ENOENT)
+    return 0;
+  if (r < 0)
+    return r;
+  dout(15) << "_inline_materialize " << cid << "/" << oid
+	   << " " << bl.length() << " bytes" << dendl;
+  FDRef fd;
+  r = lfn_open(cid, oid, false, &fd);
+  if (r < 0)
+    return r;
+  r = bl.write_fd(**fd);
+  lfn_close(fd);
+  if (r < 0)
+    return r;
+  return _inline_rm(oid);
+}
+
+// -- kv collection index --
+
+bool FileStore::_coll_indexed(coll_t cid)
+{
+  Mutex::Locker l(coll_index_lock);
+  return indexed_colls.count(cid);
+}
+
+int FileStore::_cindex_add(coll_t cid, const ghobject_t& oid)
+{
+  if (!inline_db || !_coll_indexed(cid))
+    return 0;
+  bufferlist empty;
+  KeyValueDB::Transaction t = inline_db->get_transaction();
+  t->set(COLL_INDEX_PREFIX, GenericObjectMap::header_key(cid, oid), empty);
+  return inline_db->submit_transaction(t);
+}
+
+int FileStore::_cindex_rm(coll_t cid, const ghobject_t& oid)
+{
+  if (!inline_db || !_coll_indexed(cid))
+    return 0;
+  KeyValueDB::Transaction t = inline_db->get_transaction();
+  t->rmkey(COLL_INDEX_PREFIX, GenericObjectMap::header_key(cid, oid));
+  return inline_db->submit_transaction(t);
+}
+
+int FileStore::_cindex_create(coll_t cid)
+{
+  if (!inline_db || !m_filestore_collection_index)
+    return 0;
+  {
+    Mutex::Locker l(coll_index_lock);
+    indexed_colls.insert(cid);
+  }
+  dout(10) << "_cindex_create " << cid << dendl;
+  bufferlist empty;
+  KeyValueDB::Transaction t = inline_db->get_transaction();
+  t->set(COLL_INDEX_META_PREFIX, cid.to_str(), empty);
+  return inline_db->submit_transaction(t);
+}
+
+int FileStore::_cindex_destroy(coll_t cid)
+{
+  if (!inline_db)
+    return 0;
+  {
+    Mutex::Locker l(coll_index_lock);
+    if (!indexed_colls.erase(cid))
+      return 0;
+  }
+  dout(10) << "_cindex_destroy " << cid << dendl;
+  KeyValueDB::Transaction t = inline_db->get_transaction();
+  t->rmkey(COLL_INDEX_META_PREFIX, cid.to_str());
+  // the collection is empty by now; drop any leftover entries anyway
+  string prefix = GenericObjectMap::header_key(cid);
+  KeyValueDB::Iterator iter = inline_db->get_iterator(COLL_INDEX_PREFIX);
+  for (iter->lower_bound(prefix); iter->valid(); iter->next()) {
+    if (iter->key().substr(0, prefix.size()) != prefix)
+      break;
+    t->rmkey(COLL_INDEX_PREFIX, iter->key());
+  }
+  return inline_db->submit_transaction(t);
+}
+
+int FileStore::_cindex_move_coll(coll_t cid, coll_t ncid)
+{
+  if (!inline_db)
+    return 0;
+  {
+    Mutex::Locker l(coll_index_lock);
+    if (!indexed_colls.erase(cid))
+      return 0;
+    indexed_colls.insert(ncid);
+  }
+  dout(10) << "_cindex_move_coll " << cid << " -> " << ncid << dendl;
+  bufferlist empty;
+  KeyValueDB::Transaction t = inline_db->get_transaction();
+  t->rmkey(COLL_INDEX_META_PREFIX, cid.to_str());
+  t->set(COLL_INDEX_META_PREFIX, ncid.to_str(), empty);
+  string prefix = GenericObjectMap::header_key(cid);
+  KeyValueDB::Iterator iter = inline_db->get_iterator(COLL_INDEX_PREFIX);
+  for (iter->lower_bound(prefix); iter->valid(); iter->next()) {
+    if (iter->key().substr(0, prefix.size()) != prefix)
+      break;
+    coll_t c;
+    ghobject_t oid;
+    if (!GenericObjectMap::parse_header_key(iter->key(), &c, &oid))
+      return -EINVAL;
+    t->rmkey(COLL_INDEX_PREFIX, iter->key());
+    t->set(COLL_INDEX_PREFIX, GenericObjectMap::header_key(ncid, oid), empty);
+  }
+  return inline_db->submit_transaction(t);
+}
+
+int FileStore::_cindex_split(coll_t cid, uint32_t bits, uint32_t rem,
+			     coll_t dest)
+{
+  if (!inline_db || !_coll_indexed(cid))
+    return 0;
+  dout(10) << "_cindex_split " << cid << " bits " << bits << " -> "
+	   << dest << dendl;
+  bool dest_indexed = _coll_indexed(dest);
+  bufferlist empty;
+  KeyValueDB::Transaction t = inline_db->get_transaction();
+  string prefix = GenericObjectMap::header_key(cid);
+  KeyValueDB::Iterator iter = inline_db->get_iterator(COLL_INDEX_PREFIX);
+  for (iter->lower_bound(prefix); iter->valid(); iter->next()) {
+    if (iter->key().substr(0, prefix.size()) != prefix)
+      break;
+    coll_t c;
+    ghobject_t oid;
+    if (!GenericObjectMap::parse_header_key(iter->key(), &c, &oid))
+      return -EINVAL;
+    if (!oid.match(bits, rem))
+      continue;
+    t->rmkey(COLL_INDEX_PREFIX, iter->key());
+    if (dest_indexed)
+      t->set(COLL_INDEX_PREFIX, GenericObjectMap::header_key(dest, oid),
+	     empty);
+  }
+  return inline_db->submit_transaction(t);
+}
+
+int FileStore::_cindex_list(coll_t cid, ghobject_t start, int max,
+			    vector<ghobject_t> *ls, ghobject_t *next)
+{
+  assert(inline_db);
+  if (start.is_max()) {
+    if (next)
+      *next = start;
+    return 0;
+  }
+  string prefix = GenericObjectMap::header_key(cid);
+  string pos;
+  if (start == ghobject_t())
+    pos = prefix;
+  else
+    pos = GenericObjectMap::header_key(cid, start);
+  KeyValueDB::Iterator iter = inline_db->get_iterator(COLL_INDEX_PREFIX);
+  for (iter->lower_bound(pos); iter->valid(); iter->next()) {
+    if (iter->key().substr(0, prefix.size()) != prefix)
+      break;
+    coll_t c;
+    ghobject_t oid;
+    if (!GenericObjectMap::parse_header_key(iter->key(), &c, &oid))
+      return -EINVAL;
+    if (max && (int)ls->size() >= max) {
+      if (next)
+	*next = oid;
+      return 0;
+    }
+    ls->push_back(oid);
+  }
+  if (next)
+    *next = ghobject_t::get_max();
+  return 0;
+}
+
 int FileStore::stat(
   coll_t cid, const ghobject_t& oid, struct stat *st, bool allow_eio)
 {
   int r = lfn_stat(cid, oid, st);
   assert(allow_eio || !m_filestore_fail_eio || r != -EIO);
+  if (r == 0 && st->st_size == 0) {
+    // the data, if any, may live inline in the omap db
+    bufferlist ibl;
+    if (_inline_get(oid, &ibl) == 0)
+      st->st_size = ibl.length();
+  }
   if (r < 0) {
     dout(10) << "stat " << cid << "/" << oid
 	     << " = " << r << dendl;
@@ -2636,13 +3003,26 @@ int FileStore::read(
     return r;
   }
 
-  if (len == 0) {
-    struct stat st;
-    memset(&st, 0, sizeof(struct stat));
-    int r = ::fstat(**fd, &st);
-    assert(r == 0);
-    len = st.st_size;
+  struct stat st;
+  memset(&st, 0, sizeof(struct stat));
+  r = ::fstat(**fd, &st);
+  assert(r == 0);
+  if (st.st_size == 0) {
+    // zero-length file: the data, if any, lives inline in the omap db
+    bufferlist ibl;
+    if (_inline_get(oid, &ibl) == 0) {
+      lfn_close(fd);
+      if (len == 0)
+	len = ibl.length();
+      if (offset < ibl.length())
+	bl.substr_of(ibl, offset, MIN(len, ibl.length() - offset));
+      dout(10) << "FileStore::read " << cid << "/" << oid << " " << offset
+	       << "~" << bl.length() << "/" << len << " (inline)" << dendl;
+      return bl.length();
+    }
   }
+  if (len == 0)
+    len = st.st_size;
 
   bufferptr bptr(len);  // prealloc space for entire read
   got = safe_pread(**fd, bptr.c_str(), len, offset);
@@ -2677,6 +3057,158 @@ int FileStore::read(
   }
 }
 
+int FileStore::aio_read(
+  coll_t cid,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t len,
+  bufferlist *pbl,
+  Context *onfinish,
+  bool allow_eio)
+{
+#ifdef HAVE_LIBAIO
+  dout(15) << "aio_read " << cid << "/" << oid << " " << offset << "~" << len << dendl;
+
+  if (!m_filestore_aio_reads || !read_aio_thread.is_started())
+    return ObjectStore::aio_read(cid, oid, offset, len, pbl, onfinish,
+				 allow_eio);
+
+  IndexedPath path;
+  int r = lfn_find(cid, oid, &path);
+  if (r < 0) {
+    dout(10) << "FileStore::aio_read(" << cid << "/" << oid << ") open error: "
+	     << cpp_strerror(r) << dendl;
+    onfinish->complete(r);
+    return 0;
+  }
+
+  // the fds in the fdcache are buffered; aio is only actually
+  // asynchronous with O_DIRECT, so open our own
+  int fd = TEMP_FAILURE_RETRY(::open(path->path(), O_RDONLY|O_DIRECT));
+  if (fd < 0) {
+    // the fs may not support O_DIRECT; fall back to the sync path
+    dout(10) << "FileStore::aio_read(" << cid << "/" << oid
+	     << ") O_DIRECT open failed: " << cpp_strerror(-errno)
+	     << ", reading synchronously" << dendl;
+    return ObjectStore::aio_read(cid, oid, offset, len, pbl, onfinish,
+				 allow_eio);
+  }
+
+  struct stat st;
+  memset(&st, 0, sizeof(struct stat));
+  r = ::fstat(fd, &st);
+  assert(r == 0);
+  if (st.st_size == 0) {
+    // zero-length file: the data, if any, lives inline in the omap db
+    bufferlist ibl;
+    if (_inline_get(oid, &ibl) == 0) {
+      VOID_TEMP_FAILURE_RETRY(::close(fd));
+      if (len == 0)
+	len = ibl.length();
+      if (offset < ibl.length())
+	pbl->substr_of(ibl, offset, MIN(len, ibl.length() - offset));
+      onfinish->complete(pbl->length());
+      return 0;
+    }
+  }
+  if (len == 0)
+    len = st.st_size;
+  if (len == 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    onfinish->complete(0);
+    return 0;
+  }
+
+  // O_DIRECT wants page-aligned offset, length and buffer; read the
+  // covering aligned range and trim on completion.
+  AioReadState *o = new AioReadState;
+  o->fs = this;
+  o->pbl = pbl;
+  o->onfinish = onfinish;
+  o->offset = offset;
+  o->len = len;
+  o->fd = fd;
+  o->allow_eio = allow_eio;
+  o->aligned_off = offset & ~(uint64_t)(CEPH_PAGE_SIZE - 1);
+  uint64_t aligned_len =
+    ROUND_UP_TO(offset + len, CEPH_PAGE_SIZE) - o->aligned_off;
+  o->bptr = buffer::create_page_aligned(aligned_len);
+  io_prep_pread(&o->cb, fd, o->bptr.c_str(), aligned_len, o->aligned_off);
+  o->cb.data = o;
+
+  Mutex::Locker l(read_aio_lock);
+  struct iocb *piocb = &o->cb;
+  do {
+    r = io_submit(read_aio_ctx, 1, &piocb);
+  } while (r == -EAGAIN);
+  if (r < 0) {
+    derr << "FileStore::aio_read io_submit got " << cpp_strerror(r) << dendl;
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    delete o;
+    onfinish->complete(r);
+    return 0;
+  }
+  ++read_aio_num;
+  return 0;
+#else
+  return ObjectStore::aio_read(cid, oid, offset, len, pbl, onfinish,
+			       allow_eio);
+#endif
+}
+
+#ifdef HAVE_LIBAIO
+void FileStore::read_aio_entry()
+{
+  dout(10) << "read_aio_entry start" << dendl;
+  while (1) {
+    {
+      Mutex::Locker l(read_aio_lock);
+      if (read_aio_stop && read_aio_num == 0)
+	break;
+    }
+
+    io_event events[16];
+    struct timespec t;
+    t.tv_sec = 0;
+    t.tv_nsec = 100000000ull;  // 100ms; bounds our shutdown latency
+    int r = io_getevents(read_aio_ctx, 1, 16, events, &t);
+    if (r < 0) {
+      if (r == -EINTR)
+	continue;
+      derr << "io_getevents got " << cpp_strerror(r) << dendl;
+      assert(0 == "got unexpected error from io_getevents");
+    }
+
+    for (int i = 0; i < r; ++i) {
+      AioReadState *o = static_cast<AioReadState*>(events[i].data);
+      long res = events[i].res;
+      int result;
+      if (res < 0) {
+	dout(10) << "read_aio_entry aio error: " << cpp_strerror(res) << dendl;
+	result = res;
+	assert(o->allow_eio || !m_filestore_fail_eio || result != -EIO);
+      } else if (o->aligned_off + (uint64_t)res <= o->offset) {
+	// read started past eof
+	result = 0;
+      } else {
+	// trim the covering aligned read down to the requested range
+	result = MIN(o->len, o->aligned_off + res - o->offset);
+	bufferlist aligned;
+	aligned.push_back(o->bptr);
+	o->pbl->substr_of(aligned, o->offset - o->aligned_off, result);
+      }
+      VOID_TEMP_FAILURE_RETRY(::close(o->fd));
+      read_finisher.queue(o->onfinish, result);
+      delete o;
+
+      Mutex::Locker l(read_aio_lock);
+      --read_aio_num;
+    }
+  }
+  dout(10) << "read_aio_entry finish" << dendl;
+}
+#endif
+
 int FileStore::fiemap(coll_t cid, const ghobject_t& oid,
                     uint64_t offset, size_t len,
                     bufferlist& bl)
@@ -2701,6 +3233,18 @@ int FileStore::fiemap(coll_t cid, const ghobject_t& oid,
   } else {
     uint64_t i;
 
+    struct stat st;
+    if (::fstat(**fd, &st) == 0 && st.st_size == 0) {
+      // zero-length file; if the data lives inline in the omap db,
+      // report the live bytes as a single extent
+      bufferlist ibl;
+      if (_inline_get(oid, &ibl) == 0) {
+	if (offset < ibl.length())
+	  exomap[offset] = MIN(len, ibl.length() - offset);
+	goto done;
+      }
+    }
+
     r = backend->do_fiemap(**fd, offset, len, &fiemap);
     if (r < 0)
       goto done;
@@ -2756,6 +3300,27 @@ done:
   return r;
 }
 
+int FileStore::get_checksum_map(coll_t cid, const ghobject_t& oid,
+				SloppyCRCMap *out)
+{
+  dout(15) << "get_checksum_map " << cid << "/" << oid << dendl;
+
+  if (!m_filestore_sloppy_crc)
+    return -EOPNOTSUPP;
+
+  FDRef fd;
+  int r = lfn_open(cid, oid, false, &fd);
+  if (r < 0) {
+    dout(10) << "FileStore::get_checksum_map(" << cid << "/" << oid
+	     << ") open error: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  r = backend->_crc_get(**fd, out);
+  lfn_close(fd);
+  dout(10) << "get_checksum_map " << cid << "/" << oid << " = " << r << dendl;
+  return r;
+}
+
 
 int FileStore::_remove(coll_t cid, const ghobject_t& oid,
 		       const SequencerPosition &spos) 
@@ -2769,7 +3334,10 @@ int FileStore::_remove(coll_t cid, const ghobject_t& oid,
 int FileStore::_truncate(coll_t cid, const ghobject_t& oid, uint64_t size)
 {
   dout(15) << "truncate " << cid << "/" << oid << " size " << size << dendl;
-  int r = lfn_truncate(cid, oid, size);
+  // inline data has no backing bytes to truncate; push it out first
+  int r = _inline_materialize(cid, oid);
+  if (r == 0)
+    r = lfn_truncate(cid, oid, size);
   dout(10) << "truncate " << cid << "/" << oid << " size " << size << " = " << r << dendl;
   return r;
 }
@@ -2786,6 +3354,8 @@ int FileStore::_touch(coll_t cid, const ghobject_t& oid)
   } else {
     lfn_close(fd);
   }
+  if (r == 0)
+    r = _cindex_add(cid, oid);
   dout(10) << "touch " << cid << "/" << oid << " = " << r << dendl;
   return r;
 }
@@ -2807,7 +3377,23 @@ int FileStore::_write(coll_t cid, const ghobject_t& oid,
 	    << cpp_strerror(r) << dendl;
     goto out;
   }
-    
+
+  r = _cindex_add(cid, oid);
+  if (r < 0) {
+    lfn_close(fd);
+    goto out;
+  }
+
+  // small writes may be absorbed into the omap db; this also pushes any
+  // previously inline data out to the file if this write outgrows it
+  r = _inline_write(oid, offset, len, bl, fd);
+  if (r != 0) {
+    if (r > 0)
+      r = len;
+    lfn_close(fd);
+    goto out;
+  }
+
   // seek
   actual = ::lseek64(**fd, offset, SEEK_SET);
   if (actual < 0) {
@@ -2847,7 +3433,11 @@ int FileStore::_write(coll_t cid, const ghobject_t& oid,
 int FileStore::_zero(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len)
 {
   dout(15) << "zero " << cid << "/" << oid << " " << offset << "~" << len << dendl;
-  int ret = 0;
+  // zeroing works on file extents; push any inline data out first
+  int ret = _inline_materialize(cid, oid);
+  if (ret < 0)
+    return ret;
+  ret = 0;
 
 #ifdef CEPH_HAVE_FALLOCATE
 # if !defined(DARWIN) && !defined(__FreeBSD__)
@@ -2933,6 +3523,22 @@ int FileStore::_clone(coll_t cid, const ghobject_t& oldoid, const ghobject_t& ne
     r = object_map->clone(oldoid, newoid, &spos);
     if (r < 0 && r != -ENOENT)
       goto out3;
+
+    // inline data is keyed by object, like omap; carry it across too
+    {
+      bufferlist ibl;
+      r = _inline_get(oldoid, &ibl);
+      if (r == 0)
+	r = _inline_set(newoid, ibl);
+      else if (r == -ENOENT)
+	r = _inline_rm(newoid);  // clear stale data from a previous incarnation
+      if (r < 0)
+	goto out3;
+    }
+
+    r = _cindex_add(cid, newoid);
+    if (r < 0)
+      goto out3;
   }
 
   {
@@ -3165,6 +3771,15 @@ int FileStore::_clone_range(coll_t cid, const ghobject_t& oldoid, const ghobject
 
   int r;
   FDRef o, n;
+
+  // clone_range copies file bytes; push any inline data out first
+  r = _inline_materialize(cid, oldoid);
+  if (r < 0)
+    goto out2;
+  r = _inline_materialize(cid, newoid);
+  if (r < 0)
+    goto out2;
+
   r = lfn_open(cid, oldoid, false, &o);
   if (r < 0) {
     goto out2;
@@ -3173,6 +3788,11 @@ int FileStore::_clone_range(coll_t cid, const ghobject_t& oldoid, const ghobject
   if (r < 0) {
     goto out;
   }
+  r = _cindex_add(cid, newoid);
+  if (r < 0) {
+    lfn_close(n);
+    goto out;
+  }
   r = _do_clone_range(**o, **n, srcoff, len, dstoff);
 
   // clone is non-idempotent; record our work.
@@ -3519,57 +4139,28 @@ int FileStore::_fgetattr(int fd, const char *name, bufferptr& bp)
 
 int FileStore::_fgetattrs(int fd, map<string,bufferptr>& aset, bool user_only)
 {
-  // get attr list
-  char names1[100];
-  int len = chain_flistxattr(fd, names1, sizeof(names1)-1);
-  char *names2 = 0;
-  char *name = 0;
-  if (len == -ERANGE) {
-    len = chain_flistxattr(fd, 0, 0);
-    if (len < 0) {
-      assert(!m_filestore_fail_eio || len != -EIO);
-      return len;
-    }
-    dout(10) << " -ERANGE, len is " << len << dendl;
-    names2 = new char[len+1];
-    len = chain_flistxattr(fd, names2, len);
-    dout(10) << " -ERANGE, got " << len << dendl;
-    if (len < 0) {
-      assert(!m_filestore_fail_eio || len != -EIO);
-      return len;
+  // one listing plus one read per chunk
+  map<string, bufferptr> raw_aset;
+  int r = chain_fgetxattrs(fd, "user.ceph.", raw_aset);
+  if (r < 0) {
+    assert(!m_filestore_fail_eio || r != -EIO);
+    return r;
+  }
+  for (map<string, bufferptr>::iterator p = raw_aset.begin();
+       p != raw_aset.end();
+       ++p) {
+    const char *set_name = p->first.c_str() + sizeof("user.ceph.") - 1;
+    if (user_only) {
+      if (*set_name == '_')
+	set_name++;
+      else
+	continue;
     }
-    name = names2;
-  } else if (len < 0) {
-    assert(!m_filestore_fail_eio || len != -EIO);
-    return len;
-  } else {
-    name = names1;
-  }
-  name[len] = 0;
-
-  char *end = name + len;
-  while (name < end) {
-    char *attrname = name;
-    if (parse_attrname(&name)) {
-      char *set_name = name;
-      bool can_get = true;
-      if (user_only) {
-	if (*set_name =='_')
-	  set_name++;
-	else
-	  can_get = false;
-      }
-      if (*set_name && can_get) {
-        dout(20) << "fgetattrs " << fd << " getting '" << name << "'" << dendl;
-        int r = _fgetattr(fd, attrname, aset[set_name]);
-        if (r < 0)
-	  return r;
-      }
+    if (*set_name) {
+      dout(20) << "fgetattrs " << fd << " got '" << set_name << "'" << dendl;
+      aset[set_name] = p->second;
     }
-    name += strlen(name) + 1;
   }
-
-  delete[] names2;
   return 0;
 }
 
@@ -4174,6 +4765,7 @@ int FileStore::_collection_rename(const coll_t &cid, const coll_t &ncid,
     assert(fd >= 0);
     _set_replay_guard(fd, spos);
     VOID_TEMP_FAILURE_RETRY(::close(fd));
+    ret = _cindex_move_coll(cid, ncid);
   }
 
   dout(10) << "collection_rename '" << cid << "' to '" << ncid << "'"
@@ -4280,6 +4872,11 @@ bool FileStore::collection_exists(coll_t c)
 bool FileStore::collection_empty(coll_t c) 
 {  
   dout(15) << "collection_empty " << c << dendl;
+  if (_coll_indexed(c)) {
+    vector<ghobject_t> ls;
+    int r = _cindex_list(c, ghobject_t(), 1, &ls, NULL);
+    return r == 0 && ls.empty();
+  }
   Index index;
   int r = get_index(c, &index);
   if (r < 0)
@@ -4333,6 +4930,12 @@ int FileStore::collection_list_partial(coll_t c, ghobject_t start,
 				       vector<ghobject_t> *ls, ghobject_t *next)
 {
   dout(10) << "collection_list_partial: " << c << dendl;
+  if (_coll_indexed(c)) {
+    int r = _cindex_list(c, start, max, ls, next);
+    if (r == 0 && ls)
+      dout(20) << "objects: " << *ls << dendl;
+    return r;
+  }
   Index index;
   int r = get_index(c, &index);
   if (r < 0)
@@ -4350,7 +4953,9 @@ int FileStore::collection_list_partial(coll_t c, ghobject_t start,
 }
 
 int FileStore::collection_list(coll_t c, vector<ghobject_t>& ls)
-{  
+{
+  if (_coll_indexed(c))
+    return _cindex_list(c, ghobject_t(), 0, &ls, NULL);
   Index index;
   int r = get_index(c, &index);
   if (r < 0)
@@ -4456,6 +5061,18 @@ ObjectMap::ObjectMapIterator FileStore::get_omap_iterator(coll_t c,
   return object_map->get_iterator(hoid);
 }
 
+ObjectMap::ObjectMapIterator FileStore::get_omap_snapshot_iterator(
+  coll_t c,
+  const ghobject_t &hoid)
+{
+  dout(15) << __func__ << " " << c << "/" << hoid << dendl;
+  IndexedPath path;
+  int r = lfn_find(c, hoid, &path);
+  if (r < 0)
+    return ObjectMap::ObjectMapIterator();
+  return object_map->get_snapshot_iterator(hoid);
+}
+
 int FileStore::_create_collection(
   coll_t c,
   const SequencerPosition &spos)
@@ -4473,6 +5090,9 @@ int FileStore::_create_collection(
   if (r < 0)
     return r;
   r = init_index(c);
+  if (r < 0)
+    return r;
+  r = _cindex_create(c);
   if (r < 0)
     return r;
   _set_replay_guard(c, spos);
@@ -4492,7 +5112,10 @@ int FileStore::_create_collection(coll_t c)
 
   if (r < 0)
     return r;
-  return init_index(c);
+  r = init_index(c);
+  if (r < 0)
+    return r;
+  return _cindex_create(c);
 }
 
 int FileStore::_destroy_collection(coll_t c) 
@@ -4512,6 +5135,8 @@ int FileStore::_destroy_collection(coll_t c)
   int r = ::rmdir(fn);
   if (r < 0)
     r = -errno;
+  if (r == 0)
+    r = _cindex_destroy(c);
   dout(10) << "_destroy_collection " << fn << " = " << r << dendl;
   return r;
 }
@@ -4561,6 +5186,9 @@ int FileStore::_collection_add(coll_t c, coll_t oldcid, const ghobject_t& o,
   }
   lfn_close(fd);
 
+  if (r == 0)
+    r = _cindex_add(c, o);
+
   dout(10) << "collection_add " << c << "/" << o << " from " << oldcid << "/" << o << " = " << r << dendl;
   return r;
 }
@@ -4622,6 +5250,19 @@ int FileStore::_collection_move_rename(coll_t oldcid, const ghobject_t& oldoid,
 	r = 0;
     }
 
+    if (r == 0) {
+      // ... and any inline data, which is keyed by name as well
+      bufferlist ibl;
+      int ir = _inline_get(oldoid, &ibl);
+      if (ir == 0)
+	r = _inline_set(o, ibl);
+      else if (ir != -ENOENT)
+	r = ir;
+    }
+
+    if (r == 0)
+      r = _cindex_add(c, o);
+
     _inject_failure();
 
     lfn_close(fd);
@@ -4779,6 +5420,9 @@ int FileStore::_split_collection(coll_t cid,
     if (!r)
       r = from->split(rem, bits, to);
 
+    if (!r)
+      r = _cindex_split(cid, bits, rem, dest);
+
     _close_replay_guard(cid, spos);
     _close_replay_guard(dest, spos);
   }
@@ -4910,6 +5554,8 @@ const char** FileStore::get_tracked_conf_keys() const
     "filestore_sloppy_crc",
     "filestore_sloppy_crc_block_size",
     "filestore_max_alloc_hint_size",
+    "filestore_inline_data_size",
+    "filestore_collection_index",
     NULL
   };
   return KEYS;
@@ -4940,6 +5586,8 @@ void FileStore::handle_conf_change(const struct md_config_t *conf,
       changed.count("filestore_sloppy_crc") ||
       changed.count("filestore_sloppy_crc_block_size") ||
       changed.count("filestore_max_alloc_hint_size") ||
+      changed.count("filestore_inline_data_size") ||
+      changed.count("filestore_collection_index") ||
       changed.count("filestore_replica_fadvise")) {
     Mutex::Locker l(lock);
     m_filestore_min_sync_interval = conf->filestore_min_sync_interval;
@@ -4954,6 +5602,8 @@ void FileStore::handle_conf_change(const struct md_config_t *conf,
     m_filestore_sloppy_crc = conf->filestore_sloppy_crc;
     m_filestore_sloppy_crc_block_size = conf->filestore_sloppy_crc_block_size;
     m_filestore_max_alloc_hint_size = conf->filestore_max_alloc_hint_size;
+    m_filestore_inline_data_size = conf->filestore_inline_data_size;
+    m_filestore_collection_index = conf->filestore_collection_index;
   }
   if (changed.count("filestore_commit_timeout")) {
     Mutex::Locker l(sync_entry_timeo_lock);
@@ -44,6 +44,10 @@ using namespace std;
 
 #include "include/uuid.h"
 
+#ifdef HAVE_LIBAIO
+# include <libaio.h>
+#endif
+
 
 // from include/linux/falloc.h:
 #ifndef FALLOC_FL_PUNCH_HOLE
@@ -65,6 +69,7 @@ static const __SWORD_TYPE ZFS_SUPER_MAGIC(0x2fc12fc1);
 
 
 class FileStoreBackend;
+class KeyValueDB;
 
 #define CEPH_FS_FEATURE_INCOMPAT_SHARDS CompatSet::Feature(1, "sharded objects")
 
@@ -140,7 +145,26 @@ private:
 
   // ObjectMap
   boost::scoped_ptr<ObjectMap> object_map;
-  
+
+  /// borrowed pointer to object_map's KeyValueDB; holds inline object
+  /// data under its own prefix (see _inline_*).  NULL when unmounted.
+  KeyValueDB *inline_db;
+
+  /// collections whose object index lives in the kv store; listing
+  /// those is a leveldb range scan instead of a readdir walk
+  Mutex coll_index_lock;
+  set<coll_t> indexed_colls;
+
+  bool _coll_indexed(coll_t cid);
+  int _cindex_add(coll_t cid, const ghobject_t& oid);
+  int _cindex_rm(coll_t cid, const ghobject_t& oid);
+  int _cindex_create(coll_t cid);
+  int _cindex_destroy(coll_t cid);
+  int _cindex_move_coll(coll_t cid, coll_t ncid);
+  int _cindex_split(coll_t cid, uint32_t bits, uint32_t rem, coll_t dest);
+  int _cindex_list(coll_t cid, ghobject_t start, int max,
+		   vector<ghobject_t> *ls, ghobject_t *next);
+
   Finisher ondisk_finisher;
 
   // helper fns
@@ -297,6 +321,38 @@ private:
     }
   } op_wq;
 
+#ifdef HAVE_LIBAIO
+  // -- async reads --
+  /// state for one in-flight aio read; freed when it completes
+  struct AioReadState {
+    FileStore *fs;
+    bufferptr bptr;      ///< page-aligned buffer covering the aligned range
+    bufferlist *pbl;     ///< caller's target bufferlist
+    Context *onfinish;
+    uint64_t offset;     ///< offset the caller asked for
+    size_t len;          ///< length the caller asked for
+    uint64_t aligned_off;
+    int fd;
+    bool allow_eio;
+    struct iocb cb;
+  };
+  Mutex read_aio_lock;
+  io_context_t read_aio_ctx;
+  int read_aio_num;      ///< in-flight reads, protected by read_aio_lock
+  bool read_aio_stop;
+  class ReadAioThread : public Thread {
+    FileStore *fs;
+  public:
+    ReadAioThread(FileStore *f) : fs(f) {}
+    void *entry() {
+      fs->read_aio_entry();
+      return 0;
+    }
+  } read_aio_thread;
+  void read_aio_entry();
+  Finisher read_finisher;
+#endif
+
   void _do_op(OpSequencer *o, ThreadPool::TPHandle &handle);
   void _finish_op(OpSequencer *o);
   Op *build_op(list<Transaction*>& tls,
@@ -325,6 +381,18 @@ public:
     IndexedPath *path = 0,
     Index *index = 0);
   void lfn_close(FDRef fd);
+
+  // Small object data can live entirely in the omap kv store, next to
+  // the DBObjectMap rows.  An object with inline data always has a
+  // zero-length backing file, so indexing, xattrs and replay guards
+  // work as usual; st_size == 0 is the cheap hint to check the db.
+  int _inline_get(const ghobject_t& oid, bufferlist *bl);
+  int _inline_set(const ghobject_t& oid, const bufferlist& bl);
+  int _inline_rm(const ghobject_t& oid);
+  int _inline_write(const ghobject_t& oid, uint64_t offset, size_t len,
+		    const bufferlist& bl, const FDRef& fd);
+  int _inline_materialize(coll_t cid, const ghobject_t& oid);
+
   int lfn_link(coll_t c, coll_t newcid, const ghobject_t& o, const ghobject_t& newoid) ;
   int lfn_unlink(coll_t cid, const ghobject_t& o, const SequencerPosition &spos,
 		 bool force_clear_omap=false);
@@ -343,6 +411,7 @@ public:
   int write_op_seq(int, uint64_t seq);
   int mount();
   int umount();
+  void register_caches(MemoryBudget *budget);
   int get_max_object_name_length();
   int mkfs();
   int mkjournal();
@@ -443,7 +512,16 @@ public:
     size_t len,
     bufferlist& bl,
     bool allow_eio = false);
+  int aio_read(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    bufferlist *pbl,
+    Context *onfinish,
+    bool allow_eio = false);
   int fiemap(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len, bufferlist& bl);
+  int get_checksum_map(coll_t cid, const ghobject_t& oid, SloppyCRCMap *out);
 
   int _touch(coll_t cid, const ghobject_t& oid);
   int _write(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len, const bufferlist& bl,
@@ -542,6 +620,8 @@ public:
   int omap_check_keys(coll_t c, const ghobject_t &oid, const set<string> &keys,
 		      set<string> *out);
   ObjectMap::ObjectMapIterator get_omap_iterator(coll_t c, const ghobject_t &oid);
+  ObjectMap::ObjectMapIterator get_omap_snapshot_iterator(coll_t c,
+							  const ghobject_t &oid);
 
   int _create_collection(coll_t c);
   int _create_collection(coll_t c, const SequencerPosition &spos);
@@ -594,6 +674,7 @@ private:
   double m_filestore_min_sync_interval;
   bool m_filestore_fail_eio;
   bool m_filestore_replica_fadvise;
+  bool m_filestore_aio_reads;
   int do_update;
   bool m_journal_dio, m_journal_aio, m_journal_force_aio;
   std::string m_osd_rollback_to_cluster_snap;
@@ -609,6 +690,8 @@ private:
   bool m_filestore_sloppy_crc;
   int m_filestore_sloppy_crc_block_size;
   uint64_t m_filestore_max_alloc_hint_size;
+  uint64_t m_filestore_inline_data_size;
+  bool m_filestore_collection_index;
   long m_fs_type;
 
   //Determined xattr handling based on fs type
@@ -706,6 +789,7 @@ public:
 				      loff_t srcoff, size_t len, loff_t dstoff) = 0;
   virtual int _crc_verify_read(int fd, loff_t off, size_t len, const bufferlist& bl,
 			       ostream *out) = 0;
+  virtual int _crc_get(int fd, SloppyCRCMap *out) = 0;
 };
 
 #endif
@@ -364,3 +364,9 @@ int GenericFileStoreBackend::_crc_verify_read(int fd, loff_t off, size_t len, co
     return r;
   return scm.read(off, len, bl, out);
 }
+
+int GenericFileStoreBackend::_crc_get(int fd, SloppyCRCMap *out)
+{
+  out->set_block_size(get_crc_block_size());
+  return _crc_load_or_init(fd, out);
+}
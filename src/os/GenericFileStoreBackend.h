@@ -58,5 +58,6 @@ public:
 				      loff_t srcoff, size_t len, loff_t dstoff);
   virtual int _crc_verify_read(int fd, loff_t off, size_t len, const bufferlist& bl,
 			       ostream *out);
+  virtual int _crc_get(int fd, SloppyCRCMap *out);
 };
 #endif
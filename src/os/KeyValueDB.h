@@ -12,6 +12,9 @@
 #include "ObjectMap.h"
 
 using std::string;
+
+class CephContext;
+
 /**
  * Defines virtual interface to be implemented by key value store
  *
@@ -19,6 +22,14 @@ using std::string;
  */
 class KeyValueDB {
 public:
+  /**
+   * Create an uninitialized KeyValueDB of the given type ("leveldb", ...)
+   * rooted at dir.  Returns NULL if the type is unknown.  The caller
+   * still needs to init() and open()/create_and_open() the result.
+   */
+  static KeyValueDB *create(CephContext *cct, const string &type,
+			    const string &dir);
+
   class TransactionImpl {
   public:
     /// Set Keys
@@ -45,6 +45,8 @@
 #include "common/debug.h"
 #include "common/errno.h"
 #include "common/run_cmd.h"
+#include "common/strtol.h"
+#include "include/str_list.h"
 #include "common/safe_io.h"
 #include "common/perf_counters.h"
 #include "common/sync_filesystem.h"
@@ -309,6 +311,11 @@ int KeyValueStore::BufferTransaction::lookup_cached_header(
   r = store->backend->lookup_strip_header(cid, oid, header);
   if (r < 0 && create_if_missing) {
     r = store->backend->create_strip_header(cid, oid, header, t);
+    if (r >= 0) {
+      // existing objects keep the strip size they were created with;
+      // new ones get the (possibly per-pool) configured size
+      header.strip_size = store->strip_size_for(cid);
+    }
   }
 
   if (r < 0) {
@@ -506,9 +513,17 @@ KeyValueStore::KeyValueStore(const std::string &base,
         g_conf->keyvaluestore_op_threads, "keyvaluestore_op_threads"),
   op_wq(this, g_conf->keyvaluestore_op_thread_timeout,
         g_conf->keyvaluestore_op_thread_suicide_timeout, &op_tp),
+  sync_lock("KeyValueStore::sync_lock"),
+  sync_stop(false),
+  sync_thread(this),
   perf_logger(NULL),
   m_keyvaluestore_queue_max_ops(g_conf->keyvaluestore_queue_max_ops),
   m_keyvaluestore_queue_max_bytes(g_conf->keyvaluestore_queue_max_bytes),
+  m_keyvaluestore_parallel_apply(g_conf->keyvaluestore_parallel_apply),
+  m_keyvaluestore_batch_sync(g_conf->keyvaluestore_batch_sync),
+  m_keyvaluestore_max_sync_interval(g_conf->keyvaluestore_max_sync_interval),
+  m_keyvaluestore_sync_max_ops(g_conf->keyvaluestore_sync_max_ops),
+  m_keyvaluestore_default_strip_size(g_conf->keyvaluestore_default_strip_size),
   do_update(do_update)
 {
   ostringstream oss;
@@ -519,6 +534,28 @@ KeyValueStore::KeyValueStore(const std::string &base,
   sss << basedir << "/current/commit_op_seq";
   current_op_seq_fn = sss.str();
 
+  // parse per-pool strip size overrides ("<pool>=<size>[,<pool>=<size>]")
+  list<string> overrides;
+  get_str_list(g_conf->keyvaluestore_pool_strip_size, overrides);
+  for (list<string>::iterator p = overrides.begin();
+       p != overrides.end();
+       ++p) {
+    size_t eq = p->find('=');
+    string err;
+    int64_t pool = -1, size = 0;
+    if (eq != string::npos) {
+      pool = strict_strtoll(p->substr(0, eq).c_str(), 10, &err);
+      if (err.empty())
+        size = strict_strtoll(p->substr(eq + 1).c_str(), 10, &err);
+    }
+    if (eq == string::npos || !err.empty() || pool < 0 || size <= 0) {
+      derr << "ignoring malformed keyvaluestore_pool_strip_size item '"
+           << *p << "'" << dendl;
+      continue;
+    }
+    m_pool_strip_size[pool] = size;
+  }
+
   // initialize perf_logger
   PerfCountersBuilder plb(g_ceph_context, internal_name, l_os_commit_lat, l_os_last);
 
@@ -530,6 +567,8 @@ KeyValueStore::KeyValueStore(const std::string &base,
   plb.add_u64_counter(l_os_bytes, "bytes");
   plb.add_time_avg(l_os_apply_lat, "apply_latency");
   plb.add_time_avg(l_os_queue_lat, "queue_transaction_latency_avg");
+  plb.add_u64_counter(l_os_kv_sync, "batch_syncs");
+  plb.add_time_avg(l_os_kv_sync_lat, "batch_sync_latency");
 
   perf_logger = plb.create_perf_counters();
 
@@ -636,10 +675,10 @@ int KeyValueStore::mkfs()
   }
 
   {
-    KeyValueDB *store;
-    if (kv_type == KV_TYPE_LEVELDB) {
-      store = new LevelDBStore(g_ceph_context, current_fn);
-    } else {
+    KeyValueDB *store = NULL;
+    if (kv_type == KV_TYPE_LEVELDB)
+      store = KeyValueDB::create(g_ceph_context, "leveldb", current_fn);
+    if (!store) {
       derr << "KeyValueStore::mkfs error: unknown backend type" << kv_type << dendl;
       ret = -1;
       goto close_fsid_fd;
@@ -836,10 +875,10 @@ int KeyValueStore::mount()
   }
 
   {
-    KeyValueDB *store;
-    if (kv_type == KV_TYPE_LEVELDB) {
-      store = new LevelDBStore(g_ceph_context, current_fn);
-    } else {
+    KeyValueDB *store = NULL;
+    if (kv_type == KV_TYPE_LEVELDB)
+      store = KeyValueDB::create(g_ceph_context, "leveldb", current_fn);
+    if (!store) {
       derr << "KeyValueStore::mount error: unknown backend type" << kv_type
            << dendl;
       ret = -1;
@@ -879,6 +918,11 @@ int KeyValueStore::mount()
   op_finisher.start();
   ondisk_finisher.start();
 
+  if (m_keyvaluestore_batch_sync) {
+    sync_stop = false;
+    sync_thread.create();
+  }
+
   // all okay.
   return 0;
 
@@ -897,6 +941,15 @@ int KeyValueStore::umount()
   dout(5) << "umount " << basedir << dendl;
 
   op_tp.stop();
+
+  if (sync_thread.is_started()) {
+    sync_lock.Lock();
+    sync_stop = true;
+    sync_cond.Signal();
+    sync_lock.Unlock();
+    sync_thread.join();
+  }
+
   op_finisher.stop();
   ondisk_finisher.stop();
 
@@ -996,9 +1049,153 @@ KeyValueStore::Op *KeyValueStore::build_op(list<Transaction*>& tls,
   o->ops = ops;
   o->bytes = bytes;
   o->osd_op = osd_op;
+  o->exclusive = !m_keyvaluestore_parallel_apply;
+  if (!o->exclusive)
+    collect_op_objects(o);
   return o;
 }
 
+// Walk the transactions and record which objects they touch, so ops on
+// disjoint objects may apply in parallel.  The decode sequence must
+// mirror _do_transaction exactly.  Anything operating on collection
+// state (or an op we don't recognize) marks the op exclusive, which
+// serializes it against the whole sequencer.
+void KeyValueStore::collect_op_objects(Op *o)
+{
+  for (list<Transaction*>::iterator p = o->tls.begin();
+       p != o->tls.end();
+       ++p) {
+    Transaction::iterator i = (*p)->begin();
+    while (i.have_op()) {
+      int op = i.decode_op();
+
+      switch (op) {
+      case Transaction::OP_NOP:
+      case Transaction::OP_STARTSYNC:
+        break;
+
+      case Transaction::OP_TOUCH:
+      case Transaction::OP_REMOVE:
+      case Transaction::OP_RMATTRS:
+      case Transaction::OP_OMAP_CLEAR:
+      case Transaction::OP_COLL_REMOVE:
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        break;
+
+      case Transaction::OP_WRITE:
+        {
+          i.decode_cid();
+          o->objects.insert(i.decode_oid());
+          i.decode_length();
+          i.decode_length();
+          i.get_replica();
+          bufferlist bl;
+          i.decode_bl(bl);
+        }
+        break;
+
+      case Transaction::OP_ZERO:
+      case Transaction::OP_TRIMCACHE:
+      case Transaction::OP_SETALLOCHINT:
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        i.decode_length();
+        i.decode_length();
+        break;
+
+      case Transaction::OP_TRUNCATE:
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        i.decode_length();
+        break;
+
+      case Transaction::OP_SETATTR:
+      case Transaction::OP_OMAP_SETHEADER:
+        {
+          i.decode_cid();
+          o->objects.insert(i.decode_oid());
+          if (op == Transaction::OP_SETATTR)
+            i.decode_attrname();
+          bufferlist bl;
+          i.decode_bl(bl);
+        }
+        break;
+
+      case Transaction::OP_SETATTRS:
+      case Transaction::OP_OMAP_SETKEYS:
+        {
+          i.decode_cid();
+          o->objects.insert(i.decode_oid());
+          map<string, bufferlist> aset;
+          i.decode_attrset(aset);
+        }
+        break;
+
+      case Transaction::OP_RMATTR:
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        i.decode_attrname();
+        break;
+
+      case Transaction::OP_CLONE:
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        o->objects.insert(i.decode_oid());
+        break;
+
+      case Transaction::OP_CLONERANGE:
+      case Transaction::OP_CLONERANGE2:
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        o->objects.insert(i.decode_oid());
+        i.decode_length();
+        i.decode_length();
+        if (op == Transaction::OP_CLONERANGE2)
+          i.decode_length();
+        break;
+
+      case Transaction::OP_COLL_ADD:
+      case Transaction::OP_COLL_MOVE:
+        i.decode_cid();
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        break;
+
+      case Transaction::OP_COLL_MOVE_RENAME:
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        break;
+
+      case Transaction::OP_OMAP_RMKEYS:
+        {
+          i.decode_cid();
+          o->objects.insert(i.decode_oid());
+          set<string> keys;
+          i.decode_keyset(keys);
+        }
+        break;
+
+      case Transaction::OP_OMAP_RMKEYRANGE:
+        i.decode_cid();
+        o->objects.insert(i.decode_oid());
+        i.decode_key();
+        i.decode_key();
+        break;
+
+      default:
+        // collection create/destroy/rename/split, attrs on the
+        // collection itself, or an op added after this function:
+        // play it safe
+        o->exclusive = true;
+        return;
+      }
+    }
+  }
+}
+
 void KeyValueStore::queue_op(OpSequencer *osr, Op *o)
 {
   // queue op on sequencer, then queue sequencer for the threadpool,
@@ -1065,10 +1262,18 @@ void KeyValueStore::op_queue_release_throttle(Op *o)
 
 void KeyValueStore::_do_op(OpSequencer *osr, ThreadPool::TPHandle &handle)
 {
-  // FIXME: Suppose the collection of transaction only affect objects in the
-  // one PG, so this lock will ensure no other concurrent write operation
+  // ops are dequeued in submission order, but may apply in parallel
+  // when they touch disjoint objects; a later op on the same object
+  // (or an exclusive one) waits here for the earlier ones to finish
   osr->apply_lock.Lock();
-  Op *o = osr->peek_queue();
+  Op *o = osr->dequeue_for_apply();
+  while (osr->must_wait(o)) {
+    handle.suspend_tp_timeout();
+    osr->apply_cond.Wait(osr->apply_lock);
+    handle.reset_tp_timeout();
+  }
+  osr->apply_lock.Unlock();
+
   dout(5) << "_do_op " << o << " seq " << o->op << " " << *osr << "/" << osr->parent << " start" << dendl;
   int r = _do_transactions(o->tls, o->op, &handle);
   dout(10) << "_do_op " << o << " seq " << o->op << " r = " << r
@@ -1078,18 +1283,23 @@ void KeyValueStore::_do_op(OpSequencer *osr, ThreadPool::TPHandle &handle)
     if (r < 0) {
       delete o->ondisk;
       o->ondisk = 0;
+    } else if (m_keyvaluestore_batch_sync) {
+      queue_sync_waiter(o->ondisk);
     } else {
       ondisk_finisher.queue(o->ondisk, r);
     }
   }
+
+  osr->apply_lock.Lock();
+  osr->finish_applying(o);
+  osr->apply_lock.Unlock();
 }
 
 void KeyValueStore::_finish_op(OpSequencer *osr)
 {
-  Op *o = osr->dequeue();
+  Op *o = osr->dequeue_finished();
 
   dout(10) << "_finish_op " << o << " seq " << o->op << " " << *osr << "/" << osr->parent << dendl;
-  osr->apply_lock.Unlock();  // locked in _do_op
   op_queue_release_throttle(o);
 
   utime_t lat = ceph_clock_now(g_ceph_context);
@@ -1103,6 +1313,72 @@ void KeyValueStore::_finish_op(OpSequencer *osr)
   delete o;
 }
 
+void KeyValueStore::sync_entry()
+{
+  dout(10) << "sync_entry start" << dendl;
+  sync_lock.Lock();
+  while (!sync_stop) {
+    utime_t interval;
+    interval.set_from_double(m_keyvaluestore_max_sync_interval);
+    sync_cond.WaitInterval(g_ceph_context, sync_lock, interval);
+    _flush_sync_waiters();
+  }
+  // catch waiters queued after the last pass
+  _flush_sync_waiters();
+  sync_lock.Unlock();
+  dout(10) << "sync_entry stop" << dendl;
+}
+
+// group all accumulated ondisk waiters behind one durable backend
+// sync; called with sync_lock held, drops it for the sync itself
+void KeyValueStore::_flush_sync_waiters()
+{
+  assert(sync_lock.is_locked());
+  while (!sync_waiters.empty()) {
+    list<Context*> ls;
+    ls.swap(sync_waiters);
+    sync_lock.Unlock();
+
+    utime_t start = ceph_clock_now(g_ceph_context);
+    int r = backend->submit_transaction_sync(backend->get_transaction());
+    utime_t lat = ceph_clock_now(g_ceph_context) - start;
+    if (r < 0)
+      derr << __func__ << " backend sync got " << cpp_strerror(r) << dendl;
+    perf_logger->inc(l_os_kv_sync);
+    perf_logger->tinc(l_os_kv_sync_lat, lat);
+    dout(20) << __func__ << " " << ls.size() << " ondisk completions after "
+             << "one sync (" << lat << "s)" << dendl;
+    for (list<Context*>::iterator p = ls.begin(); p != ls.end(); ++p)
+      ondisk_finisher.queue(*p, r);
+
+    sync_lock.Lock();
+  }
+}
+
+void KeyValueStore::queue_sync_waiter(Context *c)
+{
+  Mutex::Locker l(sync_lock);
+  sync_waiters.push_back(c);
+  if (m_keyvaluestore_sync_max_ops &&
+      (int)sync_waiters.size() >= m_keyvaluestore_sync_max_ops)
+    sync_cond.Signal();
+}
+
+uint64_t KeyValueStore::strip_size_for(const coll_t &cid)
+{
+  if (!m_pool_strip_size.empty()) {
+    spg_t pgid;
+    snapid_t snap;
+    if (cid.is_pg(pgid, snap)) {
+      map<int64_t, uint64_t>::iterator p =
+        m_pool_strip_size.find(pgid.pgid.pool());
+      if (p != m_pool_strip_size.end())
+        return p->second;
+    }
+  }
+  return m_keyvaluestore_default_strip_size;
+}
+
 // Combine all the ops in the same transaction using "BufferTransaction" and
 // cache the middle results in order to make visible to the following ops.
 //
@@ -2976,6 +3252,8 @@ const char** KeyValueStore::get_tracked_conf_keys() const
   static const char* KEYS[] = {
     "keyvaluestore_queue_max_ops",
     "keyvaluestore_queue_max_bytes",
+    "keyvaluestore_max_sync_interval",
+    "keyvaluestore_sync_max_ops",
     NULL
   };
   return KEYS;
@@ -2989,6 +3267,14 @@ void KeyValueStore::handle_conf_change(const struct md_config_t *conf,
     m_keyvaluestore_queue_max_ops = conf->keyvaluestore_queue_max_ops;
     m_keyvaluestore_queue_max_bytes = conf->keyvaluestore_queue_max_bytes;
   }
+  // batch_sync itself (and the apply/stripe settings) only take effect
+  // at mount time, but the sync pacing can be tuned on the fly
+  if (changed.count("keyvaluestore_max_sync_interval") ||
+      changed.count("keyvaluestore_sync_max_ops")) {
+    Mutex::Locker l(sync_lock);
+    m_keyvaluestore_max_sync_interval = conf->keyvaluestore_max_sync_interval;
+    m_keyvaluestore_sync_max_ops = conf->keyvaluestore_sync_max_ops;
+  }
 }
 
 void KeyValueStore::dump_transactions(list<ObjectStore::Transaction*>& ls, uint64_t seq, OpSequencer *osr)
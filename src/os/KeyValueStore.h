@@ -253,30 +253,67 @@ class KeyValueStore : public ObjectStore,
     Context *ondisk, *onreadable, *onreadable_sync;
     uint64_t ops, bytes;
     TrackedOpRef osd_op;
+    set<ghobject_t> objects;  // objects the transactions touch
+    bool exclusive;  // touches collection state; serialize with everything
   };
   class OpSequencer : public Sequencer_impl {
     Mutex qlock; // to protect q, for benefit of flush (peek/dequeue also protected by lock)
     list<Op*> q;
+    list<Op*> applying;  // dequeued and being applied, in dequeue order
+    list<Op*> finishing; // applied, awaiting _finish_op
     list<uint64_t> jq;
     Cond cond;
    public:
     Sequencer *parent;
-    Mutex apply_lock;  // for apply mutual exclusion
+    Mutex apply_lock;  // protects the applying list and apply_cond
+    Cond apply_cond;
 
     void queue(Op *o) {
       Mutex::Locker l(qlock);
       q.push_back(o);
     }
-    Op *peek_queue() {
-      assert(apply_lock.is_locked());
-      return q.front();
-    }
-    Op *dequeue() {
+    Op *dequeue_for_apply() {
       assert(apply_lock.is_locked());
       Mutex::Locker l(qlock);
       Op *o = q.front();
       q.pop_front();
-      cond.Signal();
+      applying.push_back(o);
+      return o;
+    }
+    // must o (already on the applying list) wait for an earlier
+    // in-flight op touching one of its objects?
+    bool must_wait(Op *o) {
+      assert(apply_lock.is_locked());
+      Mutex::Locker l(qlock);
+      for (list<Op*>::iterator p = applying.begin();
+           p != applying.end() && *p != o;
+           ++p) {
+        if ((*p)->exclusive || o->exclusive)
+          return true;
+        for (set<ghobject_t>::iterator i = o->objects.begin();
+             i != o->objects.end();
+             ++i) {
+          if ((*p)->objects.count(*i))
+            return true;
+        }
+      }
+      return false;
+    }
+    void finish_applying(Op *o) {
+      assert(apply_lock.is_locked());
+      {
+        Mutex::Locker l(qlock);
+        applying.remove(o);
+        finishing.push_back(o);
+        cond.Signal();
+      }
+      apply_cond.SignalAll();
+    }
+    Op *dequeue_finished() {
+      Mutex::Locker l(qlock);
+      assert(!finishing.empty());
+      Op *o = finishing.front();
+      finishing.pop_front();
       return o;
     }
     void flush() {
@@ -284,6 +321,8 @@ class KeyValueStore : public ObjectStore,
 
       // get max for journal _or_ op queues
       uint64_t seq = 0;
+      if (!applying.empty())
+        seq = applying.back()->op;
       if (!q.empty())
         seq = q.back()->op;
       if (!jq.empty() && jq.back() > seq)
@@ -293,6 +332,7 @@ class KeyValueStore : public ObjectStore,
         // everything prior to our watermark to drain through either/both
         // queues
         while ((!q.empty() && q.front()->op <= seq) ||
+                (!applying.empty() && applying.front()->op <= seq) ||
                 (!jq.empty() && jq.front() <= seq))
           cond.Wait(qlock);
       }
@@ -304,6 +344,8 @@ class KeyValueStore : public ObjectStore,
 	apply_lock("KeyValueStore::OpSequencer::apply_lock", false, false) {}
     ~OpSequencer() {
       assert(q.empty());
+      assert(applying.empty());
+      assert(finishing.empty());
     }
 
     const string& get_name() const {
@@ -359,12 +401,33 @@ class KeyValueStore : public ObjectStore,
 
   Op *build_op(list<Transaction*>& tls, Context *ondisk, Context *onreadable,
                Context *onreadable_sync, TrackedOpRef osd_op);
+  void collect_op_objects(Op *o);
   void queue_op(OpSequencer *osr, Op *o);
   void op_queue_reserve_throttle(Op *o, ThreadPool::TPHandle *handle = NULL);
   void _do_op(OpSequencer *osr, ThreadPool::TPHandle &handle);
   void op_queue_release_throttle(Op *o);
   void _finish_op(OpSequencer *osr);
 
+  // -- batched sync --
+  // in batch sync mode ondisk completions are withheld until the sync
+  // thread groups the preceding transactions into one durable backend
+  // sync, amortizing the sync cost over many small transactions
+  Mutex sync_lock;
+  Cond sync_cond;
+  list<Context*> sync_waiters;
+  bool sync_stop;
+  struct SyncThread : public Thread {
+    KeyValueStore *kvs;
+    SyncThread(KeyValueStore *k) : kvs(k) {}
+    void *entry() {
+      kvs->sync_entry();
+      return 0;
+    }
+  } sync_thread;
+  void sync_entry();
+  void _flush_sync_waiters();
+  void queue_sync_waiter(Context *c);
+
   PerfCounters *perf_logger;
 
  public:
@@ -560,6 +623,14 @@ class KeyValueStore : public ObjectStore,
   std::string m_osd_rollback_to_cluster_snap;
   int m_keyvaluestore_queue_max_ops;
   int m_keyvaluestore_queue_max_bytes;
+  bool m_keyvaluestore_parallel_apply;
+  bool m_keyvaluestore_batch_sync;
+  double m_keyvaluestore_max_sync_interval;
+  int m_keyvaluestore_sync_max_ops;
+  uint64_t m_keyvaluestore_default_strip_size;
+  map<int64_t, uint64_t> m_pool_strip_size;
+
+  uint64_t strip_size_for(const coll_t &cid);
 
   int do_update;
 
@@ -29,12 +29,40 @@
 #include "common/debug.h"
 #include "include/buffer.h"
 #include "common/ceph_crypto.h"
+#include "common/perf_counters.h"
+#include "global/global_context.h"
 #include "include/compat.h"
 #include "chain_xattr.h"
 
 #include "LFNIndex.h"
 using ceph::crypto::SHA1;
 
+enum {
+  l_lfn_first = 999290,
+  l_lfn_path_cache_hit,
+  l_lfn_path_cache_miss,
+  l_lfn_last,
+};
+
+// hit rates are aggregated over all collection indexes in the
+// process; a PerfCounters instance per collection would flood the
+// admin socket.  Built lazily on first index init, lives for the
+// process.
+static PerfCounters *lfn_logger = NULL;
+static Mutex lfn_logger_lock("LFNIndex::lfn_logger_lock");
+
+static void build_lfn_logger()
+{
+  Mutex::Locker l(lfn_logger_lock);
+  if (lfn_logger || !g_ceph_context)
+    return;
+  PerfCountersBuilder b(g_ceph_context, "lfnindex", l_lfn_first, l_lfn_last);
+  b.add_u64_counter(l_lfn_path_cache_hit, "index_path_cache_hit");
+  b.add_u64_counter(l_lfn_path_cache_miss, "index_path_cache_miss");
+  lfn_logger = b.create_perf_counters();
+  g_ceph_context->get_perfcounters_collection()->add(lfn_logger);
+}
+
 #define dout_subsys ceph_subsys_filestore
 #undef dout_prefix
 #define dout_prefix *_dout << "LFNIndex(" << get_base_path() << ") "
@@ -70,6 +98,7 @@ void LFNIndex::set_ref(ceph::shared_ptr<CollectionIndex> ref)
 
 int LFNIndex::init()
 {
+  build_lfn_logger();
   return _init();
 }
 
@@ -472,6 +501,12 @@ int LFNIndex::list_subdirs(const vector<string> &to_list,
 
 int LFNIndex::create_path(const vector<string> &to_create)
 {
+  // invalidate before touching disk; injected failures can unwind us
+  // after the mkdir took effect
+  {
+    Mutex::Locker l(path_cache_lock);
+    path_cache.erase(get_full_path_subdir(to_create));
+  }
   maybe_inject_failure();
   int r = ::mkdir(get_full_path_subdir(to_create).c_str(), 0777);
   maybe_inject_failure();
@@ -483,6 +518,10 @@ int LFNIndex::create_path(const vector<string> &to_create)
 
 int LFNIndex::remove_path(const vector<string> &to_remove)
 {
+  {
+    Mutex::Locker l(path_cache_lock);
+    path_cache.erase(get_full_path_subdir(to_remove));
+  }
   maybe_inject_failure();
   int r = ::rmdir(get_full_path_subdir(to_remove).c_str());
   maybe_inject_failure();
@@ -495,19 +534,35 @@ int LFNIndex::remove_path(const vector<string> &to_remove)
 int LFNIndex::path_exists(const vector<string> &to_check, int *exists)
 {
   string full_path = get_full_path_subdir(to_check);
+
+  {
+    Mutex::Locker l(path_cache_lock);
+    map<string, bool>::iterator p = path_cache.find(full_path);
+    if (p != path_cache.end()) {
+      if (lfn_logger)
+	lfn_logger->inc(l_lfn_path_cache_hit);
+      *exists = p->second ? 1 : 0;
+      return 0;
+    }
+  }
+  if (lfn_logger)
+    lfn_logger->inc(l_lfn_path_cache_miss);
+
   struct stat buf;
   if (::stat(full_path.c_str(), &buf)) {
     int r = -errno;
     if (r == -ENOENT) {
       *exists = 0;
-      return 0;
     } else {
       return r;
     }
   } else {
     *exists = 1;
-    return 0;
   }
+
+  Mutex::Locker l(path_cache_lock);
+  path_cache[full_path] = (*exists == 1);
+  return 0;
 }
 
 int LFNIndex::add_attr_path(const vector<string> &path,
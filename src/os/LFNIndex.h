@@ -26,6 +26,7 @@
 #include "osd/osd_types.h"
 #include "include/object.h"
 #include "common/ceph_crypto.h"
+#include "common/Mutex.h"
 
 #include "CollectionIndex.h"
 
@@ -126,6 +127,16 @@ private:
   string lfn_attribute;
   coll_t collection;
 
+  /**
+   * Cached existence of hashed subdirectories.  The on-disk fan-out
+   * only changes through create_path/remove_path (split/merge), which
+   * invalidate the affected entry, so the common-case lookup walk is
+   * answered from memory.  Size is bounded by the collection's subdir
+   * count.
+   */
+  Mutex path_cache_lock;
+  std::map<string, bool> path_cache;
+
 public:
   /// Constructor
   LFNIndex(
@@ -139,7 +150,8 @@ public:
       error_injection_on(_error_injection_probability != 0),
       error_injection_probability(_error_injection_probability),
       last_failure(0), current_failure(0),
-      collection(collection) {
+      collection(collection),
+      path_cache_lock("LFNIndex::path_cache_lock") {
     if (index_version == HASH_INDEX_TAG) {
       lfn_attribute = LFN_ATTR;
     } else {
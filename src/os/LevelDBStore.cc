@@ -8,7 +8,43 @@
 #include "include/memory.h"
 #include <errno.h>
 using std::string;
+#include "common/Clock.h"
 #include "common/perf_counters.h"
+#include "common/admin_socket.h"
+
+// One block cache shared by every LevelDBStore in the process that asks
+// for it (options.cache_shared).  It is sized by the first store that
+// creates it and intentionally never freed; it has process lifetime.
+static Mutex leveldb_shared_cache_lock("LevelDBStore::shared_cache_lock");
+static leveldb::Cache *leveldb_shared_cache = NULL;
+
+static leveldb::Cache *get_shared_cache(uint64_t size)
+{
+  Mutex::Locker l(leveldb_shared_cache_lock);
+  if (!leveldb_shared_cache)
+    leveldb_shared_cache = leveldb::NewLRUCache(size);
+  return leveldb_shared_cache;
+}
+
+// let operators kick off a background compaction of one prefix (e.g.
+// schedule omap compaction during quiet hours) without restarting
+class LevelDBStoreAsokHook : public AdminSocketHook {
+  LevelDBStore *store;
+public:
+  LevelDBStoreAsokHook(LevelDBStore *s) : store(s) {}
+  bool call(std::string command, cmdmap_t &cmdmap, std::string format,
+	    bufferlist& out) {
+    string prefix;
+    cmd_getval(g_ceph_context, cmdmap, "prefix_arg", prefix);
+    if (prefix.empty()) {
+      out.append("missing prefix argument\n");
+      return true;
+    }
+    store->compact_prefix_async(prefix);
+    out.append("queued compaction of prefix " + prefix + "\n");
+    return true;
+  }
+};
 
 int LevelDBStore::init()
 {
@@ -16,10 +52,12 @@ int LevelDBStore::init()
   // prior to calling open.
   options.write_buffer_size = g_conf->leveldb_write_buffer_size;
   options.cache_size = g_conf->leveldb_cache_size;
+  options.cache_shared = g_conf->leveldb_cache_shared;
   options.block_size = g_conf->leveldb_block_size;
   options.bloom_size = g_conf->leveldb_bloom_size;
   options.compression_enabled = g_conf->leveldb_compression;
   options.paranoid_checks = g_conf->leveldb_paranoid;
+  options.compact_pause = g_conf->leveldb_compact_pause;
   options.max_open_files = g_conf->leveldb_max_open_files;
   options.log_file = g_conf->leveldb_log;
   return 0;
@@ -34,9 +72,13 @@ int LevelDBStore::do_open(ostream &out, bool create_if_missing)
   if (options.max_open_files)
     ldoptions.max_open_files = options.max_open_files;
   if (options.cache_size) {
-    leveldb::Cache *_db_cache = leveldb::NewLRUCache(options.cache_size);
-    db_cache.reset(_db_cache);
-    ldoptions.block_cache = db_cache.get();
+    if (options.cache_shared) {
+      ldoptions.block_cache = get_shared_cache(options.cache_size);
+    } else {
+      leveldb::Cache *_db_cache = leveldb::NewLRUCache(options.cache_size);
+      db_cache.reset(_db_cache);
+      ldoptions.block_cache = db_cache.get();
+    }
   }
   if (options.block_size)
     ldoptions.block_size = options.block_size;
@@ -87,8 +129,23 @@ int LevelDBStore::do_open(ostream &out, bool create_if_missing)
   plb.add_u64_counter(l_leveldb_compact_range, "leveldb_compact_range");
   plb.add_u64_counter(l_leveldb_compact_queue_merge, "leveldb_compact_queue_merge");
   plb.add_u64(l_leveldb_compact_queue_len, "leveldb_compact_queue_len");
+  plb.add_time_avg(l_leveldb_submit_latency, "leveldb_submit_latency");
+  plb.add_time_avg(l_leveldb_compact_latency, "leveldb_compact_latency");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
+
+  // only one store per daemon can own the command; a second open (or a
+  // second store instance) just goes without
+  AdminSocketHook *hook = new LevelDBStoreAsokHook(this);
+  int r = cct->get_admin_socket()->register_command(
+    "leveldb_compact_prefix",
+    "leveldb_compact_prefix name=prefix_arg,type=CephString",
+    hook,
+    "queue async compaction of all keys with a given prefix");
+  if (r == 0)
+    asok_hook = hook;
+  else
+    delete hook;
   return 0;
 }
 
@@ -116,14 +173,24 @@ void LevelDBStore::close()
 
   if (logger)
     cct->get_perfcounters_collection()->remove(logger);
+
+  if (asok_hook) {
+    cct->get_admin_socket()->unregister_command("leveldb_compact_prefix");
+    delete asok_hook;
+    asok_hook = NULL;
+  }
 }
 
 int LevelDBStore::submit_transaction(KeyValueDB::Transaction t)
 {
   LevelDBTransactionImpl * _t =
     static_cast<LevelDBTransactionImpl *>(t.get());
+  utime_t start = ceph_clock_now(g_ceph_context);
   leveldb::Status s = db->Write(leveldb::WriteOptions(), &(_t->bat));
   logger->inc(l_leveldb_txns);
+  // any write stall (leveldb throttling us while it catches up on
+  // compaction) shows up here
+  logger->tinc(l_leveldb_submit_latency, ceph_clock_now(g_ceph_context) - start);
   return s.ok() ? 0 : -1;
 }
 
@@ -133,8 +200,10 @@ int LevelDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
     static_cast<LevelDBTransactionImpl *>(t.get());
   leveldb::WriteOptions options;
   options.sync = true;
+  utime_t start = ceph_clock_now(g_ceph_context);
   leveldb::Status s = db->Write(options, &(_t->bat));
   logger->inc(l_leveldb_txns);
+  logger->tinc(l_leveldb_submit_latency, ceph_clock_now(g_ceph_context) - start);
   return s.ok() ? 0 : -1;
 }
 
@@ -224,7 +293,9 @@ int LevelDBStore::split_key(leveldb::Slice in, string *prefix, string *key)
 void LevelDBStore::compact()
 {
   logger->inc(l_leveldb_compact);
+  utime_t start = ceph_clock_now(g_ceph_context);
   db->CompactRange(NULL, NULL);
+  logger->tinc(l_leveldb_compact_latency, ceph_clock_now(g_ceph_context) - start);
 }
 
 
@@ -238,8 +309,19 @@ void LevelDBStore::compact_thread_entry()
       logger->set(l_leveldb_compact_queue_len, compact_queue.size());
       compact_queue_lock.Unlock();
       logger->inc(l_leveldb_compact_range);
+      utime_t start = ceph_clock_now(g_ceph_context);
       compact_range(range.first, range.second);
+      logger->tinc(l_leveldb_compact_latency,
+		   ceph_clock_now(g_ceph_context) - start);
       compact_queue_lock.Lock();
+      if (options.compact_pause > 0 && !compact_queue_stop &&
+	  !compact_queue.empty()) {
+	// pace ourselves so compaction i/o does not starve concurrent
+	// commits; a signal (shutdown) cuts the pause short
+	utime_t pause;
+	pause.set_from_double(options.compact_pause);
+	compact_queue_cond.WaitInterval(cct, compact_queue_lock, pause);
+      }
       continue;
     }
     compact_queue_cond.Wait(compact_queue_lock);
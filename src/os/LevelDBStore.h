@@ -29,6 +29,7 @@
 #include "common/ceph_context.h"
 
 class PerfCounters;
+class AdminSocketHook;
 
 enum {
   l_leveldb_first = 34300,
@@ -38,6 +39,8 @@ enum {
   l_leveldb_compact_range,
   l_leveldb_compact_queue_merge,
   l_leveldb_compact_queue_len,
+  l_leveldb_submit_latency,
+  l_leveldb_compact_latency,
   l_leveldb_last,
 };
 
@@ -47,6 +50,7 @@ enum {
 class LevelDBStore : public KeyValueDB {
   CephContext *cct;
   PerfCounters *logger;
+  AdminSocketHook *asok_hook;
   string path;
   boost::scoped_ptr<leveldb::Cache> db_cache;
 #ifdef HAVE_LEVELDB_FILTER_POLICY
@@ -114,9 +118,11 @@ public:
     uint64_t write_buffer_size; /// in-memory write buffer size
     int max_open_files; /// maximum number of files LevelDB can open at once
     uint64_t cache_size; /// size of extra decompressed cache to use
+    bool cache_shared; /// share one block cache between all stores in the process
     uint64_t block_size; /// user data per block
     int bloom_size; /// number of bits per entry to put in a bloom filter
     bool compression_enabled; /// whether to use libsnappy compression or not
+    double compact_pause; /// seconds to pause between queued background range compactions
 
     // don't change these ones. No, seriously
     int block_restart_interval;
@@ -129,9 +135,11 @@ public:
       write_buffer_size(0), //< 0 means default
       max_open_files(0), //< 0 means default
       cache_size(0), //< 0 means no cache (default)
+      cache_shared(false), //< set to true to share the process-wide cache
       block_size(0), //< 0 means default
       bloom_size(0), //< 0 means no bloom filter (default)
       compression_enabled(true), //< set to false for no compression
+      compact_pause(0), //< 0 means no pause (default)
       block_restart_interval(0), //< 0 means default
       error_if_exists(false), //< set to true if you want to check nonexistence
       paranoid_checks(false) //< set to true if you want paranoid checks
@@ -141,6 +149,7 @@ public:
   LevelDBStore(CephContext *c, const string &path) :
     cct(c),
     logger(NULL),
+    asok_hook(NULL),
     path(path),
     db_cache(NULL),
 #ifdef HAVE_LEVELDB_FILTER_POLICY
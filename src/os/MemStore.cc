@@ -25,6 +25,8 @@
 #include "include/stringify.h"
 #include "include/unordered_map.h"
 #include "include/memory.h"
+#include "common/ceph_context.h"
+#include "common/config.h"
 #include "common/errno.h"
 #include "MemStore.h"
 
@@ -48,25 +50,106 @@ int MemStore::peek_journal_fsid(uuid_d *fsid)
 
 int MemStore::mount()
 {
+  m_memstore_max_bytes = cct->_conf->memstore_max_bytes;
+  m_memstore_snapshot_interval = cct->_conf->memstore_snapshot_interval;
   int r = _load();
   if (r < 0)
     return r;
+  r = _open_backing();
+  if (r < 0)
+    return r;
+  if (m_memstore_max_bytes && !backing_store) {
+    derr << __func__ << " memstore_max_bytes set but no backing store"
+	 << " configured; ignoring the bound" << dendl;
+    m_memstore_max_bytes = 0;
+  }
   finisher.start();
+  if (m_memstore_snapshot_interval > 0) {
+    snapshot_stop = false;
+    snapshot_thread.create();
+  }
   return 0;
 }
 
 int MemStore::umount()
 {
+  if (snapshot_thread.is_started()) {
+    snapshot_lock.Lock();
+    snapshot_stop = true;
+    snapshot_cond.Signal();
+    snapshot_lock.Unlock();
+    snapshot_thread.join();
+  }
   finisher.stop();
-  return _save();
+  int r = _save();
+  if (backing_store) {
+    int br = backing_store->umount();
+    if (r >= 0)
+      r = br;
+    delete backing_store;
+    backing_store = NULL;
+  }
+  return r;
+}
+
+int MemStore::_open_backing()
+{
+  string type = cct->_conf->memstore_backing_type;
+  if (type.empty())
+    return 0;
+  if (type == "memstore") {
+    derr << __func__ << " refusing to back memstore with memstore" << dendl;
+    return -EINVAL;
+  }
+  assert(!backing_store);
+  backing_store = ObjectStore::create(cct, type,
+				      cct->_conf->memstore_backing_path,
+				      cct->_conf->memstore_backing_journal);
+  if (!backing_store) {
+    derr << __func__ << " unknown backing store type " << type << dendl;
+    return -EINVAL;
+  }
+  int r = backing_store->mount();
+  if (r < 0) {
+    derr << __func__ << " failed to mount backing store: " << cpp_strerror(r)
+	 << dendl;
+    delete backing_store;
+    backing_store = NULL;
+    return r;
+  }
+  dout(1) << __func__ << " " << type << " "
+	  << cct->_conf->memstore_backing_path << dendl;
+  return 0;
+}
+
+void MemStore::snapshot_entry()
+{
+  dout(10) << __func__ << " start" << dendl;
+  snapshot_lock.Lock();
+  while (!snapshot_stop) {
+    utime_t interval;
+    interval.set_from_double(m_memstore_snapshot_interval);
+    snapshot_cond.WaitInterval(cct, snapshot_lock, interval);
+    if (snapshot_stop)
+      break;
+    snapshot_lock.Unlock();
+    int r = _save();
+    if (r < 0)
+      derr << __func__ << " snapshot failed: " << cpp_strerror(r) << dendl;
+    snapshot_lock.Lock();
+  }
+  snapshot_lock.Unlock();
+  dout(10) << __func__ << " finish" << dendl;
 }
 
 int MemStore::_save()
 {
   dout(10) << __func__ << dendl;
   Mutex::Locker l(apply_lock); // block any writer
-  dump_all();
+  if (cct->_conf->subsys.should_gather(ceph_subsys_filestore, 30))
+    dump_all();
   set<coll_t> collections;
+  list<string> pending;  // files to rename into place
   for (ceph::unordered_map<coll_t,CollectionRef>::iterator p = coll_map.begin();
        p != coll_map.end();
        ++p) {
@@ -74,19 +157,41 @@ int MemStore::_save()
     collections.insert(p->first);
     bufferlist bl;
     assert(p->second);
-    p->second->encode(bl);
+    {
+      // exclude readers so nothing faults back in mid-encode
+      RWLock::WLocker lc(p->second->lock);
+      p->second->encode(bl);
+    }
     string fn = path + "/" + stringify(p->first);
-    int r = bl.write_file(fn.c_str());
+    int r = bl.write_file((fn + ".tmp").c_str());
     if (r < 0)
       return r;
+    pending.push_back(fn);
   }
 
-  string fn = path + "/collections";
-  bufferlist bl;
-  ::encode(collections, bl);
-  int r = bl.write_file(fn.c_str());
-  if (r < 0)
-    return r;
+  {
+    bufferlist bl;
+    ::encode(collections, bl);
+    string fn = path + "/collections";
+    int r = bl.write_file((fn + ".tmp").c_str());
+    if (r < 0)
+      return r;
+    pending.push_back(fn);
+  }
+
+  // rename into place only once everything is written out.  each file
+  // is replaced atomically, and the collections list goes last, so a
+  // crash mid-save always leaves a mountable image with each collection
+  // individually consistent.
+  for (list<string>::iterator p = pending.begin(); p != pending.end(); ++p) {
+    string tmp = *p + ".tmp";
+    if (::rename(tmp.c_str(), p->c_str()) < 0) {
+      int err = errno;
+      derr << __func__ << " failed to rename " << tmp << ": "
+	   << cpp_strerror(err) << dendl;
+      return -err;
+    }
+  }
 
   return 0;
 }
@@ -166,11 +271,22 @@ int MemStore::_load()
     bufferlist::iterator p = cbl.begin();
     c->decode(p);
     coll_map[*q] = c;
+
+    Mutex::Locker l(cache_lock);
+    for (map<ghobject_t,ObjectRef>::iterator o = c->object_map.begin();
+	 o != c->object_map.end();
+	 ++o) {
+      if (!o->second->spilled) {
+	used_bytes += o->second->get_size();
+	_lru_touch(make_pair(*q, o->first));
+      }
+    }
   }
 
-  dump_all();
+  if (cct->_conf->subsys.should_gather(ceph_subsys_filestore, 30))
+    dump_all();
 
-  return 0;  
+  return 0;
 }
 
 void MemStore::set_fsid(uuid_d u)
@@ -215,12 +331,29 @@ int MemStore::mkfs()
   if (r < 0)
     return r;
 
+  string type = cct->_conf->memstore_backing_type;
+  if (type.length() && type != "memstore") {
+    ObjectStore *bs = ObjectStore::create(cct, type,
+					  cct->_conf->memstore_backing_path,
+					  cct->_conf->memstore_backing_journal);
+    if (!bs) {
+      derr << __func__ << " unknown backing store type " << type << dendl;
+      return -EINVAL;
+    }
+    r = bs->mkfs();
+    delete bs;
+    if (r < 0)
+      return r;
+  }
+
   return 0;
 }
 
 int MemStore::statfs(struct statfs *st)
 {
   dout(10) << __func__ << dendl;
+  if (backing_store)
+    return backing_store->statfs(st);
   // make some shit up.  these are the only fields that matter.
   st->f_bsize = 1024;
   st->f_blocks = 1000000;
@@ -245,6 +378,163 @@ MemStore::CollectionRef MemStore::get_collection(coll_t cid)
 }
 
 
+// ---------------
+// object cache
+
+MemStore::ObjectRef MemStore::find_object(CollectionRef c, coll_t cid,
+					  const ghobject_t& oid)
+{
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return o;
+  if (o->spilled) {
+    int r = _fetch_object(cid, oid, o);
+    if (r < 0) {
+      derr << __func__ << " " << cid << "/" << oid
+	   << " fetch from backing store failed: " << cpp_strerror(r) << dendl;
+      return ObjectRef();
+    }
+  }
+  Mutex::Locker l(cache_lock);
+  _lru_touch(make_pair(cid, oid));
+  return o;
+}
+
+int MemStore::_fetch_object(coll_t cid, const ghobject_t& oid, ObjectRef o)
+{
+  dout(10) << __func__ << " " << cid << " " << oid << dendl;
+  assert(backing_store);
+  struct stat st;
+  int r = backing_store->stat(cid, oid, &st);
+  if (r < 0)
+    return r;
+  if (st.st_size) {
+    r = backing_store->read(cid, oid, 0, st.st_size, o->data);
+    if (r < 0)
+      return r;
+  }
+  r = backing_store->getattrs(cid, oid, o->xattr);
+  if (r < 0 && r != -ENODATA)
+    return r;
+  r = backing_store->omap_get(cid, oid, &o->omap_header, &o->omap);
+  if (r < 0)
+    return r;
+  o->spilled = false;
+  o->dirty = false;
+  Mutex::Locker l(cache_lock);
+  used_bytes += o->get_size();
+  return 0;
+}
+
+void MemStore::_cache_dirty(coll_t cid, const ghobject_t& oid, ObjectRef o,
+			    uint64_t before)
+{
+  o->dirty = true;
+  Mutex::Locker l(cache_lock);
+  used_bytes += o->get_size() - before;
+  _lru_touch(make_pair(cid, oid));
+}
+
+void MemStore::_cache_forget(coll_t cid, const ghobject_t& oid, ObjectRef o)
+{
+  Mutex::Locker l(cache_lock);
+  used_bytes -= o->get_size();
+  map<cache_key_t, list<cache_key_t>::iterator>::iterator p =
+    lru_pos.find(make_pair(cid, oid));
+  if (p != lru_pos.end()) {
+    lru.erase(p->second);
+    lru_pos.erase(p);
+  }
+}
+
+void MemStore::_lru_touch(const cache_key_t& key)
+{
+  map<cache_key_t, list<cache_key_t>::iterator>::iterator p =
+    lru_pos.find(key);
+  if (p != lru_pos.end())
+    lru.erase(p->second);
+  lru.push_back(key);
+  lru_pos[key] = --lru.end();
+}
+
+void MemStore::_trim_cache()
+{
+  if (!m_memstore_max_bytes || !backing_store)
+    return;
+  cache_lock.Lock();
+  while (used_bytes > m_memstore_max_bytes && !lru.empty()) {
+    cache_key_t victim = lru.front();
+    lru.pop_front();
+    lru_pos.erase(victim);
+    cache_lock.Unlock();
+    _evict_object(victim.first, victim.second);
+    cache_lock.Lock();
+  }
+  cache_lock.Unlock();
+}
+
+bool MemStore::_evict_object(coll_t cid, const ghobject_t& oid)
+{
+  CollectionRef c = get_collection(cid);
+  if (!c)
+    return false;  // renamed or split away; it re-enters the lru on next use
+  RWLock::WLocker l(c->lock);
+  ObjectRef o = c->get_object(oid);
+  if (!o || o->spilled)
+    return false;
+  // the collection maps hold two refs and we hold one; any more and
+  // someone (a reader, an omap iterator) is actively using this object
+  if (o.use_count() > 3)
+    return false;
+  if (o->dirty || !o->in_backing) {
+    int r = _writeback(cid, oid, o);
+    if (r < 0) {
+      derr << __func__ << " " << cid << "/" << oid << " writeback failed: "
+	   << cpp_strerror(r) << dendl;
+      return false;
+    }
+  }
+  dout(10) << __func__ << " " << cid << " " << oid << dendl;
+  Mutex::Locker lc(cache_lock);
+  used_bytes -= o->get_size();
+  o->data.clear();
+  o->xattr.clear();
+  o->omap_header.clear();
+  o->omap.clear();
+  o->spilled = true;
+  return true;
+}
+
+int MemStore::_writeback(coll_t cid, const ghobject_t& oid, ObjectRef o)
+{
+  dout(15) << __func__ << " " << cid << " " << oid << dendl;
+  Transaction t;
+  if (o->in_backing)
+    t.remove(cid, oid);
+  t.touch(cid, oid);
+  if (o->data.length())
+    t.write(cid, oid, 0, o->data.length(), o->data);
+  if (!o->xattr.empty())
+    t.setattrs(cid, oid, o->xattr);
+  if (o->omap_header.length())
+    t.omap_setheader(cid, oid, o->omap_header);
+  if (!o->omap.empty())
+    t.omap_setkeys(cid, oid, o->omap);
+  int r = _backing_apply(t);
+  if (r < 0)
+    return r;
+  o->dirty = false;
+  o->in_backing = true;
+  return 0;
+}
+
+int MemStore::_backing_apply(Transaction& t)
+{
+  assert(backing_store);
+  return backing_store->apply_transaction(t);
+}
+
+
 // ---------------
 // read operations
 
@@ -273,7 +563,7 @@ int MemStore::stat(
     return -ENOENT;
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   st->st_size = o->data.length();
@@ -298,7 +588,7 @@ int MemStore::read(
     return -ENOENT;
   RWLock::RLocker lc(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   if (offset >= o->data.length())
@@ -323,7 +613,7 @@ int MemStore::fiemap(coll_t cid, const ghobject_t& oid,
     return -ENOENT;
   RWLock::RLocker lc(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   if (offset >= o->data.length())
@@ -346,7 +636,7 @@ int MemStore::getattr(coll_t cid, const ghobject_t& oid,
     return -ENOENT;
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   string k(name);
@@ -366,7 +656,7 @@ int MemStore::getattrs(coll_t cid, const ghobject_t& oid,
     return -ENOENT;
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   if (user_only) {
@@ -530,7 +820,7 @@ int MemStore::omap_get(
     return -ENOENT;
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   *header = o->omap_header;
@@ -551,7 +841,7 @@ int MemStore::omap_get_header(
     return -ENOENT;
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   *header = o->omap_header;
@@ -570,7 +860,7 @@ int MemStore::omap_get_keys(
     return -ENOENT;
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   for (map<string,bufferlist>::iterator p = o->omap.begin();
@@ -593,7 +883,7 @@ int MemStore::omap_get_values(
     return -ENOENT;
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   for (set<string>::const_iterator p = keys.begin();
@@ -619,7 +909,7 @@ int MemStore::omap_check_keys(
     return -ENOENT;
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   for (set<string>::const_iterator p = keys.begin();
@@ -641,7 +931,7 @@ ObjectMap::ObjectMapIterator MemStore::get_omap_iterator(coll_t cid,
     return ObjectMap::ObjectMapIterator();
   RWLock::RLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return ObjectMap::ObjectMapIterator();
   return ObjectMap::ObjectMapIterator(new OmapIteratorImpl(c, o));
@@ -676,6 +966,8 @@ int MemStore::queue_transactions(Sequencer *osr,
     finisher.queue(on_apply);
   if (on_commit)
     finisher.queue(on_commit);
+
+  _trim_cache();
   return 0;
 }
 
@@ -1024,6 +1316,7 @@ int MemStore::_touch(coll_t cid, const ghobject_t& oid)
     o.reset(new Object);
     c->object_map[oid] = o;
     c->object_hash[oid] = o;
+    _cache_dirty(cid, oid, o, 0);
   }
   return 0;
 }
@@ -1041,7 +1334,7 @@ int MemStore::_write(coll_t cid, const ghobject_t& oid,
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o) {
     // write implicitly creates a missing object
     o.reset(new Object);
@@ -1049,7 +1342,9 @@ int MemStore::_write(coll_t cid, const ghobject_t& oid,
     c->object_hash[oid] = o;
   }
 
+  uint64_t before = o->get_size();
   _write_into_bl(bl, offset, &o->data);
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1101,9 +1396,10 @@ int MemStore::_truncate(coll_t cid, const ghobject_t& oid, uint64_t size)
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
+  uint64_t before = o->get_size();
   if (o->data.length() > size) {
     bufferlist bl;
     bl.substr_of(o->data, 0, size);
@@ -1115,6 +1411,7 @@ int MemStore::_truncate(coll_t cid, const ghobject_t& oid, uint64_t size)
     bp.zero();
     o->data.append(bp);
   }
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1131,6 +1428,12 @@ int MemStore::_remove(coll_t cid, const ghobject_t& oid)
     return -ENOENT;
   c->object_map.erase(oid);
   c->object_hash.erase(oid);
+  _cache_forget(cid, oid, o);
+  if (backing_store && o->in_backing) {
+    Transaction t;
+    t.remove(cid, oid);
+    _backing_apply(t);
+  }
   return 0;
 }
 
@@ -1143,11 +1446,13 @@ int MemStore::_setattrs(coll_t cid, const ghobject_t& oid,
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
+  uint64_t before = o->get_size();
   for (map<string,bufferptr>::const_iterator p = aset.begin(); p != aset.end(); ++p)
     o->xattr[p->first] = p->second;
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1159,12 +1464,14 @@ int MemStore::_rmattr(coll_t cid, const ghobject_t& oid, const char *name)
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
   if (!o->xattr.count(name))
     return -ENODATA;
+  uint64_t before = o->get_size();
   o->xattr.erase(name);
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1176,10 +1483,12 @@ int MemStore::_rmattrs(coll_t cid, const ghobject_t& oid)
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
+  uint64_t before = o->get_size();
   o->xattr.clear();
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1193,18 +1502,20 @@ int MemStore::_clone(coll_t cid, const ghobject_t& oldoid,
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef oo = c->get_object(oldoid);
+  ObjectRef oo = find_object(c, cid, oldoid);
   if (!oo)
     return -ENOENT;
-  ObjectRef no = c->get_object(newoid);
+  ObjectRef no = find_object(c, cid, newoid);
   if (!no) {
     no.reset(new Object);
     c->object_map[newoid] = no;
     c->object_hash[newoid] = no;
   }
+  uint64_t before = no->get_size();
   no->data = oo->data;
   no->omap_header = oo->omap_header;
   no->omap = oo->omap;
+  _cache_dirty(cid, newoid, no, before);
   return 0;
 }
 
@@ -1221,14 +1532,15 @@ int MemStore::_clone_range(coll_t cid, const ghobject_t& oldoid,
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef oo = c->get_object(oldoid);
+  ObjectRef oo = find_object(c, cid, oldoid);
   if (!oo)
     return -ENOENT;
-  ObjectRef no = c->get_object(newoid);
+  ObjectRef no = find_object(c, cid, newoid);
   if (!no) {
     no.reset(new Object);
     c->object_map[newoid] = no;
     c->object_hash[newoid] = no;
+    _cache_dirty(cid, newoid, no, 0);
   }
   if (srcoff >= oo->data.length())
     return 0;
@@ -1236,7 +1548,9 @@ int MemStore::_clone_range(coll_t cid, const ghobject_t& oldoid,
     len = oo->data.length() - srcoff;
   bufferlist bl;
   bl.substr_of(oo->data, srcoff, len);
+  uint64_t before = no->get_size();
   _write_into_bl(bl, dstoff, &no->data);
+  _cache_dirty(cid, newoid, no, before);
   return len;
 }
 
@@ -1248,10 +1562,12 @@ int MemStore::_omap_clear(coll_t cid, const ghobject_t &oid)
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
+  uint64_t before = o->get_size();
   o->omap.clear();
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1264,11 +1580,13 @@ int MemStore::_omap_setkeys(coll_t cid, const ghobject_t &oid,
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
+  uint64_t before = o->get_size();
   for (map<string,bufferlist>::const_iterator p = aset.begin(); p != aset.end(); ++p)
     o->omap[p->first] = p->second;
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1281,11 +1599,13 @@ int MemStore::_omap_rmkeys(coll_t cid, const ghobject_t &oid,
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
+  uint64_t before = o->get_size();
   for (set<string>::const_iterator p = keys.begin(); p != keys.end(); ++p)
     o->omap.erase(*p);
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1299,13 +1619,15 @@ int MemStore::_omap_rmkeyrange(coll_t cid, const ghobject_t &oid,
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
+  uint64_t before = o->get_size();
   map<string,bufferlist>::iterator p = o->omap.upper_bound(first);
   map<string,bufferlist>::iterator e = o->omap.lower_bound(last);
   while (p != e)
     o->omap.erase(p++);
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1318,10 +1640,12 @@ int MemStore::_omap_setheader(coll_t cid, const ghobject_t &oid,
     return -ENOENT;
   RWLock::WLocker l(c->lock);
 
-  ObjectRef o = c->get_object(oid);
+  ObjectRef o = find_object(c, cid, oid);
   if (!o)
     return -ENOENT;
+  uint64_t before = o->get_size();
   o->omap_header = bl;
+  _cache_dirty(cid, oid, o, before);
   return 0;
 }
 
@@ -1333,6 +1657,11 @@ int MemStore::_create_collection(coll_t cid)
   if (cp != coll_map.end())
     return -EEXIST;
   coll_map[cid].reset(new Collection);
+  if (backing_store) {
+    Transaction t;
+    t.create_collection(cid);
+    _backing_apply(t);
+  }
   return 0;
 }
 
@@ -1349,6 +1678,11 @@ int MemStore::_destroy_collection(coll_t cid)
       return -ENOTEMPTY;
   }
   coll_map.erase(cp);
+  if (backing_store) {
+    Transaction t;
+    t.remove_collection(cid);
+    _backing_apply(t);
+  }
   return 0;
 }
 
@@ -1371,6 +1705,14 @@ int MemStore::_collection_add(coll_t cid, coll_t ocid, const ghobject_t& oid)
   ObjectRef o = oc->object_hash[oid];
   c->object_map[oid] = o;
   c->object_hash[oid] = o;
+  // the object is now linked under both cids; account it under the new
+  // one too (over-counting is the safe direction for the cache bound)
+  _cache_dirty(cid, oid, o, 0);
+  if (backing_store && o->in_backing) {
+    Transaction t;
+    t.collection_add(cid, ocid, oid);
+    _backing_apply(t);
+  }
   return 0;
 }
 
@@ -1397,7 +1739,14 @@ int MemStore::_collection_move_rename(coll_t oldcid, const ghobject_t& oldoid,
   c->object_hash[oid] = o;
   oc->object_map.erase(oldoid);
   oc->object_hash.erase(oldoid);
-  return 0; 
+  _cache_dirty(cid, oid, o, 0);
+  _cache_forget(oldcid, oldoid, o);
+  if (backing_store && o->in_backing) {
+    Transaction t;
+    t.collection_move_rename(oldcid, oldoid, cid, oid);
+    _backing_apply(t);
+  }
+  return 0;
 }
 
 int MemStore::_collection_setattr(coll_t cid, const char *name,
@@ -1453,6 +1802,13 @@ int MemStore::_collection_rename(const coll_t &cid, const coll_t &ncid)
     return -EEXIST;
   coll_map[ncid] = coll_map[cid];
   coll_map.erase(cid);
+  // lru entries keyed by the old cid go stale; eviction skips them and
+  // the objects re-enter the lru on next use
+  if (backing_store) {
+    Transaction t;
+    t.collection_rename(cid, ncid);
+    _backing_apply(t);
+  }
   return 0;
 }
 
@@ -1483,5 +1839,13 @@ int MemStore::_split_collection(coll_t cid, uint32_t bits, uint32_t match,
     }
   }
 
+  // lru entries for the moved objects go stale; eviction skips them and
+  // the objects re-enter the lru on next use
+  if (backing_store) {
+    Transaction t;
+    t.split_collection(cid, bits, match, dest);
+    _backing_apply(t);
+  }
+
   return 0;
 }
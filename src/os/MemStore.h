@@ -21,6 +21,7 @@
 #include "include/memory.h"
 #include "common/Finisher.h"
 #include "common/RWLock.h"
+#include "common/Thread.h"
 #include "ObjectStore.h"
 
 class MemStore : public ObjectStore {
@@ -31,20 +32,50 @@ public:
     bufferlist omap_header;
     map<string,bufferlist> omap;
 
+    bool dirty;      ///< modified since last writeback (in memory only)
+    bool spilled;    ///< contents dropped; the backing store has them
+    bool in_backing; ///< the backing store holds a (possibly stale) copy
+
+    Object() : dirty(false), spilled(false), in_backing(false) {}
+
+    uint64_t get_size() const {
+      uint64_t s = data.length() + omap_header.length();
+      for (map<string,bufferptr>::const_iterator p = xattr.begin();
+	   p != xattr.end();
+	   ++p)
+	s += p->first.length() + p->second.length();
+      for (map<string,bufferlist>::const_iterator p = omap.begin();
+	   p != omap.end();
+	   ++p)
+	s += p->first.length() + p->second.length();
+      return s;
+    }
+
     void encode(bufferlist& bl) const {
-      ENCODE_START(1, 1, bl);
+      ENCODE_START(2, 1, bl);
       ::encode(data, bl);
       ::encode(xattr, bl);
       ::encode(omap_header, bl);
       ::encode(omap, bl);
+      ::encode(spilled, bl);
+      ::encode(in_backing, bl);
       ENCODE_FINISH(bl);
     }
     void decode(bufferlist::iterator& p) {
-      DECODE_START(1, p);
+      DECODE_START(2, p);
       ::decode(data, p);
       ::decode(xattr, p);
       ::decode(omap_header, p);
       ::decode(omap, p);
+      if (struct_v >= 2) {
+	::decode(spilled, p);
+	::decode(in_backing, p);
+      } else {
+	spilled = false;
+	in_backing = false;
+      }
+      // the snapshot may be newer than the backing copy; rewrite on evict
+      dirty = !spilled;
       DECODE_FINISH(p);
     }
     void dump(Formatter *f) const {
@@ -182,6 +213,47 @@ private:
 
   Finisher finisher;
 
+  CephContext *cct;
+
+  /// cold objects spill here once used_bytes exceeds the bound (may be NULL)
+  ObjectStore *backing_store;
+
+  typedef pair<coll_t,ghobject_t> cache_key_t;
+  Mutex cache_lock;    ///< protects used_bytes and the lru
+  uint64_t used_bytes; ///< resident object bytes
+  list<cache_key_t> lru;  ///< coldest objects at the front
+  map<cache_key_t, list<cache_key_t>::iterator> lru_pos;
+
+  uint64_t m_memstore_max_bytes;
+  double m_memstore_snapshot_interval;
+
+  struct SnapshotThread : public Thread {
+    MemStore *ms;
+    SnapshotThread(MemStore *m) : ms(m) {}
+    void *entry() {
+      ms->snapshot_entry();
+      return 0;
+    }
+  } snapshot_thread;
+  Mutex snapshot_lock;
+  Cond snapshot_cond;
+  bool snapshot_stop;
+  void snapshot_entry();
+
+  /// look oid up in c, faulting its contents back in from the backing
+  /// store if they were spilled; c->lock must be held
+  ObjectRef find_object(CollectionRef c, coll_t cid, const ghobject_t& oid);
+  int _fetch_object(coll_t cid, const ghobject_t& oid, ObjectRef o);
+  void _cache_dirty(coll_t cid, const ghobject_t& oid, ObjectRef o,
+		    uint64_t before);
+  void _cache_forget(coll_t cid, const ghobject_t& oid, ObjectRef o);
+  void _lru_touch(const cache_key_t& key);
+  void _trim_cache();
+  bool _evict_object(coll_t cid, const ghobject_t& oid);
+  int _writeback(coll_t cid, const ghobject_t& oid, ObjectRef o);
+  int _open_backing();
+  int _backing_apply(Transaction& t);
+
   void _do_transaction(Transaction& t);
 
   void _write_into_bl(const bufferlist& src, unsigned offset, bufferlist *dst);
@@ -230,8 +302,19 @@ public:
     : ObjectStore(path),
       coll_lock("MemStore::coll_lock"),
       apply_lock("MemStore::apply_lock"),
-      finisher(cct) { }
-  ~MemStore() { }
+      finisher(cct),
+      cct(cct),
+      backing_store(NULL),
+      cache_lock("MemStore::cache_lock"),
+      used_bytes(0),
+      m_memstore_max_bytes(0),
+      m_memstore_snapshot_interval(0),
+      snapshot_thread(this),
+      snapshot_lock("MemStore::snapshot_lock"),
+      snapshot_stop(false) { }
+  ~MemStore() {
+    delete backing_store;
+  }
 
   int update_version_stamp() {
     return 0;
@@ -21,6 +21,8 @@
 #include <vector>
 #include "include/memory.h"
 
+class MemoryBudget;
+
 /**
  * Encapsulates the FileStore key value store
  *
@@ -28,6 +30,9 @@
  */
 class ObjectMap {
 public:
+  /// register any trimmable caches with the daemon's memory balancer
+  virtual void register_budget(MemoryBudget *budget) {}
+
   /// Set keys and values from specified map
   virtual int set_keys(
     const ghobject_t &oid,              ///< [in] object containing map
@@ -147,6 +152,25 @@ public:
     virtual string key() = 0;
     virtual bufferlist value() = 0;
     virtual int status() = 0;
+
+    /**
+     * Fetch up to max keys starting at the current position in one
+     * call, advancing the iterator past them.  Backends that can walk
+     * their store more cheaply than a valid()/key()/value()/next()
+     * round trip per key should override this.
+     */
+    virtual int get_next_n(uint64_t max, map<string, bufferlist> *out) {
+      uint64_t got = 0;
+      while (got < max && valid()) {
+	out->insert(out->end(), make_pair(key(), value()));
+	++got;
+	int r = next();
+	if (r < 0)
+	  return r;
+      }
+      return got;
+    }
+
     virtual ~ObjectMapIteratorImpl() {}
   };
   typedef ceph::shared_ptr<ObjectMapIteratorImpl> ObjectMapIterator;
@@ -154,6 +178,12 @@ public:
     return ObjectMapIterator();
   }
 
+  /// as get_iterator, but the view is pinned to a snapshot of the
+  /// backing store taken at creation time (where supported)
+  virtual ObjectMapIterator get_snapshot_iterator(const ghobject_t &oid) {
+    return get_iterator(oid);
+  }
+
 
   virtual ~ObjectMap() {}
 };
@@ -33,6 +33,7 @@
 #endif /* DARWIN */
 
 class CephContext;
+class MemoryBudget;
 
 using std::vector;
 using std::string;
@@ -52,6 +53,8 @@ enum {
   l_os_j_lat,
   l_os_j_wr,
   l_os_j_wr_bytes,
+  l_os_j_wr_entries,
+  l_os_j_batch_lat,
   l_os_j_full,
   l_os_committing,
   l_os_commit,
@@ -65,6 +68,8 @@ enum {
   l_os_bytes,
   l_os_apply_lat,
   l_os_queue_lat,
+  l_os_kv_sync,
+  l_os_kv_sync_lat,
   l_os_last,
 };
 
@@ -74,6 +79,7 @@ enum {
  */
 
 class Logger;
+class SloppyCRCMap;
 
 
 static inline void encode(const map<string,bufferptr> *attrset, bufferlist &bl) {
@@ -344,11 +350,44 @@ public:
       OP_SETALLOCHINT = 39,  // cid, oid, object_size, write_size
     };
 
+    /**
+     * Op - structured in-memory form of a single operation
+     *
+     * Transactions built in-process keep each operation in one of
+     * these, in op_list, alongside the encoded form in tbl.  The
+     * encoded form is still what gets journaled and shipped to
+     * replicas, but a local consumer (FileStore::_do_transaction et
+     * al) reads the structs back through the iterator below and skips
+     * the decode entirely.  Transactions that arrive already encoded
+     * (from a replica, or journal replay) have an empty op_list and
+     * fall back to decoding tbl.
+     *
+     * Fields are shared across op types; the iterator hands them out
+     * in the same order the encoded form would have produced them
+     * (e.g. for OP_CLONERANGE2 successive decode_length calls return
+     * off, len, off2).
+     */
+    struct Op {
+      __u32 op;
+      coll_t cid, cid2;
+      ghobject_t oid, oid2;
+      uint64_t off, len, off2;
+      uint32_t u32_1, u32_2;
+      string name, name2;
+      bufferlist data;
+      map<string, bufferptr> xattrs;
+      map<string, bufferlist> values;
+      set<string> keys;
+      explicit Op(__u32 o)
+	: op(o), off(0), len(0), off2(0), u32_1(0), u32_2(0) {}
+    };
+
   private:
     uint64_t ops;
     uint64_t pad_unused_bytes;
     uint32_t largest_data_len, largest_data_off, largest_data_off_in_tbl;
     bufferlist tbl;
+    list<Op> op_list;
     bool sobject_encoding;
     int64_t pool_override;
     bool use_pool_override;
@@ -433,10 +472,16 @@ public:
       std::swap(on_commit, other.on_commit);
       std::swap(on_applied_sync, other.on_applied_sync);
       tbl.swap(other.tbl);
+      op_list.swap(other.op_list);
     }
 
     /// Append the operations of the parameter to this Transaction. Those operations are removed from the parameter Transaction
     void append(Transaction& other) {
+      // the structured form survives only if both sides still have one
+      // op struct per encoded op; otherwise consumers fall back to
+      // decoding tbl.
+      bool keep_op_list = op_list.size() == ops &&
+	other.op_list.size() == other.ops;
       ops += other.ops;
       assert(pad_unused_bytes == 0);
       assert(other.pad_unused_bytes == 0);
@@ -446,6 +491,12 @@ public:
 	largest_data_off_in_tbl = tbl.length() + other.largest_data_off_in_tbl;
       }
       tbl.append(other.tbl);
+      if (keep_op_list) {
+	op_list.splice(op_list.end(), other.op_list);
+      } else {
+	op_list.clear();
+	other.op_list.clear();
+      }
       on_applied.splice(on_applied.end(), other.on_applied);
       on_commit.splice(on_commit.end(), other.on_commit);
       on_applied_sync.splice(on_applied_sync.end(), other.on_applied_sync);
@@ -513,6 +564,12 @@ public:
       bool replica;
       bool _tolerate_collection_add_enoent;
 
+      /// structured path; used iff op_list covers every op
+      bool structured;
+      list<Op>::const_iterator op_cur, op_end;
+      const Op *cur;
+      unsigned cid_n, oid_n, len_n, name_n, u32_n;
+
       iterator(Transaction *t)
 	: p(t->tbl.begin()),
 	  sobject_encoding(t->sobject_encoding),
@@ -520,7 +577,12 @@ public:
 	  use_pool_override(t->use_pool_override),
 	  replica(t->replica),
 	  _tolerate_collection_add_enoent(
-	    t->tolerate_collection_add_enoent) {}
+	    t->tolerate_collection_add_enoent),
+	  structured(t->op_list.size() == t->ops),
+	  op_cur(t->op_list.begin()),
+	  op_end(t->op_list.end()),
+	  cur(0),
+	  cid_n(0), oid_n(0), len_n(0), name_n(0), u32_n(0) {}
 
       friend class Transaction;
 
@@ -530,6 +592,8 @@ public:
       }
       /// true if there are more operations left to be enumerated
       bool have_op() {
+	if (structured)
+	  return op_cur != op_end;
 	return !p.end();
       }
 
@@ -538,16 +602,30 @@ public:
        * correct type.
        */
       int decode_op() {
+	if (structured) {
+	  cur = &*op_cur;
+	  ++op_cur;
+	  cid_n = oid_n = len_n = name_n = u32_n = 0;
+	  return cur->op;
+	}
 	__u32 op;
 	::decode(op, p);
 	return op;
       }
       void decode_bl(bufferlist& bl) {
+	if (structured) {
+	  bl = cur->data;
+	  return;
+	}
 	::decode(bl, p);
       }
       /// Get an oid, recognize various legacy forms and update them.
       ghobject_t decode_oid() {
 	ghobject_t oid;
+	if (structured) {
+	  // locally built; no legacy munging to do
+	  return oid_n++ ? cur->oid2 : cur->oid;
+	}
 	if (sobject_encoding) {
 	  sobject_t soid;
 	  ::decode(soid, p);
@@ -565,35 +643,77 @@ public:
 	return oid;
       }
       coll_t decode_cid() {
+	if (structured)
+	  return cid_n++ ? cur->cid2 : cur->cid;
 	coll_t c;
 	::decode(c, p);
 	return c;
       }
       uint64_t decode_length() {
+	if (structured) {
+	  switch (len_n++) {
+	  case 0: return cur->off;
+	  case 1: return cur->len;
+	  default: return cur->off2;
+	  }
+	}
 	uint64_t len;
 	::decode(len, p);
 	return len;
       }
       string decode_attrname() {
+	if (structured)
+	  return name_n++ ? cur->name2 : cur->name;
 	string s;
 	::decode(s, p);
 	return s;
       }
       string decode_key() {
-	string s;
-	::decode(s, p);
-	return s;
+	return decode_attrname();
       }
       void decode_attrset(map<string,bufferptr>& aset) {
+	if (structured) {
+	  if (cur->values.empty()) {
+	    aset = cur->xattrs;
+	  } else {
+	    // built via the bufferlist overload; flatten each value
+	    for (map<string,bufferlist>::const_iterator i =
+		   cur->values.begin();
+		 i != cur->values.end();
+		 ++i) {
+	      bufferlist bl(i->second);
+	      aset[i->first] = bufferptr(bl.c_str(), bl.length());
+	    }
+	  }
+	  return;
+	}
 	::decode(aset, p);
       }
       void decode_attrset(map<string,bufferlist>& aset) {
+	if (structured) {
+	  if (cur->xattrs.empty()) {
+	    aset = cur->values;
+	  } else {
+	    for (map<string,bufferptr>::const_iterator i =
+		   cur->xattrs.begin();
+		 i != cur->xattrs.end();
+		 ++i)
+	      aset[i->first].append(i->second);
+	  }
+	  return;
+	}
 	::decode(aset, p);
       }
       void decode_keyset(set<string> &keys) {
+	if (structured) {
+	  keys = cur->keys;
+	  return;
+	}
 	::decode(keys, p);
       }
       uint32_t decode_u32() {
+	if (structured)
+	  return u32_n++ ? cur->u32_2 : cur->u32_1;
 	uint32_t bits;
 	::decode(bits, p);
 	return bits;
@@ -618,12 +738,14 @@ public:
     void start_sync() {
       __u32 op = OP_STARTSYNC;
       ::encode(op, tbl);
+      op_list.push_back(Op(op));
       ops++;
     }
     /// noop. 'nuf said
     void nop() {
       __u32 op = OP_NOP;
       ::encode(op, tbl);
+      op_list.push_back(Op(op));
       ops++;
     }
     /**
@@ -637,6 +759,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(oid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
       ops++;
     }
     /**
@@ -664,6 +790,13 @@ public:
 	largest_data_off_in_tbl = tbl.length() + sizeof(__u32);  // we are about to
       }
       ::encode(data, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.off = off;
+      o.len = len;
+      o.data = data;
       ops++;
     }
     /**
@@ -678,6 +811,12 @@ public:
       ::encode(oid, tbl);
       ::encode(off, tbl);
       ::encode(len, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.off = off;
+      o.len = len;
       ops++;
     }
     /// Discard all data in the object beyond the specified size.
@@ -687,6 +826,11 @@ public:
       ::encode(cid, tbl);
       ::encode(oid, tbl);
       ::encode(off, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.off = off;
       ops++;
     }
     /// Remove an object. All four parts of the object are removed.
@@ -695,6 +839,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(oid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
       ops++;
     }
     /// Set an xattr of an object
@@ -710,6 +858,12 @@ public:
       ::encode(oid, tbl);
       ::encode(s, tbl);
       ::encode(val, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.name = s;
+      o.data = val;
       ops++;
     }
     /// Set multiple xattrs of an object
@@ -719,6 +873,11 @@ public:
       ::encode(cid, tbl);
       ::encode(oid, tbl);
       ::encode(attrset, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.xattrs = attrset;
       ops++;
     }
     /// Set multiple xattrs of an object
@@ -728,6 +887,11 @@ public:
       ::encode(cid, tbl);
       ::encode(oid, tbl);
       ::encode(attrset, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.values = attrset;
       ops++;
     }
     /// remove an xattr from an object
@@ -742,6 +906,11 @@ public:
       ::encode(cid, tbl);
       ::encode(oid, tbl);
       ::encode(s, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.name = s;
       ops++;
     }
     /// remove all xattrs from an object
@@ -750,6 +919,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(oid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
       ops++;
     }
     /**
@@ -769,6 +942,11 @@ public:
       ::encode(cid, tbl);
       ::encode(oid, tbl);
       ::encode(noid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.oid2 = noid;
       ops++;
     }
     /**
@@ -788,6 +966,14 @@ public:
       ::encode(srcoff, tbl);
       ::encode(srclen, tbl);
       ::encode(dstoff, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.oid2 = noid;
+      o.off = srcoff;
+      o.len = srclen;
+      o.off2 = dstoff;
       ops++;
     }
     /// Create the collection
@@ -795,6 +981,8 @@ public:
       __u32 op = OP_MKCOLL;
       ::encode(op, tbl);
       ::encode(cid, tbl);
+      op_list.push_back(Op(op));
+      op_list.back().cid = cid;
       ops++;
     }
     /// remove the collection, the collection must be empty
@@ -802,6 +990,8 @@ public:
       __u32 op = OP_RMCOLL;
       ::encode(op, tbl);
       ::encode(cid, tbl);
+      op_list.push_back(Op(op));
+      op_list.back().cid = cid;
       ops++;
     }
     /**
@@ -819,6 +1009,11 @@ public:
       ::encode(cid, tbl);
       ::encode(ocid, tbl);
       ::encode(oid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.cid2 = ocid;
+      o.oid = oid;
       ops++;
     }
     void collection_remove(coll_t cid, const ghobject_t& oid) {
@@ -826,6 +1021,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(oid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
       ops++;
     }
     void collection_move(coll_t cid, coll_t oldcid, const ghobject_t& oid) {
@@ -841,6 +1040,12 @@ public:
       ::encode(oldoid, tbl);
       ::encode(cid, tbl);
       ::encode(oid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = oldcid;
+      o.oid = oldoid;
+      o.cid2 = cid;
+      o.oid2 = oid;
       ops++;
     }
 
@@ -856,6 +1061,11 @@ public:
       ::encode(cid, tbl);
       ::encode(name, tbl);
       ::encode(val, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.name = name;
+      o.data = val;
       ops++;
     }
 
@@ -870,6 +1080,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(name, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.name = name;
       ops++;
     }
     /// Set multiple xattrs on a collection
@@ -878,6 +1092,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(aset, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.xattrs = aset;
       ops++;
     }
     /// Set multiple xattrs on a collection
@@ -886,6 +1104,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(aset, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.values = aset;
       ops++;
     }
     /// Change the name of a collection
@@ -894,6 +1116,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(ncid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.cid2 = ncid;
       ops++;
     }
 
@@ -906,6 +1132,10 @@ public:
       ::encode(op, tbl);
       ::encode(cid, tbl);
       ::encode(oid, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
       ops++;
     }
     /// Set keys on oid omap.  Replaces duplicate keys.
@@ -919,6 +1149,11 @@ public:
       ::encode(cid, tbl);
       ::encode(oid, tbl);
       ::encode(attrset, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.values = attrset;
       ops++;
     }
     /// Remove keys from oid omap
@@ -932,6 +1167,11 @@ public:
       ::encode(cid, tbl);
       ::encode(oid, tbl);
       ::encode(keys, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.keys = keys;
       ops++;
     }
 
@@ -948,6 +1188,12 @@ public:
       ::encode(oid, tbl);
       ::encode(first, tbl);
       ::encode(last, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.name = first;
+      o.name2 = last;
       ops++;
     }
 
@@ -962,6 +1208,11 @@ public:
       ::encode(cid, tbl);
       ::encode(oid, tbl);
       ::encode(bl, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.data = bl;
       ops++;
     }
 
@@ -978,6 +1229,12 @@ public:
       ::encode(bits, tbl);
       ::encode(rem, tbl);
       ::encode(destination, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.u32_1 = bits;
+      o.u32_2 = rem;
+      o.cid2 = destination;
       ++ops;
     }
 
@@ -993,6 +1250,12 @@ public:
       ::encode(oid, tbl);
       ::encode(expected_object_size, tbl);
       ::encode(expected_write_size, tbl);
+      op_list.push_back(Op(op));
+      Op &o = op_list.back();
+      o.cid = cid;
+      o.oid = oid;
+      o.off = expected_object_size;
+      o.len = expected_write_size;
       ++ops;
     }
 
@@ -1046,6 +1309,9 @@ public:
 	::decode(largest_data_off_in_tbl, bl);
       }
       ::decode(tbl, bl);
+      // encoded transactions carry no structured form; consumers
+      // decode tbl as before
+      op_list.clear();
       if (struct_v < 6) {
 	use_pool_override = true;
       }
@@ -1176,6 +1442,13 @@ public:
 
   virtual void collect_metadata(map<string,string> *pm) { }
 
+  /**
+   * register the store's caches with the daemon's memory balancer;
+   * call after mount().  stores with no trimmable caches need not
+   * implement this.
+   */
+  virtual void register_caches(MemoryBudget *budget) { }
+
   /**
    * get the most recent "on-disk format version" supported
    */
@@ -1282,6 +1555,37 @@ public:
     bufferlist& bl,
     bool allow_eio = false) = 0;
 
+  /**
+   * aio_read -- read a byte range of data from an object, asynchronously
+   *
+   * onfinish is completed with the value read() would have returned.
+   * The base implementation just does a synchronous read and completes
+   * the context before returning; backends with a real aio engine
+   * override it so the calling thread is not tied up for the duration
+   * of the disk read.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to be read
+   * @param len number of bytes to be read
+   * @param pbl output bufferlist, must stay valid until onfinish runs
+   * @param onfinish completion to call with the read result
+   * @param allow_eio if false, assert on -EIO operation failure
+   * @returns 0 if the read was submitted (or completed synchronously).
+   */
+  virtual int aio_read(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    bufferlist *pbl,
+    Context *onfinish,
+    bool allow_eio = false) {
+    int r = read(cid, oid, offset, len, *pbl, allow_eio);
+    onfinish->complete(r);
+    return 0;
+  }
+
   /**
    * fiemap -- get extent map of data of an object
    *
@@ -1300,6 +1604,26 @@ public:
    */
   virtual int fiemap(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len, bufferlist& bl) = 0;
 
+  /**
+   * get_checksum_map -- fetch stored per-block checksums for an object
+   *
+   * Backends that maintain block checksums alongside object data (see
+   * filestore_sloppy_crc) return the stored map here, so that a deep
+   * scrub can compare checksums across replicas without rereading data
+   * that has not changed.  The map may be sparse; only blocks that have
+   * been written in their entirety carry a crc.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param out stored checksum map
+   * @returns 0 on success, negative error code on failure;
+   *  -EOPNOTSUPP if the backend does not maintain checksums.
+   */
+  virtual int get_checksum_map(coll_t cid, const ghobject_t& oid,
+			       SloppyCRCMap *out) {
+    return -EOPNOTSUPP;
+  }
+
   /**
    * getattr -- get an xattr of an object
    *
@@ -1527,6 +1851,20 @@ public:
     const ghobject_t &oid  ///< [in] object
     ) = 0;
 
+  /**
+   * Get an omap iterator over a consistent snapshot of an object's keys
+   *
+   * Backends with snapshot support pin the view when the iterator is
+   * created, so concurrent updates cannot perturb an in-progress
+   * listing; others fall back to a live iterator.
+   */
+  virtual ObjectMap::ObjectMapIterator get_omap_snapshot_iterator(
+    coll_t c,              ///< [in] collection
+    const ghobject_t &oid  ///< [in] object
+    ) {
+    return get_omap_iterator(c, oid);
+  }
+
   virtual void sync(Context *onsync) {}
   virtual void sync() {}
   virtual void flush() {}
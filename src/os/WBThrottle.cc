@@ -4,10 +4,15 @@
 #include "acconfig.h"
 
 #include "os/WBThrottle.h"
+#include "common/Clock.h"
 #include "common/perf_counters.h"
 
 WBThrottle::WBThrottle(CephContext *cct) :
   cur_ios(0), cur_size(0),
+  adaptive(false),
+  flush_latency_target(0),
+  flush_latency_ewma(0),
+  limit_scale(1.0),
   cct(cct),
   logger(NULL),
   stopping(true),
@@ -28,6 +33,7 @@ WBThrottle::WBThrottle(CephContext *cct) :
   b.add_u64(l_wbthrottle_ios_wb, "ios_wb");
   b.add_u64(l_wbthrottle_inodes_dirtied, "inodes_dirtied");
   b.add_u64(l_wbthrottle_inodes_wb, "inodes_wb");
+  b.add_time_avg(l_wbthrottle_flush_lat, "flush_latency");
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
   for (unsigned i = l_wbthrottle_first + 1; i != l_wbthrottle_last; ++i)
@@ -78,6 +84,8 @@ const char** WBThrottle::get_tracked_conf_keys() const
     "filestore_wbthrottle_xfs_ios_hard_limit",
     "filestore_wbthrottle_xfs_inodes_start_flusher",
     "filestore_wbthrottle_xfs_inodes_hard_limit",
+    "filestore_wbthrottle_adaptive",
+    "filestore_wbthrottle_flush_latency_target",
     NULL
   };
   return KEYS;
@@ -115,6 +123,10 @@ void WBThrottle::set_from_conf()
   } else {
     assert(0 == "invalid value for fs");
   }
+  adaptive = cct->_conf->filestore_wbthrottle_adaptive;
+  flush_latency_target = cct->_conf->filestore_wbthrottle_flush_latency_target;
+  if (!adaptive)
+    limit_scale = 1.0;
   cond.Signal();
 }
 
@@ -136,9 +148,9 @@ bool WBThrottle::get_next_should_flush(
   assert(lock.is_locked());
   assert(next);
   while (!stopping &&
-         cur_ios < io_limits.first &&
-         pending_wbs.size() < fd_limits.first &&
-         cur_size < size_limits.first)
+         cur_ios < scaled(io_limits.first) &&
+         pending_wbs.size() < scaled(fd_limits.first) &&
+         cur_size < scaled(size_limits.first))
          cond.Wait(lock);
   if (stopping)
     return false;
@@ -160,11 +172,13 @@ void *WBThrottle::entry()
   while (get_next_should_flush(&wb)) {
     clearing = wb.get<0>();
     lock.Unlock();
+    utime_t start = ceph_clock_now(cct);
 #ifdef HAVE_FDATASYNC
     ::fdatasync(**wb.get<1>());
 #else
     ::fsync(**wb.get<1>());
 #endif
+    utime_t lat = ceph_clock_now(cct) - start;
 #ifdef HAVE_POSIX_FADVISE
     if (wb.get<2>().nocache) {
       int fa_r = posix_fadvise(**wb.get<1>(), 0, 0, POSIX_FADV_DONTNEED);
@@ -173,6 +187,8 @@ void *WBThrottle::entry()
 #endif
     lock.Lock();
     clearing = ghobject_t();
+    logger->tinc(l_wbthrottle_flush_lat, lat);
+    update_flush_latency((double)lat);
     cur_ios -= wb.get<2>().ios;
     logger->dec(l_wbthrottle_ios_dirtied, wb.get<2>().ios);
     cur_size -= wb.get<2>().size;
@@ -252,9 +268,9 @@ void WBThrottle::throttle()
 {
   Mutex::Locker l(lock);
   while (!stopping && !(
-	   cur_ios < io_limits.second &&
-	   pending_wbs.size() < fd_limits.second &&
-	   cur_size < size_limits.second)) {
+	   cur_ios < scaled(io_limits.second) &&
+	   pending_wbs.size() < scaled(fd_limits.second) &&
+	   cur_size < scaled(size_limits.second))) {
     cond.Wait(lock);
   }
 }
@@ -17,6 +17,7 @@
 
 #include <map>
 #include <boost/tuple/tuple.hpp>
+#include "include/intarith.h"
 #include "include/memory.h"
 #include "include/buffer.h"
 #include "common/Formatter.h"
@@ -35,6 +36,7 @@ enum {
   l_wbthrottle_ios_wb,
   l_wbthrottle_inodes_dirtied,
   l_wbthrottle_inodes_wb,
+  l_wbthrottle_flush_lat,
   l_wbthrottle_last
 };
 
@@ -62,6 +64,42 @@ class WBThrottle : Thread, public md_config_obs_t {
   uint64_t cur_ios;  /// Currently unflushed IOs
   uint64_t cur_size; /// Currently unflushed bytes
 
+  /**
+   * Adaptive mode: watch how long the backing device takes to flush
+   * and scale the configured limits down when it falls behind (and
+   * back up when it recovers), so a slow spindle backs pressure up to
+   * the op threads early instead of stalling the whole store at the
+   * hard limit.  One WBThrottle exists per FileStore, i.e. per
+   * backing device, so the adjustment is naturally per device.
+   */
+  bool adaptive;
+  double flush_latency_target; ///< seconds; ewma above this shrinks limits
+  double flush_latency_ewma;   ///< decaying average of fdatasync latency
+  double limit_scale;          ///< in (0, 1]; multiplies all limits
+
+  /// account a completed flush; adjusts limit_scale
+  void update_flush_latency(double lat) {
+    assert(lock.is_locked());
+    flush_latency_ewma = flush_latency_ewma * 0.8 + lat * 0.2;
+    if (!adaptive || flush_latency_target <= 0)
+      return;
+    if (flush_latency_ewma > flush_latency_target) {
+      limit_scale = MAX(limit_scale * 0.9, 0.05);
+    } else if (flush_latency_ewma < flush_latency_target / 2 &&
+	       limit_scale < 1.0) {
+      limit_scale = MIN(limit_scale * 1.1, 1.0);
+      cond.Signal();
+    }
+  }
+
+  /// apply limit_scale in adaptive mode
+  uint64_t scaled(uint64_t limit) const {
+    if (!adaptive)
+      return limit;
+    uint64_t l = (uint64_t)(limit * limit_scale);
+    return l ? l : 1;
+  }
+
   /**
    * PendingWB tracks the ios pending on an object.
    */
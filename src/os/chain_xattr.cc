@@ -435,3 +435,94 @@ done:
   free(full_buf);
   return r;
 }
+
+/* returns the chain index encoded in a raw xattr name (0 for the first
+ * chunk; later chunks carry an unescaped "@<id>" suffix) */
+static int get_raw_xattr_id(const char *raw_name)
+{
+  while (*raw_name) {
+    if (*raw_name == '@') {
+      raw_name++;
+      if (*raw_name != '@')
+	return atoi(raw_name);
+    }
+    raw_name++;
+  }
+  return 0;
+}
+
+int chain_fgetxattrs(int fd, const char *prefix,
+		     std::map<std::string, ceph::bufferptr>& aset)
+{
+  int len = sys_flistxattr(fd, 0, 0);
+  if (len < 0)
+    return len;
+
+  size_t total_len = len * 2; // should be enough
+  char *names = (char *)malloc(total_len);
+  if (!names)
+    return -ENOMEM;
+  len = sys_flistxattr(fd, names, total_len);
+  if (len < 0) {
+    free(names);
+    return len;
+  }
+
+  // group chain chunks under their translated name, in chain order
+  std::map<std::string, std::map<int, std::string> > chains;
+  char *p = names;
+  const char *end = names + len;
+  while (p < end) {
+    char name[CHAIN_XATTR_MAX_NAME_LEN * 2 + 16];
+    bool is_first;
+    translate_raw_name(p, name, sizeof(name), &is_first);
+    if (!prefix || !strncmp(name, prefix, strlen(prefix)))
+      chains[name][is_first ? 0 : get_raw_xattr_id(p)] = p;
+    p += strlen(p) + 1;
+  }
+  free(names);
+
+  // chunks are written at most CHAIN_XATTR_MAX_BLOCK_LEN long, so one
+  // read per chunk suffices and no length probes are needed
+  char buf[CHAIN_XATTR_MAX_BLOCK_LEN];
+  for (std::map<std::string, std::map<int, std::string> >::iterator c =
+	 chains.begin();
+       c != chains.end();
+       ++c) {
+    ceph::bufferlist bl;
+    int r = 0;
+    for (std::map<int, std::string>::iterator i = c->second.begin();
+	 i != c->second.end();
+	 ++i) {
+      r = sys_fgetxattr(fd, i->second.c_str(), buf, sizeof(buf));
+      if (r == -ERANGE) {
+	// a foreign writer used larger chunks; fall back to the
+	// probing read for this attr
+	r = chain_fgetxattr(fd, c->first.c_str(), 0, 0);
+	if (r >= 0) {
+	  ceph::bufferptr bp(r);
+	  r = chain_fgetxattr(fd, c->first.c_str(), bp.c_str(), r);
+	  bl.clear();
+	  if (r >= 0) {
+	    bp.set_length(r);
+	    bl.append(bp);
+	  }
+	}
+	break;
+      }
+      if (r < 0)
+	break;
+      bl.append(buf, r);
+    }
+    if (r < 0)
+      return r;
+    if (bl.length() == 0) {
+      aset[c->first] = ceph::bufferptr();
+    } else {
+      if (bl.buffers().size() > 1)
+	bl.rebuild();
+      aset[c->first] = bl.buffers().front();
+    }
+  }
+  return 0;
+}
@@ -5,8 +5,11 @@
 #define __CEPH_OSD_CHAIN_XATTR_H
 
 #include "common/xattr.h"
+#include "include/buffer.h"
 
 #include <errno.h>
+#include <map>
+#include <string>
 
 #define CHAIN_XATTR_MAX_NAME_LEN  128
 #define CHAIN_XATTR_MAX_BLOCK_LEN 2048
@@ -70,4 +73,20 @@ int chain_flistxattr(int fd, char *names, size_t len);
 int chain_removexattr(const char *fn, const char *name);
 int chain_fremovexattr(int fd, const char *name);
 
+/**
+ * fetch every xattr of an fd in one pass
+ *
+ * One listing enumerates all raw names (including chain chunks), then
+ * each chunk is read with exactly one fgetxattr -- no length probes --
+ * since chunks are written at most CHAIN_XATTR_MAX_BLOCK_LEN long.
+ * Chains are reassembled under their translated name.
+ *
+ * @param fd file descriptor
+ * @param prefix if non-NULL, only fetch attrs whose name starts with it
+ * @param aset out map of name to value
+ * @returns 0 on success, negative error code on failure
+ */
+int chain_fgetxattrs(int fd, const char *prefix,
+		     std::map<std::string, ceph::bufferptr>& aset);
+
 #endif
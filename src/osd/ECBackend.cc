@@ -1568,12 +1568,15 @@ struct CallClientContexts :
   ECBackend::ClientAsyncReadStatus *status;
   list<pair<pair<uint64_t, uint64_t>,
 	    pair<bufferlist*, Context*> > > to_read;
+  set<int> want_to_read;
   CallClientContexts(
     ECBackend *ec,
     ECBackend::ClientAsyncReadStatus *status,
     const list<pair<pair<uint64_t, uint64_t>,
-		    pair<bufferlist*, Context*> > > &to_read)
-    : ec(ec), status(status), to_read(to_read) {}
+		    pair<bufferlist*, Context*> > > &to_read,
+    const set<int> &want_to_read)
+    : ec(ec), status(status), to_read(to_read),
+      want_to_read(want_to_read) {}
   void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) {
     ECBackend::read_result_t &res = in.second;
     assert(res.returned.size() == to_read.size());
@@ -1595,11 +1598,29 @@ struct CallClientContexts :
 	   ++j) {
 	to_decode[j->first.shard].claim(j->second);
       }
-      ECUtil::decode(
-	ec->sinfo,
-	ec->ec_impl,
-	to_decode,
-	&bl);
+      // if every wanted data chunk came back we can stitch the
+      // stripes together directly; otherwise reconstruct
+      bool need_decode = false;
+      for (set<int>::const_iterator w = want_to_read.begin();
+	   w != want_to_read.end();
+	   ++w) {
+	if (!to_decode.count(*w)) {
+	  need_decode = true;
+	  break;
+	}
+      }
+      if (need_decode) {
+	ECUtil::decode(
+	  ec->sinfo,
+	  ec->ec_impl,
+	  to_decode,
+	  &bl);
+      } else {
+	ECUtil::assemble(
+	  ec->sinfo,
+	  to_decode,
+	  &bl);
+      }
       assert(i->second.second);
       assert(i->second.first);
       i->second.first->substr_of(
@@ -1639,8 +1660,6 @@ void ECBackend::objects_read_async(
   Context *on_complete)
 {
   in_progress_client_reads.push_back(ClientAsyncReadStatus(on_complete));
-  CallClientContexts *c = new CallClientContexts(
-    this, &(in_progress_client_reads.back()), to_read);
   list<pair<uint64_t, uint64_t> > offsets;
   for (list<pair<pair<uint64_t, uint64_t>,
 		 pair<bufferlist*, Context*> > >::const_iterator i =
@@ -1651,10 +1670,35 @@ void ECBackend::objects_read_async(
       sinfo.offset_len_to_stripe_bounds(i->first));
   }
 
+  // only ask for the data chunks the requested ranges actually touch;
+  // a small read inside one chunk then hits a single shard
   set<int> want_to_read;
-  for (int i = 0; i < (int)ec_impl->get_data_chunk_count(); ++i) {
-    want_to_read.insert(i);
+  unsigned data_chunk_count = ec_impl->get_data_chunk_count();
+  uint64_t chunk_size = sinfo.get_chunk_size();
+  uint64_t stripe_width = sinfo.get_stripe_width();
+  for (list<pair<pair<uint64_t, uint64_t>,
+		 pair<bufferlist*, Context*> > >::const_iterator i =
+	 to_read.begin();
+       i != to_read.end() && want_to_read.size() < data_chunk_count;
+       ++i) {
+    uint64_t off = i->first.first;
+    uint64_t len = i->first.second;
+    if (len == 0)
+      continue;
+    for (uint64_t b = off - (off % chunk_size); b < off + len;
+	 b += chunk_size) {
+      want_to_read.insert((b % stripe_width) / chunk_size);
+      if (want_to_read.size() == data_chunk_count)
+	break;
+    }
+  }
+  if (want_to_read.empty()) {
+    // zero-length reads still need a shard to report the object size
+    want_to_read.insert(0);
   }
+
+  CallClientContexts *c = new CallClientContexts(
+    this, &(in_progress_client_reads.back()), to_read, want_to_read);
   set<pg_shard_t> shards;
   int r = get_min_avail_to_read_shards(
     hoid,
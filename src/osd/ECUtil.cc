@@ -97,6 +97,46 @@ int ECUtil::decode(
   return 0;
 }
 
+int ECUtil::assemble(
+  const stripe_info_t &sinfo,
+  map<int, bufferlist> &chunks,
+  bufferlist *out) {
+
+  assert(chunks.size());
+  uint64_t total_chunk_size = chunks.begin()->second.length();
+  int k = sinfo.get_stripe_width() / sinfo.get_chunk_size();
+
+  assert(total_chunk_size % sinfo.get_chunk_size() == 0);
+  assert(out);
+  assert(out->length() == 0);
+
+  for (map<int, bufferlist>::iterator i = chunks.begin();
+       i != chunks.end();
+       ++i) {
+    assert(i->second.length() == total_chunk_size);
+  }
+
+  if (total_chunk_size == 0)
+    return 0;
+
+  bufferptr zeros(buffer::create(sinfo.get_chunk_size()));
+  zeros.zero();
+
+  for (uint64_t i = 0; i < total_chunk_size; i += sinfo.get_chunk_size()) {
+    for (int j = 0; j < k; ++j) {
+      map<int, bufferlist>::iterator chunk = chunks.find(j);
+      if (chunk != chunks.end()) {
+	bufferlist bl;
+	bl.substr_of(chunk->second, i, sinfo.get_chunk_size());
+	out->claim_append(bl);
+      } else {
+	out->append(zeros);
+      }
+    }
+  }
+  return 0;
+}
+
 int ECUtil::encode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
@@ -97,6 +97,17 @@ int decode(
   map<int, bufferlist> &to_decode,
   map<int, bufferlist*> &out);
 
+/**
+ * Reassemble the logical stripes from a subset of the data chunks
+ * without invoking the erasure code.  Stripe regions belonging to
+ * chunks that are not present are zero filled, so the caller must
+ * only use the byte ranges covered by the chunks passed in.
+ */
+int assemble(
+  const stripe_info_t &sinfo,
+  map<int, bufferlist> &chunks,
+  bufferlist *out);
+
 int encode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
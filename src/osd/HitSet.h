@@ -37,7 +37,8 @@ public:
     TYPE_NONE = 0,
     TYPE_EXPLICIT_HASH = 1,
     TYPE_EXPLICIT_OBJECT = 2,
-    TYPE_BLOOM = 3
+    TYPE_BLOOM = 3,
+    TYPE_BLOCKED_BLOOM = 4
   } impl_type_t;
 
   static const char *get_type_name(impl_type_t t) {
@@ -46,6 +47,7 @@ public:
     case TYPE_EXPLICIT_HASH: return "explicit_hash";
     case TYPE_EXPLICIT_OBJECT: return "explicit_object";
     case TYPE_BLOOM: return "bloom";
+    case TYPE_BLOCKED_BLOOM: return "blocked_bloom";
     default: return "???";
     }
   }
@@ -474,4 +476,98 @@ public:
 };
 WRITE_CLASS_ENCODER(BloomHitSet)
 
+/**
+ * as BloomHitSet, but all probes for an object stay within one cache
+ * line of the filter, so the agent pays at most one miss per HitSet
+ * it consults instead of one per hash
+ */
+class BlockedBloomHitSet : public HitSet::Impl {
+  blocked_bloom_filter bloom;
+
+public:
+  HitSet::impl_type_t get_type() const {
+    return HitSet::TYPE_BLOCKED_BLOOM;
+  }
+
+  /// same knobs as the bloom params, different resulting impl
+  class Params : public BloomHitSet::Params {
+  public:
+    virtual HitSet::impl_type_t get_type() const {
+      return HitSet::TYPE_BLOCKED_BLOOM;
+    }
+    virtual HitSet::Impl *get_new_impl() const {
+      return new BlockedBloomHitSet;
+    }
+    static void generate_test_instances(list<Params*>& o) {
+      o.push_back(new Params);
+      o.push_back(new Params);
+      (*o.rbegin())->fpp_micro = 123456;
+      (*o.rbegin())->target_size = 300;
+      (*o.rbegin())->seed = 99;
+    }
+  };
+
+  BlockedBloomHitSet() {}
+  BlockedBloomHitSet(unsigned inserts, double fpp, int seed)
+    : bloom(inserts, fpp, seed)
+  {}
+  BlockedBloomHitSet(const BlockedBloomHitSet::Params *p)
+    : bloom(p->target_size, p->get_fpp(), p->seed)
+  {}
+
+  BlockedBloomHitSet(const BlockedBloomHitSet &o) {
+    bufferlist bl;
+    o.encode(bl);
+    bufferlist::iterator bli = bl.begin();
+    this->decode(bli);
+  }
+
+  HitSet::Impl *clone() const {
+    return new BlockedBloomHitSet(*this);
+  }
+
+  bool is_full() const {
+    return bloom.is_full();
+  }
+
+  void insert(const hobject_t& o) {
+    bloom.insert(o.hash);
+  }
+  bool contains(const hobject_t& o) const {
+    return bloom.contains(o.hash);
+  }
+  unsigned insert_count() const {
+    return bloom.element_count();
+  }
+  unsigned approx_unique_insert_count() const {
+    return bloom.approx_unique_element_count();
+  }
+  // no seal(): the block layout cannot be folded the way
+  // compressible_bloom_filter shrinks its table
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(bloom, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &bl) {
+    DECODE_START(1, bl);
+    ::decode(bloom, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const {
+    f->open_object_section("blocked_bloom_filter");
+    bloom.dump(f);
+    f->close_section();
+  }
+  static void generate_test_instances(list<BlockedBloomHitSet*>& o) {
+    o.push_back(new BlockedBloomHitSet);
+    o.push_back(new BlockedBloomHitSet(10, .1, 1));
+    o.back()->insert(hobject_t());
+    o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
+    o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
+  }
+};
+WRITE_CLASS_ENCODER(BlockedBloomHitSet)
+
 #endif
@@ -181,7 +181,6 @@ OSDService::OSDService(OSD *osd) :
   logger(osd->logger),
   recoverystate_perf(osd->recoverystate_perf),
   monc(osd->monc),
-  op_wq(osd->op_wq),
   peering_wq(osd->peering_wq),
   recovery_wq(osd->recovery_wq),
   snap_trim_wq(osd->snap_trim_wq),
@@ -202,10 +201,11 @@ OSDService::OSDService(OSD *osd) :
   agent_valid_iterator(false),
   agent_ops(0),
   agent_active(true),
-  agent_thread(this),
   agent_stop_flag(false),
   agent_timer_lock("OSD::agent_timer_lock"),
   agent_timer(osd->client_messenger->cct, agent_timer_lock),
+  read_cache(cct->_conf->osd_read_cache_size,
+	     cct->_conf->osd_read_cache_shards),
   objecter_lock("OSD::objecter_lock"),
   objecter_timer(osd->client_messenger->cct, objecter_lock),
   objecter(new Objecter(osd->client_messenger->cct, osd->objecter_messenger, osd->monc, &objecter_osdmap,
@@ -217,6 +217,8 @@ OSDService::OSDService(OSD *osd) :
   next_notif_id(0),
   backfill_request_lock("OSD::backfill_request_lock"),
   backfill_request_timer(cct, backfill_request_lock, false),
+  pool_throttle_lock("OSD::pool_throttle_lock"),
+  pool_throttle_timer(cct, pool_throttle_lock, false),
   last_tid(0),
   tid_lock("OSDService::tid_lock"),
   reserver_finisher(cct),
@@ -227,6 +229,9 @@ OSDService::OSDService(OSD *osd) :
   map_cache(cct->_conf->osd_map_cache_size),
   map_bl_cache(cct->_conf->osd_map_cache_size),
   map_bl_inc_cache(cct->_conf->osd_map_cache_size),
+  mem_budget(cct),
+  avg_map_bytes(0),
+  map_cache_budget_client(this),
   in_progress_split_lock("OSDService::in_progress_split_lock"),
   full_status_lock("OSDService::full_status_lock"),
   cur_state(NONE),
@@ -442,6 +447,10 @@ void OSDService::shutdown()
     Mutex::Locker l(backfill_request_lock);
     backfill_request_timer.shutdown();
   }
+  {
+    Mutex::Locker l(pool_throttle_lock);
+    pool_throttle_timer.shutdown();
+  }
   {
     Mutex::Locker l(agent_timer_lock);
     agent_timer.shutdown();
@@ -464,7 +473,53 @@ void OSDService::init()
   watch_timer.init();
   agent_timer.init();
 
-  agent_thread.create();
+  mem_budget.register_client(&map_cache_budget_client);
+
+  int threads = MAX(1, cct->_conf->osd_agent_threads);
+  for (int i = 0; i < threads; ++i) {
+    AgentThread *t = new AgentThread(this);
+    t->create();
+    agent_threads.push_back(t);
+  }
+}
+
+bool OSDService::pool_throttle_admit(int64_t poolid, const pg_pool_t &pool,
+				     uint64_t bytes, utime_t *delay)
+{
+  Mutex::Locker l(pool_throttle_lock);
+  PoolThrottle &t = pool_throttles[poolid];
+  utime_t now = ceph_clock_now(cct);
+
+  // refill, capping the burst at one second's worth of tokens
+  if (t.last_refill != utime_t()) {
+    double dt = now - t.last_refill;
+    if (dt > 0) {
+      t.iops_tokens = MIN(t.iops_tokens + dt * pool.rate_limit_iops,
+			  (double)pool.rate_limit_iops);
+      t.bps_tokens = MIN(t.bps_tokens + dt * pool.rate_limit_bps,
+			 (double)pool.rate_limit_bps);
+    }
+  }
+  t.last_refill = now;
+
+  // admit whenever the buckets are not in debt, letting a single op
+  // overdraw them; that way an op larger than one second's budget
+  // still makes progress instead of stalling forever
+  double wait = 0;
+  if (pool.rate_limit_iops && t.iops_tokens < 0)
+    wait = MAX(wait, -t.iops_tokens / pool.rate_limit_iops);
+  if (pool.rate_limit_bps && t.bps_tokens < 0)
+    wait = MAX(wait, -t.bps_tokens / pool.rate_limit_bps);
+  if (wait > 0) {
+    delay->set_from_double(wait);
+    return false;
+  }
+
+  if (pool.rate_limit_iops)
+    t.iops_tokens -= 1;
+  if (pool.rate_limit_bps)
+    t.bps_tokens -= bytes;
+  return true;
 }
 
 void OSDService::activate_map()
@@ -520,6 +575,8 @@ void OSDService::agent_entry()
       agent_valid_iterator = true;
     }
     PGRef pg = *agent_queue_pos;
+    ++agent_queue_pos;  // advance under the lock so other workers
+			// pick different pgs
     int max = g_conf->osd_agent_max_ops - agent_ops;
     agent_lock.Unlock();
     if (!pg->agent_work(max)) {
@@ -557,7 +614,11 @@ void OSDService::agent_stop()
     agent_stop_flag = true;
     agent_cond.Signal();
   }
-  agent_thread.join();
+  while (!agent_threads.empty()) {
+    agent_threads.back()->join();
+    delete agent_threads.back();
+    agent_threads.pop_back();
+  }
 }
 
 
@@ -937,9 +998,12 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
   heartbeat_thread(this),
   heartbeat_dispatcher(this),
   stat_lock("OSD::stat_lock"),
+  backfill_reservation_max(cct_->_conf->osd_max_backfills),
   finished_lock("OSD::finished_lock"),
-  op_tracker(cct, cct->_conf->osd_enable_op_tracker),
+  op_tracker(cct, cct->_conf->osd_enable_op_tracker,
+	     cct->_conf->osd_num_op_tracker_shard),
   test_ops_hook(NULL),
+  op_capture(cct_),
   op_wq(this, cct->_conf->osd_op_thread_timeout, &op_tp),
   peering_wq(this, cct->_conf->osd_op_thread_timeout, &op_tp),
   map_lock("OSD::map_lock"),
@@ -970,10 +1034,25 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
                                          cct->_conf->osd_op_log_threshold);
   op_tracker.set_history_size_and_duration(cct->_conf->osd_op_history_size,
                                            cct->_conf->osd_op_history_duration);
+
+  int num_shards = cct->_conf->osd_op_num_shards;
+  for (int i = 0; i < num_shards; ++i) {
+    char tp_name[32];
+    snprintf(tp_name, sizeof(tp_name), "OSD::op_shard_tp_%d", i);
+    ThreadPool *tp = new ThreadPool(
+      cct, tp_name, cct->_conf->osd_op_num_threads_per_shard);
+    op_shard_tps.push_back(tp);
+    op_shard_wqs.push_back(
+      new OpWQ(this, cct->_conf->osd_op_thread_timeout, tp));
+  }
 }
 
 OSD::~OSD()
 {
+  for (unsigned i = 0; i < op_shard_wqs.size(); ++i)
+    delete op_shard_wqs[i];
+  for (unsigned i = 0; i < op_shard_tps.size(); ++i)
+    delete op_shard_tps[i];
   delete authorize_handler_cluster_registry;
   delete authorize_handler_service_registry;
   delete class_handler;
@@ -1050,10 +1129,75 @@ bool OSD::asok_command(string command, cmdmap_t& cmdmap, string format,
     op_tracker.dump_ops_in_flight(f);
   } else if (command == "dump_historic_ops") {
     op_tracker.dump_historic_ops(f);
+  } else if (command == "dump_historic_ops_by_duration") {
+    int64_t num = 10;
+    cmd_getval(cct, cmdmap, "num", num);
+    op_tracker.dump_historic_ops_by_duration(f, num);
+  } else if (command == "dump_traced_ops") {
+    op_tracker.dump_traced_ops(f);
+  } else if (command == "dump_op_stage_latencies") {
+    op_tracker.dump_stage_latencies(f);
+  } else if (command == "dump_memory_budget") {
+    service.mem_budget.dump(f);
   } else if (command == "dump_op_pq_state") {
     f->open_object_section("pq");
     op_wq.dump(f);
     f->close_section();
+    for (unsigned i = 0; i < op_shard_wqs.size(); ++i) {
+      char sec[32];
+      snprintf(sec, sizeof(sec), "pq_shard_%d", i);
+      f->open_object_section(sec);
+      op_shard_wqs[i]->dump(f);
+      f->close_section();
+    }
+  } else if (command == "dump_scrubs") {
+    f->open_object_section("scrubs");
+    {
+      Mutex::Locker l(service.sched_scrub_lock);
+      f->dump_int("scrubs_pending", service.scrubs_pending);
+      f->dump_int("scrubs_active", service.scrubs_active);
+    }
+    f->open_array_section("pgs");
+    {
+      Mutex::Locker l(osd_lock);
+      RWLock::RLocker l2(pg_map_lock);
+      for (ceph::unordered_map<spg_t,PG*>::iterator it = pg_map.begin();
+	   it != pg_map.end();
+	   ++it) {
+	PG *pg = it->second;
+	pg->lock();
+	if (pg->scrubber.active) {
+	  f->open_object_section("pg");
+	  f->dump_stream("pgid") << pg->info.pgid;
+	  f->dump_string("state",
+			 PG::Scrubber::state_string(pg->scrubber.state));
+	  f->dump_int("deep", pg->scrubber.deep);
+	  f->dump_stream("chunk_start") << pg->scrubber.start;
+	  f->dump_int("shallow_errors", pg->scrubber.shallow_errors);
+	  f->dump_int("deep_errors", pg->scrubber.deep_errors);
+	  f->close_section();
+	}
+	pg->unlock();
+      }
+    }
+    f->close_section();
+    f->close_section();
+  } else if (command == "dump_snap_trims") {
+    f->open_array_section("pgs");
+    {
+      Mutex::Locker l(osd_lock);
+      RWLock::RLocker l2(pg_map_lock);
+      for (ceph::unordered_map<spg_t,PG*>::iterator it = pg_map.begin();
+	   it != pg_map.end();
+	   ++it) {
+	PG *pg = it->second;
+	pg->lock();
+	if (!pg->snap_trimq.empty())
+	  pg->dump_snap_trimmer(f);
+	pg->unlock();
+      }
+    }
+    f->close_section();
   } else if (command == "dump_blacklist") {
     list<pair<entity_addr_t,utime_t> > bl;
     OSDMapRef curmap = service.get_osdmap();
@@ -1147,6 +1291,7 @@ int OSD::init()
 
   tick_timer.init();
   service.backfill_request_timer.init();
+  service.pool_throttle_timer.init();
 
   // mount.
   dout(2) << "mounting " << dev_path << " "
@@ -1281,6 +1426,8 @@ int OSD::init()
   monc->set_log_client(&clog);
 
   op_tp.start();
+  for (unsigned i = 0; i < op_shard_tps.size(); ++i)
+    op_shard_tps[i]->start();
   recovery_tp.start();
   disk_tp.start();
   command_tp.start();
@@ -1289,9 +1436,11 @@ int OSD::init()
   heartbeat_thread.create();
 
   // tick
-  tick_timer.add_event_after(cct->_conf->osd_heartbeat_interval, new C_Tick(this));
+  tick_timer.add_event_after(cct->_conf->osd_heartbeat_interval, new C_Tick(this),
+			     true /* coarse */);
 
   service.init();
+  store->register_caches(&service.mem_budget);
   service.publish_map(osdmap);
   service.publish_superblock(superblock);
 
@@ -1317,6 +1466,15 @@ int OSD::init()
   consume_map();
   peering_wq.drain();
 
+  if (!cct->_conf->osd_op_capture_file.empty()) {
+    r = op_capture.start(cct->_conf->osd_op_capture_file,
+			 cct->_conf->osd_op_capture_every);
+    if (r < 0)
+      derr << "OSD::init: unable to open op capture file "
+	   << cct->_conf->osd_op_capture_file << ": "
+	   << cpp_strerror(r) << dendl;
+  }
+
   dout(0) << "done with init, starting boot process" << dendl;
   set_state(STATE_BOOTING);
   start_boot();
@@ -1351,10 +1509,36 @@ void OSD::final_init()
 				     asok_hook,
 				     "show slowest recent ops");
   assert(r == 0);
+  r = admin_socket->register_command("dump_historic_ops_by_duration",
+				     "dump_historic_ops_by_duration "
+				     "name=num,type=CephInt,req=false",
+				     asok_hook,
+				     "show the N slowest recent ops, sorted by duration");
+  assert(r == 0);
+  r = admin_socket->register_command("dump_traced_ops", "dump_traced_ops",
+				     asok_hook,
+				     "show recent ops flagged for tracing");
+  assert(r == 0);
+  r = admin_socket->register_command("dump_op_stage_latencies",
+				     "dump_op_stage_latencies", asok_hook,
+				     "show aggregate latency per op tracker event");
+  assert(r == 0);
+  r = admin_socket->register_command("dump_memory_budget",
+				     "dump_memory_budget", asok_hook,
+				     "show cache memory usage and grants");
+  assert(r == 0);
   r = admin_socket->register_command("dump_op_pq_state", "dump_op_pq_state",
 				     asok_hook,
 				     "dump op priority queue state");
   assert(r == 0);
+  r = admin_socket->register_command("dump_scrubs", "dump_scrubs",
+				     asok_hook,
+				     "show progress of in-flight scrubs");
+  assert(r == 0);
+  r = admin_socket->register_command("dump_snap_trims", "dump_snap_trims",
+				     asok_hook,
+				     "show progress of in-flight snap trims");
+  assert(r == 0);
   r = admin_socket->register_command("dump_blacklist", "dump_blacklist",
 				     asok_hook,
 				     "dump blacklisted clients and times");
@@ -1500,6 +1684,8 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(l_osd_map, "map_messages");           // osdmap messages
   osd_plb.add_u64_counter(l_osd_mape, "map_message_epochs");         // osdmap epochs
   osd_plb.add_u64_counter(l_osd_mape_dup, "map_message_epoch_dups"); // dup osdmap epochs
+  osd_plb.add_u64(l_osd_pg_map_hit, "pg_mapping_cache_hits");   // memoized pg mappings served
+  osd_plb.add_u64(l_osd_pg_map_miss, "pg_mapping_cache_misses"); // pg mappings computed
   osd_plb.add_u64_counter(l_osd_waiting_for_map,
 			  "messages_delayed_for_map"); // dup osdmap epochs
 
@@ -1525,6 +1711,12 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(l_osd_agent_flush, "agent_flush");
   osd_plb.add_u64_counter(l_osd_agent_evict, "agent_evict");
 
+  osd_plb.add_u64_counter(l_osd_pool_throttle, "pool_throttle"); // ops delayed by a pool rate limit
+  osd_plb.add_time_avg(l_osd_pool_throttle_lat, "pool_throttle_lat"); // delay imposed by pool rate limits
+
+  osd_plb.add_u64_counter(l_osd_rdcache_hit, "read_cache_hit");
+  osd_plb.add_u64_counter(l_osd_rdcache_miss, "read_cache_miss");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -1581,6 +1773,8 @@ void OSD::suicide(int exitcode)
 
   derr << " pausing thread pools" << dendl;
   op_tp.pause();
+  for (unsigned i = 0; i < op_shard_tps.size(); ++i)
+    op_shard_tps[i]->pause();
   disk_tp.pause();
   recovery_tp.pause();
   command_tp.pause();
@@ -1631,6 +1825,8 @@ int OSD::shutdown()
   
   // finish ops
   op_wq.drain(); // should already be empty except for lagard PGs
+  for (unsigned i = 0; i < op_shard_wqs.size(); ++i)
+    op_shard_wqs[i]->drain();
   {
     Mutex::Locker l(finished_lock);
     finished.clear(); // zap waiters (bleh, this is messy)
@@ -1641,7 +1837,13 @@ int OSD::shutdown()
   cct->get_admin_socket()->unregister_command("flush_journal");
   cct->get_admin_socket()->unregister_command("dump_ops_in_flight");
   cct->get_admin_socket()->unregister_command("dump_historic_ops");
+  cct->get_admin_socket()->unregister_command("dump_historic_ops_by_duration");
+  cct->get_admin_socket()->unregister_command("dump_traced_ops");
+  cct->get_admin_socket()->unregister_command("dump_op_stage_latencies");
+  cct->get_admin_socket()->unregister_command("dump_memory_budget");
   cct->get_admin_socket()->unregister_command("dump_op_pq_state");
+  cct->get_admin_socket()->unregister_command("dump_scrubs");
+  cct->get_admin_socket()->unregister_command("dump_snap_trims");
   cct->get_admin_socket()->unregister_command("dump_blacklist");
   cct->get_admin_socket()->unregister_command("dump_watchers");
   delete asok_hook;
@@ -1671,6 +1873,10 @@ int OSD::shutdown()
 
   op_tp.drain();
   op_tp.stop();
+  for (unsigned i = 0; i < op_shard_tps.size(); ++i) {
+    op_shard_tps[i]->drain();
+    op_shard_tps[i]->stop();
+  }
   dout(10) << "op tp stopped" << dendl;
 
   command_tp.drain();
@@ -1748,6 +1954,7 @@ int OSD::shutdown()
   osdmap = OSDMapRef();
   service.shutdown();
   op_tracker.on_shutdown();
+  op_capture.stop();
 
   class_handler->shutdown();
   client_messenger->shutdown();
@@ -2074,6 +2281,44 @@ PG *OSD::_lookup_lock_pg_with_map_lock_held(spg_t pgid)
   return pg;
 }
 
+/// per-pg work carried between the phases of OSD::load_pgs
+struct pg_load_item {
+  PG *pg;
+  bufferlist info_bl;
+  interval_set<snapid_t> snaps;
+  pg_load_item() : pg(NULL) {}
+};
+
+/**
+ * worker thread for the parallel phase of OSD::load_pgs: pulls pgs off
+ * a shared list and reads their on-disk state.  The reads for distinct
+ * pgs are independent, so several readers can scan concurrently.
+ */
+struct PGLoadReader : public Thread {
+  ObjectStore *store;
+  vector<pg_load_item> *items;
+  Mutex *lock;
+  unsigned *pos;
+  PGLoadReader(ObjectStore *s, vector<pg_load_item> *i, Mutex *l, unsigned *p)
+    : store(s), items(i), lock(l), pos(p) {}
+  void *entry() {
+    while (true) {
+      unsigned i;
+      {
+	Mutex::Locker locker(*lock);
+	if (*pos >= items->size())
+	  break;
+	i = (*pos)++;
+      }
+      PG *pg = (*items)[i].pg;
+      pg->lock();
+      pg->read_state(store, (*items)[i].info_bl);
+      pg->unlock();
+    }
+    return NULL;
+  }
+};
+
 void OSD::load_pgs()
 {
   assert(osd_lock.is_locked());
@@ -2120,7 +2365,9 @@ void OSD::load_pgs()
     dout(10) << "load_pgs ignoring unrecognized " << *it << dendl;
   }
 
-  bool has_upgraded = false;
+  // open all pgs and peek at their map epochs
+  vector<pg_load_item> items;
+  items.reserve(pgs.size());
   for (map<spg_t, interval_set<snapid_t> >::iterator i = pgs.begin();
        i != pgs.end();
        ++i) {
@@ -2145,13 +2392,54 @@ void OSD::load_pgs()
     }
 
     dout(10) << "pgid " << pgid << " coll " << coll_t(pgid) << dendl;
-    bufferlist bl;
-    epoch_t map_epoch = PG::peek_map_epoch(store, coll_t(pgid), service.infos_oid, &bl);
-
-    PG *pg = _open_lock_pg(map_epoch == 0 ? osdmap : service.get_map(map_epoch), pgid);
+    items.push_back(pg_load_item());
+    pg_load_item &item = items.back();
+    epoch_t map_epoch = PG::peek_map_epoch(store, coll_t(pgid),
+					   service.infos_oid, &item.info_bl);
+    item.pg = _open_lock_pg(
+      map_epoch == 0 ? osdmap : service.get_map(map_epoch), pgid);
+    item.snaps = i->second;
+    item.pg->unlock();
+  }
+
+  // read pg state and logs; this is the expensive part, and the reads
+  // for distinct pgs are independent, so fan it out if configured
+  int readers = cct->_conf->osd_pg_load_threads;
+  if (readers > 1 && items.size() > 1) {
+    Mutex pos_lock("OSD::load_pgs::pos_lock");
+    unsigned pos = 0;
+    list<PGLoadReader*> threads;
+    if ((unsigned)readers > items.size())
+      readers = items.size();
+    for (int i = 0; i < readers; ++i) {
+      PGLoadReader *t = new PGLoadReader(store, &items, &pos_lock, &pos);
+      t->create();
+      threads.push_back(t);
+    }
+    for (list<PGLoadReader*>::iterator p = threads.begin();
+	 p != threads.end();
+	 ++p) {
+      (*p)->join();
+      delete *p;
+    }
+  } else {
+    for (vector<pg_load_item>::iterator i = items.begin();
+	 i != items.end();
+	 ++i) {
+      i->pg->lock();
+      i->pg->read_state(store, i->info_bl);
+      i->pg->unlock();
+    }
+  }
 
-    // read pg state, log
-    pg->read_state(store, bl);
+  // fix up and activate what we loaded
+  bool has_upgraded = false;
+  for (vector<pg_load_item>::iterator i = items.begin();
+       i != items.end();
+       ++i) {
+    PG *pg = i->pg;
+    pg->lock();
+    spg_t pgid = pg->info.pgid;
 
     if (pg->must_upgrade()) {
       if (!has_upgraded) {
@@ -2160,11 +2448,11 @@ void OSD::load_pgs()
       }
       dout(10) << "PG " << pg->info.pgid
 	       << " must upgrade..." << dendl;
-      pg->upgrade(store, i->second);
-    } else if (!i->second.empty()) {
+      pg->upgrade(store, i->snaps);
+    } else if (!i->snaps.empty()) {
       // handle upgrade bug
-      for (interval_set<snapid_t>::iterator j = i->second.begin();
-	   j != i->second.end();
+      for (interval_set<snapid_t>::iterator j = i->snaps.begin();
+	   j != i->snaps.end();
 	   ++j) {
 	for (snapid_t k = j.get_start();
 	     k != j.get_start() + j.get_len();
@@ -2784,9 +3072,39 @@ void OSD::update_osd_stat()
 
   op_tracker.get_age_ms_histogram(&osd_stat.op_queue_age_hist);
 
+  maybe_scale_backfill_reservations();
+
   dout(20) << "update_osd_stat " << osd_stat << dendl;
 }
 
+void OSD::maybe_scale_backfill_reservations()
+{
+  if (!cct->_conf->osd_backfill_reservation_adaptive)
+    return;
+
+  unsigned limit = cct->_conf->osd_max_backfills;
+  unsigned cur = MIN(backfill_reservation_max, limit);
+  uint32_t lat = store->get_cur_stats().filestore_apply_latency;
+  uint32_t high = cct->_conf->osd_backfill_apply_latency_high;
+
+  // shed grants one at a time while the device is saturated, and grow
+  // back just as gradually once it recovers, so a brief stall does not
+  // make the limit oscillate
+  if (lat > high && cur > 1)
+    --cur;
+  else if (lat < high / 2 && cur < limit)
+    ++cur;
+
+  if (cur != backfill_reservation_max) {
+    dout(10) << "maybe_scale_backfill_reservations apply latency " << lat
+	     << "ms -> max backfills " << cur << " (limit " << limit << ")"
+	     << dendl;
+    backfill_reservation_max = cur;
+    service.local_reserver.set_max(cur);
+    service.remote_reserver.set_max(cur);
+  }
+}
+
 void OSD::_add_heartbeat_peer(int p)
 {
   if (p == whoami)
@@ -2982,39 +3300,47 @@ void OSD::handle_osd_ping(MOSDPing *m)
 
   int from = m->get_source().num();
 
-  heartbeat_lock.Lock();
   if (is_stopping()) {
-    heartbeat_lock.Unlock();
     m->put();
     return;
   }
 
   OSDMapRef curmap = service.get_osdmap();
-  
+
+  // note: only take heartbeat_lock where we actually touch shared
+  // heartbeat state; replying to pings must not wait behind a
+  // heartbeat()/heartbeat_check() pass or a load spike here makes our
+  // peers report us dead.
   switch (m->op) {
 
   case MOSDPing::PING:
     {
       if (cct->_conf->osd_debug_drop_ping_probability > 0) {
-	if (debug_heartbeat_drops_remaining.count(from)) {
-	  if (debug_heartbeat_drops_remaining[from] == 0) {
-	    debug_heartbeat_drops_remaining.erase(from);
-	  } else {
-	    debug_heartbeat_drops_remaining[from]--;
+	bool drop = false;
+	{
+	  Mutex::Locker l(heartbeat_lock);
+	  if (debug_heartbeat_drops_remaining.count(from)) {
+	    if (debug_heartbeat_drops_remaining[from] == 0) {
+	      debug_heartbeat_drops_remaining.erase(from);
+	    } else {
+	      debug_heartbeat_drops_remaining[from]--;
+	      drop = true;
+	      dout(5) << "Dropping heartbeat from " << from
+		      << ", " << debug_heartbeat_drops_remaining[from]
+		      << " remaining to drop" << dendl;
+	    }
+	  } else if (cct->_conf->osd_debug_drop_ping_probability >
+		     ((((double)(rand()%100))/100.0))) {
+	    debug_heartbeat_drops_remaining[from] =
+	      cct->_conf->osd_debug_drop_ping_duration;
+	    drop = true;
 	    dout(5) << "Dropping heartbeat from " << from
 		    << ", " << debug_heartbeat_drops_remaining[from]
 		    << " remaining to drop" << dendl;
-	    break;
 	  }
-	} else if (cct->_conf->osd_debug_drop_ping_probability >
-	           ((((double)(rand()%100))/100.0))) {
-	  debug_heartbeat_drops_remaining[from] =
-	    cct->_conf->osd_debug_drop_ping_duration;
-	  dout(5) << "Dropping heartbeat from " << from
-		  << ", " << debug_heartbeat_drops_remaining[from]
-		  << " remaining to drop" << dendl;
-	  break;
 	}
+	if (drop)
+	  break;
       }
 
       if (!cct->get_heartbeat_map()->is_healthy()) {
@@ -3050,27 +3376,34 @@ void OSD::handle_osd_ping(MOSDPing *m)
 
   case MOSDPing::PING_REPLY:
     {
-      map<int,HeartbeatInfo>::iterator i = heartbeat_peers.find(from);
-      if (i != heartbeat_peers.end()) {
-	if (m->get_connection() == i->second.con_back) {
-	  dout(25) << "handle_osd_ping got reply from osd." << from
-		   << " first_rx " << i->second.first_tx
-		   << " last_tx " << i->second.last_tx
-		   << " last_rx_back " << i->second.last_rx_back << " -> " << m->stamp
-		   << " last_rx_front " << i->second.last_rx_front
-		   << dendl;
-	  i->second.last_rx_back = m->stamp;
-	  // if there is no front con, set both stamps.
-	  if (i->second.con_front == NULL)
+      bool healthy = false;
+      {
+	Mutex::Locker l(heartbeat_lock);
+	map<int,HeartbeatInfo>::iterator i = heartbeat_peers.find(from);
+	if (i != heartbeat_peers.end()) {
+	  if (m->get_connection() == i->second.con_back) {
+	    dout(25) << "handle_osd_ping got reply from osd." << from
+		     << " first_rx " << i->second.first_tx
+		     << " last_tx " << i->second.last_tx
+		     << " last_rx_back " << i->second.last_rx_back << " -> " << m->stamp
+		     << " last_rx_front " << i->second.last_rx_front
+		     << dendl;
+	    i->second.last_rx_back = m->stamp;
+	    // if there is no front con, set both stamps.
+	    if (i->second.con_front == NULL)
+	      i->second.last_rx_front = m->stamp;
+	  } else if (m->get_connection() == i->second.con_front) {
+	    dout(25) << "handle_osd_ping got reply from osd." << from
+		     << " first_rx " << i->second.first_tx
+		     << " last_tx " << i->second.last_tx
+		     << " last_rx_back " << i->second.last_rx_back
+		     << " last_rx_front " << i->second.last_rx_front << " -> " << m->stamp
+		     << dendl;
 	    i->second.last_rx_front = m->stamp;
-	} else if (m->get_connection() == i->second.con_front) {
-	  dout(25) << "handle_osd_ping got reply from osd." << from
-		   << " first_rx " << i->second.first_tx
-		   << " last_tx " << i->second.last_tx
-		   << " last_rx_back " << i->second.last_rx_back
-		   << " last_rx_front " << i->second.last_rx_front << " -> " << m->stamp
-		   << dendl;
-	  i->second.last_rx_front = m->stamp;
+	  }
+	  utime_t cutoff = ceph_clock_now(cct);
+	  cutoff -= cct->_conf->osd_heartbeat_grace;
+	  healthy = i->second.is_healthy(cutoff);
 	}
       }
 
@@ -3085,10 +3418,9 @@ void OSD::handle_osd_ping(MOSDPing *m)
 	}
       }
 
-      utime_t cutoff = ceph_clock_now(cct);
-      cutoff -= cct->_conf->osd_heartbeat_grace;
-      if (i->second.is_healthy(cutoff)) {
+      if (healthy) {
 	// Cancel false reports
+	Mutex::Locker l(heartbeat_lock);
 	if (failure_queue.count(from)) {
 	  dout(10) << "handle_osd_ping canceling queued failure report for osd." << from<< dendl;
 	  failure_queue.erase(from);
@@ -3109,12 +3441,27 @@ void OSD::handle_osd_ping(MOSDPing *m)
     break;
   }
 
-  heartbeat_lock.Unlock();
   m->put();
 }
 
 void OSD::heartbeat_entry()
 {
+  int prio = cct->_conf->osd_heartbeat_thread_rt_priority;
+  if (prio > 0) {
+    // pings must go out on time even when the box is loaded, or our
+    // peers will report us down
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = MIN(prio, sched_get_priority_max(SCHED_RR));
+    int r = pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+    if (r == 0)
+      dout(1) << "heartbeat_entry SCHED_RR priority "
+	      << param.sched_priority << dendl;
+    else
+      dout(1) << "heartbeat_entry unable to set SCHED_RR priority: "
+	      << cpp_strerror(r) << dendl;
+  }
+
   Mutex::Locker l(heartbeat_lock);
   if (is_stopping())
     return;
@@ -3293,6 +3640,15 @@ void OSD::tick()
 
   logger->set(l_osd_buf, buffer::get_total_alloc());
 
+  if (OSDMapRef map = service.get_osdmap()) {
+    uint64_t hits, misses;
+    map->get_mapping_cache_stats(&hits, &misses);
+    logger->set(l_osd_pg_map_hit, hits);
+    logger->set(l_osd_pg_map_miss, misses);
+  }
+
+  service.check_memory_usage();
+
   if (is_active() || is_waiting_for_healthy()) {
     map_lock.get_read();
 
@@ -3312,6 +3668,7 @@ void OSD::tick()
       timeout_mon_on_pg_stats = false;
       last_pg_stats_ack = ceph_clock_now(cct);  // reset clock
       last_pg_stats_sent = utime_t();
+      last_pg_stats_resend = utime_t();  // the new mon gets a full report
     }
     if (now - last_pg_stats_sent > cct->_conf->osd_mon_report_interval_max) {
       osd_stat_updated = true;
@@ -3354,7 +3711,7 @@ void OSD::tick()
 
   check_ops_in_flight();
 
-  tick_timer.add_event_after(1.0, new C_Tick(this));
+  tick_timer.add_event_after(1.0, new C_Tick(this), true /* coarse */);
 }
 
 void OSD::check_ops_in_flight()
@@ -4090,6 +4447,16 @@ void OSD::send_pg_stats(const utime_t &now)
 
     dout(10) << "send_pg_stats - " << pg_stat_queue.size() << " pgs updated" << dendl;
 
+    // normally a queued pg goes out once and then just waits for the
+    // ack; periodically resend everything in case a report was lost
+    // on the way to the mon
+    bool resend_all = false;
+    if (now - last_pg_stats_resend >
+	cct->_conf->osd_pg_stat_resend_interval) {
+      resend_all = true;
+      last_pg_stats_resend = now;
+    }
+
     utime_t had_for(now);
     had_for -= had_map_since;
 
@@ -4107,13 +4474,20 @@ void OSD::send_pg_stats(const utime_t &now)
 	continue;
       }
       pg->pg_stats_publish_lock.Lock();
-      if (pg->pg_stats_publish_valid) {
-	m->pg_stat[pg->info.pgid.pgid] = pg->pg_stats_publish;
-	dout(25) << " sending " << pg->info.pgid << " " << pg->pg_stats_publish.reported_epoch << ":"
-		 << pg->pg_stats_publish.reported_seq << dendl;
+      if (!pg->pg_stats_publish_valid) {
+	dout(25) << " NOT sending " << pg->info.pgid << " " << pg->pg_stats_publish->reported_epoch << ":"
+		 << pg->pg_stats_publish->reported_seq << ", not valid" << dendl;
+      } else if (!resend_all &&
+		 pg->pg_stats_publish->reported_seq == pg->pg_stats_sent_seq &&
+		 pg->pg_stats_publish->reported_epoch == pg->pg_stats_sent_epoch) {
+	dout(25) << " NOT sending " << pg->info.pgid << " " << pg->pg_stats_publish->reported_epoch << ":"
+		 << pg->pg_stats_publish->reported_seq << ", already sent, awaiting ack" << dendl;
       } else {
-	dout(25) << " NOT sending " << pg->info.pgid << " " << pg->pg_stats_publish.reported_epoch << ":"
-		 << pg->pg_stats_publish.reported_seq << ", not valid" << dendl;
+	m->pg_stat[pg->info.pgid.pgid] = *pg->pg_stats_publish;
+	pg->pg_stats_sent_seq = pg->pg_stats_publish->reported_seq;
+	pg->pg_stats_sent_epoch = pg->pg_stats_publish->reported_epoch;
+	dout(25) << " sending " << pg->info.pgid << " " << pg->pg_stats_publish->reported_epoch << ":"
+		 << pg->pg_stats_publish->reported_seq << dendl;
       }
       pg->pg_stats_publish_lock.Unlock();
     }
@@ -4155,20 +4529,20 @@ void OSD::handle_pg_stats_ack(MPGStatsAck *ack)
     if (ack->pg_stat.count(pg->info.pgid.pgid)) {
       pair<version_t,epoch_t> acked = ack->pg_stat[pg->info.pgid.pgid];
       pg->pg_stats_publish_lock.Lock();
-      if (acked.first == pg->pg_stats_publish.reported_seq &&
-	  acked.second == pg->pg_stats_publish.reported_epoch) {
-	dout(25) << " ack on " << pg->info.pgid << " " << pg->pg_stats_publish.reported_epoch
-		 << ":" << pg->pg_stats_publish.reported_seq << dendl;
+      if (acked.first == pg->pg_stats_publish->reported_seq &&
+	  acked.second == pg->pg_stats_publish->reported_epoch) {
+	dout(25) << " ack on " << pg->info.pgid << " " << pg->pg_stats_publish->reported_epoch
+		 << ":" << pg->pg_stats_publish->reported_seq << dendl;
 	pg->stat_queue_item.remove_myself();
 	pg->put("pg_stat_queue");
       } else {
-	dout(25) << " still pending " << pg->info.pgid << " " << pg->pg_stats_publish.reported_epoch
-		 << ":" << pg->pg_stats_publish.reported_seq << " > acked " << acked << dendl;
+	dout(25) << " still pending " << pg->info.pgid << " " << pg->pg_stats_publish->reported_epoch
+		 << ":" << pg->pg_stats_publish->reported_seq << " > acked " << acked << dendl;
       }
       pg->pg_stats_publish_lock.Unlock();
     } else {
-      dout(30) << " still pending " << pg->info.pgid << " " << pg->pg_stats_publish.reported_epoch
-	       << ":" << pg->pg_stats_publish.reported_seq << dendl;
+      dout(30) << " still pending " << pg->info.pgid << " " << pg->pg_stats_publish->reported_epoch
+	       << ":" << pg->pg_stats_publish->reported_seq << dendl;
     }
   }
   
@@ -4929,8 +5303,40 @@ void OSD::dispatch_session_waiting(Session *session, OSDMapRef osdmap)
   }
 }
 
+struct PoolThrottleWakeup : public Context {
+  OSD *osd;
+  OSD::Session *session;   ///< we own a ref
+  PoolThrottleWakeup(OSD *o, OSD::Session *s) : osd(o), session(s) {}
+  ~PoolThrottleWakeup() {
+    session->put();
+  }
+  void finish(int r) {
+    OSDMapRef nextmap = osd->service.get_nextmap_reserved();
+    {
+      Mutex::Locker l(session->session_dispatch_lock);
+      osd->dispatch_session_waiting(session, nextmap);
+    }
+    osd->service.release_map(nextmap);
+  }
+};
+
+void OSD::defer_pool_throttled_session(Session *session, utime_t delay)
+{
+  // the wakeup event consumes the session ref passed in
+  Mutex::Locker l(service.pool_throttle_lock);
+  service.pool_throttle_timer.add_event_after(
+    (double)delay, new PoolThrottleWakeup(this, session));
+}
+
 void OSD::ms_fast_dispatch(Message *m)
 {
+  if (m->get_type() == CEPH_MSG_PING) {
+    // debug ping; nothing to do, and no need to bounce through the
+    // dispatch queue just to drop it
+    dout(10) << "ping from " << m->get_source_inst() << dendl;
+    m->put();
+    return;
+  }
   OpRequestRef op = op_tracker.create_request<OpRequest>(m);
   OSDMapRef nextmap = service.get_nextmap_reserved();
   Session *session = static_cast<Session*>(m->get_connection()->get_priv());
@@ -5170,7 +5576,8 @@ bool OSD::dispatch_op_fast(OpRequestRef op, OSDMapRef osdmap) {
   switch(op->get_req()->get_type()) {
   // client ops
   case CEPH_MSG_OSD_OP:
-    handle_op(op, osdmap);
+    if (!handle_op(op, osdmap))
+      return false;   // pool rate limited; leave it queued on the session
     break;
     // for replication etc.
   case MSG_OSD_SUBOP:
@@ -6377,9 +6784,61 @@ bool OSDService::get_inc_map_bl(epoch_t e, bufferlist& bl)
 void OSDService::_add_map_bl(epoch_t e, bufferlist& bl)
 {
   dout(10) << "add_map_bl " << e << " " << bl.length() << " bytes" << dendl;
+  // a decoded OSDMap costs roughly twice its encoding on the heap;
+  // keep a running average so the memory balancer can price the
+  // map_cache in bytes
+  uint64_t decoded = (uint64_t)bl.length() * 2;
+  if (avg_map_bytes)
+    avg_map_bytes = (avg_map_bytes * 7 + decoded) / 8;
+  else
+    avg_map_bytes = decoded;
   map_bl_cache.add(e, bl);
 }
 
+void OSDService::MapCacheBudgetClient::get_cache_stats(
+  uint64_t *bytes, uint64_t *hits, uint64_t *misses)
+{
+  osd->map_cache.get_cache_counters(hits, misses);
+  uint64_t per_map;
+  {
+    Mutex::Locker l(osd->map_cache_lock);
+    per_map = osd->avg_map_bytes;
+  }
+  if (!per_map)
+    per_map = 1024;    // no maps seen yet; nominal
+  *bytes = osd->map_cache.get_size() * per_map;
+}
+
+void OSDService::MapCacheBudgetClient::trim_cache_to(uint64_t bytes)
+{
+  uint64_t per_map;
+  {
+    Mutex::Locker l(osd->map_cache_lock);
+    per_map = osd->avg_map_bytes;
+  }
+  if (!per_map)
+    return;
+  // the budget only shrinks us; the configured size stays the ceiling
+  uint64_t entries = bytes / per_map;
+  if (entries > (uint64_t)osd->cct->_conf->osd_map_cache_size)
+    entries = osd->cct->_conf->osd_map_cache_size;
+  if (!entries)
+    entries = 1;
+  osd->map_cache.set_size(entries);
+}
+
+void OSDService::check_memory_usage()
+{
+  uint64_t target = cct->_conf->osd_memory_target;
+  if (!target)
+    return;
+  utime_t now = ceph_clock_now(cct);
+  if (now - last_memory_balance < cct->_conf->osd_memory_balance_interval)
+    return;
+  last_memory_balance = now;
+  mem_budget.balance(target);
+}
+
 void OSDService::_add_map_inc_bl(epoch_t e, bufferlist& bl)
 {
   dout(10) << "add_map_inc_bl " << e << " " << bl.length() << " bytes" << dendl;
@@ -6987,6 +7446,8 @@ void OSD::handle_pg_notify(OpRequestRef op)
 
   if (!require_same_or_newer_map(op, m->get_epoch())) return;
 
+  m->finish_decode();
+
   op->mark_started();
 
   for (vector<pair<pg_notify_t, pg_interval_map_t> >::iterator it = m->get_pg_list().begin();
@@ -7022,6 +7483,8 @@ void OSD::handle_pg_log(OpRequestRef op)
   int from = m->get_source().num();
   if (!require_same_or_newer_map(op, m->get_epoch())) return;
 
+  m->finish_decode();
+
   if (m->info.pgid.preferred() >= 0) {
     dout(10) << "ignoring localized pg " << m->info.pgid << dendl;
     return;
@@ -7051,6 +7514,8 @@ void OSD::handle_pg_info(OpRequestRef op)
   int from = m->get_source().num();
   if (!require_same_or_newer_map(op, m->get_epoch())) return;
 
+  m->finish_decode();
+
   op->mark_started();
 
   for (vector<pair<pg_notify_t,pg_interval_map_t> >::iterator p = m->pg_list.begin();
@@ -7739,15 +8204,18 @@ struct send_map_on_destruct {
   }
 };
 
-void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
+bool OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
 {
   MOSDOp *m = static_cast<MOSDOp*>(op->get_req());
   assert(m->get_header().type == CEPH_MSG_OSD_OP);
   if (op_is_discardable(m)) {
     dout(10) << " discardable " << *m << dendl;
-    return;
+    return true;
   }
 
+  // we are going to look at the whole op now; decode the deferred tail
+  m->finish_decode();
+
   // we don't need encoded payload anymore
   m->clear_payload();
 
@@ -7756,14 +8224,14 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
     dout(4) << "handle_op '" << m->get_oid().name << "' is longer than "
 	    << MAX_CEPH_OBJECT_NAME_LEN << " bytes!" << dendl;
     service.reply_op_error(op, -ENAMETOOLONG);
-    return;
+    return true;
   }
 
   // blacklisted?
   if (osdmap->is_blacklisted(m->get_source_addr())) {
     dout(4) << "handle_op " << m->get_source_addr() << " is blacklisted" << dendl;
     service.reply_op_error(op, -EBLACKLISTED);
-    return;
+    return true;
   }
 
   // set up a map send if the Op gets blocked for some reason
@@ -7785,15 +8253,18 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
     int r = init_op_flags(op);
     if (r) {
       service.reply_op_error(op, r);
-      return;
+      return true;
     }
   }
 
+  if (op_capture.enabled())
+    op_capture.capture(m);
+
   if (cct->_conf->osd_debug_drop_op_probability > 0 &&
       !m->get_source().is_mds()) {
     if ((double)rand() / (double)RAND_MAX < cct->_conf->osd_debug_drop_op_probability) {
       dout(0) << "handle_op DEBUG artificially dropping op " << *m << dendl;
-      return;
+      return true;
     }
   }
 
@@ -7805,13 +8276,13 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
 	!m->get_source().is_mds()) {  // FIXME: we'll exclude mds writes for now.
       // Drop the request, since the client will retry when the full
       // flag is unset.
-      return;
+      return true;
     }
 
     // invalid?
     if (m->get_snapid() != CEPH_NOSNAP) {
       service.reply_op_error(op, -EINVAL);
-      return;
+      return true;
     }
 
     // too big?
@@ -7822,7 +8293,7 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
 	   << " > osd_max_write_size " << (cct->_conf->osd_max_write_size << 20)
 	   << " on " << *m << dendl;
       service.reply_op_error(op, -OSD_WRITETOOBIG);
-      return;
+      return true;
     }
   }
 
@@ -7836,7 +8307,7 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
   spg_t pgid;
   if (!osdmap->get_primary_shard(_pgid, &pgid)) {
     // missing pool or acting set empty -- drop
-    return;
+    return true;
   }
 
   OSDMapRef send_map = service.try_get_map(m->get_map_epoch());
@@ -7844,7 +8315,7 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
   if (!send_map) {
 
     dout(7) << "don't have sender's osdmap; assuming it was valid and that client will resend" << dendl;
-    return;
+    return true;
   }
   if (!send_map->have_pg_pool(pgid.pool())) {
     dout(7) << "dropping request; pool did not exist" << dendl;
@@ -7855,7 +8326,7 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
 		      << ", client e" << m->get_map_epoch()
 		      << " when pool " << m->get_pg().pool() << " did not exist"
 		      << "\n";
-    return;
+    return true;
   } else if (send_map->get_pg_acting_role(pgid.pgid, whoami) < 0) {
     dout(7) << "we are invalid target" << dendl;
     clog.warn() << m->get_source_inst() << " misdirected " << m->get_reqid()
@@ -7867,14 +8338,33 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
 		      << " features " << m->get_connection()->get_features()
 		      << "\n";
     service.reply_op_error(op, -ENXIO);
-    return;
+    return true;
   }
 
   // check against current map too
   if (!osdmap->have_pg_pool(pgid.pool()) ||
       osdmap->get_pg_acting_role(pgid.pgid, whoami) < 0) {
     dout(7) << "dropping; no longer have PG (or pool); client will retarget" << dendl;
-    return;
+    return true;
+  }
+
+  // per-pool rate limit?
+  const pg_pool_t *pi = osdmap->get_pg_pool(pool);
+  if ((pi->rate_limit_iops || pi->rate_limit_bps) &&
+      !m->get_source().is_mds()) {  // mds is exempt, as for the full checks
+    utime_t delay;
+    if (!service.pool_throttle_admit(pool, *pi, m->get_data_len(), &delay)) {
+      dout(10) << "handle_op pool " << pool << " rate limited, retry in "
+	       << delay << ": " << *m << dendl;
+      logger->inc(l_osd_pool_throttle);
+      logger->tinc(l_osd_pool_throttle_lat, delay);
+      op->mark_delayed("waiting for pool rate limit");
+      Session *session =
+	static_cast<Session*>(m->get_connection()->get_priv());
+      if (session)
+	defer_pool_throttled_session(session, delay);  // consumes the ref
+      return false;
+    }
   }
 
   PG *pg = get_pg_or_queue_for_pg(pgid, op);
@@ -7884,6 +8374,7 @@ void OSD::handle_op(OpRequestRef op, OSDMapRef osdmap)
     enqueue_op(pg, op);
     share_map.should_send = false;
   }
+  return true;
 }
 
 template<typename T, int MSGTYPE>
@@ -8034,9 +8525,19 @@ void OSD::OpWQ::_process(PGRef pg, ThreadPool::TPHandle &handle)
 }
 
 
+void OSDService::queue_op(PGRef pg, OpRequestRef op)
+{
+  osd->shard_op_wq(pg.get()).queue(make_pair(pg, op));
+}
+
+void OSDService::queue_op_front(PGRef pg, OpRequestRef op)
+{
+  osd->shard_op_wq(pg.get()).queue_front(make_pair(pg, op));
+}
+
 void OSDService::dequeue_pg(PG *pg, list<OpRequestRef> *dequeued)
 {
-  osd->op_wq.dequeue(pg, dequeued);
+  osd->shard_op_wq(pg).dequeue(pg, dequeued);
 }
 
 /*
@@ -8180,6 +8681,7 @@ const char** OSD::get_tracked_conf_keys() const
 {
   static const char* KEYS[] = {
     "osd_max_backfills",
+    "osd_backfill_reservation_adaptive",
     "osd_op_complaint_time", "osd_op_log_threshold",
     "osd_op_history_size", "osd_op_history_duration",
     NULL
@@ -8190,7 +8692,10 @@ const char** OSD::get_tracked_conf_keys() const
 void OSD::handle_conf_change(const struct md_config_t *conf,
 			     const std::set <std::string> &changed)
 {
-  if (changed.count("osd_max_backfills")) {
+  if (changed.count("osd_max_backfills") ||
+      changed.count("osd_backfill_reservation_adaptive")) {
+    // adaptive scaling resumes from the configured ceiling
+    backfill_reservation_max = cct->_conf->osd_max_backfills;
     service.local_reserver.set_max(cct->_conf->osd_max_backfills);
     service.remote_reserver.set_max(cct->_conf->osd_max_backfills);
   }
@@ -8236,6 +8741,7 @@ int OSD::init_op_flags(OpRequestRef op)
 
     switch (iter->op.op) {
     case CEPH_OSD_OP_CALL:
+    case CEPH_OSD_OP_CALL_CHAIN:
       {
 	bufferlist::iterator bp = iter->indata.begin();
 	int is_write, is_read;
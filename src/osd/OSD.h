@@ -39,6 +39,7 @@
 #include "auth/KeyRing.h"
 #include "messages/MOSDRepScrub.h"
 #include "OpRequest.h"
+#include "OpCapture.h"
 
 #include <map>
 #include <memory>
@@ -49,10 +50,12 @@ using namespace std;
 #include "include/unordered_set.h"
 
 #include "Watch.h"
+#include "ObjectReadCache.h"
 #include "common/shared_cache.hpp"
 #include "common/simple_cache.hpp"
+#include "common/MemoryBudget.h"
 #include "common/sharedptr_registry.hpp"
-#include "common/PrioritizedQueue.h"
+#include "common/FlatPrioritizedQueue.h"
 
 #define CEPH_OSD_PROTOCOL    10 /* cluster internal */
 
@@ -115,6 +118,8 @@ enum {
   l_osd_map,
   l_osd_mape,
   l_osd_mape_dup,
+  l_osd_pg_map_hit,
+  l_osd_pg_map_miss,
 
   l_osd_waiting_for_map,
 
@@ -140,6 +145,12 @@ enum {
   l_osd_agent_flush,
   l_osd_agent_evict,
 
+  l_osd_pool_throttle,
+  l_osd_pool_throttle_lat,
+
+  l_osd_rdcache_hit,
+  l_osd_rdcache_miss,
+
   l_osd_last,
 };
 
@@ -321,7 +332,8 @@ public:
   PerfCounters *&logger;
   PerfCounters *&recoverystate_perf;
   MonClient   *&monc;
-  ThreadPool::WorkQueueVal<pair<PGRef, OpRequestRef>, PGRef> &op_wq;
+  void queue_op(PGRef pg, OpRequestRef op);
+  void queue_op_front(PGRef pg, OpRequestRef op);
   ThreadPool::BatchWorkQueue<PG> &peering_wq;
   ThreadPool::WorkQueue<PG> &recovery_wq;
   ThreadPool::WorkQueue<PG> &snap_trim_wq;
@@ -560,7 +572,9 @@ public:
       osd->agent_entry();
       return NULL;
     }
-  } agent_thread;
+  };
+  /// agent workers; more than one lets several pgs flush/evict at once
+  vector<AgentThread*> agent_threads;
   bool agent_stop_flag;
   Mutex agent_timer_lock;
   SafeTimer agent_timer;
@@ -642,6 +656,8 @@ public:
     return agent_ops;
   }
 
+  // -- in-memory cache of hot object reads --
+  ObjectReadCache read_cache;
 
   // -- Objecter, for teiring reads/writes from/to other OSDs --
   Mutex objecter_lock;
@@ -676,6 +692,25 @@ public:
   Mutex backfill_request_lock;
   SafeTimer backfill_request_timer;
 
+  // -- per-pool rate limits --
+  Mutex pool_throttle_lock;
+  SafeTimer pool_throttle_timer;
+  struct PoolThrottle {
+    utime_t last_refill;
+    double iops_tokens;
+    double bps_tokens;
+    PoolThrottle() : iops_tokens(0), bps_tokens(0) {}
+  };
+  map<int64_t, PoolThrottle> pool_throttles;
+  /**
+   * charge a client op against the pool's token buckets
+   *
+   * Returns true if the op may be admitted now.  On false, *delay is
+   * how long until the buckets will have refilled enough to admit it.
+   */
+  bool pool_throttle_admit(int64_t poolid, const pg_pool_t &pool,
+			   uint64_t bytes, utime_t *delay);
+
   // -- tids --
   // for ops i issue
   ceph_tid_t last_tid;
@@ -757,6 +792,27 @@ public:
 
   void clear_map_bl_cache_pins(epoch_t e);
 
+  // -- memory balancing --
+  MemoryBudget mem_budget;
+  /// running estimate of a decoded OSDMap's heap footprint, fed by the
+  /// encoded full maps passing through _add_map_bl; map_cache_lock
+  uint64_t avg_map_bytes;
+
+  /// MemoryBudgetClient glue for map_cache
+  struct MapCacheBudgetClient : public MemoryBudgetClient {
+    OSDService *osd;
+    MapCacheBudgetClient(OSDService *o) : osd(o) {}
+    const char *get_cache_name() const { return "osdmap_cache"; }
+    void get_cache_stats(uint64_t *bytes, uint64_t *hits, uint64_t *misses);
+    void trim_cache_to(uint64_t bytes);
+  } map_cache_budget_client;
+
+  utime_t last_memory_balance;
+
+  /// rebalance the cache budget if osd_memory_target is set and the
+  /// balance interval has elapsed; called from the OSD tick
+  void check_memory_usage();
+
   void need_heartbeat_peer_update();
 
   void pg_stat_queue_enqueue(PG *pg);
@@ -1118,6 +1174,8 @@ public:
     {}
   };
   void dispatch_session_waiting(Session *session, OSDMapRef osdmap);
+  /// re-run a session's waiting_on_map queue once a pool rate limit refills
+  void defer_pool_throttled_session(Session *session, utime_t delay);
   Mutex session_waiting_for_map_lock;
   set<Session*> session_waiting_for_map;
   /// Caller assumes refs for included Sessions
@@ -1261,7 +1319,12 @@ private:
   osd_stat_t osd_stat;
 
   void update_osd_stat();
-  
+
+  /// current adaptive backfill reservation limit (<= osd_max_backfills)
+  unsigned backfill_reservation_max;
+
+  void maybe_scale_backfill_reservations();
+
   // -- waiters --
   list<OpRequestRef> finished;
   Mutex finished_lock;
@@ -1291,6 +1354,9 @@ private:
   TestOpsSocketHook *test_ops_hook;
   friend struct C_CompleteSplits;
 
+  // -- op capture --
+  OpCapture op_capture;
+
   // -- op queue --
 
   struct OpWQ: public ThreadPool::WorkQueueVal<pair<PGRef, OpRequestRef>,
@@ -1298,7 +1364,7 @@ private:
     Mutex qlock;
     map<PG*, list<OpRequestRef> > pg_for_processing;
     OSD *osd;
-    PrioritizedQueue<pair<PGRef, OpRequestRef>, entity_inst_t > pqueue;
+    FlatPrioritizedQueue<pair<PGRef, OpRequestRef>, entity_inst_t > pqueue;
     OpWQ(OSD *o, time_t ti, ThreadPool *tp)
       : ThreadPool::WorkQueueVal<pair<PGRef, OpRequestRef>, PGRef >(
 	"OSD::OpWQ", ti, ti*10, tp),
@@ -1306,7 +1372,14 @@ private:
 	osd(o),
 	pqueue(o->cct->_conf->osd_op_pq_max_tokens_per_priority,
 	       o->cct->_conf->osd_op_pq_min_cost)
-    {}
+    {
+      // bandwidth floors for the op classes that flow through this
+      // queue (scrub and snap trim have their own work queues)
+      pqueue.set_reservation(o->cct->_conf->osd_client_op_priority,
+			     o->cct->_conf->osd_op_queue_client_share_min);
+      pqueue.set_reservation(o->cct->_conf->osd_recovery_op_priority,
+			     o->cct->_conf->osd_op_queue_recovery_share_min);
+    }
 
     void dump(Formatter *f) {
       lock();
@@ -1353,6 +1426,22 @@ private:
     void _process(PGRef pg, ThreadPool::TPHandle &handle);
   } op_wq;
 
+  /**
+   * Optional sharded op queue.  When osd_op_num_shards > 0 we create that
+   * many additional ThreadPool/OpWQ pairs and hash each PG to one of them,
+   * so unrelated PGs no longer contend on a single queue lock while ops
+   * for any given PG still run through one queue (preserving per-PG
+   * ordering).  With shards disabled everything goes through op_wq as
+   * before.
+   */
+  vector<ThreadPool*> op_shard_tps;
+  vector<OpWQ*> op_shard_wqs;
+  OpWQ &shard_op_wq(PG *pg) {
+    if (op_shard_wqs.empty())
+      return op_wq;
+    return *op_shard_wqs[pg->info.pgid.ps() % op_shard_wqs.size()];
+  }
+
   void enqueue_op(PG *pg, OpRequestRef op);
   void dequeue_op(
     PGRef pg, OpRequestRef op,
@@ -1575,6 +1664,7 @@ protected:
   // == monitor interaction ==
   utime_t last_mon_report;
   utime_t last_pg_stats_sent;
+  utime_t last_pg_stats_resend;  ///< last time unacked pgs were resent
 
   /* if our monitor dies, we want to notice it and reconnect.
    *  So we keep track of when it last acked our stat updates,
@@ -2054,6 +2144,7 @@ protected:
   bool ms_can_fast_dispatch_any() const { return true; }
   bool ms_can_fast_dispatch(Message *m) const {
     switch (m->get_type()) {
+    case CEPH_MSG_PING:
     case CEPH_MSG_OSD_OP:
     case MSG_OSD_SUBOP:
     case MSG_OSD_SUBOPREPLY:
@@ -2138,7 +2229,9 @@ public:
   void handle_rep_scrub(MOSDRepScrub *m);
   void handle_scrub(struct MOSDScrub *m);
   void handle_osd_ping(class MOSDPing *m);
-  void handle_op(OpRequestRef op, OSDMapRef osdmap);
+  /// returns false if the op was left queued on its session by a
+  /// pool rate limit; true if it was handled (or dropped)
+  bool handle_op(OpRequestRef op, OSDMapRef osdmap);
 
   template <typename T, int MSGTYPE>
   void handle_replica_op(OpRequestRef op, OSDMapRef osdmap);
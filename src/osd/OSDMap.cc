@@ -75,6 +75,16 @@ void osd_info_t::generate_test_instances(list<osd_info_t*>& o)
   o.back()->lost_at = 6;
 }
 
+bool operator==(const osd_info_t& l, const osd_info_t& r)
+{
+  return l.last_clean_begin == r.last_clean_begin &&
+    l.last_clean_end == r.last_clean_end &&
+    l.up_from == r.up_from &&
+    l.up_thru == r.up_thru &&
+    l.down_at == r.down_at &&
+    l.lost_at == r.lost_at;
+}
+
 ostream& operator<<(ostream& out, const osd_info_t& info)
 {
   out << "up_from " << info.up_from
@@ -139,6 +149,15 @@ void osd_xinfo_t::generate_test_instances(list<osd_xinfo_t*>& o)
   o.back()->old_weight = 0x7fff;
 }
 
+bool operator==(const osd_xinfo_t& l, const osd_xinfo_t& r)
+{
+  return l.down_stamp == r.down_stamp &&
+    l.laggy_probability == r.laggy_probability &&
+    l.laggy_interval == r.laggy_interval &&
+    l.features == r.features &&
+    l.old_weight == r.old_weight;
+}
+
 ostream& operator<<(ostream& out, const osd_xinfo_t& xi)
 {
   return out << "down_stamp " << xi.down_stamp
@@ -846,14 +865,14 @@ void OSDMap::set_max_osd(int m)
 {
   int o = max_osd;
   max_osd = m;
-  osd_state.resize(m);
-  osd_weight.resize(m);
+  osd_state->resize(m);
+  osd_weight->resize(m);
   for (; o<max_osd; o++) {
-    osd_state[o] = 0;
-    osd_weight[o] = CEPH_OSD_OUT;
+    (*osd_state)[o] = 0;
+    (*osd_weight)[o] = CEPH_OSD_OUT;
   }
-  osd_info.resize(m);
-  osd_xinfo.resize(m);
+  osd_info->resize(m);
+  osd_xinfo->resize(m);
   osd_addrs->client_addr.resize(m);
   osd_addrs->cluster_addr.resize(m);
   osd_addrs->hb_back_addr.resize(m);
@@ -869,7 +888,7 @@ int OSDMap::calc_num_osds()
 {
   num_osd = 0;
   for (int i=0; i<max_osd; i++)
-    if (osd_state[i] & CEPH_OSD_EXISTS)
+    if ((*osd_state)[i] & CEPH_OSD_EXISTS)
       num_osd++;
   return num_osd;
 }
@@ -893,8 +912,8 @@ unsigned OSDMap::get_num_up_osds() const
 {
   unsigned n = 0;
   for (int i=0; i<max_osd; i++)
-    if ((osd_state[i] & CEPH_OSD_EXISTS) &&
-	(osd_state[i] & CEPH_OSD_UP)) n++;
+    if (((*osd_state)[i] & CEPH_OSD_EXISTS) &&
+	((*osd_state)[i] & CEPH_OSD_UP)) n++;
   return n;
 }
 
@@ -902,7 +921,7 @@ unsigned OSDMap::get_num_in_osds() const
 {
   unsigned n = 0;
   for (int i=0; i<max_osd; i++)
-    if ((osd_state[i] & CEPH_OSD_EXISTS) &&
+    if (((*osd_state)[i] & CEPH_OSD_EXISTS) &&
 	get_weight(i) != CEPH_OSD_OUT) n++;
   return n;
 }
@@ -972,6 +991,8 @@ uint64_t OSDMap::get_features(uint64_t *pmask) const
   if (crush->has_nondefault_tunables3() ||
       crush->has_v3_rules())
     features |= CEPH_FEATURE_CRUSH_TUNABLES3;
+  if (crush->has_v4_buckets())
+    features |= CEPH_FEATURE_CRUSH_V4;
   mask |= CEPH_FEATURES_CRUSH;
 
   for (map<int64_t,pg_pool_t>::const_iterator p = pools.begin(); p != pools.end(); ++p) {
@@ -1083,6 +1104,21 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
   if (o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
+
+  // do states, weights or infos match?
+  if (*o->osd_state == *n->osd_state)
+    n->osd_state = o->osd_state;
+  if (*o->osd_weight == *n->osd_weight)
+    n->osd_weight = o->osd_weight;
+  if (*o->osd_info == *n->osd_info)
+    n->osd_info = o->osd_info;
+  if (*o->osd_xinfo == *n->osd_xinfo)
+    n->osd_xinfo = o->osd_xinfo;
+
+  // do primary affinities match?
+  if (o->osd_primary_affinity && n->osd_primary_affinity &&
+      *o->osd_primary_affinity == *n->osd_primary_affinity)
+    n->osd_primary_affinity = o->osd_primary_affinity;
 }
 
 void OSDMap::remove_redundant_temporaries(CephContext *cct, const OSDMap& osdmap,
@@ -1166,6 +1202,9 @@ int OSDMap::apply_incremental(const Incremental &inc)
   epoch++;
   modified = inc.modified;
 
+  // we are becoming a different map; start over on memoized mappings
+  mapping_cache.reset(new mapping_cache_t);
+
   // full map?
   if (inc.fullmap.length()) {
     bufferlist bl(inc.fullmap);
@@ -1213,8 +1252,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     // if we are marking in, clear the AUTOOUT and NEW bits, and clear
     // xinfo old_weight.
     if (i->second) {
-      osd_state[i->first] &= ~(CEPH_OSD_AUTOOUT | CEPH_OSD_NEW);
-      osd_xinfo[i->first].old_weight = 0;
+      (*osd_state)[i->first] &= ~(CEPH_OSD_AUTOOUT | CEPH_OSD_NEW);
+      (*osd_xinfo)[i->first].old_weight = 0;
     }
   }
 
@@ -1242,20 +1281,20 @@ int OSDMap::apply_incremental(const Incremental &inc)
        i != inc.new_state.end();
        ++i) {
     int s = i->second ? i->second : CEPH_OSD_UP;
-    if ((osd_state[i->first] & CEPH_OSD_UP) &&
+    if (((*osd_state)[i->first] & CEPH_OSD_UP) &&
 	(s & CEPH_OSD_UP)) {
-      osd_info[i->first].down_at = epoch;
-      osd_xinfo[i->first].down_stamp = modified;
+      (*osd_info)[i->first].down_at = epoch;
+      (*osd_xinfo)[i->first].down_stamp = modified;
     }
-    if ((osd_state[i->first] & CEPH_OSD_EXISTS) &&
+    if (((*osd_state)[i->first] & CEPH_OSD_EXISTS) &&
 	(s & CEPH_OSD_EXISTS))
       (*osd_uuid)[i->first] = uuid_d();
-    osd_state[i->first] ^= s;
+    (*osd_state)[i->first] ^= s;
   }
   for (map<int32_t,entity_addr_t>::const_iterator i = inc.new_up_client.begin();
        i != inc.new_up_client.end();
        ++i) {
-    osd_state[i->first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
+    (*osd_state)[i->first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
     osd_addrs->client_addr[i->first].reset(new entity_addr_t(i->second));
     if (inc.new_hb_back_up.empty())
       osd_addrs->hb_back_addr[i->first].reset(new entity_addr_t(i->second)); //this is a backward-compatibility hack
@@ -1268,7 +1307,7 @@ int OSDMap::apply_incremental(const Incremental &inc)
     else
       osd_addrs->hb_front_addr[i->first].reset();
 
-    osd_info[i->first].up_from = epoch;
+    (*osd_info)[i->first].up_from = epoch;
   }
   for (map<int32_t,entity_addr_t>::const_iterator i = inc.new_up_cluster.begin();
        i != inc.new_up_cluster.end();
@@ -1279,19 +1318,19 @@ int OSDMap::apply_incremental(const Incremental &inc)
   for (map<int32_t,epoch_t>::const_iterator i = inc.new_up_thru.begin();
        i != inc.new_up_thru.end();
        ++i)
-    osd_info[i->first].up_thru = i->second;
+    (*osd_info)[i->first].up_thru = i->second;
   for (map<int32_t,pair<epoch_t,epoch_t> >::const_iterator i = inc.new_last_clean_interval.begin();
        i != inc.new_last_clean_interval.end();
        ++i) {
-    osd_info[i->first].last_clean_begin = i->second.first;
-    osd_info[i->first].last_clean_end = i->second.second;
+    (*osd_info)[i->first].last_clean_begin = i->second.first;
+    (*osd_info)[i->first].last_clean_end = i->second.second;
   }
   for (map<int32_t,epoch_t>::const_iterator p = inc.new_lost.begin(); p != inc.new_lost.end(); ++p)
-    osd_info[p->first].lost_at = p->second;
+    (*osd_info)[p->first].lost_at = p->second;
 
   // xinfo
   for (map<int32_t,osd_xinfo_t>::const_iterator p = inc.new_xinfo.begin(); p != inc.new_xinfo.end(); ++p)
-    osd_xinfo[p->first] = p->second;
+    (*osd_xinfo)[p->first] = p->second;
 
   // uuid
   for (map<int32_t,uuid_d>::const_iterator p = inc.new_uuid.begin(); p != inc.new_uuid.end(); ++p) 
@@ -1417,7 +1456,7 @@ int OSDMap::_pg_to_osds(const pg_pool_t& pool, pg_t pg,
   // what crush rule?
   int ruleno = crush->find_rule(pool.get_crush_ruleset(), pool.get_type(), size);
   if (ruleno >= 0)
-    crush->do_rule(ruleno, pps, *osds, size, osd_weight);
+    crush->do_rule(ruleno, pps, *osds, size, *osd_weight);
 
   _remove_nonexistent_osds(pool, *osds);
 
@@ -1591,6 +1630,25 @@ void OSDMap::_pg_to_up_acting_osds(pg_t pg, vector<int> *up, int *up_primary,
       *acting_primary = -1;
     return;
   }
+  {
+    Spinlock::Locker l(mapping_cache->lock);
+    ceph::unordered_map<pg_t, pg_mapping_t>::const_iterator p =
+      mapping_cache->mappings.find(pg);
+    if (p != mapping_cache->mappings.end()) {
+      mapping_cache->hits.inc();
+      if (up)
+	*up = p->second.up;
+      if (up_primary)
+	*up_primary = p->second.up_primary;
+      if (acting)
+	*acting = p->second.acting;
+      if (acting_primary)
+	*acting_primary = p->second.acting_primary;
+      return;
+    }
+  }
+  mapping_cache->misses.inc();
+
   vector<int> raw;
   vector<int> _up;
   vector<int> _acting;
@@ -1607,6 +1665,16 @@ void OSDMap::_pg_to_up_acting_osds(pg_t pg, vector<int> *up, int *up_primary,
       _acting_primary = _up_primary;
     }
   }
+
+  {
+    Spinlock::Locker l(mapping_cache->lock);
+    pg_mapping_t &m = mapping_cache->mappings[pg];
+    m.up = _up;
+    m.up_primary = _up_primary;
+    m.acting = _acting;
+    m.acting_primary = _acting_primary;
+  }
+
   if (up)
     up->swap(_up);
   if (up_primary)
@@ -1617,6 +1685,74 @@ void OSDMap::_pg_to_up_acting_osds(pg_t pg, vector<int> *up, int *up_primary,
     *acting_primary = _acting_primary;
 }
 
+void OSDMap::pg_to_up_acting_osds_batch(const vector<pg_t>& pgs,
+					vector<vector<int> > *up,
+					vector<int> *up_primary,
+					vector<vector<int> > *acting,
+					vector<int> *acting_primary) const
+{
+  unsigned n = pgs.size();
+  up->clear();
+  up->resize(n);
+  up_primary->assign(n, -1);
+  acting->clear();
+  acting->resize(n);
+  acting_primary->assign(n, -1);
+
+  // group by pool so each pool's rule runs as one crush batch
+  map<int64_t, vector<unsigned> > by_pool;
+  for (unsigned i = 0; i < n; ++i)
+    by_pool[pgs[i].pool()].push_back(i);
+
+  for (map<int64_t, vector<unsigned> >::iterator p = by_pool.begin();
+       p != by_pool.end();
+       ++p) {
+    const pg_pool_t *pool = get_pg_pool(p->first);
+    if (!pool)
+      continue;  // nonexistent pool: empty sets, -1 primaries
+
+    vector<unsigned>& idx = p->second;
+    unsigned size = pool->get_size();
+    int ruleno = crush->find_rule(pool->get_crush_ruleset(),
+				  pool->get_type(), size);
+
+    vector<ps_t> pps(idx.size());
+    vector<int> xs(idx.size());
+    for (unsigned j = 0; j < idx.size(); ++j) {
+      pps[j] = pool->raw_pg_to_pps(pgs[idx[j]]);
+      xs[j] = pps[j];
+    }
+
+    vector<vector<int> > raw(idx.size());
+    if (ruleno >= 0)
+      crush->do_rule_batch(ruleno, xs, raw, size, *osd_weight);
+
+    for (unsigned j = 0; j < idx.size(); ++j) {
+      _remove_nonexistent_osds(*pool, raw[j]);
+
+      vector<int> _up;
+      int _up_primary;
+      _raw_to_up_osds(*pool, raw[j], &_up, &_up_primary);
+      _apply_primary_affinity(pps[j], *pool, &_up, &_up_primary);
+
+      vector<int> _acting;
+      int _acting_primary;
+      _get_temp_osds(*pool, pgs[idx[j]], &_acting, &_acting_primary);
+      if (_acting.empty()) {
+	_acting = _up;
+	if (_acting_primary == -1) {
+	  _acting_primary = _up_primary;
+	}
+      }
+
+      (*up)[idx[j]].swap(_up);
+      (*up_primary)[idx[j]] = _up_primary;
+      (*acting)[idx[j]].swap(_acting);
+      (*acting_primary)[idx[j]] = _acting_primary;
+    }
+  }
+}
+
 int OSDMap::calc_pg_rank(int osd, const vector<int>& acting, int nrep)
 {
   if (!nrep)
@@ -1692,8 +1828,8 @@ void OSDMap::encode_client_old(bufferlist& bl) const
   ::encode(flags, bl);
 
   ::encode(max_osd, bl);
-  ::encode(osd_state, bl);
-  ::encode(osd_weight, bl);
+  ::encode(*osd_state, bl);
+  ::encode(*osd_weight, bl);
   ::encode(osd_addrs->client_addr, bl);
 
   // for ::encode(pg_temp, bl);
@@ -1736,8 +1872,8 @@ void OSDMap::encode_classic(bufferlist& bl, uint64_t features) const
   ::encode(flags, bl);
 
   ::encode(max_osd, bl);
-  ::encode(osd_state, bl);
-  ::encode(osd_weight, bl);
+  ::encode(*osd_state, bl);
+  ::encode(*osd_weight, bl);
   ::encode(osd_addrs->client_addr, bl);
 
   ::encode(*pg_temp, bl);
@@ -1751,13 +1887,13 @@ void OSDMap::encode_classic(bufferlist& bl, uint64_t features) const
   __u16 ev = 10;
   ::encode(ev, bl);
   ::encode(osd_addrs->hb_back_addr, bl);
-  ::encode(osd_info, bl);
+  ::encode(*osd_info, bl);
   ::encode(blacklist, bl);
   ::encode(osd_addrs->cluster_addr, bl);
   ::encode(cluster_snapshot_epoch, bl);
   ::encode(cluster_snapshot, bl);
   ::encode(*osd_uuid, bl);
-  ::encode(osd_xinfo, bl);
+  ::encode(*osd_xinfo, bl);
   ::encode(osd_addrs->hb_front_addr, bl);
 }
 
@@ -1785,8 +1921,8 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
     ::encode(flags, bl);
 
     ::encode(max_osd, bl);
-    ::encode(osd_state, bl);
-    ::encode(osd_weight, bl);
+    ::encode(*osd_state, bl);
+    ::encode(*osd_weight, bl);
     ::encode(osd_addrs->client_addr, bl);
 
     ::encode(*pg_temp, bl);
@@ -1809,13 +1945,13 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
   {
     ENCODE_START(1, 1, bl); // extended, osd-only data
     ::encode(osd_addrs->hb_back_addr, bl);
-    ::encode(osd_info, bl);
+    ::encode(*osd_info, bl);
     ::encode(blacklist, bl);
     ::encode(osd_addrs->cluster_addr, bl);
     ::encode(cluster_snapshot_epoch, bl);
     ::encode(cluster_snapshot, bl);
     ::encode(*osd_uuid, bl);
-    ::encode(osd_xinfo, bl);
+    ::encode(*osd_xinfo, bl);
     ::encode(osd_addrs->hb_front_addr, bl);
     ENCODE_FINISH(bl); // osd-only data
   }
@@ -1879,8 +2015,8 @@ void OSDMap::decode_classic(bufferlist::iterator& p)
   ::decode(flags, p);
 
   ::decode(max_osd, p);
-  ::decode(osd_state, p);
-  ::decode(osd_weight, p);
+  ::decode(*osd_state, p);
+  ::decode(*osd_weight, p);
   ::decode(osd_addrs->client_addr, p);
   if (v <= 5) {
     pg_temp->clear();
@@ -1905,7 +2041,7 @@ void OSDMap::decode_classic(bufferlist::iterator& p)
   if (v >= 5)
     ::decode(ev, p);
   ::decode(osd_addrs->hb_back_addr, p);
-  ::decode(osd_info, p);
+  ::decode(*osd_info, p);
   if (v < 5)
     ::decode(pool_name, p);
 
@@ -1926,9 +2062,9 @@ void OSDMap::decode_classic(bufferlist::iterator& p)
     osd_uuid->resize(max_osd);
   }
   if (ev >= 9)
-    ::decode(osd_xinfo, p);
+    ::decode(*osd_xinfo, p);
   else
-    osd_xinfo.resize(max_osd);
+    osd_xinfo->resize(max_osd);
 
   if (ev >= 10)
     ::decode(osd_addrs->hb_front_addr, p);
@@ -1942,6 +2078,8 @@ void OSDMap::decode_classic(bufferlist::iterator& p)
 
 void OSDMap::decode(bufferlist::iterator& bl)
 {
+  mapping_cache.reset(new mapping_cache_t);
+
   /**
    * Older encodings of the OSDMap had a single struct_v which
    * covered the whole encoding, and was prior to our modern
@@ -1974,8 +2112,8 @@ void OSDMap::decode(bufferlist::iterator& bl)
     ::decode(flags, bl);
 
     ::decode(max_osd, bl);
-    ::decode(osd_state, bl);
-    ::decode(osd_weight, bl);
+    ::decode(*osd_state, bl);
+    ::decode(*osd_weight, bl);
     ::decode(osd_addrs->client_addr, bl);
 
     ::decode(*pg_temp, bl);
@@ -2005,13 +2143,13 @@ void OSDMap::decode(bufferlist::iterator& bl)
   {
     DECODE_START(1, bl); // extended, osd-only data
     ::decode(osd_addrs->hb_back_addr, bl);
-    ::decode(osd_info, bl);
+    ::decode(*osd_info, bl);
     ::decode(blacklist, bl);
     ::decode(osd_addrs->cluster_addr, bl);
     ::decode(cluster_snapshot_epoch, bl);
     ::decode(cluster_snapshot, bl);
     ::decode(*osd_uuid, bl);
-    ::decode(osd_xinfo, bl);
+    ::decode(*osd_xinfo, bl);
     ::decode(osd_addrs->hb_front_addr, bl);
     DECODE_FINISH(bl); // osd-only data
   }
@@ -2117,7 +2255,7 @@ void OSDMap::dump(Formatter *f) const
     if (exists(i)) {
       f->open_object_section("xinfo");
       f->dump_int("osd", i);
-      osd_xinfo[i].dump(f);
+      (*osd_xinfo)[i].dump(f);
       f->close_section();
     }
   }
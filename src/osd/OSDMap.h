@@ -45,6 +45,9 @@
 using namespace std;
 
 #include "include/unordered_set.h"
+#include "include/unordered_map.h"
+#include "include/Spinlock.h"
+#include "include/atomic.h"
 
 /*
  * we track up to two intervals during which the osd was alive and
@@ -86,6 +89,7 @@ struct osd_info_t {
 };
 WRITE_CLASS_ENCODER(osd_info_t)
 
+bool operator==(const osd_info_t& l, const osd_info_t& r);
 ostream& operator<<(ostream& out, const osd_info_t& info);
 
 struct osd_xinfo_t {
@@ -105,6 +109,7 @@ struct osd_xinfo_t {
 };
 WRITE_CLASS_ENCODER(osd_xinfo_t)
 
+bool operator==(const osd_xinfo_t& l, const osd_xinfo_t& r);
 ostream& operator<<(ostream& out, const osd_xinfo_t& xi);
 
 
@@ -209,7 +214,7 @@ private:
 
   int num_osd;         // not saved
   int32_t max_osd;
-  vector<uint8_t> osd_state;
+  ceph::shared_ptr< vector<uint8_t> > osd_state;
 
   struct addrs_s {
     vector<ceph::shared_ptr<entity_addr_t> > client_addr;
@@ -220,8 +225,8 @@ private:
   };
   ceph::shared_ptr<addrs_s> osd_addrs;
 
-  vector<__u32>   osd_weight;   // 16.16 fixed point, 0x10000 = "in", 0 = "out"
-  vector<osd_info_t> osd_info;
+  ceph::shared_ptr< vector<__u32> > osd_weight;   // 16.16 fixed point, 0x10000 = "in", 0 = "out"
+  ceph::shared_ptr< vector<osd_info_t> > osd_info;
   ceph::shared_ptr< map<pg_t,vector<int> > > pg_temp;  // temp pg mapping (e.g. while we rebuild)
   ceph::shared_ptr< map<pg_t,int > > primary_temp;  // temp primary mapping (e.g. while we rebuild)
   ceph::shared_ptr< vector<__u32> > osd_primary_affinity; ///< 16.16 fixed point, 0x10000 = baseline
@@ -232,7 +237,7 @@ private:
   map<string,int64_t> name_pool;
 
   ceph::shared_ptr< vector<uuid_d> > osd_uuid;
-  vector<osd_xinfo_t> osd_xinfo;
+  ceph::shared_ptr< vector<osd_xinfo_t> > osd_xinfo;
 
   ceph::unordered_map<entity_addr_t,utime_t> blacklist;
 
@@ -252,13 +257,18 @@ private:
 	     pool_max(-1),
 	     flags(0),
 	     num_osd(0), max_osd(0),
+	     osd_state(new vector<uint8_t>),
 	     osd_addrs(new addrs_s),
+	     osd_weight(new vector<__u32>),
+	     osd_info(new vector<osd_info_t>),
 	     pg_temp(new map<pg_t,vector<int> >),
 	     primary_temp(new map<pg_t,int>),
 	     osd_uuid(new vector<uuid_d>),
+	     osd_xinfo(new vector<osd_xinfo_t>),
 	     cluster_snapshot_epoch(0),
 	     new_blacklist_entries(false),
-	     crush(new CrushWrapper) {
+	     crush(new CrushWrapper),
+	     mapping_cache(new mapping_cache_t) {
     memset(&fsid, 0, sizeof(fsid));
   }
 
@@ -272,9 +282,17 @@ public:
 
   void deepish_copy_from(const OSDMap& o) {
     *this = o;
+    mapping_cache.reset(new mapping_cache_t);  // don't share; we will mutate
     primary_temp.reset(new map<pg_t,int>(*o.primary_temp));
     pg_temp.reset(new map<pg_t,vector<int> >(*o.pg_temp));
     osd_uuid.reset(new vector<uuid_d>(*o.osd_uuid));
+    osd_state.reset(new vector<uint8_t>(*o.osd_state));
+    osd_weight.reset(new vector<__u32>(*o.osd_weight));
+    osd_info.reset(new vector<osd_info_t>(*o.osd_info));
+    osd_xinfo.reset(new vector<osd_xinfo_t>(*o.osd_xinfo));
+    if (o.osd_primary_affinity)
+      osd_primary_affinity.reset(
+	new vector<__u32>(*o.osd_primary_affinity));
 
     // NOTE: this still references shared entity_addr_t's.
     osd_addrs.reset(new addrs_s(*o.osd_addrs));
@@ -329,30 +347,30 @@ public:
 
   int get_state(int o) const {
     assert(o < max_osd);
-    return osd_state[o];
+    return (*osd_state)[o];
   }
   int get_state(int o, set<string>& st) const {
     assert(o < max_osd);
-    unsigned t = osd_state[o];
+    unsigned t = (*osd_state)[o];
     calc_state_set(t, st);
-    return osd_state[o];
+    return (*osd_state)[o];
   }
   void set_state(int o, unsigned s) {
     assert(o < max_osd);
-    osd_state[o] = s;
+    (*osd_state)[o] = s;
   }
   void set_weightf(int o, float w) {
     set_weight(o, (int)((float)CEPH_OSD_IN * w));
   }
   void set_weight(int o, unsigned w) {
     assert(o < max_osd);
-    osd_weight[o] = w;
+    (*osd_weight)[o] = w;
     if (w)
-      osd_state[o] |= CEPH_OSD_EXISTS;
+      (*osd_state)[o] |= CEPH_OSD_EXISTS;
   }
   unsigned get_weight(int o) const {
     assert(o < max_osd);
-    return osd_weight[o];
+    return (*osd_weight)[o];
   }
   float get_weightf(int o) const {
     return (float)get_weight(o) / (float)CEPH_OSD_IN;
@@ -403,11 +421,11 @@ public:
 
   bool exists(int osd) const {
     //assert(osd >= 0);
-    return osd >= 0 && osd < max_osd && (osd_state[osd] & CEPH_OSD_EXISTS);
+    return osd >= 0 && osd < max_osd && ((*osd_state)[osd] & CEPH_OSD_EXISTS);
   }
 
   bool is_up(int osd) const {
-    return exists(osd) && (osd_state[osd] & CEPH_OSD_UP);
+    return exists(osd) && ((*osd_state)[osd] & CEPH_OSD_UP);
   }
 
   bool is_down(int osd) const {
@@ -480,24 +498,24 @@ public:
 
   const epoch_t& get_up_from(int osd) const {
     assert(exists(osd));
-    return osd_info[osd].up_from;
+    return (*osd_info)[osd].up_from;
   }
   const epoch_t& get_up_thru(int osd) const {
     assert(exists(osd));
-    return osd_info[osd].up_thru;
+    return (*osd_info)[osd].up_thru;
   }
   const epoch_t& get_down_at(int osd) const {
     assert(exists(osd));
-    return osd_info[osd].down_at;
+    return (*osd_info)[osd].down_at;
   }
   const osd_info_t& get_info(int osd) const {
     assert(osd < max_osd);
-    return osd_info[osd];
+    return (*osd_info)[osd];
   }
 
   const osd_xinfo_t& get_xinfo(int osd) const {
     assert(osd < max_osd);
-    return osd_xinfo[osd];
+    return (*osd_xinfo)[osd];
   }
   
   int get_any_up_osd() const {
@@ -622,7 +640,36 @@ private:
   void _pg_to_up_acting_osds(pg_t pg, vector<int> *up, int *up_primary,
                              vector<int> *acting, int *acting_primary) const;
 
+  /// a memoized pg mapping
+  struct pg_mapping_t {
+    vector<int> up;
+    vector<int> acting;
+    int up_primary;
+    int acting_primary;
+    pg_mapping_t() : up_primary(-1), acting_primary(-1) {}
+  };
+
+  /**
+   * Memoized pg -> up/acting mappings, with hit/miss counters.
+   *
+   * A published OSDMap never changes, so a computed mapping stays
+   * valid for the life of the map; decode, apply_incremental and
+   * deepish_copy_from swap in a fresh cache.  Held by pointer so that
+   * the lock does not make OSDMap uncopyable.
+   */
+  struct mapping_cache_t {
+    Spinlock lock;
+    ceph::unordered_map<pg_t, pg_mapping_t> mappings;
+    atomic_t hits, misses;
+  };
+  ceph::shared_ptr<mapping_cache_t> mapping_cache;
+
 public:
+  void get_mapping_cache_stats(uint64_t *hits, uint64_t *misses) const {
+    *hits = mapping_cache->hits.read();
+    *misses = mapping_cache->misses.read();
+  }
+
   /***
    * This is suitable only for looking at raw CRUSH outputs. It skips
    * applying the temp and up checks and should not be used
@@ -661,6 +708,20 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /**
+   * map a batch of pgs to their up and acting sets in one pass.
+   *
+   * Groups the pgs by pool so each pool's crush rule is looked up and
+   * executed once via do_rule_batch(); results are identical to
+   * calling pg_to_up_acting_osds() per pg.  Meant for full-map walks
+   * like the monitor's creating-pg placement.  All pointers must be
+   * non-NULL; outputs are indexed like @p pgs.
+   */
+  void pg_to_up_acting_osds_batch(const vector<pg_t>& pgs,
+				  vector<vector<int> > *up,
+				  vector<int> *up_primary,
+				  vector<vector<int> > *acting,
+				  vector<int> *acting_primary) const;
   bool pg_is_ec(pg_t pg) const {
     map<int64_t, pg_pool_t>::const_iterator i = pools.find(pg.pool());
     assert(i != pools.end());
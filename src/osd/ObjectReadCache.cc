@@ -0,0 +1,79 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2014 Inktank <info@inktank.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "ObjectReadCache.h"
+
+ObjectReadCache::ObjectReadCache(uint64_t max_size, uint32_t num_shards)
+{
+  if (num_shards == 0)
+    num_shards = 1;
+  shard_max = max_size / num_shards;
+  for (uint32_t i = 0; i < num_shards; ++i)
+    shards.push_back(new Shard);
+}
+
+ObjectReadCache::~ObjectReadCache()
+{
+  for (vector<Shard*>::iterator s = shards.begin(); s != shards.end(); ++s) {
+    for (map<Key, Entry*>::iterator p = (*s)->contents.begin();
+	 p != (*s)->contents.end();
+	 ++p)
+      delete p->second;
+    delete *s;
+  }
+}
+
+bool ObjectReadCache::lookup(const hobject_t &oid, eversion_t version,
+			     uint64_t offset, uint64_t length,
+			     bufferlist *out)
+{
+  Shard *s = shard_of(oid);
+  Mutex::Locker l(s->lock);
+  map<Key, Entry*>::iterator p =
+    s->contents.find(Key(oid, version, offset, length));
+  if (p == s->contents.end())
+    return false;
+  s->lru.push_front(&p->second->lru_item);
+  out->append(p->second->data);
+  return true;
+}
+
+void ObjectReadCache::insert(const hobject_t &oid, eversion_t version,
+			     uint64_t offset, uint64_t length,
+			     const bufferlist &bl)
+{
+  if (bl.length() > shard_max)
+    return;
+  Shard *s = shard_of(oid);
+  Mutex::Locker l(s->lock);
+  Key k(oid, version, offset, length);
+  if (s->contents.count(k))
+    return;
+  Entry *e = new Entry(k);
+  e->data = bl;
+  s->contents[k] = e;
+  s->lru.push_front(&e->lru_item);
+  s->size += bl.length();
+  trim(s);
+}
+
+void ObjectReadCache::trim(Shard *s)
+{
+  while (s->size > shard_max && !s->lru.empty()) {
+    Entry *e = s->lru.back();
+    s->size -= e->data.length();
+    s->contents.erase(e->key);
+    delete e;
+  }
+}
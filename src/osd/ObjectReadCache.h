@@ -0,0 +1,103 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2014 Inktank <info@inktank.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_OBJECTREADCACHE_H
+#define CEPH_OSD_OBJECTREADCACHE_H
+
+#include <map>
+#include <vector>
+
+#include "include/buffer.h"
+#include "include/xlist.h"
+#include "common/Mutex.h"
+#include "common/hobject.h"
+#include "osd/osd_types.h"
+
+/**
+ * in-memory cache of recently read object extents
+ *
+ * Entries are keyed by (object, object version, offset, length).
+ * Putting the version in the key means a write simply strands the
+ * entries for the previous version and the lru reclaims them, so no
+ * invalidation hooks are needed anywhere in the write or recovery
+ * paths.  The table is sharded by object hash so op threads do not
+ * contend on a single lock.
+ */
+class ObjectReadCache {
+public:
+  struct Key {
+    hobject_t oid;
+    eversion_t version;
+    uint64_t offset;
+    uint64_t length;
+    Key() : offset(0), length(0) {}
+    Key(const hobject_t &o, eversion_t v, uint64_t off, uint64_t len)
+      : oid(o), version(v), offset(off), length(len) {}
+    bool operator<(const Key &r) const {
+      if (oid < r.oid)
+	return true;
+      if (r.oid < oid)
+	return false;
+      if (version != r.version)
+	return version < r.version;
+      if (offset != r.offset)
+	return offset < r.offset;
+      return length < r.length;
+    }
+  };
+
+private:
+  struct Entry {
+    Key key;
+    bufferlist data;
+    xlist<Entry*>::item lru_item;
+    Entry(const Key &k) : key(k), lru_item(this) {}
+  };
+
+  struct Shard {
+    Mutex lock;
+    map<Key, Entry*> contents;
+    xlist<Entry*> lru;   ///< front is most recently used
+    uint64_t size;       ///< cached bytes
+    Shard() : lock("ObjectReadCache::shard_lock"), size(0) {}
+  };
+
+  vector<Shard*> shards;
+  uint64_t shard_max;    ///< byte limit per shard
+
+  Shard *shard_of(const hobject_t &oid) const {
+    return shards[oid.hash % shards.size()];
+  }
+
+  /// evict from the cold end until the shard fits; lock held
+  void trim(Shard *s);
+
+public:
+  ObjectReadCache(uint64_t max_size, uint32_t num_shards);
+  ~ObjectReadCache();
+
+  bool enabled() const {
+    return shard_max > 0;
+  }
+
+  /// @return true and append the cached data to out on a hit
+  bool lookup(const hobject_t &oid, eversion_t version,
+	      uint64_t offset, uint64_t length, bufferlist *out);
+
+  /// cache the result of a read; a no-op if the extent is already in
+  void insert(const hobject_t &oid, eversion_t version,
+	      uint64_t offset, uint64_t length, const bufferlist &bl);
+};
+
+#endif
@@ -0,0 +1,100 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2014 Inktank <info@inktank.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "OpCapture.h"
+#include "messages/MOSDOp.h"
+#include "common/debug.h"
+#include "common/errno.h"
+
+#define dout_subsys ceph_subsys_osd
+
+// flush in big chunks so capture costs one write() per many ops
+static const unsigned CAPTURE_FLUSH_BYTES = 65536;
+
+int OpCapture::start(const string &path, uint64_t e)
+{
+  Mutex::Locker l(lock);
+  if (fd >= 0)
+    return -EINVAL;
+  fd = TEMP_FAILURE_RETRY(::open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644));
+  if (fd < 0)
+    return -errno;
+  every = e ? e : 1;
+  seen = 0;
+
+  bufferlist header;
+  ::encode((__u32)OP_CAPTURE_MAGIC, header);
+  ::encode((__u32)OP_CAPTURE_VERSION, header);
+  int r = header.write_fd(fd);
+  if (r < 0) {
+    TEMP_FAILURE_RETRY(::close(fd));
+    fd = -1;
+    return r;
+  }
+  dout(1) << "op capture started, file " << path
+	  << ", recording every " << every
+	  << (every == 1 ? "st" : "th") << " op" << dendl;
+  return 0;
+}
+
+void OpCapture::flush()
+{
+  assert(lock.is_locked());
+  if (pending.length() == 0)
+    return;
+  int r = pending.write_fd(fd);
+  if (r < 0)
+    derr << "op capture write failed: " << cpp_strerror(r) << dendl;
+  pending.clear();
+}
+
+void OpCapture::stop()
+{
+  Mutex::Locker l(lock);
+  if (fd < 0)
+    return;
+  flush();
+  TEMP_FAILURE_RETRY(::close(fd));
+  fd = -1;
+  dout(1) << "op capture stopped after " << seen << " ops seen" << dendl;
+}
+
+void OpCapture::capture(MOSDOp *m)
+{
+  Mutex::Locker l(lock);
+  if (fd < 0)
+    return;
+  if (seen++ % every)
+    return;
+
+  captured_op_t rec;
+  rec.stamp = ceph_clock_now(cct);
+  rec.flags = m->get_flags();
+  rec.oid = m->get_oid().name;
+  rec.ops.reserve(m->ops.size());
+  for (vector<OSDOp>::iterator p = m->ops.begin(); p != m->ops.end(); ++p) {
+    captured_subop_t sub;
+    sub.op = p->op.op;
+    sub.offset = p->op.extent.offset;
+    sub.length = p->op.extent.length;
+    rec.ops.push_back(sub);
+  }
+  ::encode(rec, pending);
+  if (pending.length() >= CAPTURE_FLUSH_BYTES)
+    flush();
+}
@@ -0,0 +1,118 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2014 Inktank <info@inktank.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_OPCAPTURE_H
+#define CEPH_OSD_OPCAPTURE_H
+
+#include "include/types.h"
+#include "include/utime.h"
+#include "common/Mutex.h"
+
+class MOSDOp;
+
+/**
+ * one sub-op of a captured client op
+ *
+ * Only the shape of the op is recorded (opcode, offset, length),
+ * never the payload; that is all a replayer needs to reproduce the
+ * traffic pattern and it keeps the trace compact.
+ */
+struct captured_subop_t {
+  __u16 op;         ///< CEPH_OSD_OP_*
+  uint64_t offset;
+  uint64_t length;
+
+  captured_subop_t() : op(0), offset(0), length(0) {}
+
+  void encode(bufferlist &bl) const {
+    ::encode(op, bl);
+    ::encode(offset, bl);
+    ::encode(length, bl);
+  }
+  void decode(bufferlist::iterator &bl) {
+    ::decode(op, bl);
+    ::decode(offset, bl);
+    ::decode(length, bl);
+  }
+};
+WRITE_CLASS_ENCODER(captured_subop_t)
+
+/**
+ * one captured client op, as seen by OSD::handle_op
+ */
+struct captured_op_t {
+  utime_t stamp;    ///< arrival time at the OSD
+  __u32 flags;      ///< CEPH_OSD_FLAG_*
+  string oid;
+  vector<captured_subop_t> ops;
+
+  captured_op_t() : flags(0) {}
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(stamp, bl);
+    ::encode(flags, bl);
+    ::encode(oid, bl);
+    ::encode(ops, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &bl) {
+    DECODE_START(1, bl);
+    ::decode(stamp, bl);
+    ::decode(flags, bl);
+    ::decode(oid, bl);
+    ::decode(ops, bl);
+    DECODE_FINISH(bl);
+  }
+};
+WRITE_CLASS_ENCODER(captured_op_t)
+
+// trace file header
+#define OP_CAPTURE_MAGIC 0x4f505452u  /* 'OPTR' */
+#define OP_CAPTURE_VERSION 1u
+
+/**
+ * record sampled client ops to a compact binary trace file
+ *
+ * One instance per OSD.  start() is called from OSD::init() before
+ * client ops flow, so the unlocked enabled() check on the fast path is
+ * safe; capture() takes one mutex and usually just appends to a memory
+ * buffer which is flushed to disk in large chunks.
+ */
+class OpCapture {
+  CephContext *cct;
+  Mutex lock;
+  int fd;
+  uint64_t every;   ///< record every Nth op
+  uint64_t seen;    ///< ops offered so far
+  bufferlist pending;
+
+  void flush();     ///< requires lock
+
+public:
+  OpCapture(CephContext *cct)
+    : cct(cct), lock("OpCapture::lock"), fd(-1), every(1), seen(0) {}
+  ~OpCapture() {
+    stop();
+  }
+
+  int start(const string &path, uint64_t every);
+  void stop();
+  bool enabled() const {
+    return fd >= 0;
+  }
+  void capture(MOSDOp *m);
+};
+
+#endif
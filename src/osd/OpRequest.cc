@@ -17,6 +17,7 @@
 OpRequest::OpRequest(Message *req, OpTracker *tracker) :
   TrackedOp(tracker, req->get_recv_stamp()),
   rmw_flags(0), request(req),
+  traced(false),
   hit_flag_points(0), latest_flag_point(0),
   send_map_update(false), sent_epoch(0) {
   if (req->get_priority() < tracker->cct->_conf->osd_client_op_priority) {
@@ -24,9 +25,13 @@ OpRequest::OpRequest(Message *req, OpTracker *tracker) :
     warn_interval_multiplier = tracker->cct->_conf->osd_recovery_op_warn_multiple;
   }
   if (req->get_type() == CEPH_MSG_OSD_OP) {
-    reqid = static_cast<MOSDOp*>(req)->get_reqid();
+    MOSDOp *m = static_cast<MOSDOp*>(req);
+    reqid = m->get_reqid();
+    traced = (m->get_flags() & CEPH_OSD_FLAG_TRACE);
   } else if (req->get_type() == MSG_OSD_SUBOP) {
-    reqid = static_cast<MOSDSubOp*>(req)->reqid;
+    MOSDSubOp *m = static_cast<MOSDSubOp*>(req);
+    reqid = m->reqid;
+    traced = m->traced;
   }
   tracker->_mark_event(this, "header_read", request->get_recv_stamp());
   tracker->_mark_event(this, "throttled", request->get_throttle_stamp());
@@ -77,6 +77,7 @@ struct OpRequest : public TrackedOp {
 private:
   Message *request; /// the logical request we are tracking
   osd_reqid_t reqid;
+  bool traced;     /// request carried CEPH_OSD_FLAG_TRACE
   uint8_t hit_flag_points;
   uint8_t latest_flag_point;
   utime_t dequeued_time;
@@ -174,6 +175,10 @@ public:
     return reqid;
   }
 
+  bool is_traced() const {
+    return traced;
+  }
+
   typedef ceph::shared_ptr<OpRequest> Ref;
 };
 
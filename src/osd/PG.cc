@@ -190,6 +190,9 @@ PG::PG(OSDService *o, OSDMapRef curmap,
   flushes_in_progress(0),
   pg_stats_publish_lock("PG::pg_stats_publish_lock"),
   pg_stats_publish_valid(false),
+  pg_stats_publish(&pg_stats_publish_buf[0]),
+  pg_stats_sent_seq(0),
+  pg_stats_sent_epoch(0),
   osr(osd->osr_registry.lookup_or_create(p, (stringify(p)))),
   finish_sync_event(NULL),
   scrub_after_recovery(false),
@@ -1697,7 +1700,7 @@ void PG::take_op_map_waiters()
     if (op_must_wait_for_map(get_osdmap_with_maplock(), *i)) {
       break;
     } else {
-      osd->op_wq.queue(make_pair(PGRef(this), *i));
+      osd->queue_op(PGRef(this), *i);
       waiting_for_map.erase(i++);
     }
   }
@@ -1715,7 +1718,7 @@ void PG::queue_op(OpRequestRef op)
     waiting_for_map.push_back(op);
     return;
   }
-  osd->op_wq.queue(make_pair(PGRef(this), op));
+  osd->queue_op(PGRef(this), op);
 }
 
 void PG::replay_queued_ops()
@@ -2241,48 +2244,56 @@ void PG::_update_calc_stats()
 
 void PG::publish_stats_to_osd()
 {
-  pg_stats_publish_lock.Lock();
-  if (is_primary()) {
-    // update our stat summary
-    info.stats.reported_epoch = get_osdmap()->get_epoch();
-    ++info.stats.reported_seq;
+  if (!is_primary()) {
+    Mutex::Locker l(pg_stats_publish_lock);
+    pg_stats_publish_valid = false;
+    dout(15) << "publish_stats_to_osd -- not primary" << dendl;
+    return;
+  }
 
-    if (info.stats.stats.sum.num_scrub_errors)
-      state_set(PG_STATE_INCONSISTENT);
-    else
-      state_clear(PG_STATE_INCONSISTENT);
-
-    utime_t now = ceph_clock_now(cct);
-    info.stats.last_fresh = now;
-    if (info.stats.state != state) {
-      info.stats.state = state;
-      info.stats.last_change = now;
-      if ((state & PG_STATE_ACTIVE) &&
-	  !(info.stats.state & PG_STATE_ACTIVE))
-	info.stats.last_became_active = now;
-    }
-    if (info.stats.state & PG_STATE_CLEAN)
-      info.stats.last_clean = now;
-    if (info.stats.state & PG_STATE_ACTIVE)
-      info.stats.last_active = now;
-    info.stats.last_unstale = now;
+  // update our stat summary; we hold the PG lock, so info.stats is ours
+  info.stats.reported_epoch = get_osdmap()->get_epoch();
+  ++info.stats.reported_seq;
 
-    _update_calc_stats();
+  if (info.stats.stats.sum.num_scrub_errors)
+    state_set(PG_STATE_INCONSISTENT);
+  else
+    state_clear(PG_STATE_INCONSISTENT);
 
-    pg_stats_publish_valid = true;
-    pg_stats_publish = info.stats;
-    pg_stats_publish.stats.add(unstable_stats);
+  utime_t now = ceph_clock_now(cct);
+  info.stats.last_fresh = now;
+  if (info.stats.state != state) {
+    info.stats.state = state;
+    info.stats.last_change = now;
+    if ((state & PG_STATE_ACTIVE) &&
+	!(info.stats.state & PG_STATE_ACTIVE))
+      info.stats.last_became_active = now;
+  }
+  if (info.stats.state & PG_STATE_CLEAN)
+    info.stats.last_clean = now;
+  if (info.stats.state & PG_STATE_ACTIVE)
+    info.stats.last_active = now;
+  info.stats.last_unstale = now;
+
+  _update_calc_stats();
+
+  // fill the inactive slot without holding the publish lock (the
+  // flusher only ever reads the active one; the PG lock serializes
+  // writers), then flip under the lock
+  pg_stat_t *next = (pg_stats_publish == &pg_stats_publish_buf[0]) ?
+    &pg_stats_publish_buf[1] : &pg_stats_publish_buf[0];
+  next->publish_copy(info.stats);
+  next->stats.add(unstable_stats);
+
+  dout(15) << "publish_stats_to_osd " << next->reported_epoch
+	   << ":" << next->reported_seq << dendl;
 
-    dout(15) << "publish_stats_to_osd " << pg_stats_publish.reported_epoch
-	     << ":" << pg_stats_publish.reported_seq << dendl;
-  } else {
-    pg_stats_publish_valid = false;
-    dout(15) << "publish_stats_to_osd -- not primary" << dendl;
-  }
+  pg_stats_publish_lock.Lock();
+  pg_stats_publish = next;
+  pg_stats_publish_valid = true;
   pg_stats_publish_lock.Unlock();
 
-  if (is_primary())
-    osd->pg_stat_queue_enqueue(this);
+  osd->pg_stat_queue_enqueue(this);
 }
 
 void PG::clear_publish_stats()
@@ -2903,7 +2914,7 @@ void PG::requeue_object_waiters(map<hobject_t, list<OpRequestRef> >& m)
 
 void PG::requeue_op(OpRequestRef op)
 {
-  osd->op_wq.queue_front(make_pair(PGRef(this), op));
+  osd->queue_op_front(PGRef(this), op);
 }
 
 void PG::requeue_ops(list<OpRequestRef> &ls)
@@ -2912,7 +2923,7 @@ void PG::requeue_ops(list<OpRequestRef> &ls)
   for (list<OpRequestRef>::reverse_iterator i = ls.rbegin();
        i != ls.rend();
        ++i) {
-    osd->op_wq.queue_front(make_pair(PGRef(this), *i));
+    osd->queue_op_front(PGRef(this), *i);
   }
   ls.clear();
 }
@@ -3512,6 +3523,25 @@ void PG::scrub(ThreadPool::TPHandle &handle)
     return;
   }
 
+  // give client io a chance to get at the pg between chunks
+  if (cct->_conf->osd_scrub_sleep > 0 &&
+      (scrubber.state == PG::Scrubber::NEW_CHUNK ||
+       scrubber.state == PG::Scrubber::INACTIVE)) {
+    dout(20) << __func__ << " state is INACTIVE|NEW_CHUNK, sleeping" << dendl;
+    unlock();
+    utime_t t;
+    t.set_from_double(cct->_conf->osd_scrub_sleep);
+    handle.suspend_tp_timeout();
+    t.sleep();
+    handle.reset_tp_timeout();
+    lock();
+    dout(20) << __func__ << " slept for " << t << dendl;
+    if (deleting) {
+      unlock();
+      return;
+    }
+  }
+
   if (!is_primary() || !is_active() || !is_clean() || !is_scrubbing()) {
     dout(10) << "scrub -- not primary or active or not clean" << dendl;
     state_clear(PG_STATE_SCRUBBING);
@@ -3677,12 +3707,26 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 
           bool boundary_found = false;
           hobject_t start = scrubber.start;
+
+	  // explicit memory bound: if the last chunk's map entries were
+	  // large (attrs, digests), shrink this chunk's object count so
+	  // the in-memory maps stay near osd_scrub_chunk_max_bytes
+	  int list_max = cct->_conf->osd_scrub_chunk_max;
+	  if (scrubber.chunk_avg_object_bytes) {
+	    uint64_t cap = cct->_conf->osd_scrub_chunk_max_bytes /
+	      scrubber.chunk_avg_object_bytes;
+	    if (cap < (uint64_t)cct->_conf->osd_scrub_chunk_min)
+	      cap = cct->_conf->osd_scrub_chunk_min;
+	    if ((uint64_t)list_max > cap)
+	      list_max = cap;
+	  }
+
           while (!boundary_found) {
             vector<hobject_t> objects;
             ret = get_pgbackend()->objects_list_partial(
 	      start,
 	      cct->_conf->osd_scrub_chunk_min,
-	      cct->_conf->osd_scrub_chunk_max,
+	      list_max,
 	      0,
 	      &objects,
 	      &candidate_end);
@@ -3714,6 +3758,8 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 	    dout(10) << __func__ << ": scrub blocked somewhere in range "
 		     << "[" << scrubber.start << ", " << candidate_end << ")"
 		     << dendl;
+	    // might as well compare the last chunk while we wait
+	    scrub_compare_deferred();
 	    done = true;
 	    break;
 	  }
@@ -3747,6 +3793,10 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 
         scrubber.state = PG::Scrubber::WAIT_PUSHES;
 
+        // now that the replicas are off scanning this chunk, compare the
+        // previous one
+        scrub_compare_deferred();
+
         break;
 
       case PG::Scrubber::WAIT_PUSHES:
@@ -3783,6 +3833,25 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
           return;
         }
 
+	// remember this chunk's per-entry footprint so NEW_CHUNK can size
+	// the next one to the byte budget
+	if (!scrubber.primary_scrubmap.objects.empty()) {
+	  uint64_t bytes = 0;
+	  for (map<hobject_t, ScrubMap::object>::const_iterator p =
+		 scrubber.primary_scrubmap.objects.begin();
+	       p != scrubber.primary_scrubmap.objects.end();
+	       ++p) {
+	    bytes += sizeof(p->first) + sizeof(p->second);
+	    for (map<string, bufferptr>::const_iterator q =
+		   p->second.attrs.begin();
+		 q != p->second.attrs.end();
+		 ++q)
+	      bytes += q->first.length() + q->second.length();
+	  }
+	  scrubber.chunk_avg_object_bytes =
+	    bytes / scrubber.primary_scrubmap.objects.size();
+	}
+
         --scrubber.waiting_on;
         scrubber.waiting_on_whom.erase(pg_whoami);
 
@@ -3803,7 +3872,14 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
         assert(last_update_applied >= scrubber.subset_last_update);
         assert(scrubber.waiting_on == 0);
 
-        scrub_compare_maps();
+        // stash the finished chunk and unblock writes right away; the
+        // compare only looks at the stashed maps, and deferring it until
+        // the next chunk's map requests are out lets the replicas scan
+        // chunk n+1 while we compare chunk n
+        scrubber.compare_primary.swap(scrubber.primary_scrubmap);
+        scrubber.compare_received.swap(scrubber.received_maps);
+        scrubber.compare_pending = true;
+
         scrubber.block_writes = false;
 	scrubber.run_callbacks();
 
@@ -3818,6 +3894,7 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
           osd->scrub_wq.queue(this);
           done = true;
         } else {
+          scrub_compare_deferred();
           scrubber.state = PG::Scrubber::FINISH;
         }
 
@@ -3885,12 +3962,24 @@ bool PG::scrub_gather_replica_maps()
   }
 }
 
-void PG::scrub_compare_maps() 
+// compare the finished chunk stashed by chunky_scrub, if any
+void PG::scrub_compare_deferred()
+{
+  if (!scrubber.compare_pending)
+    return;
+  scrubber.compare_pending = false;
+  scrub_compare_maps(scrubber.compare_primary, scrubber.compare_received);
+  scrubber.compare_primary = ScrubMap();
+  scrubber.compare_received.clear();
+}
+
+void PG::scrub_compare_maps(ScrubMap &primary,
+			    map<pg_shard_t, ScrubMap> &received)
 {
   dout(10) << "scrub_compare_maps has maps, analyzing" << dendl;
 
   // construct authoritative scrub map for type specific scrubbing
-  ScrubMap authmap(scrubber.primary_scrubmap);
+  ScrubMap authmap(primary);
 
   if (acting.size() > 1) {
     dout(10) << "scrub  comparing replica scrub maps" << dendl;
@@ -3901,18 +3990,18 @@ void PG::scrub_compare_maps()
     map<hobject_t, pg_shard_t> authoritative;
     map<pg_shard_t, ScrubMap *> maps;
 
-    dout(2) << "scrub   osd." << acting[0] << " has " 
-	    << scrubber.primary_scrubmap.objects.size() << " items" << dendl;
-    maps[pg_whoami] = &scrubber.primary_scrubmap;
+    dout(2) << "scrub   osd." << acting[0] << " has "
+	    << primary.objects.size() << " items" << dendl;
+    maps[pg_whoami] = &primary;
 
     for (set<pg_shard_t>::iterator i = actingbackfill.begin();
 	 i != actingbackfill.end();
 	 ++i) {
       if (*i == pg_whoami) continue;
       dout(2) << "scrub replica " << *i << " has "
-	      << scrubber.received_maps[*i].objects.size()
+	      << received[*i].objects.size()
 	      << " items" << dendl;
-      maps[*i] = &scrubber.received_maps[*i];
+      maps[*i] = &received[*i];
     }
 
     get_pgbackend()->be_compare_scrubmaps(
@@ -4039,7 +4128,7 @@ void PG::scrub_finalize()
     return;
   }
 
-  scrub_compare_maps();
+  scrub_compare_maps(scrubber.primary_scrubmap, scrubber.received_maps);
 
   scrub_finish();
 
@@ -4738,8 +4827,9 @@ bool PG::can_discard_op(OpRequestRef op)
     return true;
   }
 
-  if ((m->get_flags() & (CEPH_OSD_FLAG_BALANCE_READS |
-			 CEPH_OSD_FLAG_LOCALIZE_READS)) &&
+  if (((m->get_flags() & (CEPH_OSD_FLAG_BALANCE_READS |
+			  CEPH_OSD_FLAG_LOCALIZE_READS)) ||
+       (pool.info.flags & pg_pool_t::FLAG_BALANCE_READS)) &&
       op->may_read() &&
       !(op->may_write() || op->may_cache())) {
     // balanced reads; any replica will do
@@ -4956,6 +5046,16 @@ void PG::queue_peering_event(CephPeeringEvtRef evt)
 {
   if (old_peering_evt(evt))
     return;
+  // a null event only exists to push the pg through advance_pg, and
+  // advance_pg always catches up to the newest map, so consecutive
+  // nulls collapse into the latest one.  during an osdmap storm this
+  // leaves one queued event per pg instead of one per epoch.
+  if (!peering_queue.empty() &&
+      dynamic_cast<const NullEvt *>(&evt->get_event()) &&
+      dynamic_cast<const NullEvt *>(&peering_queue.back()->get_event())) {
+    peering_queue.back() = evt;
+    return;
+  }
   peering_queue.push_back(evt);
   osd->queue_for_peering(this);
 }
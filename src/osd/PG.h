@@ -676,7 +676,20 @@ protected:
   // publish stats
   Mutex pg_stats_publish_lock;
   bool pg_stats_publish_valid;
-  pg_stat_t pg_stats_publish;
+  /**
+   * Double-buffered copy of info.stats for the flusher.  The PG (which
+   * holds its own lock) fills the inactive slot without taking
+   * pg_stats_publish_lock and then flips pg_stats_publish to it under
+   * the lock, so readers only contend for the flip, never the copy.
+   * The slots are long lived, so per-op publication reuses their
+   * collections' memory instead of reallocating it each time.
+   */
+  pg_stat_t pg_stats_publish_buf[2];
+  pg_stat_t *pg_stats_publish;   ///< active slot; flipped under the lock
+  /// version last included in a report to the mon; lets the OSD skip
+  /// unchanged pgs instead of resending them until the ack arrives
+  version_t pg_stats_sent_seq;
+  epoch_t pg_stats_sent_epoch;
 
   // for ordering writes
   ceph::shared_ptr<ObjectStore::Sequencer> osr;
@@ -945,6 +958,7 @@ public:
       epoch_start(0),
       block_writes(false), active(false), queue_snap_trim(false),
       waiting_on(0), shallow_errors(0), deep_errors(0), fixed(0),
+      chunk_avg_object_bytes(0), compare_pending(false),
       active_rep_scrub(0),
       must_scrub(false), must_deep_scrub(false), must_repair(false),
       state(INACTIVE),
@@ -968,6 +982,17 @@ public:
     int fixed;
     ScrubMap primary_scrubmap;
     map<pg_shard_t, ScrubMap> received_maps;
+
+    /// approx per-entry footprint of the last chunk's primary map, used
+    /// to size the next chunk against osd_scrub_chunk_max_bytes
+    uint64_t chunk_avg_object_bytes;
+
+    /// maps from the chunk just finished, stashed so the compare can run
+    /// while the replicas scan the next chunk
+    bool compare_pending;
+    ScrubMap compare_primary;
+    map<pg_shard_t, ScrubMap> compare_received;
+
     MOSDRepScrub *active_rep_scrub;
     utime_t scrub_reg_stamp;  // stamp we registered for
 
@@ -1057,6 +1082,10 @@ public:
         active_rep_scrub = NULL;
       }
       received_maps.clear();
+      chunk_avg_object_bytes = 0;
+      compare_pending = false;
+      compare_primary = ScrubMap();
+      compare_received.clear();
 
       must_scrub = false;
       must_deep_scrub = false;
@@ -1090,7 +1119,9 @@ public:
   void scrub(ThreadPool::TPHandle &handle);
   void classic_scrub(ThreadPool::TPHandle &handle);
   void chunky_scrub(ThreadPool::TPHandle &handle);
-  void scrub_compare_maps();
+  void scrub_compare_maps(ScrubMap &primary,
+			  map<pg_shard_t, ScrubMap> &received);
+  void scrub_compare_deferred();
   void scrub_process_inconsistent();
   void scrub_finalize();
   void scrub_finish();
@@ -2123,6 +2154,7 @@ public:
   virtual void on_shutdown() = 0;
   virtual void check_blacklisted_watchers() = 0;
   virtual void get_watchers(std::list<obj_watch_item_t>&) = 0;
+  virtual void dump_snap_trimmer(Formatter *f) = 0;
 
   virtual bool agent_work(int max) = 0;
   virtual void agent_stop() = 0;
@@ -179,6 +179,11 @@
        bool transaction_applied,
        ObjectStore::Transaction *t) = 0;
 
+     /// record logv's objects in the local missing set; their data
+     /// update was not applied and recovery has to push them
+     virtual void update_local_missing(
+       const vector<pg_log_entry_t> &logv) = 0;
+
      virtual void update_peer_last_complete_ondisk(
        pg_shard_t fromosd,
        eversion_t lcod) = 0;
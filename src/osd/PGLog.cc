@@ -55,7 +55,8 @@ void PGLog::IndexedLog::split_into(
 void PGLog::IndexedLog::trim(
   LogEntryHandler *handler,
   eversion_t s,
-  set<eversion_t> *trimmed)
+  set<eversion_t> *trimmed,
+  unsigned max_entries)
 {
   if (complete_to != log.end() &&
       complete_to->version <= s) {
@@ -63,16 +64,24 @@ void PGLog::IndexedLog::trim(
 		    << " on " << *this << dendl;
   }
 
+  unsigned count = 0;
   while (!log.empty()) {
     pg_log_entry_t &e = *log.begin();
     if (e.version > s)
       break;
+    if (max_entries && count >= max_entries) {
+      // bounded trim; the tail already covers everything we removed,
+      // so the remainder is picked up by a later call
+      return;
+    }
     generic_dout(20) << "trim " << e << dendl;
     if (trimmed)
       trimmed->insert(e.version);
     handler->trim(e);
     unindex(e);         // remove from index,
-    log.pop_front();    // from log
+    tail = e.version;   // raise tail past the entry,
+    log.pop_front();    // and drop it from the log
+    count++;
   }
 
   // raise tail?
@@ -139,7 +148,8 @@ void PGLog::trim(
     assert(trim_to <= info.last_complete);
 
     dout(10) << "trim " << log << " to " << trim_to << dendl;
-    log.trim(handler, trim_to, &trimmed);
+    log.trim(handler, trim_to, &trimmed,
+	     cct ? cct->_conf->osd_pg_log_trim_max : 0);
     info.log_tail = log.tail;
   }
 }
@@ -151,10 +151,18 @@ struct PGLog {
 	caller_ops[e.reqid] = &(log.back());
     }
 
+    /**
+     * trim log entries up through s
+     *
+     * If max_entries is non-zero, at most that many entries are
+     * removed; the tail is raised past each entry as it goes, so a
+     * later trim to the same point continues where this one stopped.
+     */
     void trim(
       LogEntryHandler *handler,
       eversion_t s,
-      set<eversion_t> *trimmed);
+      set<eversion_t> *trimmed,
+      unsigned max_entries = 0);
 
     ostream& print(ostream& out) const;
   };
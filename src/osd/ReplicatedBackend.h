@@ -168,8 +168,13 @@ private:
     ObjectRecoveryInfo recovery_info;
     ObjectContextRef obc;
     object_stat_sum_t stat;
+    /// chunks sent but not yet acked; see osd_recovery_push_window
+    int outstanding;
+
+    PushInfo() : outstanding(0) {}
 
     void dump(Formatter *f) const {
+      f->dump_int("outstanding_chunks", outstanding);
       {
 	f->open_object_section("recovery_progress");
 	recovery_progress.dump(f);
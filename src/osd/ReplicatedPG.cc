@@ -431,6 +431,31 @@ bool ReplicatedPG::is_degraded_object(const hobject_t& soid)
   return false;
 }
 
+bool ReplicatedPG::async_recoverable_object(const hobject_t& soid)
+{
+  if (!cct->_conf->osd_async_recovery)
+    return false;
+  if (pool.info.ec_pool())
+    return false;     // shards cannot skip their part of the transaction
+  if (pg_log.get_missing().missing.count(soid))
+    return false;     // we do not have it ourselves
+  if (recovering.count(soid) ||
+      backfills_in_flight.count(soid))
+    return false;     // wait for the in-flight push instead
+  assert(actingbackfill.size() > 0);
+  for (set<pg_shard_t>::iterator i = actingbackfill.begin();
+       i != actingbackfill.end();
+       ++i) {
+    if (*i == get_primary()) continue;
+    // backfill targets cannot catch up through the log
+    if (is_backfill_targets(*i) &&
+	peer_missing.count(*i) &&
+	peer_missing[*i].missing.count(soid))
+      return false;
+  }
+  return true;
+}
+
 void ReplicatedPG::wait_for_degraded_object(const hobject_t& soid, OpRequestRef op)
 {
   assert(is_degraded_object(soid));
@@ -1235,7 +1260,8 @@ void ReplicatedPG::do_op(OpRequestRef op)
   }
 
   // degraded object?
-  if (write_ordered && is_degraded_object(head)) {
+  if (write_ordered && is_degraded_object(head) &&
+      !async_recoverable_object(head)) {
     wait_for_degraded_object(head, op);
     return;
   }
@@ -1250,7 +1276,8 @@ void ReplicatedPG::do_op(OpRequestRef op)
   }
 
   // degraded object?
-  if (write_ordered && is_degraded_object(snapdir)) {
+  if (write_ordered && is_degraded_object(snapdir) &&
+      !async_recoverable_object(snapdir)) {
     wait_for_degraded_object(snapdir, op);
     return;
   }
@@ -1317,7 +1344,8 @@ void ReplicatedPG::do_op(OpRequestRef op)
     // we have to wait for the object.
     if (is_primary() ||
 	(!(m->get_flags() & CEPH_OSD_FLAG_BALANCE_READS) &&
-	 !(m->get_flags() & CEPH_OSD_FLAG_LOCALIZE_READS))) {
+	 !(m->get_flags() & CEPH_OSD_FLAG_LOCALIZE_READS) &&
+	 !(pool.info.flags & pg_pool_t::FLAG_BALANCE_READS))) {
       // missing the specific snap we need; requeue and wait.
       assert(!op->may_write()); // only happens on a read/cache
       wait_for_unreadable_object(missing_oid, op);
@@ -1334,7 +1362,8 @@ void ReplicatedPG::do_op(OpRequestRef op)
     // degraded object?  (the check above was for head; this could be a clone)
     if (write_ordered &&
 	obc->obs.oi.soid.snap != CEPH_NOSNAP &&
-	is_degraded_object(obc->obs.oi.soid)) {
+	is_degraded_object(obc->obs.oi.soid) &&
+	!async_recoverable_object(obc->obs.oi.soid)) {
       dout(10) << __func__ << ": clone " << obc->obs.oi.soid
 	       << " is degraded, waiting" << dendl;
       wait_for_degraded_object(obc->obs.oi.soid, op);
@@ -1342,7 +1371,9 @@ void ReplicatedPG::do_op(OpRequestRef op)
     }
   }
 
+  bool in_hit_set = false;
   if (hit_set) {
+    in_hit_set = hit_set->contains(oid);
     hit_set->insert(oid);
     if (hit_set->is_full() ||
 	hit_set_start_stamp + pool.info.hit_set_period <= m->get_recv_stamp()) {
@@ -1495,10 +1526,11 @@ void ReplicatedPG::do_op(OpRequestRef op)
   }
 
   OpContext *ctx = new OpContext(op, m->get_reqid(), m->ops,
-				 &obc->obs, obc->ssc, 
+				 &obc->obs, obc->ssc,
 				 this);
   ctx->op_t = pgbackend->get_transaction();
   ctx->obc = obc;
+  ctx->in_hit_set = in_hit_set;
 
   if (!obc->obs.exists)
     ctx->snapset_obc = get_object_context(obc->obs.oi.soid.get_snapdir(), false);
@@ -1796,6 +1828,43 @@ void ReplicatedPG::execute_ctx(OpContext *ctx)
     return;
   }
 
+  // a degraded write may have come this far on the strength of
+  // async_recoverable_object(); a replica missing an object this
+  // transaction touches skips the whole data update and catches up
+  // through recovery.  That cannot cover a delete -- the missing set
+  // only describes objects to push -- so if the op turned out to log
+  // one, fall back to waiting for recovery after all.
+  if (cct->_conf->osd_async_recovery) {
+    bool logs_delete = false;
+    for (vector<pg_log_entry_t>::iterator p = ctx->log.begin();
+	 p != ctx->log.end();
+	 ++p) {
+      if (p->is_delete())
+	logs_delete = true;
+    }
+    if (logs_delete) {
+      for (vector<pg_log_entry_t>::iterator p = ctx->log.begin();
+	   p != ctx->log.end();
+	   ++p) {
+	for (set<pg_shard_t>::iterator i = actingbackfill.begin();
+	     i != actingbackfill.end();
+	     ++i) {
+	  if (*i == get_primary()) continue;
+	  if (peer_missing.count(*i) &&
+	      peer_missing[*i].is_missing(p->soid) &&
+	      should_send_op(*i, p->soid)) {
+	    dout(10) << __func__ << " transaction deletes and " << p->soid
+		     << " is missing on " << *i
+		     << "; waiting for recovery" << dendl;
+	    wait_for_degraded_object(p->soid, op);
+	    close_op_ctx(ctx, -EAGAIN);
+	    return;
+	  }
+	}
+      }
+    }
+  }
+
   bool successful_write = !ctx->op_t->empty() && op->may_write() && result >= 0;
   // prepare the reply
   ctx->reply = new MOSDOpReply(m, 0, get_osdmap()->get_epoch(), 0,
@@ -2557,6 +2626,32 @@ void ReplicatedPG::snap_trimmer()
   return;
 }
 
+void ReplicatedPG::dump_snap_trimmer(Formatter *f)
+{
+  // caller verified there is work queued or in progress; must hold pg lock
+  f->open_object_section("pg");
+  f->dump_stream("pgid") << info.pgid;
+  f->dump_string("state", snap_trimmer_machine.current_state);
+  f->dump_stream("snap_trimq") << snap_trimq;
+  f->dump_stream("snap_to_trim") << snap_trimmer_machine.snap_to_trim;
+  f->dump_unsigned("objects_trimmed", snap_trimmer_machine.objects_trimmed);
+  f->dump_unsigned("bytes_trimmed", snap_trimmer_machine.bytes_trimmed);
+  utime_t elapsed = ceph_clock_now(cct) - snap_trimmer_machine.trim_start;
+  f->dump_float("elapsed_sec", elapsed);
+  double rate = 0.0;
+  if (elapsed > 0.0)
+    rate = snap_trimmer_machine.objects_trimmed / (double)elapsed;
+  f->dump_float("objects_per_sec", rate);
+  // clone count is an upper bound on what is left for this snap, so this
+  // is a worst-case estimate
+  uint64_t clones_left = info.stats.stats.sum.num_object_clones;
+  if (rate > 0.0)
+    f->dump_float("eta_sec", clones_left / rate);
+  else
+    f->dump_float("eta_sec", -1.0);
+  f->close_section();
+}
+
 int ReplicatedPG::do_xattr_cmp_u64(int op, __u64 v1, bufferlist& xattr)
 {
   __u64 v2;
@@ -3035,7 +3130,15 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	      make_pair(op.extent.offset, op.extent.length),
 	      make_pair(&osd_op.outdata, new FillInExtent(&op.extent.length))));
 	  dout(10) << " async_read noted for " << soid << dendl;
+	} else if (osd->read_cache.enabled() &&
+		   osd->read_cache.lookup(soid, oi.version, op.extent.offset,
+					  op.extent.length, &osd_op.outdata)) {
+	  op.extent.length = osd_op.outdata.length();
+	  osd->logger->inc(l_osd_rdcache_hit);
+	  dout(10) << " read got " << op.extent.length
+		   << " bytes from read cache for obj " << soid << dendl;
 	} else {
+	  uint64_t read_len = op.extent.length;
 	  int r = pgbackend->objects_read_sync(
 	    soid, op.extent.offset, op.extent.length, &osd_op.outdata);
 	  if (r >= 0)
@@ -3044,6 +3147,16 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	    result = r;
 	    op.extent.length = 0;
 	  }
+	  if (osd->read_cache.enabled()) {
+	    osd->logger->inc(l_osd_rdcache_miss);
+	    // only admit objects the hit set had already seen before
+	    // this op; one-off reads (backups, scans) stay out
+	    if (r > 0 && ctx->in_hit_set &&
+		osd_op.outdata.length() == (uint64_t)r &&
+		(uint64_t)r <= cct->_conf->osd_read_cache_max_extent)
+	      osd->read_cache.insert(soid, oi.version, op.extent.offset,
+				     read_len, osd_op.outdata);
+	  }
 	  dout(10) << " read got " << r << " / " << op.extent.length
 		   << " bytes from obj " << soid << dendl;
 	}
@@ -3057,6 +3170,53 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
       }
       break;
 
+    case CEPH_OSD_OP_READV:
+      if (pool.info.require_rollback()) {
+	result = -EOPNOTSUPP;
+	break;
+      }
+      ++ctx->num_read;
+      {
+	vector<pair<uint64_t,uint64_t> > extents;
+	try {
+	  ::decode(extents, bp);
+	} catch (const buffer::error& e) {
+	  result = -EINVAL;
+	  break;
+	}
+	// each extent contributes exactly its requested length to the
+	// packed reply, zero-filled past eof, so the client can carve
+	// the result back up without a per-extent length vector
+	for (vector<pair<uint64_t,uint64_t> >::iterator p = extents.begin();
+	     p != extents.end();
+	     ++p) {
+	  uint64_t off = p->first, len = p->second;
+	  result = check_offset_and_length(off, len, cct->_conf->osd_max_object_size);
+	  if (result < 0)
+	    break;
+	  bufferlist bl;
+	  if (off < oi.size) {
+	    int r = pgbackend->objects_read_sync(
+	      soid, off, MIN(len, oi.size - off), &bl);
+	    if (r < 0) {
+	      result = r;
+	      break;
+	    }
+	  }
+	  if (bl.length() < len)
+	    bl.append_zero(len - bl.length());
+	  osd_op.outdata.claim_append(bl);
+	  ctx->delta_stats.num_rd_kb += SHIFT_ROUND_UP(len, 10);
+	}
+	if (result < 0)
+	  break;
+	dout(10) << " readv got " << osd_op.outdata.length()
+		 << " bytes over " << extents.size() << " extents from obj "
+		 << soid << dendl;
+	ctx->delta_stats.num_rd++;
+      }
+      break;
+
     /* map extents */
     case CEPH_OSD_OP_MAPEXT:
       if (pool.info.require_rollback()) {
@@ -3165,6 +3325,7 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
       break;
 
     case CEPH_OSD_OP_CALL:
+    case CEPH_OSD_OP_CALL_CHAIN:
       {
 	string cname, mname;
 	bufferlist indata;
@@ -3181,6 +3342,17 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	  break;
 	}
 
+	if (op.op == CEPH_OSD_OP_CALL_CHAIN) {
+	  // hand the previous op's output to this method so dependent
+	  // calls resolve server-side in a single round trip
+	  if (p == ops.begin()) {
+	    dout(10) << "call-chain has no previous op to chain from" << dendl;
+	    result = -EINVAL;
+	    break;
+	  }
+	  indata.append((p - 1)->outdata);
+	}
+
 	ClassHandler::ClassData *cls;
 	result = osd->class_handler->open_class(cname, &cls);
 	assert(result == 0);   // init_op_flags() already verified this works.
@@ -3725,7 +3897,95 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	}
       }
       break;
-      
+
+    case CEPH_OSD_OP_WRITEV:
+      ++ctx->num_write;
+      { // scattered write; extent list then packed data in the payload
+	if (pool.info.require_rollback()) {
+	  result = -EOPNOTSUPP;
+	  break;
+	}
+	vector<pair<uint64_t,uint64_t> > extents;
+	try {
+	  ::decode(extents, bp);
+	} catch (const buffer::error& e) {
+	  result = -EINVAL;
+	  break;
+	}
+	uint64_t total = 0;
+	for (vector<pair<uint64_t,uint64_t> >::iterator p = extents.begin();
+	     p != extents.end();
+	     ++p) {
+	  result = check_offset_and_length(p->first, p->second,
+					   cct->_conf->osd_max_object_size);
+	  if (result < 0)
+	    break;
+	  total += p->second;
+	}
+	if (result < 0)
+	  break;
+	if (bp.get_remaining() < total) {
+	  result = -EINVAL;
+	  break;
+	}
+	if (!obs.exists)
+	  ctx->mod_desc.create();
+	else
+	  ctx->mod_desc.mark_unrollbackable();
+	for (vector<pair<uint64_t,uint64_t> >::iterator p = extents.begin();
+	     p != extents.end();
+	     ++p) {
+	  bufferlist bl;
+	  bp.copy(p->second, bl);
+	  t->write(soid, p->first, p->second, bl);
+	  write_update_size_and_usage(ctx->delta_stats, oi, ssc->snapset,
+				      ctx->modified_ranges,
+				      p->first, p->second, true);
+	}
+	dout(10) << " writev wrote " << total << " bytes over "
+		 << extents.size() << " extents to obj " << soid << dendl;
+	if (!obs.exists) {
+	  ctx->delta_stats.num_objects++;
+	  obs.exists = true;
+	}
+      }
+      break;
+
+    case CEPH_OSD_OP_WRITESAME:
+      ++ctx->num_write;
+      { // write the payload pattern repeatedly across the extent
+	if (pool.info.require_rollback()) {
+	  result = -EOPNOTSUPP;
+	  break;
+	}
+	uint64_t data_len = osd_op.indata.length();
+	if (data_len == 0 || op.extent.length % data_len != 0) {
+	  result = -EINVAL;
+	  break;
+	}
+	result = check_offset_and_length(op.extent.offset, op.extent.length,
+					 cct->_conf->osd_max_object_size);
+	if (result < 0)
+	  break;
+	if (!obs.exists)
+	  ctx->mod_desc.create();
+	else
+	  ctx->mod_desc.mark_unrollbackable();
+	bufferlist bl;
+	for (uint64_t write_off = 0; write_off < op.extent.length;
+	     write_off += data_len)
+	  bl.append(osd_op.indata);
+	t->write(soid, op.extent.offset, op.extent.length, bl);
+	write_update_size_and_usage(ctx->delta_stats, oi, ssc->snapset,
+				    ctx->modified_ranges,
+				    op.extent.offset, op.extent.length, true);
+	if (!obs.exists) {
+	  ctx->delta_stats.num_objects++;
+	  obs.exists = true;
+	}
+      }
+      break;
+
     case CEPH_OSD_OP_WRITEFULL:
       ++ctx->num_write;
       { // write full object
@@ -4188,7 +4448,7 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	set<string> out_set;
 
 	if (!pool.info.require_rollback()) {
-	  ObjectMap::ObjectMapIterator iter = osd->store->get_omap_iterator(
+	  ObjectMap::ObjectMapIterator iter = osd->store->get_omap_snapshot_iterator(
 	    coll, soid
 	    );
 	  assert(iter);
@@ -4223,7 +4483,7 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	map<string, bufferlist> out_set;
 
 	if (!pool.info.require_rollback()) {
-	  ObjectMap::ObjectMapIterator iter = osd->store->get_omap_iterator(
+	  ObjectMap::ObjectMapIterator iter = osd->store->get_omap_snapshot_iterator(
 	    coll, soid
 	    );
           if (!iter) {
@@ -4232,15 +4492,98 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
           }
 	  iter->upper_bound(start_after);
 	  if (filter_prefix >= start_after) iter->lower_bound(filter_prefix);
-	  for (uint64_t i = 0;
-	       i < max_return && iter->valid() &&
-		 iter->key().substr(0, filter_prefix.size()) == filter_prefix;
-	       ++i, iter->next()) {
-	    dout(20) << "Found key " << iter->key() << dendl;
-	    out_set.insert(make_pair(iter->key(), iter->value()));
+	  if (filter_prefix.empty()) {
+	    // no prefix check needed; let the backend fetch the whole
+	    // batch in one call
+	    result = iter->get_next_n(max_return, &out_set);
+	    if (result < 0)
+	      goto fail;
+	    result = 0;
+	  } else {
+	    for (uint64_t i = 0;
+		 i < max_return && iter->valid() &&
+		   iter->key().substr(0, filter_prefix.size()) == filter_prefix;
+		 ++i, iter->next()) {
+	      dout(20) << "Found key " << iter->key() << dendl;
+	      out_set.insert(make_pair(iter->key(), iter->value()));
+	    }
+	  }
+	} // else return empty out_set
+	::encode(out_set, osd_op.outdata);
+	ctx->delta_stats.num_rd_kb += SHIFT_ROUND_UP(osd_op.outdata.length(), 10);
+	ctx->delta_stats.num_rd++;
+      }
+      break;
+
+    case CEPH_OSD_OP_OMAPGETVALSFILTERED:
+      ++ctx->num_read;
+      {
+	string start_after;
+	uint64_t max_return;
+	uint64_t max_scan;
+	string filter_prefix;
+	string key_end;
+	string value_contains;
+	try {
+	  ::decode(start_after, bp);
+	  ::decode(max_return, bp);
+	  ::decode(max_scan, bp);
+	  ::decode(filter_prefix, bp);
+	  ::decode(key_end, bp);
+	  ::decode(value_contains, bp);
+	}
+	catch (buffer::error& e) {
+	  result = -EINVAL;
+	  goto fail;
+	}
+	map<string, bufferlist> out_set;
+	string next_after;
+	bool more = false;
+
+	if (!pool.info.require_rollback()) {
+	  ObjectMap::ObjectMapIterator iter = osd->store->get_omap_snapshot_iterator(
+	    coll, soid
+	    );
+          if (!iter) {
+            result = -ENOENT;
+            goto fail;
+          }
+	  iter->upper_bound(start_after);
+	  if (filter_prefix > start_after) iter->lower_bound(filter_prefix);
+	  uint64_t scanned = 0;
+	  for (; iter->valid(); iter->next()) {
+	    const string &key = iter->key();
+	    if (!filter_prefix.empty() &&
+		key.substr(0, filter_prefix.size()) != filter_prefix)
+	      break;
+	    if (!key_end.empty() && key >= key_end)
+	      break;
+	    if (max_scan && scanned >= max_scan) {
+	      // scan budget spent; resuming after next_after picks this
+	      // key back up
+	      more = true;
+	      break;
+	    }
+	    ++scanned;
+	    next_after = key;
+	    if (!value_contains.empty()) {
+	      bufferlist vbl = iter->value();
+	      // match on the raw value bytes; the client knows its own
+	      // encoding
+	      string v(vbl.c_str(), vbl.length());
+	      if (v.find(value_contains) == string::npos)
+		continue;
+	    }
+	    out_set.insert(make_pair(key, iter->value()));
+	    if (out_set.size() >= max_return) {
+	      more = true;
+	      break;
+	    }
 	  }
 	} // else return empty out_set
 	::encode(out_set, osd_op.outdata);
+	::encode(next_after, osd_op.outdata);
+	::encode(more, osd_op.outdata);
 	ctx->delta_stats.num_rd_kb += SHIFT_ROUND_UP(osd_op.outdata.length(), 10);
 	ctx->delta_stats.num_rd++;
       }
@@ -6698,6 +7041,39 @@ void ReplicatedPG::issue_repop(RepGather *repop, utime_t now)
     }
   }
 
+  // a replica that is missing any object this transaction touches
+  // will record the log entries without applying the data and rely on
+  // recovery to push the resulting versions; keep peer_missing in
+  // step with that deduction (see ReplicatedBackend::sub_op_modify)
+  for (set<pg_shard_t>::iterator i = actingbackfill.begin();
+       i != actingbackfill.end();
+       ++i) {
+    if (*i == get_primary()) continue;
+    map<pg_shard_t, pg_missing_t>::iterator pm = peer_missing.find(*i);
+    if (pm == peer_missing.end() || pm->second.missing.empty())
+      continue;
+    if (!should_send_op(*i, soid))
+      continue;    // it gets the log entries but no data to skip
+    bool will_skip = false;
+    for (vector<pg_log_entry_t>::iterator p = ctx->log.begin();
+	 p != ctx->log.end();
+	 ++p) {
+      if (pm->second.is_missing(p->soid)) {
+	will_skip = true;
+	break;
+      }
+    }
+    if (!will_skip)
+      continue;
+    dout(10) << __func__ << " osd." << *i
+	     << " will record log entries without applying; noting missing"
+	     << dendl;
+    for (vector<pg_log_entry_t>::iterator p = ctx->log.begin();
+	 p != ctx->log.end();
+	 ++p)
+      pm->second.add_next_event(*p);
+  }
+
   repop->obc->ondisk_write_lock();
   if (repop->ctx->clone_obc)
     repop->ctx->clone_obc->ondisk_write_lock();
@@ -6765,6 +7141,12 @@ void ReplicatedBackend::issue_op(
     if (op->op)
       op->op->mark_sub_op_sent(ss.str());
   }
+  // encode the transaction and log entries once; the per-replica
+  // messages below share the encoded buffers by reference instead of
+  // re-encoding for every peer
+  bufferlist op_bl, empty_op_bl, log_bl;
+  ::encode(log_entries, log_bl);
+
   for (set<pg_shard_t>::const_iterator i =
 	 parent->get_actingbackfill_shards().begin();
        i != parent->get_actingbackfill_shards().end();
@@ -6789,13 +7171,18 @@ void ReplicatedBackend::issue_op(
 	       << " beyond MAX(last_backfill_started "
 	       << ", pinfo.last_backfill "
 	       << pinfo.last_backfill << ")" << dendl;
-      ObjectStore::Transaction t;
-      ::encode(t, wr->get_data());
+      if (!empty_op_bl.length()) {
+	ObjectStore::Transaction t;
+	::encode(t, empty_op_bl);
+      }
+      wr->get_data().append(empty_op_bl);
     } else {
-      ::encode(*op_t, wr->get_data());
+      if (!op_bl.length())
+	::encode(*op_t, op_bl);
+      wr->get_data().append(op_bl);
     }
 
-    ::encode(log_entries, wr->logbl);
+    wr->logbl.append(log_bl);
 
     if (pinfo.is_incomplete())
       wr->pg_stats = pinfo.stats;  // reflects backfill progress
@@ -6808,6 +7195,10 @@ void ReplicatedBackend::issue_op(
     wr->discard_temp_oid = discard_temp_oid;
     wr->updated_hit_set_history = hset_hist;
 
+    // propagate the trace flag so the replica archives its span too
+    if (op->op && op->op->is_traced())
+      wr->traced = true;
+
     get_parent()->send_message_osd_cluster(
       peer.osd, wr, get_osdmap()->get_epoch());
   }
@@ -7538,9 +7929,6 @@ void ReplicatedBackend::sub_op_modify(OpRequestRef op)
 
   // sanity checks
   assert(m->map_epoch >= get_info().history.same_interval_since);
-  
-  // we better not be missing this.
-  assert(!parent->get_log().get_missing().is_missing(soid));
 
   int ackerosd = m->get_source().num();
   
@@ -7590,6 +7978,30 @@ void ReplicatedBackend::sub_op_modify(OpRequestRef op)
     }
     rm->opt.set_replica();
 
+    if (!rm->opt.empty()) {
+      // if we are missing any object this transaction touches we
+      // cannot apply the data update; record the log entries in our
+      // missing set instead and let recovery push the resulting
+      // versions.  The primary makes the same deduction from
+      // peer_missing (see ReplicatedPG::issue_repop).
+      bool skip_data = false;
+      for (vector<pg_log_entry_t>::iterator i = log.begin();
+	   i != log.end();
+	   ++i) {
+	if (parent->get_log().get_missing().is_missing(i->soid)) {
+	  skip_data = true;
+	  break;
+	}
+      }
+      if (skip_data) {
+	dout(10) << "sub_op_modify " << soid
+		 << " touches an object we are missing"
+		 << "; recording log entries only" << dendl;
+	parent->update_local_missing(log);
+	rm->opt = ObjectStore::Transaction();
+      }
+    }
+
     bool update_snaps = false;
     if (!rm->opt.empty()) {
       // If the opt is non-empty, we infer we are before
@@ -8130,6 +8542,7 @@ void ReplicatedBackend::prep_push(
 			&(pi.stat));
   assert(r == 0);
   pi.recovery_progress = new_progress;
+  pi.outstanding = 1;
 }
 
 int ReplicatedBackend::send_pull_legacy(int prio, pg_shard_t peer,
@@ -8654,6 +9067,8 @@ bool ReplicatedBackend::handle_push_reply(pg_shard_t peer, PushReplyOp &op, Push
   } else {
     PushInfo *pi = &pushing[soid][peer];
 
+    assert(pi->outstanding > 0);
+    --pi->outstanding;
     if (!pi->recovery_progress.data_complete) {
       dout(10) << " pushing more from, "
 	       << pi->recovery_progress.data_recovered_to
@@ -8665,7 +9080,14 @@ bool ReplicatedBackend::handle_push_reply(pg_shard_t peer, PushReplyOp &op, Push
 	&(pi->stat));
       assert(r == 0);
       pi->recovery_progress = new_progress;
+      ++pi->outstanding;
       return true;
+    } else if (pi->outstanding) {
+      // everything is built and sent; wait for the remaining chunks
+      // in the window to be acked
+      dout(10) << " pushed all of " << soid << ", waiting for "
+	       << pi->outstanding << " outstanding chunk acks" << dendl;
+      return false;
     } else {
       // done!
       get_parent()->on_peer_recover(
@@ -9946,6 +10368,23 @@ int ReplicatedBackend::start_pushes(
       prep_push_to_replica(obc, soid, peer,
 			   &(h->pushes[peer].back())
 	);
+
+      // keep up to osd_recovery_push_window chunks in flight so a
+      // large object doesn't ping-pong one chunk per rtt
+      PushInfo &pi = pushing[soid][peer];
+      while (pi.outstanding < cct->_conf->osd_recovery_push_window &&
+	     !pi.recovery_progress.data_complete) {
+	h->pushes[peer].push_back(PushOp());
+	ObjectRecoveryProgress new_progress;
+	int r = build_push_op(pi.recovery_info,
+			      pi.recovery_progress,
+			      &new_progress,
+			      &(h->pushes[peer].back()),
+			      &(pi.stat));
+	assert(r == 0);
+	pi.recovery_progress = new_progress;
+	++pi.outstanding;
+      }
     }
   }
   return pushes;
@@ -11885,6 +12324,7 @@ ReplicatedPG::SnapTrimmer::~SnapTrimmer()
 
 void ReplicatedPG::SnapTrimmer::log_enter(const char *state_name)
 {
+  current_state = state_name;
   dout(20) << "enter " << state_name << dendl;
 }
 
@@ -11932,6 +12372,9 @@ boost::statechart::result ReplicatedPG::NotTrimming::react(const SnapTrim&)
     return discard_event();
   } else {
     context<SnapTrimmer>().snap_to_trim = pg->snap_trimq.range_start();
+    context<SnapTrimmer>().objects_trimmed = 0;
+    context<SnapTrimmer>().bytes_trimmed = 0;
+    context<SnapTrimmer>().trim_start = ceph_clock_now(pg->cct);
     dout(10) << "NotTrimming: trimming "
 	     << pg->snap_trimq.range_start()
 	     << dendl;
@@ -11969,9 +12412,15 @@ boost::statechart::result ReplicatedPG::TrimmingObjects::react(const SnapTrim&)
 
   dout(10) << "TrimmingObjects: trimming snap " << snap_to_trim << dendl;
 
-  // Get next
-  hobject_t old_pos = pos;
-  int r = pg->snap_mapper.get_next_object_to_trim(snap_to_trim, &pos);
+  // Get the next chunk; mappings for repops still in flight are
+  // masked out by the snap mapper, so we never see an object twice.
+  unsigned max = pg->cct->_conf->osd_snap_trim_batch_size;
+  assert(max > 0);
+  vector<hobject_t> to_trim;
+  int r = pg->snap_mapper.get_next_objects_to_trim(
+    snap_to_trim,
+    max,
+    &to_trim);
   if (r != 0 && r != -ENOENT) {
     derr << __func__ << ": get_next returned " << cpp_strerror(r) << dendl;
     assert(0);
@@ -11982,19 +12431,37 @@ boost::statechart::result ReplicatedPG::TrimmingObjects::react(const SnapTrim&)
     return transit< WaitingOnReplicas >();
   }
 
-  dout(10) << "TrimmingObjects react trimming " << pos << dendl;
-  RepGather *repop = pg->trim_object(pos);
-  if (!repop) {
-    dout(10) << __func__ << " could not get write lock on obj "
-	     << pos << dendl;
-    pos = old_pos;
-    return discard_event();
-  }
-  assert(repop);
-  repop->queue_snap_trimmer = true;
+  // Bound the cost of this wakeup so client ops queued behind us are
+  // not starved by a run of large clones; the count cap alone does not
+  // distinguish 4K clones from 4M ones.
+  uint64_t cost_budget = pg->cct->_conf->osd_snap_trim_cost_budget;
+  uint64_t cost = 0;
+  for (vector<hobject_t>::iterator i = to_trim.begin();
+       i != to_trim.end();
+       ++i) {
+    pos = *i;
+    dout(10) << "TrimmingObjects react trimming " << pos << dendl;
+    RepGather *repop = pg->trim_object(pos);
+    if (!repop) {
+      dout(10) << __func__ << " could not get write lock on obj "
+	       << pos << dendl;
+      break;
+    }
+    repop->queue_snap_trimmer = true;
+
+    context<SnapTrimmer>().objects_trimmed++;
+    context<SnapTrimmer>().bytes_trimmed += repop->ctx->obc->obs.oi.size;
+    cost += repop->ctx->obc->obs.oi.size;
+
+    repops.insert(repop->get());
+    pg->simple_repop_submit(repop);
 
-  repops.insert(repop->get());
-  pg->simple_repop_submit(repop);
+    if (cost_budget && cost >= cost_budget) {
+      dout(10) << __func__ << " cost " << cost << " >= budget "
+	       << cost_budget << ", deferring rest" << dendl;
+      break;
+    }
+  }
   return discard_event();
 }
 /* WaitingOnReplicasObjects */
@@ -356,6 +356,18 @@ public:
     append_log(logv, trim_to, *t, transaction_applied);
   }
 
+  void update_local_missing(const vector<pg_log_entry_t> &logv) {
+    for (vector<pg_log_entry_t>::const_iterator p = logv.begin();
+	 p != logv.end();
+	 ++p) {
+      // the primary never lets a delete proceed against a missing
+      // object (see execute_ctx); the missing set could not make up
+      // for the skipped removal
+      assert(!p->is_delete());
+      pg_log.missing_add_event(*p);
+    }
+  }
+
   void op_applied(
     const eversion_t &applied_version);
 
@@ -524,6 +536,10 @@ public:
 
     ObjectModDesc mod_desc;
 
+    /// object was in the hit set before this op touched it; used to
+    /// gate read cache admission to genuinely hot objects
+    bool in_hit_set;
+
     enum { W_LOCK, R_LOCK, NONE } lock_to_release;
 
     Context *on_finish;
@@ -548,6 +564,7 @@ public:
       copy_cb(NULL),
       async_read_result(0),
       inflightreads(0),
+      in_hit_set(false),
       lock_to_release(NONE),
       on_finish(NULL),
       release_snapset_obc(false) {
@@ -1284,6 +1301,7 @@ public:
 
   RepGather *trim_object(const hobject_t &coid);
   void snap_trimmer();
+  void dump_snap_trimmer(Formatter *f);
   int do_osd_ops(OpContext *ctx, vector<OSDOp>& ops);
 
   int _get_tmap(OpContext *ctx, bufferlist *header, bufferlist *vals);
@@ -1331,7 +1349,13 @@ private:
     snapid_t snap_to_trim;
     bool need_share_pg_info;
     bool requeue;
-    SnapTrimmer(ReplicatedPG *pg) : pg(pg), need_share_pg_info(false), requeue(false) {}
+    const char *current_state;   ///< for asok visibility; updated by log_enter
+    uint64_t objects_trimmed;    ///< clones trimmed for snap_to_trim so far
+    uint64_t bytes_trimmed;      ///< clone bytes trimmed for snap_to_trim so far
+    utime_t trim_start;          ///< when we started trimming snap_to_trim
+    SnapTrimmer(ReplicatedPG *pg) : pg(pg), need_share_pg_info(false),
+				    requeue(false), current_state(""),
+				    objects_trimmed(0), bytes_trimmed(0) {}
     ~SnapTrimmer();
     void log_enter(const char *state_name);
     void log_exit(const char *state_name, utime_t duration);
@@ -1385,6 +1409,16 @@ public:
   bool is_degraded_object(const hobject_t& oid);
   void wait_for_degraded_object(const hobject_t& oid, OpRequestRef op);
 
+  /**
+   * true if a write to oid may proceed while the object is degraded
+   *
+   * We must have the object ourselves and any replica missing it must
+   * be able to catch up by recording the log entries and having
+   * recovery push the result (see ReplicatedBackend::sub_op_modify);
+   * backfill targets and in-flight pushes still block the write.
+   */
+  bool async_recoverable_object(const hobject_t& oid);
+
   bool maybe_await_blocked_snapset(const hobject_t &soid, OpRequestRef op);
   void wait_for_blocked_object(const hobject_t& soid, OpRequestRef op);
   void kick_object_context_blocked(ObjectContextRef obc);
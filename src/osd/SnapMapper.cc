@@ -50,6 +50,24 @@ int OSDriver::get_next(
   }
 }
 
+int OSDriver::get_next_batch(
+  const std::string &key,
+  size_t max,
+  std::vector<pair<std::string, bufferlist> > *out)
+{
+  ObjectMap::ObjectMapIterator iter =
+    os->get_omap_iterator(cid, hoid);
+  if (!iter) {
+    assert(0);
+    return -EINVAL;
+  }
+  for (iter->upper_bound(key);
+       out->size() < max && iter->valid();
+       iter->next())
+    out->push_back(make_pair(iter->key(), iter->value()));
+  return out->empty() ? -ENOENT : 0;
+}
+
 struct Mapping {
   snapid_t snap;
   hobject_t hoid;
@@ -244,33 +262,53 @@ int SnapMapper::get_next_object_to_trim(
   snapid_t snap,
   hobject_t *hoid)
 {
+  vector<hobject_t> got;
+  int r = get_next_objects_to_trim(snap, 1, &got);
+  if (r < 0)
+    return r;
+  if (hoid)
+    *hoid = got.front();
+  return 0;
+}
+
+int SnapMapper::get_next_objects_to_trim(
+  snapid_t snap,
+  unsigned max,
+  vector<hobject_t> *out)
+{
+  assert(out);
+  assert(out->empty());
   for (set<string>::iterator i = prefixes.begin();
-       i != prefixes.end();
+       i != prefixes.end() && out->size() < max;
        ++i) {
     string list_after(get_prefix(snap) + *i);
 
-    pair<string, bufferlist> next;
-    int r = backend.get_next(list_after, &next);
+    vector<pair<string, bufferlist> > next;
+    int r = backend.get_next_batch(list_after, max - out->size(), &next);
     if (r < 0) {
       break; // Done
     }
 
-    if (next.first.substr(0, list_after.size()) !=
-	list_after) {
-      continue; // Done with this prefix
-    }
+    for (vector<pair<string, bufferlist> >::iterator j = next.begin();
+	 j != next.end();
+	 ++j) {
+      if (j->first.substr(0, list_after.size()) !=
+	  list_after) {
+	break; // Done with this prefix
+      }
 
-    assert(is_mapping(next.first));
+      assert(is_mapping(j->first));
 
-    pair<snapid_t, hobject_t> next_decoded(from_raw(next));
-    assert(next_decoded.first == snap);
-    assert(check(next_decoded.second));
+      pair<snapid_t, hobject_t> next_decoded(from_raw(*j));
+      assert(next_decoded.first == snap);
+      assert(check(next_decoded.second));
 
-    if (hoid)
-      *hoid = next_decoded.second;
-    return 0;
+      out->push_back(next_decoded.second);
+    }
   }
-  return -ENOENT;
+  if (out->empty())
+    return -ENOENT;
+  return 0;
 }
 
 
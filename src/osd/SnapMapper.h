@@ -18,6 +18,7 @@
 #include <string>
 #include <set>
 #include <utility>
+#include <vector>
 #include <string.h>
 
 #include "common/map_cacher.hpp"
@@ -71,6 +72,10 @@ public:
   int get_next(
     const std::string &key,
     pair<std::string, bufferlist> *next);
+  int get_next_batch(
+    const std::string &key,
+    size_t max,
+    std::vector<pair<std::string, bufferlist> > *out);
 };
 
 /**
@@ -216,6 +221,13 @@ public:
     hobject_t *hoid             ///< [out] next hoid to trim
     );  ///< @return error, -ENOENT if no more objects
 
+  /// Returns up to max objects with snap as a snap, prefetched in one pass
+  int get_next_objects_to_trim(
+    snapid_t snap,              ///< [in] snap to check
+    unsigned max,               ///< [in] max objects to return
+    std::vector<hobject_t> *out ///< [out] next objects to trim
+    );  ///< @return error, -ENOENT if no more objects
+
   /// Remove mapping for oid
   int remove_oid(
     const hobject_t &oid,    ///< [in] oid to remove
@@ -14,6 +14,17 @@
 
 struct CancelableContext : public Context {
   virtual void cancel() = 0;
+  /**
+   * cancel on behalf of a single watch
+   *
+   * Contexts covering more than one watch override this to drop just
+   * that watch.  @return true if the event itself should be removed
+   * from the timer.
+   */
+  virtual bool cancel_one(WatchRef watch) {
+    cancel();
+    return true;
+  }
 };
 
 #define dout_subsys ceph_subsys_osd
@@ -124,7 +135,8 @@ void Notify::register_cb()
     cb = new NotifyTimeoutCB(self.lock());
     osd->watch_timer.add_event_after(
       timeout,
-      cb);
+      cb,
+      true /* coarse */);
     osd->watch_lock.Unlock();
   }
 }
@@ -243,6 +255,64 @@ public:
   }
 };
 
+/**
+ * Covers the timeouts of every watch that lost the same session
+ *
+ * A connection reset disconnects all of that session's watches at
+ * once, and registering an individual timer event for each of them
+ * makes the watch_timer a contention point when a client holding many
+ * watches goes away.  Instead the watches are parked on one shared
+ * event per timeout value and handled together when it fires; a watch
+ * that reconnects first drops out of the set via cancel_one().
+ */
+class HandleGroupedWatchTimeout : public CancelableContext {
+  OSDService *osd;
+  set<WatchRef> watches; ///< protected by osd->watch_lock
+public:
+  HandleGroupedWatchTimeout(OSDService *osd) : osd(osd) {}
+  void add(WatchRef watch) {
+    assert(osd->watch_lock.is_locked());
+    watches.insert(watch);
+  }
+  /// schedule the event; call once, after the last add()
+  void schedule(uint32_t timeout) {
+    Mutex::Locker l(osd->watch_lock);
+    // if every watch already canceled we fire later with an empty set
+    // and just clean ourselves up
+    osd->watch_timer.add_event_after(timeout, this, true /* coarse */);
+  }
+  void cancel() {
+    watches.clear();
+  }
+  bool cancel_one(WatchRef watch) {
+    watches.erase(watch);
+    return watches.empty();
+  }
+  void finish(int) { assert(0); /* not used */ }
+  void complete(int) {
+    set<WatchRef> to_handle;
+    to_handle.swap(watches);
+    osd->watch_lock.Unlock();
+    lgeneric_dout(osd->cct, 10) << "HandleGroupedWatchTimeout on "
+				<< to_handle.size() << " watches" << dendl;
+    while (!to_handle.empty()) {
+      WatchRef watch = *to_handle.begin();
+      boost::intrusive_ptr<ReplicatedPG> pg(watch->pg);
+      pg->lock();
+      if (watch->cb == this) {
+	watch->cb = NULL;
+	if (!watch->is_discarded())
+	  watch->pg->handle_watch_timeout(watch);
+      }
+      to_handle.erase(to_handle.begin());
+      watch.reset(); // may be the last ref; ~Watch requires pg lock!
+      pg->unlock();
+    }
+    delete this;
+    osd->watch_lock.Lock();
+  }
+};
+
 #define dout_subsys ceph_subsys_osd
 #undef dout_prefix
 #define dout_prefix _prefix(_dout, this)
@@ -297,7 +367,8 @@ void Watch::register_cb()
   cb = new HandleWatchTimeout(self.lock());
   osd->watch_timer.add_event_after(
     timeout,
-    cb);
+    cb,
+    true /* coarse */);
 }
 
 void Watch::unregister_cb()
@@ -306,10 +377,10 @@ void Watch::unregister_cb()
   if (!cb)
     return;
   dout(15) << "actually registered, cancelling" << dendl;
-  cb->cancel();
   {
     Mutex::Locker l(osd->watch_lock);
-    osd->watch_timer.cancel_event(cb); // harmless if not registered with timer
+    if (cb->cancel_one(self.lock()))
+      osd->watch_timer.cancel_event(cb); // harmless if not registered with timer
   }
   cb = NULL;
 }
@@ -336,6 +407,17 @@ void Watch::disconnect()
   register_cb();
 }
 
+void Watch::disconnect_to(HandleGroupedWatchTimeout *&group)
+{
+  dout(10) << "disconnect (grouped timeout)" << dendl;
+  conn = ConnectionRef();
+  Mutex::Locker l(osd->watch_lock);
+  if (!group)
+    group = new HandleGroupedWatchTimeout(osd);
+  group->add(self.lock());
+  cb = group;
+}
+
 void Watch::discard()
 {
   dout(10) << "discard" << dendl;
@@ -444,14 +526,23 @@ void WatchConState::reset()
     Mutex::Locker l(lock);
     _watches.swap(watches);
   }
+  // all of these watches lost the same session at the same moment, so
+  // park them on one shared timer event per timeout value rather than
+  // registering an event for every watch
+  map<uint32_t, HandleGroupedWatchTimeout*> groups;
   for (set<WatchRef>::iterator i = _watches.begin();
        i != _watches.end();
        ++i) {
     boost::intrusive_ptr<ReplicatedPG> pg((*i)->get_pg());
     pg->lock();
     if (!(*i)->is_discarded()) {
-      (*i)->disconnect();
+      (*i)->disconnect_to(groups[(*i)->get_timeout()]);
     }
     pg->unlock();
   }
+  for (map<uint32_t, HandleGroupedWatchTimeout*>::iterator p = groups.begin();
+       p != groups.end();
+       ++p) {
+    p->second->schedule(p->first);
+  }
 }
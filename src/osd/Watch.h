@@ -142,10 +142,12 @@ public:
  */
 class HandleWatchTimeout;
 class HandleDelayedWatchTimeout;
+class HandleGroupedWatchTimeout;
 class Watch {
   WWatchRef self;
   friend class HandleWatchTimeout;
   friend class HandleDelayedWatchTimeout;
+  friend class HandleGroupedWatchTimeout;
   ConnectionRef conn;
   CancelableContext *cb;
 
@@ -216,6 +218,13 @@ public:
   /// Transitions watch to disconnected, register_cb
   void disconnect();
 
+  /**
+   * As disconnect(), but joins a timeout event shared with the other
+   * watches of the same session instead of registering an individual
+   * one; allocates *group on first use
+   */
+  void disconnect_to(HandleGroupedWatchTimeout *&group);
+
   /// Called if Watch state is discarded due to new peering interval
   void discard();
 
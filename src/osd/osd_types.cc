@@ -48,6 +48,7 @@ const char *ceph_osd_flag_name(unsigned flag)
   case CEPH_OSD_FLAG_FLUSH: return "flush";
   case CEPH_OSD_FLAG_MAP_SNAP_CLONE: return "map_snap_clone";
   case CEPH_OSD_FLAG_ENFORCE_SNAPC: return "enforce_snapc";
+  case CEPH_OSD_FLAG_TRACE: return "trace";
   default: return "???";
   }
 }
@@ -279,11 +280,15 @@ void osd_stat_t::dump(Formatter *f) const
 void osd_stat_t::encode(bufferlist &bl) const
 {
   ENCODE_START(4, 2, bl);
-  ::encode(kb, bl);
-  ::encode(kb_used, bl);
-  ::encode(kb_avail, bl);
-  ::encode(snap_trim_queue_len, bl);
-  ::encode(num_snap_trimming, bl);
+  {
+    contiguous_appender ap(bl, 3 * fixed_encoding<int64_t>::wire_size +
+			   2 * fixed_encoding<int32_t>::wire_size);
+    ::encode(kb, ap);
+    ::encode(kb_used, ap);
+    ::encode(kb_avail, ap);
+    ::encode(snap_trim_queue_len, ap);
+    ::encode(num_snap_trimming, ap);
+  }
   ::encode(hb_in, bl);
   ::encode(hb_out, bl);
   ::encode(op_queue_age_hist, bl);
@@ -785,6 +790,8 @@ void pg_pool_t::dump(Formatter *f) const
   f->dump_stream("removed_snaps") << removed_snaps;
   f->dump_int("quota_max_bytes", quota_max_bytes);
   f->dump_int("quota_max_objects", quota_max_objects);
+  f->dump_int("rate_limit_iops", rate_limit_iops);
+  f->dump_int("rate_limit_bps", rate_limit_bps);
   f->open_array_section("tiers");
   for (set<uint64_t>::const_iterator p = tiers.begin(); p != tiers.end(); ++p)
     f->dump_int("pool_id", *p);
@@ -1059,7 +1066,7 @@ void pg_pool_t::encode(bufferlist& bl, uint64_t features) const
   }
 
   __u8 encode_compat = 5;
-  ENCODE_START(15, encode_compat, bl);
+  ENCODE_START(16, encode_compat, bl);
   ::encode(type, bl);
   ::encode(size, bl);
   ::encode(crush_ruleset, bl);
@@ -1099,12 +1106,14 @@ void pg_pool_t::encode(bufferlist& bl, uint64_t features) const
   ::encode(cache_min_evict_age, bl);
   ::encode(erasure_code_profile, bl);
   ::encode(last_force_op_resend, bl);
+  ::encode(rate_limit_iops, bl);
+  ::encode(rate_limit_bps, bl);
   ENCODE_FINISH(bl);
 }
 
 void pg_pool_t::decode(bufferlist::iterator& bl)
 {
-  DECODE_START_LEGACY_COMPAT_LEN(15, 5, 5, bl);
+  DECODE_START_LEGACY_COMPAT_LEN(16, 5, 5, bl);
   ::decode(type, bl);
   ::decode(size, bl);
   ::decode(crush_ruleset, bl);
@@ -1206,6 +1215,13 @@ void pg_pool_t::decode(bufferlist::iterator& bl)
   } else {
     last_force_op_resend = 0;
   }
+  if (struct_v >= 16) {
+    ::decode(rate_limit_iops, bl);
+    ::decode(rate_limit_bps, bl);
+  } else {
+    rate_limit_iops = 0;
+    rate_limit_bps = 0;
+  }
   DECODE_FINISH(bl);
   calc_pg_masks();
 }
@@ -1242,6 +1258,8 @@ void pg_pool_t::generate_test_instances(list<pg_pool_t*>& o)
   a.removed_snaps.insert(2);   // not quite valid to combine with snaps!
   a.quota_max_bytes = 2473;
   a.quota_max_objects = 4374;
+  a.rate_limit_iops = 1000;
+  a.rate_limit_bps = 52428800;
   a.tiers.insert(0);
   a.tiers.insert(1);
   a.tier_of = 2;
@@ -1284,6 +1302,10 @@ ostream& operator<<(ostream& out, const pg_pool_t& p)
     out << " max_bytes " << p.quota_max_bytes;
   if (p.quota_max_objects)
     out << " max_objects " << p.quota_max_objects;
+  if (p.rate_limit_iops)
+    out << " rate_limit_iops " << p.rate_limit_iops;
+  if (p.rate_limit_bps)
+    out << " rate_limit_bps " << p.rate_limit_bps;
   if (!p.tiers.empty())
     out << " tiers " << p.tiers;
   if (p.is_tier())
@@ -1338,27 +1360,32 @@ void object_stat_sum_t::dump(Formatter *f) const
 void object_stat_sum_t::encode(bufferlist& bl) const
 {
   ENCODE_START(9, 3, bl);
-  ::encode(num_bytes, bl);
-  ::encode(num_objects, bl);
-  ::encode(num_object_clones, bl);
-  ::encode(num_object_copies, bl);
-  ::encode(num_objects_missing_on_primary, bl);
-  ::encode(num_objects_degraded, bl);
-  ::encode(num_objects_unfound, bl);
-  ::encode(num_rd, bl);
-  ::encode(num_rd_kb, bl);
-  ::encode(num_wr, bl);
-  ::encode(num_wr_kb, bl);
-  ::encode(num_scrub_errors, bl);
-  ::encode(num_objects_recovered, bl);
-  ::encode(num_bytes_recovered, bl);
-  ::encode(num_keys_recovered, bl);
-  ::encode(num_shallow_scrub_errors, bl);
-  ::encode(num_deep_scrub_errors, bl);
-  ::encode(num_objects_dirty, bl);
-  ::encode(num_whiteouts, bl);
-  ::encode(num_objects_omap, bl);
-  ::encode(num_objects_hit_set_archive, bl);
+  {
+    // every field is a fixed-size counter; reserve the whole struct
+    // once and fill it with plain stores
+    contiguous_appender ap(bl, 21 * fixed_encoding<int64_t>::wire_size);
+    ::encode(num_bytes, ap);
+    ::encode(num_objects, ap);
+    ::encode(num_object_clones, ap);
+    ::encode(num_object_copies, ap);
+    ::encode(num_objects_missing_on_primary, ap);
+    ::encode(num_objects_degraded, ap);
+    ::encode(num_objects_unfound, ap);
+    ::encode(num_rd, ap);
+    ::encode(num_rd_kb, ap);
+    ::encode(num_wr, ap);
+    ::encode(num_wr_kb, ap);
+    ::encode(num_scrub_errors, ap);
+    ::encode(num_objects_recovered, ap);
+    ::encode(num_bytes_recovered, ap);
+    ::encode(num_keys_recovered, ap);
+    ::encode(num_shallow_scrub_errors, ap);
+    ::encode(num_deep_scrub_errors, ap);
+    ::encode(num_objects_dirty, ap);
+    ::encode(num_whiteouts, ap);
+    ::encode(num_objects_omap, ap);
+    ::encode(num_objects_hit_set_archive, ap);
+  }
   ENCODE_FINISH(bl);
 }
 
@@ -1603,40 +1630,60 @@ void pg_stat_t::dump_brief(Formatter *f) const
 
 void pg_stat_t::encode(bufferlist &bl) const
 {
+  // per-field wire sizes, from the trait table
+  enum {
+    EV = fixed_encoding<eversion_t>::wire_size,
+    TS = fixed_encoding<utime_t>::wire_size,
+    U64 = fixed_encoding<uint64_t>::wire_size,
+    U32 = fixed_encoding<uint32_t>::wire_size,
+    B = fixed_encoding<bool>::wire_size
+  };
   ENCODE_START(17, 8, bl);
-  ::encode(version, bl);
-  ::encode(reported_seq, bl);
-  ::encode(reported_epoch, bl);
-  ::encode(state, bl);
-  ::encode(log_start, bl);
-  ::encode(ondisk_log_start, bl);
-  ::encode(created, bl);
-  ::encode(last_epoch_clean, bl);
+  {
+    contiguous_appender ap(bl, 3 * EV + U64 + 4 * U32);
+    ::encode(version, ap);
+    ::encode(reported_seq, ap);
+    ::encode(reported_epoch, ap);
+    ::encode(state, ap);
+    ::encode(log_start, ap);
+    ::encode(ondisk_log_start, ap);
+    ::encode(created, ap);
+    ::encode(last_epoch_clean, ap);
+  }
   ::encode(parent, bl);
-  ::encode(parent_split_bits, bl);
-  ::encode(last_scrub, bl);
-  ::encode(last_scrub_stamp, bl);
+  {
+    contiguous_appender ap(bl, U32 + EV + TS);
+    ::encode(parent_split_bits, ap);
+    ::encode(last_scrub, ap);
+    ::encode(last_scrub_stamp, ap);
+  }
   ::encode(stats, bl);
-  ::encode(log_size, bl);
-  ::encode(ondisk_log_size, bl);
+  {
+    contiguous_appender ap(bl, 2 * U64);
+    ::encode(log_size, ap);
+    ::encode(ondisk_log_size, ap);
+  }
   ::encode(up, bl);
   ::encode(acting, bl);
-  ::encode(last_fresh, bl);
-  ::encode(last_change, bl);
-  ::encode(last_active, bl);
-  ::encode(last_clean, bl);
-  ::encode(last_unstale, bl);
-  ::encode(mapping_epoch, bl);
-  ::encode(last_deep_scrub, bl);
-  ::encode(last_deep_scrub_stamp, bl);
-  ::encode(stats_invalid, bl);
-  ::encode(last_clean_scrub_stamp, bl);
-  ::encode(last_became_active, bl);
-  ::encode(dirty_stats_invalid, bl);
-  ::encode(up_primary, bl);
-  ::encode(acting_primary, bl);
-  ::encode(omap_stats_invalid, bl);
-  ::encode(hitset_stats_invalid, bl);
+  {
+    contiguous_appender ap(bl, 8 * TS + EV + 3 * U32 + 4 * B);
+    ::encode(last_fresh, ap);
+    ::encode(last_change, ap);
+    ::encode(last_active, ap);
+    ::encode(last_clean, ap);
+    ::encode(last_unstale, ap);
+    ::encode(mapping_epoch, ap);
+    ::encode(last_deep_scrub, ap);
+    ::encode(last_deep_scrub_stamp, ap);
+    ::encode(stats_invalid, ap);
+    ::encode(last_clean_scrub_stamp, ap);
+    ::encode(last_became_active, ap);
+    ::encode(dirty_stats_invalid, ap);
+    ::encode(up_primary, ap);
+    ::encode(acting_primary, ap);
+    ::encode(omap_stats_invalid, ap);
+    ::encode(hitset_stats_invalid, ap);
+  }
   ENCODE_FINISH(bl);
 }
 
@@ -4374,6 +4421,8 @@ ostream& operator<<(ostream& out, const OSDOp& op)
     case CEPH_OSD_OP_CACHE_FLUSH:
     case CEPH_OSD_OP_CACHE_TRY_FLUSH:
     case CEPH_OSD_OP_CACHE_EVICT:
+    case CEPH_OSD_OP_READV:
+    case CEPH_OSD_OP_WRITEV:
       break;
     case CEPH_OSD_OP_ASSERT_VER:
       out << " v" << op.op.assert_ver.ver;
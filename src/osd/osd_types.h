@@ -606,6 +606,10 @@ public:
     ::encode(version, bl);
     ::encode(epoch, bl);
   }
+  void encode(contiguous_appender &a) const {
+    ::encode(version, a);
+    ::encode(epoch, a);
+  }
   void decode(bufferlist::iterator &bl) {
     ::decode(version, bl);
     ::decode(epoch, bl);
@@ -616,6 +620,10 @@ public:
   }
 };
 WRITE_CLASS_ENCODER(eversion_t)
+inline void encode(const eversion_t &v, contiguous_appender &a) {
+  v.encode(a);
+}
+WRITE_FIXED_ENCODING(eversion_t, 12)
 
 inline bool operator==(const eversion_t& l, const eversion_t& r) {
   return (l.epoch == r.epoch) && (l.version == r.version);
@@ -812,6 +820,7 @@ struct pg_pool_t {
     FLAG_HASHPSPOOL = 1, // hash pg seed and pool together (instead of adding)
     FLAG_FULL       = 2, // pool is full
     FLAG_DEBUG_FAKE_EC_POOL = 1<<2, // require ReplicatedPG to act like an EC pg
+    FLAG_BALANCE_READS = 1<<3, // serve reads from any in-sync replica
   };
 
   static const char *get_flag_name(int f) {
@@ -819,6 +828,7 @@ struct pg_pool_t {
     case FLAG_HASHPSPOOL: return "hashpspool";
     case FLAG_FULL: return "full";
     case FLAG_DEBUG_FAKE_EC_POOL: return "require_local_rollback";
+    case FLAG_BALANCE_READS: return "balance_reads";
     default: return "???";
     }
   }
@@ -889,6 +899,9 @@ public:
   uint64_t quota_max_bytes; ///< maximum number of bytes for this pool
   uint64_t quota_max_objects; ///< maximum number of objects for this pool
 
+  uint64_t rate_limit_iops; ///< client ops/sec admitted per osd (0 = unlimited)
+  uint64_t rate_limit_bps;  ///< client bytes/sec admitted per osd (0 = unlimited)
+
   /*
    * Pool snaps (global to this pool).  These define a SnapContext for
    * the pool, unless the client manually specifies an alternate
@@ -945,6 +958,7 @@ public:
       auid(0),
       crash_replay_interval(0),
       quota_max_bytes(0), quota_max_objects(0),
+      rate_limit_iops(0), rate_limit_bps(0),
       pg_num_mask(0), pgp_num_mask(0),
       tier_of(-1), read_tier(-1), write_tier(-1),
       cache_mode(CACHEMODE_NONE),
@@ -1276,6 +1290,28 @@ struct object_stat_collection_t {
 	 ++p)
       cat_sum[p->first].add(p->second);
   }
+
+  /**
+   * copy o into this, rewriting category values in place when the key
+   * sets match (the common case), so a long-lived destination that is
+   * refreshed repeatedly does not reallocate its map nodes each time
+   */
+  void copy_from(const object_stat_collection_t& o) {
+    sum = o.sum;
+    map<string,object_stat_sum_t>::iterator d = cat_sum.begin();
+    map<string,object_stat_sum_t>::const_iterator s = o.cat_sum.begin();
+    while (d != cat_sum.end() && s != o.cat_sum.end() &&
+	   d->first == s->first) {
+      d->second = s->second;
+      ++d;
+      ++s;
+    }
+    if (d != cat_sum.end() || s != o.cat_sum.end()) {
+      // key sets diverged; really copy the remainder
+      cat_sum.erase(d, cat_sum.end());
+      cat_sum.insert(s, o.cat_sum.end());
+    }
+  }
   void sub(const object_stat_collection_t& o) {
     sum.sub(o.sum);
     for (map<string,object_stat_sum_t>::const_iterator p = o.cat_sum.begin();
@@ -1377,6 +1413,52 @@ struct pg_stat_t {
       ondisk_log_size = f;
   }
 
+  /**
+   * copy o into this without reallocating our collections: scalars are
+   * assigned wholesale, the category map is rewritten in place and the
+   * up/acting vectors are only copied when they actually changed.
+   * For long-lived publication buffers that are refreshed per op
+   * (PG::publish_stats_to_osd); plain assignment would copy (and
+   * reallocate) every collection every time.
+   */
+  void publish_copy(const pg_stat_t& o) {
+    version = o.version;
+    reported_seq = o.reported_seq;
+    reported_epoch = o.reported_epoch;
+    state = o.state;
+    last_fresh = o.last_fresh;
+    last_change = o.last_change;
+    last_active = o.last_active;
+    last_clean = o.last_clean;
+    last_unstale = o.last_unstale;
+    log_start = o.log_start;
+    ondisk_log_start = o.ondisk_log_start;
+    created = o.created;
+    last_epoch_clean = o.last_epoch_clean;
+    parent = o.parent;
+    parent_split_bits = o.parent_split_bits;
+    last_scrub = o.last_scrub;
+    last_deep_scrub = o.last_deep_scrub;
+    last_scrub_stamp = o.last_scrub_stamp;
+    last_deep_scrub_stamp = o.last_deep_scrub_stamp;
+    last_clean_scrub_stamp = o.last_clean_scrub_stamp;
+    stats.copy_from(o.stats);
+    stats_invalid = o.stats_invalid;
+    log_size = o.log_size;
+    ondisk_log_size = o.ondisk_log_size;
+    if (up != o.up)
+      up = o.up;
+    if (acting != o.acting)
+      acting = o.acting;
+    mapping_epoch = o.mapping_epoch;
+    last_became_active = o.last_became_active;
+    dirty_stats_invalid = o.dirty_stats_invalid;
+    omap_stats_invalid = o.omap_stats_invalid;
+    hitset_stats_invalid = o.hitset_stats_invalid;
+    up_primary = o.up_primary;
+    acting_primary = o.acting_primary;
+  }
+
   void add(const pg_stat_t& o) {
     stats.add(o.stats);
     log_size += o.log_size;
@@ -3122,6 +3204,12 @@ struct ScrubMap {
   eversion_t incr_since;
 
   void merge_incr(const ScrubMap &l);
+  void swap(ScrubMap &r) {
+    objects.swap(r.objects);
+    attrs.swap(r.attrs);
+    std::swap(valid_through, r.valid_through);
+    std::swap(incr_since, r.incr_since);
+  }
 
   void encode(bufferlist& bl) const;
   void decode(bufferlist::iterator& bl, int64_t pool=-1);
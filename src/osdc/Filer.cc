@@ -288,7 +288,7 @@ void Filer::_do_purge_range(PurgeRange *pr, int fin)
     return;
   }
 
-  int max = 10 - pr->uncommitted;
+  int max = cct->_conf->filer_max_purge_ops - pr->uncommitted;
   while (pr->num > 0 && max > 0) {
     object_t oid = file_object_t(pr->ino, pr->first);
     object_locator_t oloc = objecter->osdmap->file_to_object_locator(pr->layout);
@@ -431,6 +431,18 @@ void Journaler::_finish_flush(int r, uint64_t start, utime_t stamp)
     finish_contexts(cct, waitfor_safe.begin()->second);
     waitfor_safe.erase(waitfor_safe.begin());
   }
+
+  // don't let the persisted head fall too far behind safe_pos, or a
+  // crash costs us a long reprobe; last_written is updated when the
+  // head write is issued, so this fires once per lag interval.
+  uint64_t max_lag = cct->_conf->journaler_write_head_max_lag;
+  if (max_lag && state == STATE_ACTIVE &&
+      safe_pos - last_written.write_pos >= max_lag) {
+    ldout(cct, 10) << "_finish_flush safe_pos " << safe_pos
+		   << " leads written head " << last_written.write_pos
+		   << " by >= " << max_lag << ", writing head" << dendl;
+    write_head();
+  }
 }
 
 
@@ -478,6 +490,15 @@ uint64_t Journaler::append_entry(bufferlist& bl)
   if (write_obj != flush_obj) {
     ldout(cct, 10) << " flushing completed object(s) (su " << su << " wro " << write_obj << " flo " << flush_obj << ")" << dendl;
     _do_flush(write_buf.length() - write_off);
+  } else if (cct->_conf->journaler_coalesce_stripe_writes) {
+    // flush any filled stripe units so they go out as aligned writes,
+    // keeping only the partial tail buffered for further coalescing
+    uint64_t stripe_unit = layout.fl_stripe_unit;
+    if (write_pos / stripe_unit != flush_pos / stripe_unit) {
+      ldout(cct, 10) << " flushing filled stripe unit(s) (su " << stripe_unit
+		     << ")" << dendl;
+      _do_flush(write_buf.length() - write_pos % stripe_unit);
+    }
   }
 
   return write_pos;
@@ -816,10 +837,17 @@ void Journaler::_issue_read(uint64_t len)
   // here because it will wait for all object reads to complete before
   // giving us back any data.  this way we can process whatever bits
   // come in that are contiguous.
-  uint64_t period = get_layout_period();
+  //
+  // with a striped layout a period still spans every object in the
+  // stripe, so optionally step by stripe unit instead: each read then
+  // completes as soon as its one object read does.
+  uint64_t step = get_layout_period();
+  if (cct->_conf->journaler_prefetch_stripe_reads &&
+      layout.fl_stripe_count > 1)
+    step = layout.fl_stripe_unit;
   while (len > 0) {
-    uint64_t e = requested_pos + period;
-    e -= e % period;
+    uint64_t e = requested_pos + step;
+    e -= e % step;
     uint64_t l = e - requested_pos;
     if (l > len)
       l = len;
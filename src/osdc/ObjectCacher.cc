@@ -618,18 +618,44 @@ void ObjectCacher::bh_read(BufferHead *bh)
   C_ReadFinish *onfinish = new C_ReadFinish(this, bh->ob, bh->last_read_tid,
 					    bh->start(), bh->length());
   // go
-  writeback_handler.read(bh->ob->get_oid(), bh->ob->get_oloc(),
-			 bh->start(), bh->length(), bh->ob->get_snap(),
-			 &onfinish->bl, bh->ob->truncate_size, bh->ob->truncate_seq,
-			 onfinish);
+  if (writeback_handler.can_read_sparse()) {
+    // ask for the allocated extent map too, so bh's that land in holes
+    // can be cached as zero bh's instead of buffers full of zeroes
+    onfinish->sparse = true;
+    writeback_handler.read_sparse(bh->ob->get_oid(), bh->ob->get_oloc(),
+				  bh->start(), bh->length(), bh->ob->get_snap(),
+				  &onfinish->extent_map, &onfinish->bl,
+				  bh->ob->truncate_size, bh->ob->truncate_seq,
+				  onfinish);
+  } else {
+    writeback_handler.read(bh->ob->get_oid(), bh->ob->get_oloc(),
+			   bh->start(), bh->length(), bh->ob->get_snap(),
+			   &onfinish->bl, bh->ob->truncate_size, bh->ob->truncate_seq,
+			   onfinish);
+  }
 
   ++reads_outstanding;
 }
 
+// true if [off, off+len) overlaps any allocated extent
+static bool extents_intersect(const map<uint64_t, uint64_t> &extent_map,
+			      uint64_t off, uint64_t len)
+{
+  map<uint64_t, uint64_t>::const_iterator p = extent_map.lower_bound(off);
+  if (p != extent_map.begin()) {
+    --p;
+    if (p->first + p->second > off)
+      return true;
+    ++p;
+  }
+  return p != extent_map.end() && p->first < off + len;
+}
+
 void ObjectCacher::bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
 				  loff_t start, uint64_t length,
 				  bufferlist &bl, int r,
-				  bool trust_enoent)
+				  bool trust_enoent,
+				  bool sparse, map<uint64_t, uint64_t> &extent_map)
 {
   assert(lock.is_locked());
   ldout(cct, 7) << "bh_read_finish " 
@@ -641,6 +667,28 @@ void ObjectCacher::bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
 		<< " outstanding reads " << reads_outstanding
 		<< dendl;
 
+  if (r >= 0 && sparse) {
+    // inflate the sparse result into a flat buffer covering
+    // [start, start+length); the extent map is kept around so that
+    // bh's falling entirely in holes can be marked zero below
+    bufferlist flat;
+    uint64_t pos = start;
+    uint64_t data_off = 0;
+    for (map<uint64_t, uint64_t>::iterator p = extent_map.begin();
+	 p != extent_map.end();
+	 ++p) {
+      assert(p->first >= pos);
+      if (p->first > pos)
+	flat.append_zero(p->first - pos);
+      bufferlist frag;
+      frag.substr_of(bl, data_off, p->second);
+      flat.claim_append(frag);
+      data_off += p->second;
+      pos = p->first + p->second;
+    }
+    bl.swap(flat);
+  }
+
   if (bl.length() < length) {
     bufferptr bp(length - bl.length());
     bp.zero();
@@ -778,6 +826,11 @@ void ObjectCacher::bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
       if (r < 0) {
 	bh->error = r;
 	mark_error(bh);
+      } else if (sparse &&
+		 !extents_intersect(extent_map, oldpos, bh->length())) {
+	// entirely inside a hole; don't keep a buffer of zeroes around
+	bh->bl.clear();
+	mark_zero(bh);
       } else {
 	bh->bl.substr_of(bl,
 			 oldpos-bh->start(),
@@ -954,7 +1007,19 @@ void ObjectCacher::trim()
 		 << ", objects: max " << max_objects << " current " << ob_lru.lru_get_size()
 		 << dendl;
 
+  // bound the work done per call; anything left over is picked up by
+  // the trim() on the next read or write, so a large backlog is evicted
+  // incrementally instead of in one long pass under the lock.
+  int budget = cct->_conf->objectcacher_max_trim_per_call;
+
   while (get_stat_clean() > 0 && (uint64_t) get_stat_clean() > max_size) {
+    if (budget == 0) {
+      ldout(cct, 10) << "trim budget exhausted, deferring" << dendl;
+      break;
+    }
+    if (budget > 0)
+      budget--;
+
     BufferHead *bh = static_cast<BufferHead*>(bh_lru_rest.lru_expire());
     if (!bh)
       break;
@@ -973,6 +1038,13 @@ void ObjectCacher::trim()
   }
 
   while (ob_lru.lru_get_size() > max_objects) {
+    if (budget == 0) {
+      ldout(cct, 10) << "trim budget exhausted, deferring" << dendl;
+      break;
+    }
+    if (budget > 0)
+      budget--;
+
     Object *ob = static_cast<Object*>(ob_lru.lru_expire());
     if (!ob)
       break;
@@ -330,8 +330,14 @@ class ObjectCacher {
   WritebackHandler& writeback_handler;
 
   string name;
+  // borrowed from the owner (Client, librbd); their completions and the
+  // WritebackHandler run under it, so the cache cannot shard its
+  // locking per object set without first owning a lock of its own.
+  // note before reaching for a hash index instead: object lookup below
+  // is already O(1) per pool, and the per-object BufferHead maps must
+  // stay ordered -- map_read/map_write are range queries.
   Mutex& lock;
-  
+
   uint64_t max_dirty, target_dirty, max_size, max_objects;
   utime_t max_dirty_age;
   bool block_writes_upfront;
@@ -462,7 +468,8 @@ class ObjectCacher {
   void bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
 		      loff_t offset, uint64_t length,
 		      bufferlist &bl, int r,
-		      bool trust_enoent);
+		      bool trust_enoent,
+		      bool sparse, map<uint64_t, uint64_t> &extent_map);
   void bh_write_commit(int64_t poolid, sobject_t oid, loff_t offset,
 		       uint64_t length, ceph_tid_t t, int r);
 
@@ -477,16 +484,19 @@ class ObjectCacher {
     ceph_tid_t tid;
 
   public:
+    bool sparse;                         ///< read issued as a sparse-read
+    map<uint64_t, uint64_t> extent_map;  ///< allocated extents, if sparse
     bufferlist bl;
     C_ReadFinish(ObjectCacher *c, Object *ob, ceph_tid_t t, loff_t s, uint64_t l) :
       oc(c), poolid(ob->oloc.pool), oid(ob->get_soid()), start(s), length(l),
       set_item(this), trust_enoent(true),
-      tid(t) {
+      tid(t), sparse(false) {
       ob->reads.push_back(&set_item);
     }
 
     void finish(int r) {
-      oc->bh_read_finish(poolid, oid, tid, start, length, bl, r, trust_enoent);
+      oc->bh_read_finish(poolid, oid, tid, start, length, bl, r, trust_enoent,
+			 sparse, extent_map);
 
       // object destructor clears the list
       if (set_item.is_on_list())
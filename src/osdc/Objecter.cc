@@ -164,6 +164,13 @@ void Objecter::init_unlocked()
 {
   assert(!initialized);
 
+  // pick up the initial crush_location (and track later changes) so
+  // that LOCALIZE_READS can actually rank replicas by crush distance
+  cct->_conf->add_observer(this);
+  set<string> changed;
+  changed.insert("crush_location");
+  handle_conf_change(cct->_conf, changed);
+
   if (!logger) {
     PerfCountersBuilder pcb(cct, "objecter", l_osdc_first, l_osdc_last);
 
@@ -289,6 +296,8 @@ void Objecter::shutdown_locked()
 
 void Objecter::shutdown_unlocked()
 {
+  cct->_conf->remove_observer(this);
+
   if (m_request_state_hook) {
     AdminSocket* admin_socket = cct->get_admin_socket();
     admin_socket->unregister_command("objecter_requests");
@@ -1308,6 +1317,7 @@ ceph_tid_t Objecter::_op_submit(Op *op)
     case CEPH_OSD_OP_TMAPPUT: code = l_osdc_osdop_tmap_put; break;
     case CEPH_OSD_OP_TMAPGET: code = l_osdc_osdop_tmap_get; break;
     case CEPH_OSD_OP_CALL: code = l_osdc_osdop_call; break;
+    case CEPH_OSD_OP_CALL_CHAIN: code = l_osdc_osdop_call; break;
     case CEPH_OSD_OP_WATCH: code = l_osdc_osdop_watch; break;
     case CEPH_OSD_OP_NOTIFY: code = l_osdc_osdop_notify; break;
     case CEPH_OSD_OP_SRC_CMPXATTR: code = l_osdc_osdop_src_cmpxattr; break;
@@ -1483,7 +1493,18 @@ int Objecter::calc_target(op_target_t *t)
   }
   int primary;
   vector<int> acting;
-  osdmap->pg_to_acting_osds(pgid, &acting, &primary);
+  if (pg_mapping_epoch != osdmap->get_epoch()) {
+    pg_mapping_cache.clear();
+    pg_mapping_epoch = osdmap->get_epoch();
+  }
+  map<pg_t, pair<vector<int>, int> >::iterator q = pg_mapping_cache.find(pgid);
+  if (q != pg_mapping_cache.end()) {
+    acting = q->second.first;
+    primary = q->second.second;
+  } else {
+    osdmap->pg_to_acting_osds(pgid, &acting, &primary);
+    pg_mapping_cache[pgid] = make_pair(acting, primary);
+  }
 
   bool need_resend = false;
 
@@ -1507,7 +1528,10 @@ int Objecter::calc_target(op_target_t *t)
     } else {
       int osd;
       bool read = is_read && !is_write;
-      if (read && (t->flags & CEPH_OSD_FLAG_BALANCE_READS)) {
+      const pg_pool_t *pgpool = osdmap->get_pg_pool(pgid.pool());
+      bool balance_reads = (t->flags & CEPH_OSD_FLAG_BALANCE_READS) ||
+	(pgpool && (pgpool->flags & pg_pool_t::FLAG_BALANCE_READS));
+      if (read && balance_reads) {
 	int p = rand() % acting.size();
 	if (p)
 	  t->used_replica = true;
@@ -1630,6 +1654,14 @@ void Objecter::send_op(Op *op)
   if (op->onack)
     flags |= CEPH_OSD_FLAG_ACK;
 
+  // sample every Nth op for cross-daemon tracing; the osds archive
+  // flagged ops so their timelines can be stitched together by reqid
+  if (cct->_conf->objecter_trace_every &&
+      ++trace_seq >= cct->_conf->objecter_trace_every) {
+    trace_seq = 0;
+    flags |= CEPH_OSD_FLAG_TRACE;
+  }
+
   assert(op->session->con);
 
   // preallocated rx buffer?
@@ -2470,15 +2502,38 @@ void Objecter::_sg_read_finish(vector<ObjectExtent>& extents, vector<bufferlist>
   ldout(cct, 15) << "_sg_read_finish" << dendl;
 
   if (extents.size() > 1) {
-    Striper::StripedReadResult r;
+    // common case (stripe_count == 1 layouts): one buffer extent per
+    // object extent, already in file order, fully satisfied.  the reply
+    // buffers can be claimed directly in order, skipping the
+    // partial-result map.  a short or sparse reply falls back to the
+    // general reassembly below.
+    bool in_order = true;
+    uint64_t pos = 0;
     vector<bufferlist>::iterator bit = resultbl.begin();
     for (vector<ObjectExtent>::iterator eit = extents.begin();
-	 eit != extents.end();
+	 eit != extents.end() && in_order;
 	 ++eit, ++bit) {
-      r.add_partial_result(cct, *bit, eit->buffer_extents);
+      if (eit->buffer_extents.size() != 1 ||
+	  eit->buffer_extents[0].first != pos ||
+	  bit->length() != eit->buffer_extents[0].second)
+	in_order = false;
+      else
+	pos += bit->length();
     }
     bl->clear();
-    r.assemble_result(cct, *bl, false);
+    if (in_order) {
+      for (bit = resultbl.begin(); bit != resultbl.end(); ++bit)
+	bl->claim_append(*bit);
+    } else {
+      Striper::StripedReadResult r;
+      bit = resultbl.begin();
+      for (vector<ObjectExtent>::iterator eit = extents.begin();
+	   eit != extents.end();
+	   ++eit, ++bit) {
+	r.add_partial_result(cct, *bit, eit->buffer_extents);
+      }
+      r.assemble_result(cct, *bl, false);
+    }
   } else {
     ldout(cct, 15) << "  only one frag" << dendl;
     bl->claim(resultbl[0]);
@@ -318,6 +318,14 @@ struct ObjectOperation {
     out_handler[p] = h;
     out_rval[p] = prval;
   }
+  void readv(const vector<pair<uint64_t,uint64_t> >& extents,
+	     bufferlist *pbl, int *prval) {
+    OSDOp& osd_op = add_op(CEPH_OSD_OP_READV);
+    ::encode(extents, osd_op.indata);
+    unsigned p = ops.size() - 1;
+    out_bl[p] = pbl;
+    out_rval[p] = prval;
+  }
   void write(uint64_t off, bufferlist& bl,
              uint64_t truncate_size,
              uint32_t truncate_seq) {
@@ -329,6 +337,18 @@ struct ObjectOperation {
   void write(uint64_t off, bufferlist& bl) {
     write(off, bl, 0, 0);
   }
+  void writev(const vector<pair<uint64_t,uint64_t> >& extents,
+	      bufferlist& bl) {
+    OSDOp& osd_op = add_op(CEPH_OSD_OP_WRITEV);
+    ::encode(extents, osd_op.indata);
+    osd_op.indata.claim_append(bl);
+  }
+  void writesame(uint64_t off, uint64_t write_len, bufferlist& bl) {
+    OSDOp& osd_op = add_op(CEPH_OSD_OP_WRITESAME);
+    osd_op.op.extent.offset = off;
+    osd_op.op.extent.length = write_len;
+    osd_op.indata.claim_append(bl);
+  }
   void write_full(bufferlist& bl) {
     add_data(CEPH_OSD_OP_WRITEFULL, 0, bl.length(), bl);
   }
@@ -388,6 +408,39 @@ struct ObjectOperation {
       }
     }
   };
+  struct C_ObjectOperation_decodevalsfiltered : public Context {
+    bufferlist bl;
+    std::map<std::string,bufferlist> *pattrs;
+    std::string *pnext_after;
+    bool *pmore;
+    int *prval;
+    C_ObjectOperation_decodevalsfiltered(std::map<std::string,bufferlist> *pa,
+					 std::string *pn, bool *pm, int *pr)
+      : pattrs(pa), pnext_after(pn), pmore(pm), prval(pr) {}
+    void finish(int r) {
+      if (r >= 0) {
+	bufferlist::iterator p = bl.begin();
+	try {
+	  std::map<std::string,bufferlist> attrs;
+	  std::string next_after;
+	  bool more;
+	  ::decode(attrs, p);
+	  ::decode(next_after, p);
+	  ::decode(more, p);
+	  if (pattrs)
+	    pattrs->swap(attrs);
+	  if (pnext_after)
+	    *pnext_after = next_after;
+	  if (pmore)
+	    *pmore = more;
+	}
+	catch (buffer::error& e) {
+	  if (prval)
+	    *prval = -EIO;
+	}
+      }
+    }
+  };
   struct C_ObjectOperation_decodekeys : public Context {
     bufferlist bl;
     std::set<std::string> *pattrs;
@@ -582,6 +635,48 @@ struct ObjectOperation {
     }
   }
 
+  /**
+   * scan omap entries with the predicate evaluated osd-side
+   *
+   * Only entries whose key starts with @c filter_prefix, whose key is
+   * below @c key_end (empty = unbounded) and whose value contains
+   * @c value_contains (empty = any) come back.  At most @c max_to_get
+   * matches are returned and at most @c max_scan entries examined
+   * (0 = unbounded); @c next_after names the last key examined so a
+   * follow-up scan can resume there when @c more is set.
+   */
+  void omap_get_vals_filtered(const string &start_after,
+			      uint64_t max_to_get,
+			      uint64_t max_scan,
+			      const string &filter_prefix,
+			      const string &key_end,
+			      const string &value_contains,
+			      std::map<std::string, bufferlist> *out_set,
+			      std::string *next_after,
+			      bool *more,
+			      int *prval) {
+    OSDOp &op = add_op(CEPH_OSD_OP_OMAPGETVALSFILTERED);
+    bufferlist bl;
+    ::encode(start_after, bl);
+    ::encode(max_to_get, bl);
+    ::encode(max_scan, bl);
+    ::encode(filter_prefix, bl);
+    ::encode(key_end, bl);
+    ::encode(value_contains, bl);
+    op.op.extent.offset = 0;
+    op.op.extent.length = bl.length();
+    op.indata.claim_append(bl);
+    if (prval || out_set || next_after || more) {
+      unsigned p = ops.size() - 1;
+      C_ObjectOperation_decodevalsfiltered *h =
+	new C_ObjectOperation_decodevalsfiltered(out_set, next_after, more,
+						 prval);
+      out_handler[p] = h;
+      out_bl[p] = &h->bl;
+      out_rval[p] = prval;
+    }
+  }
+
   void omap_get_vals_by_keys(const std::set<std::string> &to_get,
 			    std::map<std::string, bufferlist> *out_set,
 			    int *prval) {
@@ -855,6 +950,17 @@ struct ObjectOperation {
     add_call(CEPH_OSD_OP_CALL, cname, method, indata, outdata, ctx, prval);
   }
 
+  /* like call, but the osd appends the previous op's outdata to indata
+   * before invoking the method */
+  void call_chain(const char *cname, const char *method, bufferlist &indata) {
+    add_call(CEPH_OSD_OP_CALL_CHAIN, cname, method, indata, NULL, NULL, NULL);
+  }
+
+  void call_chain(const char *cname, const char *method, bufferlist &indata,
+		  bufferlist *outdata, Context *ctx, int *prval) {
+    add_call(CEPH_OSD_OP_CALL_CHAIN, cname, method, indata, outdata, ctx, prval);
+  }
+
   // watch/notify
   void watch(uint64_t cookie, uint64_t ver, bool set) {
     bufferlist inbl;
@@ -1018,6 +1124,7 @@ private:
   uint64_t max_linger_id;
   int num_unacked;
   int num_uncommitted;
+  uint64_t trace_seq; // ops sent since we last set CEPH_OSD_FLAG_TRACE
   int global_op_flags; // flags which are applied to each IO op
   bool keep_balanced_budget;
   bool honor_osdmap_full;
@@ -1029,6 +1136,26 @@ private:
   version_t last_seen_osdmap_version;
   version_t last_seen_pgmap_version;
 
+  // memoized pg -> (acting, primary) mapping for the current osdmap
+  // epoch.  rescanning tens of thousands of in-flight ops on a map
+  // update then costs one crush calculation per distinct pg instead of
+  // one per op.  cleared whenever the epoch advances.
+  map<pg_t, pair<vector<int>, int> > pg_mapping_cache;
+  epoch_t pg_mapping_epoch;
+
+  // The Objecter has no locking of its own: every entry point, every
+  // message handler, the tick timer, and all op completions run under
+  // this single lock borrowed from the owner (Client, librados, the
+  // MDS).  Giving it sharded op tables or per-OSDSession locks is not
+  // an incremental change: the owner's completion contexts fire under
+  // this lock and freely touch owner state, the WritebackHandler calls
+  // back in while the owner holds it, and handle_osd_map atomically
+  // re-targets every in-flight op against the new map -- a consistent
+  // snapshot that per-session locks would have to reconstruct with an
+  // ordered multi-lock dance.  Ownership of the lock has to move into
+  // the Objecter (with owner callbacks moved out from under it) before
+  // any finer-grained scheme can work; don't bolt shards on beneath a
+  // lock we don't own.
   Mutex &client_lock;
   SafeTimer &timer;
 
@@ -1542,11 +1669,12 @@ public:
     messenger(m), monc(mc), osdmap(om), cct(cct_),
     initialized(false),
     last_tid(0), client_inc(-1), max_linger_id(0),
-    num_unacked(0), num_uncommitted(0),
+    num_unacked(0), num_uncommitted(0), trace_seq(0),
     global_op_flags(0),
     keep_balanced_budget(false), honor_osdmap_full(true),
     last_seen_osdmap_version(0),
     last_seen_pgmap_version(0),
+    pg_mapping_epoch(0),
     client_lock(l), timer(t),
     logger(NULL), tick_event(NULL),
     m_request_state_hook(NULL),
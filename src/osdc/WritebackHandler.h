@@ -16,6 +16,19 @@ class WritebackHandler {
 		    uint64_t off, uint64_t len, snapid_t snapid,
 		    bufferlist *pbl, uint64_t trunc_size,  __u32 trunc_seq,
 		    Context *onfinish) = 0;
+  /// true if read_sparse() is implemented
+  virtual bool can_read_sparse() { return false; }
+  /**
+   * as read(), but additionally return the object's allocated extent
+   * map so the caller can tell holes apart from written zeros
+   */
+  virtual void read_sparse(const object_t& oid, const object_locator_t& oloc,
+			   uint64_t off, uint64_t len, snapid_t snapid,
+			   map<uint64_t, uint64_t> *extents, bufferlist *pbl,
+			   uint64_t trunc_size, __u32 trunc_seq,
+			   Context *onfinish) {
+    assert(0 == "this WritebackHandler does not support sparse reads");
+  }
   /**
    * check if a given extent read result may change due to a write
    *
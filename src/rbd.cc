@@ -15,6 +15,8 @@
 
 #include "common/errno.h"
 #include "common/ceph_argparse.h"
+#include "common/Throttle.h"
+#include "include/Context.h"
 #include "common/strtol.h"
 #include "global/global_init.h"
 #include "common/safe_io.h"
@@ -1035,39 +1037,115 @@ static int export_read_cb(uint64_t ofs, size_t len, const char *buf, void *arg)
   return 0;
 }
 
+static void aio_context_callback(void *completion, void *arg)
+{
+  librbd::RBD::AioCompletion *aio_completion =
+    (librbd::RBD::AioCompletion *)completion;
+  Context *ctx = static_cast<Context *>(arg);
+  ctx->complete(aio_completion->get_return_value());
+  aio_completion->release();
+}
+
+class C_Export : public Context
+{
+public:
+  C_Export(SimpleThrottle &throttle, librbd::Image &image,
+	   uint64_t offset, uint64_t length, int fd)
+    : m_throttle(throttle), m_image(image), m_offset(offset),
+      m_length(length), m_fd(fd)
+  {}
+
+  void send() {
+    m_throttle.start_op();
+    librbd::RBD::AioCompletion *aio_completion =
+      new librbd::RBD::AioCompletion(this, &aio_context_callback);
+    int r = m_image.aio_read(m_offset, m_length, m_bufferlist, aio_completion);
+    if (r < 0) {
+      cerr << "rbd: error requesting read from source image" << std::endl;
+      aio_completion->release();
+      complete(r);
+    }
+  }
+
+  virtual void finish(int r) {
+    if (r < 0) {
+      cerr << "rbd: error reading from source image at offset "
+	   << m_offset << ": " << cpp_strerror(r) << std::endl;
+    } else if (m_bufferlist.is_zero()) {
+      // skip writing zeros so the destination file can be sparse
+      r = 0;
+    } else if (lseek64(m_fd, m_offset, SEEK_SET) < 0) {
+      r = -errno;
+      cerr << "rbd: error seeking to offset " << m_offset << std::endl;
+    } else {
+      r = m_bufferlist.write_fd(m_fd);
+      if (r < 0)
+	cerr << "rbd: error writing to destination file at offset "
+	     << m_offset << std::endl;
+    }
+    m_throttle.end_op(r);
+  }
+
+private:
+  SimpleThrottle &m_throttle;
+  librbd::Image &m_image;
+  bufferlist m_bufferlist;
+  uint64_t m_offset;
+  uint64_t m_length;
+  int m_fd;
+};
+
 static int do_export(librbd::Image& image, const char *path)
 {
   int64_t r;
   librbd::image_info_t info;
-  int fd;
 
   r = image.stat(info, sizeof(info));
   if (r < 0)
     return r;
 
-  if (strcmp(path, "-") == 0)
-    fd = 1;
-  else
-    fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (strcmp(path, "-") == 0) {
+    // a pipe can't seek, so data must be produced in offset order;
+    // keep the serial walk for this case
+    ExportContext ec(&image, 1, info.size);
+    r = image.read_iterate2(0, info.size, export_read_cb, (void *)&ec);
+    if (r < 0)
+      ec.pc.fail();
+    else
+      ec.pc.finish();
+    return r;
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
   if (fd < 0)
     return -errno;
 
-  ExportContext ec(&image, fd, info.size);
-  r = image.read_iterate2(0, info.size, export_read_cb, (void *)&ec);
-  if (r < 0)
-    goto out;
+  MyProgressContext pc("Exporting image");
+
+  // keep N stripe-period-sized reads in flight; each one writes its
+  // data at the right file offset when it completes, so no reassembly
+  // pass is needed and holes stay sparse
+  SimpleThrottle throttle(g_conf->rbd_concurrent_management_ops, false);
+  uint64_t period = image.get_stripe_count() * info.obj_size;
+  for (uint64_t offset = 0; offset < info.size; offset += period) {
+    uint64_t length = min(period, info.size - offset);
+    C_Export *ctx = new C_Export(throttle, image, offset, length, fd);
+    ctx->send();
+    pc.update_progress(offset, info.size);
+  }
 
-  if (fd != 1)
+  r = throttle.wait_for_ret();
+  if (r >= 0) {
     r = ftruncate(fd, info.size);
-  if (r < 0)
-    goto out;
+    if (r < 0)
+      r = -errno;
+  }
 
- out:
   close(fd);
   if (r < 0)
-    ec.pc.fail();
+    pc.fail();
   else
-    ec.pc.finish();
+    pc.finish();
   return r;
 }
 
@@ -1310,6 +1388,7 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
   ssize_t readlen;		// amount received from one read
   size_t blklen = 0;		// amount accumulated from reads to fill blk
   librbd::Image image;
+  SimpleThrottle throttle(g_conf->rbd_concurrent_management_ops, false);
 
   bool from_stdin = !strcmp(path, "-");
   if (from_stdin) {
@@ -1381,12 +1460,19 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
     }
 
     // write as much as we got; perhaps less than imgblklen
-    // but skip writing zeros to create sparse images
+    // but skip writing zeros to create sparse images.  writes are
+    // pipelined: up to N blocks are in flight at once (aio_write
+    // copies the buffer, so bl can go out of scope immediately)
     if (!bl.is_zero()) {
-      r = image.write(image_pos, blklen, bl);
+      C_SimpleThrottle *ctx = new C_SimpleThrottle(&throttle);
+      librbd::RBD::AioCompletion *c =
+	new librbd::RBD::AioCompletion(ctx, &aio_context_callback);
+      r = image.aio_write(image_pos, blklen, bl, c);
       if (r < 0) {
 	cerr << "rbd: error writing to image position " << image_pos
 	     << std::endl;
+	c->release();
+	ctx->complete(r);
 	goto done;
       }
     }
@@ -1398,6 +1484,12 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
     blklen = 0;
     reqlen = imgblklen;
   }
+  r = throttle.wait_for_ret();
+  if (r < 0) {
+    cerr << "rbd: error writing to image" << std::endl;
+    goto done;
+  }
+
   if (from_stdin) {
     r = image.resize(image_pos);
     if (r < 0) {
@@ -1409,6 +1501,9 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
   r = 0;
 
  done:
+  // drain any writes still in flight on the error path before the
+  // image is closed
+  throttle.wait_for_ret();
   if (!from_stdin) {
     if (r < 0)
       pc.fail();
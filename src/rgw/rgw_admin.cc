@@ -1902,8 +1902,8 @@ next:
     formatter->open_array_section("objects");
     while (is_truncated) {
       map<string, RGWObjEnt> result;
-      int r = store->cls_bucket_list(bucket, marker, prefix, 1000, 
-                                     result, &is_truncated, &marker,
+      int r = store->cls_bucket_list(bucket, marker, prefix, string(), 1000,
+                                     result, &is_truncated, &marker, NULL,
                                      bucket_object_check_filter);
 
       if (r < 0 && r != -ENOENT) {
@@ -726,8 +726,8 @@ int RGWBucket::check_object_index(RGWBucketAdminOpState& op_state,
   while (is_truncated) {
     map<string, RGWObjEnt> result;
 
-    int r = store->cls_bucket_list(bucket, marker, prefix, 1000, result,
-             &is_truncated, &marker,
+    int r = store->cls_bucket_list(bucket, marker, prefix, string(), 1000, result,
+             &is_truncated, &marker, NULL,
              bucket_object_check_filter);
 
     if (r == -ENOENT) {
@@ -1683,7 +1683,7 @@ public:
 
     objv_tracker = bci.info.objv_tracker;
 
-    ret = store->init_bucket_index(bci.info.bucket);
+    ret = store->init_bucket_index(bci.info.bucket, bci.info.num_shards);
     if (ret < 0)
       return ret;
 
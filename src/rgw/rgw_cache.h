@@ -7,6 +7,7 @@
 #include "include/types.h"
 #include "include/utime.h"
 #include "include/assert.h"
+#include "include/ceph_hash.h"
 #include "common/RWLock.h"
 
 enum {
@@ -132,25 +133,52 @@ struct ObjectCacheEntry {
   ObjectCacheEntry() : lru_promotion_ts(0) {}
 };
 
+/**
+ * The cache is split into independently locked shards, selected by a
+ * hash of the entry name, so that concurrent requests don't all
+ * serialize on a single lock. Each shard runs its own LRU over its
+ * share of rgw_cache_lru_size.
+ */
 class ObjectCache {
-  std::map<string, ObjectCacheEntry> cache_map;
-  std::list<string> lru;
-  unsigned long lru_size;
-  unsigned long lru_counter;
+  struct Shard {
+    std::map<string, ObjectCacheEntry> cache_map;
+    std::list<string> lru;
+    unsigned long lru_size;
+    unsigned long lru_counter;
+    RWLock lock;
+
+    Shard() : lru_size(0), lru_counter(0), lock("ObjectCache::Shard") {}
+  };
+
+  Shard *shards;
+  int num_shards;
+  unsigned long shard_lru_size;
   unsigned long lru_window;
-  RWLock lock;
   CephContext *cct;
 
-  void touch_lru(string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter);
-  void remove_lru(string& name, std::list<string>::iterator& lru_iter);
+  Shard& get_shard(const string& name) {
+    uint32_t val = ceph_str_hash_linux(name.c_str(), name.size());
+    return shards[val % num_shards];
+  }
+
+  void touch_lru(Shard& shard, string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter);
+  void remove_lru(Shard& shard, std::list<string>::iterator& lru_iter);
 public:
-  ObjectCache() : lru_size(0), lru_counter(0), lru_window(0), lock("ObjectCache"), cct(NULL) { }
+  ObjectCache() : shards(NULL), num_shards(0), shard_lru_size(0), lru_window(0), cct(NULL) { }
+  ~ObjectCache() {
+    delete[] shards;
+  }
   int get(std::string& name, ObjectCacheInfo& bl, uint32_t mask);
   void put(std::string& name, ObjectCacheInfo& bl);
   void remove(std::string& name);
   void set_ctx(CephContext *_cct) {
     cct = _cct;
-    lru_window = cct->_conf->rgw_cache_lru_size / 2;
+    num_shards = cct->_conf->rgw_cache_shards;
+    if (num_shards < 1)
+      num_shards = 1;
+    shards = new Shard[num_shards];
+    shard_lru_size = cct->_conf->rgw_cache_lru_size / num_shards + 1;
+    lru_window = shard_lru_size / 2;
   }
 };
 
@@ -60,6 +60,36 @@ int RGWClientIO::write(const char *buf, int len)
 }
 
 
+int RGWClientIO::write(bufferlist& bl, uint64_t ofs, uint64_t len)
+{
+  /* hand the raw segments to the frontend one by one; calling c_str()
+   * on a fragmented list would reallocate and copy the whole range
+   * into a single contiguous buffer first */
+  std::list<bufferptr>::const_iterator iter = bl.buffers().begin();
+  for (; iter != bl.buffers().end() && len > 0; ++iter) {
+    if (ofs >= iter->length()) {
+      ofs -= iter->length();
+      continue;
+    }
+
+    uint64_t l = iter->length() - ofs;
+    if (l > len)
+      l = len;
+
+    int ret = write_data(iter->c_str() + ofs, l);
+    if (ret < 0)
+      return ret;
+
+    if (account)
+      bytes_sent += l;
+
+    len -= l;
+    ofs = 0;
+  }
+
+  return 0;
+}
+
 int RGWClientIO::read(char *buf, int max, int *actual)
 {
   int ret = read_data(buf, max);
@@ -28,6 +28,7 @@ public:
   void init(CephContext *cct);
   int print(const char *format, ...);
   int write(const char *buf, int len);
+  int write(bufferlist& bl, uint64_t ofs, uint64_t len);
   virtual void flush() = 0;
   int read(char *buf, int max, int *actual);
 
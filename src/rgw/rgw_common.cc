@@ -46,6 +46,11 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_keystone_token_cache_hit, "keystone_token_cache_hit");
   plb.add_u64_counter(l_rgw_keystone_token_cache_miss, "keystone_token_cache_miss");
 
+  plb.add_u64_counter(l_rgw_gc_obj_removed, "gc_obj_removed");
+  plb.add_u64_counter(l_rgw_gc_chain_removed, "gc_chain_removed");
+  plb.add_u64_counter(l_rgw_gc_chain_failed, "gc_chain_failed");
+  plb.add_u64(l_rgw_gc_backlog_secs, "gc_backlog_secs");
+
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
   return 0;
@@ -255,6 +255,7 @@ void RGWBucketInfo::generate_test_instances(list<RGWBucketInfo*>& o)
   i->bucket = rgw_bucket("bucket", "pool", ".index_pool", "marker", "10", "region");
   i->owner = "owner";
   i->flags = BUCKET_SUSPENDED;
+  i->num_shards = 8;
   o.push_back(i);
   o.push_back(new RGWBucketInfo);
 }
@@ -127,12 +127,52 @@ int RGWGC::list(int *index, string& marker, uint32_t max, bool expired_only, std
   return 0;
 }
 
+struct gc_inflight_io {
+  AioCompletion *completion;
+  bool *chain_failed;
+  cls_rgw_obj obj;
+};
+
+/* reap the oldest in-flight removal, marking the owning chain failed on error */
+static void gc_wait_io(CephContext *cct, std::list<gc_inflight_io>& ios)
+{
+  gc_inflight_io io = ios.front();
+  ios.pop_front();
+
+  io.completion->wait_for_complete();
+  int ret = io.completion->get_return_value();
+  io.completion->release();
+
+  if (ret == -ENOENT)
+    ret = 0;
+  if (ret < 0) {
+    *io.chain_failed = true;
+    ldout(cct, 0) << "failed to remove " << io.obj.pool << ":" << io.obj.oid << "@" << io.obj.key << dendl;
+    return;
+  }
+  if (perfcounter)
+    perfcounter->inc(l_rgw_gc_obj_removed);
+}
+
 int RGWGC::process(int index, int max_secs)
 {
   rados::cls::lock::Lock l(gc_index_lock_name);
   utime_t end = ceph_clock_now(g_ceph_context);
   std::list<string> remove_tags;
 
+  /* chained object removals are issued asynchronously, up to max_io in
+   * flight; a chain's tag is only removed once all of its removals have
+   * completed successfully */
+  std::list<gc_inflight_io> ios;
+  std::list<std::pair<string, bool> > chains; /* tag, failed */
+  std::map<string, IoCtx *> pool_ctxs; /* must outlive in-flight aio */
+  std::map<string, IoCtx *>::iterator citer;
+  bool first_batch = true;
+
+  int max_io = cct->_conf->rgw_gc_max_concurrent_io;
+  if (max_io < 1)
+    max_io = 1;
+
   /* max_secs should be greater than zero. We don't want a zero max_secs
    * to be translated as no timeout, since we'd then need to break the
    * lock and that would require a manual intervention. In this case
@@ -154,7 +194,6 @@ int RGWGC::process(int index, int max_secs)
 
   string marker;
   bool truncated;
-  IoCtx *ctx = NULL;
   do {
     int max = 100;
     std::list<cls_rgw_gc_obj_info> entries;
@@ -166,11 +205,18 @@ int RGWGC::process(int index, int max_secs)
     if (ret < 0)
       goto done;
 
-    string last_pool;
-    ctx = new IoCtx;
+    if (first_batch && !entries.empty()) {
+      /* entries come back ordered by expiration time, so the head of the
+       * first batch samples how far this shard's backlog is overdue */
+      utime_t now = ceph_clock_now(g_ceph_context);
+      utime_t& oldest = entries.front().time;
+      if (perfcounter)
+        perfcounter->set(l_rgw_gc_backlog_secs, (now > oldest ? now.sec() - oldest.sec() : 0));
+      first_batch = false;
+    }
+
     std::list<cls_rgw_gc_obj_info>::iterator iter;
     for (iter = entries.begin(); iter != entries.end(); ++iter) {
-      bool remove_tag;
       cls_rgw_gc_obj_info& info = *iter;
       std::list<cls_rgw_obj>::iterator liter;
       cls_rgw_obj_chain& chain = info.chain;
@@ -179,58 +225,92 @@ int RGWGC::process(int index, int max_secs)
       if (now >= end)
         goto done;
 
-      remove_tag = true;
+      chains.push_back(std::pair<string, bool>(info.tag, false));
+      bool *chain_failed = &chains.back().second;
+
       for (liter = chain.objs.begin(); liter != chain.objs.end(); ++liter) {
         cls_rgw_obj& obj = *liter;
 
-        if (obj.pool != last_pool) {
-          delete ctx;
+        IoCtx *ctx;
+        citer = pool_ctxs.find(obj.pool);
+        if (citer == pool_ctxs.end()) {
           ctx = new IoCtx;
-	  ret = store->rados->ioctx_create(obj.pool.c_str(), *ctx);
-	  if (ret < 0) {
-	    dout(0) << "ERROR: failed to create ioctx pool=" << obj.pool << dendl;
-	    continue;
-	  }
-          last_pool = obj.pool;
+          ret = store->rados->ioctx_create(obj.pool.c_str(), *ctx);
+          if (ret < 0) {
+            delete ctx;
+            dout(0) << "ERROR: failed to create ioctx pool=" << obj.pool << dendl;
+            *chain_failed = true;
+            continue;
+          }
+          pool_ctxs[obj.pool] = ctx;
+        } else {
+          ctx = citer->second;
         }
 
         ctx->locator_set_key(obj.key);
-	dout(0) << "gc::process: removing " << obj.pool << ":" << obj.oid << dendl;
-	ObjectWriteOperation op;
-	cls_refcount_put(op, info.tag, true);
-        ret = ctx->operate(obj.oid, &op);
-	if (ret == -ENOENT)
-	  ret = 0;
+        dout(0) << "gc::process: removing " << obj.pool << ":" << obj.oid << dendl;
+        ObjectWriteOperation op;
+        cls_refcount_put(op, info.tag, true);
+
+        gc_inflight_io io;
+        io.completion = librados::Rados::aio_create_completion(NULL, NULL, NULL);
+        io.chain_failed = chain_failed;
+        io.obj = obj;
+        ret = ctx->aio_operate(obj.oid, io.completion, &op);
         if (ret < 0) {
-          remove_tag = false;
+          io.completion->release();
+          *chain_failed = true;
           dout(0) << "failed to remove " << obj.pool << ":" << obj.oid << "@" << obj.key << dendl;
+        } else {
+          ios.push_back(io);
         }
 
+        while ((int)ios.size() >= max_io)
+          gc_wait_io(cct, ios);
+
         if (going_down()) // leave early, even if tag isn't removed, it's ok
           goto done;
       }
-      if (remove_tag) {
-        remove_tags.push_back(info.tag);
+    }
+
+    /* wait for the whole batch before deciding which tags may go */
+    while (!ios.empty())
+      gc_wait_io(cct, ios);
+
+    std::list<std::pair<string, bool> >::iterator chiter;
+    for (chiter = chains.begin(); chiter != chains.end(); ++chiter) {
+      if (chiter->second) {
+        if (perfcounter)
+          perfcounter->inc(l_rgw_gc_chain_failed);
+        continue;
+      }
+      if (perfcounter)
+        perfcounter->inc(l_rgw_gc_chain_removed);
+      remove_tags.push_back(chiter->first);
 #define MAX_REMOVE_CHUNK 16
-        if (remove_tags.size() > MAX_REMOVE_CHUNK) {
-          remove(index, remove_tags);
-          remove_tags.clear();
-        }
+      if (remove_tags.size() > MAX_REMOVE_CHUNK) {
+        remove(index, remove_tags);
+        remove_tags.clear();
       }
     }
+    chains.clear();
   } while (truncated);
 
 done:
+  /* drain whatever is still in flight; chains cut short here keep their
+   * tags and will be retried on a later cycle */
+  while (!ios.empty())
+    gc_wait_io(cct, ios);
   if (!remove_tags.empty())
     remove(index, remove_tags);
   l.unlock(&store->gc_pool_ctx, obj_names[index]);
-  delete ctx;
+  for (citer = pool_ctxs.begin(); citer != pool_ctxs.end(); ++citer)
+    delete citer->second;
   return 0;
 }
 
-int RGWGC::process()
+int RGWGC::process_shards(int worker_id, int num_workers)
 {
-  int max_objs = cct->_conf->rgw_gc_max_objs;
   int max_secs = cct->_conf->rgw_gc_processor_max_time;
 
   unsigned start;
@@ -240,6 +320,8 @@ int RGWGC::process()
 
   for (int i = 0; i < max_objs; i++) {
     int index = (i + start) % max_objs;
+    if (index % num_workers != worker_id) /* someone else's shard */
+      continue;
     ret = process(index, max_secs);
     if (ret < 0)
       return ret;
@@ -248,6 +330,11 @@ int RGWGC::process()
   return 0;
 }
 
+int RGWGC::process()
+{
+  return process_shards(0, 1);
+}
+
 bool RGWGC::going_down()
 {
   return (down_flag.read() != 0);
@@ -255,30 +342,37 @@ bool RGWGC::going_down()
 
 void RGWGC::start_processor()
 {
-  worker = new GCWorker(cct, this);
-  worker->create();
+  int num_workers = cct->_conf->rgw_gc_processor_threads;
+  if (num_workers < 1)
+    num_workers = 1;
+  for (int i = 0; i < num_workers; i++) {
+    GCWorker *worker = new GCWorker(cct, this, i, num_workers);
+    worker->create();
+    workers.push_back(worker);
+  }
 }
 
 void RGWGC::stop_processor()
 {
   down_flag.set(1);
-  if (worker) {
-    worker->stop();
-    worker->join();
+  std::list<GCWorker *>::iterator iter;
+  for (iter = workers.begin(); iter != workers.end(); ++iter) {
+    (*iter)->stop();
+    (*iter)->join();
+    delete *iter;
   }
-  delete worker;
-  worker = NULL;
+  workers.clear();
 }
 
 void *RGWGC::GCWorker::entry() {
   do {
     utime_t start = ceph_clock_now(cct);
-    dout(2) << "garbage collection: start" << dendl;
-    int r = gc->process();
+    dout(2) << "garbage collection: start (worker " << id << ")" << dendl;
+    int r = gc->process_shards(id, num_workers);
     if (r < 0) {
       dout(0) << "ERROR: garbage collection process() returned error r=" << r << dendl;
     }
-    dout(2) << "garbage collection: stop" << dendl;
+    dout(2) << "garbage collection: stop (worker " << id << ")" << dendl;
 
     if (gc->going_down())
       break;
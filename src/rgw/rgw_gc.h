@@ -24,18 +24,21 @@ class RGWGC {
   class GCWorker : public Thread {
     CephContext *cct;
     RGWGC *gc;
+    int id;
+    int num_workers;
     Mutex lock;
     Cond cond;
 
   public:
-    GCWorker(CephContext *_cct, RGWGC *_gc) : cct(_cct), gc(_gc), lock("GCWorker") {}
+    GCWorker(CephContext *_cct, RGWGC *_gc, int _id, int _num_workers)
+      : cct(_cct), gc(_gc), id(_id), num_workers(_num_workers), lock("GCWorker") {}
     void *entry();
     void stop();
   };
 
-  GCWorker *worker;
+  std::list<GCWorker *> workers;
 public:
-  RGWGC() : cct(NULL), store(NULL), max_objs(0), obj_names(NULL), worker(NULL) {}
+  RGWGC() : cct(NULL), store(NULL), max_objs(0), obj_names(NULL) {}
   ~RGWGC() {
     stop_processor();
     finalize();
@@ -52,6 +55,7 @@ public:
   int list(int *index, string& marker, uint32_t max, bool expired_only, std::list<cls_rgw_gc_obj_info>& result, bool *truncated);
   void list_init(int *index) { *index = 0; }
   int process(int index, int process_max_secs);
+  int process_shards(int worker_id, int num_workers);
   int process();
 
   bool going_down();
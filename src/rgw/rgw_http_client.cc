@@ -2,6 +2,11 @@
 #include <curl/easy.h>
 #include <curl/multi.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/RefCountedObj.h"
+
 #include "rgw_common.h"
 #include "rgw_http_client.h"
 
@@ -42,14 +47,66 @@ static size_t send_http_data(void *ptr, size_t size, size_t nmemb, void *_info)
   return ret;
 }
 
-int RGWHTTPClient::process(const char *method, const char *url)
-{
-  int ret = 0;
-  CURL *curl_handle;
-
+/*
+ * per-request state for requests driven by an RGWHTTPManager; refcounted,
+ * one ref is held by the submitting client (for wait()) and one by the
+ * manager thread until the transfer finishes
+ */
+struct rgw_http_req_data : public RefCountedObject {
+  CURL *easy_handle;
+  curl_slist *h;
+  Mutex lock;
+  Cond cond;
+  bool done;
+  int ret;
   char error_buf[CURL_ERROR_SIZE];
 
-  curl_handle = curl_easy_init();
+  rgw_http_req_data() : easy_handle(NULL), h(NULL), lock("rgw_http_req_data"),
+                        done(false), ret(0) {
+    error_buf[0] = '\0';
+  }
+  ~rgw_http_req_data() {
+    if (easy_handle)
+      curl_easy_cleanup(easy_handle);
+
+    if (h)
+      curl_slist_free_all(h);
+  }
+
+  int wait() {
+    Mutex::Locker l(lock);
+    while (!done)
+      cond.Wait(lock);
+    return ret;
+  }
+
+  void finish(int r) {
+    Mutex::Locker l(lock);
+    ret = r;
+    done = true;
+    cond.Signal();
+  }
+
+  bool is_done() {
+    Mutex::Locker l(lock);
+    return done;
+  }
+
+  int get_retcode() {
+    Mutex::Locker l(lock);
+    return ret;
+  }
+};
+
+RGWHTTPClient::~RGWHTTPClient()
+{
+  if (req_data)
+    req_data->put();
+}
+
+void *RGWHTTPClient::init_easy_handle(const char *method, const char *url, curl_slist **ph, char *error_buf)
+{
+  CURL *easy_handle = curl_easy_init();
 
   dout(20) << "sending request to " << url << dendl;
 
@@ -68,24 +125,38 @@ int RGWHTTPClient::process(const char *method, const char *url)
     h = curl_slist_append(h, val.c_str());
   }
 
-  curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, method);
-  curl_easy_setopt(curl_handle, CURLOPT_URL, url);
-  curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L);
-  curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
-  curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, receive_http_header);
-  curl_easy_setopt(curl_handle, CURLOPT_WRITEHEADER, (void *)this);
-  curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, receive_http_data);
-  curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)this);
-  curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, (void *)error_buf);
+  *ph = h;
+
+  curl_easy_setopt(easy_handle, CURLOPT_CUSTOMREQUEST, method);
+  curl_easy_setopt(easy_handle, CURLOPT_URL, url);
+  curl_easy_setopt(easy_handle, CURLOPT_NOPROGRESS, 1L);
+  curl_easy_setopt(easy_handle, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(easy_handle, CURLOPT_HEADERFUNCTION, receive_http_header);
+  curl_easy_setopt(easy_handle, CURLOPT_WRITEHEADER, (void *)this);
+  curl_easy_setopt(easy_handle, CURLOPT_WRITEFUNCTION, receive_http_data);
+  curl_easy_setopt(easy_handle, CURLOPT_WRITEDATA, (void *)this);
+  curl_easy_setopt(easy_handle, CURLOPT_ERRORBUFFER, (void *)error_buf);
   if (h) {
-    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, (void *)h);
+    curl_easy_setopt(easy_handle, CURLOPT_HTTPHEADER, (void *)h);
   }
-  curl_easy_setopt(curl_handle, CURLOPT_READFUNCTION, send_http_data);
-  curl_easy_setopt(curl_handle, CURLOPT_READDATA, (void *)this);
-  curl_easy_setopt(curl_handle, CURLOPT_UPLOAD, 1L); 
+  curl_easy_setopt(easy_handle, CURLOPT_READFUNCTION, send_http_data);
+  curl_easy_setopt(easy_handle, CURLOPT_READDATA, (void *)this);
+  curl_easy_setopt(easy_handle, CURLOPT_UPLOAD, 1L);
   if (has_send_len) {
-    curl_easy_setopt(curl_handle, CURLOPT_INFILESIZE, (void *)send_len); 
+    curl_easy_setopt(easy_handle, CURLOPT_INFILESIZE, (void *)send_len);
   }
+
+  return (void *)easy_handle;
+}
+
+int RGWHTTPClient::process(const char *method, const char *url)
+{
+  int ret = 0;
+
+  char error_buf[CURL_ERROR_SIZE];
+  curl_slist *h = NULL;
+  CURL *curl_handle = (CURL *)init_easy_handle(method, url, &h, error_buf);
+
   CURLcode status = curl_easy_perform(curl_handle);
   if (status) {
     dout(0) << "curl_easy_performed returned error: " << error_buf << dendl;
@@ -97,6 +168,30 @@ int RGWHTTPClient::process(const char *method, const char *url)
   return ret;
 }
 
+int RGWHTTPClient::wait()
+{
+  if (!req_data)
+    return 0;
+
+  return req_data->wait();
+}
+
+bool RGWHTTPClient::is_done()
+{
+  if (!req_data)
+    return true;
+
+  return req_data->is_done();
+}
+
+int RGWHTTPClient::get_req_retcode()
+{
+  if (!req_data)
+    return 0;
+
+  return req_data->get_retcode();
+}
+
 struct multi_req_data {
   CURL *easy_handle;
   CURLM *multi_handle;
@@ -125,7 +220,7 @@ int RGWHTTPClient::init_async(const char *method, const char *url, void **handle
   char error_buf[CURL_ERROR_SIZE];
 
   multi_handle = curl_multi_init();
-  easy_handle = curl_easy_init();
+  easy_handle = (CURL *)init_easy_handle(method, url, &req_data->h, error_buf);
 
   req_data->multi_handle = multi_handle;
   req_data->easy_handle = easy_handle;
@@ -137,53 +232,27 @@ int RGWHTTPClient::init_async(const char *method, const char *url, void **handle
     return -EIO;
   }
 
-  dout(20) << "sending request to " << url << dendl;
-
-  curl_slist *h = NULL;
-
-  list<pair<string, string> >::iterator iter;
-  for (iter = headers.begin(); iter != headers.end(); ++iter) {
-    pair<string, string>& p = *iter;
-    string val = p.first;
-
-    if (strncmp(val.c_str(), "HTTP_", 5) == 0) {
-      val = val.substr(5);
-    }
-    val.append(": ");
-    val.append(p.second);
-    h = curl_slist_append(h, val.c_str());
-  }
-
-  req_data->h = h;
-
-  curl_easy_setopt(easy_handle, CURLOPT_CUSTOMREQUEST, method);
-  curl_easy_setopt(easy_handle, CURLOPT_URL, url);
-  curl_easy_setopt(easy_handle, CURLOPT_NOPROGRESS, 1L);
-  curl_easy_setopt(easy_handle, CURLOPT_NOSIGNAL, 1L);
-  curl_easy_setopt(easy_handle, CURLOPT_HEADERFUNCTION, receive_http_header);
-  curl_easy_setopt(easy_handle, CURLOPT_WRITEHEADER, (void *)this);
-  curl_easy_setopt(easy_handle, CURLOPT_WRITEFUNCTION, receive_http_data);
-  curl_easy_setopt(easy_handle, CURLOPT_WRITEDATA, (void *)this);
-  curl_easy_setopt(easy_handle, CURLOPT_ERRORBUFFER, (void *)error_buf);
-  if (h) {
-    curl_easy_setopt(easy_handle, CURLOPT_HTTPHEADER, (void *)h);
-  }
-  curl_easy_setopt(easy_handle, CURLOPT_READFUNCTION, send_http_data);
-  curl_easy_setopt(easy_handle, CURLOPT_READDATA, (void *)this);
-  curl_easy_setopt(easy_handle, CURLOPT_UPLOAD, 1L); 
-  if (has_send_len) {
-    curl_easy_setopt(easy_handle, CURLOPT_INFILESIZE, (void *)send_len); 
-  }
-
   return 0;
 }
 
 #if HAVE_CURL_MULTI_WAIT
 
-static int do_curl_wait(CephContext *cct, CURLM *handle)
+static int do_curl_wait(CephContext *cct, CURLM *handle, int signal_fd)
 {
   int num_fds;
-  int ret = curl_multi_wait(handle, NULL, 0, cct->_conf->rgw_curl_wait_timeout_ms, &num_fds);
+  struct curl_waitfd wait_fd;
+  struct curl_waitfd *pwait_fd = NULL;
+  int num_wait_fds = 0;
+
+  if (signal_fd >= 0) {
+    wait_fd.fd = signal_fd;
+    wait_fd.events = CURL_WAIT_POLLIN;
+    wait_fd.revents = 0;
+    pwait_fd = &wait_fd;
+    num_wait_fds = 1;
+  }
+
+  int ret = curl_multi_wait(handle, pwait_fd, num_wait_fds, cct->_conf->rgw_curl_wait_timeout_ms, &num_fds);
   if (ret) {
     dout(0) << "ERROR: curl_multi_wait() returned " << ret << dendl;
     return -EIO;
@@ -193,24 +262,31 @@ static int do_curl_wait(CephContext *cct, CURLM *handle)
 
 #else
 
-static int do_curl_wait(CephContext *cct, CURLM *handle)
+static int do_curl_wait(CephContext *cct, CURLM *handle, int signal_fd)
 {
   fd_set fdread;
   fd_set fdwrite;
   fd_set fdexcep;
   int maxfd = -1;
- 
+
   FD_ZERO(&fdread);
   FD_ZERO(&fdwrite);
   FD_ZERO(&fdexcep);
 
-  /* get file descriptors from the transfers */ 
+  /* get file descriptors from the transfers */
   int ret = curl_multi_fdset(handle, &fdread, &fdwrite, &fdexcep, &maxfd);
   if (ret) {
     dout(0) << "ERROR: curl_multi_fdset returned " << ret << dendl;
     return -EIO;
   }
 
+  if (signal_fd >= 0) {
+    FD_SET(signal_fd, &fdread);
+    if (signal_fd >= maxfd) {
+      maxfd = signal_fd + 1;
+    }
+  }
+
   /* forcing a strict timeout, as the returned fdsets might not reference all fds we wait on */
   uint64_t to = cct->_conf->rgw_curl_wait_timeout_ms;
 #define RGW_CURL_TIMEOUT 1000
@@ -240,7 +316,7 @@ int RGWHTTPClient::process_request(void *handle, bool wait_for_data, bool *done)
 
   do {
     if (wait_for_data) {
-      int ret = do_curl_wait(cct, req_data->multi_handle);
+      int ret = do_curl_wait(cct, req_data->multi_handle, -1);
       if (ret < 0) {
         return ret;
       }
@@ -287,3 +363,170 @@ int RGWHTTPClient::complete_request(void *handle)
 
   return ret;
 }
+
+RGWHTTPManager::RGWHTTPManager(CephContext *_cct) : cct(_cct), multi_handle(NULL),
+                                                    reqs_lock("RGWHTTPManager::reqs_lock"),
+                                                    reqs_thread(NULL)
+{
+  multi_handle = (void *)curl_multi_init();
+  thread_pipe[0] = -1;
+  thread_pipe[1] = -1;
+}
+
+RGWHTTPManager::~RGWHTTPManager()
+{
+  stop();
+  if (multi_handle)
+    curl_multi_cleanup((CURLM *)multi_handle);
+}
+
+int RGWHTTPManager::start()
+{
+  if (pipe(thread_pipe) < 0) {
+    int e = errno;
+    ldout(cct, 0) << "ERROR: pipe() returned errno=" << e << dendl;
+    return -e;
+  }
+
+  /* the writing end should never block */
+  fcntl(thread_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(thread_pipe[1], F_SETFL, O_NONBLOCK);
+
+  reqs_thread = new ReqsThread(this);
+  reqs_thread->create();
+  return 0;
+}
+
+void RGWHTTPManager::stop()
+{
+  if (!reqs_thread)
+    return;
+
+  going_down.set(1);
+  signal_thread();
+  reqs_thread->join();
+  delete reqs_thread;
+  reqs_thread = NULL;
+
+  close(thread_pipe[0]);
+  close(thread_pipe[1]);
+  thread_pipe[0] = -1;
+  thread_pipe[1] = -1;
+}
+
+void RGWHTTPManager::signal_thread()
+{
+  char buf[1];
+  buf[0] = 0;
+  int ret = write(thread_pipe[1], buf, sizeof(buf));
+  if (ret < 0 && errno != EAGAIN) {
+    ldout(cct, 0) << "ERROR: " << __func__ << ": write() returned errno=" << errno << dendl;
+  }
+}
+
+int RGWHTTPManager::add_request(RGWHTTPClient *client, const char *method, const char *url)
+{
+  rgw_http_req_data *req_data = new rgw_http_req_data;
+
+  CURL *easy_handle = (CURL *)client->init_easy_handle(method, url, &req_data->h, req_data->error_buf);
+  req_data->easy_handle = easy_handle;
+  curl_easy_setopt(easy_handle, CURLOPT_PRIVATE, (void *)req_data);
+
+  /* one ref for the client to wait on, the other rides with the thread */
+  if (client->req_data)
+    client->req_data->put();
+  req_data->get();
+  client->req_data = req_data;
+
+  {
+    Mutex::Locker l(reqs_lock);
+    pending_reqs.push_back(req_data);
+  }
+  signal_thread();
+
+  return 0;
+}
+
+void *RGWHTTPManager::reqs_thread_entry()
+{
+  CURLM *handle = (CURLM *)multi_handle;
+  std::set<rgw_http_req_data *> in_flight;
+  int still_running = 0;
+
+  while (!going_down.read()) {
+    /* the multi handle is only ever touched from this thread */
+    std::list<rgw_http_req_data *> pending;
+    {
+      Mutex::Locker l(reqs_lock);
+      pending.swap(pending_reqs);
+    }
+
+    std::list<rgw_http_req_data *>::iterator piter;
+    for (piter = pending.begin(); piter != pending.end(); ++piter) {
+      rgw_http_req_data *req_data = *piter;
+      CURLMcode mstatus = curl_multi_add_handle(handle, req_data->easy_handle);
+      if (mstatus) {
+        dout(0) << "ERROR: failed on curl_multi_add_handle, status=" << mstatus << dendl;
+        req_data->finish(-EIO);
+        req_data->put();
+        continue;
+      }
+      in_flight.insert(req_data);
+    }
+
+    int ret = do_curl_wait(cct, handle, thread_pipe[0]);
+    if (ret < 0) {
+      dout(0) << "ERROR: do_curl_wait() returned " << ret << dendl;
+    }
+
+    /* drain wakeup signals */
+    char buf[32];
+    while (read(thread_pipe[0], buf, sizeof(buf)) > 0)
+      ;
+
+    curl_multi_perform(handle, &still_running);
+
+    int msgs_left;
+    CURLMsg *msg;
+    while ((msg = curl_multi_info_read(handle, &msgs_left))) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      CURL *e = msg->easy_handle;
+      char *priv;
+      curl_easy_getinfo(e, CURLINFO_PRIVATE, &priv);
+      rgw_http_req_data *req_data = (rgw_http_req_data *)priv;
+
+      int r = 0;
+      if (msg->data.result != CURLE_OK) {
+        dout(0) << "ERROR: curl request failed, status=" << msg->data.result
+                << " (" << req_data->error_buf << ")" << dendl;
+        r = -EIO;
+      }
+
+      curl_multi_remove_handle(handle, e);
+      in_flight.erase(req_data);
+      req_data->finish(r);
+      req_data->put();
+    }
+  }
+
+  /* going down, cancel whatever is left */
+  std::set<rgw_http_req_data *>::iterator siter;
+  for (siter = in_flight.begin(); siter != in_flight.end(); ++siter) {
+    rgw_http_req_data *req_data = *siter;
+    curl_multi_remove_handle(handle, req_data->easy_handle);
+    req_data->finish(-ECANCELED);
+    req_data->put();
+  }
+
+  Mutex::Locker l(reqs_lock);
+  std::list<rgw_http_req_data *>::iterator piter;
+  for (piter = pending_reqs.begin(); piter != pending_reqs.end(); ++piter) {
+    (*piter)->finish(-ECANCELED);
+    (*piter)->put();
+  }
+  pending_reqs.clear();
+
+  return NULL;
+}
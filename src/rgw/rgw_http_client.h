@@ -1,21 +1,33 @@
 #ifndef CEPH_RGW_HTTP_CLIENT_H
 #define CEPH_RGW_HTTP_CLIENT_H
 
+#include "common/Mutex.h"
+#include "common/Cond.h"
+#include "common/Thread.h"
 #include "rgw_common.h"
 
+struct curl_slist;
+struct rgw_http_req_data;
+
 class RGWHTTPClient
 {
+  friend class RGWHTTPManager;
+
   bufferlist send_bl;
   bufferlist::iterator send_iter;
   size_t send_len;
   bool has_send_len;
+
+  rgw_http_req_data *req_data;
+
+  void *init_easy_handle(const char *method, const char *url, curl_slist **ph, char *error_buf);
 protected:
   CephContext *cct;
 
   list<pair<string, string> > headers;
 public:
-  virtual ~RGWHTTPClient() {}
-  RGWHTTPClient(CephContext *_cct): send_len (0), has_send_len(false), cct(_cct) {}
+  virtual ~RGWHTTPClient();
+  RGWHTTPClient(CephContext *_cct): send_len (0), has_send_len(false), req_data(NULL), cct(_cct) {}
 
   void append_header(const string& name, const string& val) {
     headers.push_back(pair<string, string>(name, val));
@@ -36,6 +48,50 @@ public:
   int init_async(const char *method, const char *url, void **handle);
   int process_request(void *handle, bool wait_for_data, bool *done);
   int complete_request(void *handle);
+
+  /* completion interface for requests submitted through an RGWHTTPManager */
+  int wait();
+  bool is_done();
+  int get_req_retcode();
+};
+
+/*
+ * runs a single curl multi handle on its own thread; all requests added to
+ * one manager share that handle, so curl keeps their connections alive and
+ * reuses them instead of setting up a new one per request
+ */
+class RGWHTTPManager {
+  CephContext *cct;
+  void *multi_handle;
+  atomic_t going_down;
+
+  Mutex reqs_lock;
+  std::list<rgw_http_req_data *> pending_reqs;
+  int thread_pipe[2];
+
+  class ReqsThread : public Thread {
+    RGWHTTPManager *manager;
+
+  public:
+    ReqsThread(RGWHTTPManager *_m) : manager(_m) {}
+    void *entry() {
+      return manager->reqs_thread_entry();
+    }
+  };
+
+  ReqsThread *reqs_thread;
+
+  void *reqs_thread_entry();
+  void signal_thread();
+
+public:
+  RGWHTTPManager(CephContext *_cct);
+  ~RGWHTTPManager();
+
+  int start();
+  void stop();
+
+  int add_request(RGWHTTPClient *client, const char *method, const char *url);
 };
 
 #endif
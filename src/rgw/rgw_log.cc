@@ -88,6 +88,8 @@ class UsageLogger {
   SafeTimer timer;
   utime_t round_timestamp;
 
+  bool flush_scheduled;
+
   class C_UsageLogTimeout : public Context {
     UsageLogger *logger;
   public:
@@ -98,12 +100,21 @@ class UsageLogger {
     }
   };
 
+  class C_UsageLogFlush : public Context {
+    UsageLogger *logger;
+  public:
+    C_UsageLogFlush(UsageLogger *_l) : logger(_l) {}
+    void finish(int r) {
+      logger->flush();
+    }
+  };
+
   void set_timer() {
     timer.add_event_after(cct->_conf->rgw_usage_log_tick_interval, new C_UsageLogTimeout(this));
   }
 public:
 
-  UsageLogger(CephContext *_cct, RGWRados *_store) : cct(_cct), store(_store), lock("UsageLogger"), num_entries(0), timer_lock("UsageLogger::timer_lock"), timer(cct, timer_lock) {
+  UsageLogger(CephContext *_cct, RGWRados *_store) : cct(_cct), store(_store), lock("UsageLogger"), num_entries(0), flush_scheduled(false), timer_lock("UsageLogger::timer_lock"), timer(cct, timer_lock) {
     timer.init();
     Mutex::Locker l(timer_lock);
     set_timer();
@@ -132,11 +143,16 @@ public:
     usage_map[ub].insert(round_timestamp, entry, &account);
     if (account)
       num_entries++;
-    bool need_flush = (num_entries > cct->_conf->rgw_usage_log_flush_threshold);
+    bool need_flush = (num_entries > cct->_conf->rgw_usage_log_flush_threshold) && !flush_scheduled;
+    if (need_flush)
+      flush_scheduled = true;
     lock.Unlock();
     if (need_flush) {
+      /* hand the actual rados writes to the timer thread, the request
+       * thread that happened to cross the threshold shouldn't wait out
+       * a flush of everybody's pending usage */
       Mutex::Locker l(timer_lock);
-      flush();
+      timer.add_event_after(0, new C_UsageLogFlush(this));
     }
   }
 
@@ -145,6 +161,7 @@ public:
     lock.Lock();
     old_map.swap(usage_map);
     num_entries = 0;
+    flush_scheduled = false;
     lock.Unlock();
 
     store->log_usage(old_map);
@@ -164,6 +181,110 @@ void rgw_log_usage_finalize()
   usage_logger = NULL;
 }
 
+/* rados ops logger; request threads only append the encoded entry to an
+ * in-memory batch keyed by log object, a timer thread turns each batch
+ * into a single rados append */
+class OpsLogger {
+  CephContext *cct;
+  RGWRados *store;
+  Mutex lock;
+  map<string, bufferlist> pending;
+  int32_t num_entries;
+  bool flush_scheduled;
+  Mutex timer_lock;
+  SafeTimer timer;
+
+  class C_OpsLogTimeout : public Context {
+    OpsLogger *logger;
+  public:
+    C_OpsLogTimeout(OpsLogger *_l) : logger(_l) {}
+    void finish(int r) {
+      logger->flush();
+      logger->set_timer();
+    }
+  };
+
+  class C_OpsLogFlush : public Context {
+    OpsLogger *logger;
+  public:
+    C_OpsLogFlush(OpsLogger *_l) : logger(_l) {}
+    void finish(int r) {
+      logger->flush();
+    }
+  };
+
+  void set_timer() {
+    timer.add_event_after(cct->_conf->rgw_ops_log_tick_interval, new C_OpsLogTimeout(this));
+  }
+public:
+
+  OpsLogger(CephContext *_cct, RGWRados *_store) : cct(_cct), store(_store), lock("OpsLogger"), num_entries(0), flush_scheduled(false), timer_lock("OpsLogger::timer_lock"), timer(cct, timer_lock) {
+    timer.init();
+    Mutex::Locker l(timer_lock);
+    set_timer();
+  }
+
+  ~OpsLogger() {
+    Mutex::Locker l(timer_lock);
+    flush();
+    timer.cancel_all_events();
+    timer.shutdown();
+  }
+
+  void log(const string& oid, bufferlist& bl) {
+    lock.Lock();
+    pending[oid].claim_append(bl);
+    num_entries++;
+    bool need_flush = (num_entries > cct->_conf->rgw_ops_log_flush_threshold) && !flush_scheduled;
+    if (need_flush)
+      flush_scheduled = true;
+    lock.Unlock();
+    if (need_flush) {
+      Mutex::Locker l(timer_lock);
+      timer.add_event_after(0, new C_OpsLogFlush(this));
+    }
+  }
+
+  void flush() {
+    map<string, bufferlist> old_map;
+    lock.Lock();
+    old_map.swap(pending);
+    num_entries = 0;
+    flush_scheduled = false;
+    lock.Unlock();
+
+    map<string, bufferlist>::iterator iter;
+    for (iter = old_map.begin(); iter != old_map.end(); ++iter) {
+      rgw_obj obj(store->zone.log_pool, iter->first);
+      int ret = store->append_async(obj, iter->second.length(), iter->second);
+      if (ret == -ENOENT) {
+        ret = store->create_pool(store->zone.log_pool);
+        if (ret < 0) {
+          ldout(cct, 0) << "ERROR: failed to create log pool, ret=" << ret << dendl;
+          continue;
+        }
+        // retry
+        ret = store->append_async(obj, iter->second.length(), iter->second);
+      }
+      if (ret < 0)
+        ldout(cct, 0) << "ERROR: failed to log entries to " << iter->first << ", ret=" << ret << dendl;
+    }
+  }
+};
+
+static OpsLogger *ops_logger = NULL;
+
+void rgw_log_ops_init(CephContext *cct, RGWRados *store)
+{
+  ops_logger = new OpsLogger(cct, store);
+}
+
+void rgw_log_ops_finalize()
+{
+  delete ops_logger;
+  ops_logger = NULL;
+}
+
 static void log_usage(struct req_state *s, const string& op_name)
 {
   if (s->system_request) /* don't log system user operations */
@@ -345,15 +466,20 @@ int rgw_log_op(RGWRados *store, struct req_state *s, const string& op_name, OpsL
     string oid = render_log_object_name(s->cct->_conf->rgw_log_object_name, &bdt,
 				        s->bucket.bucket_id, entry.bucket);
 
-    rgw_obj obj(store->zone.log_pool, oid);
+    if (ops_logger) {
+      /* just queue it up, the logger batches appends per log object */
+      ops_logger->log(oid, bl);
+    } else {
+      rgw_obj obj(store->zone.log_pool, oid);
 
-    ret = store->append_async(obj, bl.length(), bl);
-    if (ret == -ENOENT) {
-      ret = store->create_pool(store->zone.log_pool);
-      if (ret < 0)
-        goto done;
-      // retry
       ret = store->append_async(obj, bl.length(), bl);
+      if (ret == -ENOENT) {
+        ret = store->create_pool(store->zone.log_pool);
+        if (ret < 0)
+          goto done;
+        // retry
+        ret = store->append_async(obj, bl.length(), bl);
+      }
     }
   }
 
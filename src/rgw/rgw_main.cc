@@ -25,6 +25,7 @@
 #include "common/config.h"
 #include "common/errno.h"
 #include "common/WorkQueue.h"
+#include "common/FlatPrioritizedQueue.h"
 #include "common/Timer.h"
 #include "common/Throttle.h"
 #include "common/safe_io.h"
@@ -89,6 +90,7 @@ struct RGWRequest
   string req_str;
   RGWOp *op;
   utime_t ts;
+  string sched_class; /* tenant class used for fair queueing */
 
   RGWRequest() : id(0), s(NULL), op(NULL) {
   }
@@ -157,7 +159,9 @@ struct RGWProcessEnv {
 };
 
 class RGWProcess {
-  deque<RGWRequest *> m_req_queue;
+  /* requests are scheduled round robin across tenant classes within a
+   * priority, so one tenant's backlog can't starve everybody else */
+  FlatPrioritizedQueue<RGWRequest *, string> m_req_queue;
 protected:
   RGWRados *store;
   OpsLogSocket *olog;
@@ -166,6 +170,9 @@ protected:
   RGWREST *rest;
   RGWFrontendConfig *conf;
   int sock_fd;
+  atomic_t req_queue_len;
+
+#define RGW_REQUEST_DEFAULT_PRIO 1
 
   struct RGWWQ : public ThreadPool::WorkQueue<RGWRequest> {
     RGWProcess *process;
@@ -173,9 +180,10 @@ protected:
       : ThreadPool::WorkQueue<RGWRequest>("RGWWQ", timeout, suicide_timeout, tp), process(p) {}
 
     bool _enqueue(RGWRequest *req) {
-      process->m_req_queue.push_back(req);
+      process->m_req_queue.enqueue(req->sched_class, RGW_REQUEST_DEFAULT_PRIO, 1, req);
+      process->req_queue_len.inc();
       perfcounter->inc(l_rgw_qlen);
-      dout(20) << "enqueued request req=" << hex << req << dec << dendl;
+      dout(20) << "enqueued request req=" << hex << req << dec << " class=" << req->sched_class << dendl;
       _dump_queue();
       return true;
     }
@@ -188,8 +196,8 @@ protected:
     RGWRequest *_dequeue() {
       if (process->m_req_queue.empty())
 	return NULL;
-      RGWRequest *req = process->m_req_queue.front();
-      process->m_req_queue.pop_front();
+      RGWRequest *req = process->m_req_queue.dequeue();
+      process->req_queue_len.dec();
       dout(20) << "dequeued request req=" << hex << req << dec << dendl;
       _dump_queue();
       perfcounter->inc(l_rgw_qlen, -1);
@@ -202,15 +210,7 @@ protected:
       perfcounter->inc(l_rgw_qactive, -1);
     }
     void _dump_queue() {
-      deque<RGWRequest *>::iterator iter;
-      if (process->m_req_queue.empty()) {
-        dout(20) << "RGWWQ: empty" << dendl;
-        return;
-      }
-      dout(20) << "RGWWQ:" << dendl;
-      for (iter = process->m_req_queue.begin(); iter != process->m_req_queue.end(); ++iter) {
-        dout(20) << "req: " << hex << *iter << dec << dendl;
-      }
+      dout(20) << "RGWWQ: " << process->m_req_queue.length() << " queued" << dendl;
     }
     void _clear() {
       assert(process->m_req_queue.empty());
@@ -219,9 +219,17 @@ protected:
 
   uint64_t max_req_id;
 
+  bool req_queue_full() {
+    int max = g_conf->rgw_qos_max_queue_length;
+    if (max <= 0) /* admission control disabled */
+      return false;
+    return ((int)req_queue_len.read() >= max);
+  }
+
 public:
   RGWProcess(CephContext *cct, RGWProcessEnv *pe, int num_threads, RGWFrontendConfig *_conf)
-    : store(pe->store), olog(pe->olog), m_tp(cct, "RGWProcess::m_tp", num_threads),
+    : m_req_queue(num_threads, 1),
+      store(pe->store), olog(pe->olog), m_tp(cct, "RGWProcess::m_tp", num_threads),
       req_throttle(cct, "rgw_ops", num_threads * 2),
       rest(pe->rest),
       conf(_conf),
@@ -250,6 +258,44 @@ public:
   void handle_request(RGWRequest *req);
 };
 
+/* cheap tenant classification for fair queueing; we can't authenticate
+ * before the request runs, but the s3 access key, or failing that the
+ * leading uri segment (the bucket), identify who's queueing the work */
+static string fcgx_request_class(FCGX_Request *fcgx)
+{
+  const char *auth = FCGX_GetParam("HTTP_AUTHORIZATION", fcgx->envp);
+  if (auth && strncmp(auth, "AWS ", 4) == 0) {
+    const char *p = auth + 4;
+    const char *colon = strchr(p, ':');
+    if (colon)
+      return string(p, colon - p);
+  }
+  const char *uri = FCGX_GetParam("REQUEST_URI", fcgx->envp);
+  if (uri && uri[0] == '/') {
+    const char *p = uri + 1;
+    const char *end = p;
+    while (*end && *end != '/' && *end != '?')
+      end++;
+    if (end > p)
+      return string(p, end - p);
+  }
+  const char *addr = FCGX_GetParam("REMOTE_ADDR", fcgx->envp);
+  if (addr)
+    return string(addr);
+  return string();
+}
+
+/* answer straight from the accept loop without tying up an op thread */
+static void fcgx_reject_overloaded(RGWFCGXRequest *req)
+{
+  int retry_after = g_conf->rgw_qos_retry_after_secs;
+  FCGX_FPrintF(req->fcgx.out,
+               "Status: 503 Slow Down\r\n"
+               "Retry-After: %d\r\n"
+               "Content-Length: 0\r\n\r\n", retry_after);
+  FCGX_Finish_r(&req->fcgx);
+}
+
 void RGWFCGXProcess::run()
 {
   string socket_path;
@@ -311,6 +357,16 @@ void RGWFCGXProcess::run()
       break;
     }
 
+    if (req_queue_full()) {
+      dout(5) << "request queue full, rejecting request with 503" << dendl;
+      fcgx_reject_overloaded(req);
+      delete req;
+      req_throttle.put(1);
+      continue;
+    }
+
+    req->sched_class = fcgx_request_class(&req->fcgx);
+
     req_wq.queue(req);
   }
 
@@ -1023,6 +1079,7 @@ int main(int argc, const char **argv)
   rgw_user_init(store->meta_mgr);
   rgw_bucket_init(store->meta_mgr);
   rgw_log_usage_init(g_ceph_context, store);
+  rgw_log_ops_init(g_ceph_context, store);
 
   RGWREST rest;
 
@@ -1176,6 +1233,7 @@ int main(int argc, const char **argv)
     swift_finalize();
   }
 
+  rgw_log_ops_finalize();
   rgw_log_usage_finalize();
 
   delete olog;
@@ -1633,10 +1633,6 @@ void RGWPutObj::execute()
     void *handle;
     const unsigned char *data_ptr = (const unsigned char *)data.c_str();
 
-    ret = processor->handle_data(data, ofs, &handle);
-    if (ret < 0)
-      goto done;
-
     if (need_calc_md5) {
       hash.Update(data_ptr, len);
     }
@@ -1646,43 +1642,61 @@ void RGWPutObj::execute()
      */
     bool need_to_wait = (ofs == 0) && multipart;
 
-    ret = processor->throttle_data(handle, need_to_wait);
-    if (ret < 0) {
-      if (!need_to_wait || ret != -EEXIST) {
-        ldout(s->cct, 20) << "processor->thottle_data() returned ret=" << ret << dendl;
+    bufferlist orig_data;
+    if (need_to_wait) {
+      /* handle_data() claims the data; keep a reference aside in case
+       * we need to restart the write with a different oid suffix */
+      orig_data = data;
+    }
+
+    bool again;
+    do {
+      ret = processor->handle_data(data, ofs, &handle, &again);
+      if (ret < 0)
         goto done;
-      }
 
-      ldout(s->cct, 5) << "NOTICE: processor->throttle_data() returned -EEXIST, need to restart write" << dendl;
+      ret = processor->throttle_data(handle, need_to_wait);
+      if (ret < 0) {
+        if (!need_to_wait || ret != -EEXIST) {
+          ldout(s->cct, 20) << "processor->thottle_data() returned ret=" << ret << dendl;
+          goto done;
+        }
 
-      /* restart processing with different oid suffix */
+        ldout(s->cct, 5) << "NOTICE: processor->throttle_data() returned -EEXIST, need to restart write" << dendl;
 
-      dispose_processor(processor);
-      processor = select_processor(&multipart);
+        /* restart processing with different oid suffix */
 
-      string oid_rand;
-      char buf[33];
-      gen_rand_alphanumeric(store->ctx(), buf, sizeof(buf) - 1);
-      oid_rand.append(buf);
+        dispose_processor(processor);
+        processor = select_processor(&multipart);
 
-      ret = processor->prepare(store, s->obj_ctx, &oid_rand);
-      if (ret < 0) {
-        ldout(s->cct, 0) << "ERROR: processor->prepare() returned " << ret << dendl;
-        goto done;
-      }
+        string oid_rand;
+        char buf[33];
+        gen_rand_alphanumeric(store->ctx(), buf, sizeof(buf) - 1);
+        oid_rand.append(buf);
 
-      ret = processor->handle_data(data, ofs, &handle);
-      if (ret < 0) {
-        ldout(s->cct, 0) << "ERROR: processor->handle_data() returned " << ret << dendl;
-        goto done;
-      }
+        ret = processor->prepare(store, s->obj_ctx, &oid_rand);
+        if (ret < 0) {
+          ldout(s->cct, 0) << "ERROR: processor->prepare() returned " << ret << dendl;
+          goto done;
+        }
 
-      ret = processor->throttle_data(handle, false);
-      if (ret < 0) {
-        ldout(s->cct, 0) << "ERROR: processor->throttle_data() returned " << ret << dendl;
-        goto done;
+        /* restore the data the disposed processor already consumed */
+        data.swap(orig_data);
+
+        ret = processor->handle_data(data, ofs, &handle, &again);
+        if (ret < 0) {
+          ldout(s->cct, 0) << "ERROR: processor->handle_data() returned " << ret << dendl;
+          goto done;
+        }
+
+        ret = processor->throttle_data(handle, false);
+        if (ret < 0) {
+          ldout(s->cct, 0) << "ERROR: processor->throttle_data() returned " << ret << dendl;
+          goto done;
+        }
       }
-    }
+      need_to_wait = false;
+    } while (again);
 
     ofs += len;
   } while (len > 0);
@@ -1846,15 +1860,18 @@ void RGWPostObj::execute()
      void *handle;
      const unsigned char *data_ptr = (const unsigned char *)data.c_str();
 
-     ret = processor->handle_data(data, ofs, &handle);
-     if (ret < 0)
-       goto done;
-
      hash.Update(data_ptr, len);
 
-     ret = processor->throttle_data(handle, false);
-     if (ret < 0)
-       goto done;
+     bool again;
+     do {
+       ret = processor->handle_data(data, ofs, &handle, &again);
+       if (ret < 0)
+         goto done;
+
+       ret = processor->throttle_data(handle, false);
+       if (ret < 0)
+         goto done;
+     } while (again);
 
      ofs += len;
 
@@ -2830,7 +2847,6 @@ void RGWCompleteMultipart::execute()
   RGWRados::PutObjMetaExtraParams extra_params;
 
   extra_params.manifest = &manifest;
-  extra_params.remove_objs = &remove_objs;
 
   extra_params.ptag = &s->req_id; /* use req_id as operation tag */
   extra_params.owner = s->owner.get_id();
@@ -2841,6 +2857,19 @@ void RGWCompleteMultipart::execute()
   if (ret < 0)
     return;
 
+  /* the part entries are cleaned out of the index separately instead of
+   * riding along in the link op above, so the atomic link step carries no
+   * per-part payload (and each removal hits the index shard that owns
+   * it). The parts' data lives on as the tail of the completed object;
+   * only their listing entries go away, and a leftover entry after a
+   * failure here is repaired by the next listing's disk state check. */
+  if (!remove_objs.empty()) {
+    int r = store->remove_objs_from_index(s->bucket, remove_objs);
+    if (r < 0) {
+      ldout(s->cct, 0) << "WARNING: failed to remove part entries from bucket index, r=" << r << dendl;
+    }
+  }
+
   // remove the upload obj
   meta_obj.set_in_extra_data(true);
   store->delete_obj(s->obj_ctx, s->bucket_owner.get_id(), meta_obj);
@@ -5,6 +5,7 @@
 #include "common/ceph_json.h"
 
 #include "common/errno.h"
+#include "common/strtol.h"
 #include "common/Formatter.h"
 #include "common/Throttle.h"
 
@@ -1042,8 +1043,10 @@ int RGWPutObjProcessor_Plain::prepare(RGWRados *store, void *obj_ctx, string *oi
   return 0;
 }
 
-int RGWPutObjProcessor_Plain::handle_data(bufferlist& bl, off_t _ofs, void **phandle)
+int RGWPutObjProcessor_Plain::handle_data(bufferlist& bl, off_t _ofs, void **phandle, bool *again)
 {
+  *again = false;
+
   if (ofs != _ofs)
     return -EINVAL;
 
@@ -1126,8 +1129,9 @@ int RGWPutObjProcessor_Aio::throttle_data(void *handle, bool need_to_wait)
     pending.push_back(info);
   }
   size_t orig_size = pending.size();
-  while (pending_has_completed()
-         || need_to_wait) {
+  while (!pending.empty()
+         && (pending_has_completed()
+             || need_to_wait)) {
     int r = wait_pending_front();
     if (r < 0)
       return r;
@@ -1160,9 +1164,10 @@ int RGWPutObjProcessor_Atomic::write_data(bufferlist& bl, off_t ofs, void **phan
   return RGWPutObjProcessor_Aio::handle_obj_data(cur_obj, bl, ofs - cur_part_ofs, ofs, phandle, exclusive);
 }
 
-int RGWPutObjProcessor_Atomic::handle_data(bufferlist& bl, off_t ofs, void **phandle)
+int RGWPutObjProcessor_Atomic::handle_data(bufferlist& bl, off_t ofs, void **phandle, bool *again)
 {
   *phandle = NULL;
+  *again = false;
   if (extra_data_len) {
     size_t extra_len = bl.length();
     if (extra_len > extra_data_len)
@@ -1186,6 +1191,10 @@ int RGWPutObjProcessor_Atomic::handle_data(bufferlist& bl, off_t ofs, void **pha
 
   pending_data_bl.splice(0, max_chunk_size, &bl);
 
+  /* do we have another full chunk buffered? if so have the caller come right
+   * back for it instead of waiting for the next client read */
+  *again = (pending_data_bl.length() >= max_chunk_size);
+
   if (!data_ofs && !immutable_head()) {
     first_chunk.claim(bl);
     obj_len = (uint64_t)first_chunk.length();
@@ -2241,10 +2250,17 @@ int RGWRados::list_objects(rgw_bucket& bucket, int max, string& prefix, string&
   prefix_obj.set_obj(prefix);
   string cur_prefix = prefix_obj.object;
 
+  /* push the delimiter down to the index objects so whole common-prefix
+   * ranges are skipped osd-side; when a caller filter has to run first we
+   * can't let the osd fold entries away, so the delimiter stays here */
+  string cls_delim;
+  if (!filter)
+    cls_delim = delim;
+
   do {
     std::map<string, RGWObjEnt> ent_map;
-    int r = cls_bucket_list(bucket, cur_marker, cur_prefix, max - count, ent_map,
-                            &truncated, &cur_marker);
+    int r = cls_bucket_list(bucket, cur_marker, cur_prefix, cls_delim, max - count, ent_map,
+                            &truncated, &cur_marker, &common_prefixes);
     if (r < 0)
       return r;
 
@@ -2323,7 +2339,7 @@ int RGWRados::create_pool(rgw_bucket& bucket)
   return 0;
 }
 
-int RGWRados::init_bucket_index(rgw_bucket& bucket)
+int RGWRados::init_bucket_index(rgw_bucket& bucket, int num_shards)
 {
   librados::IoCtx index_ctx; // context for new bucket
 
@@ -2334,11 +2350,17 @@ int RGWRados::init_bucket_index(rgw_bucket& bucket)
   string dir_oid =  dir_oid_prefix;
   dir_oid.append(bucket.marker);
 
-  librados::ObjectWriteOperation op;
-  op.create(true);
-  r = cls_rgw_init_index(index_ctx, op, dir_oid);
-  if (r < 0 && r != -EEXIST)
-    return r;
+  map<int, string> bucket_objs;
+  get_bucket_index_objects(dir_oid, num_shards, bucket_objs);
+
+  map<int, string>::iterator iter;
+  for (iter = bucket_objs.begin(); iter != bucket_objs.end(); ++iter) {
+    librados::ObjectWriteOperation op;
+    op.create(true);
+    r = cls_rgw_init_index(index_ctx, op, iter->second);
+    if (r < 0 && r != -EEXIST)
+      return r;
+  }
 
   return 0;
 }
@@ -2391,10 +2413,17 @@ int RGWRados::create_bucket(RGWUserInfo& owner, rgw_bucket& bucket,
     string dir_oid =  dir_oid_prefix;
     dir_oid.append(bucket.marker);
 
-    r = init_bucket_index(bucket);
+    uint32_t bucket_index_max_shards = cct->_conf->rgw_bucket_index_max_shards;
+    info.num_shards = bucket_index_max_shards;
+    r = init_bucket_index(bucket, info.num_shards);
     if (r < 0)
       return r;
 
+    {
+      Mutex::Locker l(bucket_index_shards_lock);
+      bucket_index_shards_cache[bucket.bucket_id] = info.num_shards;
+    }
+
     RGWObjVersionTracker& objv_tracker = info.objv_tracker;
 
     if (pobjv) {
@@ -2439,7 +2468,12 @@ int RGWRados::create_bucket(RGWUserInfo& owner, rgw_bucket& bucket,
         if (r < 0)
           return r;
 
-        index_ctx.remove(dir_oid);
+        map<int, string> bucket_objs;
+        get_bucket_index_objects(dir_oid, bucket_index_max_shards, bucket_objs);
+        map<int, string>::iterator biter;
+        for (biter = bucket_objs.begin(); biter != bucket_objs.end(); ++biter) {
+          index_ctx.remove(biter->second);
+        }
       }
       /* ret == -ENOENT here */
     }
@@ -3032,25 +3066,28 @@ public:
   int handle_data(bufferlist& bl, off_t ofs, off_t len) {
     progress_cb(ofs, progress_data);
 
-    void *handle;
-    int ret = processor->handle_data(bl, ofs, &handle);
-    if (ret < 0)
-      return ret;
-
     if (opstate) {
       /* need to update opstate repository with new state. This is ratelimited, so we're not
        * really doing it every time
        */
-      ret = opstate->renew_state();
+      int ret = opstate->renew_state();
       if (ret < 0) {
         /* could not renew state! might have been marked as cancelled */
         return ret;
       }
     }
 
-    ret = processor->throttle_data(handle, false);
-    if (ret < 0)
-      return ret;
+    void *handle;
+    bool again;
+    do {
+      int ret = processor->handle_data(bl, ofs, &handle, &again);
+      if (ret < 0)
+        return ret;
+
+      ret = processor->throttle_data(handle, false);
+      if (ret < 0)
+        return ret;
+    } while (again);
 
     return 0;
   }
@@ -3525,8 +3562,8 @@ done_err:
 int RGWRados::delete_bucket(rgw_bucket& bucket, RGWObjVersionTracker& objv_tracker)
 {
   librados::IoCtx index_ctx;
-  string oid;
-  int r = open_bucket_index(bucket, index_ctx, oid);
+  map<int, string> bucket_objs;
+  int r = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (r < 0)
     return r;
 
@@ -3536,7 +3573,7 @@ int RGWRados::delete_bucket(rgw_bucket& bucket, RGWObjVersionTracker& objv_track
 
   do {
 #define NUM_ENTRIES 1000
-    r = cls_bucket_list(bucket, marker, prefix, NUM_ENTRIES, ent_map,
+    r = cls_bucket_list(bucket, marker, prefix, string(), NUM_ENTRIES, ent_map,
                         &is_truncated, &marker);
     if (r < 0)
       return r;
@@ -3654,7 +3691,8 @@ int RGWRados::complete_atomic_overwrite(RGWRadosCtx *rctx, RGWObjState *state, r
   return ret;
 }
 
-int RGWRados::open_bucket_index(rgw_bucket& bucket, librados::IoCtx& index_ctx, string& bucket_oid)
+int RGWRados::open_bucket_index_base(rgw_bucket& bucket, librados::IoCtx& index_ctx,
+                                     string& bucket_oid_base)
 {
   if (bucket_is_system(bucket))
     return -EINVAL;
@@ -3668,12 +3706,101 @@ int RGWRados::open_bucket_index(rgw_bucket& bucket, librados::IoCtx& index_ctx,
     return -EIO;
   }
 
-  bucket_oid = dir_oid_prefix;
-  bucket_oid.append(bucket.marker);
+  bucket_oid_base = dir_oid_prefix;
+  bucket_oid_base.append(bucket.marker);
 
   return 0;
 }
 
+int RGWRados::open_bucket_index(rgw_bucket& bucket, librados::IoCtx& index_ctx,
+                                map<int, string>& bucket_objs)
+{
+  string bucket_oid_base;
+  int r = open_bucket_index_base(bucket, index_ctx, bucket_oid_base);
+  if (r < 0)
+    return r;
+
+  uint32_t num_shards;
+  r = get_bucket_index_shards(bucket, &num_shards);
+  if (r < 0)
+    return r;
+
+  get_bucket_index_objects(bucket_oid_base, num_shards, bucket_objs);
+  return 0;
+}
+
+int RGWRados::open_bucket_index_shard(rgw_bucket& bucket, librados::IoCtx& index_ctx,
+                                      const string& obj_key, string& bucket_obj)
+{
+  string bucket_oid_base;
+  int r = open_bucket_index_base(bucket, index_ctx, bucket_oid_base);
+  if (r < 0)
+    return r;
+
+  uint32_t num_shards;
+  r = get_bucket_index_shards(bucket, &num_shards);
+  if (r < 0)
+    return r;
+
+  get_bucket_index_object(bucket_oid_base, obj_key, num_shards, bucket_obj);
+  return 0;
+}
+
+int RGWRados::get_bucket_index_shards(rgw_bucket& bucket, uint32_t *num_shards)
+{
+  if (bucket.bucket_id.empty()) {
+    /* buckets that predate instance objects also predate index sharding */
+    *num_shards = 0;
+    return 0;
+  }
+
+  {
+    Mutex::Locker l(bucket_index_shards_lock);
+    map<string, uint32_t>::iterator iter = bucket_index_shards_cache.find(bucket.bucket_id);
+    if (iter != bucket_index_shards_cache.end()) {
+      *num_shards = iter->second;
+      return 0;
+    }
+  }
+
+  RGWBucketInfo info;
+  int r = get_bucket_instance_info(NULL, bucket, info, NULL, NULL);
+  if (r < 0)
+    return r;
+
+  Mutex::Locker l(bucket_index_shards_lock);
+  bucket_index_shards_cache[bucket.bucket_id] = info.num_shards;
+  *num_shards = info.num_shards;
+  return 0;
+}
+
+void RGWRados::get_bucket_index_object(const string& bucket_oid_base, const string& obj_key,
+                                       uint32_t num_shards, string& bucket_obj)
+{
+  if (!num_shards) {
+    bucket_obj = bucket_oid_base;
+    return;
+  }
+  uint32_t shard_id = ceph_str_hash_linux(obj_key.c_str(), obj_key.size()) % num_shards;
+  char buf[16];
+  snprintf(buf, sizeof(buf), ".%u", shard_id);
+  bucket_obj = bucket_oid_base + buf;
+}
+
+void RGWRados::get_bucket_index_objects(const string& bucket_oid_base, uint32_t num_shards,
+                                        map<int, string>& bucket_objs)
+{
+  if (!num_shards) {
+    bucket_objs[0] = bucket_oid_base;
+    return;
+  }
+  for (uint32_t i = 0; i < num_shards; i++) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), ".%u", i);
+    bucket_objs[i] = bucket_oid_base + buf;
+  }
+}
+
 static void translate_raw_stats(rgw_bucket_dir_header& header, map<RGWObjCategory, RGWStorageStats>& stats)
 {
   map<uint8_t, struct rgw_bucket_category_stats>::iterator iter = header.stats.begin();
@@ -3688,23 +3815,49 @@ static void translate_raw_stats(rgw_bucket_dir_header& header, map<RGWObjCategor
   }
 }
 
+static void accumulate_raw_header(rgw_bucket_dir_header& header, rgw_bucket_dir_header& agg)
+{
+  map<uint8_t, struct rgw_bucket_category_stats>::iterator iter = header.stats.begin();
+  for (; iter != header.stats.end(); ++iter) {
+    struct rgw_bucket_category_stats& agg_stats = agg.stats[iter->first];
+    agg_stats.total_size += iter->second.total_size;
+    agg_stats.total_size_rounded += iter->second.total_size_rounded;
+    agg_stats.num_entries += iter->second.num_entries;
+  }
+  agg.ver += header.ver;
+  agg.master_ver += header.master_ver;
+  if (header.tag_timeout > agg.tag_timeout)
+    agg.tag_timeout = header.tag_timeout;
+  if (header.max_marker > agg.max_marker)
+    agg.max_marker = header.max_marker;
+}
+
 int RGWRados::bucket_check_index(rgw_bucket& bucket,
 				 map<RGWObjCategory, RGWStorageStats> *existing_stats,
 				 map<RGWObjCategory, RGWStorageStats> *calculated_stats)
 {
   librados::IoCtx index_ctx;
-  string oid;
+  map<int, string> bucket_objs;
 
-  int ret = open_bucket_index(bucket, index_ctx, oid);
+  int ret = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (ret < 0)
     return ret;
 
   rgw_bucket_dir_header existing_header;
   rgw_bucket_dir_header calculated_header;
 
-  ret = cls_rgw_bucket_check_index_op(index_ctx, oid, &existing_header, &calculated_header);
-  if (ret < 0)
-    return ret;
+  map<int, string>::iterator iter;
+  for (iter = bucket_objs.begin(); iter != bucket_objs.end(); ++iter) {
+    rgw_bucket_dir_header existing_shard;
+    rgw_bucket_dir_header calculated_shard;
+
+    ret = cls_rgw_bucket_check_index_op(index_ctx, iter->second, &existing_shard, &calculated_shard);
+    if (ret < 0)
+      return ret;
+
+    accumulate_raw_header(existing_shard, existing_header);
+    accumulate_raw_header(calculated_shard, calculated_header);
+  }
 
   translate_raw_stats(existing_header, *existing_stats);
   translate_raw_stats(calculated_header, *calculated_stats);
@@ -3715,13 +3868,20 @@ int RGWRados::bucket_check_index(rgw_bucket& bucket,
 int RGWRados::bucket_rebuild_index(rgw_bucket& bucket)
 {
   librados::IoCtx index_ctx;
-  string oid;
+  map<int, string> bucket_objs;
 
-  int ret = open_bucket_index(bucket, index_ctx, oid);
+  int ret = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (ret < 0)
     return ret;
 
-  return cls_rgw_bucket_rebuild_index_op(index_ctx, oid);
+  map<int, string>::iterator iter;
+  for (iter = bucket_objs.begin(); iter != bucket_objs.end(); ++iter) {
+    ret = cls_rgw_bucket_rebuild_index_op(index_ctx, iter->second);
+    if (ret < 0)
+      return ret;
+  }
+
+  return 0;
 }
 
 
@@ -5769,41 +5929,137 @@ int RGWRados::list_raw_objects(rgw_bucket& pool, const string& prefix_filter,
   return oids.size();
 }
 
+/* markers for sharded bucket index logs carry the owning shard in the
+ * form "<shard>#<shard marker>", so that a marker handed back to the
+ * caller can be mapped to the right shard object later on */
+static int parse_bucket_shard_marker(const string& marker, int *shard_id, string *shard_marker)
+{
+  size_t pos = marker.find('#');
+  if (pos == string::npos)
+    return -EINVAL;
+
+  string err;
+  int id = strict_strtol(marker.substr(0, pos).c_str(), 10, &err);
+  if (!err.empty() || id < 0)
+    return -EINVAL;
+
+  *shard_id = id;
+  *shard_marker = marker.substr(pos + 1);
+  return 0;
+}
+
 int RGWRados::list_bi_log_entries(rgw_bucket& bucket, string& marker, uint32_t max,
                                   std::list<rgw_bi_log_entry>& result, bool *truncated)
 {
   result.clear();
 
   librados::IoCtx index_ctx;
-  string oid;
-  int r = open_bucket_index(bucket, index_ctx, oid);
+  map<int, string> bucket_objs;
+  int r = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (r < 0)
     return r;
 
-  std::list<rgw_bi_log_entry> entries;
-  int ret = cls_rgw_bi_log_list(index_ctx, oid, marker, max - result.size(), entries, truncated);
-  if (ret < 0)
-    return ret;
+  if (bucket_objs.size() == 1) {
+    /* unsharded indexes keep their plain markers */
+    std::list<rgw_bi_log_entry> entries;
+    int ret = cls_rgw_bi_log_list(index_ctx, bucket_objs.begin()->second, marker,
+                                  max - result.size(), entries, truncated);
+    if (ret < 0)
+      return ret;
 
-  std::list<rgw_bi_log_entry>::iterator iter;
-  for (iter = entries.begin(); iter != entries.end(); ++iter) {
-    result.push_back(*iter);
+    std::list<rgw_bi_log_entry>::iterator iter;
+    for (iter = entries.begin(); iter != entries.end(); ++iter) {
+      result.push_back(*iter);
+    }
+
+    return 0;
+  }
+
+  /* drain the shards in shard order, starting from the one the marker
+   * points at; entry ids are requalified with the shard prefix so any of
+   * them can be fed back in as a marker */
+  int start_shard = 0;
+  string shard_marker;
+  if (!marker.empty()) {
+    r = parse_bucket_shard_marker(marker, &start_shard, &shard_marker);
+    if (r < 0)
+      return r;
   }
 
+  map<int, string>::iterator oiter = bucket_objs.lower_bound(start_shard);
+  for (; oiter != bucket_objs.end() && result.size() < max; ++oiter) {
+    string m;
+    if (oiter->first == start_shard)
+      m = shard_marker;
+
+    std::list<rgw_bi_log_entry> entries;
+    bool shard_truncated = false;
+    int ret = cls_rgw_bi_log_list(index_ctx, oiter->second, m, max - result.size(),
+                                  entries, &shard_truncated);
+    if (ret < 0)
+      return ret;
+
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d#", oiter->first);
+    std::list<rgw_bi_log_entry>::iterator iter;
+    for (iter = entries.begin(); iter != entries.end(); ++iter) {
+      iter->id = buf + iter->id;
+      result.push_back(*iter);
+    }
+
+    if (shard_truncated)
+      break;
+  }
+
+  *truncated = (oiter != bucket_objs.end());
   return 0;
 }
 
 int RGWRados::trim_bi_log_entries(rgw_bucket& bucket, string& start_marker, string& end_marker)
 {
   librados::IoCtx index_ctx;
-  string oid;
-  int r = open_bucket_index(bucket, index_ctx, oid);
+  map<int, string> bucket_objs;
+  int r = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (r < 0)
     return r;
 
-  int ret = cls_rgw_bi_log_trim(index_ctx, oid, start_marker, end_marker);
-  if (ret < 0)
-    return ret;
+  if (bucket_objs.size() == 1) {
+    return cls_rgw_bi_log_trim(index_ctx, bucket_objs.begin()->second, start_marker, end_marker);
+  }
+
+  /* an empty marker stands for the corresponding end of the log;
+   * intermediate shards are trimmed completely */
+  int start_shard = bucket_objs.begin()->first;
+  string start_m;
+  if (!start_marker.empty()) {
+    r = parse_bucket_shard_marker(start_marker, &start_shard, &start_m);
+    if (r < 0)
+      return r;
+  }
+
+  int end_shard = bucket_objs.rbegin()->first;
+  string end_m;
+  if (!end_marker.empty()) {
+    r = parse_bucket_shard_marker(end_marker, &end_shard, &end_m);
+    if (r < 0)
+      return r;
+  }
+
+  if (end_shard < start_shard)
+    return -EINVAL;
+
+  map<int, string>::iterator oiter = bucket_objs.lower_bound(start_shard);
+  for (; oiter != bucket_objs.end() && oiter->first <= end_shard; ++oiter) {
+    string sm, em;
+    if (oiter->first == start_shard)
+      sm = start_m;
+    if (oiter->first == end_shard)
+      em = end_m;
+
+    int ret = cls_rgw_bi_log_trim(index_ctx, oiter->second, sm, em);
+    if (ret < 0)
+      return ret;
+  }
 
   return 0;
 }
@@ -5850,7 +6106,7 @@ int RGWRados::cls_obj_prepare_op(rgw_bucket& bucket, RGWModifyOp op, string& tag
   librados::IoCtx index_ctx;
   string oid;
 
-  int r = open_bucket_index(bucket, index_ctx, oid);
+  int r = open_bucket_index_shard(bucket, index_ctx, name, oid);
   if (r < 0)
     return r;
 
@@ -5868,7 +6124,7 @@ int RGWRados::cls_obj_complete_op(rgw_bucket& bucket, RGWModifyOp op, string& ta
   librados::IoCtx index_ctx;
   string oid;
 
-  int r = open_bucket_index(bucket, index_ctx, oid);
+  int r = open_bucket_index_shard(bucket, index_ctx, ent.name, oid);
   if (r < 0)
     return r;
 
@@ -5920,44 +6176,100 @@ int RGWRados::cls_obj_complete_cancel(rgw_bucket& bucket, string& tag, string& n
 int RGWRados::cls_obj_set_bucket_tag_timeout(rgw_bucket& bucket, uint64_t timeout)
 {
   librados::IoCtx index_ctx;
-  string oid;
+  map<int, string> bucket_objs;
 
-  int r = open_bucket_index(bucket, index_ctx, oid);
+  int r = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (r < 0)
     return r;
 
-  ObjectWriteOperation o;
-  cls_rgw_bucket_set_tag_timeout(o, timeout);
+  map<int, string>::iterator iter;
+  for (iter = bucket_objs.begin(); iter != bucket_objs.end(); ++iter) {
+    ObjectWriteOperation o;
+    cls_rgw_bucket_set_tag_timeout(o, timeout);
 
-  r = index_ctx.operate(oid, &o);
+    r = index_ctx.operate(iter->second, &o);
+    if (r < 0)
+      return r;
+  }
 
-  return r;
+  return 0;
 }
 
 int RGWRados::cls_bucket_list(rgw_bucket& bucket, string start, string prefix,
-		              uint32_t num, map<string, RGWObjEnt>& m,
+		              const string& delimiter, uint32_t num,
+			      map<string, RGWObjEnt>& m,
 			      bool *is_truncated, string *last_entry,
+			      map<string, bool> *common_prefixes,
 			      bool (*force_check_filter)(const string&  name))
 {
   ldout(cct, 10) << "cls_bucket_list " << bucket << " start " << start << " num " << num << dendl;
 
   librados::IoCtx index_ctx;
-  string oid;
-  int r = open_bucket_index(bucket, index_ctx, oid);
-  if (r < 0)
-    return r;
-
-  struct rgw_bucket_dir dir;
-  r = cls_rgw_list_op(index_ctx, oid, start, prefix, num, &dir, is_truncated);
+  map<int, string> bucket_objs;
+  int r = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (r < 0)
     return r;
 
-  map<string, struct rgw_bucket_dir_entry>::iterator miter;
-  bufferlist updates;
-  for (miter = dir.m.begin(); miter != dir.m.end(); ++miter) {
+  /* list every shard from the same start marker; each shard comes back
+   * individually sorted, so collecting the results in a map restores the
+   * global ordering before the window is trimmed down to num entries */
+  map<string, struct rgw_bucket_dir_entry> merged;
+  map<string, int> entry_shard;
+  set<string> merged_prefixes;
+  bool truncated = false;
+
+  map<int, string>::iterator oiter;
+  for (oiter = bucket_objs.begin(); oiter != bucket_objs.end(); ++oiter) {
+    struct rgw_bucket_dir dir;
+    std::list<string> shard_prefixes;
+    bool shard_truncated = false;
+    r = cls_rgw_list_op(index_ctx, oiter->second, start, prefix, delimiter,
+                        num, &dir, &shard_prefixes, &shard_truncated);
+    if (r < 0)
+      return r;
+    if (shard_truncated)
+      truncated = true;
+
+    map<string, struct rgw_bucket_dir_entry>::iterator diter;
+    for (diter = dir.m.begin(); diter != dir.m.end(); ++diter) {
+      merged[diter->first] = diter->second;
+      entry_shard[diter->first] = oiter->first;
+    }
+    std::list<string>::iterator piter;
+    for (piter = shard_prefixes.begin(); piter != shard_prefixes.end(); ++piter) {
+      merged_prefixes.insert(*piter);
+    }
+  }
+
+  /* anything beyond the first num merged entries may be missing entries
+   * from a shard that filled its window, so it cannot be returned */
+  if (merged.size() + merged_prefixes.size() > num)
+    truncated = true;
+
+  map<int, bufferlist> updates;
+  string last_added;
+  uint32_t count = 0;
+  map<string, struct rgw_bucket_dir_entry>::iterator miter = merged.begin();
+  set<string>::iterator cpiter = merged_prefixes.begin();
+  while (count < num && (miter != merged.end() || cpiter != merged_prefixes.end())) {
+    /* walk entries and folded prefixes in a single key order */
+    if (miter == merged.end() ||
+        (cpiter != merged_prefixes.end() && *cpiter < miter->first)) {
+      if (common_prefixes)
+        (*common_prefixes)[*cpiter] = true;
+      /* resume past the whole prefix range on the next round */
+      last_added = *cpiter;
+      last_added.append(1, (char)0xFF);
+      ++cpiter;
+      ++count;
+      continue;
+    }
     RGWObjEnt e;
     rgw_bucket_dir_entry& dirent = miter->second;
 
+    last_added = miter->first;
+    ++count;
+
     // fill it in with initial values; we may correct later
     e.name = dirent.name;
     e.size = dirent.meta.size;
@@ -5971,6 +6283,7 @@ int RGWRados::cls_bucket_list(rgw_bucket& bucket, string start, string prefix,
     /* oh, that shouldn't happen! */
     if (e.name.empty()) {
       ldout(cct, 0) << "WARNING: got empty dirent name, skipping" << dendl;
+      ++miter;
       continue;
     }
 
@@ -5981,30 +6294,37 @@ int RGWRados::cls_bucket_list(rgw_bucket& bucket, string start, string prefix,
        * and if the tags are old we need to do cleanup as well. */
       librados::IoCtx sub_ctx;
       sub_ctx.dup(index_ctx);
-      r = check_disk_state(sub_ctx, bucket, dirent, e, updates);
+      r = check_disk_state(sub_ctx, bucket, dirent, e, updates[entry_shard[miter->first]]);
       if (r < 0) {
-        if (r == -ENOENT)
+        if (r == -ENOENT) {
+          ++miter;
           continue;
-        else
-          return r;
+        }
+        return r;
       }
     }
     m[e.name] = e;
     ldout(cct, 10) << "RGWRados::cls_bucket_list: got " << e.name << dendl;
+    ++miter;
   }
 
-  if (dir.m.size()) {
-    *last_entry = dir.m.rbegin()->first;
+  if (!last_added.empty()) {
+    *last_entry = last_added;
   }
 
-  if (updates.length()) {
+  map<int, bufferlist>::iterator uiter;
+  for (uiter = updates.begin(); uiter != updates.end(); ++uiter) {
+    if (!uiter->second.length())
+      continue;
     ObjectWriteOperation o;
-    cls_rgw_suggest_changes(o, updates);
+    cls_rgw_suggest_changes(o, uiter->second);
     // we don't care if we lose suggested updates, send them off blindly
     AioCompletion *c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
-    r = index_ctx.aio_operate(oid, c, &o);
+    r = index_ctx.aio_operate(bucket_objs[uiter->first], c, &o);
     c->release();
   }
+
+  *is_truncated = truncated;
   return m.size();
 }
 
@@ -6070,13 +6390,18 @@ int RGWRados::cls_obj_usage_log_trim(string& oid, string& user, uint64_t start_e
 int RGWRados::remove_objs_from_index(rgw_bucket& bucket, list<string>& oid_list)
 {
   librados::IoCtx index_ctx;
-  string dir_oid;
+  string bucket_oid_base;
+
+  int r = open_bucket_index_base(bucket, index_ctx, bucket_oid_base);
+  if (r < 0)
+    return r;
 
-  int r = open_bucket_index(bucket, index_ctx, dir_oid);
+  uint32_t num_shards;
+  r = get_bucket_index_shards(bucket, &num_shards);
   if (r < 0)
     return r;
 
-  bufferlist updates;
+  map<string, bufferlist> updates; /* shard object -> suggested changes */
 
   list<string>::iterator iter;
 
@@ -6086,15 +6411,23 @@ int RGWRados::remove_objs_from_index(rgw_bucket& bucket, list<string>& oid_list)
     rgw_bucket_dir_entry entry;
     entry.ver.epoch = (uint64_t)-1; // ULLONG_MAX, needed to that objclass doesn't skip out request
     entry.name = oid;
-    updates.append(CEPH_RGW_REMOVE);
-    ::encode(entry, updates);
+    string bucket_obj;
+    get_bucket_index_object(bucket_oid_base, oid, num_shards, bucket_obj);
+    bufferlist& update_bl = updates[bucket_obj];
+    update_bl.append(CEPH_RGW_REMOVE);
+    ::encode(entry, update_bl);
   }
 
-  bufferlist out;
+  map<string, bufferlist>::iterator uiter;
+  for (uiter = updates.begin(); uiter != updates.end(); ++uiter) {
+    bufferlist out;
 
-  r = index_ctx.exec(dir_oid, "rgw", "dir_suggest_changes", updates, out);
+    r = index_ctx.exec(uiter->first, "rgw", "dir_suggest_changes", uiter->second, out);
+    if (r < 0)
+      return r;
+  }
 
-  return r;
+  return 0;
 }
 
 int RGWRados::check_disk_state(librados::IoCtx io_ctx,
@@ -6201,30 +6534,74 @@ int RGWRados::check_disk_state(librados::IoCtx io_ctx,
 int RGWRados::cls_bucket_head(rgw_bucket& bucket, struct rgw_bucket_dir_header& header)
 {
   librados::IoCtx index_ctx;
-  string oid;
-  int r = open_bucket_index(bucket, index_ctx, oid);
+  map<int, string> bucket_objs;
+  int r = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (r < 0)
     return r;
 
-  r = cls_rgw_get_dir_header(index_ctx, oid, &header);
-  if (r < 0)
-    return r;
+  map<int, string>::iterator iter;
+  for (iter = bucket_objs.begin(); iter != bucket_objs.end(); ++iter) {
+    rgw_bucket_dir_header shard_header;
+    r = cls_rgw_get_dir_header(index_ctx, iter->second, &shard_header);
+    if (r < 0)
+      return r;
+
+    accumulate_raw_header(shard_header, header);
+  }
 
   return 0;
 }
 
+class RGWGetDirHeaderShardCB : public RGWGetDirHeader_CB {
+  RGWGetDirHeader_CB *cb;
+  Mutex lock;
+  rgw_bucket_dir_header header;
+  int pending;
+  int ret;
+public:
+  RGWGetDirHeaderShardCB(RGWGetDirHeader_CB *_cb, int num_shards)
+    : cb(_cb), lock("RGWGetDirHeaderShardCB"), pending(num_shards), ret(0) {}
+  void handle_response(int r, rgw_bucket_dir_header& shard_header) {
+    Mutex::Locker l(lock);
+    if (r < 0) {
+      if (ret >= 0)
+	ret = r;
+    } else {
+      accumulate_raw_header(shard_header, header);
+    }
+    if (--pending == 0) {
+      cb->handle_response(ret, header);
+      cb->put();
+    }
+  }
+};
+
 int RGWRados::cls_bucket_head_async(rgw_bucket& bucket, RGWGetDirHeader_CB *ctx)
 {
   librados::IoCtx index_ctx;
-  string oid;
-  int r = open_bucket_index(bucket, index_ctx, oid);
+  map<int, string> bucket_objs;
+  int r = open_bucket_index(bucket, index_ctx, bucket_objs);
   if (r < 0)
     return r;
 
-  r = cls_rgw_get_dir_header_async(index_ctx, oid, ctx);
-  if (r < 0)
-    return r;
+  if (bucket_objs.size() == 1) {
+    return cls_rgw_get_dir_header_async(index_ctx, bucket_objs.begin()->second, ctx);
+  }
 
+  /* one response per shard; the aggregator sums them up and fires the
+   * original callback once the last one is in */
+  RGWGetDirHeaderShardCB *shard_cb = new RGWGetDirHeaderShardCB(ctx, bucket_objs.size());
+  map<int, string>::iterator iter;
+  for (iter = bucket_objs.begin(); iter != bucket_objs.end(); ++iter) {
+    shard_cb->get(); /* each issued request puts once when its response lands */
+    r = cls_rgw_get_dir_header_async(index_ctx, iter->second, shard_cb);
+    if (r < 0) {
+      rgw_bucket_dir_header dummy;
+      shard_cb->handle_response(r, dummy);
+      shard_cb->put();
+    }
+  }
+  shard_cb->put(); /* drop the creation ref */
   return 0;
 }
 
@@ -6584,19 +6961,21 @@ int RGWRados::process_intent_log(rgw_bucket& bucket, string& oid,
         break;
       } else {
         librados::IoCtx index_ctx;
-        string oid;
-        int r = open_bucket_index(entry.obj.bucket, index_ctx, oid);
+        map<int, string> bucket_objs;
+        int r = open_bucket_index(entry.obj.bucket, index_ctx, bucket_objs);
         if (r < 0)
           return r;
-        ObjectWriteOperation op;
-        op.remove();
-        oid.append(entry.obj.bucket.marker);
-        librados::AioCompletion *completion = rados->aio_create_completion(NULL, NULL, NULL);
-        r = index_ctx.aio_operate(oid, completion, &op);
-        completion->release();
-        if (r < 0 && r != -ENOENT) {
-          cerr << "failed to remove bucket: " << entry.obj.bucket << std::endl;
-          complete = false;
+        map<int, string>::iterator biter;
+        for (biter = bucket_objs.begin(); biter != bucket_objs.end(); ++biter) {
+          ObjectWriteOperation op;
+          op.remove();
+          librados::AioCompletion *completion = rados->aio_create_completion(NULL, NULL, NULL);
+          r = index_ctx.aio_operate(biter->second, completion, &op);
+          completion->release();
+          if (r < 0 && r != -ENOENT) {
+            cerr << "failed to remove bucket: " << entry.obj.bucket << std::endl;
+            complete = false;
+          }
         }
       }
       break;
@@ -546,7 +546,13 @@ public:
     obj_ctx = _o;
     return 0;
   }
-  virtual int handle_data(bufferlist& bl, off_t ofs, void **phandle) = 0;
+  /* Hands the processor the next piece of incoming data. A non-NULL *phandle
+   * refers to a rados write that was started asynchronously; the caller pushes
+   * it through throttle_data() to bound the number of writes in flight. If
+   * *again is set the processor has at least one more full chunk buffered and
+   * the caller should call back immediately, before reading more client data,
+   * so rados writes overlap the client reads. */
+  virtual int handle_data(bufferlist& bl, off_t ofs, void **phandle, bool *again) = 0;
   virtual int throttle_data(void *handle, bool need_to_wait) = 0;
   virtual int complete(string& etag, time_t *mtime, time_t set_mtime, map<string, bufferlist>& attrs);
 };
@@ -562,7 +568,7 @@ class RGWPutObjProcessor_Plain : public RGWPutObjProcessor
 
 protected:
   int prepare(RGWRados *store, void *obj_ctx, string *oid_rand);
-  int handle_data(bufferlist& bl, off_t ofs, void **phandle);
+  int handle_data(bufferlist& bl, off_t ofs, void **phandle, bool *again);
   int do_complete(string& etag, time_t *mtime, time_t set_mtime, map<string, bufferlist>& attrs);
 
 public:
@@ -647,7 +653,7 @@ public:
   void set_extra_data_len(uint64_t len) {
     extra_data_len = len;
   }
-  virtual int handle_data(bufferlist& bl, off_t ofs, void **phandle);
+  virtual int handle_data(bufferlist& bl, off_t ofs, void **phandle, bool *again);
   bufferlist& get_extra_data() { return extra_data_bl; }
 };
 
@@ -1181,7 +1187,15 @@ class RGWRados
   int open_bucket_index_ctx(rgw_bucket& bucket, librados::IoCtx&  index_ctx);
   int open_bucket_data_ctx(rgw_bucket& bucket, librados::IoCtx&  io_ctx);
   int open_bucket_data_extra_ctx(rgw_bucket& bucket, librados::IoCtx&  io_ctx);
-  int open_bucket_index(rgw_bucket& bucket, librados::IoCtx&  index_ctx, string& bucket_oid);
+  int open_bucket_index_base(rgw_bucket& bucket, librados::IoCtx& index_ctx, string& bucket_oid_base);
+  int open_bucket_index(rgw_bucket& bucket, librados::IoCtx& index_ctx, map<int, string>& bucket_objs);
+  int open_bucket_index_shard(rgw_bucket& bucket, librados::IoCtx& index_ctx,
+                              const string& obj_key, string& bucket_obj);
+  int get_bucket_index_shards(rgw_bucket& bucket, uint32_t *num_shards);
+  static void get_bucket_index_object(const string& bucket_oid_base, const string& obj_key,
+                                      uint32_t num_shards, string& bucket_obj);
+  static void get_bucket_index_objects(const string& bucket_oid_base, uint32_t num_shards,
+                                       map<int, string>& bucket_objs);
 
   struct GetObjState {
     librados::IoCtx io_ctx;
@@ -1215,6 +1229,11 @@ class RGWRados
 
   Mutex bucket_id_lock;
 
+  // reverse mapping from bucket instance to its index shard count; the
+  // shard count is fixed at bucket creation, so entries never go stale
+  Mutex bucket_index_shards_lock;
+  map<string, uint32_t> bucket_index_shards_cache;
+
   int get_obj_ioctx(const rgw_obj& obj, librados::IoCtx *ioctx);
   int get_obj_ref(const rgw_obj& obj, rgw_rados_ref *ref, rgw_bucket *bucket, bool ref_system_obj = false);
   uint64_t max_bucket_id;
@@ -1284,7 +1303,8 @@ public:
                gc(NULL), use_gc_thread(false), quota_threads(false),
                num_watchers(0), watchers(NULL), watch_handles(NULL),
                watch_initialized(false),
-               bucket_id_lock("rados_bucket_id"), max_bucket_id(0),
+               bucket_id_lock("rados_bucket_id"),
+               bucket_index_shards_lock("rados_bucket_index_shards"), max_bucket_id(0),
                max_chunk_size(0),
                cct(NULL), rados(NULL),
                pools_initialized(false),
@@ -1399,7 +1419,7 @@ public:
    * create a bucket with name bucket and the given list of attrs
    * returns 0 on success, -ERR# otherwise.
    */
-  virtual int init_bucket_index(rgw_bucket& bucket);
+  virtual int init_bucket_index(rgw_bucket& bucket, int num_shards);
   int select_bucket_placement(RGWUserInfo& user_info, const string& region_name, const std::string& rule,
                               const std::string& bucket_name, rgw_bucket& bucket, string *pselected_rule);
   int select_legacy_bucket_placement(const string& bucket_name, rgw_bucket& bucket);
@@ -1752,9 +1772,11 @@ public:
   int cls_obj_complete_del(rgw_bucket& bucket, string& tag, int64_t pool, uint64_t epoch, string& name);
   int cls_obj_complete_cancel(rgw_bucket& bucket, string& tag, string& name);
   int cls_obj_set_bucket_tag_timeout(rgw_bucket& bucket, uint64_t timeout);
-  int cls_bucket_list(rgw_bucket& bucket, string start, string prefix, uint32_t num,
+  int cls_bucket_list(rgw_bucket& bucket, string start, string prefix,
+                      const string& delimiter, uint32_t num,
                       map<string, RGWObjEnt>& m, bool *is_truncated,
-                      string *last_entry, bool (*force_check_filter)(const string&  name) = NULL);
+                      string *last_entry, map<string, bool> *common_prefixes = NULL,
+                      bool (*force_check_filter)(const string&  name) = NULL);
   int cls_bucket_head(rgw_bucket& bucket, struct rgw_bucket_dir_header& header);
   int cls_bucket_head_async(rgw_bucket& bucket, RGWGetDirHeader_CB *ctx);
   int prepare_update_index(RGWObjState *state, rgw_bucket& bucket,
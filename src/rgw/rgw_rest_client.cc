@@ -280,9 +280,8 @@ int RGWRESTStreamOutCB::handle_data(bufferlist& bl, off_t bl_ofs, off_t bl_len)
     return req->add_output_data(bl);
   }
 
-  bufferptr bp(bl.c_str() + bl_ofs, bl_len);
   bufferlist new_bl;
-  new_bl.push_back(bp);
+  new_bl.substr_of(bl, bl_ofs, bl_len);
 
   return req->add_output_data(new_bl);
 }
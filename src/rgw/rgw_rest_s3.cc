@@ -170,13 +170,13 @@ done:
   end_header(s, this, content_type);
 
   if (metadata_bl.length()) {
-    s->cio->write(metadata_bl.c_str(), metadata_bl.length());
+    s->cio->write(metadata_bl, 0, metadata_bl.length());
   }
   sent_header = true;
 
 send_data:
   if (get_data && !ret) {
-    int r = s->cio->write(bl.c_str() + bl_ofs, bl_len);
+    int r = s->cio->write(bl, bl_ofs, bl_len);
     if (r < 0)
       return r;
   }
@@ -505,7 +505,17 @@ int RGWSwift::validate_keystone_token(RGWRados *store, const string& token, stru
 
     validate.append_header("X-Auth-Token", admin_token);
 
-    int ret = validate.process(url.c_str());
+    /* go through the shared manager when we have one, so the keystone
+     * connection is kept alive between validations instead of being set
+     * up from scratch every time */
+    int ret;
+    if (keystone_http_manager) {
+      ret = keystone_http_manager->add_request(&validate, "GET", url.c_str());
+      if (ret >= 0)
+        ret = validate.wait();
+    } else {
+      ret = validate.process(url.c_str());
+    }
     if (ret < 0)
       return ret;
   }
@@ -671,6 +681,14 @@ void RGWSwift::init_keystone()
 {
   keystone_token_cache = new RGWKeystoneTokenCache(cct, cct->_conf->rgw_keystone_token_cache_size);
 
+  keystone_http_manager = new RGWHTTPManager(cct);
+  int ret = keystone_http_manager->start();
+  if (ret < 0) {
+    ldout(cct, 0) << "ERROR: failed to start keystone http manager, falling back to blocking requests" << dendl;
+    delete keystone_http_manager;
+    keystone_http_manager = NULL;
+  }
+
   keystone_revoke_thread = new KeystoneRevokeThread(cct, this);
   keystone_revoke_thread->create();
 }
@@ -687,6 +705,12 @@ void RGWSwift::finalize_keystone()
   delete keystone_token_cache;
   keystone_token_cache = NULL;
 
+  if (keystone_http_manager) {
+    keystone_http_manager->stop();
+    delete keystone_http_manager;
+    keystone_http_manager = NULL;
+  }
+
   down_flag.set(1);
   if (keystone_revoke_thread) {
     keystone_revoke_thread->stop();
@@ -6,6 +6,7 @@
 #include "common/Cond.h"
 
 class RGWRados;
+class RGWHTTPManager;
 class KeystoneToken;
 
 struct rgw_swift_auth_info {
@@ -45,6 +46,7 @@ class RGWSwift {
   };
 
   KeystoneRevokeThread *keystone_revoke_thread;
+  RGWHTTPManager *keystone_http_manager;
 
   void init();
   void finalize();
@@ -57,7 +59,8 @@ protected:
   int check_revoked();
 public:
 
-  RGWSwift(CephContext *_cct) : cct(_cct), keystone_revoke_thread(NULL) {
+  RGWSwift(CephContext *_cct) : cct(_cct), keystone_revoke_thread(NULL),
+                                keystone_http_manager(NULL) {
     init();
   }
   ~RGWSwift() {
@@ -0,0 +1,83 @@
+#!/usr/bin/env python
+#
+# Stitch per-daemon op traces into causal timelines.
+#
+# Collect 'ceph daemon osd.N dump_traced_ops' output from each osd into
+# a file per daemon, then run
+#
+#   stitch_op_traces.py osd.0.json osd.1.json ...
+#
+# Ops are correlated by the request id (client.X.Y:Z) embedded in the op
+# description, so the primary's osd_op span and each replica's
+# osd_sub_op span for the same client request merge into one timeline.
+
+import json
+import re
+import sys
+
+reqid_re = re.compile(r'^osd_(?:sub_)?op\((\S+)\s')
+
+
+def parse_stamp(s):
+    # YYYY-MM-DD HH:MM:SS.ssssss -> sortable as-is
+    return s
+
+
+def load_dump(path):
+    f = open(path)
+    try:
+        dump = json.load(f)
+    finally:
+        f.close()
+    daemon = path
+    if daemon.endswith('.json'):
+        daemon = daemon[:-len('.json')]
+    daemon = daemon.split('/')[-1]
+    spans = []
+    for op in dump.get('Ops', []):
+        m = reqid_re.match(op.get('description', ''))
+        if not m:
+            continue
+        events = []
+        for section in op.get('type_data', []):
+            for ev in section.get('events', []):
+                events.append((parse_stamp(ev['time']), ev['event']))
+        spans.append({
+            'reqid': m.group(1),
+            'daemon': daemon,
+            'description': op['description'],
+            'initiated_at': op['initiated_at'],
+            'duration': op['duration'],
+            'events': events,
+            })
+    return spans
+
+
+def main():
+    args = sys.argv[1:]
+    if not args:
+        print >>sys.stderr, 'usage: %s <dump_traced_ops json> ...' % sys.argv[0]
+        return 1
+
+    by_reqid = {}
+    for path in args:
+        for span in load_dump(path):
+            by_reqid.setdefault(span['reqid'], []).append(span)
+
+    for reqid in sorted(by_reqid, key=lambda r: min(s['initiated_at'] for s in by_reqid[r])):
+        spans = by_reqid[reqid]
+        total = max(s['duration'] for s in spans)
+        print '%s (%d spans, %0.6fs)' % (reqid, len(spans), total)
+        timeline = []
+        for span in spans:
+            for stamp, event in span['events']:
+                timeline.append((stamp, span['daemon'], event))
+        timeline.sort()
+        for stamp, daemon, event in timeline:
+            print '  %s %-12s %s' % (stamp, daemon, event)
+        print
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -674,6 +674,41 @@ TEST_F(ObjectMapTest, CloneOneObject) {
   db->clear(hoid2);
 }
 
+TEST_F(ObjectMapTest, FlattenOnWrite) {
+  ghobject_t hoid(hobject_t(sobject_t("foo", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("foo2", CEPH_NOSNAP)));
+
+  tester.set_key(hoid, "foo", "bar");
+  tester.set_key(hoid, "foo2", "bar2");
+  tester.set_header(hoid, "header");
+  db->clone(hoid, hoid2);
+
+  g_ceph_context->_conf->set_val("filestore_omap_flatten_on_write", "true");
+
+  // this write collapses hoid2's parent chain
+  tester.set_key(hoid2, "foo3", "bar3");
+
+  string result;
+  ASSERT_EQ(1, tester.get_key(hoid2, "foo", &result));
+  ASSERT_EQ("bar", result);
+  ASSERT_EQ(1, tester.get_key(hoid2, "foo2", &result));
+  ASSERT_EQ("bar2", result);
+  ASSERT_EQ(1, tester.get_key(hoid2, "foo3", &result));
+  ASSERT_EQ("bar3", result);
+  ASSERT_EQ(0, tester.get_header(hoid2, &result));
+  ASSERT_EQ("header", result);
+
+  // the flattened clone no longer shares state with the source
+  tester.remove_key(hoid2, "foo");
+  ASSERT_EQ(0, tester.get_key(hoid2, "foo", &result));
+  ASSERT_EQ(1, tester.get_key(hoid, "foo", &result));
+  ASSERT_EQ("bar", result);
+
+  g_ceph_context->_conf->set_val("filestore_omap_flatten_on_write", "false");
+  db->clear(hoid);
+  db->clear(hoid2);
+}
+
 TEST_F(ObjectMapTest, OddEvenClone) {
   ghobject_t hoid(hobject_t(sobject_t("foo", CEPH_NOSNAP)));
   ghobject_t hoid2(hobject_t(sobject_t("foo2", CEPH_NOSNAP)));
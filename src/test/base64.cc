@@ -13,6 +13,7 @@
  */
 
 #include "common/armor.h"
+#include "common/Clock.h"
 #include "common/config.h"
 #include "include/buffer.h"
 #include "include/encoding.h"
@@ -98,3 +99,67 @@ TEST(FuzzEncoding, BadDecode2) {
   }
   ASSERT_EQ(failed, true);
 }
+
+TEST(FastPath, MatchesScalar) {
+  // line-broken encoding never takes the vectorized path; stripping the
+  // newlines from it yields the scalar encoding of the same input
+  static const int IN_MAX = 1024;
+  static const int OUT_MAX = 4096;
+  static const int ITERS = 200;
+  for (int i = 0; i < ITERS; ++i) {
+    unsigned int seed = i;
+    int in_len = rand_r(&seed) % IN_MAX;
+
+    char in[IN_MAX];
+    for (int j = 0; j < in_len; ++j)
+      in[j] = rand_r(&seed) % 0xff;
+
+    char out[OUT_MAX];
+    int alen = ceph_armor(out, out + OUT_MAX, in, in + in_len);
+    ASSERT_GE(alen, 0);
+
+    char lined[OUT_MAX];
+    int llen = ceph_armor_line_break(lined, lined + OUT_MAX, in, in + in_len, 64);
+    ASSERT_GE(llen, alen);
+
+    char stripped[OUT_MAX];
+    int slen = 0;
+    for (int j = 0; j < llen; ++j)
+      if (lined[j] != '\n')
+	stripped[slen++] = lined[j];
+    ASSERT_EQ(alen, slen);
+    ASSERT_EQ(0, memcmp(out, stripped, alen));
+  }
+}
+
+TEST(Benchmark, EncodeDecode) {
+  static const int IN_LEN = 65536;
+  static const int ITERS = 2000;
+  char *in = (char *)malloc(IN_LEN);
+  char *out = (char *)malloc(2 * IN_LEN);
+  char *decoded = (char *)malloc(IN_LEN);
+  unsigned int seed = 42;
+  for (int j = 0; j < IN_LEN; ++j)
+    in[j] = rand_r(&seed) % 0xff;
+
+  utime_t start = ceph_clock_now(NULL);
+  int alen = 0;
+  for (int i = 0; i < ITERS; ++i)
+    alen = ceph_armor(out, out + 2 * IN_LEN, in, in + IN_LEN);
+  utime_t enc = ceph_clock_now(NULL) - start;
+
+  start = ceph_clock_now(NULL);
+  for (int i = 0; i < ITERS; ++i) {
+    int blen = ceph_unarmor(decoded, decoded + IN_LEN, out, out + alen);
+    ASSERT_EQ(IN_LEN, blen);
+  }
+  utime_t dec = ceph_clock_now(NULL) - start;
+
+  double mb = (double)IN_LEN * ITERS / (1024.0 * 1024.0);
+  std::cout << "armor:   " << mb / (double)enc << " MB/s" << std::endl;
+  std::cout << "unarmor: " << mb / (double)dec << " MB/s" << std::endl;
+
+  free(in);
+  free(out);
+  free(decoded);
+}
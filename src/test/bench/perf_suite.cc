@@ -0,0 +1,308 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2014 Inktank <info@inktank.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Micro benchmark suite for the hot primitives: bufferlist append,
+ * crc32c, osd_types encode/decode, PrioritizedQueue, CRUSH mapping and
+ * erasure code encode.  Every benchmark emits one entry in a stable
+ * JSON document so results from different builds can be diffed by a
+ * regression harness:
+ *
+ *   make benchmarks && ./ceph_perf_suite > results.json
+ */
+
+#include <boost/program_options/option.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/parsers.hpp>
+
+#include "global/global_init.h"
+#include "global/global_context.h"
+#include "common/ceph_argparse.h"
+#include "common/config.h"
+#include "common/Clock.h"
+#include "common/Formatter.h"
+#include "common/PrioritizedQueue.h"
+#include "include/crc32c.h"
+#include "include/utime.h"
+#include "include/buffer.h"
+#include "osd/osd_types.h"
+#include "crush/CrushWrapper.h"
+#include "erasure-code/ErasureCodePlugin.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace po = boost::program_options;
+
+// each benchmark runs a fixed number of iterations and reports how
+// many bytes it pushed through (0 if a byte rate is meaningless)
+typedef uint64_t (*bench_fn)(uint64_t iterations);
+
+static uint64_t bench_bufferlist_append(uint64_t iterations)
+{
+  char chunk[64];
+  memset(chunk, 'x', sizeof(chunk));
+  bufferlist bl;
+  for (uint64_t i = 0; i < iterations; ++i) {
+    bl.append(chunk, sizeof(chunk));
+    if (bl.length() >= 4 * 1024 * 1024)
+      bl.clear();
+  }
+  return iterations * sizeof(chunk);
+}
+
+static uint64_t bench_crc32c(uint64_t iterations)
+{
+  const unsigned len = 4 * 1024 * 1024;
+  bufferptr bp(len);
+  memset(bp.c_str(), 'y', len);
+  uint32_t crc = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+    crc = ceph_crc32c(crc, (unsigned char *)bp.c_str(), len);
+  // keep the result alive so the loop cannot be optimized out
+  if (crc == 0xdeadbeef)
+    cerr << "" << std::endl;
+  return iterations * (uint64_t)len;
+}
+
+static void fill_pg_stat(pg_stat_t *st)
+{
+  st->stats.sum.num_bytes = 123456789;
+  st->stats.sum.num_objects = 1000;
+  st->stats.sum.num_object_copies = 3000;
+  st->stats.sum.num_rd = 100;
+  st->stats.sum.num_wr = 200;
+  for (int i = 0; i < 3; ++i) {
+    st->up.push_back(i);
+    st->acting.push_back(i);
+  }
+}
+
+static uint64_t bench_pg_stat_encode(uint64_t iterations)
+{
+  pg_stat_t st;
+  fill_pg_stat(&st);
+  uint64_t bytes = 0;
+  for (uint64_t i = 0; i < iterations; ++i) {
+    bufferlist bl;
+    ::encode(st, bl);
+    bytes += bl.length();
+  }
+  return bytes;
+}
+
+static uint64_t bench_pg_stat_decode(uint64_t iterations)
+{
+  pg_stat_t st;
+  fill_pg_stat(&st);
+  bufferlist bl;
+  ::encode(st, bl);
+  for (uint64_t i = 0; i < iterations; ++i) {
+    pg_stat_t out;
+    bufferlist::iterator p = bl.begin();
+    ::decode(out, p);
+  }
+  return iterations * (uint64_t)bl.length();
+}
+
+static uint64_t bench_prioritized_queue(uint64_t iterations)
+{
+  PrioritizedQueue<uint64_t, uint64_t> pq(1000, 100);
+  const unsigned batch = 1024;
+  uint64_t done = 0;
+  while (done < iterations) {
+    for (unsigned i = 0; i < batch; ++i)
+      pq.enqueue(i % 4, 1 + (i % 3), 100, done + i);
+    while (!pq.empty())
+      pq.dequeue();
+    done += batch;
+  }
+  return 0;
+}
+
+static uint64_t bench_crush_mapping(uint64_t iterations)
+{
+  const int num_osds = 64;
+  CrushWrapper crush;
+  crush.create();
+  crush.set_type_name(0, "osd");
+  crush.set_type_name(1, "root");
+
+  int items[num_osds], weights[num_osds];
+  for (int i = 0; i < num_osds; ++i) {
+    items[i] = i;
+    weights[i] = 0x10000;
+  }
+  int rootno;
+  crush.add_bucket(0, CRUSH_BUCKET_STRAW, CRUSH_HASH_RJENKINS1,
+		   1, num_osds, items, weights, &rootno);
+  crush.set_item_name(rootno, "default");
+  int ruleno = crush.add_simple_ruleset("data", "default", "osd", "firstn",
+					pg_pool_t::TYPE_REPLICATED);
+  crush.finalize();
+
+  vector<__u32> weight(num_osds, 0x10000);
+  for (uint64_t i = 0; i < iterations; ++i) {
+    vector<int> out;
+    crush.do_rule(ruleno, i, out, 3, weight);
+  }
+  return 0;
+}
+
+static ErasureCodeInterfaceRef ec_impl;
+
+static uint64_t bench_ec_encode(uint64_t iterations)
+{
+  const unsigned in_size = 1024 * 1024;
+  bufferlist in;
+  in.append(string(in_size, 'X'));
+  set<int> want_to_encode;
+  for (int i = 0; i < 6; ++i)  // k=4 m=2
+    want_to_encode.insert(i);
+  for (uint64_t i = 0; i < iterations; ++i) {
+    map<int, bufferlist> encoded;
+    if (ec_impl->encode(want_to_encode, in, &encoded))
+      return 0;
+  }
+  return iterations * (uint64_t)in_size;
+}
+
+struct suite_benchmark {
+  const char *name;
+  bench_fn fn;
+  uint64_t iterations;
+};
+
+static const suite_benchmark benchmarks[] = {
+  { "bufferlist_append_64b", bench_bufferlist_append, 10000000 },
+  { "crc32c_4mb", bench_crc32c, 1000 },
+  { "pg_stat_encode", bench_pg_stat_encode, 100000 },
+  { "pg_stat_decode", bench_pg_stat_decode, 100000 },
+  { "prioritized_queue_enqueue_dequeue", bench_prioritized_queue, 1000000 },
+  { "crush_map_firstn_3", bench_crush_mapping, 1000000 },
+  { "ec_encode_jerasure_k4_m2", bench_ec_encode, 100 },
+};
+
+static void run_benchmark(const suite_benchmark &b, uint64_t iterations,
+			  ceph::Formatter *f)
+{
+  utime_t start = ceph_clock_now(g_ceph_context);
+  uint64_t bytes = b.fn(iterations);
+  utime_t end = ceph_clock_now(g_ceph_context);
+  double seconds = (double)(end - start);
+
+  f->open_object_section("benchmark");
+  f->dump_string("name", b.name);
+  f->dump_unsigned("iterations", iterations);
+  f->dump_float("total_seconds", seconds);
+  f->dump_float("rate_per_sec", seconds > 0 ? iterations / seconds : 0);
+  f->dump_float("mb_per_sec",
+		seconds > 0 ? bytes / seconds / (1024 * 1024) : 0);
+  f->close_section();
+}
+
+int main(int argc, char **argv)
+{
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help,h", "produce help message")
+    ("benchmark,b", po::value<string>()->default_value(""),
+     "only run benchmarks whose name contains this substring")
+    ("iterations,i", po::value<uint64_t>()->default_value(0),
+     "override the per-benchmark iteration counts")
+    ("scale", po::value<double>()->default_value(1.0),
+     "multiply the default iteration counts (e.g. 0.1 for a quick run)")
+    ("format", po::value<string>()->default_value("json"),
+     "output format (json or xml)")
+    ("erasure-code-dir", po::value<string>()->default_value(".libs"),
+     "directory to load the erasure code plugin from")
+    ;
+
+  po::variables_map vm;
+  po::parsed_options parsed =
+    po::command_line_parser(argc, argv).options(desc).allow_unregistered().run();
+  po::store(parsed, vm);
+  po::notify(vm);
+
+  vector<const char *> ceph_options, def_args;
+  vector<string> ceph_option_strings = po::collect_unrecognized(
+    parsed.options, po::include_positional);
+  ceph_options.reserve(ceph_option_strings.size());
+  for (vector<string>::iterator i = ceph_option_strings.begin();
+       i != ceph_option_strings.end();
+       ++i) {
+    ceph_options.push_back(i->c_str());
+  }
+
+  global_init(&def_args, ceph_options, CEPH_ENTITY_TYPE_CLIENT,
+	      CODE_ENVIRONMENT_UTILITY,
+	      CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  if (vm.count("help")) {
+    cout << desc << std::endl;
+    return 1;
+  }
+
+  string filter = vm["benchmark"].as<string>();
+  uint64_t iteration_override = vm["iterations"].as<uint64_t>();
+  double scale = vm["scale"].as<double>();
+
+  // the erasure code benchmark needs a built plugin; skip it (but keep
+  // the rest of the suite usable) if the plugin cannot be loaded
+  map<string, string> ec_parameters;
+  ec_parameters["k"] = "4";
+  ec_parameters["m"] = "2";
+  ec_parameters["technique"] = "reed_sol_van";
+  ec_parameters["directory"] = vm["erasure-code-dir"].as<string>();
+  ErasureCodePluginRegistry &ec_registry = ErasureCodePluginRegistry::instance();
+  ec_registry.disable_dlclose = true;
+  bool have_ec = ec_registry.factory("jerasure", ec_parameters,
+				     &ec_impl, cerr) == 0;
+
+  ceph::Formatter *f = new_formatter(vm["format"].as<string>());
+  if (!f) {
+    cerr << "unrecognized format: " << vm["format"].as<string>() << std::endl;
+    return 1;
+  }
+
+  f->open_object_section("perf_suite");
+  f->open_array_section("benchmarks");
+  for (unsigned i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i) {
+    const suite_benchmark &b = benchmarks[i];
+    if (!filter.empty() && string(b.name).find(filter) == string::npos)
+      continue;
+    if (b.fn == bench_ec_encode && !have_ec) {
+      cerr << "skipping " << b.name
+	   << ": erasure code plugin not available" << std::endl;
+      continue;
+    }
+    uint64_t iterations = iteration_override ? iteration_override :
+      (uint64_t)(b.iterations * scale);
+    if (iterations == 0)
+      iterations = 1;
+    run_benchmark(b, iterations, f);
+  }
+  f->close_section();
+  f->close_section();
+  f->flush(cout);
+  cout << std::endl;
+  delete f;
+
+  return 0;
+}
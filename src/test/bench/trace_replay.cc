@@ -0,0 +1,267 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2014 Inktank <info@inktank.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Replay an op trace captured by the OSD (osd_op_capture_file) against
+ * a test pool, either with the original timing, accelerated, or as
+ * fast as the pool allows.  This lets us benchmark with the traffic
+ * shape of a production incident instead of synthetic distributions.
+ */
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/program_options/option.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <iostream>
+#include <fstream>
+#include <set>
+#include <vector>
+
+#include "common/Formatter.h"
+#include "common/Clock.h"
+#include "include/rados/librados.hpp"
+#include "include/rados.h"
+#include "osd/OpCapture.h"
+
+#include "bencher.h"
+#include "rados_backend.h"
+#include "detailed_stat_collector.h"
+#include "distribution.h"
+
+namespace po = boost::program_options;
+using namespace std;
+
+/**
+ * feed a captured trace to Bencher, sleeping until each op's scheduled
+ * issue time so the replay keeps the original (or scaled) arrival
+ * pattern; a speedup of 0 disables pacing entirely.  Wraps around if
+ * asked for more ops than the trace contains.
+ */
+class TraceDist :
+  public Distribution<boost::tuple<string, uint64_t, uint64_t, Bencher::OpType> > {
+  const vector<captured_op_t> &records;
+  const string prefix;
+  const double speedup;
+  size_t pos;
+  double loop_offset;
+  utime_t trace_start;
+  utime_t replay_start;
+public:
+  TraceDist(const vector<captured_op_t> &records,
+	    const string &prefix,
+	    double speedup)
+    : records(records), prefix(prefix), speedup(speedup),
+      pos(0), loop_offset(0) {
+    assert(!records.empty());
+    trace_start = records.front().stamp;
+    replay_start = ceph_clock_now(g_ceph_context);
+  }
+
+  boost::tuple<string, uint64_t, uint64_t, Bencher::OpType> operator()() {
+    if (pos == records.size()) {
+      loop_offset += records.back().stamp - trace_start;
+      pos = 0;
+    }
+    const captured_op_t &rec = records[pos++];
+
+    if (speedup > 0) {
+      double offset = ((double)(rec.stamp - trace_start) + loop_offset) /
+	speedup;
+      utime_t target = replay_start;
+      target += offset;
+      utime_t now = ceph_clock_now(g_ceph_context);
+      if (now < target)
+	usleep((useconds_t)((double)(target - now) * 1000000.0));
+    }
+
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    for (vector<captured_subop_t>::const_iterator p = rec.ops.begin();
+	 p != rec.ops.end();
+	 ++p) {
+      if (p->length > length) {
+	offset = p->offset;
+	length = p->length;
+      }
+    }
+    if (length == 0)
+      length = 4096;  // delete/stat class ops -- replay as a small io
+
+    Bencher::OpType type =
+      (rec.flags & CEPH_OSD_FLAG_WRITE) ? Bencher::WRITE : Bencher::READ;
+    return boost::make_tuple(prefix + rec.oid, offset, length, type);
+  }
+};
+
+static int load_trace(const string &file, vector<captured_op_t> *records)
+{
+  bufferlist bl;
+  string error;
+  int r = bl.read_file(file.c_str(), &error);
+  if (r < 0) {
+    cerr << "error reading " << file << ": " << error << std::endl;
+    return r;
+  }
+
+  bufferlist::iterator p = bl.begin();
+  try {
+    __u32 magic, version;
+    ::decode(magic, p);
+    ::decode(version, p);
+    if (magic != OP_CAPTURE_MAGIC) {
+      cerr << file << " is not an op capture trace" << std::endl;
+      return -EINVAL;
+    }
+    if (version != OP_CAPTURE_VERSION) {
+      cerr << file << " has unsupported trace version " << version << std::endl;
+      return -EINVAL;
+    }
+    while (!p.end()) {
+      captured_op_t rec;
+      ::decode(rec, p);
+      records->push_back(rec);
+    }
+  } catch (buffer::error &e) {
+    // a trace from a crashed OSD may end mid-record; use what we got
+    cerr << "warning: trace ends mid-record, keeping "
+	 << records->size() << " ops" << std::endl;
+  }
+
+  if (records->empty()) {
+    cerr << "trace " << file << " contains no ops" << std::endl;
+    return -EINVAL;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help", "produce help message")
+    ("trace-file", po::value<string>(),
+     "op trace captured with osd_op_capture_file (required)")
+    ("pool-name", po::value<string>()->default_value("data"),
+     "set pool")
+    ("ceph-client-id", po::value<string>()->default_value("admin"),
+     "set ceph client id")
+    ("speedup", po::value<double>()->default_value(1.0),
+     "replay speed multiplier; 1 keeps original timing, 0 replays unpaced")
+    ("num-concurrent-ops", po::value<unsigned>()->default_value(128),
+     "cap on concurrent ops")
+    ("max-ops", po::value<unsigned>()->default_value(0),
+     "number of ops to replay, 0 for one pass over the trace")
+    ("duration", po::value<unsigned>()->default_value(0),
+     "set max duration, 0 for unlimited")
+    ("object-prefix", po::value<string>()->default_value(""),
+     "prepend to captured object names to keep replays apart")
+    ("object-size", po::value<unsigned>()->default_value(4<<20),
+     "size to create replay objects with")
+    ("do-not-init", po::value<bool>()->default_value(false),
+     "assume replay objects already exist")
+    ("op-dump-file", po::value<string>()->default_value(""),
+     "set file for dumping op details, omit for stderr")
+    ("disable-detailed-ops", po::value<bool>()->default_value(false),
+     "don't dump per op stats")
+    ;
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  if (vm.count("help") || !vm.count("trace-file")) {
+    cout << desc << std::endl;
+    return 1;
+  }
+
+  vector<captured_op_t> records;
+  int r = load_trace(vm["trace-file"].as<string>(), &records);
+  if (r < 0)
+    return -r;
+  cout << "loaded " << records.size() << " ops from "
+       << vm["trace-file"].as<string>() << std::endl;
+
+  string prefix = vm["object-prefix"].as<string>();
+  set<string> objects;
+  for (vector<captured_op_t>::iterator i = records.begin();
+       i != records.end();
+       ++i)
+    objects.insert(prefix + i->oid);
+
+  librados::Rados rados;
+  librados::IoCtx ioctx;
+  r = rados.init(vm["ceph-client-id"].as<string>().c_str());
+  if (r < 0) {
+    cerr << "error in init r=" << r << std::endl;
+    return -r;
+  }
+  r = rados.conf_read_file(NULL);
+  if (r < 0) {
+    cerr << "error in conf_read_file r=" << r << std::endl;
+    return -r;
+  }
+  r = rados.conf_parse_env(NULL);
+  if (r < 0) {
+    cerr << "error in conf_parse_env r=" << r << std::endl;
+    return -r;
+  }
+  r = rados.connect();
+  if (r < 0) {
+    cerr << "error in connect r=" << r << std::endl;
+    return -r;
+  }
+  r = rados.ioctx_create(vm["pool-name"].as<string>().c_str(), ioctx);
+  if (r < 0) {
+    cerr << "error in ioctx_create r=" << r << std::endl;
+    return -r;
+  }
+
+  ostream *detailed_ops = 0;
+  ofstream myfile;
+  if (vm["disable-detailed-ops"].as<bool>()) {
+    detailed_ops = 0;
+  } else if (vm["op-dump-file"].as<string>().size()) {
+    myfile.open(vm["op-dump-file"].as<string>().c_str());
+    detailed_ops = &myfile;
+  } else {
+    detailed_ops = &cerr;
+  }
+
+  unsigned max_ops = vm["max-ops"].as<unsigned>();
+  if (max_ops == 0)
+    max_ops = records.size();
+
+  Bencher bencher(
+    new TraceDist(records, prefix, vm["speedup"].as<double>()),
+    new DetailedStatCollector(1, new JSONFormatter, detailed_ops, &cout),
+    new RadosBackend(&ioctx),
+    vm["num-concurrent-ops"].as<unsigned>(),
+    vm["duration"].as<unsigned>(),
+    max_ops);
+
+  if (!vm["do-not-init"].as<bool>()) {
+    bencher.init(objects, vm["object-size"].as<unsigned>(), &std::cout);
+    cout << "Created objects..." << std::endl;
+  }
+
+  bencher.run_bench();
+
+  rados.shutdown();
+  if (vm["op-dump-file"].as<string>().size()) {
+    myfile.close();
+  }
+  return 0;
+}
@@ -492,6 +492,60 @@ TEST(BufferPtr, release) {
   EXPECT_EQ(1, ptr1.raw_nref());
 }
 
+TEST(BufferPool, recycle) {
+  buffer::pool *pool = new buffer::pool(2);
+  const char *data;
+  {
+    bufferptr ptr(pool->create(100));
+    EXPECT_EQ((unsigned)100, ptr.length());
+    EXPECT_TRUE(ptr.is_page_aligned());
+    data = ptr.c_str();
+  }
+  {
+    // last unref above put the 4k slab back on the free list
+    bufferptr ptr(pool->create(200));
+    EXPECT_EQ(data, ptr.c_str());
+  }
+  {
+    // outstanding buffers keep the pool alive past put()
+    bufferptr ptr(pool->create_page_aligned(4096));
+    pool->put();
+  }
+}
+
+TEST(BufferPool, stats) {
+  buffer::pool::size_class_stats before[buffer::pool::NUM_SIZES];
+  buffer::pool::size_class_stats after[buffer::pool::NUM_SIZES];
+  buffer::pool::get_stats(before);
+
+  buffer::pool *pool = new buffer::pool(2);
+  {
+    bufferptr ptr(pool->create(100));
+  }
+  {
+    // drawn back out of this thread's magazine
+    bufferptr ptr(pool->create(100));
+  }
+  pool->put();
+
+  buffer::pool::get_stats(after);
+  EXPECT_EQ(before[0].alloc + 2, after[0].alloc);
+  EXPECT_EQ(before[0].tls_hit + 1, after[0].tls_hit);
+}
+
+TEST(BufferPool, fallback) {
+  // oversize requests and a zero cap bypass the pool
+  buffer::pool *pool = new buffer::pool(2);
+  bufferptr big(pool->create(2 * 1048576));
+  EXPECT_EQ((unsigned)(2 * 1048576), big.length());
+  pool->put();
+
+  buffer::pool *off = new buffer::pool(0);
+  bufferptr ptr(off->create(100));
+  EXPECT_EQ((unsigned)100, ptr.length());
+  off->put();
+}
+
 TEST(BufferPtr, have_raw) {
   {
     bufferptr ptr;
@@ -1023,6 +1077,47 @@ TEST(BufferListIterator, copy_in) {
   }
 }
 
+TEST(BufferListIterator, copy_shallow) {
+  //
+  // void buffer::list::iterator::copy_shallow(unsigned len, ptr &dest)
+  //
+  {
+    // range within one buffer: dest aliases it instead of copying
+    bufferlist bl;
+    bl.append("ABCDEF", 6);
+    bufferlist::iterator i(&bl);
+    i.advance(1);
+    bufferptr bp;
+    i.copy_shallow(3, bp);
+    EXPECT_EQ((unsigned)3, bp.length());
+    EXPECT_EQ(0, ::memcmp(bp.c_str(), "BCD", 3));
+    EXPECT_EQ(bl.buffers().front().c_str() + 1, bp.c_str());
+    EXPECT_EQ((unsigned)4, i.get_off());
+  }
+  {
+    // range spanning buffers: falls back to a flat copy
+    bufferlist bl;
+    bl.append(bufferptr("ABC", 3));
+    bl.append(bufferptr("DEF", 3));
+    bufferlist::iterator i(&bl);
+    bufferptr bp;
+    i.copy_shallow(5, bp);
+    EXPECT_EQ((unsigned)5, bp.length());
+    EXPECT_EQ(0, ::memcmp(bp.c_str(), "ABCDE", 5));
+    EXPECT_NE(bl.buffers().front().c_str(), bp.c_str());
+  }
+  {
+    // zero length yields an empty ptr, even at end of list
+    bufferlist bl;
+    bl.append("A", 1);
+    bufferlist::iterator i(&bl);
+    i.advance(1);
+    bufferptr bp;
+    i.copy_shallow(0, bp);
+    EXPECT_EQ((unsigned)0, bp.length());
+  }
+}
+
 TEST(BufferList, constructors) {
   //
   // list()
@@ -1369,7 +1464,22 @@ TEST(BufferList, rebuild_page_aligned) {
     EXPECT_FALSE(bl.is_page_aligned());
     bl.rebuild_page_aligned();
     EXPECT_TRUE(bl.is_page_aligned());
-    EXPECT_EQ((unsigned)4, bl.buffers().size());
+    // the second segment is split so its whole pages stay in place and
+    // only its tail byte is rebuilt with the two unaligned segments
+    EXPECT_EQ((unsigned)5, bl.buffers().size());
+  }
+  {
+    // whole pages of an aligned segment with a partial tail are not copied
+    bufferlist bl;
+    bufferptr ptr(buffer::create_page_aligned(2 * CEPH_PAGE_SIZE + 10));
+    const char *data = ptr.c_str();
+    bl.append(ptr);
+    bl.append("123456", 6);
+    bl.rebuild_page_aligned();
+    EXPECT_TRUE(bl.is_page_aligned());
+    EXPECT_EQ((unsigned)2, bl.buffers().size());
+    EXPECT_EQ((void*)data, (void*)bl.buffers().front().c_str());
+    EXPECT_EQ((unsigned)(2 * CEPH_PAGE_SIZE), bl.buffers().front().length());
   }
 }
 
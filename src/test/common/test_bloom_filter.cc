@@ -117,6 +117,75 @@ TEST(BloomFilter, SweepInt) {
 }
 
 
+TEST(BloomFilter, BlockedBasic) {
+  blocked_bloom_filter bf(10, .1, 1);
+  bf.insert(12345);
+  bf.insert(67890);
+
+  ASSERT_TRUE(bf.contains(12345));
+  ASSERT_TRUE(bf.contains(67890));
+
+  ASSERT_EQ(2, bf.element_count());
+}
+
+TEST(BloomFilter, BlockedEmpty) {
+  blocked_bloom_filter bf;
+  for (int i=0; i<100; ++i) {
+    ASSERT_FALSE(bf.contains(i));
+  }
+}
+
+TEST(BloomFilter, BlockedSweepInt) {
+  std::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
+  std::cout.precision(5);
+  std::cout << "# max\tfpp\tactual\tsize\tB/insert" << std::endl;
+  for (int ex = 3; ex < 12; ex += 2) {
+    for (float fpp = .001; fpp < .5; fpp *= 4.0) {
+      int max = 2 << ex;
+      blocked_bloom_filter bf(max, fpp, 1);
+
+      // well-mixed values, as the insert() doc comment asks for
+      for (int n = 0; n < max; n++)
+	bf.insert(n * 2654435761u);
+
+      int test = max * 100;
+      int hit = 0;
+      for (int n = 0; n < test; n++)
+	if (bf.contains((100000 + n) * 2654435761u))
+	  hit++;
+
+      for (int n = 0; n < max; n++)
+	ASSERT_TRUE(bf.contains(n * 2654435761u));
+
+      double actual = (double)hit / (double)test;
+
+      bufferlist bl;
+      ::encode(bf, bl);
+
+      double byte_per_insert = (double)bl.length() / (double)max;
+
+      std::cout << max << "\t" << fpp << "\t" << actual << "\t" << bl.length() << "\t" << byte_per_insert << std::endl;
+      ASSERT_TRUE(actual < fpp * 10);
+    }
+  }
+}
+
+TEST(BloomFilter, BlockedRoundTrip) {
+  blocked_bloom_filter bf(100, .01, 5);
+  for (int n = 0; n < 100; n++)
+    bf.insert(n * 2654435761u);
+
+  bufferlist bl;
+  ::encode(bf, bl);
+  blocked_bloom_filter bf2;
+  bufferlist::iterator p = bl.begin();
+  ::decode(bf2, p);
+
+  for (int n = 0; n < 100; n++)
+    ASSERT_TRUE(bf2.contains(n * 2654435761u));
+  ASSERT_EQ(bf.element_count(), bf2.element_count());
+}
+
 TEST(BloomFilter, CompressibleSweep) {
   std::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
   std::cout.precision(5);
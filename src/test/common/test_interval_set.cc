@@ -0,0 +1,154 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2004-2006 Sage Weil <sage@newdream.net>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "include/interval_set.h"
+#include "include/buffer.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <stdlib.h>
+
+typedef interval_set<uint64_t> map_set_t;
+typedef interval_set<uint64_t, flat_interval_map<uint64_t> > flat_set_t;
+
+template<typename S>
+static std::string str(const S& s)
+{
+  std::ostringstream oss;
+  oss << s;
+  return oss.str();
+}
+
+// build a random set in both backings and verify they agree
+static void random_pair(map_set_t& m, flat_set_t& f, unsigned seed)
+{
+  srand(seed);
+  for (int i = 0; i < 100; i++) {
+    uint64_t start = (rand() % 1000) * 10;
+    uint64_t len = 1 + rand() % 10;
+    if (m.intersects(start, len))
+      continue;
+    m.insert(start, len);
+    f.insert(start, len);
+  }
+}
+
+TEST(flat_interval_set, insert_merge) {
+  flat_set_t s;
+  s.insert(10, 10);
+  s.insert(30, 10);
+  s.insert(20, 10);     // glues the two together
+  ASSERT_EQ(1, s.num_intervals());
+  ASSERT_EQ(30, s.size());
+  ASSERT_EQ(10u, s.range_start());
+  ASSERT_EQ(40u, s.range_end());
+  ASSERT_TRUE(s.contains(10, 30));
+  ASSERT_FALSE(s.contains(9));
+  ASSERT_FALSE(s.contains(40));
+}
+
+TEST(flat_interval_set, erase) {
+  flat_set_t s;
+  s.insert(0, 100);
+  s.erase(10, 10);
+  ASSERT_EQ(2, s.num_intervals());
+  ASSERT_EQ(90, s.size());
+  ASSERT_TRUE(s.contains(0, 10));
+  ASSERT_FALSE(s.contains(10));
+  ASSERT_TRUE(s.contains(20, 80));
+}
+
+TEST(flat_interval_set, matches_map_backing) {
+  map_set_t m;
+  flat_set_t f;
+  random_pair(m, f, 42);
+  ASSERT_EQ(m.size(), f.size());
+  ASSERT_EQ(m.num_intervals(), f.num_intervals());
+  ASSERT_EQ(str(m), str(f));
+}
+
+TEST(flat_interval_set, union_of) {
+  for (unsigned seed = 0; seed < 10; seed++) {
+    map_set_t ma, mb, mu;
+    flat_set_t fa, fb, fu;
+    random_pair(ma, fa, seed);
+    random_pair(mb, fb, seed + 1000);
+    mu.union_of(ma, mb);
+    fu.union_of(fa, fb);
+    ASSERT_EQ(str(mu), str(fu));
+    ASSERT_EQ(mu.size(), fu.size());
+  }
+}
+
+TEST(flat_interval_set, intersection_of) {
+  for (unsigned seed = 0; seed < 10; seed++) {
+    map_set_t ma, mb, mi;
+    flat_set_t fa, fb, fi;
+    random_pair(ma, fa, seed);
+    random_pair(mb, fb, seed + 1000);
+    mi.intersection_of(ma, mb);
+    fi.intersection_of(fa, fb);
+    ASSERT_EQ(str(mi), str(fi));
+    ASSERT_EQ(mi.size(), fi.size());
+  }
+}
+
+TEST(flat_interval_set, subtract) {
+  map_set_t ma, mb;
+  flat_set_t fa, fb;
+  random_pair(ma, fa, 7);
+  mb.intersection_of(ma, ma);
+  fb.intersection_of(fa, fa);
+  ma.subtract(mb);
+  fa.subtract(fb);
+  ASSERT_TRUE(ma.empty());
+  ASSERT_TRUE(fa.empty());
+}
+
+TEST(flat_interval_set, wire_compat) {
+  // flat and map-backed sets must encode identically
+  map_set_t m;
+  flat_set_t f;
+  random_pair(m, f, 99);
+
+  bufferlist mbl, fbl;
+  ::encode(m, mbl);
+  ::encode(f, fbl);
+  ASSERT_TRUE(mbl.contents_equal(fbl));
+
+  // and decode each other's output
+  map_set_t m2;
+  flat_set_t f2;
+  bufferlist::iterator p = fbl.begin();
+  ::decode(m2, p);
+  bufferlist::iterator q = mbl.begin();
+  ::decode(f2, q);
+  ASSERT_EQ(str(m), str(m2));
+  ASSERT_EQ(str(f), str(f2));
+  ASSERT_EQ(m2.size(), f2.size());
+}
+
+TEST(flat_interval_set, span_of) {
+  flat_set_t s, sub;
+  s.insert(5, 5);
+  s.insert(20, 5);
+  sub.span_of(s, 8, 5);
+  ASSERT_EQ("[8~2,20~3]", str(sub));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,66 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include <gtest/gtest.h>
+
+TEST(Mutex, Uncontended)
+{
+  Mutex m("test::uncontended");
+  m.Lock();
+  ASSERT_TRUE(m.is_locked());
+  ASSERT_TRUE(m.is_locked_by_me());
+  m.Unlock();
+  ASSERT_FALSE(m.is_locked());
+  ASSERT_EQ(0u, m.get_num_contended());
+  ASSERT_TRUE(m.TryLock());
+  m.Unlock();
+}
+
+class MutexHammer : public Thread {
+public:
+  Mutex &m;
+  int &counter;
+  int iters;
+  MutexHammer(Mutex &m, int &counter, int iters)
+    : m(m), counter(counter), iters(iters) {}
+  virtual void *entry() {
+    for (int i = 0; i < iters; i++) {
+      Mutex::Locker l(m);
+      counter++;
+    }
+    return NULL;
+  }
+};
+
+static void hammer(Mutex &m)
+{
+  const int nthreads = 4;
+  const int iters = 100000;
+  int counter = 0;
+  MutexHammer *threads[nthreads];
+  for (int i = 0; i < nthreads; i++) {
+    threads[i] = new MutexHammer(m, counter, iters);
+    threads[i]->create();
+  }
+  for (int i = 0; i < nthreads; i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  ASSERT_EQ(nthreads * iters, counter);
+}
+
+TEST(Mutex, Contended)
+{
+  Mutex m("test::contended");
+  hammer(m);
+  ASSERT_GT(m.get_num_contended(), 0u);
+}
+
+TEST(Mutex, AdaptiveContended)
+{
+  Mutex m("test::adaptive", false, true, false, 0, true);
+  hammer(m);
+  ASSERT_GT(m.get_num_contended(), 0u);
+}
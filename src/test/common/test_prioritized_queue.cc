@@ -0,0 +1,140 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2004-2006 Sage Weil <sage@newdream.net>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "include/types.h"
+#include "common/PrioritizedQueue.h"
+#include "common/FlatPrioritizedQueue.h"
+#include "common/Clock.h"
+#include "include/utime.h"
+
+#include <gtest/gtest.h>
+
+typedef FlatPrioritizedQueue<int, int> FlatQ;
+typedef PrioritizedQueue<int, int> MapQ;
+
+TEST(FlatPrioritizedQueue, strict_before_normal) {
+  FlatQ q(1000, 1);
+  q.enqueue(1, 10, 1, 100);
+  q.enqueue_strict(1, 5, 200);
+  q.enqueue_strict(1, 20, 300);
+  EXPECT_EQ(3u, q.length());
+  // strict items first, highest strict priority first
+  EXPECT_EQ(300, q.dequeue());
+  EXPECT_EQ(200, q.dequeue());
+  EXPECT_EQ(100, q.dequeue());
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(FlatPrioritizedQueue, round_robin_within_priority) {
+  FlatQ q(1000, 1);
+  for (int i = 0; i < 3; i++) {
+    q.enqueue(1, 10, 1, 100 + i);
+    q.enqueue(2, 10, 1, 200 + i);
+  }
+  // clients take turns
+  EXPECT_EQ(100, q.dequeue());
+  EXPECT_EQ(200, q.dequeue());
+  EXPECT_EQ(101, q.dequeue());
+  EXPECT_EQ(201, q.dequeue());
+  EXPECT_EQ(102, q.dequeue());
+  EXPECT_EQ(202, q.dequeue());
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(FlatPrioritizedQueue, enqueue_front) {
+  FlatQ q(1000, 1);
+  q.enqueue(1, 10, 1, 1);
+  q.enqueue(1, 10, 1, 2);
+  q.enqueue_front(1, 10, 1, 3);
+  EXPECT_EQ(3, q.dequeue());
+  EXPECT_EQ(1, q.dequeue());
+  EXPECT_EQ(2, q.dequeue());
+}
+
+TEST(FlatPrioritizedQueue, remove_by_class) {
+  FlatQ q(1000, 1);
+  q.enqueue(1, 10, 1, 1);
+  q.enqueue(2, 10, 1, 2);
+  q.enqueue(1, 20, 1, 3);
+  q.enqueue_strict(1, 30, 4);
+  list<int> removed;
+  q.remove_by_class(1, &removed);
+  EXPECT_EQ(3u, removed.size());
+  EXPECT_EQ(1u, q.length());
+  EXPECT_EQ(2, q.dequeue());
+  EXPECT_TRUE(q.empty());
+}
+
+static bool is_even(int v)
+{
+  return (v % 2) == 0;
+}
+
+TEST(FlatPrioritizedQueue, remove_by_filter) {
+  FlatQ q(1000, 1);
+  for (int i = 0; i < 10; i++)
+    q.enqueue(i % 3, 10, 1, i);
+  list<int> removed;
+  q.remove_by_filter(is_even, &removed);
+  EXPECT_EQ(5u, removed.size());
+  EXPECT_EQ(5u, q.length());
+  while (!q.empty())
+    EXPECT_EQ(1, q.dequeue() % 2);
+}
+
+TEST(FlatPrioritizedQueue, starvation_avoidance) {
+  // a busy low priority queue must still make progress against a
+  // higher priority one
+  FlatQ q(1000, 1);
+  for (int i = 0; i < 1000; i++) {
+    q.enqueue(1, 1, 100, -i);
+    q.enqueue(2, 63, 100, i);
+  }
+  int low = 0;
+  for (int i = 0; i < 500; i++) {
+    if (q.dequeue() <= 0)
+      low++;
+  }
+  EXPECT_GT(low, 0);
+}
+
+template <typename Q>
+static double time_queue(const char *name)
+{
+  const int num_clients = 16;
+  const int per_client = 1024;
+  const int rounds = 32;
+  Q q(1000, 1);
+  utime_t start = ceph_clock_now(NULL);
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < per_client; i++) {
+      for (int c = 0; c < num_clients; c++) {
+	q.enqueue(c, (c % 4) * 31 + 1, i % 128 + 1, i);
+      }
+    }
+    while (!q.empty())
+      q.dequeue();
+  }
+  utime_t end = ceph_clock_now(NULL);
+  double secs = (double)(end - start);
+  double ops = (double)rounds * per_client * num_clients * 2;
+  printf("%s: %.0f queue ops/sec\n", name, ops / secs);
+  return secs;
+}
+
+TEST(FlatPrioritizedQueue, benchmark) {
+  double map_secs = time_queue<MapQ>("PrioritizedQueue");
+  double flat_secs = time_queue<FlatQ>("FlatPrioritizedQueue");
+  printf("speedup: %.2fx\n", map_secs / flat_secs);
+}
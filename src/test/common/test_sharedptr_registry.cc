@@ -31,9 +31,9 @@ using namespace std::tr1;
 
 class SharedPtrRegistryTest : public SharedPtrRegistry<unsigned int, int> {
 public:
-  Mutex &get_lock() { return lock; }
+  Mutex &get_lock() { return shards[0].lock; }
   map<unsigned int, pair<weak_ptr<int>, int*> > &get_contents() {
-    return contents;
+    return shards[0].contents;
   }
 };
 
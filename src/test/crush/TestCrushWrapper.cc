@@ -615,6 +615,144 @@ TEST(CrushWrapper, distance) {
   ASSERT_EQ(1, c.get_common_ancestor_distance(g_ceph_context, 3, p));
 }
 
+TEST(CrushWrapper, do_rule_batch) {
+  CrushWrapper c;
+  c.create();
+
+  const int ROOT_TYPE = 2;
+  c.set_type_name(ROOT_TYPE, "root");
+  const int HOST_TYPE = 1;
+  c.set_type_name(HOST_TYPE, "host");
+  const int OSD_TYPE = 0;
+  c.set_type_name(OSD_TYPE, "osd");
+
+  int rootno;
+  c.add_bucket(0, CRUSH_BUCKET_STRAW, CRUSH_HASH_RJENKINS1,
+	       ROOT_TYPE, 0, NULL, NULL, &rootno);
+  c.set_item_name(rootno, "default");
+
+  const int NUM_OSDS = 8;
+  for (int item = 0; item < NUM_OSDS; item++) {
+    map<string,string> loc;
+    loc["root"] = "default";
+    loc["host"] = string("host") + stringify(item / 2);
+    EXPECT_EQ(0, c.insert_item(g_ceph_context, item, 1.0,
+			       string("osd.") + stringify(item), loc));
+  }
+
+  int ruleset = c.add_simple_ruleset("data", "default", "host",
+				     "firstn", pg_pool_t::TYPE_REPLICATED);
+  EXPECT_EQ(0, ruleset);
+  int rule = c.find_rule(ruleset, pg_pool_t::TYPE_REPLICATED, 2);
+  ASSERT_LE(0, rule);
+
+  vector<__u32> weight(NUM_OSDS, 0x10000);
+  vector<int> xs;
+  for (int x = 0; x < 1024; x++)
+    xs.push_back(x);
+
+  // batch results must be identical to one do_rule() call per input
+  vector<vector<int> > batched;
+  c.do_rule_batch(rule, xs, batched, 2, weight);
+  ASSERT_EQ(xs.size(), batched.size());
+  for (unsigned i = 0; i < xs.size(); i++) {
+    vector<int> one;
+    c.do_rule(rule, xs[i], one, 2, weight);
+    ASSERT_TRUE(one == batched[i]);
+  }
+
+  // ... and so must the thread-parallel variant
+  vector<vector<int> > parallel;
+  c.do_rule_batch_parallel(rule, xs, parallel, 2, weight, 4);
+  ASSERT_TRUE(batched == parallel);
+
+  // bad rule: every input maps to nothing
+  vector<vector<int> > none;
+  c.do_rule_batch(12345, xs, none, 2, weight);
+  ASSERT_EQ(xs.size(), none.size());
+  for (unsigned i = 0; i < xs.size(); i++)
+    ASSERT_TRUE(none[i].empty());
+}
+
+TEST(CrushWrapper, straw2) {
+  CrushWrapper c;
+  c.create();
+
+  const int ROOT_TYPE = 1;
+  c.set_type_name(ROOT_TYPE, "root");
+  const int OSD_TYPE = 0;
+  c.set_type_name(OSD_TYPE, "osd");
+
+  const int NUM_OSDS = 8;
+  int items[NUM_OSDS], iweights[NUM_OSDS];
+  for (int i = 0; i < NUM_OSDS; i++) {
+    items[i] = i;
+    iweights[i] = 0x10000;
+  }
+  int rootno;
+  EXPECT_EQ(0, c.add_bucket(0, CRUSH_BUCKET_STRAW2, CRUSH_HASH_RJENKINS1,
+			    ROOT_TYPE, NUM_OSDS, items, iweights, &rootno));
+  c.set_item_name(rootno, "default");
+
+  EXPECT_TRUE(c.has_v4_buckets());
+
+  int ruleset = c.add_simple_ruleset("data", "default", "osd",
+				     "firstn", pg_pool_t::TYPE_REPLICATED);
+  EXPECT_EQ(0, ruleset);
+  int rule = c.find_rule(ruleset, pg_pool_t::TYPE_REPLICATED, 1);
+  ASSERT_LE(0, rule);
+  c.finalize();
+
+  vector<__u32> weight(NUM_OSDS, 0x10000);
+  const int NUM_X = 10000;
+
+  // roughly uniform distribution with equal weights
+  vector<int> before(NUM_X);
+  vector<int> count(NUM_OSDS, 0);
+  for (int x = 0; x < NUM_X; x++) {
+    vector<int> out;
+    c.do_rule(rule, x, out, 1, weight);
+    ASSERT_EQ(1u, out.size());
+    before[x] = out[0];
+    count[out[0]]++;
+  }
+  for (int i = 0; i < NUM_OSDS; i++) {
+    ASSERT_LT(NUM_X / NUM_OSDS * 3 / 4, count[i]);
+    ASSERT_GT(NUM_X / NUM_OSDS * 5 / 4, count[i]);
+  }
+
+  // doubling one item's weight only moves inputs *to* that item;
+  // mappings between the other items never change
+  EXPECT_EQ(1, c.adjust_item_weight(g_ceph_context, 0, 0x20000));
+  int moved = 0;
+  for (int x = 0; x < NUM_X; x++) {
+    vector<int> out;
+    c.do_rule(rule, x, out, 1, weight);
+    ASSERT_EQ(1u, out.size());
+    if (out[0] != before[x]) {
+      ASSERT_EQ(0, out[0]);
+      moved++;
+    }
+  }
+  ASSERT_LT(0, moved);
+  // about 1/9 of the inputs should move to the doubled item
+  ASSERT_GT(NUM_X / 9 * 5 / 4, moved);
+
+  // encode/decode round trip preserves the mapping
+  bufferlist bl;
+  c.encode(bl);
+  CrushWrapper c2;
+  bufferlist::iterator p = bl.begin();
+  c2.decode(p);
+  ASSERT_TRUE(c2.has_v4_buckets());
+  for (int x = 0; x < NUM_X; x++) {
+    vector<int> out, out2;
+    c.do_rule(rule, x, out, 1, weight);
+    c2.do_rule(rule, x, out2, 1, weight);
+    ASSERT_TRUE(out == out2);
+  }
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -7,6 +7,7 @@ TYPE(filepath)
 #include "common/bloom_filter.hpp"
 TYPE(bloom_filter)
 TYPE(compressible_bloom_filter)
+TYPE(blocked_bloom_filter)
 
 #include "common/snap_types.h"
 TYPE(SnapContext)
@@ -95,6 +96,7 @@ TYPE(ECSubReadReply)
 TYPE(ExplicitHashHitSet)
 TYPE(ExplicitObjectHitSet)
 TYPE(BloomHitSet)
+TYPE(BlockedBloomHitSet)
 TYPE(HitSet)
 TYPE(HitSet::Params)
 
@@ -257,6 +257,40 @@ TEST(ErasureCodeTest, encode)
     EXPECT_EQ(1u, encoded.size());
     EXPECT_EQ(alignment, encoded[0].length());
   }
+
+  {
+    //
+    // The coding chunks do not depend on the layout of the input
+    // bufferlist: a fragmented input encodes to the same chunks as
+    // the equivalent contiguous input.
+    //
+    set<int> want_to_encode;
+    for (int i = 0; i < 4; i++)
+      want_to_encode.insert(i);
+
+    bufferlist contiguous;
+    contiguous.append(string(2 * alignment, 'X'));
+    map<int,bufferlist> encoded_contiguous;
+    EXPECT_EQ(0, jerasure.encode(want_to_encode, contiguous,
+				 &encoded_contiguous));
+
+    bufferlist fragmented;
+    for (unsigned i = 0; i < 2 * alignment; i += 10) {
+      unsigned len = min(10u, 2 * alignment - i);
+      fragmented.push_back(buffer::copy(contiguous.c_str() + i, len));
+    }
+    map<int,bufferlist> encoded_fragmented;
+    EXPECT_EQ(0, jerasure.encode(want_to_encode, fragmented,
+				 &encoded_fragmented));
+
+    for (int i = 0; i < 4; i++) {
+      EXPECT_EQ(encoded_contiguous[i].length(),
+		encoded_fragmented[i].length());
+      EXPECT_EQ(0, memcmp(encoded_contiguous[i].c_str(),
+			  encoded_fragmented[i].c_str(),
+			  encoded_contiguous[i].length()));
+    }
+  }
 }
 
 TEST(ErasureCodeTest, create_ruleset)
@@ -0,0 +1,175 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ * Copyright (C) 2014 Cloudwatt <libre.licensing@cloudwatt.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <errno.h>
+#include "global/global_init.h"
+#include "erasure-code/ErasureCodePlugin.h"
+#include "common/ceph_argparse.h"
+#include "global/global_context.h"
+#include "gtest/gtest.h"
+
+static ErasureCodeInterfaceRef load_lrc(int k, int m, int l)
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  map<std::string,std::string> parameters;
+  parameters["directory"] = ".libs";
+  {
+    std::ostringstream os;
+    os << k;
+    parameters["k"] = os.str();
+  }
+  {
+    std::ostringstream os;
+    os << m;
+    parameters["m"] = os.str();
+  }
+  {
+    std::ostringstream os;
+    os << l;
+    parameters["l"] = os.str();
+  }
+  ErasureCodeInterfaceRef erasure_code;
+  EXPECT_EQ(0, instance.factory("lrc", parameters, &erasure_code, cerr));
+  return erasure_code;
+}
+
+TEST(ErasureCodeLrc, parameters)
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  map<std::string,std::string> parameters;
+  parameters["directory"] = ".libs";
+  // k must be a multiple of l
+  parameters["k"] = "5";
+  parameters["m"] = "2";
+  parameters["l"] = "2";
+  ErasureCodeInterfaceRef erasure_code;
+  EXPECT_EQ(-EINVAL, instance.factory("lrc", parameters, &erasure_code, cerr));
+}
+
+TEST(ErasureCodeLrc, minimum_to_decode)
+{
+  // k=4 m=2 l=2 : two groups of two data chunks, chunks 6 and 7 are
+  // the local parities
+  ErasureCodeInterfaceRef lrc = load_lrc(4, 2, 2);
+  ASSERT_TRUE(lrc);
+  EXPECT_EQ(8u, lrc->get_chunk_count());
+  EXPECT_EQ(4u, lrc->get_data_chunk_count());
+
+  set<int> available;
+  for (int i = 0; i < 8; ++i)
+    available.insert(i);
+
+  // a single lost data chunk only needs the rest of its local group
+  {
+    available.erase(0);
+    set<int> want;
+    want.insert(0);
+    set<int> minimum;
+    EXPECT_EQ(0, lrc->minimum_to_decode(want, available, &minimum));
+    set<int> group;
+    group.insert(1);
+    group.insert(6);
+    EXPECT_EQ(group, minimum);
+    available.insert(0);
+  }
+
+  // two losses in the same group fall back to the global code and
+  // need k chunks
+  {
+    available.erase(0);
+    available.erase(1);
+    set<int> want;
+    want.insert(0);
+    want.insert(1);
+    set<int> minimum;
+    EXPECT_EQ(0, lrc->minimum_to_decode(want, available, &minimum));
+    EXPECT_EQ(4u, minimum.size());
+    available.insert(0);
+    available.insert(1);
+  }
+}
+
+TEST(ErasureCodeLrc, encode_decode)
+{
+  ErasureCodeInterfaceRef lrc = load_lrc(4, 2, 2);
+  ASSERT_TRUE(lrc);
+
+  bufferlist in;
+  for (int i = 0; i < 4096; ++i)
+    in.append((char)(i % 26 + 'A'));
+  set<int> want_to_encode;
+  for (int i = 0; i < 8; ++i)
+    want_to_encode.insert(i);
+  map<int, bufferlist> encoded;
+  EXPECT_EQ(0, lrc->encode(want_to_encode, in, &encoded));
+  EXPECT_EQ(8u, encoded.size());
+  unsigned length =  encoded[0].length();
+
+  // the local parity is the XOR of its group
+  {
+    bufferlist expected;
+    expected.append(encoded[0]);
+    char *xored = expected.c_str();
+    const char *other = encoded[1].c_str();
+    for (unsigned i = 0; i < length; ++i)
+      xored[i] ^= other[i];
+    EXPECT_EQ(0, memcmp(xored, encoded[6].c_str(), length));
+  }
+
+  // a data chunk lost with its group intact is recovered exactly
+  {
+    map<int, bufferlist> degraded = encoded;
+    degraded.erase(2);
+    set<int> want;
+    want.insert(2);
+    map<int, bufferlist> decoded;
+    EXPECT_EQ(0, lrc->decode(want, degraded, &decoded));
+    EXPECT_EQ(0, memcmp(decoded[2].c_str(), encoded[2].c_str(), length));
+  }
+
+  // two chunks of the same group lost still decode via the global code
+  {
+    map<int, bufferlist> degraded = encoded;
+    degraded.erase(0);
+    degraded.erase(1);
+    set<int> want;
+    want.insert(0);
+    want.insert(1);
+    map<int, bufferlist> decoded;
+    EXPECT_EQ(0, lrc->decode(want, degraded, &decoded));
+    EXPECT_EQ(0, memcmp(decoded[0].c_str(), encoded[0].c_str(), length));
+    EXPECT_EQ(0, memcmp(decoded[1].c_str(), encoded[1].c_str(), length));
+  }
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+/*
+ * Local Variables:
+ * compile-command: "cd ../.. ; make -j4 &&
+ *   make unittest_erasure_code_lrc &&
+ *   valgrind --tool=memcheck ./unittest_erasure_code_lrc \
+ *      --gtest_filter=*.* --log-to-stderr=true --debug-osd=20"
+ * End:
+ */
@@ -178,3 +178,90 @@ TEST(XmlFormatter, NamespaceTest) {
     "<foo xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
     "<blah>hithere</blah><pi>3.14</pi></foo>");
 }
+
+TEST(StreamFormatter, MatchesJson) {
+  // the bufferlist-backed formatter must emit byte-identical output
+  ostringstream expected, actual;
+  JSONFormatter plain(true);
+  JSONStreamFormatter stream(true);
+  Formatter *fmts[2] = { &plain, &stream };
+  for (int i = 0; i < 2; ++i) {
+    Formatter *f = fmts[i];
+    f->open_object_section("foo");
+    f->dump_int("a", 1);
+    f->dump_string("b", "blah\nblah");
+    f->open_array_section("c");
+    f->dump_stream("item") << "hithere";
+    f->dump_float("pi", 3.14);
+    f->close_section();
+    f->close_section();
+  }
+  plain.flush(expected);
+  stream.flush(actual);
+  ASSERT_EQ(expected.str(), actual.str());
+}
+
+TEST(StreamFormatter, FlushBufferlist) {
+  JSONStreamFormatter fmt(false);
+  fmt.open_object_section("foo");
+  fmt.dump_int("a", 1);
+  fmt.close_section();
+  ASSERT_EQ(fmt.get_len(), 7);
+  bufferlist bl;
+  fmt.flush(bl);
+  ASSERT_EQ(std::string(bl.c_str(), bl.length()), "{\"a\":1}");
+  ASSERT_EQ(fmt.get_len(), 0);
+}
+
+struct StringFlushHandler : public BufferlistStreambuf::flush_handler {
+  std::string out;
+  int calls;
+  StringFlushHandler() : calls(0) {}
+  void handle_flush(bufferlist& bl) {
+    out.append(bl.c_str(), bl.length());
+    bl.clear();
+    calls++;
+  }
+};
+
+TEST(StreamFormatter, FlushHandler) {
+  // a tiny chunk size forces the handler to run mid-dump
+  StringFlushHandler handler;
+  JSONStreamFormatter fmt(false, 8);
+  fmt.set_flush_handler(&handler);
+  fmt.open_object_section("foo");
+  for (int i = 0; i < 100; ++i)
+    fmt.dump_int("a", i);
+  fmt.close_section();
+  ASSERT_GT(handler.calls, 1);
+  bufferlist tail;
+  fmt.flush(tail);
+  std::string actual = handler.out;
+  actual.append(tail.c_str(), tail.length());
+
+  ostringstream expected;
+  JSONFormatter plain(false);
+  plain.open_object_section("foo");
+  for (int i = 0; i < 100; ++i)
+    plain.dump_int("a", i);
+  plain.close_section();
+  plain.flush(expected);
+  ASSERT_EQ(expected.str(), actual);
+}
+
+TEST(StreamFormatter, MatchesXml) {
+  ostringstream expected, actual;
+  XMLFormatter plain(false);
+  XMLStreamFormatter stream(false, 16);
+  Formatter *fmts[2] = { &plain, &stream };
+  for (int i = 0; i < 2; ++i) {
+    Formatter *f = fmts[i];
+    f->open_array_section("foo");
+    f->dump_stream("blah") << "hithere";
+    f->dump_float("pi", 3.14);
+    f->close_section();
+  }
+  plain.flush(expected);
+  stream.flush(actual);
+  ASSERT_EQ(expected.str(), actual.str());
+}
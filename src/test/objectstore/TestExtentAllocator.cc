@@ -0,0 +1,106 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "os/ExtentAllocator.h"
+#include <gtest/gtest.h>
+
+TEST(ExtentAllocator, AllocateAll) {
+  ExtentAllocator a;
+  a.init_add_free(0, 1048576);
+  ASSERT_EQ(1048576u, a.get_free());
+
+  uint64_t off, len;
+  ASSERT_EQ(0, a.allocate(1048576, 4096, &off, &len));
+  ASSERT_EQ(0u, off);
+  ASSERT_EQ(1048576u, len);
+  ASSERT_EQ(0u, a.get_free());
+
+  ASSERT_EQ(-ENOSPC, a.allocate(4096, 4096, &off, &len));
+}
+
+TEST(ExtentAllocator, Alignment) {
+  ExtentAllocator a;
+  // free region starts and ends unaligned
+  a.init_add_free(100, 20000);
+
+  uint64_t off, len;
+  ASSERT_EQ(0, a.allocate(4096, 4096, &off, &len));
+  ASSERT_EQ(0u, off % 4096);
+  ASSERT_EQ(4096u, len);
+
+  // too small to yield one aligned unit
+  ExtentAllocator b;
+  b.init_add_free(100, 4096);
+  ASSERT_EQ(-ENOSPC, b.allocate(4096, 4096, &off, &len));
+}
+
+TEST(ExtentAllocator, ReleaseCoalesces) {
+  ExtentAllocator a;
+  a.init_add_free(0, 65536);
+
+  uint64_t o1, l1, o2, l2, o3, l3;
+  ASSERT_EQ(0, a.allocate(16384, 4096, &o1, &l1));
+  ASSERT_EQ(0, a.allocate(16384, 4096, &o2, &l2));
+  ASSERT_EQ(0, a.allocate(16384, 4096, &o3, &l3));
+  ASSERT_EQ(16384u, a.get_free());
+
+  // release out of order; the regions must merge back together
+  a.release(o2, l2);
+  a.release(o1, l1);
+  a.release(o3, l3);
+  ASSERT_EQ(65536u, a.get_free());
+
+  // whole region is contiguous again
+  uint64_t off, len;
+  ASSERT_EQ(0, a.allocate(65536, 4096, &off, &len));
+  ASSERT_EQ(65536u, len);
+}
+
+TEST(ExtentAllocator, FragmentedAllocation) {
+  ExtentAllocator a;
+  a.init_add_free(0, 65536);
+
+  uint64_t o1, l1, o2, l2, o3, l3;
+  ASSERT_EQ(0, a.allocate(16384, 4096, &o1, &l1));
+  ASSERT_EQ(0, a.allocate(16384, 4096, &o2, &l2));
+  ASSERT_EQ(0, a.allocate(32768, 4096, &o3, &l3));
+
+  // free two non-adjacent holes
+  a.release(o1, l1);
+  a.release(o3, l3);
+  ASSERT_EQ(49152u, a.get_free());
+
+  // a request bigger than any one hole returns a shorter extent and
+  // the caller loops for the rest
+  uint64_t total = 0;
+  while (total < 49152) {
+    uint64_t off, len;
+    ASSERT_EQ(0, a.allocate(49152 - total, 4096, &off, &len));
+    ASSERT_GT(len, 0u);
+    total += len;
+  }
+  ASSERT_EQ(49152u, total);
+  ASSERT_EQ(0u, a.get_free());
+}
+
+TEST(ExtentAllocator, InitRmFree) {
+  ExtentAllocator a;
+  a.init_add_free(0, 65536);
+  // carve out a region already in use (e.g. the superblock)
+  a.init_rm_free(0, 8192);
+  ASSERT_EQ(57344u, a.get_free());
+
+  uint64_t off, len;
+  ASSERT_EQ(0, a.allocate(57344, 4096, &off, &len));
+  ASSERT_EQ(8192u, off);
+  ASSERT_EQ(57344u, len);
+}
@@ -186,6 +186,43 @@ TEST(chain_xattr, listxattr) {
   ::unlink(file);
 }
 
+TEST(chain_xattr, fgetxattrs) {
+  const char* file = "testfile";
+  ::unlink(file);
+  int fd = ::open(file, O_CREAT|O_RDWR|O_TRUNC, 0700);
+  const string user("user.");
+  const string name1 = user + string(CHAIN_XATTR_MAX_NAME_LEN - user.size(), '1');
+  const string name2 = user + string(CHAIN_XATTR_MAX_NAME_LEN - user.size(), '@');
+  const string x(LARGE_BLOCK_LEN, 'X');
+  const int y = 1234;
+
+  ASSERT_EQ(LARGE_BLOCK_LEN, chain_fsetxattr(fd, name1.c_str(), x.c_str(), LARGE_BLOCK_LEN));
+  ASSERT_EQ((int)sizeof(y), chain_fsetxattr(fd, name2.c_str(), &y, sizeof(y)));
+
+  map<string, bufferptr> aset;
+  ASSERT_EQ(0, chain_fgetxattrs(fd, NULL, aset));
+  ASSERT_EQ(2u, aset.size());
+  ASSERT_EQ((unsigned)LARGE_BLOCK_LEN, aset[name1].length());
+  ASSERT_EQ(0, ::memcmp(x.c_str(), aset[name1].c_str(), LARGE_BLOCK_LEN));
+  ASSERT_EQ(sizeof(y), aset[name2].length());
+  ASSERT_EQ(0, ::memcmp(&y, aset[name2].c_str(), sizeof(y)));
+
+  // prefix filter
+  aset.clear();
+  ASSERT_EQ(0, chain_fgetxattrs(fd, name1.c_str(), aset));
+  ASSERT_EQ(1u, aset.size());
+  ASSERT_TRUE(aset.count(name1));
+
+  int unlikely_to_be_a_valid_fd = 400;
+  aset.clear();
+  ASSERT_GT(0, chain_fgetxattrs(unlikely_to_be_a_valid_fd, NULL, aset));
+
+  ASSERT_EQ(0, chain_fremovexattr(fd, name1.c_str()));
+  ASSERT_EQ(0, chain_fremovexattr(fd, name2.c_str()));
+  ::close(fd);
+  ::unlink(file);
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -58,3 +58,29 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+TEST(ECUtil, assemble)
+{
+  const uint64_t swidth = 4096;
+  const uint64_t ssize = 4;
+
+  ECUtil::stripe_info_t s(ssize, swidth);
+  uint64_t csize = s.get_chunk_size();
+
+  // two stripes worth of chunks 1 and 3, chunks 0 and 2 not read
+  map<int, bufferlist> chunks;
+  chunks[1].append(string(2 * csize, 'B'));
+  chunks[3].append(string(2 * csize, 'D'));
+
+  bufferlist out;
+  ASSERT_EQ(0, ECUtil::assemble(s, chunks, &out));
+  ASSERT_EQ(2 * swidth, out.length());
+
+  for (unsigned stripe = 0; stripe < 2; ++stripe) {
+    const char *base = out.c_str() + stripe * swidth;
+    ASSERT_EQ('\0', base[0]);
+    ASSERT_EQ('B', base[csize]);
+    ASSERT_EQ('\0', base[2 * csize]);
+    ASSERT_EQ('D', base[3 * csize]);
+  }
+}
+
@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2014 Inktank <info@inktank.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "osd/ObjectReadCache.h"
+#include <gtest/gtest.h>
+
+static hobject_t mkobj(const char *name, uint32_t hash)
+{
+  return hobject_t(object_t(name), "", CEPH_NOSNAP, hash, 0, "");
+}
+
+static bufferlist mkbl(char c, unsigned len)
+{
+  bufferlist bl;
+  bl.append(string(len, c));
+  return bl;
+}
+
+TEST(ObjectReadCache, LookupAndVersion)
+{
+  ObjectReadCache cache(1 << 20, 4);
+  ASSERT_TRUE(cache.enabled());
+
+  hobject_t oid = mkobj("foo", 123);
+  eversion_t v1(1, 10);
+  cache.insert(oid, v1, 0, 8192, mkbl('a', 8192));
+
+  bufferlist out;
+  ASSERT_TRUE(cache.lookup(oid, v1, 0, 8192, &out));
+  ASSERT_EQ(8192u, out.length());
+  ASSERT_EQ('a', out[0]);
+
+  // other extents and other versions miss
+  out.clear();
+  ASSERT_FALSE(cache.lookup(oid, v1, 4096, 8192, &out));
+  eversion_t v2(1, 11);
+  ASSERT_FALSE(cache.lookup(oid, v2, 0, 8192, &out));
+
+  // newer version coexists until the lru drops the old one
+  cache.insert(oid, v2, 0, 8192, mkbl('b', 8192));
+  ASSERT_TRUE(cache.lookup(oid, v2, 0, 8192, &out));
+  ASSERT_EQ('b', out[0]);
+}
+
+TEST(ObjectReadCache, Trim)
+{
+  // one shard of 64k; entries of 16k, so at most 4 fit
+  ObjectReadCache cache(64 << 10, 1);
+  eversion_t v(1, 1);
+  for (int i = 0; i < 8; ++i)
+    cache.insert(mkobj("obj", i), v, 0, 16384, mkbl('x', 16384));
+
+  int cached = 0;
+  for (int i = 0; i < 8; ++i) {
+    bufferlist out;
+    if (cache.lookup(mkobj("obj", i), v, 0, 16384, &out))
+      ++cached;
+  }
+  ASSERT_EQ(4, cached);
+
+  // the survivors are the most recently inserted
+  bufferlist out;
+  ASSERT_TRUE(cache.lookup(mkobj("obj", 7), v, 0, 16384, &out));
+}
+
+TEST(ObjectReadCache, Disabled)
+{
+  ObjectReadCache cache(0, 4);
+  ASSERT_FALSE(cache.enabled());
+}
@@ -1862,6 +1862,35 @@ TEST_F(PGLogTest, merge_log_prior_version_have) {
   run_test_case(t);
 }
 
+TEST_F(PGLogTest, trim_bounded) {
+  clear();
+
+  for (unsigned i = 1; i <= 5; ++i) {
+    pg_log_entry_t e = mk_ple_mod(mk_obj(i), mk_evt(1, i), mk_evt(1, i - 1));
+    log.add(e);
+  }
+  log.reset_recovery_pointers();
+
+  list<hobject_t> removed;
+  TestHandler h(removed);
+  set<eversion_t> trimmed;
+
+  // only max_entries go per call
+  log.trim(&h, mk_evt(1, 4), &trimmed, 2);
+  EXPECT_EQ(3u, log.log.size());
+  EXPECT_EQ(2u, trimmed.size());
+  EXPECT_EQ(mk_evt(1, 2), log.tail);
+  EXPECT_FALSE(log.logged_object(mk_obj(1)));
+  EXPECT_TRUE(log.logged_object(mk_obj(3)));
+
+  // a second call to the same point finishes the job
+  log.trim(&h, mk_evt(1, 4), &trimmed, 2);
+  EXPECT_EQ(1u, log.log.size());
+  EXPECT_EQ(4u, trimmed.size());
+  EXPECT_EQ(mk_evt(1, 4), log.tail);
+  EXPECT_TRUE(log.logged_object(mk_obj(5)));
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
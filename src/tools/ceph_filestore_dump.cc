@@ -19,6 +19,9 @@
 
 #include "common/Formatter.h"
 #include "common/errno.h"
+#include "common/Mutex.h"
+#include "common/Cond.h"
+#include "common/Thread.h"
 
 #include "global/global_init.h"
 
@@ -334,31 +337,40 @@ hobject_t biginfo_oid, log_oid;
 
 int file_fd = fd_none;
 bool debug = false;
+int num_threads = 1;
 super_header sh;
 
+// flush an import transaction once this much section data accumulates
+static const uint64_t import_batch_bytes = 64 * 1024 * 1024;
+
 template <typename T>
-int write_section(sectiontype_t type, const T& obj, int fd) {
-  bufferlist blhdr, bl, blftr;
+void append_section(sectiontype_t type, const T& obj, bufferlist& out) {
+  bufferlist bl;
   obj.encode(bl);
   header hdr(type, bl.length());
-  hdr.encode(blhdr);
+  hdr.encode(out);
+  out.claim_append(bl);
   footer ft;
-  ft.encode(blftr);
+  ft.encode(out);
+}
 
-  int ret = blhdr.write_fd(fd);
-  if (ret) return ret;
-  ret = bl.write_fd(fd);
-  if (ret) return ret;
-  ret = blftr.write_fd(fd);
-  return ret;
+void append_simple(sectiontype_t type, bufferlist& out)
+{
+  header hdr(type, 0);
+  hdr.encode(out);
+}
+
+template <typename T>
+int write_section(sectiontype_t type, const T& obj, int fd) {
+  bufferlist bl;
+  append_section(type, obj, bl);
+  return bl.write_fd(fd);
 }
 
 int write_simple(sectiontype_t type, int fd)
 {
   bufferlist hbl;
-
-  header hdr(type, 0);
-  hdr.encode(hbl);
+  append_simple(type, hbl);
   return hbl.write_fd(fd);
 }
 
@@ -575,11 +587,13 @@ int write_pg(ObjectStore::Transaction &t, epoch_t epoch, pg_info_t &info,
   return 0;
 }
 
-int export_file(ObjectStore *store, coll_t cid, ghobject_t &obj)
+// serialize one object's sections into outbl; does not touch file_fd,
+// so several objects can be encoded concurrently
+int export_object(ObjectStore *store, coll_t cid, ghobject_t &obj,
+		  bufferlist &outbl)
 {
   struct stat st;
   mysize_t total;
-  footer ft;
 
   int ret = store->stat(cid, obj, &st);
   if (ret < 0)
@@ -593,15 +607,12 @@ int export_file(ObjectStore *store, coll_t cid, ghobject_t &obj)
     cout << "size=" << total << std::endl;
 
   object_begin objb(obj);
-  ret = write_section(TYPE_OBJECT_BEGIN, objb, file_fd);
-  if (ret < 0)
-    return ret;
+  append_section(TYPE_OBJECT_BEGIN, objb, outbl);
 
   uint64_t offset = 0;
-  bufferlist rawdatabl, databl;
+  bufferlist rawdatabl;
   while(total > 0) {
     rawdatabl.clear();
-    databl.clear();
     mysize_t len = max_read;
     if (len > total)
       len = total;
@@ -619,8 +630,7 @@ int export_file(ObjectStore *store, coll_t cid, ghobject_t &obj)
     if (debug && file_fd != STDOUT_FILENO)
       cout << "data section offset=" << offset << " len=" << len << std::endl;
 
-    ret = write_section(TYPE_DATA, dblock, file_fd);
-    if (ret) return ret;
+    append_section(TYPE_DATA, dblock, outbl);
   }
 
   //Handle attrs for this object
@@ -628,16 +638,13 @@ int export_file(ObjectStore *store, coll_t cid, ghobject_t &obj)
   ret = store->getattrs(cid, obj, aset, false);
   if (ret) return ret;
   attr_section as(aset);
-  ret = write_section(TYPE_ATTRS, as, file_fd);
-  if (ret)
-    return ret;
+  append_section(TYPE_ATTRS, as, outbl);
 
   if (debug && file_fd != STDOUT_FILENO) {
     cout << "attrs size " << aset.size() << std::endl;
   }
 
   //Handle omap information
-  databl.clear();
   bufferlist hdrbuf;
   map<string, bufferlist> out;
   ret = store->omap_get(cid, obj, &hdrbuf, &out);
@@ -645,29 +652,136 @@ int export_file(ObjectStore *store, coll_t cid, ghobject_t &obj)
     return ret;
 
   omap_hdr_section ohs(hdrbuf);
-  ret = write_section(TYPE_OMAP_HDR, ohs, file_fd);
-  if (ret)
-    return ret;
+  append_section(TYPE_OMAP_HDR, ohs, outbl);
 
   if (!out.empty()) {
     omap_section oms(out);
-    ret = write_section(TYPE_OMAP, oms, file_fd);
-    if (ret)
-      return ret;
+    append_section(TYPE_OMAP, oms, outbl);
 
     if (debug && file_fd != STDOUT_FILENO)
       cout << "omap map size " << out.size() << std::endl;
   }
 
-  ret = write_simple(TYPE_OBJECT_END, file_fd);
-  if (ret)
-    return ret;
+  append_simple(TYPE_OBJECT_END, outbl);
 
   return 0;
 }
 
+int export_file(ObjectStore *store, coll_t cid, ghobject_t &obj)
+{
+  bufferlist bl;
+  int ret = export_object(store, cid, obj, bl);
+  if (ret < 0)
+    return ret;
+  return bl.write_fd(file_fd);
+}
+
+/*
+ * shared state for the parallel export.  worker threads claim objects
+ * in order, encode them into per-object buffers, and the main thread
+ * writes the buffers out in claim order so the stream is identical to
+ * a single threaded export.
+ */
+struct export_state {
+  Mutex lock;
+  Cond cond;
+  ObjectStore *store;
+  coll_t coll;
+  const vector<ghobject_t> *objects;
+  unsigned next;               //next object index to claim
+  map<unsigned, bufferlist> done;  //encoded, not yet written
+  unsigned max_pending;        //cap on done.size(), for memory
+  int ret;
+
+  export_state(ObjectStore *s, coll_t c, const vector<ghobject_t> *o,
+	       unsigned pending)
+    : lock("export_state::lock"),
+      store(s), coll(c), objects(o),
+      next(0), max_pending(pending), ret(0) {}
+};
+
+struct ExportThread : public Thread {
+  export_state *st;
+  ExportThread(export_state *s) : st(s) {}
+  void *entry() {
+    st->lock.Lock();
+    while (st->ret == 0 && st->next < st->objects->size()) {
+      // claimed-but-unfinished objects are not in done, so waiting
+      // here never blocks completion of an earlier index
+      if (st->done.size() >= st->max_pending) {
+	st->cond.Wait(st->lock);
+	continue;
+      }
+      unsigned i = st->next++;
+      st->lock.Unlock();
+
+      ghobject_t obj = (*st->objects)[i];
+      bufferlist bl;
+      int r = export_object(st->store, st->coll, obj, bl);
+
+      st->lock.Lock();
+      if (r < 0) {
+	if (st->ret == 0)
+	  st->ret = r;
+	bl.clear();  //don't emit a partial object
+      }
+      st->done[i].claim(bl);
+      st->cond.Signal();
+    }
+    st->cond.Signal();
+    st->lock.Unlock();
+    return NULL;
+  }
+};
+
+int export_files_parallel(ObjectStore *store, coll_t coll,
+			  const vector<ghobject_t>& objects)
+{
+  export_state st(store, coll, &objects, num_threads * 2);
+  vector<ExportThread*> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.push_back(new ExportThread(&st));
+    threads.back()->create();
+  }
+
+  int ret = 0;
+  unsigned next_write = 0;
+  st.lock.Lock();
+  while (next_write < objects.size()) {
+    if (st.ret < 0)
+      break;
+    map<unsigned, bufferlist>::iterator p = st.done.find(next_write);
+    if (p == st.done.end()) {
+      st.cond.Wait(st.lock);
+      continue;
+    }
+    bufferlist bl;
+    bl.claim(p->second);
+    st.done.erase(p);
+    st.cond.Signal();
+    st.lock.Unlock();
+
+    int r = bl.write_fd(file_fd);
+
+    st.lock.Lock();
+    if (r < 0 && st.ret == 0)
+      st.ret = r;
+    next_write++;
+  }
+  ret = st.ret;
+  st.cond.Signal();  //broadcast; wake any worker stalled on max_pending
+  st.lock.Unlock();
+
+  for (unsigned i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  return ret;
+}
+
 int export_files(ObjectStore *store, coll_t coll)
 {
+  vector<ghobject_t> all;
   vector<ghobject_t> objects;
   ghobject_t next;
 
@@ -676,13 +790,19 @@ int export_files(ObjectStore *store, coll_t coll)
       &objects, &next);
     if (r < 0)
       return r;
-    for (vector<ghobject_t>::iterator i = objects.begin();
-	 i != objects.end();
-	 ++i) {
-      r = export_file(store, coll, *i);
-      if (r < 0)
-        return r;
-    }
+    all.insert(all.end(), objects.begin(), objects.end());
+    objects.clear();
+  }
+
+  if (num_threads > 1)
+    return export_files_parallel(store, coll, all);
+
+  for (vector<ghobject_t>::iterator i = all.begin();
+       i != all.end();
+       ++i) {
+    int r = export_file(store, coll, *i);
+    if (r < 0)
+      return r;
   }
   return 0;
 }
@@ -865,10 +985,12 @@ int get_omap(ObjectStore *store, coll_t coll, ghobject_t hoid,
   return 0;
 }
 
-int get_object(ObjectStore *store, coll_t coll, bufferlist &bl)
+// append one object's writes to the caller's transaction; bytes is
+// bumped by the section payload sizes so the caller can decide when
+// the batch is big enough to apply
+int get_object(ObjectStore *store, coll_t coll, bufferlist &bl,
+	       ObjectStore::Transaction *t, uint64_t *bytes)
 {
-  ObjectStore::Transaction tran;
-  ObjectStore::Transaction *t = &tran;
   bufferlist::iterator ebliter = bl.begin();
   object_begin ob;
   ob.decode(ebliter);
@@ -898,6 +1020,7 @@ int get_object(ObjectStore *store, coll_t coll, bufferlist &bl)
       cout << "Skipping unknown object section type" << std::endl;
       continue;
     }
+    *bytes += ebl.length();
     switch(type) {
     case TYPE_DATA:
       ret = get_data(store, coll, ob.hoid, t, ebl);
@@ -922,7 +1045,6 @@ int get_object(ObjectStore *store, coll_t coll, bufferlist &bl)
       return EFAULT;
     }
   }
-  store->apply_transaction(*t);
   return 0;
 }
 
@@ -1028,12 +1150,19 @@ int do_import(ObjectStore *store, OSDSuperblock& sb)
 
   cout << "Importing pgid " << pgid << std::endl;
 
+  // batch objects into one transaction until enough data accumulates;
+  // applying a few big transactions is much faster than one per object
+  ObjectStore::Transaction *batch = new ObjectStore::Transaction;
+  uint64_t batch_bytes = 0;
+
   bool done = false;
   bool found_metadata = false;
   while(!done) {
     ret = read_section(file_fd, &type, &ebl);
-    if (ret)
+    if (ret) {
+      delete batch;
       return ret;
+    }
 
     //cout << "do_import: Section type " << hex << type << dec << std::endl;
     if (type >= END_OF_TYPES) {
@@ -1042,22 +1171,44 @@ int do_import(ObjectStore *store, OSDSuperblock& sb)
     }
     switch(type) {
     case TYPE_OBJECT_BEGIN:
-      ret = get_object(store, rmcoll, ebl);
-      if (ret) return ret;
+      ret = get_object(store, rmcoll, ebl, batch, &batch_bytes);
+      if (ret) {
+	delete batch;
+	return ret;
+      }
+      if (batch_bytes >= import_batch_bytes) {
+	store->apply_transaction(*batch);
+	delete batch;
+	batch = new ObjectStore::Transaction;
+	batch_bytes = 0;
+      }
       break;
     case TYPE_PG_METADATA:
+      // flush pending objects before the collection is renamed
+      store->apply_transaction(*batch);
+      delete batch;
+      batch = new ObjectStore::Transaction;
+      batch_bytes = 0;
       ret = get_pg_metadata(store, rmcoll, ebl);
-      if (ret) return ret;
+      if (ret) {
+	delete batch;
+	return ret;
+      }
       found_metadata = true;
       break;
     case TYPE_PG_END:
       done = true;
       break;
     default:
+      delete batch;
       return EFAULT;
     }
   }
 
+  if (!batch->empty())
+    store->apply_transaction(*batch);
+  delete batch;
+
   if (!found_metadata) {
     cout << "Missing metadata section" << std::endl;
     return EFAULT;
@@ -1085,6 +1236,8 @@ int main(int argc, char **argv)
     ("file", po::value<string>(&file),
      "path of file to export or import")
     ("debug", "Enable diagnostic output to stderr")
+    ("threads", po::value<int>(&num_threads),
+     "number of reader threads for export (default 1)")
     ;
 
   po::variables_map vm;
@@ -1163,6 +1316,11 @@ int main(int argc, char **argv)
     exit(1);
   }
 
+  if (num_threads < 1) {
+    cerr << "--threads must be >= 1" << std::endl;
+    exit(1);
+  }
+
   vector<const char *> ceph_options, def_args;
   vector<string> ceph_option_strings = po::collect_unrecognized(
     parsed.options, po::include_positional);
@@ -10,6 +10,9 @@
 * License version 2.1, as published by the Free Software
 * Foundation. See file COPYING.
 */
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <map>
 #include <set>
 #include <string>
@@ -27,15 +30,24 @@
 
 using namespace std;
 
+// export stream framing: a fixed magic header, then length-prefixed
+// chunks of encoded (prefix, key, value) records, so arbitrarily large
+// stores stream through a bounded amount of memory
+static const uint32_t EXPORT_MAGIC = 0x4b564442;  // 'KVDB'
+static const uint32_t EXPORT_VERSION = 1;
+static const unsigned EXPORT_KEYS_PER_CHUNK = 128;
+
 class StoreTool
 {
   boost::scoped_ptr<KeyValueDB> db;
+  LevelDBStore *ldb;  //owned by db; for store-level maintenance ops
   string store_path;
 
   public:
   StoreTool(const string &path) : store_path(path) {
     LevelDBStore *db_ptr = new LevelDBStore(g_ceph_context, store_path);
     assert(!db_ptr->open(std::cerr));
+    ldb = db_ptr;
     db.reset(db_ptr);
   }
 
@@ -139,6 +151,169 @@ class StoreTool
     return (ret == 0);
   }
 
+  int export_store(const string &prefix, const string &file) {
+    int fd = ::open(file.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) {
+      int err = -errno;
+      std::cerr << "error opening '" << file << "': "
+                << cpp_strerror(err) << std::endl;
+      return err;
+    }
+
+    bufferlist hbl;
+    ::encode(EXPORT_MAGIC, hbl);
+    ::encode(EXPORT_VERSION, hbl);
+    int r = hbl.write_fd(fd);
+    if (r < 0)
+      goto out;
+
+    {
+      KeyValueDB::WholeSpaceIterator iter = db->get_iterator();
+      if (prefix.empty())
+        iter->seek_to_first();
+      else
+        iter->seek_to_first(prefix);
+
+      uint64_t total_keys = 0, total_size = 0;
+      while (iter->valid()) {
+        bufferlist records;
+        uint32_t num = 0;
+        while (iter->valid() && num < EXPORT_KEYS_PER_CHUNK) {
+          pair<string,string> rk = iter->raw_key();
+          if (!prefix.empty() && (rk.first != prefix))
+            break;
+          bufferlist v = iter->value();
+          ::encode(rk.first, records);
+          ::encode(rk.second, records);
+          ::encode(v, records);
+          total_size += v.length();
+          num++;
+          iter->next();
+        }
+        if (num == 0)
+          break;
+        bufferlist chunk;
+        ::encode(num, chunk);
+        chunk.claim_append(records);
+        bufferlist framed;
+        ::encode(chunk, framed);
+        r = framed.write_fd(fd);
+        if (r < 0)
+          goto out;
+        total_keys += num;
+      }
+      std::cout << "exported " << total_keys << " keys ("
+                << stringify(si_t(total_size)) << ")" << std::endl;
+    }
+    r = 0;
+
+   out:
+    (void)::close(fd);
+    return r;
+  }
+
+  int import_store(const string &file, const int num_keys_per_tx) {
+    if (num_keys_per_tx <= 0) {
+      std::cerr << "must specify a number of keys/tx > 0" << std::endl;
+      return -EINVAL;
+    }
+
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+      int err = -errno;
+      std::cerr << "error opening '" << file << "': "
+                << cpp_strerror(err) << std::endl;
+      return err;
+    }
+
+    int r;
+    uint64_t total_keys = 0, total_size = 0;
+    {
+      bufferlist hbl;
+      if (hbl.read_fd(fd, 8) != 8) {
+        std::cerr << "short header" << std::endl;
+        r = -EINVAL;
+        goto out;
+      }
+      uint32_t magic, version;
+      bufferlist::iterator p = hbl.begin();
+      ::decode(magic, p);
+      ::decode(version, p);
+      if (magic != EXPORT_MAGIC) {
+        std::cerr << "bad magic; not a kvstore export?" << std::endl;
+        r = -EINVAL;
+        goto out;
+      }
+      if (version > EXPORT_VERSION) {
+        std::cerr << "can't handle export version " << version << std::endl;
+        r = -EINVAL;
+        goto out;
+      }
+    }
+
+    {
+      KeyValueDB::Transaction tx = db->get_transaction();
+      int tx_keys = 0;
+      while (true) {
+        bufferlist lenbl;
+        ssize_t got = lenbl.read_fd(fd, sizeof(uint32_t));
+        if (got == 0)
+          break;  //clean EOF
+        uint32_t len;
+        {
+          bufferlist::iterator p = lenbl.begin();
+          ::decode(len, p);
+        }
+        bufferlist chunk;
+        if (chunk.read_fd(fd, len) != (ssize_t)len) {
+          std::cerr << "unexpected EOF" << std::endl;
+          r = -EINVAL;
+          goto out;
+        }
+        bufferlist::iterator p = chunk.begin();
+        uint32_t num;
+        ::decode(num, p);
+        for (uint32_t i = 0; i < num; i++) {
+          string kprefix, key;
+          bufferlist value;
+          ::decode(kprefix, p);
+          ::decode(key, p);
+          ::decode(value, p);
+          tx->set(kprefix, key, value);
+          total_size += value.length();
+          if (++tx_keys >= num_keys_per_tx) {
+            db->submit_transaction_sync(tx);
+            tx = db->get_transaction();
+            tx_keys = 0;
+          }
+        }
+        total_keys += num;
+      }
+      if (tx_keys > 0)
+        db->submit_transaction_sync(tx);
+    }
+    std::cout << "imported " << total_keys << " keys ("
+              << stringify(si_t(total_size)) << ")" << std::endl;
+    r = 0;
+
+   out:
+    (void)::close(fd);
+    return r;
+  }
+
+  void compact() {
+    ldb->compact();
+  }
+
+  void compact_prefix(const string &prefix) {
+    ldb->compact_prefix(prefix);
+  }
+
+  void compact_range(const string &prefix,
+                     const string &start, const string &end) {
+    ldb->compact_range(prefix, start, end);
+  }
+
   int copy_store_to(const string &other_path, const int num_keys_per_tx) {
 
     if (num_keys_per_tx <= 0) {
@@ -218,6 +393,11 @@ void usage(const char *pname)
     << "  set <prefix> <key> [ver <N>|in <file>]\n"
     << "  store-copy <path> [num-keys-per-tx]\n"
     << "  store-crc <path>\n"
+    << "  export <file> [prefix]\n"
+    << "  import <file> [num-keys-per-tx]\n"
+    << "  compact\n"
+    << "  compact-prefix <prefix>\n"
+    << "  compact-range <prefix> <start> <end>\n"
     << std::endl;
 }
 
@@ -409,6 +589,54 @@ int main(int argc, const char *argv[])
       return 1;
     }
 
+  } else if (cmd == "export") {
+    if (argc < 4) {
+      usage(argv[0]);
+      return 1;
+    }
+    string prefix;
+    if (argc > 4)
+      prefix = argv[4];
+
+    int ret = st.export_store(prefix, argv[3]);
+    if (ret < 0)
+      return 1;
+
+  } else if (cmd == "import") {
+    int num_keys_per_tx = 128;
+    if (argc < 4) {
+      usage(argv[0]);
+      return 1;
+    } else if (argc > 4) {
+      string err;
+      num_keys_per_tx = strict_strtol(argv[4], 10, &err);
+      if (!err.empty()) {
+        std::cerr << "invalid num_keys_per_tx: " << err << std::endl;
+        return 1;
+      }
+    }
+
+    int ret = st.import_store(argv[3], num_keys_per_tx);
+    if (ret < 0)
+      return 1;
+
+  } else if (cmd == "compact") {
+    st.compact();
+
+  } else if (cmd == "compact-prefix") {
+    if (argc < 4) {
+      usage(argv[0]);
+      return 1;
+    }
+    st.compact_prefix(argv[3]);
+
+  } else if (cmd == "compact-range") {
+    if (argc < 6) {
+      usage(argv[0]);
+      return 1;
+    }
+    st.compact_range(argv[3], argv[4], argv[5]);
+
   } else if (cmd == "store-crc") {
     uint32_t crc = st.traverse(string(), true, NULL);
     std::cout << "store at '" << path << "' crc " << crc << std::endl;
@@ -0,0 +1,232 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2014 Inktank <info@inktank.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * top(1)-style live view of daemon perf counters.  Polls 'perf rate'
+ * on one or more admin sockets and renders one row per daemon, so it
+ * works against any running daemon without a restart or a config
+ * change.  Counters show their per-second rate, gauges (e.g. the op
+ * queue depth) their current value, and running averages (latencies)
+ * the mean over the sampling interval.
+ */
+
+#include <boost/program_options/option.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <curses.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/admin_socket_client.h"
+#include "json_spirit/json_spirit.h"
+
+namespace po = boost::program_options;
+using namespace std;
+
+#define NAME_WIDTH 24
+#define COL_WIDTH 14
+
+static void split(const string &s, char sep, vector<string> *out)
+{
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t next = s.find(sep, pos);
+    if (next == string::npos)
+      next = s.size();
+    if (next > pos)
+      out->push_back(s.substr(pos, next - pos));
+    pos = next + 1;
+  }
+}
+
+// JSONFormatter quotes floats, so rates arrive as strings
+static double to_double(const json_spirit::mValue &v)
+{
+  switch (v.type()) {
+  case json_spirit::real_type:
+    return v.get_real();
+  case json_spirit::int_type:
+    return (double)v.get_int64();
+  case json_spirit::str_type:
+    return strtod(v.get_str().c_str(), NULL);
+  default:
+    return 0;
+  }
+}
+
+/*
+ * look up a "logger.counter" spec in a parsed 'perf rate' reply and
+ * render it into buf.  Counters come back as numbers (already a
+ * per-second rate) and running averages as {"rate": ..., "avg": ...};
+ * for the latter we show the interval mean, scaled to milliseconds
+ * since it is invariably a latency.
+ */
+static void format_cell(const json_spirit::mValue &root, const string &spec,
+			char *buf, size_t len)
+{
+  snprintf(buf, len, "%*s", COL_WIDTH, "-");
+  size_t dot = spec.find('.');
+  if (dot == string::npos || root.type() != json_spirit::obj_type)
+    return;
+
+  const json_spirit::mObject &top = root.get_obj();
+  json_spirit::mObject::const_iterator l = top.find(spec.substr(0, dot));
+  if (l == top.end() || l->second.type() != json_spirit::obj_type)
+    return;
+  const json_spirit::mObject &logger = l->second.get_obj();
+  json_spirit::mObject::const_iterator c = logger.find(spec.substr(dot + 1));
+  if (c == logger.end())
+    return;
+
+  const json_spirit::mValue &v = c->second;
+  if (v.type() == json_spirit::obj_type) {
+    const json_spirit::mObject &avg = v.get_obj();
+    json_spirit::mObject::const_iterator a = avg.find("avg");
+    if (a != avg.end())
+      snprintf(buf, len, "%*.3f", COL_WIDTH, to_double(a->second) * 1000.0);
+  } else if (v.type() == json_spirit::int_type) {
+    snprintf(buf, len, "%*llu", COL_WIDTH,
+	     (unsigned long long)v.get_uint64());
+  } else {
+    snprintf(buf, len, "%*.1f", COL_WIDTH, to_double(v));
+  }
+}
+
+static string daemon_name(const string &path)
+{
+  size_t slash = path.find_last_of('/');
+  string name = (slash == string::npos) ? path : path.substr(slash + 1);
+  if (name.size() > 5 && name.substr(name.size() - 5) == ".asok")
+    name = name.substr(0, name.size() - 5);
+  return name;
+}
+
+int main(int argc, char **argv)
+{
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help", "produce help message")
+    ("admin-socket", po::value<vector<string> >(),
+     "admin socket path; repeat for multiple daemons")
+    ("interval", po::value<double>()->default_value(1.0),
+     "sampling interval in seconds")
+    ("counters", po::value<string>()->default_value(
+      "osd.op,osd.op_in_bytes,osd.op_out_bytes,osd.opq,osd.op_latency"),
+     "comma separated logger.counter columns to display")
+    ("count", po::value<unsigned>()->default_value(0),
+     "exit after this many refreshes, 0 to run until 'q'")
+    ;
+  po::positional_options_description pd;
+  pd.add("admin-socket", -1);
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).
+	    options(desc).positional(pd).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help") || !vm.count("admin-socket")) {
+    cout << "usage: ceph_perf_top [options] <admin-socket> [<admin-socket>...]"
+	 << std::endl;
+    cout << desc << std::endl;
+    return 1;
+  }
+
+  vector<string> sockets = vm["admin-socket"].as<vector<string> >();
+  vector<string> columns;
+  split(vm["counters"].as<string>(), ',', &columns);
+  if (columns.empty()) {
+    cerr << "no counters to display" << std::endl;
+    return 1;
+  }
+
+  double interval = vm["interval"].as<double>();
+  if (interval < 0.1)
+    interval = 0.1;
+  unsigned count = vm["count"].as<unsigned>();
+
+  // prime the rate state in each daemon so the first screen already
+  // has a real interval behind it
+  for (vector<string>::iterator s = sockets.begin();
+       s != sockets.end();
+       ++s) {
+    AdminSocketClient client(*s);
+    string out;
+    client.do_request("{\"prefix\": \"perf rate\", \"format\": \"json\"}",
+		      &out);
+  }
+
+  initscr();
+  cbreak();
+  noecho();
+  nodelay(stdscr, TRUE);
+  curs_set(0);
+
+  unsigned refreshes = 0;
+  bool done = false;
+  while (!done) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)interval;
+    ts.tv_nsec = (long)((interval - (double)ts.tv_sec) * 1000000000.0);
+    nanosleep(&ts, NULL);
+
+    erase();
+    mvprintw(0, 0, "%-*s", NAME_WIDTH, "daemon");
+    for (unsigned i = 0; i < columns.size(); ++i) {
+      // averages are rendered in milliseconds; mark them
+      string header = columns[i].substr(columns[i].find('.') + 1);
+      mvprintw(0, NAME_WIDTH + i * (COL_WIDTH + 1), "%*s",
+	       COL_WIDTH, header.c_str());
+    }
+
+    int row = 1;
+    for (vector<string>::iterator s = sockets.begin();
+	 s != sockets.end();
+	 ++s, ++row) {
+      mvprintw(row, 0, "%-*s", NAME_WIDTH, daemon_name(*s).c_str());
+
+      AdminSocketClient client(*s);
+      string out;
+      string err = client.do_request(
+	"{\"prefix\": \"perf rate\", \"format\": \"json\"}", &out);
+      json_spirit::mValue v;
+      if (!err.empty() || !json_spirit::read(out, v)) {
+	mvprintw(row, NAME_WIDTH, "(unreachable)");
+	continue;
+      }
+      for (unsigned i = 0; i < columns.size(); ++i) {
+	char buf[64];
+	format_cell(v, columns[i], buf, sizeof(buf));
+	mvprintw(row, NAME_WIDTH + i * (COL_WIDTH + 1), "%s", buf);
+      }
+    }
+    mvprintw(row + 1, 0,
+	     "interval %.1fs; rates/s, gauges absolute, latencies avg ms; "
+	     "q to quit", interval);
+    refresh();
+
+    ++refreshes;
+    if (count && refreshes >= count)
+      done = true;
+    int ch = getch();
+    if (ch == 'q' || ch == 'Q')
+      done = true;
+  }
+
+  endwin();
+  return 0;
+}
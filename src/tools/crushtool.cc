@@ -97,6 +97,9 @@ void usage()
   cout << "      [--min-rule r] [--max-rule r] [--rule r]\n";
   cout << "      [--num-rep n]\n";
   cout << "      [--batches b]      split the CRUSH mapping into b > 1 rounds\n";
+  cout << "      [--num-threads n]  compute mappings with n parallel threads\n";
+  cout << "      [--baseline mapfn] only test rules whose mapping could\n";
+  cout << "                         differ from what mapfn produces\n";
   cout << "      [--weight|-w devno weight]\n";
   cout << "                         where weight is 0 to 1.0\n";
   cout << "      [--simulate]       simulate placements using a random\n";
@@ -147,6 +150,7 @@ struct bucket_types_t {
   { "uniform", CRUSH_BUCKET_UNIFORM },
   { "list", CRUSH_BUCKET_LIST },
   { "straw", CRUSH_BUCKET_STRAW },
+  { "straw2", CRUSH_BUCKET_STRAW2 },
   { "tree", CRUSH_BUCKET_TREE },
   { 0, 0 },
 };
@@ -164,6 +168,7 @@ int main(int argc, const char **argv)
 
   const char *me = argv[0];
   std::string infn, srcfn, outfn, add_name, remove_name, reweight_name;
+  std::string baselinefn;
   bool compile = false;
   bool decompile = false;
   bool test = false;
@@ -390,6 +395,14 @@ int main(int argc, const char **argv)
 	exit(EXIT_FAILURE);
       }
       tester.set_batches(x);
+    } else if (ceph_argparse_withint(args, i, &x, &err, "--num-threads", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << err.str() << std::endl;
+	exit(EXIT_FAILURE);
+      }
+      tester.set_num_threads(x);
+    } else if (ceph_argparse_witharg(args, i, &val, "--baseline", (char*)NULL)) {
+      baselinefn = val;
     } else if (ceph_argparse_withfloat(args, i, &y, &err, "--mark-down-ratio", (char*)NULL)) {
       if (!err.str().empty()) {
         cerr << err.str() << std::endl;
@@ -477,6 +490,21 @@ int main(int argc, const char **argv)
     crush.decode(p);
   }
 
+  CrushWrapper baseline_crush;
+  if (!baselinefn.empty()) {
+    bufferlist bl;
+    std::string error;
+    int r = bl.read_file(baselinefn.c_str(), &error);
+    if (r < 0) {
+      cerr << me << ": error reading '" << baselinefn << "': "
+	   << error << std::endl;
+      exit(1);
+    }
+    bufferlist::iterator p = bl.begin();
+    baseline_crush.decode(p);
+    tester.set_baseline(&baseline_crush);
+  }
+
   if (decompile) {
     CrushCompiler cc(crush, cerr, verbose);
     if (!outfn.empty()) {
@@ -170,6 +170,11 @@ void usage(ostream& out)
 "        Set number of concurrent I/O operations\n"
 "   --show-time\n"
 "        prefix output with date/time\n"
+"   --target-iops=N\n"
+"        pace ops at a fixed rate instead of issuing a new op as soon\n"
+"        as an old one completes (measures latency at a target load)\n"
+"   --format=json\n"
+"        print the final summary in a machine-readable format\n"
 "\n"
 "LOAD GEN OPTIONS:\n"
 "   --num-objects                    total number of objects\n"
@@ -1192,6 +1197,7 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
   int64_t read_percent = -1;
   uint64_t num_objs = 0;
   int run_length = 0;
+  int target_iops = 0;
 
   bool show_time = false;
 
@@ -1292,6 +1298,10 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
   if (i != opts.end()) {
     run_length = strtol(i->second.c_str(), NULL, 10);
   }
+  i = opts.find("target-iops");
+  if (i != opts.end()) {
+    target_iops = strtol(i->second.c_str(), NULL, 10);
+  }
   i = opts.find("show-time");
   if (i != opts.end()) {
     show_time = true;
@@ -2213,6 +2223,8 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
       usage_exit();
     RadosBencher bencher(g_ceph_context, rados, io_ctx);
     bencher.set_show_time(show_time);
+    bencher.set_formatter(formatter);
+    bencher.set_target_iops(target_iops);
     ret = bencher.aio_bench(operation, seconds, num_objs,
 			    concurrent_ios, op_size, cleanup, run_name);
     if (ret != 0)
@@ -2614,6 +2626,8 @@ int main(int argc, const char **argv)
       opts["num-objects"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--run-length", (char*)NULL)) {
       opts["run-length"] = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--target-iops", (char*)NULL)) {
+      opts["target-iops"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--workers", (char*)NULL)) {
       opts["workers"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--format", (char*)NULL)) {